@@ -15,6 +15,7 @@ import 'services/version_service.dart';
 import 'services/player_background_service.dart';
 import 'services/persistent_storage_service.dart';
 import 'services/listening_stats_service.dart';
+import 'services/local_search_service.dart';
 import 'services/desktop_lyric_service.dart';
 import 'services/android_floating_lyric_service.dart';
 
@@ -126,8 +127,12 @@ void main() async {
   ListeningStatsService().initialize();
   DeveloperModeService().addLog('📊 听歌统计服务已初始化');
   
-  // 初始化桌面歌词服务（仅Windows）
-  if (Platform.isWindows) {
+  // 初始化本地搜索索引（后台建立，不阻塞启动）
+  LocalSearchService().initialize();
+  DeveloperModeService().addLog('🔎 本地搜索服务已初始化');
+  
+  // 初始化桌面歌词服务（Windows / Linux）
+  if (DesktopLyricService.isSupported) {
     await DesktopLyricService().initialize();
     DeveloperModeService().addLog('🎤 桌面歌词服务已初始化');
   }
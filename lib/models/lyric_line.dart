@@ -1,13 +1,28 @@
+/// 逐字歌词中的一个字（词）
+class LyricWord {
+  final Duration startTime;
+  final Duration duration;
+  final String text;
+
+  const LyricWord({
+    required this.startTime,
+    required this.duration,
+    required this.text,
+  });
+}
+
 /// 歌词行模型
 class LyricLine {
   final Duration startTime;
   final String text;
   final String? translation; // 翻译歌词
+  final List<LyricWord>? words; // 逐字时间（YRC/QRC），拼接后等于 text
 
   LyricLine({
     required this.startTime,
     required this.text,
     this.translation,
+    this.words,
   });
 
   /// 从时间戳字符串解析 Duration
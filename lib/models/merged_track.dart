@@ -1,3 +1,4 @@
+import '../native/search_merge_native.dart';
 import 'track.dart';
 
 /// 合并后的歌曲模型（支持多平台）
@@ -49,8 +50,11 @@ class MergedTrack {
     }
   }
 
-  /// 判断两首歌是否相同（歌曲名和歌手名完全一致）
+  /// 判断两首歌是否相同（原生库可用时与搜索合并规则一致，否则要求
+  /// 歌曲名和歌手名完全一致）
   static bool isSameSong(Track a, Track b) {
+    final groups = NativeSearchMerger.group([a, b]);
+    if (groups != null) return groups[1] == 0;
     return _normalize(a.name) == _normalize(b.name) &&
            _normalize(a.artists) == _normalize(b.artists);
   }
@@ -0,0 +1,88 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _CreateNative = Pointer<Void> Function(Pointer<Uint8>, Int32);
+typedef _CreateDart = Pointer<Void> Function(Pointer<Uint8>, int);
+typedef _DestroyNative = Void Function(Pointer<Void>);
+typedef _DestroyDart = void Function(Pointer<Void>);
+typedef _ApplyNative = Void Function(
+    Pointer<Void>, Pointer<Uint8>, Pointer<Uint8>, Int64, Int64);
+typedef _ApplyDart = void Function(
+    Pointer<Void>, Pointer<Uint8>, Pointer<Uint8>, int, int);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<_CreateNative, _CreateDart>('cyrene_aes_create'),
+        destroy = lib.lookupFunction<_DestroyNative, _DestroyDart>('cyrene_aes_destroy'),
+        apply = lib.lookupFunction<_ApplyNative, _ApplyDart>(
+            'cyrene_aes_apply', isLeaf: true);
+
+  final _CreateDart create;
+  final _DestroyDart destroy;
+  final _ApplyDart apply;
+}
+
+/// 原生 AES-CTR 加解密内核
+///
+/// 由 native/aes_ctr.cc 实现，按 CPU 选择 VAES（AVX-512 / AVX2）/ AES-NI
+/// 路径，不支持 AES 指令时使用 OpenSSL。计数器为 nonce + 偏移 / 16，
+/// 可以从任意位置开始处理；数据原地处理，不产生额外拷贝。
+class NativeAesCtr {
+  NativeAesCtr._(this._handle);
+
+  /// nonce 长度（字节）
+  static const int nonceLength = 16;
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeAesCtr] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  final Pointer<Void> _handle;
+
+  /// 使用 16 字节（AES-128）或 32 字节（AES-256）的 [key] 创建内核，
+  /// 原生库不可用或密钥长度不对时返回 null
+  ///
+  /// 密钥在创建时展开一次，实例应长期复用（通常与服务同生命周期）。
+  static NativeAesCtr? create(Uint8List key) {
+    final native = _native;
+    if (native == null || (key.length != 16 && key.length != 32)) return null;
+
+    final keyPtr = malloc<Uint8>(key.length);
+    try {
+      keyPtr.asTypedList(key.length).setAll(0, key);
+      final handle = native.create(keyPtr, key.length);
+      if (handle == nullptr) return null;
+      return NativeAesCtr._(handle);
+    } finally {
+      malloc.free(keyPtr);
+    }
+  }
+
+  /// 用 [nonce] 的密钥流原地加解密 [data]，[offset] 为 data[0] 在密文流中的位置
+  void apply(Uint8List nonce, Uint8List data, {int offset = 0}) {
+    if (data.isEmpty || nonce.length != nonceLength) return;
+    _native!.apply(_handle, nonce.address, data.address, data.length, offset);
+  }
+
+  /// 释放原生资源
+  void dispose() {
+    _native!.destroy(_handle);
+  }
+}
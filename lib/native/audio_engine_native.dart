@@ -0,0 +1,218 @@
+import 'dart:ffi';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _CreateNative = Pointer<Void> Function(Int32);
+typedef _CreateDart = Pointer<Void> Function(int);
+typedef _HandleNative = Void Function(Pointer<Void>);
+typedef _HandleDart = void Function(Pointer<Void>);
+typedef _LoadNative = Int32 Function(
+    Pointer<Void>, Int64, Pointer<Utf8>, Int32, Double);
+typedef _LoadDart = int Function(Pointer<Void>, int, Pointer<Utf8>, int, double);
+typedef _QueueNextNative = Int32 Function(
+    Pointer<Void>, Int64, Pointer<Utf8>, Double);
+typedef _QueueNextDart = int Function(Pointer<Void>, int, Pointer<Utf8>, double);
+typedef _SeekNative = Void Function(Pointer<Void>, Int64);
+typedef _SeekDart = void Function(Pointer<Void>, int);
+typedef _VolumeNative = Void Function(Pointer<Void>, Double);
+typedef _VolumeDart = void Function(Pointer<Void>, double);
+typedef _CrossfadeNative = Void Function(Pointer<Void>, Int32);
+typedef _CrossfadeDart = void Function(Pointer<Void>, int);
+typedef _StatusNative = Int32 Function(Pointer<Void>, Pointer<Int64>, Int32);
+typedef _StatusDart = int Function(Pointer<Void>, Pointer<Int64>, int);
+typedef _SinkNameNative = Pointer<Utf8> Function(Pointer<Void>);
+typedef _SinkNameDart = Pointer<Utf8> Function(Pointer<Void>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<_CreateNative, _CreateDart>(
+            'cyrene_audio_engine_create'),
+        destroy = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_audio_engine_destroy'),
+        load = lib.lookupFunction<_LoadNative, _LoadDart>(
+            'cyrene_audio_engine_load'),
+        queueNext = lib.lookupFunction<_QueueNextNative, _QueueNextDart>(
+            'cyrene_audio_engine_queue_next'),
+        play = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_audio_engine_play', isLeaf: true),
+        pause = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_audio_engine_pause', isLeaf: true),
+        stop = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_audio_engine_stop'),
+        seek = lib.lookupFunction<_SeekNative, _SeekDart>(
+            'cyrene_audio_engine_seek', isLeaf: true),
+        setVolume = lib.lookupFunction<_VolumeNative, _VolumeDart>(
+            'cyrene_audio_engine_set_volume', isLeaf: true),
+        setCrossfade = lib.lookupFunction<_CrossfadeNative, _CrossfadeDart>(
+            'cyrene_audio_engine_set_crossfade', isLeaf: true),
+        status = lib.lookupFunction<_StatusNative, _StatusDart>(
+            'cyrene_audio_engine_status', isLeaf: true),
+        sinkName = lib.lookupFunction<_SinkNameNative, _SinkNameDart>(
+            'cyrene_audio_engine_sink_name', isLeaf: true);
+
+  final _CreateDart create;
+  final _HandleDart destroy;
+  final _LoadDart load;
+  final _QueueNextDart queueNext;
+  final _HandleDart play;
+  final _HandleDart pause;
+  final _HandleDart stop;
+  final _SeekDart seek;
+  final _VolumeDart setVolume;
+  final _CrossfadeDart setCrossfade;
+  final _StatusDart status;
+  final _SinkNameDart sinkName;
+}
+
+/// 输出后端（与 native/audio_sink.h 的 SinkBackend 一致）
+enum AudioSinkBackend {
+  /// 依次尝试 PulseAudio（PipeWire 通过 pipewire-pulse 提供）、ALSA、空输出
+  auto,
+  pulse,
+  alsa,
+
+  /// 不发声、按实时速度消耗数据，用于测试
+  none,
+}
+
+/// 引擎状态（与 native/audio_engine.h 的 AudioEngine::State 一致）
+enum AudioEngineState { idle, loading, playing, paused, ended, error }
+
+/// 一次状态查询的结果
+class AudioEngineStatus {
+  const AudioEngineStatus({
+    required this.state,
+    required this.itemId,
+    required this.position,
+    required this.duration,
+    required this.latency,
+    required this.underruns,
+    required this.nextItemId,
+  });
+
+  final AudioEngineState state;
+
+  /// 正在听到的条目（切歌后要等新歌真正出声才会变）
+  final int itemId;
+  final Duration position;
+
+  /// 未知时为 0
+  final Duration duration;
+
+  /// 已解码但还没听到的音频：设备缓冲 + 环形缓冲
+  final Duration latency;
+
+  /// 播放中缓冲被取空的次数（含设备报告的欠载）
+  final int underruns;
+
+  /// 已打开并预解码、可以无缝接上的下一条目，没有时为 0
+  final int nextItemId;
+}
+
+/// 原生播放引擎（Linux）
+///
+/// 由 native/audio_engine.cc 实现：解码线程经无锁环形缓冲把数据交给输出
+/// 线程，输出到 PulseAudio / PipeWire / ALSA。[queueNext] 在后台打开并预
+/// 解码下一首，当前歌曲结束时在同一个缓冲里直接接上（无缝播放），设置了
+/// [setCrossfade] 时在结尾交叉淡入淡出。引擎不回调 Dart，由调用方定时
+/// 查询 [status]。
+class NativeAudioEngine {
+  NativeAudioEngine._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeAudioEngine] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生引擎是否可用
+  static bool get isAvailable => _native != null;
+
+  static const int _statusFields = 7;
+
+  final Pointer<Void> _handle;
+
+  /// 打开 [backend] 并创建引擎，不可用时返回 null
+  static NativeAudioEngine? create(
+      {AudioSinkBackend backend = AudioSinkBackend.auto}) {
+    final native = _native;
+    if (native == null) return null;
+    final handle = native.create(backend.index);
+    if (handle == nullptr) return null;
+    return NativeAudioEngine._(handle);
+  }
+
+  /// 实际使用的输出（pulse / alsa / null）
+  String get sinkName => _native!.sinkName(_handle).toDartString();
+
+  /// 停止当前播放，打开 [uri]（本地路径、file:// 或 http://）作为 [itemId]
+  ///
+  /// [gain] 是只作用于这一首的线性增益（响度均衡），在混音和音量之前施加。
+  void load(int itemId, String uri, {bool play = true, double gain = 1.0}) {
+    final uriPtr = uri.toNativeUtf8();
+    try {
+      _native!.load(_handle, itemId, uriPtr, play ? 1 : 0, gain);
+    } finally {
+      malloc.free(uriPtr);
+    }
+  }
+
+  /// 把 [uri] 设为下一首并开始预解码；[uri] 为 null 时清除
+  void queueNext(int itemId, String? uri, {double gain = 1.0}) {
+    if (uri == null) {
+      _native!.queueNext(_handle, 0, nullptr, 1.0);
+      return;
+    }
+    final uriPtr = uri.toNativeUtf8();
+    try {
+      _native!.queueNext(_handle, itemId, uriPtr, gain);
+    } finally {
+      malloc.free(uriPtr);
+    }
+  }
+
+  void play() => _native!.play(_handle);
+  void pause() => _native!.pause(_handle);
+  void stop() => _native!.stop(_handle);
+  void seek(Duration position) =>
+      _native!.seek(_handle, position.inMilliseconds);
+  void setVolume(double volume) => _native!.setVolume(_handle, volume);
+
+  /// 结尾交叉淡入淡出的时长，[Duration.zero] 为无缝衔接
+  void setCrossfade(Duration duration) =>
+      _native!.setCrossfade(_handle, duration.inMilliseconds);
+
+  AudioEngineStatus status() {
+    final out = malloc<Int64>(_statusFields);
+    try {
+      _native!.status(_handle, out, _statusFields);
+      return AudioEngineStatus(
+        state: AudioEngineState.values[out[0]],
+        itemId: out[1],
+        position: Duration(milliseconds: out[2]),
+        duration: Duration(milliseconds: out[3]),
+        latency: Duration(milliseconds: out[4]),
+        underruns: out[5],
+        nextItemId: out[6],
+      );
+    } finally {
+      malloc.free(out);
+    }
+  }
+
+  /// 释放引擎，之后不能再使用
+  void dispose() => _native!.destroy(_handle);
+}
@@ -0,0 +1,74 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _RenderNative = Int32 Function(
+    Pointer<Utf8>, Pointer<Uint8>, Int64, Int32, Int32, Float, Uint32);
+typedef _RenderDart = int Function(
+    Pointer<Utf8>, Pointer<Uint8>, int, int, int, double, int);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : render = lib.lookupFunction<_RenderNative, _RenderDart>(
+            'cyrene_background_render');
+
+  final _RenderDart render;
+}
+
+/// 原生预模糊播放器背景
+///
+/// 由 native/background_blur.cc 实现：按显示区域的宽高比居中裁剪，缩小到
+/// 模糊只剩几个像素宽的工作尺寸，三次可分离盒式模糊（AVX2/NEON）近似
+/// 高斯模糊，再叠加半透明遮罩，输出一张小 JPEG 供界面拉伸绘制。调用是
+/// 阻塞的，应在后台 isolate 中执行。
+class NativeBackgroundBlur {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeBackgroundBlur] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生背景模糊是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 把图片 [bytes]（JPEG/PNG）按 [width]×[height] 逻辑像素的显示区域、
+  /// 高斯模糊 [sigma]（与 ImageFilter.blur 相同）渲染，叠加 ARGB 遮罩
+  /// [tint] 后写入 [path]。原生库不可用或无法解码时返回 false。
+  static bool render(
+    String path,
+    Uint8List bytes, {
+    required int width,
+    required int height,
+    required double sigma,
+    required int tint,
+  }) {
+    final native = _native;
+    if (native == null || bytes.isEmpty) return false;
+
+    final pathPtr = path.toNativeUtf8();
+    final dataPtr = malloc<Uint8>(bytes.length);
+    try {
+      dataPtr.asTypedList(bytes.length).setAll(0, bytes);
+      return native.render(
+              pathPtr, dataPtr, bytes.length, width, height, sigma, tint) !=
+          0;
+    } finally {
+      malloc.free(pathPtr);
+      malloc.free(dataPtr);
+    }
+  }
+}
@@ -0,0 +1,118 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _IngestNative = Int32 Function(Pointer<Utf8>, Pointer<Utf8>,
+    Pointer<Uint8>, Int32, Pointer<Uint8>, Int32, Pointer<Utf8>,
+    Pointer<Int64>, Pointer<Utf8>);
+typedef _IngestDart = int Function(Pointer<Utf8>, Pointer<Utf8>,
+    Pointer<Uint8>, int, Pointer<Uint8>, int, Pointer<Utf8>, Pointer<Int64>,
+    Pointer<Utf8>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : ingest = lib.lookupFunction<_IngestNative, _IngestDart>(
+            'cyrene_cache_ingest');
+
+  final _IngestDart ingest;
+}
+
+/// 一次下载入缓存的结果
+class CacheIngestResult {
+  const CacheIngestResult({
+    required this.success,
+    required this.statusCode,
+    required this.size,
+    required this.checksum,
+  });
+
+  final bool success;
+
+  /// 最终响应的 HTTP 状态码，没有收到响应时为 0
+  final int statusCode;
+
+  /// 写入的音频字节数（失败时为已收到的字节数）
+  final int size;
+
+  /// 音频数据的 MD5（小写十六进制），失败时为空
+  final String checksum;
+}
+
+/// 原生缓存写入管线（Linux）
+///
+/// 由 native/cache_ingest.cc 实现：响应体按块依次经过增量 MD5 和 .cyrene v2 / v3
+/// 写入器（加密、CRC32C），直接写入 `.part` 文件，完成后原子重命名。整首歌
+/// 不会进入内存，每个下载只占一个写入块加一次 socket 读取的内存。调用会阻塞
+/// 到下载结束，应在后台 isolate 中使用。
+class NativeCacheIngest {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeCacheIngest] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生管线是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 下载 [url] 并以 [key] 加密写入 [filePath]，[metadata] 写入文件头
+  ///
+  /// 给出 [expectedMd5] 时，音频数据的 MD5 不一致视为失败，不留下文件。
+  static CacheIngestResult ingest(
+    String url,
+    String filePath,
+    Uint8List key,
+    Uint8List metadata, {
+    String? expectedMd5,
+  }) {
+    final native = _native;
+    if (native == null) {
+      return const CacheIngestResult(
+          success: false, statusCode: 0, size: 0, checksum: '');
+    }
+
+    final urlPtr = url.toNativeUtf8();
+    final pathPtr = filePath.toNativeUtf8();
+    final keyPtr = malloc<Uint8>(key.isEmpty ? 1 : key.length);
+    final metadataPtr = malloc<Uint8>(metadata.isEmpty ? 1 : metadata.length);
+    final out = malloc<Int64>(2);
+    final md5Ptr = malloc<Uint8>(33);
+    final expectedPtr =
+        expectedMd5 == null ? nullptr : expectedMd5.toNativeUtf8();
+    try {
+      keyPtr.asTypedList(key.length).setAll(0, key);
+      metadataPtr.asTypedList(metadata.length).setAll(0, metadata);
+      final ok = native.ingest(urlPtr, pathPtr, keyPtr, key.length,
+              metadataPtr, metadata.length, expectedPtr, out,
+              md5Ptr.cast<Utf8>()) ==
+          1;
+      return CacheIngestResult(
+        success: ok,
+        statusCode: out[0],
+        size: out[1],
+        checksum: ok ? md5Ptr.cast<Utf8>().toDartString() : '',
+      );
+    } finally {
+      malloc.free(urlPtr);
+      malloc.free(pathPtr);
+      malloc.free(keyPtr);
+      malloc.free(metadataPtr);
+      malloc.free(out);
+      malloc.free(md5Ptr);
+      if (expectedPtr != nullptr) malloc.free(expectedPtr);
+    }
+  }
+}
@@ -0,0 +1,214 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _OpenNative = Pointer<Void> Function(Pointer<Utf8>, Pointer<Utf8>);
+typedef _OpenDart = Pointer<Void> Function(Pointer<Utf8>, Pointer<Utf8>);
+typedef _HandleNative = Void Function(Pointer<Void>);
+typedef _HandleDart = void Function(Pointer<Void>);
+typedef _KeyNative = Void Function(Pointer<Void>, Pointer<Utf8>);
+typedef _KeyDart = void Function(Pointer<Void>, Pointer<Utf8>);
+typedef _SetBudgetNative = Void Function(Pointer<Void>, Int64, Int32);
+typedef _SetBudgetDart = void Function(Pointer<Void>, int, int);
+typedef _EvictNative = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _EvictDart = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _StatsNative = Void Function(Pointer<Void>, Pointer<Int64>);
+typedef _StatsDart = void Function(Pointer<Void>, Pointer<Int64>);
+typedef _SourceCountNative = Int64 Function(Pointer<Void>, Pointer<Utf8>);
+typedef _SourceCountDart = int Function(Pointer<Void>, Pointer<Utf8>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : open = lib.lookupFunction<_OpenNative, _OpenDart>(
+            'cyrene_cache_manager_open'),
+        close = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_cache_manager_close'),
+        insert = lib.lookupFunction<_KeyNative, _KeyDart>(
+            'cyrene_cache_manager_insert'),
+        touch = lib.lookupFunction<_KeyNative, _KeyDart>(
+            'cyrene_cache_manager_touch'),
+        erase = lib.lookupFunction<_KeyNative, _KeyDart>(
+            'cyrene_cache_manager_erase'),
+        clear = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_cache_manager_clear'),
+        setBudget = lib.lookupFunction<_SetBudgetNative, _SetBudgetDart>(
+            'cyrene_cache_manager_set_budget'),
+        evict = lib.lookupFunction<_EvictNative, _EvictDart>(
+            'cyrene_cache_manager_evict'),
+        stats = lib.lookupFunction<_StatsNative, _StatsDart>(
+            'cyrene_cache_manager_stats', isLeaf: true),
+        sourceCount = lib.lookupFunction<_SourceCountNative, _SourceCountDart>(
+            'cyrene_cache_manager_source_count', isLeaf: true);
+
+  final _OpenDart open;
+  final _HandleDart close;
+  final _KeyDart insert;
+  final _KeyDart touch;
+  final _KeyDart erase;
+  final _HandleDart clear;
+  final _SetBudgetDart setBudget;
+  final _EvictDart evict;
+  final _StatsDart stats;
+  final _SourceCountDart sourceCount;
+}
+
+/// 缓存淘汰策略（与 native/cache_manager.h 的 EvictionPolicy 对应）
+enum CacheEvictionPolicy {
+  /// 最久未播放的先淘汰
+  lru,
+
+  /// 播放次数最少的先淘汰（次数按 14 天半衰期衰减）
+  lfu,
+
+  /// 自适应替换（ARC），在“最近播放”和“经常播放”之间自动平衡
+  arc,
+}
+
+/// 缓存管理器的计数器
+class CacheManagerStats {
+  const CacheManagerStats({
+    required this.totalSize,
+    required this.totalFiles,
+    required this.evictedFiles,
+    required this.evictedSize,
+    required this.sweptFiles,
+    required this.sweptSize,
+  });
+
+  final int totalSize;
+  final int totalFiles;
+
+  /// 本次启动以来淘汰的歌曲
+  final int evictedFiles;
+  final int evictedSize;
+
+  /// 本次启动以来后台清理的残留文件
+  final int sweptFiles;
+  final int sweptSize;
+}
+
+/// 原生缓存管理器（Linux）
+///
+/// 由 native/cache_manager.cc 实现：打开时扫描一次缓存目录，之后按调用方
+/// 报告的写入、播放和删除维护总大小和数量计数器；每首歌的最近播放时间、
+/// 播放次数记录在缓存目录的 cache_access.store 中。超出容量上限时按所选
+/// 策略删除 .cyrene 文件并返回被淘汰的缓存键。低优先级后台线程定期清理
+/// 中断留下的 .part 文件和本应用临时目录（CacheService.tempDirectory，
+/// 不是共用的 /tmp）中的 temp_* 文件。
+class NativeCacheManager {
+  NativeCacheManager._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeCacheManager] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生管理器是否可用
+  static bool get isAvailable => _native != null;
+
+  Pointer<Void> _handle;
+
+  /// 打开 [directory] 的缓存管理器，原生库不可用或打开失败时返回 null
+  static NativeCacheManager? open(String directory, String tempDirectory) {
+    final native = _native;
+    if (native == null) return null;
+
+    final directoryPtr = directory.toNativeUtf8();
+    final tempPtr = tempDirectory.toNativeUtf8();
+    try {
+      final handle = native.open(directoryPtr, tempPtr);
+      if (handle == nullptr) return null;
+      return NativeCacheManager._(handle);
+    } finally {
+      malloc.free(directoryPtr);
+      malloc.free(tempPtr);
+    }
+  }
+
+  /// 记录刚写入的 `<key>.cyrene`（大小从磁盘读取）
+  void insert(String key) => _withKey(key, _native!.insert);
+
+  /// 记录一次缓存命中（播放）
+  void touch(String key) => _withKey(key, _native!.touch);
+
+  /// 忘记一首已被调用方删除的歌曲
+  void erase(String key) => _withKey(key, _native!.erase);
+
+  void clear() => _native!.clear(_handle);
+
+  /// 设置容量上限（字节，0 表示不限）和淘汰策略
+  void setBudget(int bytes, CacheEvictionPolicy policy) =>
+      _native!.setBudget(_handle, bytes, policy.index);
+
+  /// 删除歌曲直到不超过容量上限，返回被淘汰的缓存键
+  List<String> evict() {
+    final lengthPtr = malloc<Int64>();
+    try {
+      final data = _native!.evict(_handle, lengthPtr);
+      if (data == nullptr || lengthPtr.value == 0) return const [];
+      final text = utf8.decode(data.asTypedList(lengthPtr.value),
+          allowMalformed: true);
+      return text.split('\u0000')..removeLast();
+    } finally {
+      malloc.free(lengthPtr);
+    }
+  }
+
+  CacheManagerStats get stats {
+    final out = malloc<Int64>(6);
+    try {
+      _native!.stats(_handle, out);
+      return CacheManagerStats(
+        totalSize: out[0],
+        totalFiles: out[1],
+        evictedFiles: out[2],
+        evictedSize: out[3],
+        sweptFiles: out[4],
+        sweptSize: out[5],
+      );
+    } finally {
+      malloc.free(out);
+    }
+  }
+
+  /// 某个来源（netease / qq / kugou）的已缓存歌曲数
+  int sourceCount(String source) {
+    final sourcePtr = source.toNativeUtf8();
+    try {
+      return _native!.sourceCount(_handle, sourcePtr);
+    } finally {
+      malloc.free(sourcePtr);
+    }
+  }
+
+  /// 落盘并关闭，之后不能再使用该实例
+  void close() {
+    if (_handle == nullptr) return;
+    _native!.close(_handle);
+    _handle = nullptr;
+  }
+
+  void _withKey(String key, void Function(Pointer<Void>, Pointer<Utf8>) call) {
+    final keyPtr = key.toNativeUtf8();
+    try {
+      call(_handle, keyPtr);
+    } finally {
+      malloc.free(keyPtr);
+    }
+  }
+}
@@ -0,0 +1,162 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _OpenNative = Pointer<Void> Function(Pointer<Utf8>, Pointer<Uint8>, Int32);
+typedef _OpenDart = Pointer<Void> Function(Pointer<Utf8>, Pointer<Uint8>, int);
+typedef _CloseNative = Void Function(Pointer<Void>);
+typedef _CloseDart = void Function(Pointer<Void>);
+typedef _VersionNative = Int32 Function(Pointer<Void>);
+typedef _VersionDart = int Function(Pointer<Void>);
+typedef _AudioSizeNative = Int64 Function(Pointer<Void>);
+typedef _AudioSizeDart = int Function(Pointer<Void>);
+typedef _MetadataLengthNative = Int32 Function(Pointer<Void>);
+typedef _MetadataLengthDart = int Function(Pointer<Void>);
+typedef _CopyMetadataNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Int32);
+typedef _CopyMetadataDart = int Function(Pointer<Void>, Pointer<Uint8>, int);
+typedef _ReadNative = Int64 Function(Pointer<Void>, Int64, Pointer<Uint8>, Int64);
+typedef _ReadDart = int Function(Pointer<Void>, int, Pointer<Uint8>, int);
+typedef _VerifyNative = Int64 Function(Pointer<Void>);
+typedef _VerifyDart = int Function(Pointer<Void>);
+typedef _ExtractNative = Int32 Function(Pointer<Utf8>, Pointer<Uint8>, Int32, Pointer<Utf8>);
+typedef _ExtractDart = int Function(Pointer<Utf8>, Pointer<Uint8>, int, Pointer<Utf8>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : open = lib.lookupFunction<_OpenNative, _OpenDart>('cyrene_file_open'),
+        close = lib.lookupFunction<_CloseNative, _CloseDart>('cyrene_file_close'),
+        version = lib.lookupFunction<_VersionNative, _VersionDart>(
+            'cyrene_file_version', isLeaf: true),
+        audioSize = lib.lookupFunction<_AudioSizeNative, _AudioSizeDart>(
+            'cyrene_file_audio_size', isLeaf: true),
+        metadataLength = lib.lookupFunction<_MetadataLengthNative, _MetadataLengthDart>(
+            'cyrene_file_metadata_length', isLeaf: true),
+        copyMetadata = lib.lookupFunction<_CopyMetadataNative, _CopyMetadataDart>(
+            'cyrene_file_copy_metadata', isLeaf: true),
+        read = lib.lookupFunction<_ReadNative, _ReadDart>(
+            'cyrene_file_read', isLeaf: true),
+        verify = lib.lookupFunction<_VerifyNative, _VerifyDart>('cyrene_file_verify'),
+        extract = lib.lookupFunction<_ExtractNative, _ExtractDart>('cyrene_file_extract');
+
+  final _OpenDart open;
+  final _CloseDart close;
+  final _VersionDart version;
+  final _AudioSizeDart audioSize;
+  final _MetadataLengthDart metadataLength;
+  final _CopyMetadataDart copyMetadata;
+  final _ReadDart read;
+  final _VerifyDart verify;
+  final _ExtractDart extract;
+}
+
+/// 原生 .cyrene 文件读取器
+///
+/// 由 native/cyrene_file.cc 实现：文件通过 mmap 映射，音频数据在读取时
+/// 按偏移即时解密，播放缓存歌曲无需把整首歌读入内存，也无需写临时文件。
+/// 同时支持 v1 单块格式和 v2 / v3 分块格式（读取时按块校验 CRC32C）。
+/// v3 以 AES-CTR 加密，需要 16 / 32 字节的安装密钥；传入这样的密钥时，
+/// v1 / v2 文件用内置的 XOR 密钥解密。
+class NativeCyreneFile {
+  NativeCyreneFile._(this._handle);
+
+  /// [read] 的返回值：v2 / v3 文件中有数据块校验失败
+  static const int corrupt = -2;
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeCyreneFile] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生读取器是否可用
+  static bool get isAvailable => _native != null;
+
+  Pointer<Void> _handle;
+
+  /// 打开 .cyrene 文件，失败时返回 null
+  static NativeCyreneFile? open(String filePath, Uint8List key) {
+    final native = _native;
+    if (native == null) return null;
+
+    final pathPtr = filePath.toNativeUtf8();
+    final keyPtr = _copyToNative(key);
+    try {
+      final handle = native.open(pathPtr, keyPtr, key.length);
+      if (handle == nullptr) return null;
+      return NativeCyreneFile._(handle);
+    } finally {
+      malloc.free(pathPtr);
+      malloc.free(keyPtr);
+    }
+  }
+
+  /// 容器格式版本（1、2 或 3）
+  int get version => _native!.version(_handle);
+
+  /// 解密后的音频数据大小
+  int get audioSize => _native!.audioSize(_handle);
+
+  /// 元数据 JSON
+  String get metadataJson {
+    final length = _native!.metadataLength(_handle);
+    if (length <= 0) return '';
+    final buffer = Uint8List(length);
+    final copied = _native!.copyMetadata(_handle, buffer.address, length);
+    return utf8.decode(Uint8List.sublistView(buffer, 0, copied));
+  }
+
+  /// 从音频偏移 [offset] 处解密读取数据到 [buffer]
+  ///
+  /// 返回实际读取的字节数；到达末尾返回 0，数据块损坏返回 [corrupt]。
+  int read(int offset, Uint8List buffer) {
+    return _native!.read(_handle, offset, buffer.address, buffer.length);
+  }
+
+  /// 校验全部数据块，返回第一个损坏块的序号，完好（或 v1 文件）返回 -1
+  int verify() => _native!.verify(_handle);
+
+  /// 关闭文件（重复调用无副作用）
+  void close() {
+    if (_handle == nullptr) return;
+    _native!.close(_handle);
+    _handle = nullptr;
+  }
+
+  /// 将 .cyrene 文件的音频数据分块解密写入 [outputPath]
+  static bool extract(String filePath, Uint8List key, String outputPath) {
+    final native = _native;
+    if (native == null) return false;
+
+    final pathPtr = filePath.toNativeUtf8();
+    final outputPtr = outputPath.toNativeUtf8();
+    final keyPtr = _copyToNative(key);
+    try {
+      return native.extract(pathPtr, keyPtr, key.length, outputPtr) == 1;
+    } finally {
+      malloc.free(pathPtr);
+      malloc.free(outputPtr);
+      malloc.free(keyPtr);
+    }
+  }
+
+  static Pointer<Uint8> _copyToNative(Uint8List bytes) {
+    final ptr = malloc<Uint8>(bytes.isEmpty ? 1 : bytes.length);
+    ptr.asTypedList(bytes.length).setAll(0, bytes);
+    return ptr;
+  }
+}
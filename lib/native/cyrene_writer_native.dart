@@ -0,0 +1,141 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _OpenNative = Pointer<Void> Function(
+    Pointer<Utf8>, Pointer<Uint8>, Int32, Pointer<Uint8>, Int32, Int32);
+typedef _OpenDart = Pointer<Void> Function(
+    Pointer<Utf8>, Pointer<Uint8>, int, Pointer<Uint8>, int, int);
+typedef _AppendNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Int64);
+typedef _AppendDart = int Function(Pointer<Void>, Pointer<Uint8>, int);
+typedef _FinishNative = Int32 Function(Pointer<Void>);
+typedef _FinishDart = int Function(Pointer<Void>);
+typedef _AbortNative = Void Function(Pointer<Void>);
+typedef _AbortDart = void Function(Pointer<Void>);
+typedef _UpgradeNative = Int32 Function(Pointer<Utf8>, Pointer<Uint8>, Int32);
+typedef _UpgradeDart = int Function(Pointer<Utf8>, Pointer<Uint8>, int);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : open = lib.lookupFunction<_OpenNative, _OpenDart>('cyrene_writer_open'),
+        append = lib.lookupFunction<_AppendNative, _AppendDart>(
+            'cyrene_writer_append', isLeaf: true),
+        finish = lib.lookupFunction<_FinishNative, _FinishDart>('cyrene_writer_finish'),
+        abort = lib.lookupFunction<_AbortNative, _AbortDart>('cyrene_writer_abort'),
+        upgrade = lib.lookupFunction<_UpgradeNative, _UpgradeDart>('cyrene_writer_upgrade');
+
+  final _OpenDart open;
+  final _AppendDart append;
+  final _FinishDart finish;
+  final _AbortDart abort;
+  final _UpgradeDart upgrade;
+}
+
+/// 原生 .cyrene v2 / v3 写入器
+///
+/// 由 native/cyrene_writer.cc 实现：音频按固定大小分块加密写入，
+/// 文件末尾附带块索引（偏移 + CRC32C），先写入 `.part` 文件，
+/// 完成后原子重命名。16 / 32 字节的密钥写入 v3（AES-CTR），
+/// 其他密钥写入 v2（XOR）。
+class NativeCyreneWriter {
+  NativeCyreneWriter._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeCyreneWriter] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生写入器是否可用
+  static bool get isAvailable => _native != null;
+
+  Pointer<Void> _handle;
+
+  /// 创建写入器，[blockSize] 为 0 时使用默认块大小（256 KB）
+  static NativeCyreneWriter? open(
+    String filePath,
+    Uint8List key,
+    Uint8List metadata, {
+    int blockSize = 0,
+  }) {
+    final native = _native;
+    if (native == null) return null;
+
+    final pathPtr = filePath.toNativeUtf8();
+    final keyPtr = malloc<Uint8>(key.isEmpty ? 1 : key.length);
+    final metadataPtr = malloc<Uint8>(metadata.isEmpty ? 1 : metadata.length);
+    try {
+      keyPtr.asTypedList(key.length).setAll(0, key);
+      metadataPtr.asTypedList(metadata.length).setAll(0, metadata);
+      final handle = native.open(
+        pathPtr,
+        keyPtr,
+        key.length,
+        metadataPtr,
+        metadata.length,
+        blockSize,
+      );
+      if (handle == nullptr) return null;
+      return NativeCyreneWriter._(handle);
+    } finally {
+      malloc.free(pathPtr);
+      malloc.free(keyPtr);
+      malloc.free(metadataPtr);
+    }
+  }
+
+  /// 追加明文音频数据（[data] 不会被修改）
+  bool append(Uint8List data) {
+    if (_handle == nullptr) return false;
+    if (data.isEmpty) return true;
+    return _native!.append(_handle, data.address, data.length) == 1;
+  }
+
+  /// 写入索引并原子重命名到目标路径，之后写入器不可再用
+  bool finish() {
+    if (_handle == nullptr) return false;
+    final ok = _native!.finish(_handle) == 1;
+    _handle = nullptr;
+    return ok;
+  }
+
+  /// 放弃写入并删除 `.part` 文件
+  void abort() {
+    if (_handle == nullptr) return;
+    _native!.abort(_handle);
+    _handle = nullptr;
+  }
+
+  /// 把 v1 / v2 缓存文件就地重写为 v3（AES-CTR，[key] 为 16 / 32 字节）
+  ///
+  /// 新文件写完才替换原文件；已是 v3 时直接返回 true，文件损坏时返回 false
+  /// 且原文件不变。读写整首歌，应在后台 isolate 中调用。
+  static bool upgrade(String filePath, Uint8List key) {
+    final native = _native;
+    if (native == null || key.isEmpty) return false;
+
+    final pathPtr = filePath.toNativeUtf8();
+    final keyPtr = malloc<Uint8>(key.length);
+    try {
+      keyPtr.asTypedList(key.length).setAll(0, key);
+      return native.upgrade(pathPtr, keyPtr, key.length) == 1;
+    } finally {
+      malloc.free(pathPtr);
+      malloc.free(keyPtr);
+    }
+  }
+}
@@ -0,0 +1,161 @@
+import 'dart:ffi';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _AddNative = Int64 Function(
+    Pointer<Utf8>, Pointer<Utf8>, Pointer<Utf8>, Pointer<Utf8>);
+typedef _AddDart = int Function(
+    Pointer<Utf8>, Pointer<Utf8>, Pointer<Utf8>, Pointer<Utf8>);
+typedef _ProgressNative = Int32 Function(Int64, Pointer<Int64>, Pointer<Utf8>);
+typedef _ProgressDart = int Function(int, Pointer<Int64>, Pointer<Utf8>);
+typedef _IdNative = Void Function(Int64);
+typedef _IdDart = void Function(int);
+typedef _SetLimitsNative = Void Function(Int32, Int32);
+typedef _SetLimitsDart = void Function(int, int);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : add = lib.lookupFunction<_AddNative, _AddDart>('cyrene_download_add'),
+        progress = lib.lookupFunction<_ProgressNative, _ProgressDart>(
+            'cyrene_download_progress'),
+        cancel =
+            lib.lookupFunction<_IdNative, _IdDart>('cyrene_download_cancel'),
+        remove =
+            lib.lookupFunction<_IdNative, _IdDart>('cyrene_download_remove'),
+        setLimits = lib.lookupFunction<_SetLimitsNative, _SetLimitsDart>(
+            'cyrene_download_set_limits');
+
+  final _AddDart add;
+  final _ProgressDart progress;
+  final _IdDart cancel;
+  final _IdDart remove;
+  final _SetLimitsDart setLimits;
+}
+
+/// 下载任务状态（与 native/download_engine.h 的 DownloadState 对应）
+enum NativeDownloadState { queued, running, verifying, done, failed, cancelled }
+
+/// 下载任务的一次进度快照
+class NativeDownloadProgress {
+  const NativeDownloadProgress({
+    required this.state,
+    required this.received,
+    required this.total,
+    required this.bytesPerSecond,
+    required this.httpStatus,
+    required this.md5,
+  });
+
+  final NativeDownloadState state;
+
+  /// 已写入磁盘的字节数（包括续传前已有的部分）
+  final int received;
+
+  /// 文件总大小，未知时为 0
+  final int total;
+
+  /// 本次运行的平均速度
+  final int bytesPerSecond;
+
+  /// 最近一次响应的 HTTP 状态码
+  final int httpStatus;
+
+  /// 完成后文件的 MD5（小写十六进制），否则为空
+  final String md5;
+
+  bool get isFinished =>
+      state == NativeDownloadState.done ||
+      state == NativeDownloadState.failed ||
+      state == NativeDownloadState.cancelled;
+}
+
+/// 原生分段下载引擎（Linux）
+///
+/// 由 native/download_engine.cc 实现：按 1 MB 分段并发 Range 请求，连接池
+/// 复用，分段位图持久化到 `<文件>.part.state`，中断或崩溃后从已完成的分段
+/// 续传；掉线只重试该分段剩余部分，完成后校验 MD5 再原子重命名。所有任务
+/// 共用一个全局调度器（总连接数和单任务连接数上限，先加入的先服务）。
+/// 调用均不阻塞，可在 UI isolate 中轮询进度。
+class NativeDownloadEngine {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeDownloadEngine] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生引擎是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 把 [url] 下载到 [filePath]，返回任务 id（失败时为 0）
+  ///
+  /// 同一路径留有未完成的分段时自动续传。给出 [expectedMd5] 时校验不符
+  /// 的文件会被删除。
+  static int start(
+    String url,
+    String filePath, {
+    String? referer,
+    String? expectedMd5,
+  }) {
+    final native = _native;
+    if (native == null) return 0;
+
+    final urlPtr = url.toNativeUtf8();
+    final pathPtr = filePath.toNativeUtf8();
+    final refererPtr = referer == null ? nullptr : referer.toNativeUtf8();
+    final md5Ptr = expectedMd5 == null ? nullptr : expectedMd5.toNativeUtf8();
+    try {
+      return native.add(urlPtr, pathPtr, refererPtr, md5Ptr);
+    } finally {
+      malloc.free(urlPtr);
+      malloc.free(pathPtr);
+      if (refererPtr != nullptr) malloc.free(refererPtr);
+      if (md5Ptr != nullptr) malloc.free(md5Ptr);
+    }
+  }
+
+  /// 查询任务进度，任务不存在时返回 null
+  static NativeDownloadProgress? progress(int id) {
+    final native = _native;
+    if (native == null) return null;
+
+    final out = malloc<Int64>(5);
+    final md5Ptr = malloc<Uint8>(33);
+    try {
+      if (native.progress(id, out, md5Ptr.cast<Utf8>()) == 0) return null;
+      return NativeDownloadProgress(
+        state: NativeDownloadState.values[out[0]],
+        received: out[1],
+        total: out[2],
+        bytesPerSecond: out[3],
+        httpStatus: out[4],
+        md5: md5Ptr.cast<Utf8>().toDartString(),
+      );
+    } finally {
+      malloc.free(out);
+      malloc.free(md5Ptr);
+    }
+  }
+
+  /// 停止任务，保留已下载的分段供之后续传
+  static void cancel(int id) => _native?.cancel(id);
+
+  /// 释放已结束的任务
+  static void remove(int id) => _native?.remove(id);
+
+  /// 设置全局并发连接数和单个任务的连接数上限
+  static void setLimits({required int connections, required int perTask}) =>
+      _native?.setLimits(connections, perTask);
+}
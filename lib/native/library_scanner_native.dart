@@ -0,0 +1,199 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _ScanNative = Pointer<Void> Function(Pointer<Utf8>, Pointer<Utf8>, Int32);
+typedef _ScanDart = Pointer<Void> Function(Pointer<Utf8>, Pointer<Utf8>, int);
+typedef _ReadNative = Pointer<Void> Function(Pointer<Uint8>, Int64);
+typedef _ReadDart = Pointer<Void> Function(Pointer<Uint8>, int);
+typedef _DataNative = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _DataDart = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _FreeDart = void Function(Pointer<Void>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : scan = lib.lookupFunction<_ScanNative, _ScanDart>('cyrene_library_scan'),
+        read = lib.lookupFunction<_ReadNative, _ReadDart>('cyrene_library_read'),
+        data = lib.lookupFunction<_DataNative, _DataDart>(
+            'cyrene_library_scan_data', isLeaf: true),
+        free = lib.lookupFunction<_FreeNative, _FreeDart>('cyrene_library_scan_free');
+
+  final _ScanDart scan;
+  final _ReadDart read;
+  final _DataDart data;
+  final _FreeDart free;
+}
+
+/// 扫描得到的单个音频文件（标签缺失时对应字段为空字符串）
+class ScannedTrack {
+  final String path;
+  final String title;
+  final String artist;
+  final String album;
+
+  /// 同名 .lrc 歌词路径（同目录或 Lyrics 子目录），没有时为空字符串
+  final String lyricPath;
+
+  /// 时长（毫秒），无法从文件头得出时为 0
+  final int durationMs;
+
+  const ScannedTrack({
+    required this.path,
+    required this.title,
+    required this.artist,
+    required this.album,
+    required this.lyricPath,
+    required this.durationMs,
+  });
+}
+
+/// 一次扫描的结果
+class LibraryScanResult {
+  final List<ScannedTrack> tracks;
+
+  /// 本次实际读取了文件头的文件数
+  final int parsed;
+
+  /// 直接复用索引（inode、修改时间、大小均未变）的文件数
+  final int reused;
+
+  /// 遍历的目录数
+  final int directories;
+
+  const LibraryScanResult({
+    required this.tracks,
+    required this.parsed,
+    required this.reused,
+    required this.directories,
+  });
+}
+
+/// 原生本地音乐库扫描器
+///
+/// 由 native/library_scanner.cc 实现：多线程（工作窃取）遍历目录，只读取
+/// 文件头解析 ID3v2/ID3v1、FLAC、Ogg Vorbis/Opus、MP4、WAV 的标签与时长。
+/// [indexPath] 处保存 (inode, mtime, size) 索引，重新扫描时未变化的文件
+/// 不会再被打开。调用是阻塞的，应在后台 isolate 中执行。
+class NativeLibraryScanner {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeLibraryScanner] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生扫描器是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 递归扫描 [root]，原生库不可用或目录无法打开时返回 null
+  static LibraryScanResult? scan(String root, {String? indexPath, int threads = 0}) {
+    final native = _native;
+    if (native == null) return null;
+
+    final rootPtr = root.toNativeUtf8();
+    final indexPtr = indexPath == null ? nullptr : indexPath.toNativeUtf8();
+    final lengthPtr = malloc<Int64>();
+    Pointer<Void> handle = nullptr;
+    try {
+      handle = native.scan(rootPtr, indexPtr, threads);
+      if (handle == nullptr) return null;
+      final data = native.data(handle, lengthPtr);
+      return _decode(data.asTypedList(lengthPtr.value));
+    } finally {
+      if (handle != nullptr) native.free(handle);
+      malloc.free(rootPtr);
+      if (indexPtr != nullptr) malloc.free(indexPtr);
+      malloc.free(lengthPtr);
+    }
+  }
+
+  /// 读取指定文件（如目录监听报告的新增文件）的标签，原生库不可用时返回 null
+  static LibraryScanResult? readFiles(List<String> paths) {
+    final native = _native;
+    if (native == null) return null;
+
+    // 以 NUL 分隔的 UTF-8 路径
+    final builder = BytesBuilder(copy: false);
+    for (final path in paths) {
+      builder.add(utf8.encode(path));
+      builder.addByte(0);
+    }
+    final bytes = builder.takeBytes();
+    final pathsPtr = malloc<Uint8>(bytes.isEmpty ? 1 : bytes.length);
+    final lengthPtr = malloc<Int64>();
+    Pointer<Void> handle = nullptr;
+    try {
+      pathsPtr.asTypedList(bytes.length).setAll(0, bytes);
+      handle = native.read(pathsPtr, bytes.length);
+      final data = native.data(handle, lengthPtr);
+      return _decode(data.asTypedList(lengthPtr.value));
+    } finally {
+      if (handle != nullptr) native.free(handle);
+      malloc.free(pathsPtr);
+      malloc.free(lengthPtr);
+    }
+  }
+
+  static LibraryScanResult _decode(Uint8List bytes) {
+    final view = ByteData.sublistView(bytes);
+    var offset = 0;
+
+    int readU32() {
+      final value = view.getUint32(offset);
+      offset += 4;
+      return value;
+    }
+
+    String readString() {
+      final length = view.getUint16(offset);
+      offset += 2;
+      final value = utf8.decode(
+          Uint8List.sublistView(bytes, offset, offset + length),
+          allowMalformed: true);
+      offset += length;
+      return value;
+    }
+
+    final count = readU32();
+    final parsed = readU32();
+    final reused = readU32();
+    final directories = readU32();
+    final tracks = List<ScannedTrack>.generate(count, (_) {
+      final path = readString();
+      final title = readString();
+      final artist = readString();
+      final album = readString();
+      final lyricPath = readString();
+      return ScannedTrack(
+        path: path,
+        title: title,
+        artist: artist,
+        album: album,
+        lyricPath: lyricPath,
+        durationMs: readU32(),
+      );
+    }, growable: false);
+
+    return LibraryScanResult(
+      tracks: tracks,
+      parsed: parsed,
+      reused: reused,
+      directories: directories,
+    );
+  }
+}
@@ -0,0 +1,76 @@
+import 'dart:ffi';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _AnalyzeNative = Int32 Function(Pointer<Utf8>, Pointer<Double>);
+typedef _AnalyzeDart = int Function(Pointer<Utf8>, Pointer<Double>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : analyze = lib.lookupFunction<_AnalyzeNative, _AnalyzeDart>(
+            'cyrene_loudness_analyze');
+
+  final _AnalyzeDart analyze;
+}
+
+/// 一次响度测量的结果
+class LoudnessResult {
+  const LoudnessResult({
+    required this.integratedLufs,
+    required this.truePeakDb,
+  });
+
+  /// 门限后的整体响度（LUFS）
+  final double integratedLufs;
+
+  /// 4 倍过采样后的真峰值（dBTP）
+  final double truePeakDb;
+}
+
+/// 原生 EBU R128 响度分析（Linux）
+///
+/// 由 native/loudness.cc 实现：按 ITU-R BS.1770-4 做 K 加权、400 ms 块
+/// 的 -70 LUFS 绝对门限和 -10 LU 相对门限，真峰值按 CPU 选择 AVX2 / SSE2 /
+/// NEON 向量化路径。解码走播放引擎同一套解码器，耗时与整首歌解码相当，
+/// 应在后台 isolate 中调用。
+class NativeLoudness {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeLoudness] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生分析是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 解码 [uri]（本地路径、file:// 或 http://）并测量整首歌
+  ///
+  /// 无法解码或整首都低于门限（静音、不足 400 ms）时返回 null。
+  static LoudnessResult? analyze(String uri) {
+    final native = _native;
+    if (native == null) return null;
+
+    final uriPtr = uri.toNativeUtf8();
+    final out = malloc<Double>(2);
+    try {
+      if (native.analyze(uriPtr, out) == 0) return null;
+      return LoudnessResult(integratedLufs: out[0], truePeakDb: out[1]);
+    } finally {
+      malloc.free(uriPtr);
+      malloc.free(out);
+    }
+  }
+}
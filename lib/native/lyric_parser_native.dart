@@ -0,0 +1,161 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import '../models/lyric_line.dart';
+import 'native_library.dart';
+
+typedef _ParseNative = Pointer<Void> Function(
+    Pointer<Uint8>, Int64, Pointer<Uint8>, Int64);
+typedef _ParseDart = Pointer<Void> Function(
+    Pointer<Uint8>, int, Pointer<Uint8>, int);
+typedef _DestroyNative = Void Function(Pointer<Void>);
+typedef _DestroyDart = void Function(Pointer<Void>);
+typedef _CountNative = Int32 Function(Pointer<Void>);
+typedef _CountDart = int Function(Pointer<Void>);
+typedef _TextNative = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _TextDart = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _Int64ArrayNative = Pointer<Int64> Function(Pointer<Void>);
+typedef _Int32ArrayNative = Pointer<Int32> Function(Pointer<Void>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : parse = lib.lookupFunction<_ParseNative, _ParseDart>('cyrene_lyrics_parse'),
+        destroy = lib.lookupFunction<_DestroyNative, _DestroyDart>('cyrene_lyrics_destroy'),
+        lineCount = lib.lookupFunction<_CountNative, _CountDart>(
+            'cyrene_lyrics_line_count', isLeaf: true),
+        wordCount = lib.lookupFunction<_CountNative, _CountDart>(
+            'cyrene_lyrics_word_count', isLeaf: true),
+        text = lib.lookupFunction<_TextNative, _TextDart>(
+            'cyrene_lyrics_text', isLeaf: true),
+        startTimes = lib.lookupFunction<_Int64ArrayNative, _Int64ArrayNative>(
+            'cyrene_lyrics_start_times', isLeaf: true),
+        textRanges = lib.lookupFunction<_Int32ArrayNative, _Int32ArrayNative>(
+            'cyrene_lyrics_text_ranges', isLeaf: true),
+        wordIndex = lib.lookupFunction<_Int32ArrayNative, _Int32ArrayNative>(
+            'cyrene_lyrics_word_index', isLeaf: true),
+        wordTimes = lib.lookupFunction<_Int64ArrayNative, _Int64ArrayNative>(
+            'cyrene_lyrics_word_times', isLeaf: true),
+        wordRanges = lib.lookupFunction<_Int32ArrayNative, _Int32ArrayNative>(
+            'cyrene_lyrics_word_ranges', isLeaf: true);
+
+  final _ParseDart parse;
+  final _DestroyDart destroy;
+  final _CountDart lineCount;
+  final _CountDart wordCount;
+  final _TextDart text;
+  final _Int64ArrayNative startTimes;
+  final _Int32ArrayNative textRanges;
+  final _Int32ArrayNative wordIndex;
+  final _Int64ArrayNative wordTimes;
+  final _Int32ArrayNative wordRanges;
+}
+
+/// 原生歌词解析器
+///
+/// 由 native/lyric_parser.cc 实现：单次扫描解析 LRC（含多时间戳）、
+/// 逐字 YRC / QRC，按时间排序并按时间合并翻译。结果以扁平数组返回，
+/// 这里一次性读出并转换为 [LyricLine]。
+class NativeLyricParser {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeLyricParser] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生解析器是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 解析 [lyric]（及可选的 LRC 翻译），原生库不可用时返回 null
+  static List<LyricLine>? parse(String lyric, {String? translation}) {
+    final native = _native;
+    if (native == null) return null;
+
+    final lyricBytes = utf8.encode(lyric);
+    final translationBytes = utf8.encode(translation ?? '');
+    final lyricPtr = malloc<Uint8>(lyricBytes.isEmpty ? 1 : lyricBytes.length);
+    final translationPtr =
+        malloc<Uint8>(translationBytes.isEmpty ? 1 : translationBytes.length);
+    Pointer<Void> handle = nullptr;
+    try {
+      lyricPtr.asTypedList(lyricBytes.length).setAll(0, lyricBytes);
+      translationPtr
+          .asTypedList(translationBytes.length)
+          .setAll(0, translationBytes);
+      handle = native.parse(lyricPtr, lyricBytes.length, translationPtr,
+          translationBytes.length);
+      if (handle == nullptr) return null;
+      return _readLines(native, handle);
+    } finally {
+      if (handle != nullptr) native.destroy(handle);
+      malloc.free(lyricPtr);
+      malloc.free(translationPtr);
+    }
+  }
+
+  static List<LyricLine> _readLines(_Bindings native, Pointer<Void> handle) {
+    final lineCount = native.lineCount(handle);
+    if (lineCount == 0) return [];
+    final wordCount = native.wordCount(handle);
+
+    final lengthPtr = malloc<Int64>();
+    final Uint8List text;
+    try {
+      final textPtr = native.text(handle, lengthPtr);
+      text = textPtr.asTypedList(lengthPtr.value);
+    } finally {
+      malloc.free(lengthPtr);
+    }
+    final startTimes = native.startTimes(handle).asTypedList(lineCount);
+    final textRanges = native.textRanges(handle).asTypedList(lineCount * 4);
+    final wordIndex = native.wordIndex(handle).asTypedList(lineCount + 1);
+    final wordTimes = wordCount == 0
+        ? Int64List(0)
+        : native.wordTimes(handle).asTypedList(wordCount * 2);
+    final wordRanges = wordCount == 0
+        ? Int32List(0)
+        : native.wordRanges(handle).asTypedList(wordCount * 2);
+
+    String decode(int begin, int end) => utf8.decode(
+        Uint8List.sublistView(text, begin, end),
+        allowMalformed: true);
+
+    final lines = List<LyricLine>.generate(lineCount, (i) {
+      final translationBegin = textRanges[i * 4 + 2];
+      final translationEnd = textRanges[i * 4 + 3];
+      final firstWord = wordIndex[i];
+      final lastWord = wordIndex[i + 1];
+      return LyricLine(
+        startTime: Duration(milliseconds: startTimes[i]),
+        text: decode(textRanges[i * 4], textRanges[i * 4 + 1]),
+        translation: translationEnd > translationBegin
+            ? decode(translationBegin, translationEnd)
+            : null,
+        words: lastWord > firstWord
+            ? List<LyricWord>.generate(lastWord - firstWord, (j) {
+                final w = firstWord + j;
+                return LyricWord(
+                  startTime: Duration(milliseconds: wordTimes[w * 2]),
+                  duration: Duration(milliseconds: wordTimes[w * 2 + 1]),
+                  text: decode(wordRanges[w * 2], wordRanges[w * 2 + 1]),
+                );
+              }, growable: false)
+            : null,
+      );
+    }, growable: true);
+    return lines;
+  }
+}
@@ -0,0 +1,36 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'package:path/path.dart' as path;
+
+/// Cyrene 原生库加载器
+///
+/// `libcyrene_native.so` 由 Linux 构建（native/CMakeLists.txt）生成，
+/// 随应用一起安装到 bundle 的 lib/ 目录。其他平台或加载失败时返回 null，
+/// 调用方应回退到纯 Dart 实现。
+class NativeLibrary {
+  static DynamicLibrary? _library;
+  static bool _loadAttempted = false;
+
+  /// 已加载的原生库（不可用时为 null）
+  static DynamicLibrary? get instance {
+    if (_loadAttempted) return _library;
+    _loadAttempted = true;
+
+    if (!Platform.isLinux) return null;
+
+    try {
+      final executableDir = path.dirname(Platform.resolvedExecutable);
+      _library = DynamicLibrary.open(
+        path.join(executableDir, 'lib', 'libcyrene_native.so'),
+      );
+      print('✅ [NativeLibrary] 原生库已加载');
+    } catch (e) {
+      print('⚠️ [NativeLibrary] 原生库不可用，使用 Dart 实现: $e');
+      _library = null;
+    }
+    return _library;
+  }
+
+  /// 原生库是否可用
+  static bool get isAvailable => instance != null;
+}
@@ -0,0 +1,127 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'dart:ui' show Color, Rect;
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _ExtractNative = Int32 Function(
+    Pointer<Uint8>, Int64, Double, Double, Double, Double, Pointer<Uint32>);
+typedef _ExtractDart = int Function(
+    Pointer<Uint8>, int, double, double, double, double, Pointer<Uint32>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : extract = lib.lookupFunction<_ExtractNative, _ExtractDart>(
+            'cyrene_palette_extract');
+
+  final _ExtractDart extract;
+}
+
+/// 一组调色板颜色（与 PaletteGenerator 的目标一致，缺失时为 null）
+class CoverSwatches {
+  final Color? vibrant;
+  final Color? darkVibrant;
+  final Color? lightVibrant;
+  final Color? muted;
+  final Color? darkMuted;
+  final Color? lightMuted;
+  final Color? dominant;
+
+  const CoverSwatches({
+    this.vibrant,
+    this.darkVibrant,
+    this.lightVibrant,
+    this.muted,
+    this.darkMuted,
+    this.lightMuted,
+    this.dominant,
+  });
+
+  /// 按 PlayerService 的优先级选出的主题色
+  Color? get themeColor =>
+      vibrant ?? dominant ?? darkVibrant ?? lightVibrant ?? muted;
+
+  /// 由 7 个 ARGB 值创建（顺序同 [toArgbList]，0 表示缺失）
+  factory CoverSwatches.fromArgbList(List<int> argb) {
+    Color? color(int value) => value == 0 ? null : Color(value);
+    return CoverSwatches(
+      vibrant: color(argb[0]),
+      darkVibrant: color(argb[1]),
+      lightVibrant: color(argb[2]),
+      muted: color(argb[3]),
+      darkMuted: color(argb[4]),
+      lightMuted: color(argb[5]),
+      dominant: color(argb[6]),
+    );
+  }
+
+  List<int> toArgbList() => [
+        for (final color in [
+          vibrant, darkVibrant, lightVibrant, muted, darkMuted, lightMuted, dominant,
+        ])
+          color?.value ?? 0,
+      ];
+}
+
+/// 封面调色板：整张图片 + 指定区域
+class CoverPalette {
+  final CoverSwatches full;
+  final CoverSwatches region;
+
+  const CoverPalette({required this.full, required this.region});
+}
+
+/// 原生封面取色
+///
+/// 由 native/palette.cc 实现：JPEG 通过 DCT 缩放直接解码到约 112 像素，
+/// 在 5 位 RGB 直方图上做中位切分，一次遍历同时得到整图与 [region] 的
+/// 调色板。1000×1000 的 JPEG 封面约 3 毫秒。
+class NativePalette {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativePalette] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生取色是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 提取 JPEG/PNG 图片 [bytes] 的调色板
+  ///
+  /// [region] 为相对图片尺寸的比例（0~1）。原生库不可用或无法解码时返回 null。
+  static CoverPalette? extract(Uint8List bytes,
+      {Rect region = const Rect.fromLTRB(0, 0, 1, 1)}) {
+    final native = _native;
+    if (native == null || bytes.isEmpty) return null;
+
+    final dataPtr = malloc<Uint8>(bytes.length);
+    final outPtr = malloc<Uint32>(14);
+    try {
+      dataPtr.asTypedList(bytes.length).setAll(0, bytes);
+      final ok = native.extract(dataPtr, bytes.length, region.left, region.top,
+          region.right, region.bottom, outPtr);
+      if (ok == 0) return null;
+      final out = outPtr.asTypedList(14);
+      return CoverPalette(
+        full: CoverSwatches.fromArgbList(out.sublist(0, 7)),
+        region: CoverSwatches.fromArgbList(out.sublist(7, 14)),
+      );
+    } finally {
+      malloc.free(dataPtr);
+      malloc.free(outPtr);
+    }
+  }
+}
@@ -0,0 +1,262 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _OpenNative = Pointer<Void> Function(Pointer<Utf8>);
+typedef _OpenDart = Pointer<Void> Function(Pointer<Utf8>);
+typedef _HandleNative = Void Function(Pointer<Void>);
+typedef _HandleDart = void Function(Pointer<Void>);
+typedef _PutNative = Int32 Function(
+    Pointer<Void>, Pointer<Uint8>, Int32, Pointer<Uint8>, Int32);
+typedef _PutDart = int Function(
+    Pointer<Void>, Pointer<Uint8>, int, Pointer<Uint8>, int);
+typedef _KeyNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Int32);
+typedef _KeyDart = int Function(Pointer<Void>, Pointer<Uint8>, int);
+typedef _GetNative = Pointer<Uint8> Function(
+    Pointer<Void>, Pointer<Uint8>, Int32, Pointer<Int64>);
+typedef _GetDart = Pointer<Uint8> Function(
+    Pointer<Void>, Pointer<Uint8>, int, Pointer<Int64>);
+typedef _CountNative = Int64 Function(Pointer<Void>);
+typedef _CountDart = int Function(Pointer<Void>);
+typedef _EntriesNative = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _EntriesDart = Pointer<Uint8> Function(Pointer<Void>, Pointer<Int64>);
+typedef _StatusNative = Int32 Function(Pointer<Void>);
+typedef _StatusDart = int Function(Pointer<Void>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : open = lib.lookupFunction<_OpenNative, _OpenDart>('cyrene_store_open'),
+        close = lib.lookupFunction<_HandleNative, _HandleDart>('cyrene_store_close'),
+        put = lib.lookupFunction<_PutNative, _PutDart>(
+            'cyrene_store_put', isLeaf: true),
+        delete = lib.lookupFunction<_KeyNative, _KeyDart>(
+            'cyrene_store_delete', isLeaf: true),
+        get = lib.lookupFunction<_GetNative, _GetDart>(
+            'cyrene_store_get', isLeaf: true),
+        contains = lib.lookupFunction<_KeyNative, _KeyDart>(
+            'cyrene_store_contains', isLeaf: true),
+        count = lib.lookupFunction<_CountNative, _CountDart>(
+            'cyrene_store_count', isLeaf: true),
+        entries = lib.lookupFunction<_EntriesNative, _EntriesDart>('cyrene_store_entries'),
+        clear = lib.lookupFunction<_StatusNative, _StatusDart>('cyrene_store_clear'),
+        checkpoint =
+            lib.lookupFunction<_StatusNative, _StatusDart>('cyrene_store_checkpoint');
+
+  final _OpenDart open;
+  final _HandleDart close;
+  final _PutDart put;
+  final _KeyDart delete;
+  final _GetDart get;
+  final _KeyDart contains;
+  final _CountDart count;
+  final _EntriesDart entries;
+  final _StatusDart clear;
+  final _StatusDart checkpoint;
+}
+
+/// 原生持久化键值存储
+///
+/// 由 native/record_store.cc 实现：只追加的日志文件 + mmap 读取 + 内存哈希
+/// 索引。put/delete 只追加一条记录（O(1)），不会重写整个文件；打开时按
+/// 校验和回放日志，崩溃时写了一半的记录会被丢弃。写入后约 2 秒自动做一次
+/// checkpoint（fdatasync，必要时压缩日志）。
+class NativeRecordStore {
+  NativeRecordStore._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeRecordStore] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生存储是否可用
+  static bool get isAvailable => _native != null;
+
+  static const Duration _checkpointDelay = Duration(seconds: 2);
+
+  Pointer<Void> _handle;
+  Timer? _checkpointTimer;
+
+  /// 打开（不存在时创建）[path] 处的存储，原生库不可用或打开失败时返回 null
+  static NativeRecordStore? open(String path) {
+    final native = _native;
+    if (native == null) return null;
+
+    final pathPtr = path.toNativeUtf8();
+    try {
+      final handle = native.open(pathPtr);
+      if (handle == nullptr) return null;
+      return NativeRecordStore._(handle);
+    } finally {
+      malloc.free(pathPtr);
+    }
+  }
+
+  /// 记录条数
+  int get length => _native!.count(_handle);
+
+  bool contains(String key) {
+    return _withKey(key, (keyPtr, keyLength) =>
+        _native!.contains(_handle, keyPtr, keyLength) != 0);
+  }
+
+  /// [key] 对应的值（拷贝），不存在时返回 null
+  Uint8List? get(String key) {
+    final lengthPtr = malloc<Int64>();
+    try {
+      return _withKey(key, (keyPtr, keyLength) {
+        final value = _native!.get(_handle, keyPtr, keyLength, lengthPtr);
+        if (value == nullptr) return null;
+        return Uint8List.fromList(value.asTypedList(lengthPtr.value));
+      });
+    } finally {
+      malloc.free(lengthPtr);
+    }
+  }
+
+  bool put(String key, Uint8List value) {
+    final ok = _withKey(key, (keyPtr, keyLength) =>
+        _native!.put(_handle, keyPtr, keyLength, value.address, value.length) != 0);
+    _scheduleCheckpoint();
+    return ok;
+  }
+
+  /// 删除 [key]，返回它是否存在
+  bool delete(String key) {
+    final existed = _withKey(key, (keyPtr, keyLength) =>
+        _native!.delete(_handle, keyPtr, keyLength) != 0);
+    if (existed) _scheduleCheckpoint();
+    return existed;
+  }
+
+  /// 所有记录（顺序不固定），值均为拷贝
+  Map<String, Uint8List> entries() {
+    final lengthPtr = malloc<Int64>();
+    try {
+      final data = _native!.entries(_handle, lengthPtr);
+      final result = <String, Uint8List>{};
+      if (data == nullptr || lengthPtr.value == 0) return result;
+
+      final bytes = data.asTypedList(lengthPtr.value);
+      final view = ByteData.sublistView(bytes);
+      var offset = 0;
+      while (offset < bytes.length) {
+        final keyLength = view.getUint32(offset);
+        final key = utf8.decode(
+            Uint8List.sublistView(bytes, offset + 4, offset + 4 + keyLength),
+            allowMalformed: true);
+        offset += 4 + keyLength;
+        final valueLength = view.getUint32(offset);
+        result[key] = Uint8List.fromList(
+            Uint8List.sublistView(bytes, offset + 4, offset + 4 + valueLength));
+        offset += 4 + valueLength;
+      }
+      return result;
+    } finally {
+      malloc.free(lengthPtr);
+    }
+  }
+
+  bool clear() {
+    final ok = _native!.clear(_handle) != 0;
+    _scheduleCheckpoint();
+    return ok;
+  }
+
+  /// 立即把已写入的记录落盘
+  bool checkpoint() {
+    _checkpointTimer?.cancel();
+    _checkpointTimer = null;
+    return _native!.checkpoint(_handle) != 0;
+  }
+
+  /// 落盘并关闭，之后不能再使用该实例
+  void close() {
+    if (_handle == nullptr) return;
+    checkpoint();
+    _native!.close(_handle);
+    _handle = nullptr;
+  }
+
+  void _scheduleCheckpoint() {
+    _checkpointTimer ??= Timer(_checkpointDelay, () {
+      _checkpointTimer = null;
+      if (_handle != nullptr) _native!.checkpoint(_handle);
+    });
+  }
+
+  T _withKey<T>(String key, T Function(Pointer<Uint8> keyPtr, int keyLength) body) {
+    final keyBytes = utf8.encode(key);
+    final keyPtr = malloc<Uint8>(keyBytes.isEmpty ? 1 : keyBytes.length);
+    try {
+      keyPtr.asTypedList(keyBytes.length).setAll(0, keyBytes);
+      return body(keyPtr, keyBytes.length);
+    } finally {
+      malloc.free(keyPtr);
+    }
+  }
+}
+
+/// 存储记录的紧凑二进制编码：字符串为 u32 长度 + UTF-8，整数为 i64（大端）
+class StoreRecordWriter {
+  final BytesBuilder _builder = BytesBuilder();
+  final ByteData _scratch = ByteData(8);
+
+  void writeString(String value) {
+    final bytes = utf8.encode(value);
+    _scratch.setUint32(0, bytes.length);
+    _builder.add(Uint8List.sublistView(_scratch, 0, 4));
+    _builder.add(bytes);
+  }
+
+  void writeInt(int value) {
+    _scratch.setInt64(0, value);
+    _builder.add(Uint8List.sublistView(_scratch, 0, 8));
+  }
+
+  Uint8List takeBytes() => _builder.takeBytes();
+}
+
+/// [StoreRecordWriter] 的读取端，越界时抛出 RangeError
+class StoreRecordReader {
+  StoreRecordReader(this._bytes) : _view = ByteData.sublistView(_bytes);
+
+  final Uint8List _bytes;
+  final ByteData _view;
+  int _offset = 0;
+
+  String readString() {
+    final length = _view.getUint32(_offset);
+    _offset += 4;
+    final value = utf8.decode(
+        Uint8List.sublistView(_bytes, _offset, _offset + length),
+        allowMalformed: true);
+    _offset += length;
+    return value;
+  }
+
+  int readInt() {
+    final value = _view.getInt64(_offset);
+    _offset += 8;
+    return value;
+  }
+
+  /// 是否还有未读的字段（旧版本写入的记录没有后来追加的字段）
+  bool get hasMore => _offset < _bytes.length;
+}
@@ -0,0 +1,221 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _CreateNative = Pointer<Void> Function();
+typedef _CreateDart = Pointer<Void> Function();
+typedef _HandleNative = Void Function(Pointer<Void>);
+typedef _HandleDart = void Function(Pointer<Void>);
+typedef _PutNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Int64,
+    Pointer<Int32>, Pointer<Float>, Int32);
+typedef _PutDart = int Function(
+    Pointer<Void>, Pointer<Uint8>, int, Pointer<Int32>, Pointer<Float>, int);
+typedef _RemoveNative = Int32 Function(
+    Pointer<Void>, Pointer<Uint8>, Int64, Pointer<Int32>, Int32);
+typedef _RemoveDart = int Function(
+    Pointer<Void>, Pointer<Uint8>, int, Pointer<Int32>, int);
+typedef _CountNative = Int64 Function(Pointer<Void>);
+typedef _CountDart = int Function(Pointer<Void>);
+typedef _QueryNative = Int32 Function(Pointer<Void>, Pointer<Uint8>, Int32,
+    Int32, Pointer<Uint8>, Int32, Pointer<Int32>, Pointer<Float>);
+typedef _QueryDart = int Function(Pointer<Void>, Pointer<Uint8>, int, int,
+    Pointer<Uint8>, int, Pointer<Int32>, Pointer<Float>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<_CreateNative, _CreateDart>(
+            'cyrene_search_index_create'),
+        destroy = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_search_index_destroy'),
+        put = lib.lookupFunction<_PutNative, _PutDart>('cyrene_search_index_put'),
+        remove = lib.lookupFunction<_RemoveNative, _RemoveDart>(
+            'cyrene_search_index_remove'),
+        clear = lib.lookupFunction<_HandleNative, _HandleDart>(
+            'cyrene_search_index_clear'),
+        count = lib.lookupFunction<_CountNative, _CountDart>(
+            'cyrene_search_index_count', isLeaf: true),
+        query = lib.lookupFunction<_QueryNative, _QueryDart>(
+            'cyrene_search_index_query', isLeaf: true);
+
+  final _CreateDart create;
+  final _HandleDart destroy;
+  final _PutDart put;
+  final _RemoveDart remove;
+  final _HandleDart clear;
+  final _CountDart count;
+  final _QueryDart query;
+}
+
+/// 索引中的一首歌
+class SearchIndexEntry {
+  const SearchIndexEntry({
+    required this.key,
+    required this.title,
+    required this.artists,
+    required this.album,
+    this.boost = 0,
+  });
+
+  final String key;
+  final String title;
+  final String artists;
+  final String album;
+
+  /// 加到每次命中的得分上（收藏、本地文件排在前面）
+  final double boost;
+}
+
+/// 原生本地搜索索引
+///
+/// 由 native/search_index.cc 实现的内存倒排索引：歌名、歌手、专辑经 NFKC
+/// 折叠与繁转简后分词，中文另外按全拼和首字母展开（"zhoujielun"、
+/// "jielun"、"zjl" 都能找到周杰伦），查询支持前缀和一个字符的拼写错误，
+/// 10 万首歌上一次查询不到 1 毫秒。索引可以在后台 isolate 中通过
+/// [address] 批量写入，查询在主 isolate 上直接调用。
+class NativeSearchIndex {
+  NativeSearchIndex._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeSearchIndex] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生索引是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 一次查询返回的键的总字节上限
+  static const int _keysCapacity = 64 * 1024;
+
+  final Pointer<Void> _handle;
+
+  /// 创建空索引，原生库不可用时返回 null
+  static NativeSearchIndex? create() {
+    final native = _native;
+    if (native == null) return null;
+    final handle = native.create();
+    if (handle == nullptr) return null;
+    return NativeSearchIndex._(handle);
+  }
+
+  /// 在其他 isolate 中访问同一个索引（不转移所有权）
+  static NativeSearchIndex? fromAddress(int address) {
+    if (_native == null || address == 0) return null;
+    return NativeSearchIndex._(Pointer<Void>.fromAddress(address));
+  }
+
+  int get address => _handle.address;
+
+  /// 条目数
+  int get length => _native!.count(_handle);
+
+  /// 写入（按 key 替换）[entries]，返回是否成功
+  bool put(List<SearchIndexEntry> entries) {
+    if (entries.isEmpty) return true;
+    final builder = BytesBuilder(copy: false);
+    final ranges = Int32List(entries.length * 8);
+    for (var i = 0; i < entries.length; i++) {
+      final entry = entries[i];
+      final fields = [entry.key, entry.title, entry.artists, entry.album];
+      for (var f = 0; f < fields.length; f++) {
+        ranges[i * 8 + f * 2] = builder.length;
+        builder.add(utf8.encode(fields[f]));
+        ranges[i * 8 + f * 2 + 1] = builder.length;
+      }
+    }
+    final text = builder.takeBytes();
+
+    final textPtr = malloc<Uint8>(text.isEmpty ? 1 : text.length);
+    final rangesPtr = malloc<Int32>(ranges.length);
+    final boostsPtr = malloc<Float>(entries.length);
+    try {
+      textPtr.asTypedList(text.length).setAll(0, text);
+      rangesPtr.asTypedList(ranges.length).setAll(0, ranges);
+      final boosts = boostsPtr.asTypedList(entries.length);
+      for (var i = 0; i < entries.length; i++) {
+        boosts[i] = entries[i].boost;
+      }
+      return _native!.put(_handle, textPtr, text.length, rangesPtr, boostsPtr,
+              entries.length) ==
+          entries.length;
+    } finally {
+      malloc.free(textPtr);
+      malloc.free(rangesPtr);
+      malloc.free(boostsPtr);
+    }
+  }
+
+  /// 删除 [keys]，返回实际删除的条数
+  int remove(List<String> keys) {
+    if (keys.isEmpty) return 0;
+    final builder = BytesBuilder(copy: false);
+    final ranges = Int32List(keys.length * 2);
+    for (var i = 0; i < keys.length; i++) {
+      ranges[i * 2] = builder.length;
+      builder.add(utf8.encode(keys[i]));
+      ranges[i * 2 + 1] = builder.length;
+    }
+    final text = builder.takeBytes();
+
+    final textPtr = malloc<Uint8>(text.isEmpty ? 1 : text.length);
+    final rangesPtr = malloc<Int32>(ranges.length);
+    try {
+      textPtr.asTypedList(text.length).setAll(0, text);
+      rangesPtr.asTypedList(ranges.length).setAll(0, ranges);
+      return _native!
+          .remove(_handle, textPtr, text.length, rangesPtr, keys.length);
+    } finally {
+      malloc.free(textPtr);
+      malloc.free(rangesPtr);
+    }
+  }
+
+  void clear() => _native!.clear(_handle);
+
+  /// 按得分从高到低返回最多 [limit] 个匹配 [query] 的 key
+  List<String> search(String query, {int limit = 50}) {
+    final queryBytes = utf8.encode(query);
+    if (queryBytes.isEmpty || limit <= 0) return const [];
+
+    final queryPtr = malloc<Uint8>(queryBytes.length);
+    final keysPtr = malloc<Uint8>(_keysCapacity);
+    final endsPtr = malloc<Int32>(limit);
+    try {
+      queryPtr.asTypedList(queryBytes.length).setAll(0, queryBytes);
+      final count = _native!.query(_handle, queryPtr, queryBytes.length, limit,
+          keysPtr, _keysCapacity, endsPtr, nullptr);
+      if (count <= 0) return const [];
+      final ends = endsPtr.asTypedList(count);
+      final bytes = keysPtr.asTypedList(ends[count - 1]);
+      final keys = <String>[];
+      var start = 0;
+      for (var i = 0; i < count; i++) {
+        keys.add(utf8.decode(Uint8List.sublistView(bytes, start, ends[i])));
+        start = ends[i];
+      }
+      return keys;
+    } finally {
+      malloc.free(queryPtr);
+      malloc.free(keysPtr);
+      malloc.free(endsPtr);
+    }
+  }
+
+  /// 释放索引，之后不能再使用
+  void dispose() => _native!.destroy(_handle);
+}
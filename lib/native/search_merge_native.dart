@@ -0,0 +1,95 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import '../models/track.dart';
+import 'native_library.dart';
+
+typedef _GroupNative = Int32 Function(
+    Pointer<Uint8>, Int64, Pointer<Int32>, Pointer<Int32>, Int32, Pointer<Int32>);
+typedef _GroupDart = int Function(
+    Pointer<Uint8>, int, Pointer<Int32>, Pointer<Int32>, int, Pointer<Int32>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : group = lib.lookupFunction<_GroupNative, _GroupDart>(
+            'cyrene_search_group', isLeaf: true);
+
+  final _GroupDart group;
+}
+
+/// 原生跨平台搜索结果合并
+///
+/// 由 native/search_merge.cc 实现：歌名与歌手经 NFKC 折叠（全角/半角、
+/// 大小写）与繁体转简体后，去掉括号、" - " 后缀和 feat. 部分（后缀中的
+/// Live/Remix/伴奏/翻唱 作为版本标记，必须一致），歌名用字符三元组的
+/// MinHash 分桶找候选、Jaccard 相似度判定，歌手至少共享一半。几百条结果
+/// 一次调用不到 1 毫秒。
+class NativeSearchMerger {
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeSearchMerger] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生合并是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 对 [tracks] 分组：返回每首歌所在组第一首歌的下标。
+  /// 同一组内每个平台最多一首（完全相同的重复结果除外）。
+  /// 原生库不可用时返回 null。
+  static List<int>? group(List<Track> tracks) {
+    final native = _native;
+    if (native == null) return null;
+    if (tracks.isEmpty) return const [];
+
+    final builder = BytesBuilder(copy: false);
+    final ranges = Int32List(tracks.length * 4);
+    for (var i = 0; i < tracks.length; i++) {
+      final title = utf8.encode(tracks[i].name);
+      final artists = utf8.encode(tracks[i].artists);
+      ranges[i * 4] = builder.length;
+      builder.add(title);
+      ranges[i * 4 + 1] = builder.length;
+      ranges[i * 4 + 2] = builder.length;
+      builder.add(artists);
+      ranges[i * 4 + 3] = builder.length;
+    }
+    final text = builder.takeBytes();
+
+    final textPtr = malloc<Uint8>(text.isEmpty ? 1 : text.length);
+    final rangesPtr = malloc<Int32>(ranges.length);
+    final sourcesPtr = malloc<Int32>(tracks.length);
+    final groupsPtr = malloc<Int32>(tracks.length);
+    try {
+      textPtr.asTypedList(text.length).setAll(0, text);
+      rangesPtr.asTypedList(ranges.length).setAll(0, ranges);
+      final sources = sourcesPtr.asTypedList(tracks.length);
+      for (var i = 0; i < tracks.length; i++) {
+        sources[i] = tracks[i].source.index;
+      }
+      final count = native.group(
+          textPtr, text.length, rangesPtr, sourcesPtr, tracks.length, groupsPtr);
+      if (count < 0) return null;
+      return List<int>.of(groupsPtr.asTypedList(tracks.length));
+    } finally {
+      malloc.free(textPtr);
+      malloc.free(rangesPtr);
+      malloc.free(sourcesPtr);
+      malloc.free(groupsPtr);
+    }
+  }
+}
@@ -0,0 +1,77 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _StoreNative = Int32 Function(
+    Pointer<Utf8>, Pointer<Uint8>, Int64, Pointer<Utf8>);
+typedef _StoreDart = int Function(
+    Pointer<Utf8>, Pointer<Uint8>, int, Pointer<Utf8>);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : store = lib.lookupFunction<_StoreNative, _StoreDart>(
+            'cyrene_thumbnail_store');
+
+  final _StoreDart store;
+}
+
+/// 原生封面缩略图缓存
+///
+/// 由 native/thumbnail_cache.cc 实现：按原图内容的 SHA-256 存储，每张封面
+/// 生成 512/256/128/64 四级正方形 JPEG（居中裁剪，先面积重采样到 512，
+/// 再逐级 SIMD 2×2 平均），内容相同的封面只处理一次。调用是阻塞的，应在
+/// 后台 isolate 中执行。
+class NativeThumbnailCache {
+  /// 缩略图级别（像素），从大到小
+  static const List<int> levels = [512, 256, 128, 64];
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeThumbnailCache] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  /// 原生缩略图缓存是否可用
+  static bool get isAvailable => _native != null;
+
+  /// 在 [directory] 中生成 [bytes]（JPEG/PNG）的缩略图，返回内容哈希；
+  /// 原生库不可用或无法解码时返回 null
+  static String? store(String directory, Uint8List bytes) {
+    final native = _native;
+    if (native == null || bytes.isEmpty) return null;
+
+    final directoryPtr = directory.toNativeUtf8();
+    final dataPtr = malloc<Uint8>(bytes.length);
+    final hashPtr = malloc<Uint8>(65).cast<Utf8>();
+    try {
+      dataPtr.asTypedList(bytes.length).setAll(0, bytes);
+      if (native.store(directoryPtr, dataPtr, bytes.length, hashPtr) == 0) {
+        return null;
+      }
+      return hashPtr.toDartString();
+    } finally {
+      malloc.free(directoryPtr);
+      malloc.free(dataPtr);
+      malloc.free(hashPtr);
+    }
+  }
+
+  /// [hash] 的 [level] 级缩略图路径（与 native ThumbnailPath 一致）
+  static String pathFor(String directory, String hash, int level) {
+    return '$directory/${hash.substring(0, 2)}/${hash}_$level.jpg';
+  }
+}
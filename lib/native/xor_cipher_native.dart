@@ -0,0 +1,81 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'native_library.dart';
+
+typedef _CreateNative = Pointer<Void> Function(Pointer<Uint8>, Int32);
+typedef _CreateDart = Pointer<Void> Function(Pointer<Uint8>, int);
+typedef _DestroyNative = Void Function(Pointer<Void>);
+typedef _DestroyDart = void Function(Pointer<Void>);
+typedef _ApplyNative = Void Function(Pointer<Void>, Pointer<Uint8>, Int64, Int64);
+typedef _ApplyDart = void Function(Pointer<Void>, Pointer<Uint8>, int, int);
+
+class _Bindings {
+  _Bindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<_CreateNative, _CreateDart>('cyrene_xor_create'),
+        destroy = lib.lookupFunction<_DestroyNative, _DestroyDart>('cyrene_xor_destroy'),
+        apply = lib.lookupFunction<_ApplyNative, _ApplyDart>(
+            'cyrene_xor_apply', isLeaf: true);
+
+  final _CreateDart create;
+  final _DestroyDart destroy;
+  final _ApplyDart apply;
+}
+
+/// 原生 XOR 加解密内核
+///
+/// 由 native/xor_cipher.cc 实现，按 CPU 选择 AVX2 / SSE2 / NEON 向量化路径。
+/// 数据原地处理，不产生额外拷贝。
+class NativeXorCipher {
+  NativeXorCipher._(this._handle);
+
+  static _Bindings? _bindings;
+  static bool _bindingsResolved = false;
+
+  static _Bindings? get _native {
+    if (_bindingsResolved) return _bindings;
+    _bindingsResolved = true;
+
+    final lib = NativeLibrary.instance;
+    if (lib == null) return null;
+
+    try {
+      _bindings = _Bindings(lib);
+    } catch (e) {
+      print('⚠️ [NativeXorCipher] 绑定原生函数失败: $e');
+      _bindings = null;
+    }
+    return _bindings;
+  }
+
+  final Pointer<Void> _handle;
+
+  /// 使用 [key] 创建内核，原生库不可用时返回 null
+  ///
+  /// 密钥在创建时展开一次，实例应长期复用（通常与服务同生命周期）。
+  static NativeXorCipher? create(Uint8List key) {
+    final native = _native;
+    if (native == null || key.isEmpty) return null;
+
+    final keyPtr = malloc<Uint8>(key.length);
+    try {
+      keyPtr.asTypedList(key.length).setAll(0, key);
+      final handle = native.create(keyPtr, key.length);
+      if (handle == nullptr) return null;
+      return NativeXorCipher._(handle);
+    } finally {
+      malloc.free(keyPtr);
+    }
+  }
+
+  /// 原地加解密 [data]，[offset] 为 data[0] 在密文流中的位置
+  void apply(Uint8List data, {int offset = 0}) {
+    if (data.isEmpty) return;
+    _native!.apply(_handle, data.address, data.length, offset);
+  }
+
+  /// 释放原生资源
+  void dispose() {
+    _native!.destroy(_handle);
+  }
+}
@@ -1,5 +1,5 @@
 import 'package:flutter/material.dart';
-import 'package:cached_network_image/cached_network_image.dart';
+import '../widgets/cover_image.dart';
 import '../services/netease_discover_service.dart';
 import '../models/netease_discover.dart';
 import 'discover_playlist_detail_page.dart';
@@ -252,7 +252,7 @@ class _PlaylistCard extends StatelessWidget {
           children: [
             AspectRatio(
               aspectRatio: 1,
-              child: CachedNetworkImage(
+              child: CoverImage(
                 imageUrl: summary.coverImgUrl,
                 fit: BoxFit.cover,
                 placeholder: (context, url) => Container(
@@ -1,5 +1,5 @@
 import 'package:flutter/material.dart';
-import 'package:cached_network_image/cached_network_image.dart';
+import '../widgets/cover_image.dart';
 import '../services/play_history_service.dart';
 import '../services/player_service.dart';
 import '../models/track.dart';
@@ -180,7 +180,7 @@ class _HistoryPageState extends State<HistoryPage> with AutomaticKeepAliveClient
           children: [
             ClipRRect(
               borderRadius: BorderRadius.circular(4),
-              child: CachedNetworkImage(
+              child: CoverImage(
                 imageUrl: item.picUrl,
                 width: 50,
                 height: 50,
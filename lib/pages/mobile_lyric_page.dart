@@ -126,6 +126,7 @@ class _MobileLyricPageState extends State<MobileLyricPage> {
     final newIndex = LyricParser.findCurrentLineIndex(
       _lyrics,
       PlayerService().position,
+      hint: _currentLyricIndex,
     );
 
     if (newIndex != _currentLyricIndex && newIndex >= 0 && mounted) {
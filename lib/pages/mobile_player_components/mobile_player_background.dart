@@ -1,11 +1,11 @@
 import 'dart:io';
-import 'dart:ui';
 import 'package:flutter/material.dart';
 import 'package:cached_network_image/cached_network_image.dart';
 import '../../services/player_service.dart';
 import '../../services/player_background_service.dart';
 import '../../models/track.dart';
 import '../../models/song_detail.dart';
+import '../../widgets/blurred_background_image.dart';
 
 /// 移动端播放器背景组件
 /// 根据设置显示不同类型的背景（自适应、纯色、图片）
@@ -173,6 +173,14 @@ class MobilePlayerBackground extends StatelessWidget {
     if (backgroundService.imagePath != null) {
       final imageFile = File(backgroundService.imagePath!);
       if (imageFile.existsSync()) {
+        // 模糊背景预先渲染为静态图片（见 BlurredBackgroundImage）
+        if (backgroundService.blurAmount > 0) {
+          return BlurredBackgroundImage(
+            imagePath: imageFile.path,
+            blurAmount: backgroundService.blurAmount,
+          );
+        }
+
         return Stack(
           children: [
             // 图片层
@@ -182,26 +190,12 @@ class MobilePlayerBackground extends StatelessWidget {
                 fit: BoxFit.cover, // 保持原比例裁剪
               ),
             ),
-            // 模糊层
-            if (backgroundService.blurAmount > 0)
-              Positioned.fill(
-                child: BackdropFilter(
-                  filter: ImageFilter.blur(
-                    sigmaX: backgroundService.blurAmount,
-                    sigmaY: backgroundService.blurAmount,
-                  ),
-                  child: Container(
-                    color: Colors.black.withOpacity(0.3), // 添加半透明遮罩
-                  ),
-                ),
-              )
-            else
-              // 无模糊时也添加浅色遮罩以确保文字可读
-              Positioned.fill(
-                child: Container(
-                  color: Colors.black.withOpacity(0.2),
-                ),
+            // 无模糊时也添加浅色遮罩以确保文字可读
+            Positioned.fill(
+              child: Container(
+                color: Colors.black.withOpacity(0.2),
               ),
+            ),
           ],
         );
       }
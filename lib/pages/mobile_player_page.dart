@@ -254,6 +254,7 @@ class _MobilePlayerPageState extends State<MobilePlayerPage> with TickerProvider
     final newIndex = LyricParser.findCurrentLineIndex(
       _lyrics,
       PlayerService().position,
+      hint: _currentLyricIndex,
     );
 
     if (newIndex != _currentLyricIndex && newIndex >= 0 && mounted) {
@@ -296,6 +296,7 @@ class _PlayerPageState extends State<PlayerPage> with WindowListener, TickerProv
     final newIndex = LyricParser.findCurrentLineIndex(
       _lyrics,
       PlayerService().position,
+      hint: _currentLyricIndex,
     );
 
     if (newIndex != _currentLyricIndex && newIndex >= 0 && mounted) {
@@ -1,5 +1,5 @@
 import 'package:flutter/material.dart';
-import 'package:cached_network_image/cached_network_image.dart';
+import '../widgets/cover_image.dart';
 import '../services/playlist_service.dart';
 import '../services/player_service.dart';
 import '../services/playlist_queue_service.dart';
@@ -819,7 +819,7 @@ class _PlaylistsPageState extends State<PlaylistsPage>
                 children: [
                   ClipRRect(
                     borderRadius: BorderRadius.circular(4),
-                    child: CachedNetworkImage(
+                    child: CoverImage(
                       imageUrl: item.picUrl,
                       width: 50,
                       height: 50,
@@ -1,5 +1,6 @@
 import 'dart:io';
 import 'package:flutter/material.dart';
+import '../../services/desktop_lyric_service.dart';
 import '../../widgets/desktop_lyric_settings.dart';
 import '../../widgets/android_floating_lyric_settings.dart';
 
@@ -10,7 +11,7 @@ class LyricSettings extends StatelessWidget {
   @override
   Widget build(BuildContext context) {
     // 根据平台显示对应的歌词设置
-    if (Platform.isWindows) {
+    if (DesktopLyricService.isSupported) {
       return Column(
         crossAxisAlignment: CrossAxisAlignment.start,
         children: [
@@ -1,5 +1,6 @@
 import 'package:flutter/material.dart';
 import '../../services/audio_quality_service.dart';
+import '../../services/player_service.dart';
 import '../../models/song_detail.dart';
 
 /// 播放设置组件
@@ -23,10 +24,91 @@ class PlaybackSettings extends StatelessWidget {
             onTap: () => _showAudioQualityDialog(context),
           ),
         ),
+        // 交叉淡入淡出和响度均衡只有原生播放引擎（Linux）支持
+        if (PlayerService().hasNativeEngine) ...[
+          const SizedBox(height: 8),
+          AnimatedBuilder(
+            animation: PlayerService(),
+            builder: (context, _) => Card(
+              child: Column(
+                children: [
+                  ListTile(
+                    leading: const Icon(Icons.multiple_stop),
+                    title: const Text('歌曲衔接'),
+                    subtitle: Text(_crossfadeName(PlayerService().crossfade)),
+                    trailing: const Icon(Icons.chevron_right),
+                    onTap: () => _showCrossfadeDialog(context),
+                  ),
+                  const Divider(height: 1),
+                  SwitchListTile(
+                    secondary: const Icon(Icons.equalizer),
+                    title: const Text('响度均衡'),
+                    subtitle: const Text('按 EBU R128 统一已缓存歌曲的音量，从下一首开始生效'),
+                    value: PlayerService().normalizeLoudness,
+                    onChanged: (value) =>
+                        PlayerService().setNormalizeLoudness(value),
+                  ),
+                ],
+              ),
+            ),
+          ),
+        ],
       ],
     );
   }
 
+  static const List<Duration> _crossfadeOptions = [
+    Duration.zero,
+    Duration(seconds: 2),
+    Duration(seconds: 5),
+    Duration(seconds: 8),
+  ];
+
+  String _crossfadeName(Duration crossfade) {
+    if (crossfade == Duration.zero) return '无缝衔接（不留空白）';
+    return '交叉淡入淡出 ${crossfade.inSeconds} 秒';
+  }
+
+  void _showCrossfadeDialog(BuildContext context) {
+    final current = PlayerService().crossfade;
+
+    showDialog(
+      context: context,
+      builder: (context) => AlertDialog(
+        title: const Text('歌曲衔接'),
+        content: Column(
+          mainAxisSize: MainAxisSize.min,
+          children: [
+            for (final option in _crossfadeOptions)
+              RadioListTile<Duration>(
+                title: Text(_crossfadeName(option)),
+                value: option,
+                groupValue: current,
+                onChanged: (value) {
+                  if (value != null) {
+                    PlayerService().setCrossfade(value);
+                    Navigator.pop(context);
+                    ScaffoldMessenger.of(context).showSnackBar(
+                      const SnackBar(
+                        content: Text('歌曲衔接设置已更新'),
+                        duration: Duration(seconds: 1),
+                      ),
+                    );
+                  }
+                },
+              ),
+          ],
+        ),
+        actions: [
+          TextButton(
+            onPressed: () => Navigator.pop(context),
+            child: const Text('关闭'),
+          ),
+        ],
+      ),
+    );
+  }
+
   Widget _buildSectionTitle(BuildContext context, String title) {
     return Padding(
       padding: const EdgeInsets.only(bottom: 12.0, left: 4.0),
@@ -1,6 +1,7 @@
 import 'dart:io';
 import 'package:flutter/material.dart';
 import 'package:file_picker/file_picker.dart';
+import '../../native/cache_manager_native.dart';
 import '../../services/cache_service.dart';
 import '../../services/download_service.dart';
 
@@ -54,6 +55,16 @@ class _StorageSettingsState extends State<StorageSettings> {
                 trailing: const Icon(Icons.chevron_right),
                 onTap: () => _showCacheManagement(),
               ),
+              if (CacheService().evictionAvailable) ...[
+                const Divider(height: 1),
+                ListTile(
+                  leading: const Icon(Icons.data_usage),
+                  title: const Text('缓存上限'),
+                  subtitle: Text(_getCacheLimitSubtitle()),
+                  trailing: const Icon(Icons.chevron_right),
+                  onTap: () => _showCacheLimitSettings(),
+                ),
+              ],
               if (Platform.isWindows) ...[
                 const Divider(height: 1),
                 ListTile(
@@ -101,6 +112,32 @@ class _StorageSettingsState extends State<StorageSettings> {
     return '已缓存 $count 首歌曲';
   }
 
+  static const List<int> _cacheLimitChoices = [
+    1024 * 1024 * 1024,
+    2 * 1024 * 1024 * 1024,
+    5 * 1024 * 1024 * 1024,
+    10 * 1024 * 1024 * 1024,
+    0,
+  ];
+
+  static const Map<CacheEvictionPolicy, String> _policyNames = {
+    CacheEvictionPolicy.lru: '最久未播放优先',
+    CacheEvictionPolicy.lfu: '播放最少优先',
+    CacheEvictionPolicy.arc: '自适应（ARC）',
+  };
+
+  String _formatCacheLimit(int bytes) {
+    if (bytes == 0) return '不限';
+    return '${bytes ~/ (1024 * 1024 * 1024)} GB';
+  }
+
+  String _getCacheLimitSubtitle() {
+    final service = CacheService();
+    if (service.cacheBudget == 0) return '不限';
+    return '${_formatCacheLimit(service.cacheBudget)}，'
+        '${_policyNames[service.evictionPolicy]}';
+  }
+
   String _getCacheDirSubtitle() {
     final customDir = CacheService().customCacheDir;
     if (customDir != null && customDir.isNotEmpty) {
@@ -287,6 +324,70 @@ class _StorageSettingsState extends State<StorageSettings> {
     );
   }
 
+  void _showCacheLimitSettings() {
+    showDialog(
+      context: context,
+      builder: (context) => StatefulBuilder(
+        builder: (context, setDialogState) => AlertDialog(
+          title: const Row(
+            children: [
+              Icon(Icons.data_usage),
+              SizedBox(width: 8),
+              Text('缓存上限'),
+            ],
+          ),
+          content: SingleChildScrollView(
+            child: Column(
+              mainAxisSize: MainAxisSize.min,
+              crossAxisAlignment: CrossAxisAlignment.start,
+              children: [
+                for (final bytes in _cacheLimitChoices)
+                  RadioListTile<int>(
+                    title: Text(_formatCacheLimit(bytes)),
+                    value: bytes,
+                    groupValue: CacheService().cacheBudget,
+                    onChanged: (value) async {
+                      if (value == null) return;
+                      await CacheService().setCacheBudget(value);
+                      setDialogState(() {});
+                      setState(() {});
+                    },
+                  ),
+                const Divider(),
+                ListTile(
+                  title: const Text('淘汰策略'),
+                  subtitle: const Text('超出上限时先删除哪些缓存'),
+                  trailing: DropdownButton<CacheEvictionPolicy>(
+                    value: CacheService().evictionPolicy,
+                    items: [
+                      for (final entry in _policyNames.entries)
+                        DropdownMenuItem(
+                          value: entry.key,
+                          child: Text(entry.value),
+                        ),
+                    ],
+                    onChanged: (value) async {
+                      if (value == null) return;
+                      await CacheService().setEvictionPolicy(value);
+                      setDialogState(() {});
+                      setState(() {});
+                    },
+                  ),
+                ),
+              ],
+            ),
+          ),
+          actions: [
+            TextButton(
+              onPressed: () => Navigator.pop(context),
+              child: const Text('关闭'),
+            ),
+          ],
+        ),
+      ),
+    );
+  }
+
   Future<void> _showCacheDirSettings() async {
     final currentCustomDir = CacheService().customCacheDir;
     final currentDir = CacheService().currentCacheDir;
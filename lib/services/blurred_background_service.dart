@@ -0,0 +1,135 @@
+import 'dart:convert';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'dart:ui';
+import 'package:crypto/crypto.dart';
+import 'package:path/path.dart' as path;
+import 'package:path_provider/path_provider.dart';
+import '../native/background_blur_native.dart';
+
+/// 预模糊背景服务
+///
+/// 播放器图片背景原先每帧都用 BackdropFilter 实时模糊全屏图片，在软件
+/// 渲染的 Linux 桌面上开销很大。这里对每张背景图、模糊程度和显示尺寸只
+/// 在原生层（native/background_blur.cc）渲染一次，界面直接拉伸绘制结果，
+/// 停留在播放页时几乎没有额外开销。原生库不可用时 [isAvailable] 为
+/// false，调用方应继续使用 BackdropFilter。
+class BlurredBackgroundService {
+  static final BlurredBackgroundService _instance = BlurredBackgroundService._internal();
+  factory BlurredBackgroundService() => _instance;
+  BlurredBackgroundService._internal();
+
+  static const String _directoryName = 'player_backgrounds';
+
+  /// 显示尺寸按此步长（逻辑像素）取整，窗口微调大小时复用同一张结果
+  static const int _sizeStep = 64;
+
+  /// 保留的渲染结果数量，更早的文件会被删除
+  static const int _maxRendered = 4;
+
+  /// 叠加的遮罩，与原模糊层上的 30% 黑色一致
+  static const Color tint = Color(0x4D000000);
+
+  /// 原生背景模糊是否可用
+  static bool get isAvailable => NativeBackgroundBlur.isAvailable;
+
+  String? _directory;
+  Future<bool>? _opened;
+  final Map<String, Future<String?>> _pending = {};
+  final List<String> _rendered = [];
+
+  /// [imagePath] 以 [blurAmount] 模糊、铺满 [displaySize] 时的背景图路径；
+  /// 首次请求时渲染，失败时返回 null
+  Future<String?> backgroundPath(
+      String imagePath, Size displaySize, double blurAmount) async {
+    if (displaySize.isEmpty || !await (_opened ??= _open())) return null;
+
+    final FileStat stat;
+    try {
+      stat = await File(imagePath).stat();
+    } catch (_) {
+      return null;
+    }
+    if (stat.type != FileSystemEntityType.file) return null;
+
+    final width = _bucket(displaySize.width);
+    final height = _bucket(displaySize.height);
+    final key = md5
+        .convert(utf8.encode('$imagePath|${stat.modified.millisecondsSinceEpoch}|'
+            '${stat.size}|${width}x$height|$blurAmount'))
+        .toString();
+    final output = path.join(_directory!, '$key.jpg');
+    if (_rendered.contains(output) && await File(output).exists()) {
+      return output;
+    }
+
+    // 同一背景的并发请求共用一次渲染
+    return _pending[key] ??= _render(imagePath, output, width, height, blurAmount)
+        .whenComplete(() => _pending.remove(key));
+  }
+
+  static int _bucket(double logical) {
+    return (logical / _sizeStep).ceil() * _sizeStep;
+  }
+
+  Future<bool> _open() async {
+    try {
+      final supportDir = await getApplicationSupportDirectory();
+      final directory = Directory(path.join(supportDir.path, _directoryName));
+      // 上次运行留下的结果不再引用，启动时清空
+      if (await directory.exists()) {
+        await directory.delete(recursive: true);
+      }
+      await directory.create(recursive: true);
+      _directory = directory.path;
+      return true;
+    } catch (e) {
+      print('⚠️ [BlurredBackgroundService] 初始化背景目录失败: $e');
+      return false;
+    }
+  }
+
+  Future<String?> _render(String imagePath, String output, int width,
+      int height, double blurAmount) async {
+    try {
+      final bytes = await File(imagePath).readAsBytes();
+      final stopwatch = Stopwatch()..start();
+      final ok = await _renderInBackground(
+          output, bytes, width, height, blurAmount, tint.value);
+      if (!ok) {
+        print('⚠️ [BlurredBackgroundService] 无法渲染背景: $imagePath');
+        return null;
+      }
+      print('🎨 [BlurredBackgroundService] 背景已渲染 ${width}x$height, '
+          '模糊: $blurAmount, 耗时 ${stopwatch.elapsedMilliseconds}ms');
+      _remember(output);
+      return output;
+    } catch (e) {
+      print('⚠️ [BlurredBackgroundService] 渲染背景失败: $e');
+      return null;
+    }
+  }
+
+  void _remember(String output) {
+    _rendered
+      ..remove(output)
+      ..add(output);
+    while (_rendered.length > _maxRendered) {
+      _delete(_rendered.removeAt(0));
+    }
+  }
+
+  static Future<void> _delete(String file) async {
+    try {
+      await File(file).delete();
+    } catch (_) {}
+  }
+
+  /// 在后台 isolate 中渲染（闭包只捕获参数）
+  static Future<bool> _renderInBackground(String output, Uint8List bytes,
+      int width, int height, double blurAmount, int tint) {
+    return Isolate.run(() => NativeBackgroundBlur.render(output, bytes,
+        width: width, height: height, sigma: blurAmount, tint: tint));
+  }
+}
@@ -1,5 +1,7 @@
 import 'dart:io';
 import 'dart:convert';
+import 'dart:isolate';
+import 'dart:math' as math;
 import 'dart:typed_data';
 import 'package:flutter/foundation.dart';
 import 'package:path_provider/path_provider.dart';
@@ -7,6 +9,15 @@ import 'package:crypto/crypto.dart';
 import 'package:shared_preferences/shared_preferences.dart';
 import '../models/track.dart';
 import '../models/song_detail.dart';
+import '../native/aes_ctr_native.dart';
+import '../native/cache_ingest_native.dart';
+import '../native/cache_manager_native.dart';
+import '../native/cyrene_file_native.dart';
+import '../native/cyrene_writer_native.dart';
+import '../native/loudness_native.dart';
+import '../native/record_store_native.dart';
+import '../native/xor_cipher_native.dart';
+import 'proxy_service.dart';
 import 'package:http/http.dart' as http;
 import 'package:path/path.dart' as path;
 
@@ -26,6 +37,12 @@ class CacheMetadata {
   final String lyric;
   final String tlyric;
 
+  /// 响度均衡增益（dB），尚未分析时为 null；分析失败记为 0
+  final double? gainDb;
+
+  /// 真峰值（dBTP），与 [gainDb] 一起写入
+  final double? truePeakDb;
+
   CacheMetadata({
     required this.songId,
     required this.songName,
@@ -40,8 +57,31 @@ class CacheMetadata {
     required this.checksum,
     required this.lyric,
     required this.tlyric,
+    this.gainDb,
+    this.truePeakDb,
   });
 
+  /// 复制一份并记录响度分析结果
+  CacheMetadata withLoudness(double gainDb, double truePeakDb) {
+    return CacheMetadata(
+      songId: songId,
+      songName: songName,
+      artists: artists,
+      album: album,
+      picUrl: picUrl,
+      source: source,
+      quality: quality,
+      originalUrl: originalUrl,
+      fileSize: fileSize,
+      cachedAt: cachedAt,
+      checksum: checksum,
+      lyric: lyric,
+      tlyric: tlyric,
+      gainDb: gainDb,
+      truePeakDb: truePeakDb,
+    );
+  }
+
   factory CacheMetadata.fromJson(Map<String, dynamic> json) {
     return CacheMetadata(
       songId: json['songId'],
@@ -57,7 +97,57 @@ class CacheMetadata {
       checksum: json['checksum'],
       lyric: json['lyric'] ?? '',
       tlyric: json['tlyric'] ?? '',
+      gainDb: (json['gainDb'] as num?)?.toDouble(),
+      truePeakDb: (json['truePeakDb'] as num?)?.toDouble(),
+    );
+  }
+
+  /// 编码为缓存索引存储中的二进制值
+  Uint8List toRecord() {
+    final writer = StoreRecordWriter()
+      ..writeString(songId)
+      ..writeString(songName)
+      ..writeString(artists)
+      ..writeString(album)
+      ..writeString(picUrl)
+      ..writeString(source)
+      ..writeString(quality)
+      ..writeString(originalUrl)
+      ..writeInt(fileSize)
+      ..writeInt(cachedAt.millisecondsSinceEpoch)
+      ..writeString(checksum)
+      ..writeString(lyric)
+      ..writeString(tlyric);
+    // 响度字段追加在末尾（单位 0.01 dB），旧记录没有这两项
+    if (gainDb != null && truePeakDb != null) {
+      writer
+        ..writeInt((gainDb! * 100).round())
+        ..writeInt((truePeakDb! * 100).round());
+    }
+    return writer.takeBytes();
+  }
+
+  /// 从缓存索引存储中的二进制值创建
+  factory CacheMetadata.fromRecord(Uint8List bytes) {
+    final reader = StoreRecordReader(bytes);
+    final metadata = CacheMetadata(
+      songId: reader.readString(),
+      songName: reader.readString(),
+      artists: reader.readString(),
+      album: reader.readString(),
+      picUrl: reader.readString(),
+      source: reader.readString(),
+      quality: reader.readString(),
+      originalUrl: reader.readString(),
+      fileSize: reader.readInt(),
+      cachedAt: DateTime.fromMillisecondsSinceEpoch(reader.readInt()),
+      checksum: reader.readString(),
+      lyric: reader.readString(),
+      tlyric: reader.readString(),
     );
+    if (!reader.hasMore) return metadata;
+    return metadata.withLoudness(
+        reader.readInt() / 100, reader.readInt() / 100);
   }
 
   Map<String, dynamic> toJson() {
@@ -75,6 +165,8 @@ class CacheMetadata {
       'checksum': checksum,
       'lyric': lyric,
       'tlyric': tlyric,
+      if (gainDb != null) 'gainDb': gainDb,
+      if (truePeakDb != null) 'truePeakDb': truePeakDb,
     };
   }
 }
@@ -111,20 +203,97 @@ class CacheService extends ChangeNotifier {
   factory CacheService() => _instance;
   CacheService._internal();
 
-  // 加密密钥（用于简单的异或加密）
+  // 旧版加密密钥（v1 / v2 缓存文件和旧索引记录的异或加密）
   static const String _encryptionKey = 'CyreneMusicCacheKey2025';
+  static final Uint8List _encryptionKeyBytes = Uint8List.fromList(utf8.encode(_encryptionKey));
+
+  // 原生 XOR 内核（不可用时为 null，使用 Dart 循环）
+  static final NativeXorCipher? _nativeCipher = NativeXorCipher.create(_encryptionKeyBytes);
+
+  // 本机安装密钥（AES-128），首次启动时随机生成并保存在设置中；
+  // 新缓存文件写成 v3（AES-CTR），索引记录也用它加密。原生库不可用时为 null
+  static const String _fileKeyPref = 'cache_encryption_key';
+  Uint8List? _fileKey;
+  NativeAesCtr? _recordCipher;
+  static final math.Random _secureRandom = math.Random.secure();
+
+  // AES 加密的索引记录：[4字节魔数 "CYAE"][16字节 nonce][密文]
+  static const List<int> _recordMagic = [0x43, 0x59, 0x41, 0x45];
+
+  // 旧格式缓存文件在首次访问时于后台升级为 v3，同一时间只升级一首
+  Future<void> _upgradeQueue = Future.value();
+  final Set<String> _upgradeChecked = {};
 
   Directory? _cacheDir;
   Map<String, CacheMetadata> _cacheIndex = {};
+
+  // 原生缓存索引存储（Linux），每首歌一条记录，值经 XOR 加密；
+  // 不可用时整个索引以加密 JSON 保存在 cache_index.cyrene 中
+  NativeRecordStore? _indexStore;
+  static const String _indexStoreFileName = 'cache_index.store';
+  static const String _legacyIndexFileName = 'cache_index.cyrene';
+  // 原生缓存管理器的访问记录（native/cache_manager.cc）
+  static const String _accessStoreFileName = 'cache_access.store';
   bool _isInitialized = false;
   bool _cacheEnabled = false;  // 缓存开关，默认关闭
+
+  // 响度均衡（EBU R128）：每首歌缓存后在后台分析一次，结果写入索引
+  static const double _targetLoudness = -18.0; // ReplayGain 2.0 参考响度（LUFS）
+  static const double _peakCeiling = -1.0;     // 增益后的真峰值上限（dBTP）
+  Future<void> _loudnessQueue = Future.value();
+  final Set<String> _loudnessPending = {};
+
+  // 正在写入的缓存键，同一首歌同时只写一份 .part 文件
+  final Set<String> _ingesting = {};
   String? _customCacheDir;    // 自定义缓存目录
 
+  // 原生缓存管理器（Linux）：维护大小计数器和播放记录，超出上限时按策略淘汰
+  NativeCacheManager? _manager;
+  static const int _defaultCacheBudget = 2 * 1024 * 1024 * 1024;
+  int _cacheBudget = _defaultCacheBudget;  // 容量上限（字节），0 表示不限
+  // 代理分段缓存（临时目录）的上限取缓存上限的四分之一，限制在此区间内；
+  // 缓存上限不限时也取最大值，临时目录不应无限增长
+  static const int _minStreamCacheBudget = 256 * 1024 * 1024;
+  static const int _maxStreamCacheBudget = 2 * 1024 * 1024 * 1024;
+  CacheEvictionPolicy _evictionPolicy = CacheEvictionPolicy.lru;
+
   bool get isInitialized => _isInitialized;
   int get cachedCount => _cacheIndex.length;
   bool get cacheEnabled => _cacheEnabled;
   String? get customCacheDir => _customCacheDir;
   String? get currentCacheDir => _cacheDir?.path;
+  int get cacheBudget => _cacheBudget;
+  CacheEvictionPolicy get evictionPolicy => _evictionPolicy;
+
+  /// 代理分段缓存的容量上限（字节），由缓存上限推出
+  int get streamCacheBudget => _cacheBudget == 0
+      ? _maxStreamCacheBudget
+      : (_cacheBudget ~/ 4)
+          .clamp(_minStreamCacheBudget, _maxStreamCacheBudget)
+          .toInt();
+
+  /// 本应用的临时目录（系统临时目录下的 cyrene 子目录）
+  ///
+  /// Linux 上系统临时目录是所有程序共用的 /tmp：解密副本等临时文件都写在
+  /// 这里，原生缓存管理器也只清理这个目录，不会动到其他程序的文件。
+  static Future<Directory> tempDirectory() async {
+    final dir = Directory(
+      path.join((await getTemporaryDirectory()).path, 'cyrene'),
+    );
+    if (!await dir.exists()) {
+      await dir.create(recursive: true);
+    }
+    return dir;
+  }
+
+  /// 是否支持容量上限和自动淘汰（需要原生缓存管理器）
+  bool get evictionAvailable => _manager != null;
+
+  /// 原生读取器打开缓存文件用的密钥
+  ///
+  /// 有安装密钥时为它（v1 / v2 文件由原生读取器用内置的异或密钥解密），
+  /// 否则为旧版异或密钥。
+  Uint8List get cacheFileKey => _fileKey ?? _encryptionKeyBytes;
 
   /// 初始化缓存服务
   Future<void> initialize() async {
@@ -183,9 +352,24 @@ class CacheService extends ChangeNotifier {
       // 加载缓存索引
       await _loadCacheIndex();
 
+      // 原生缓存管理器扫描一次缓存目录，之后只维护计数器
+      _manager?.close();
+      _manager = NativeCacheManager.open(
+        _cacheDir!.path,
+        (await tempDirectory()).path,
+      );
+      _manager?.setBudget(_cacheBudget, _evictionPolicy);
+      await ProxyService().setStreamCacheLimit(streamCacheBudget);
+
       _isInitialized = true;
+      await _evictOverBudget();
       notifyListeners();
 
+      // 补齐旧缓存的响度分析
+      for (final entry in _cacheIndex.entries) {
+        if (entry.value.gainDb == null) _scheduleLoudness(entry.key);
+      }
+
       print('✅ [CacheService] 缓存服务初始化完成！');
       print('📊 [CacheService] 已缓存歌曲数: ${_cacheIndex.length}');
       print('📁 [CacheService] 缓存位置: ${_cacheDir!.path}');
@@ -207,26 +391,66 @@ class CacheService extends ChangeNotifier {
   }
 
   /// 加密数据（简单的异或加密，防止直接播放）
-  Uint8List _encryptData(Uint8List data) {
-    final keyBytes = utf8.encode(_encryptionKey);
-    final encrypted = Uint8List(data.length);
+  ///
+  /// 原地处理并返回 [data]；原生内核可用时走 SIMD 路径。
+  /// [offset] 为 data[0] 在整段密文中的位置，用于分块处理。
+  Uint8List _encryptData(Uint8List data, {int offset = 0}) {
+    final cipher = _nativeCipher;
+    if (cipher != null) {
+      cipher.apply(data, offset: offset);
+      return data;
+    }
 
+    final keyBytes = _encryptionKeyBytes;
     for (int i = 0; i < data.length; i++) {
-      encrypted[i] = data[i] ^ keyBytes[i % keyBytes.length];
+      data[i] ^= keyBytes[(offset + i) % keyBytes.length];
     }
 
-    return encrypted;
+    return data;
   }
 
-  /// 解密数据
+  /// 解密数据（原地处理）
   Uint8List _decryptData(Uint8List encryptedData) {
     // 异或加密是对称的，加密和解密使用相同的方法
     return _encryptData(encryptedData);
   }
 
-  /// 计算文件校验和
-  String _calculateChecksum(Uint8List data) {
-    return md5.convert(data).toString();
+  /// 加密一条缓存索引记录
+  ///
+  /// 有安装密钥时以 AES-CTR 加密（每条记录一个随机 nonce），否则沿用异或加密。
+  Uint8List _sealRecord(Uint8List record) {
+    final cipher = _recordCipher;
+    if (cipher == null) return _encryptData(record);
+
+    final nonce = Uint8List(NativeAesCtr.nonceLength);
+    for (int i = 0; i < nonce.length; i++) {
+      nonce[i] = _secureRandom.nextInt(256);
+    }
+    cipher.apply(nonce, record);
+    return (BytesBuilder(copy: false)
+          ..add(_recordMagic)
+          ..add(nonce)
+          ..add(record))
+        .takeBytes();
+  }
+
+  /// 解密一条 AES 加密的缓存索引记录，旧版异或加密的记录返回 null
+  ///
+  /// 旧记录以歌曲 ID 的 4 字节长度开头，与异或密钥运算后前两个字节总是 "Cy"，
+  /// 不会与魔数 "CYAE" 相同。
+  Uint8List? _openRecord(Uint8List value) {
+    final headerLength = _recordMagic.length + NativeAesCtr.nonceLength;
+    if (value.length < headerLength) return null;
+    for (int i = 0; i < _recordMagic.length; i++) {
+      if (value[i] != _recordMagic[i]) return null;
+    }
+    final cipher = _recordCipher;
+    if (cipher == null) throw StateError('缺少安装密钥');
+
+    final nonce = value.sublist(_recordMagic.length, headerLength);
+    final record = value.sublist(headerLength);
+    cipher.apply(nonce, record);
+    return record;
   }
 
   /// 检查缓存是否存在
@@ -253,6 +477,50 @@ class CacheService extends ChangeNotifier {
     return _cacheIndex[cacheKey];
   }
 
+  /// 获取缓存歌曲的本地流式播放 URL（用于播放）
+  ///
+  /// 由原生读取器按需解密，经本地代理输出，不读入整首歌也不写临时文件。
+  /// 原生读取器或代理不可用时返回 null，调用方应回退到 [getCachedFilePath]。
+  Future<String?> getCachedStreamUrl(Track track) async {
+    if (!_isInitialized ||
+        !NativeCyreneFile.isAvailable ||
+        (!ProxyService().isRunning && !ProxyService().isNativeRunning)) {
+      return null;
+    }
+
+    final cacheKey = _generateCacheKey(
+      track.id.toString(),
+      track.source,
+    );
+
+    final metadata = _cacheIndex[cacheKey];
+    if (metadata == null) {
+      return null;
+    }
+
+    final cacheFilePath = _getCacheFilePath(cacheKey);
+
+    // 预先打开一次，校验文件存在且格式正确
+    final file = NativeCyreneFile.open(cacheFilePath, cacheFileKey);
+    if (file == null) {
+      print('⚠️ [CacheService] 缓存文件无效: $cacheFilePath');
+      await _dropBrokenCache(cacheKey);
+      return null;
+    }
+    final version = file.version;
+    file.close();
+    _manager?.touch(cacheKey);
+    if (version < 3) _scheduleUpgrade(cacheKey);
+
+    // 分段缓存键与 PlayerService 传给 getProxyUrl 的一致
+    return ProxyService().registerCacheStream(
+      cacheKey,
+      cacheFilePath,
+      cacheFileKey,
+      segmentKey: '${metadata.source}_${metadata.songId}_${metadata.quality}',
+    );
+  }
+
   /// 获取缓存文件路径（用于播放）
   Future<String?> getCachedFilePath(Track track) async {
     if (!_isInitialized) {
@@ -274,8 +542,26 @@ class CacheService extends ChangeNotifier {
 
     if (!await cacheFile.exists()) {
       print('⚠️ [CacheService] 缓存文件不存在: $cacheFilePath');
-      _cacheIndex.remove(cacheKey);
-      await _saveCacheIndex();
+      await _dropBrokenCache(cacheKey);
+      return null;
+    }
+    _manager?.touch(cacheKey);
+    _scheduleUpgrade(cacheKey);
+
+    // 原生读取器可用时直接分块解密到临时文件（兼容 v1 / v2 / v3 格式）
+    if (NativeCyreneFile.isAvailable) {
+      final tempDir = await tempDirectory();
+      final tempFilePath = '${tempDir.path}/temp_${cacheKey}_${DateTime.now().millisecondsSinceEpoch}.mp3';
+      final keyBytes = cacheFileKey;
+      final extracted = await Isolate.run(
+        () => NativeCyreneFile.extract(cacheFilePath, keyBytes, tempFilePath),
+      );
+      if (extracted) {
+        print('✅ [CacheService] 解密缓存文件: $tempFilePath');
+        return tempFilePath;
+      }
+      print('❌ [CacheService] 解密缓存失败: $cacheFilePath');
+      await _dropBrokenCache(cacheKey);
       return null;
     }
 
@@ -307,7 +593,7 @@ class CacheService extends ChangeNotifier {
       final decryptedData = _decryptData(encryptedAudioData);
 
       // 创建临时文件
-      final tempDir = await getTemporaryDirectory();
+      final tempDir = await tempDirectory();
       final tempFilePath = '${tempDir.path}/temp_${cacheKey}_${DateTime.now().millisecondsSinceEpoch}.mp3';
       final tempFile = File(tempFilePath);
       await tempFile.writeAsBytes(decryptedData);
@@ -316,8 +602,7 @@ class CacheService extends ChangeNotifier {
       return tempFilePath;
     } catch (e) {
       print('❌ [CacheService] 解密缓存失败: $e');
-      _cacheIndex.remove(cacheKey);
-      await _saveCacheIndex();
+      await _dropBrokenCache(cacheKey);
       return null;
     }
   }
@@ -350,73 +635,66 @@ class CacheService extends ChangeNotifier {
         return true;
       }
 
-      print('💾 [CacheService] 开始缓存: ${track.name} (${track.getSourceName()})');
-
-      // 下载音频数据
-      final response = await http.get(Uri.parse(songDetail.url));
-      if (response.statusCode != 200) {
-        print('❌ [CacheService] 下载失败: ${response.statusCode}');
+      if (!_ingesting.add(cacheKey)) {
+        print('ℹ️ [CacheService] 歌曲正在缓存: ${track.name}');
         return false;
       }
 
-      final audioData = response.bodyBytes;
-      print('📥 [CacheService] 下载完成: ${audioData.length} bytes');
-
-      // 计算校验和
-      final checksum = _calculateChecksum(audioData);
-
-      // 加密音频数据
-      final encryptedAudioData = _encryptData(audioData);
-
-      // 创建元数据
-      final metadata = CacheMetadata(
-        songId: track.id.toString(),
-        songName: track.name,
-        artists: track.artists,
-        album: track.album,
-        picUrl: track.picUrl,
-        source: track.source.name,
-        quality: quality,
-        originalUrl: songDetail.url,
-        fileSize: audioData.length,
-        cachedAt: DateTime.now(),
-        checksum: checksum,
-        lyric: songDetail.lyric,
-        tlyric: songDetail.tlyric,
-      );
+      print('💾 [CacheService] 开始缓存: ${track.name} (${track.getSourceName()})');
 
-      // 将元数据转换为字节
-      final metadataJson = jsonEncode(metadata.toJson());
-      final metadataBytes = utf8.encode(metadataJson);
-      final metadataLength = metadataBytes.length;
+      CacheMetadata buildMetadata(int fileSize, String checksum) => CacheMetadata(
+            songId: track.id.toString(),
+            songName: track.name,
+            artists: track.artists,
+            album: track.album,
+            picUrl: track.picUrl,
+            source: track.source.name,
+            quality: quality,
+            originalUrl: songDetail.url,
+            fileSize: fileSize,
+            cachedAt: DateTime.now(),
+            checksum: checksum,
+            lyric: songDetail.lyric,
+            tlyric: songDetail.tlyric,
+          );
+
+      // 文件头里的元数据在下载开始前写入，此时大小和校验和还未知，以缓存索引为准
+      final metadataBytes = utf8.encode(jsonEncode(buildMetadata(0, '').toJson()));
+      final cacheFilePath = _getCacheFilePath(cacheKey);
 
-      // 构建 .cyrene 文件
-      // 格式: [4字节元数据长度] [元数据JSON] [加密的音频数据]
-      final cyreneFile = BytesBuilder();
-      
-      // 写入元数据长度（4字节，大端序）
-      cyreneFile.addByte((metadataLength >> 24) & 0xFF);
-      cyreneFile.addByte((metadataLength >> 16) & 0xFF);
-      cyreneFile.addByte((metadataLength >> 8) & 0xFF);
-      cyreneFile.addByte(metadataLength & 0xFF);
-      
-      // 写入元数据
-      cyreneFile.add(metadataBytes);
-      
-      // 写入加密的音频数据
-      cyreneFile.add(encryptedAudioData);
+      // 边下载边校验、加密、写盘，整首歌不进入内存
+      final CacheIngestResult result;
+      try {
+        if (NativeCacheIngest.isAvailable) {
+          // 原生管线写入 v3 分块格式（AES-CTR，块索引 + CRC32C，写完后原子重命名）；
+          // 没有安装密钥时写入 v2
+          final url = songDetail.url;
+          final keyBytes = cacheFileKey;
+          result = await Isolate.run(
+            () => NativeCacheIngest.ingest(url, cacheFilePath, keyBytes, metadataBytes),
+          );
+        } else {
+          result = await _ingestStreaming(songDetail.url, cacheFilePath, metadataBytes);
+        }
+      } finally {
+        _ingesting.remove(cacheKey);
+      }
 
-      // 保存 .cyrene 文件
-      final cacheFilePath = _getCacheFilePath(cacheKey);
-      final cacheFile = File(cacheFilePath);
-      await cacheFile.writeAsBytes(cyreneFile.toBytes());
+      if (!result.success) {
+        print('❌ [CacheService] 下载失败: HTTP ${result.statusCode}, 已接收 ${result.size} bytes');
+        return false;
+      }
 
+      final metadata = buildMetadata(result.size, result.checksum);
       print('🔒 [CacheService] 保存缓存文件: $cacheFilePath');
-      print('📊 [CacheService] 文件大小: ${cyreneFile.length} bytes (元数据: $metadataLength bytes)');
+      print('📊 [CacheService] 音频大小: ${result.size} bytes (元数据: ${metadataBytes.length} bytes)');
 
       // 更新缓存索引
       _cacheIndex[cacheKey] = metadata;
-      await _saveCacheIndex();
+      await _saveCacheIndex(cacheKey);
+      _manager?.insert(cacheKey);
+      await _evictOverBudget();
+      _scheduleLoudness(cacheKey);
 
       print('✅ [CacheService] 缓存完成: ${track.name}');
       notifyListeners();
@@ -428,10 +706,206 @@ class CacheService extends ChangeNotifier {
     }
   }
 
+  /// 排队分析一首缓存歌曲的响度（同一时间只分析一首）
+  void _scheduleLoudness(String cacheKey) {
+    if (!NativeLoudness.isAvailable || !NativeCyreneFile.isAvailable) return;
+    if (!_loudnessPending.add(cacheKey)) return;
+    _loudnessQueue = _loudnessQueue.then((_) => _analyzeLoudness(cacheKey));
+  }
+
+  /// 整首测量一首缓存歌曲，换算成均衡增益写入缓存索引
+  ///
+  /// 与播放一样经本地代理的 /cache/ 地址按需解密，明文不落盘。
+  /// 代理未运行时保持未分析，下次启动再排队。
+  Future<void> _analyzeLoudness(String cacheKey) async {
+    // 独立的流 ID，不影响同一首歌正在播放的登记
+    final streamId = 'loudness_$cacheKey';
+    try {
+      final metadata = _cacheIndex[cacheKey];
+      if (metadata == null || metadata.gainDb != null) return;
+
+      final streamUrl = await ProxyService().registerCacheStream(
+        streamId,
+        _getCacheFilePath(cacheKey),
+        cacheFileKey,
+      );
+      if (streamUrl == null) {
+        print('⚠️ [CacheService] 代理未运行，暂不分析响度: ${metadata.songName}');
+        return;
+      }
+      final result = await Isolate.run(() => NativeLoudness.analyze(streamUrl));
+
+      // 分析期间缓存被删除或重新写入
+      if (!identical(_cacheIndex[cacheKey], metadata)) return;
+
+      if (result == null) {
+        // 无法解码或整首静音：不调整，也不再重复分析
+        print('⚠️ [CacheService] 响度分析失败: ${metadata.songName}');
+        _cacheIndex[cacheKey] = metadata.withLoudness(0, 0);
+      } else {
+        final gainDb = math.min(_targetLoudness - result.integratedLufs,
+            _peakCeiling - result.truePeakDb);
+        _cacheIndex[cacheKey] = metadata.withLoudness(gainDb, result.truePeakDb);
+        print('🎚️ [CacheService] 响度分析: ${metadata.songName} '
+            '${result.integratedLufs.toStringAsFixed(1)} LUFS, '
+            '峰值 ${result.truePeakDb.toStringAsFixed(1)} dBTP, '
+            '增益 ${gainDb.toStringAsFixed(1)} dB');
+      }
+      await _saveCacheIndex(cacheKey);
+    } catch (e) {
+      print('⚠️ [CacheService] 响度分析异常: $e');
+    } finally {
+      ProxyService().unregisterCacheStream(streamId);
+      _loudnessPending.remove(cacheKey);
+    }
+  }
+
+  /// 排队把一首旧格式（v1 / v2 异或加密）缓存文件升级为 v3
+  ///
+  /// 每首歌每次启动只检查一次；已是 v3 的文件在原生侧只解析文件头就返回。
+  /// 升级写入新文件后原子替换，正在播放的映射不受影响。
+  void _scheduleUpgrade(String cacheKey) {
+    final key = _fileKey;
+    if (key == null || !NativeCyreneWriter.isAvailable) return;
+    if (!_upgradeChecked.add(cacheKey)) return;
+    _upgradeQueue = _upgradeQueue.then((_) => _upgradeCacheFile(cacheKey, key));
+  }
+
+  Future<void> _upgradeCacheFile(String cacheKey, Uint8List key) async {
+    // 正在重新写入的歌曲留到下次访问
+    if (!_cacheIndex.containsKey(cacheKey) || _ingesting.contains(cacheKey)) {
+      _upgradeChecked.remove(cacheKey);
+      return;
+    }
+    try {
+      final cacheFilePath = _getCacheFilePath(cacheKey);
+      final upgraded = await Isolate.run(
+        () => NativeCyreneWriter.upgrade(cacheFilePath, key),
+      );
+      if (!upgraded) {
+        print('⚠️ [CacheService] 缓存文件升级失败: $cacheKey');
+      }
+    } catch (e) {
+      print('⚠️ [CacheService] 缓存文件升级异常: $e');
+    }
+  }
+
+  /// 流式下载并写入 v1 格式（原生管线不可用时）
+  ///
+  /// 响应体逐块计算 MD5、按偏移加密后追加到 `.part` 文件，完成后重命名，
+  /// 内存占用与歌曲大小无关。
+  Future<CacheIngestResult> _ingestStreaming(
+    String url,
+    String cacheFilePath,
+    Uint8List metadataBytes,
+  ) async {
+    final partFile = File('$cacheFilePath.part');
+    final client = http.Client();
+    RandomAccessFile? output;
+    var statusCode = 0;
+    var size = 0;
+    var success = false;
+    String checksum = '';
+    try {
+      final response = await client.send(http.Request('GET', Uri.parse(url)));
+      statusCode = response.statusCode;
+      if (statusCode != 200) {
+        await response.stream.drain<void>();
+      } else {
+        // 格式: [4字节元数据长度] [元数据JSON] [加密的音频数据]
+        output = await partFile.open(mode: FileMode.write);
+        final header = ByteData(4)..setUint32(0, metadataBytes.length);
+        await output.writeFrom(header.buffer.asUint8List());
+        await output.writeFrom(metadataBytes);
+
+        final digest = _DigestSink();
+        final hasher = md5.startChunkedConversion(digest);
+        await for (final chunk in response.stream) {
+          hasher.add(chunk);
+          final data = chunk is Uint8List ? chunk : Uint8List.fromList(chunk);
+          await output.writeFrom(_encryptData(data, offset: size));
+          size += data.length;
+        }
+        hasher.close();
+        await output.flush();
+        await output.close();
+        output = null;
+
+        final expected = response.contentLength;
+        if (expected == null || expected == size) {
+          await partFile.rename(cacheFilePath);
+          checksum = digest.value.toString();
+          success = true;
+        }
+      }
+    } catch (e) {
+      print('❌ [CacheService] 流式写入失败: $e');
+    } finally {
+      client.close();
+      await output?.close();
+      if (!success && await partFile.exists()) {
+        await partFile.delete();
+      }
+    }
+    return CacheIngestResult(
+      success: success,
+      statusCode: statusCode,
+      size: size,
+      checksum: checksum,
+    );
+  }
+
   /// 加载缓存索引
   Future<void> _loadCacheIndex() async {
     try {
-      final indexFile = File('${_cacheDir!.path}/cache_index.cyrene');
+      final indexFile = File('${_cacheDir!.path}/$_legacyIndexFileName');
+
+      _indexStore?.close();
+      _indexStore = NativeRecordStore.open('${_cacheDir!.path}/$_indexStoreFileName');
+      final store = _indexStore;
+      if (store != null) {
+        _cacheIndex = {};
+        final legacyKeys = <String>[];
+        for (final entry in store.entries().entries) {
+          try {
+            final bytes = _openRecord(entry.value);
+            _cacheIndex[entry.key] =
+                CacheMetadata.fromRecord(bytes ?? _decryptData(entry.value));
+            if (bytes == null) legacyKeys.add(entry.key);
+          } catch (e) {
+            // 安装密钥丢失后的记录无法解密，对应的缓存文件也无法读取，
+            // 跳过后由缓存管理器按容量上限淘汰
+            print('⚠️ [CacheService] 无法解析缓存索引记录: ${entry.key}');
+          }
+        }
+
+        // 旧版异或加密的记录重新以 AES 加密保存
+        if (_recordCipher != null && legacyKeys.isNotEmpty) {
+          for (final key in legacyKeys) {
+            await _saveCacheIndex(key);
+          }
+          print('🔐 [CacheService] 已重新加密 ${legacyKeys.length} 条缓存索引记录');
+        }
+
+        // 旧版 JSON 索引一次性迁移后删除
+        if (await indexFile.exists()) {
+          try {
+            final indexJson = utf8.decode(_decryptData(await indexFile.readAsBytes()));
+            for (final entry in (jsonDecode(indexJson) as Map<String, dynamic>).entries) {
+              _cacheIndex[entry.key] = CacheMetadata.fromJson(entry.value);
+            }
+            await _saveCacheIndex();
+            store.checkpoint();
+            await indexFile.delete();
+            print('📦 [CacheService] 已迁移旧版缓存索引');
+          } catch (e) {
+            print('⚠️ [CacheService] 迁移旧版缓存索引失败: $e');
+          }
+        }
+
+        print('📑 [CacheService] 加载缓存索引: ${_cacheIndex.length} 条记录');
+        return;
+      }
 
       if (await indexFile.exists()) {
         print('📑 [CacheService] 发现缓存索引文件，读取中...');
@@ -462,9 +936,27 @@ class CacheService extends ChangeNotifier {
   }
 
   /// 保存缓存索引
-  Future<void> _saveCacheIndex() async {
+  ///
+  /// 指定 [changedKey] 时只写入这一条（原生存储可用时为 O(1) 追加），
+  /// 否则整体重写。
+  Future<void> _saveCacheIndex([String? changedKey]) async {
+    final store = _indexStore;
+    if (store != null) {
+      final keys = changedKey != null ? [changedKey] : _cacheIndex.keys;
+      if (changedKey == null) store.clear();
+      for (final key in keys) {
+        final metadata = _cacheIndex[key];
+        if (metadata == null) {
+          store.delete(key);
+        } else if (!store.put(key, _sealRecord(metadata.toRecord()))) {
+          print('❌ [CacheService] 保存缓存索引失败: $key');
+        }
+      }
+      return;
+    }
+
     try {
-      final indexFile = File('${_cacheDir!.path}/cache_index.cyrene');
+      final indexFile = File('${_cacheDir!.path}/$_legacyIndexFileName');
       final indexData = <String, dynamic>{};
 
       for (final entry in _cacheIndex.entries) {
@@ -487,7 +979,21 @@ class CacheService extends ChangeNotifier {
   }
 
   /// 获取缓存统计信息
+  ///
+  /// 原生缓存管理器可用时直接读取它的计数器，不遍历缓存索引。
   Future<CacheStats> getCacheStats() async {
+    final manager = _manager;
+    if (manager != null) {
+      final stats = manager.stats;
+      return CacheStats(
+        totalFiles: stats.totalFiles,
+        totalSize: stats.totalSize,
+        neteaseCount: manager.sourceCount('netease'),
+        qqCount: manager.sourceCount('qq'),
+        kugouCount: manager.sourceCount('kugou'),
+      );
+    }
+
     int totalSize = 0;
     int neteaseCount = 0;
     int qqCount = 0;
@@ -525,17 +1031,24 @@ class CacheService extends ChangeNotifier {
     try {
       print('🗑️ [CacheService] 清除所有缓存...');
 
-      // 删除所有缓存文件
+      // 删除所有缓存文件（索引存储和访问记录正在使用，稍后清空）
       final files = await _cacheDir!.list().toList();
       for (final file in files) {
-        if (file is File) {
+        final name = path.basename(file.path);
+        if (file is File &&
+            !name.startsWith(_indexStoreFileName) &&
+            !name.startsWith(_accessStoreFileName)) {
           await file.delete();
         }
       }
 
       // 清空索引
+      for (final cacheKey in _cacheIndex.keys) {
+        ProxyService().unregisterCacheStream(cacheKey);
+      }
       _cacheIndex.clear();
       await _saveCacheIndex();
+      _manager?.clear();
 
       print('✅ [CacheService] 缓存已清除');
       notifyListeners();
@@ -567,7 +1080,9 @@ class CacheService extends ChangeNotifier {
 
       // 从索引中移除
       _cacheIndex.remove(cacheKey);
-      await _saveCacheIndex();
+      ProxyService().unregisterCacheStream(cacheKey);
+      await _saveCacheIndex(cacheKey);
+      _manager?.erase(cacheKey);
 
       print('🗑️ [CacheService] 删除缓存: ${track.name}');
       notifyListeners();
@@ -576,6 +1091,38 @@ class CacheService extends ChangeNotifier {
     }
   }
 
+  /// 删除无法打开或解密的缓存：文件、索引条目和缓存管理器中的记录一并移除，
+  /// 避免损坏的文件继续占用容量上限
+  Future<void> _dropBrokenCache(String cacheKey) async {
+    _cacheIndex.remove(cacheKey);
+    ProxyService().unregisterCacheStream(cacheKey);
+    try {
+      final cacheFile = File(_getCacheFilePath(cacheKey));
+      if (await cacheFile.exists()) await cacheFile.delete();
+    } catch (e) {
+      print('⚠️ [CacheService] 删除损坏的缓存文件失败: $e');
+    }
+    await _saveCacheIndex(cacheKey);
+    _manager?.erase(cacheKey);
+    notifyListeners();
+  }
+
+  /// 超出容量上限时按淘汰策略删除缓存，并同步缓存索引
+  Future<void> _evictOverBudget() async {
+    final evicted = _manager?.evict() ?? const <String>[];
+    if (evicted.isEmpty) return;
+
+    for (final cacheKey in evicted) {
+      _cacheIndex.remove(cacheKey);
+      ProxyService().unregisterCacheStream(cacheKey);
+      await _saveCacheIndex(cacheKey);
+    }
+    final stats = _manager!.stats;
+    print('🧹 [CacheService] 超出容量上限，淘汰 ${evicted.length} 首缓存'
+        '（剩余 ${stats.totalFiles} 首, ${stats.totalSize ~/ (1024 * 1024)} MB）');
+    notifyListeners();
+  }
+
   /// 获取缓存列表
   List<CacheMetadata> getCachedList() {
     return _cacheIndex.values.toList()
@@ -585,7 +1132,7 @@ class CacheService extends ChangeNotifier {
   /// 清理临时文件
   Future<void> cleanTempFiles() async {
     try {
-      final tempDir = await getTemporaryDirectory();
+      final tempDir = await tempDirectory();
       final files = await tempDir.list().toList();
 
       for (final file in files) {
@@ -604,6 +1151,37 @@ class CacheService extends ChangeNotifier {
     }
   }
 
+  /// 加载或生成本机安装密钥（需要原生 AES 内核）
+  ///
+  /// 密钥先写入设置再启用，避免写出下次启动无法解密的文件。
+  Future<void> _loadFileKey(SharedPreferences prefs) async {
+    Uint8List? key;
+    final saved = prefs.getString(_fileKeyPref);
+    if (saved != null) {
+      try {
+        key = base64Decode(saved);
+      } catch (_) {}
+    }
+    if (key == null || key.length != 16) {
+      key = Uint8List(16);
+      for (int i = 0; i < key.length; i++) {
+        key[i] = _secureRandom.nextInt(256);
+      }
+      // 原生库不可用的平台不生成密钥，继续使用异或加密
+      final probe = NativeAesCtr.create(key);
+      if (probe == null) return;
+      probe.dispose();
+      if (!await prefs.setString(_fileKeyPref, base64Encode(key))) return;
+      print('🔐 [CacheService] 已生成缓存加密密钥');
+    }
+
+    final cipher = NativeAesCtr.create(key);
+    if (cipher == null) return;
+    _recordCipher?.dispose();
+    _recordCipher = cipher;
+    _fileKey = key;
+  }
+
   /// 加载缓存设置
   Future<void> _loadSettings() async {
     try {
@@ -614,6 +1192,16 @@ class CacheService extends ChangeNotifier {
       
       // 加载自定义缓存目录
       _customCacheDir = prefs.getString('custom_cache_dir');
+
+      // 加载容量上限和淘汰策略
+      _cacheBudget = prefs.getInt('cache_budget_bytes') ?? _defaultCacheBudget;
+      final policyName = prefs.getString('cache_eviction_policy');
+      _evictionPolicy = CacheEvictionPolicy.values.firstWhere(
+        (policy) => policy.name == policyName,
+        orElse: () => CacheEvictionPolicy.lru,
+      );
+
+      await _loadFileKey(prefs);
       
       print('⚙️ [CacheService] 加载设置 - 缓存开关: $_cacheEnabled, 自定义目录: ${_customCacheDir ?? "无"}');
     } catch (e) {
@@ -660,6 +1248,38 @@ class CacheService extends ChangeNotifier {
     }
   }
 
+  /// 设置缓存容量上限（字节，0 表示不限）
+  Future<void> setCacheBudget(int bytes) async {
+    if (_cacheBudget == bytes) return;
+    _cacheBudget = bytes;
+    try {
+      final prefs = await SharedPreferences.getInstance();
+      await prefs.setInt('cache_budget_bytes', bytes);
+      print('💾 [CacheService] 容量上限已保存: $bytes');
+    } catch (e) {
+      print('❌ [CacheService] 保存容量上限失败: $e');
+    }
+    _manager?.setBudget(_cacheBudget, _evictionPolicy);
+    await ProxyService().setStreamCacheLimit(streamCacheBudget);
+    await _evictOverBudget();
+    notifyListeners();
+  }
+
+  /// 设置缓存淘汰策略
+  Future<void> setEvictionPolicy(CacheEvictionPolicy policy) async {
+    if (_evictionPolicy == policy) return;
+    _evictionPolicy = policy;
+    try {
+      final prefs = await SharedPreferences.getInstance();
+      await prefs.setString('cache_eviction_policy', policy.name);
+      print('💾 [CacheService] 淘汰策略已保存: ${policy.name}');
+    } catch (e) {
+      print('❌ [CacheService] 保存淘汰策略失败: $e');
+    }
+    _manager?.setBudget(_cacheBudget, _evictionPolicy);
+    notifyListeners();
+  }
+
   /// 设置自定义缓存目录
   Future<bool> setCustomCacheDir(String? dirPath) async {
     try {
@@ -712,3 +1332,13 @@ class CacheService extends ChangeNotifier {
   }
 }
 
+/// 接收分块 MD5 的最终结果
+class _DigestSink implements Sink<Digest> {
+  late Digest value;
+
+  @override
+  void add(Digest data) => value = data;
+
+  @override
+  void close() {}
+}
@@ -0,0 +1,102 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'dart:ui' show Rect;
+import 'package:crypto/crypto.dart';
+import 'package:path/path.dart' as path;
+import 'package:path_provider/path_provider.dart';
+import '../native/palette_native.dart';
+import '../native/record_store_native.dart';
+import 'cover_thumbnail_service.dart';
+
+/// 封面调色板服务
+///
+/// 用原生取色（native/palette.cc）一次得到整张封面和底部区域的调色板，
+/// 按封面 URL 的 MD5 缓存在内存与记录存储（palette_cache.store）中，
+/// 同一张封面只下载、解码一次。原生库不可用时 [getPalette] 返回 null，
+/// 调用方应回退到 PaletteGenerator。
+class CoverPaletteService {
+  static final CoverPaletteService _instance = CoverPaletteService._internal();
+  factory CoverPaletteService() => _instance;
+  CoverPaletteService._internal();
+
+  static const String _storeFileName = 'palette_cache.store';
+
+  /// 底部区域（移动端渐变模式取色用），为封面高度的后 30%
+  static const Rect bottomRegion = Rect.fromLTRB(0, 0.7, 1, 1);
+
+  final Map<String, CoverPalette> _memoryCache = {};
+  final Map<String, Future<CoverPalette?>> _pending = {};
+  Future<NativeRecordStore?>? _store;
+
+  /// 获取 [imageUrl]（网络地址或本地路径）的调色板
+  Future<CoverPalette?> getPalette(String imageUrl) async {
+    if (imageUrl.isEmpty || !NativePalette.isAvailable) return null;
+
+    final key = md5.convert(utf8.encode(imageUrl)).toString();
+    final cached = _memoryCache[key];
+    if (cached != null) return cached;
+
+    // 同一封面的并发请求共用一次提取
+    return _pending[key] ??= _load(key, imageUrl).whenComplete(() {
+      _pending.remove(key);
+    });
+  }
+
+  Future<CoverPalette?> _load(String key, String imageUrl) async {
+    final store = await (_store ??= _openStore());
+    final record = store?.get(key);
+    if (record != null) {
+      final palette = _decode(record);
+      _memoryCache[key] = palette;
+      return palette;
+    }
+
+    final bytes = await CoverThumbnailService.fetchCover(imageUrl);
+    if (bytes == null) return null;
+
+    final palette = await _extractInBackground(bytes);
+    if (palette == null) {
+      print('⚠️ [CoverPaletteService] 无法解码封面: $imageUrl');
+      return null;
+    }
+
+    _memoryCache[key] = palette;
+    store?.put(key, _encode(palette));
+    return palette;
+  }
+
+  /// 在后台 isolate 中取色（闭包只捕获 [bytes]）
+  static Future<CoverPalette?> _extractInBackground(Uint8List bytes) {
+    return Isolate.run(() => NativePalette.extract(bytes, region: bottomRegion));
+  }
+
+  Future<NativeRecordStore?> _openStore() async {
+    try {
+      final supportDir = await getApplicationSupportDirectory();
+      return NativeRecordStore.open(path.join(supportDir.path, _storeFileName));
+    } catch (e) {
+      print('⚠️ [CoverPaletteService] 打开调色板缓存失败: $e');
+      return null;
+    }
+  }
+
+  static Uint8List _encode(CoverPalette palette) {
+    final writer = StoreRecordWriter();
+    final argbList = [...palette.full.toArgbList(), ...palette.region.toArgbList()];
+    for (final argb in argbList) {
+      writer.writeInt(argb);
+    }
+    return writer.takeBytes();
+  }
+
+  static CoverPalette _decode(Uint8List record) {
+    final reader = StoreRecordReader(record);
+    final argb = List<int>.generate(14, (_) => reader.readInt());
+    return CoverPalette(
+      full: CoverSwatches.fromArgbList(argb.sublist(0, 7)),
+      region: CoverSwatches.fromArgbList(argb.sublist(7)),
+    );
+  }
+}
@@ -0,0 +1,122 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'package:crypto/crypto.dart';
+import 'package:http/http.dart' as http;
+import 'package:path/path.dart' as path;
+import 'package:path_provider/path_provider.dart';
+import '../native/record_store_native.dart';
+import '../native/thumbnail_cache_native.dart';
+
+/// 封面缩略图服务
+///
+/// 每张封面按内容哈希只存一份 512/256/128/64 四级缩略图（native/
+/// thumbnail_cache.cc），界面按实际绘制尺寸取最接近的一级，避免列表、
+/// 迷你播放器等反复解码原图。封面 URL 到内容哈希的映射保存在记录存储
+/// （cover_thumbnails.store）中。原生库不可用时 [isAvailable] 为 false，
+/// 调用方应直接加载原图。
+class CoverThumbnailService {
+  static final CoverThumbnailService _instance = CoverThumbnailService._internal();
+  factory CoverThumbnailService() => _instance;
+  CoverThumbnailService._internal();
+
+  static const String _directoryName = 'cover_thumbnails';
+  static const String _indexFileName = 'cover_thumbnails.store';
+  static const Duration _fetchTimeout = Duration(seconds: 8);
+
+  /// 原生缩略图是否可用
+  static bool get isAvailable => NativeThumbnailCache.isAvailable;
+
+  /// 不小于 [pixelSize] 的最小级别；超过最大级别时返回 null（应使用原图）
+  static int? levelFor(int pixelSize) {
+    for (final level in NativeThumbnailCache.levels.reversed) {
+      if (level >= pixelSize) return level;
+    }
+    return null;
+  }
+
+  String? _directory;
+  NativeRecordStore? _index;
+  Future<bool>? _opened;
+  final Map<String, String> _hashes = {};
+  final Map<String, Future<String?>> _pending = {};
+
+  /// [imageUrl] 的 [level] 级缩略图路径，首次请求时下载并生成；失败时返回 null
+  Future<String?> thumbnailPath(String imageUrl, int level) async {
+    if (imageUrl.isEmpty || !await (_opened ??= _open())) return null;
+    final directory = _directory!;
+
+    final key = md5.convert(utf8.encode(imageUrl)).toString();
+    final known = _hashes[key] ?? _readIndex(key);
+    if (known != null) {
+      final thumbnail = NativeThumbnailCache.pathFor(directory, known, level);
+      if (await File(thumbnail).exists()) {
+        _hashes[key] = known;
+        return thumbnail;
+      }
+    }
+
+    // 同一封面的并发请求共用一次生成
+    final hash = await (_pending[key] ??= _generate(key, imageUrl).whenComplete(() {
+      _pending.remove(key);
+    }));
+    return hash == null ? null : NativeThumbnailCache.pathFor(directory, hash, level);
+  }
+
+  Future<bool> _open() async {
+    try {
+      final supportDir = await getApplicationSupportDirectory();
+      final directory = Directory(path.join(supportDir.path, _directoryName));
+      await directory.create(recursive: true);
+      _directory = directory.path;
+      _index = NativeRecordStore.open(path.join(supportDir.path, _indexFileName));
+      return true;
+    } catch (e) {
+      print('⚠️ [CoverThumbnailService] 初始化缩略图目录失败: $e');
+      return false;
+    }
+  }
+
+  String? _readIndex(String key) {
+    final value = _index?.get(key);
+    return value == null ? null : utf8.decode(value);
+  }
+
+  Future<String?> _generate(String key, String imageUrl) async {
+    final bytes = await fetchCover(imageUrl);
+    if (bytes == null) return null;
+
+    final hash = await _storeInBackground(_directory!, bytes);
+    if (hash == null) {
+      print('⚠️ [CoverThumbnailService] 无法生成缩略图: $imageUrl');
+      return null;
+    }
+    _hashes[key] = hash;
+    _index?.put(key, utf8.encode(hash));
+    return hash;
+  }
+
+  /// 在后台 isolate 中生成缩略图（闭包只捕获参数）
+  static Future<String?> _storeInBackground(String directory, Uint8List bytes) {
+    return Isolate.run(() => NativeThumbnailCache.store(directory, bytes));
+  }
+
+  /// 读取封面原图：网络地址下载，本地路径（或 file://）直接读取
+  static Future<Uint8List?> fetchCover(String imageUrl) async {
+    if (!imageUrl.startsWith('http')) {
+      final file = File(imageUrl.startsWith('file://')
+          ? Uri.parse(imageUrl).toFilePath()
+          : imageUrl);
+      return await file.exists() ? await file.readAsBytes() : null;
+    }
+
+    final response = await http.get(Uri.parse(imageUrl)).timeout(_fetchTimeout);
+    if (response.statusCode != 200) {
+      print('⚠️ [CoverThumbnailService] 下载封面失败: HTTP ${response.statusCode}');
+      return null;
+    }
+    return response.bodyBytes;
+  }
+}
@@ -1,14 +1,18 @@
 import 'dart:io';
+import 'dart:typed_data';
 import 'package:flutter/services.dart';
 import 'package:shared_preferences/shared_preferences.dart';
+import '../models/lyric_line.dart';
 
-/// 桌面歌词服务（仅Windows平台）
+/// 桌面歌词服务（Windows / Linux）
 /// 
 /// 提供系统级桌面歌词功能，包括：
 /// - 创建/销毁桌面歌词窗口
 /// - 显示/隐藏歌词
 /// - 自定义字体、颜色、描边
 /// - 拖动和鼠标穿透设置
+/// - 原生逐字高亮（卡拉OK）：整份歌词只发送一次，由原生定时器按播放进度推进，
+///   Dart 侧只需偶尔同步进度
 class DesktopLyricService {
   static final DesktopLyricService _instance = DesktopLyricService._internal();
   factory DesktopLyricService() => _instance;
@@ -16,6 +20,9 @@ class DesktopLyricService {
 
   static const MethodChannel _channel = MethodChannel('desktop_lyric');
 
+  /// 当前平台是否有原生桌面歌词实现（Windows: GDI+ 分层窗口，Linux: GTK 透明窗口）
+  static bool get isSupported => Platform.isWindows || Platform.isLinux;
+
   // 配置项的SharedPreferences键
   static const String _keyEnabled = 'desktop_lyric_enabled';
   static const String _keyFontSize = 'desktop_lyric_font_size';
@@ -26,6 +33,14 @@ class DesktopLyricService {
   static const String _keyPositionY = 'desktop_lyric_position_y';
   static const String _keyDraggable = 'desktop_lyric_draggable';
   static const String _keyMouseTransparent = 'desktop_lyric_mouse_transparent';
+  static const String _keyHighlightColor = 'desktop_lyric_highlight_color';
+
+  // 进度同步：原生时钟自行插值，仅在偏差过大或间隔过久时才同步
+  static const int _syncIntervalMs = 2000;
+  static const int _syncDriftThresholdMs = 250;
+
+  // applyStyle 二进制格式版本，与 native/lyric_style.h 保持一致
+  static const int _styleVersion = 1;
 
   bool _isCreated = false;
   bool _isVisible = false;
@@ -38,10 +53,17 @@ class DesktopLyricService {
   int _strokeWidth = 2;
   bool _isDraggable = true;
   bool _isMouseTransparent = false;
+  int _highlightColor = 0xFF4FC3F7; // 浅蓝
+
+  // 当前歌词文档（原生卡拉OK模式）
+  List<Map<String, dynamic>>? _lyricDocument;
+  int _lastSyncPositionMs = 0;
+  bool _lastSyncPlaying = false;
+  DateTime? _lastSyncTime;
 
   /// 初始化服务（加载配置）
   Future<void> initialize() async {
-    if (!Platform.isWindows) return;
+    if (!isSupported) return;
 
     try {
       final prefs = await SharedPreferences.getInstance();
@@ -54,6 +76,7 @@ class DesktopLyricService {
       _strokeWidth = prefs.getInt(_keyStrokeWidth) ?? 2;
       _isDraggable = prefs.getBool(_keyDraggable) ?? true;
       _isMouseTransparent = prefs.getBool(_keyMouseTransparent) ?? false;
+      _highlightColor = prefs.getInt(_keyHighlightColor) ?? 0xFF4FC3F7;
 
       // 延迟创建窗口，确保不阻塞主窗口启动
       Future.delayed(Duration(milliseconds: 500), () async {
@@ -61,13 +84,17 @@ class DesktopLyricService {
           // 创建窗口
           await _createWindow();
 
-          // 应用配置
-          await setFontSize(_fontSize, saveToPrefs: false);
-          await setTextColor(_textColor, saveToPrefs: false);
-          await setStrokeColor(_strokeColor, saveToPrefs: false);
-          await setStrokeWidth(_strokeWidth, saveToPrefs: false);
-          await setDraggable(_isDraggable, saveToPrefs: false);
-          await setMouseTransparent(_isMouseTransparent, saveToPrefs: false);
+          // 应用配置（一次调用、一次重绘）
+          await applyStyle(
+            fontSize: _fontSize,
+            textColor: _textColor,
+            strokeColor: _strokeColor,
+            strokeWidth: _strokeWidth,
+            highlightColor: _highlightColor,
+            draggable: _isDraggable,
+            mouseTransparent: _isMouseTransparent,
+            saveToPrefs: false,
+          );
 
           // 恢复位置
           final x = prefs.getInt(_keyPositionX);
@@ -93,11 +120,15 @@ class DesktopLyricService {
 
   /// 创建桌面歌词窗口
   Future<bool> _createWindow() async {
-    if (!Platform.isWindows || _isCreated) return true;
+    if (!isSupported || _isCreated) return true;
 
     try {
       final result = await _channel.invokeMethod('create');
       _isCreated = result == true;
+      // 窗口创建前已加载的歌词文档补发给原生层
+      if (_isCreated && _lyricDocument != null) {
+        await _sendLyricDocument();
+      }
       return _isCreated;
     } catch (e) {
       print('❌ [DesktopLyric] 创建窗口失败: $e');
@@ -107,7 +138,7 @@ class DesktopLyricService {
 
   /// 显示桌面歌词
   Future<void> show() async {
-    if (!Platform.isWindows) return;
+    if (!isSupported) return;
     
     // 如果窗口还未创建，先创建
     if (!_isCreated) {
@@ -121,6 +152,7 @@ class DesktopLyricService {
     try {
       await _channel.invokeMethod('show');
       _isVisible = true;
+      _lastSyncTime = null; // 下一次进度立即同步
       
       // 保存启用状态
       final prefs = await SharedPreferences.getInstance();
@@ -132,7 +164,7 @@ class DesktopLyricService {
 
   /// 隐藏桌面歌词
   Future<void> hide() async {
-    if (!Platform.isWindows || !_isCreated) return;
+    if (!isSupported || !_isCreated) return;
 
     try {
       await _channel.invokeMethod('hide');
@@ -157,9 +189,10 @@ class DesktopLyricService {
 
   /// 设置歌词文本
   Future<void> setLyricText(String text) async {
-    if (!Platform.isWindows) return;
+    if (!isSupported) return;
     
     _currentLyric = text;
+    _lyricDocument = null; // 原生层收到纯文本后退出卡拉OK模式
     
     // 如果窗口未创建，只保存文本，不实际设置
     if (!_isCreated) return;
@@ -171,9 +204,79 @@ class DesktopLyricService {
     }
   }
 
+  /// 设置完整歌词文档（原生卡拉OK模式）
+  ///
+  /// 每首歌只发送一次；之后由原生定时器推进当前行和逐字高亮，
+  /// 只需通过 [syncPosition] 偶尔同步播放进度。带逐字时间（YRC/QRC）的行
+  /// 按字推进，其余行由原生层按行时长匀速推进。
+  Future<void> setLyricDocument(List<LyricLine> lines) async {
+    if (!isSupported) return;
+
+    _lyricDocument = lines.map((line) => <String, dynamic>{
+      'time': line.startTime.inMilliseconds,
+      'text': line.text,
+      if (line.translation != null && line.translation!.isNotEmpty)
+        'translation': line.translation,
+      if (line.words != null && line.words!.isNotEmpty)
+        'words': line.words!.map((word) => <String, dynamic>{
+          'time': word.startTime.inMilliseconds,
+          'duration': word.duration.inMilliseconds,
+          'text': word.text,
+        }).toList(),
+    }).toList();
+    _lastSyncTime = null;
+
+    if (!_isCreated) return;
+    await _sendLyricDocument();
+  }
+
+  Future<void> _sendLyricDocument() async {
+    try {
+      await _channel.invokeMethod('setLyricDocument', {'lines': _lyricDocument});
+      print('✅ [DesktopLyric] 歌词文档已发送到原生层: ${_lyricDocument!.length} 行');
+    } catch (e) {
+      print('❌ [DesktopLyric] 设置歌词文档失败: $e');
+    }
+  }
+
+  /// 是否处于原生卡拉OK模式（已发送歌词文档）
+  bool get hasLyricDocument => _lyricDocument != null && _lyricDocument!.isNotEmpty;
+
+  /// 同步播放进度（原生卡拉OK模式）
+  ///
+  /// 播放器的进度回调很频繁，但原生时钟会自行插值：只有播放状态变化、
+  /// 与预期位置偏差超过阈值（如拖动进度）或距上次同步过久时才真正发送。
+  void syncPosition(Duration position, {required bool playing}) {
+    if (!isSupported || !_isCreated || !_isVisible || !hasLyricDocument) {
+      return;
+    }
+
+    final now = DateTime.now();
+    final positionMs = position.inMilliseconds;
+    final lastTime = _lastSyncTime;
+    if (lastTime != null && playing == _lastSyncPlaying) {
+      final elapsed = now.difference(lastTime).inMilliseconds;
+      final expected = _lastSyncPositionMs + (playing ? elapsed : 0);
+      if (elapsed < _syncIntervalMs &&
+          (positionMs - expected).abs() < _syncDriftThresholdMs) {
+        return;
+      }
+    }
+
+    _lastSyncTime = now;
+    _lastSyncPositionMs = positionMs;
+    _lastSyncPlaying = playing;
+    _channel.invokeMethod('syncPosition', {
+      'position': positionMs,
+      'playing': playing,
+    }).catchError((e) {
+      // 忽略错误，避免日志刷屏
+    });
+  }
+
   /// 设置窗口位置
   Future<void> setPosition(int x, int y) async {
-    if (!Platform.isWindows || !_isCreated) return;
+    if (!isSupported || !_isCreated) return;
 
     try {
       await _channel.invokeMethod('setPosition', {'x': x, 'y': y});
@@ -189,7 +292,7 @@ class DesktopLyricService {
 
   /// 获取窗口位置
   Future<Map<String, int>?> getPosition() async {
-    if (!Platform.isWindows || !_isCreated) return null;
+    if (!isSupported || !_isCreated) return null;
 
     try {
       final result = await _channel.invokeMethod('getPosition');
@@ -204,111 +307,129 @@ class DesktopLyricService {
   }
 
   /// 设置字体大小
-  Future<void> setFontSize(int size, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
-
-    _fontSize = size;
-
-    try {
-      await _channel.invokeMethod('setFontSize', {'size': size});
-      
-      if (saveToPrefs) {
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.setInt(_keyFontSize, size);
-      }
-    } catch (e) {
-      print('❌ [DesktopLyric] 设置字体大小失败: $e');
-    }
-  }
+  Future<void> setFontSize(int size, {bool saveToPrefs = true}) =>
+      applyStyle(fontSize: size, saveToPrefs: saveToPrefs);
 
   /// 设置文字颜色（ARGB格式）
-  Future<void> setTextColor(int color, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
-
-    _textColor = color;
-
-    try {
-      await _channel.invokeMethod('setTextColor', {'color': color});
-      
-      if (saveToPrefs) {
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.setInt(_keyTextColor, color);
-      }
-    } catch (e) {
-      print('❌ [DesktopLyric] 设置文字颜色失败: $e');
-    }
-  }
+  Future<void> setTextColor(int color, {bool saveToPrefs = true}) =>
+      applyStyle(textColor: color, saveToPrefs: saveToPrefs);
 
   /// 设置描边颜色（ARGB格式）
-  Future<void> setStrokeColor(int color, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
-
-    _strokeColor = color;
-
-    try {
-      await _channel.invokeMethod('setStrokeColor', {'color': color});
-      
-      if (saveToPrefs) {
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.setInt(_keyStrokeColor, color);
-      }
-    } catch (e) {
-      print('❌ [DesktopLyric] 设置描边颜色失败: $e');
-    }
-  }
+  Future<void> setStrokeColor(int color, {bool saveToPrefs = true}) =>
+      applyStyle(strokeColor: color, saveToPrefs: saveToPrefs);
 
   /// 设置描边宽度
-  Future<void> setStrokeWidth(int width, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
+  Future<void> setStrokeWidth(int width, {bool saveToPrefs = true}) =>
+      applyStyle(strokeWidth: width, saveToPrefs: saveToPrefs);
 
-    _strokeWidth = width;
-
-    try {
-      await _channel.invokeMethod('setStrokeWidth', {'width': width});
-      
-      if (saveToPrefs) {
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.setInt(_keyStrokeWidth, width);
-      }
-    } catch (e) {
-      print('❌ [DesktopLyric] 设置描边宽度失败: $e');
-    }
-  }
+  /// 设置逐字高亮颜色（ARGB格式）
+  Future<void> setHighlightColor(int color, {bool saveToPrefs = true}) =>
+      applyStyle(highlightColor: color, saveToPrefs: saveToPrefs);
 
   /// 设置是否可拖动
-  Future<void> setDraggable(bool draggable, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
+  Future<void> setDraggable(bool draggable, {bool saveToPrefs = true}) =>
+      applyStyle(draggable: draggable, saveToPrefs: saveToPrefs);
 
-    _isDraggable = draggable;
+  /// 设置鼠标穿透
+  Future<void> setMouseTransparent(bool transparent, {bool saveToPrefs = true}) =>
+      applyStyle(mouseTransparent: transparent, saveToPrefs: saveToPrefs);
+
+  /// 一次性应用多项样式
+  ///
+  /// 所有改动打包成一个紧凑的二进制结构（格式见 native/lyric_style.h），
+  /// 一次方法调用送达原生层并只触发一次重绘；应用整套主题不再是
+  /// 每个属性各一次往返、各一次重绘。
+  Future<void> applyStyle({
+    int? fontSize,
+    int? textColor,
+    int? strokeColor,
+    int? strokeWidth,
+    int? highlightColor,
+    bool? draggable,
+    bool? mouseTransparent,
+    bool saveToPrefs = true,
+  }) async {
+    if (!isSupported || !_isCreated) return;
+
+    if (fontSize != null) _fontSize = fontSize;
+    if (textColor != null) _textColor = textColor;
+    if (strokeColor != null) _strokeColor = strokeColor;
+    if (strokeWidth != null) _strokeWidth = strokeWidth;
+    if (highlightColor != null) _highlightColor = highlightColor;
+    if (draggable != null) _isDraggable = draggable;
+    if (mouseTransparent != null) _isMouseTransparent = mouseTransparent;
 
     try {
-      await _channel.invokeMethod('setDraggable', {'draggable': draggable});
-      
+      await _channel.invokeMethod('applyStyle', _encodeStyle(
+        fontSize: fontSize,
+        textColor: textColor,
+        strokeColor: strokeColor,
+        strokeWidth: strokeWidth,
+        highlightColor: highlightColor,
+        draggable: draggable,
+        mouseTransparent: mouseTransparent,
+      ));
+
       if (saveToPrefs) {
         final prefs = await SharedPreferences.getInstance();
-        await prefs.setBool(_keyDraggable, draggable);
+        if (fontSize != null) await prefs.setInt(_keyFontSize, fontSize);
+        if (textColor != null) await prefs.setInt(_keyTextColor, textColor);
+        if (strokeColor != null) await prefs.setInt(_keyStrokeColor, strokeColor);
+        if (strokeWidth != null) await prefs.setInt(_keyStrokeWidth, strokeWidth);
+        if (highlightColor != null) await prefs.setInt(_keyHighlightColor, highlightColor);
+        if (draggable != null) await prefs.setBool(_keyDraggable, draggable);
+        if (mouseTransparent != null) {
+          await prefs.setBool(_keyMouseTransparent, mouseTransparent);
+        }
       }
     } catch (e) {
-      print('❌ [DesktopLyric] 设置拖动状态失败: $e');
+      print('❌ [DesktopLyric] 应用样式失败: $e');
     }
   }
 
-  /// 设置鼠标穿透
-  Future<void> setMouseTransparent(bool transparent, {bool saveToPrefs = true}) async {
-    if (!Platform.isWindows || !_isCreated) return;
-
-    _isMouseTransparent = transparent;
-
-    try {
-      await _channel.invokeMethod('setMouseTransparent', {'transparent': transparent});
-      
-      if (saveToPrefs) {
-        final prefs = await SharedPreferences.getInstance();
-        await prefs.setBool(_keyMouseTransparent, transparent);
+  /// 编码样式更新：u8 版本 | u16 字段位图 | 按位序排列的字段（大端序）
+  static Uint8List _encodeStyle({
+    int? fontSize,
+    int? textColor,
+    int? strokeColor,
+    int? strokeWidth,
+    int? highlightColor,
+    bool? draggable,
+    bool? mouseTransparent,
+  }) {
+    final ints = [fontSize, textColor, strokeColor, strokeWidth, highlightColor];
+    final flags = [draggable, mouseTransparent];
+
+    var fields = 0;
+    var length = 3;
+    for (var i = 0; i < ints.length; i++) {
+      if (ints[i] != null) {
+        fields |= 1 << i;
+        length += 4;
       }
-    } catch (e) {
-      print('❌ [DesktopLyric] 设置鼠标穿透失败: $e');
     }
+    for (var i = 0; i < flags.length; i++) {
+      if (flags[i] != null) {
+        fields |= 1 << (ints.length + i);
+        length += 1;
+      }
+    }
+
+    final data = ByteData(length);
+    data.setUint8(0, _styleVersion);
+    data.setUint16(1, fields);
+    var offset = 3;
+    for (final value in ints) {
+      if (value == null) continue;
+      data.setUint32(offset, value & 0xFFFFFFFF);
+      offset += 4;
+    }
+    for (final flag in flags) {
+      if (flag == null) continue;
+      data.setUint8(offset, flag ? 1 : 0);
+      offset += 1;
+    }
+    return data.buffer.asUint8List();
   }
 
   /// 检查是否可见
@@ -323,13 +444,14 @@ class DesktopLyricService {
     'textColor': _textColor,
     'strokeColor': _strokeColor,
     'strokeWidth': _strokeWidth,
+    'highlightColor': _highlightColor,
     'isDraggable': _isDraggable,
     'isMouseTransparent': _isMouseTransparent,
   };
 
   /// 销毁窗口（应用退出时调用）
   Future<void> dispose() async {
-    if (!Platform.isWindows || !_isCreated) return;
+    if (!isSupported || !_isCreated) return;
 
     try {
       // 保存当前位置
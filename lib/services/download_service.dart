@@ -1,5 +1,6 @@
 import 'dart:io';
 import 'dart:convert';
+import 'dart:isolate';
 import 'dart:typed_data';
 import 'package:flutter/foundation.dart';
 import 'package:path_provider/path_provider.dart';
@@ -8,6 +9,9 @@ import 'package:http/http.dart' as http;
 import 'package:crypto/crypto.dart';
 import '../models/track.dart';
 import '../models/song_detail.dart';
+import '../native/cyrene_file_native.dart';
+import '../native/download_engine_native.dart';
+import '../native/xor_cipher_native.dart';
 import 'cache_service.dart';
 
 /// 下载进度回调
@@ -42,9 +46,16 @@ class DownloadService extends ChangeNotifier {
     _loadDownloadPath();
   }
 
-  // 加密密钥（与 CacheService 保持一致）
+  // 旧版加密密钥（与 CacheService 保持一致，Dart 回退路径解密 v1 缓存用）
   static const String _encryptionKey = 'CyreneMusicCacheKey2025';
 
+  // 轮询原生下载引擎进度的间隔
+  static const Duration _enginePollInterval = Duration(milliseconds: 200);
+
+  // 原生 XOR 内核（不可用时为 null，使用 Dart 循环）
+  static final NativeXorCipher? _nativeCipher =
+      NativeXorCipher.create(Uint8List.fromList(utf8.encode(_encryptionKey)));
+
   String? _downloadPath;
   final Map<String, DownloadTask> _downloadTasks = {};
 
@@ -145,16 +156,20 @@ class DownloadService extends ChangeNotifier {
     }
   }
 
-  /// 解密缓存数据
+  /// 解密缓存数据（原地处理）
   Uint8List _decryptData(Uint8List encryptedData) {
-    final keyBytes = utf8.encode(_encryptionKey);
-    final decrypted = Uint8List(encryptedData.length);
+    final cipher = _nativeCipher;
+    if (cipher != null) {
+      cipher.apply(encryptedData);
+      return encryptedData;
+    }
 
+    final keyBytes = utf8.encode(_encryptionKey);
     for (int i = 0; i < encryptedData.length; i++) {
-      decrypted[i] = encryptedData[i] ^ keyBytes[i % keyBytes.length];
+      encryptedData[i] ^= keyBytes[i % keyBytes.length];
     }
 
-    return decrypted;
+    return encryptedData;
   }
 
   /// 生成安全的文件名
@@ -183,6 +198,19 @@ class DownloadService extends ChangeNotifier {
         return false;
       }
 
+      // 原生读取器可用时在后台 isolate 中分块解密写出，不把整个文件读入内存
+      if (NativeCyreneFile.isAvailable) {
+        final keyBytes = cacheService.cacheFileKey;
+        final extracted = await Isolate.run(
+          () => NativeCyreneFile.extract(cacheFilePath, keyBytes, outputPath),
+        );
+        if (extracted) {
+          print('✅ [DownloadService] 从缓存下载成功: $outputPath');
+          return true;
+        }
+        print('⚠️ [DownloadService] 原生解密失败，回退到 Dart 实现');
+      }
+
       // 读取 .cyrene 文件
       final fileData = await cacheFile.readAsBytes();
 
@@ -221,15 +249,70 @@ class DownloadService extends ChangeNotifier {
     }
   }
 
-  /// 直接下载音频文件
-  Future<bool> _downloadFromUrl(
+  /// 各平台 CDN 要求的 Referer（没有要求时为 null）
+  String? _refererFor(Track track) {
+    switch (track.source) {
+      case MusicSource.qq:
+        return 'https://y.qq.com';
+      case MusicSource.kugou:
+        return 'https://www.kugou.com';
+      default:
+        return null;
+    }
+  }
+
+  /// 用原生分段引擎下载（支持断点续传），引擎不可用时返回 null
+  Future<bool?> _downloadWithEngine(
     String url,
     String outputPath,
+    String? referer,
     DownloadProgressCallback? onProgress,
   ) async {
+    if (!NativeDownloadEngine.isAvailable) return null;
+
+    final id = NativeDownloadEngine.start(url, outputPath, referer: referer);
+    if (id == 0) return null;
+
+    try {
+      while (true) {
+        await Future.delayed(_enginePollInterval);
+        final progress = NativeDownloadEngine.progress(id);
+        if (progress == null) return false;
+
+        if (progress.total > 0 && onProgress != null) {
+          onProgress(progress.received / progress.total);
+        }
+        if (!progress.isFinished) continue;
+
+        if (progress.state == NativeDownloadState.done) {
+          final speed = progress.bytesPerSecond / 1024 / 1024;
+          print('✅ [DownloadService] 分段下载完成: $outputPath '
+              '(${speed.toStringAsFixed(1)} MB/s, md5 ${progress.md5})');
+          return true;
+        }
+        print('❌ [DownloadService] 分段下载失败: HTTP ${progress.httpStatus}');
+        return false;
+      }
+    } finally {
+      NativeDownloadEngine.remove(id);
+    }
+  }
+
+  /// 直接下载音频文件
+  Future<bool> _downloadFromUrl(
+    String url,
+    String outputPath,
+    DownloadProgressCallback? onProgress, {
+    String? referer,
+  }) async {
     try {
       print('🌐 [DownloadService] 从网络下载: $url');
 
+      // Linux 上交给原生引擎：多连接分段下载，中断后从已完成的分段续传
+      final viaEngine =
+          await _downloadWithEngine(url, outputPath, referer, onProgress);
+      if (viaEngine != null) return viaEngine;
+
       final request = http.Request('GET', Uri.parse(url));
       final response = await request.send();
 
@@ -311,6 +394,7 @@ class DownloadService extends ChangeNotifier {
             notifyListeners();
             onProgress?.call(progress);
           },
+          referer: _refererFor(track),
         );
       }
 
@@ -1,9 +1,13 @@
 import 'dart:async';
 import 'dart:io';
+import 'dart:isolate';
 import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
 import 'package:file_picker/file_picker.dart';
 import 'package:path/path.dart' as p;
+import 'package:path_provider/path_provider.dart';
 import '../models/track.dart';
+import '../native/library_scanner_native.dart';
 
 /// 本地音乐库服务：负责扫描目录、管理本地歌曲与歌词
 class LocalLibraryService extends ChangeNotifier {
@@ -19,20 +23,79 @@ class LocalLibraryService extends ChangeNotifier {
   /// 歌词扩展名
   static const String lyricExt = 'lrc';
 
+  /// 原生扫描索引文件名（位于应用支持目录）
+  static const String _scanIndexFileName = 'local_library.idx';
+
+  /// Linux 目录监听（linux/runner/library_watcher_plugin.cc）
+  static const MethodChannel _watcherChannel =
+      MethodChannel('com.cyrene.music/library_watcher');
+  static const EventChannel _watcherEvents =
+      EventChannel('com.cyrene.music/library_watcher/events');
+
+  /// 已扫描并处于监听中的文件夹
+  final Set<String> _watchedFolders = {};
+  StreamSubscription<dynamic>? _watcherSubscription;
+
+  /// 按到达顺序依次处理变更批次
+  Future<void> _pendingChanges = Future.value();
+
   /// 路径 -> 歌词内容缓存
   final Map<String, String> _pathToLyric = {};
 
+  /// 路径 -> 歌词文件路径（原生扫描结果，首次取歌词时才读取内容）
+  final Map<String, String> _pathToLyricPath = {};
+
+  /// 路径 -> 时长（毫秒，来自文件头）
+  final Map<String, int> _pathToDurationMs = {};
+
   /// 已扫描的本地歌曲列表
   final List<Track> _tracks = [];
 
+  /// 已加入的歌曲 id，用于去重
+  final Set<String> _trackIds = {};
+
   List<Track> get tracks => List.unmodifiable(_tracks);
 
   /// 根据 Track.id（本地为完整文件路径）获取歌词文本
   String getLyricByTrackId(dynamic id) {
-    if (id is String) {
-      return _pathToLyric[id] ?? '';
+    if (id is! String) return '';
+
+    final cached = _pathToLyric[id];
+    if (cached != null) return cached;
+
+    // 歌词文件变化后缓存会被清掉，此时重新查找
+    final lyricPath = _pathToLyricPath.remove(id) ??
+        (_trackIds.contains(id) ? _findLyricPath(id) : null);
+    String lyricText = '';
+    if (lyricPath != null) {
+      try {
+        lyricText = File(lyricPath).readAsStringSync();
+      } catch (_) {
+        // 歌词文件已被删除或无法读取
+      }
     }
-    return '';
+    _pathToLyric[id] = lyricText;
+    return lyricText;
+  }
+
+  /// 同名歌词：同目录或 Lyrics 子目录
+  String? _findLyricPath(String filePath) {
+    final nameNoExt = p.basenameWithoutExtension(filePath);
+    final dir = p.dirname(filePath);
+    for (final candidate in [
+      p.join(dir, '$nameNoExt.$lyricExt'),
+      p.join(dir, 'Lyrics', '$nameNoExt.$lyricExt'),
+    ]) {
+      if (File(candidate).existsSync()) return candidate;
+    }
+    return null;
+  }
+
+  /// 根据 Track.id 获取文件头中的时长，未知时返回 null
+  Duration? getDurationByTrackId(dynamic id) {
+    final durationMs = id is String ? _pathToDurationMs[id] : null;
+    if (durationMs == null || durationMs <= 0) return null;
+    return Duration(milliseconds: durationMs);
   }
 
   /// 选择单首歌曲文件
@@ -59,10 +122,19 @@ class LocalLibraryService extends ChangeNotifier {
   }
 
   /// 扫描指定文件夹（递归）
-  Future<void> scanFolder(String folderPath) async {
+  ///
+  /// [replace] 为 true 时先移除该文件夹下已有的歌曲（用于监听丢失事件后的重新扫描）。
+  Future<void> scanFolder(String folderPath, {bool replace = false}) async {
     final dir = Directory(folderPath);
     if (!await dir.exists()) return;
 
+    if (replace) _removeUnder(folderPath);
+    unawaited(_watchFolder(folderPath));
+
+    if (NativeLibraryScanner.isAvailable && await _scanFolderNative(folderPath)) {
+      return;
+    }
+
     final List<Future<void>> futures = [];
     await for (final entity in dir.list(recursive: true, followLinks: false)) {
       if (entity is File) {
@@ -78,10 +150,264 @@ class LocalLibraryService extends ChangeNotifier {
     }
   }
 
+  /// 由原生扫描结果构造 Track，并记录歌词路径与时长
+  Track _trackFromScan(ScannedTrack scanned) {
+    _pathToLyric.remove(scanned.path);
+    if (scanned.lyricPath.isNotEmpty) {
+      _pathToLyricPath[scanned.path] = scanned.lyricPath;
+    } else {
+      _pathToLyricPath.remove(scanned.path);
+      _pathToLyric[scanned.path] = '';
+    }
+    if (scanned.durationMs > 0) {
+      _pathToDurationMs[scanned.path] = scanned.durationMs;
+    } else {
+      _pathToDurationMs.remove(scanned.path);
+    }
+    return Track(
+      id: scanned.path,
+      name: scanned.title.isNotEmpty
+          ? scanned.title
+          : p.basenameWithoutExtension(scanned.path),
+      artists: scanned.artist.isNotEmpty ? scanned.artist : '本地文件',
+      album: scanned.album,
+      picUrl: '', // 暂无封面，播放器会使用占位
+      source: MusicSource.local,
+    );
+  }
+
+  /// 原生扫描：后台 isolate 中并行遍历并解析标签，失败时返回 false 以回退
+  Future<bool> _scanFolderNative(String folderPath) async {
+    try {
+      final supportDir = await getApplicationSupportDirectory();
+      final indexPath = p.join(supportDir.path, _scanIndexFileName);
+      final stopwatch = Stopwatch()..start();
+      final result = await Isolate.run(
+        () => NativeLibraryScanner.scan(folderPath, indexPath: indexPath),
+      );
+      if (result == null) return false;
+
+      print('📂 [LocalLibraryService] 扫描完成: ${result.tracks.length} 首'
+          '（解析 ${result.parsed}，复用索引 ${result.reused}，'
+          '${result.directories} 个目录，${stopwatch.elapsedMilliseconds}ms）');
+
+      var added = false;
+      for (final scanned in result.tracks) {
+        if (!_trackIds.add(scanned.path)) continue;
+        _tracks.add(_trackFromScan(scanned));
+        added = true;
+      }
+      if (added) notifyListeners();
+      return true;
+    } catch (e) {
+      print('⚠️ [LocalLibraryService] 原生扫描失败，回退到 Dart 实现: $e');
+      return false;
+    }
+  }
+
+  /// 监听已扫描的文件夹，文件增删、改名时增量更新歌曲列表（仅 Linux）
+  Future<void> _watchFolder(String folderPath) async {
+    if (!Platform.isLinux || !_watchedFolders.add(folderPath)) return;
+    _watcherSubscription ??= _watcherEvents.receiveBroadcastStream().listen(
+      (event) {
+        if (event is! List) return;
+        _pendingChanges = _pendingChanges
+            .then((_) => _applyChanges(event))
+            .catchError((e) => print('⚠️ [LocalLibraryService] 应用目录变更失败: $e'));
+      },
+      onError: (e) => print('⚠️ [LocalLibraryService] 目录监听事件错误: $e'),
+    );
+    try {
+      final watching = await _watcherChannel
+          .invokeMethod<bool>('watch', {'path': folderPath});
+      if (watching != true) {
+        _watchedFolders.remove(folderPath);
+        print('⚠️ [LocalLibraryService] 无法监听文件夹: $folderPath');
+      }
+    } catch (e) {
+      _watchedFolders.remove(folderPath);
+      print('⚠️ [LocalLibraryService] 目录监听不可用: $e');
+    }
+  }
+
+  /// 应用一批目录变更：[{type, path, oldPath?, isDirectory}]
+  ///
+  /// 删除、改名在内存中按顺序完成；新增文件最后统一读取标签。
+  Future<void> _applyChanges(List<dynamic> changes) async {
+    // 以 id 为键的有序视图，批内每次增删改都是 O(1)
+    var byId = <String, Track>{
+      for (final track in _tracks) track.id as String: track,
+    };
+    final added = <String>{};
+    final rescans = <String>[];
+
+    for (final raw in changes) {
+      if (raw is! Map) continue;
+      final type = raw['type'] as String?;
+      final path = raw['path'] as String?;
+      if (type == null || path == null) continue;
+      final isDirectory = raw['isDirectory'] == true;
+      final oldPath = raw['oldPath'] as String?;
+
+      switch (type) {
+        case 'added':
+          if (_isLyricFile(path)) {
+            _invalidateLyric(path, byId);
+          } else {
+            added.add(path);
+          }
+          break;
+        case 'removed':
+          if (isDirectory) {
+            final prefix = '$path${p.separator}';
+            byId.removeWhere((id, _) => id.startsWith(prefix));
+            added.removeWhere((id) => id.startsWith(prefix));
+          } else if (_isLyricFile(path)) {
+            _invalidateLyric(path, byId);
+          } else {
+            byId.remove(path);
+            added.remove(path);
+          }
+          break;
+        case 'renamed':
+          if (oldPath == null) break;
+          if (isDirectory) {
+            final prefix = '$oldPath${p.separator}';
+            String moved(String id) => id.startsWith(prefix)
+                ? '$path${id.substring(oldPath.length)}'
+                : id;
+            byId = {
+              for (final entry in byId.entries)
+                moved(entry.key): entry.key.startsWith(prefix)
+                    ? _movedTrack(entry.value, moved(entry.key))
+                    : entry.value,
+            };
+            final addedMoved = added.map(moved).toList();
+            added
+              ..clear()
+              ..addAll(addedMoved);
+          } else if (_isLyricFile(path) || _isLyricFile(oldPath)) {
+            _invalidateLyric(oldPath, byId);
+            _invalidateLyric(path, byId);
+          } else {
+            final track = byId.remove(oldPath);
+            if (track != null) byId[path] = _movedTrack(track, path);
+            if (added.remove(oldPath)) added.add(path);
+          }
+          break;
+        case 'rescan':
+          rescans.add(path);
+          break;
+      }
+    }
+
+    _tracks
+      ..clear()
+      ..addAll(byId.values);
+    _trackIds
+      ..clear()
+      ..addAll(byId.keys);
+    _pathToLyric.removeWhere((id, _) => !_trackIds.contains(id));
+    _pathToLyricPath.removeWhere((id, _) => !_trackIds.contains(id));
+    _pathToDurationMs.removeWhere((id, _) => !_trackIds.contains(id));
+
+    if (added.isNotEmpty) await _addChangedFiles(added.toList());
+    notifyListeners();
+
+    for (final root in rescans) {
+      print('🔄 [LocalLibraryService] 监听事件丢失，重新扫描: $root');
+      await scanFolder(root, replace: true);
+    }
+  }
+
+  /// 新增或重写的文件：原生读取标签后插入或原位替换
+  Future<void> _addChangedFiles(List<String> paths) async {
+    if (!NativeLibraryScanner.isAvailable) {
+      for (final path in paths) {
+        await _addAudioFile(path);
+      }
+      return;
+    }
+
+    final result =
+        await Isolate.run(() => NativeLibraryScanner.readFiles(paths));
+    if (result == null) return;
+    final positions = <String, int>{
+      for (var i = 0; i < _tracks.length; i++) _tracks[i].id as String: i,
+    };
+    for (final scanned in result.tracks) {
+      final track = _trackFromScan(scanned);
+      final position = positions[scanned.path];
+      if (position != null) {
+        _tracks[position] = track;
+      } else {
+        _tracks.add(track);
+        _trackIds.add(scanned.path);
+      }
+    }
+  }
+
+  /// 文件改名或所在目录改名后的 Track（名称取自文件名时随之更新）
+  Track _movedTrack(Track track, String newPath) {
+    final oldId = track.id as String;
+    final nameFromFile = track.name == p.basenameWithoutExtension(oldId);
+    _moveCacheEntry(_pathToLyricPath, oldId, newPath);
+    _moveCacheEntry(_pathToDurationMs, oldId, newPath);
+    _pathToLyric.remove(oldId);
+    return Track(
+      id: newPath,
+      name: nameFromFile ? p.basenameWithoutExtension(newPath) : track.name,
+      artists: track.artists,
+      album: track.album,
+      picUrl: track.picUrl,
+      source: track.source,
+    );
+  }
+
+  void _moveCacheEntry<V>(Map<String, V> cache, String from, String to) {
+    final value = cache.remove(from);
+    if (value != null) cache[to] = value;
+  }
+
+  bool _isLyricFile(String path) =>
+      p.extension(path).toLowerCase() == '.$lyricExt';
+
+  /// 歌词文件增删后清掉对应歌曲的歌词缓存，下次取歌词时重新查找
+  void _invalidateLyric(String lyricPath, Map<String, Track> byId) {
+    var dir = p.dirname(lyricPath);
+    if (p.basename(dir) == 'Lyrics') dir = p.dirname(dir);
+    final nameNoExt = p.basenameWithoutExtension(lyricPath);
+    for (final ext in supportedAudioExts) {
+      final id = p.join(dir, '$nameNoExt.$ext');
+      if (byId.containsKey(id)) {
+        _pathToLyric.remove(id);
+        _pathToLyricPath.remove(id);
+      }
+    }
+  }
+
+  /// 移除 [folderPath] 下的所有歌曲
+  void _removeUnder(String folderPath) {
+    final prefix = '$folderPath${p.separator}';
+    bool under(String id) => id.startsWith(prefix);
+    _tracks.removeWhere((t) => under(t.id as String));
+    _trackIds.removeWhere(under);
+    _pathToLyric.removeWhere((id, _) => under(id));
+    _pathToLyricPath.removeWhere((id, _) => under(id));
+    _pathToDurationMs.removeWhere((id, _) => under(id));
+  }
+
   /// 清空已扫描结果
   void clear() {
+    if (_watchedFolders.isNotEmpty) {
+      _watchedFolders.clear();
+      _watcherChannel.invokeMethod('unwatchAll').catchError((_) {});
+    }
     _tracks.clear();
+    _trackIds.clear();
     _pathToLyric.clear();
+    _pathToLyricPath.clear();
+    _pathToDurationMs.clear();
     notifyListeners();
   }
 
@@ -89,10 +415,11 @@ class LocalLibraryService extends ChangeNotifier {
   Future<void> _addAudioFile(String filePath) async {
     try {
       // 去重
-      if (_tracks.any((t) => t.id == filePath)) return;
+      if (_trackIds.contains(filePath)) return;
 
       final file = File(filePath);
       if (!await file.exists()) return;
+      if (!_trackIds.add(filePath)) return;
 
       final filename = p.basename(filePath);
       final nameNoExt = p.basenameWithoutExtension(filePath);
@@ -0,0 +1,216 @@
+import 'dart:async';
+import 'dart:isolate';
+import '../models/track.dart';
+import '../native/search_index_native.dart';
+import 'cache_service.dart';
+import 'favorite_service.dart';
+import 'local_library_service.dart';
+import 'play_history_service.dart';
+
+/// 本地搜索服务
+///
+/// 平台搜索要等三个接口返回，而设备上已有的歌曲（本地音乐库、收藏、播放
+/// 历史、已缓存的 .cyrene）从来不参与搜索。这里把它们放进原生倒排索引
+/// （native/search_index.cc），支持拼音、首字母、前缀和拼写纠错，查询
+/// 不到 1 毫秒，在网络搜索进行中就能先显示结果。各来源变化时只增量更新
+/// 变化的歌曲；同一首歌出现在多个来源时合并为一条，得分叠加各来源的加权。
+class LocalSearchService {
+  static final LocalSearchService _instance = LocalSearchService._internal();
+  factory LocalSearchService() => _instance;
+  LocalSearchService._internal();
+
+  /// 来源（按位组合）及其排序加权
+  static const int _fromLibrary = 1;
+  static const int _fromFavorites = 2;
+  static const int _fromHistory = 4;
+  static const int _fromCache = 8;
+  static const Map<int, double> _boosts = {
+    _fromLibrary: 3,
+    _fromFavorites: 2,
+    _fromHistory: 1,
+    _fromCache: 0.5,
+  };
+
+  /// 来源频繁通知（扫描、批量收藏）时合并为一次更新
+  static const Duration _syncDelay = Duration(milliseconds: 300);
+
+  /// 一次变化超过这个数量时在后台 isolate 写入索引
+  static const int _backgroundBatch = 500;
+
+  NativeSearchIndex? _index;
+  bool _initialized = false;
+
+  /// key -> 歌曲及其来源
+  final Map<String, _IndexedTrack> _tracks = {};
+
+  /// 来源 -> 该来源当前的 key
+  final Map<int, Set<String>> _sourceKeys = {};
+  final Map<int, Timer> _syncTimers = {};
+
+  /// 按顺序依次同步，避免并发写入交错
+  Future<void> _pendingSync = Future.value();
+
+  /// 本地搜索是否可用
+  bool get isAvailable => _index != null;
+
+  /// 已索引的歌曲数
+  int get length => _tracks.length;
+
+  void initialize() {
+    if (_initialized) return;
+    _initialized = true;
+
+    _index = NativeSearchIndex.create();
+    if (_index == null) {
+      print('⚠️ [LocalSearchService] 原生索引不可用，本地搜索已禁用');
+      return;
+    }
+
+    LocalLibraryService().addListener(() => _scheduleSync(_fromLibrary));
+    FavoriteService().addListener(() => _scheduleSync(_fromFavorites));
+    PlayHistoryService().addListener(() => _scheduleSync(_fromHistory));
+    CacheService().addListener(() => _scheduleSync(_fromCache));
+    for (final source in _boosts.keys) {
+      _scheduleSync(source);
+    }
+  }
+
+  /// 按相关度返回最多 [limit] 首匹配 [query] 的歌曲
+  List<Track> search(String query, {int limit = 20}) {
+    final index = _index;
+    if (index == null || query.trim().isEmpty) return const [];
+    final result = <Track>[];
+    for (final key in index.search(query, limit: limit)) {
+      final indexed = _tracks[key];
+      if (indexed != null) result.add(indexed.track);
+    }
+    return result;
+  }
+
+  void _scheduleSync(int source) {
+    _syncTimers[source]?.cancel();
+    _syncTimers[source] = Timer(_syncDelay, () {
+      _pendingSync = _pendingSync.then((_) => _sync(source));
+    });
+  }
+
+  Future<void> _sync(int source) async {
+    final index = _index;
+    if (index == null) return;
+
+    try {
+      final stopwatch = Stopwatch()..start();
+      final keys = <String>{};
+      final changed = <String>{};
+      for (final track in _tracksOf(source)) {
+        final key = '${track.source.name}:${track.id}';
+        if (!keys.add(key)) continue;
+        final indexed = _tracks[key];
+        if (indexed == null) {
+          _tracks[key] = _IndexedTrack(track, source);
+          changed.add(key);
+        } else if (indexed.sources & source == 0) {
+          indexed.sources |= source;
+          changed.add(key);
+        } else if (indexed.track.name != track.name ||
+            indexed.track.artists != track.artists ||
+            indexed.track.album != track.album) {
+          indexed.track = track;
+          changed.add(key);
+        }
+      }
+
+      final removed = <String>[];
+      for (final key in _sourceKeys[source] ?? const <String>{}) {
+        if (keys.contains(key)) continue;
+        final indexed = _tracks[key]!;
+        indexed.sources &= ~source;
+        if (indexed.sources == 0) {
+          _tracks.remove(key);
+          changed.remove(key);
+          removed.add(key);
+        } else {
+          changed.add(key);
+        }
+      }
+      _sourceKeys[source] = keys;
+      if (changed.isEmpty && removed.isEmpty) return;
+
+      final entries = [
+        for (final key in changed) _tracks[key]!.toEntry(key),
+      ];
+      if (entries.length > _backgroundBatch) {
+        await _putInBackground(index.address, entries);
+      } else {
+        index.put(entries);
+      }
+      index.remove(removed);
+      print('🔎 [LocalSearchService] 索引已更新: +${entries.length} '
+          '-${removed.length}, 共 ${_tracks.length} 首, '
+          '耗时 ${stopwatch.elapsedMilliseconds}ms');
+    } catch (e) {
+      print('⚠️ [LocalSearchService] 更新索引失败: $e');
+    }
+  }
+
+  static Iterable<Track> _tracksOf(int source) {
+    switch (source) {
+      case _fromLibrary:
+        return LocalLibraryService().tracks;
+      case _fromFavorites:
+        return FavoriteService().favorites.map((item) => item.toTrack());
+      case _fromHistory:
+        return PlayHistoryService().history.map((item) => item.toTrack());
+      case _fromCache:
+        return CacheService().getCachedList().map(_trackOfCache);
+    }
+    return const [];
+  }
+
+  static Track _trackOfCache(CacheMetadata metadata) {
+    final source = MusicSource.values.firstWhere(
+      (e) => e.name == metadata.source,
+      orElse: () => MusicSource.netease,
+    );
+    return Track(
+      // 网易云的 id 是 int，与其他来源生成的 key 保持一致
+      id: source == MusicSource.netease
+          ? int.tryParse(metadata.songId) ?? metadata.songId
+          : metadata.songId,
+      name: metadata.songName,
+      artists: metadata.artists,
+      album: metadata.album,
+      picUrl: metadata.picUrl,
+      source: source,
+    );
+  }
+
+  /// 在后台 isolate 中写入（闭包只捕获参数）
+  static Future<void> _putInBackground(
+      int address, List<SearchIndexEntry> entries) {
+    return Isolate.run(() {
+      NativeSearchIndex.fromAddress(address)?.put(entries);
+    });
+  }
+}
+
+class _IndexedTrack {
+  _IndexedTrack(this.track, this.sources);
+
+  Track track;
+  int sources;
+
+  SearchIndexEntry toEntry(String key) {
+    var boost = 0.0;
+    LocalSearchService._boosts.forEach((source, value) {
+      if (sources & source != 0) boost += value;
+    });
+    return SearchIndexEntry(
+      key: key,
+      title: track.name,
+      artists: track.artists,
+      album: track.album,
+      boost: boost,
+    );
+  }
+}
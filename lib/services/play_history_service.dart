@@ -1,7 +1,11 @@
 import 'package:flutter/foundation.dart';
+import 'package:path_provider/path_provider.dart';
 import 'package:shared_preferences/shared_preferences.dart';
+import 'package:path/path.dart' as path;
 import 'dart:convert';
+import 'dart:typed_data';
 import '../models/track.dart';
+import '../native/record_store_native.dart';
 
 /// 播放历史记录模型
 class PlayHistoryItem {
@@ -61,6 +65,45 @@ class PlayHistoryItem {
     };
   }
 
+  /// 在记录存储中的键（同一平台、同一ID只保留一条）
+  String get storeKey => '${source.name}:$id';
+
+  /// 编码为记录存储中的二进制值
+  Uint8List toRecord() {
+    final writer = StoreRecordWriter()
+      ..writeString(id)
+      ..writeString(name)
+      ..writeString(artists)
+      ..writeString(album)
+      ..writeString(picUrl)
+      ..writeString(source.name)
+      ..writeInt(playedAt.millisecondsSinceEpoch);
+    return writer.takeBytes();
+  }
+
+  /// 从记录存储中的二进制值创建
+  factory PlayHistoryItem.fromRecord(Uint8List bytes) {
+    final reader = StoreRecordReader(bytes);
+    final id = reader.readString();
+    final name = reader.readString();
+    final artists = reader.readString();
+    final album = reader.readString();
+    final picUrl = reader.readString();
+    final sourceName = reader.readString();
+    return PlayHistoryItem(
+      id: id,
+      name: name,
+      artists: artists,
+      album: album,
+      picUrl: picUrl,
+      source: MusicSource.values.firstWhere(
+        (e) => e.name == sourceName,
+        orElse: () => MusicSource.netease,
+      ),
+      playedAt: DateTime.fromMillisecondsSinceEpoch(reader.readInt()),
+    );
+  }
+
   /// 从 JSON 创建
   factory PlayHistoryItem.fromJson(Map<String, dynamic> json) {
     return PlayHistoryItem(
@@ -90,13 +133,30 @@ class PlayHistoryService extends ChangeNotifier {
   List<PlayHistoryItem> get history => _history;
 
   static const String _historyKey = 'play_history';
+  static const String _storeFileName = 'play_history.store';
   static const int _maxHistoryCount = 500; // 最多保存500条历史记录
 
+  /// 原生记录存储（Linux），每条历史一条记录，增删只写一条；
+  /// 不可用时整个列表以 JSON 保存在 SharedPreferences 中
+  NativeRecordStore? _store;
+
   /// 加载播放历史
   Future<void> _loadHistory() async {
     try {
       final prefs = await SharedPreferences.getInstance();
       final historyJson = prefs.getString(_historyKey);
+
+      final store = await _openStore();
+      if (store != null) {
+        if (historyJson != null) {
+          _importLegacyHistory(store, historyJson);
+          await prefs.remove(_historyKey);
+        }
+        _history = store.entries().values.map(PlayHistoryItem.fromRecord).toList()
+          ..sort((a, b) => b.playedAt.compareTo(a.playedAt));
+        print('📚 [PlayHistoryService] 加载播放历史: ${_history.length} 条');
+        return;
+      }
       
       if (historyJson != null) {
         final List<dynamic> decoded = json.decode(historyJson);
@@ -112,6 +172,26 @@ class PlayHistoryService extends ChangeNotifier {
     }
   }
 
+  Future<NativeRecordStore?> _openStore() async {
+    if (!NativeRecordStore.isAvailable) return null;
+    final supportDir = await getApplicationSupportDirectory();
+    _store = NativeRecordStore.open(path.join(supportDir.path, _storeFileName));
+    return _store;
+  }
+
+  /// 把旧版 SharedPreferences 中的 JSON 列表一次性导入记录存储
+  void _importLegacyHistory(NativeRecordStore store, String historyJson) {
+    final List<dynamic> decoded = json.decode(historyJson);
+    store.clear();
+    // 旧列表按时间倒序，倒着写入使同一首歌保留最近的一条
+    for (final item in decoded.reversed) {
+      final historyItem = PlayHistoryItem.fromJson(item as Map<String, dynamic>);
+      store.put(historyItem.storeKey, historyItem.toRecord());
+    }
+    store.checkpoint();
+    print('📦 [PlayHistoryService] 已迁移旧版播放历史: ${decoded.length} 条');
+  }
+
   /// 添加播放记录
   Future<void> addToHistory(Track track) async {
     try {
@@ -126,12 +206,22 @@ class PlayHistoryService extends ChangeNotifier {
       _history.insert(0, historyItem);
       
       // 限制历史记录数量
+      List<PlayHistoryItem> dropped = const [];
       if (_history.length > _maxHistoryCount) {
+        dropped = _history.sublist(_maxHistoryCount);
         _history = _history.sublist(0, _maxHistoryCount);
       }
       
       // 保存到本地
-      await _saveHistory();
+      final store = _store;
+      if (store != null) {
+        store.put(historyItem.storeKey, historyItem.toRecord());
+        for (final item in dropped) {
+          store.delete(item.storeKey);
+        }
+      } else {
+        await _saveHistory();
+      }
       
       print('💾 [PlayHistoryService] 添加播放记录: ${track.name}');
       notifyListeners();
@@ -157,7 +247,12 @@ class PlayHistoryService extends ChangeNotifier {
   Future<void> removeHistoryItem(PlayHistoryItem item) async {
     try {
       _history.remove(item);
-      await _saveHistory();
+      final store = _store;
+      if (store != null) {
+        store.delete(item.storeKey);
+      } else {
+        await _saveHistory();
+      }
       
       print('🗑️ [PlayHistoryService] 删除播放记录: ${item.name}');
       notifyListeners();
@@ -170,6 +265,7 @@ class PlayHistoryService extends ChangeNotifier {
   Future<void> clearHistory() async {
     try {
       _history.clear();
+      _store?.clear();
       
       final prefs = await SharedPreferences.getInstance();
       await prefs.remove(_historyKey);
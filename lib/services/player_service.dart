@@ -6,16 +6,18 @@ import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:audioplayers/audioplayers.dart' as ap;
 import 'package:http/http.dart' as http;
-import 'package:path_provider/path_provider.dart';
 import 'package:cached_network_image/cached_network_image.dart';
 import 'package:palette_generator/palette_generator.dart';
+import 'package:shared_preferences/shared_preferences.dart';
 import '../models/song_detail.dart';
 import '../models/track.dart';
 import '../models/lyric_line.dart';
+import '../native/audio_engine_native.dart';
 import '../utils/lyric_parser.dart';
 import 'music_service.dart';
 import 'cache_service.dart';
 import 'proxy_service.dart';
+import 'prefetch_service.dart';
 import 'play_history_service.dart';
 import 'playback_mode_service.dart';
 import 'playlist_queue_service.dart';
@@ -24,6 +26,7 @@ import 'listening_stats_service.dart';
 import 'desktop_lyric_service.dart';
 import 'android_floating_lyric_service.dart';
 import 'player_background_service.dart';
+import 'cover_palette_service.dart';
 import 'local_library_service.dart';
 import 'dart:async' as async_lib;
 import 'dart:async' show TimeoutException;
@@ -66,6 +69,25 @@ class PlayerService extends ChangeNotifier {
   List<LyricLine> _lyrics = [];
   int _currentLyricIndex = -1;
 
+  // Linux 原生播放引擎（无缝播放、交叉淡入淡出），不可用时使用 audioplayers
+  NativeAudioEngine? _engine;
+  async_lib.Timer? _engineTimer;
+  AudioEngineStatus? _engineStatus;
+  int _engineItemId = 0; // 最近分配的引擎条目 id
+  int _currentItemId = 0; // 当前歌曲对应的条目 id
+  _PreparedTrack? _queuedTrack; // 已交给引擎预加载的下一首
+  int _upcomingRequest = 0; // 预加载请求序号，用于丢弃过期结果
+  bool _upcomingRequested = false;
+  bool _engineEndHandled = false;
+  Duration _crossfade = Duration.zero;
+  static const String _crossfadeKey = 'player_crossfade_ms';
+
+  // 响度均衡：按缓存索引里的增益调整每首歌（见 CacheService 的响度分析）
+  bool _normalizeLoudness = true;
+  static const String _normalizeLoudnessKey = 'player_normalize_loudness';
+  double _trackGain = 1.0; // 当前歌曲的线性增益，audioplayers 回退路径用
+  static const Duration _engineStatusInterval = Duration(milliseconds: 200);
+
   PlayerState get state => _state;
   SongDetail? get currentSong => _currentSong;
   Track? get currentTrack => _currentTrack;
@@ -78,6 +100,18 @@ class PlayerService extends ChangeNotifier {
   double get volume => _volume; // 获取当前音量
   ImageProvider? get currentCoverImageProvider => _currentCoverImageProvider;
 
+  /// 是否使用原生播放引擎（Linux）
+  bool get hasNativeEngine => _engine != null;
+
+  /// 歌曲之间的交叉淡入淡出时长（0 为无缝衔接，仅原生引擎）
+  Duration get crossfade => _crossfade;
+
+  /// 是否开启响度均衡
+  bool get normalizeLoudness => _normalizeLoudness;
+
+  /// 原生引擎的最近一次状态（延迟、欠载次数），未使用时为 null
+  AudioEngineStatus? get engineStatus => _engineStatus;
+
   /// 设置当前歌曲的预取封面图像提供器
   void setCurrentCoverImageProvider(ImageProvider? provider) {
     _currentCoverImageProvider = provider;
@@ -86,6 +120,25 @@ class PlayerService extends ChangeNotifier {
 
   /// 初始化播放器监听
   Future<void> initialize() async {
+    // Linux 上优先使用原生播放引擎
+    if (Platform.isLinux) {
+      _engine = NativeAudioEngine.create();
+      if (_engine != null) {
+        try {
+          final prefs = await SharedPreferences.getInstance();
+          _crossfade = Duration(milliseconds: prefs.getInt(_crossfadeKey) ?? 0);
+          _normalizeLoudness = prefs.getBool(_normalizeLoudnessKey) ?? true;
+        } catch (e) {
+          print('⚠️ [PlayerService] 读取交叉淡入淡出设置失败: $e');
+        }
+        _engine!.setCrossfade(_crossfade);
+        _engine!.setVolume(_volume);
+        PlaylistQueueService().addListener(_onUpcomingChanged);
+        PlaybackModeService().addListener(_onUpcomingChanged);
+        print('🎧 [PlayerService] 使用原生播放引擎，输出: ${_engine!.sinkName}');
+      }
+    }
+
     // 监听播放状态
     _audioPlayer.onPlayerStateChanged.listen((state) {
       switch (state) {
@@ -127,6 +180,10 @@ class PlayerService extends ChangeNotifier {
         default:
           break;
       }
+      // 桌面歌词原生时钟随播放状态启停
+      if (DesktopLyricService.isSupported) {
+        DesktopLyricService().syncPosition(_position, playing: _state == PlayerState.playing);
+      }
       notifyListeners();
     });
 
@@ -134,6 +191,10 @@ class PlayerService extends ChangeNotifier {
     _audioPlayer.onPositionChanged.listen((position) {
       _position = position;
       _updateFloatingLyric(); // 更新桌面/悬浮歌词
+      // 桌面歌词逐字高亮由原生时钟推进，这里只做节流后的进度校准
+      if (DesktopLyricService.isSupported) {
+        DesktopLyricService().syncPosition(position, playing: _state == PlayerState.playing);
+      }
       // 🔥 通知Android原生层播放位置（后台歌词更新关键）
       if (Platform.isAndroid) {
         AndroidFloatingLyricService().updatePosition(position);
@@ -152,6 +213,7 @@ class PlayerService extends ChangeNotifier {
     final proxyStarted = await ProxyService().start();
     if (proxyStarted) {
       print('✅ [PlayerService] 本地代理服务器已就绪');
+      await PrefetchService().initialize();
     } else {
       print('⚠️ [PlayerService] 本地代理服务器启动失败，将使用备用方案');
     }
@@ -172,6 +234,7 @@ class PlayerService extends ChangeNotifier {
       _state = PlayerState.loading;
       _currentTrack = track;
       _errorMessage = null;
+      _reserveEngineItem();
       notifyListeners();
 
       print('🎵 [PlayerService] 开始播放: ${track.name} - ${track.artists}');
@@ -184,7 +247,7 @@ class PlayerService extends ChangeNotifier {
       await ListeningStatsService().recordPlayCount(track);
 
       // 1. 检查缓存
-      final qualityStr = quality.toString().split('.').last;
+      final qualityStr = selectedQuality.toString().split('.').last;
       final isCached = CacheService().isCached(track);
 
       if (isCached) {
@@ -192,25 +255,17 @@ class PlayerService extends ChangeNotifier {
         
         // 获取缓存的元数据
         final metadata = CacheService().getCachedMetadata(track);
-        final cachedFilePath = await CacheService().getCachedFilePath(track);
+        // 优先通过本地代理流式播放（按需解密，无临时文件），不可用时回退到解密后的临时文件
+        final cachedStreamUrl = await CacheService().getCachedStreamUrl(track);
+        final cachedFilePath = cachedStreamUrl ?? await CacheService().getCachedFilePath(track);
 
         if (cachedFilePath != null && metadata != null) {
           // 记录临时文件路径（用于后续清理）
-          _currentTempFilePath = cachedFilePath;
+          if (cachedStreamUrl == null) {
+            _currentTempFilePath = cachedFilePath;
+          }
           
-          _currentSong = SongDetail(
-            id: track.id,
-            name: track.name,
-            url: cachedFilePath,
-            pic: metadata.picUrl,
-            arName: metadata.artists,
-            alName: metadata.album,
-            level: metadata.quality,
-            size: metadata.fileSize.toString(),
-            lyric: metadata.lyric,      // 从缓存恢复歌词
-            tlyric: metadata.tlyric,    // 从缓存恢复翻译
-            source: track.source,
-          );
+          _currentSong = _songFromCache(track, metadata, cachedFilePath);
           
           // 🔧 立即通知监听器，确保 PlayerPage 能获取到包含歌词的 currentSong
           notifyListeners();
@@ -220,7 +275,7 @@ class PlayerService extends ChangeNotifier {
           _loadLyricsForFloatingDisplay();
 
           // 播放缓存文件
-          await _audioPlayer.play(ap.DeviceFileSource(cachedFilePath));
+          await _playUri(cachedFilePath, gain: _gainFor(metadata));
           print('✅ [PlayerService] 从缓存播放: $cachedFilePath');
           print('📝 [PlayerService] 歌词已从缓存恢复');
           
@@ -248,39 +303,26 @@ class PlayerService extends ChangeNotifier {
           return;
         }
 
-        // 从本地服务取歌词
-        final lyricText = LocalLibraryService().getLyricByTrackId(filePath);
-
-        _currentSong = SongDetail(
-          id: filePath,
-          name: track.name,
-          pic: track.picUrl,
-          arName: track.artists,
-          alName: track.album,
-          level: 'local',
-          size: '',
-          url: filePath,
-          lyric: lyricText,
-          tlyric: '',
-          source: MusicSource.local,
-        );
+        _currentSong = _songFromLocal(track, filePath);
 
         notifyListeners();
         _loadLyricsForFloatingDisplay();
 
-        await _audioPlayer.play(ap.DeviceFileSource(filePath));
+        await _playUri(filePath);
         print('✅ [PlayerService] 播放本地文件: $filePath');
         _extractThemeColorInBackground(track.picUrl);
         return;
       }
 
       // 2. 从网络获取歌曲详情
+      // 预取过的歌曲直接复用已解析的播放地址
+      final songDetail = PrefetchService().resolvedDetail(track, selectedQuality) ??
+          await MusicService().fetchSongDetail(
+            songId: track.id,
+            quality: selectedQuality,
+            source: track.source,
+          );
       print('🌐 [PlayerService] 从网络获取歌曲');
-      final songDetail = await MusicService().fetchSongDetail(
-        songId: track.id,
-        quality: selectedQuality,
-        source: track.source,
-      );
 
       if (songDetail == null || songDetail.url.isEmpty) {
         _state = PlayerState.error;
@@ -313,11 +355,15 @@ class PlayerService extends ChangeNotifier {
       // 3. 播放音乐
       if (track.source == MusicSource.qq || track.source == MusicSource.kugou) {
         // QQ音乐和酷狗音乐使用本地代理播放（边下载边播放）
-        if (ProxyService().isRunning) {
+        if (ProxyService().isRunning || ProxyService().isNativeRunning) {
           print('🎶 [PlayerService] 使用本地代理播放 ${track.getSourceName()}');
           final platform = track.source == MusicSource.qq ? 'qq' : 'kugou';
-          final proxyUrl = ProxyService().getProxyUrl(songDetail.url, platform);
-          await _audioPlayer.play(ap.UrlSource(proxyUrl));
+          final proxyUrl = ProxyService().getProxyUrl(
+            songDetail.url,
+            platform,
+            cacheKey: PrefetchService.streamKey(track, selectedQuality),
+          );
+          await _playUri(proxyUrl);
           print('✅ [PlayerService] 通过代理开始流式播放');
         } else {
           // 备用方案：下载后播放
@@ -327,9 +373,17 @@ class PlayerService extends ChangeNotifier {
             _currentTempFilePath = tempFilePath;
           }
         }
+      } else if (ProxyService().isNativeRunning) {
+        // 网易云音乐经原生代理播放，才能用上预取的分段缓存
+        await _playUri(ProxyService().getProxyUrl(
+          songDetail.url,
+          'netease',
+          cacheKey: PrefetchService.streamKey(track, selectedQuality),
+        ));
+        print('✅ [PlayerService] 通过原生代理开始播放: ${songDetail.url}');
       } else {
         // 网易云音乐直接播放
-        await _audioPlayer.play(ap.UrlSource(songDetail.url));
+        await _playUri(songDetail.url);
         print('✅ [PlayerService] 开始播放: ${songDetail.url}');
       }
 
@@ -354,7 +408,7 @@ class PlayerService extends ChangeNotifier {
       print('📥 [PlayerService] 开始下载音频: ${songDetail.name}');
       
       // 获取临时目录
-      final tempDir = await getTemporaryDirectory();
+      final tempDir = await CacheService.tempDirectory();
       final timestamp = DateTime.now().millisecondsSinceEpoch;
       final tempFilePath = '${tempDir.path}/temp_audio_$timestamp.mp3';
       
@@ -379,7 +433,7 @@ class PlayerService extends ChangeNotifier {
         print('📁 [PlayerService] 临时文件: $tempFilePath');
         
         // 播放临时文件
-        await _audioPlayer.play(ap.DeviceFileSource(tempFilePath));
+        await _playUri(tempFilePath);
         print('▶️ [PlayerService] 开始播放临时文件');
         
         return tempFilePath;
@@ -409,6 +463,333 @@ class PlayerService extends ChangeNotifier {
     }
   }
 
+  /// 由缓存元数据构造歌曲详情（[url] 为缓存流地址或解密后的临时文件）
+  SongDetail _songFromCache(Track track, CacheMetadata metadata, String url) {
+    return SongDetail(
+      id: track.id,
+      name: track.name,
+      url: url,
+      pic: metadata.picUrl,
+      arName: metadata.artists,
+      alName: metadata.album,
+      level: metadata.quality,
+      size: metadata.fileSize.toString(),
+      lyric: metadata.lyric,      // 从缓存恢复歌词
+      tlyric: metadata.tlyric,    // 从缓存恢复翻译
+      source: track.source,
+    );
+  }
+
+  /// 构造本地文件的歌曲详情（歌词从本地音乐库取）
+  SongDetail _songFromLocal(Track track, String filePath) {
+    return SongDetail(
+      id: filePath,
+      name: track.name,
+      pic: track.picUrl,
+      arName: track.artists,
+      alName: track.album,
+      level: 'local',
+      size: '',
+      url: filePath,
+      lyric: LocalLibraryService().getLyricByTrackId(filePath),
+      tlyric: '',
+      source: MusicSource.local,
+    );
+  }
+
+  /// 开始播放 [uri]（本地路径或 http(s) 地址），[gain] 为响度均衡增益
+  Future<void> _playUri(String uri, {double gain = 1.0}) async {
+    final engine = _engine;
+    if (engine == null) {
+      // audioplayers 只能衰减，增益并入音量
+      _trackGain = gain;
+      await _audioPlayer.setVolume((_volume * gain).clamp(0.0, 1.0));
+      final isUrl = uri.startsWith('http://') || uri.startsWith('https://');
+      await _audioPlayer.play(
+          isUrl ? ap.UrlSource(uri) : ap.DeviceFileSource(uri));
+      return;
+    }
+
+    engine.load(_currentItemId, uri, gain: gain);
+    _engineTimer ??= async_lib.Timer.periodic(
+        _engineStatusInterval, (_) => _pollEngine());
+  }
+
+  /// 缓存歌曲的响度均衡增益（线性），未开启或尚未分析时为 1
+  double _gainFor(CacheMetadata metadata) {
+    final gainDb = metadata.gainDb;
+    if (!_normalizeLoudness || gainDb == null) return 1.0;
+    return pow(10, gainDb / 20).toDouble();
+  }
+
+  /// 为即将播放的歌曲分配引擎条目，并丢弃已预加载的下一首
+  ///
+  /// 在获取播放地址之前调用：此后引擎里旧歌曲的状态和进度不再更新到界面。
+  void _reserveEngineItem() {
+    final engine = _engine;
+    if (engine == null) return;
+    _currentItemId = ++_engineItemId;
+    _queuedTrack = null;
+    _upcomingRequest++;
+    _upcomingRequested = false;
+    _engineEndHandled = false;
+    engine.queueNext(0, null);
+  }
+
+  /// 定时读取原生引擎状态，代替 audioplayers 的事件流
+  void _pollEngine() {
+    final engine = _engine;
+    if (engine == null) return;
+    final status = engine.status();
+    _engineStatus = status;
+
+    // 引擎已经接上预加载的歌曲
+    final queued = _queuedTrack;
+    if (queued != null && status.itemId == queued.itemId) {
+      _commitQueuedTrack(queued);
+    }
+
+    final isCurrent = status.itemId == _currentItemId;
+    switch (status.state) {
+      case AudioEngineState.loading:
+        _applyEngineState(PlayerState.loading);
+        break;
+      case AudioEngineState.error:
+        if (_state != PlayerState.error) {
+          _errorMessage = '播放失败: 无法解码音频';
+          print('❌ [PlayerService] 原生引擎播放失败');
+        }
+        _applyEngineState(PlayerState.error);
+        break;
+      case AudioEngineState.playing:
+        if (isCurrent) _applyEngineState(PlayerState.playing);
+        break;
+      case AudioEngineState.paused:
+        if (isCurrent) _applyEngineState(PlayerState.paused);
+        break;
+      case AudioEngineState.idle:
+        break;
+      case AudioEngineState.ended:
+        if (isCurrent && !_engineEndHandled) {
+          // 没有预加载的下一首（随机模式、获取地址失败等），按原流程切歌
+          _engineEndHandled = true;
+          _position = Duration.zero;
+          _applyEngineState(PlayerState.idle);
+          _playNextFromHistory();
+        }
+        return;
+    }
+    if (!isCurrent) return;
+
+    if (status.duration > Duration.zero && status.duration != _duration) {
+      _duration = status.duration;
+      notifyListeners();
+    }
+    if (status.position != _position) {
+      _position = status.position;
+      _updateFloatingLyric(); // 更新桌面/悬浮歌词
+      if (DesktopLyricService.isSupported) {
+        DesktopLyricService().syncPosition(_position, playing: _state == PlayerState.playing);
+      }
+      notifyListeners();
+    }
+
+    // 当前歌曲开始出声后再预加载下一首，避免和它抢带宽
+    if (status.state == AudioEngineState.playing && !_upcomingRequested) {
+      _upcomingRequested = true;
+      _queueUpcoming();
+    }
+  }
+
+  /// 引擎状态变化时做与 audioplayers 事件相同的处理
+  void _applyEngineState(PlayerState state) {
+    if (_state == state) return;
+    _state = state;
+    if (state == PlayerState.playing) {
+      _startListeningTimeTracking();
+    } else {
+      _pauseListeningTimeTracking();
+    }
+    // 桌面歌词原生时钟随播放状态启停
+    if (DesktopLyricService.isSupported) {
+      DesktopLyricService().syncPosition(_position, playing: state == PlayerState.playing);
+    }
+    notifyListeners();
+  }
+
+  /// 自然播完后将要播放的歌曲，只有能提前确定时才返回（随机模式在切歌时才决定）
+  _Upcoming? _upcomingTrack() {
+    switch (PlaybackModeService().currentMode) {
+      case PlaybackMode.repeatOne:
+        final current = _currentTrack;
+        return current == null ? null : _Upcoming(current, advancesQueue: false);
+      case PlaybackMode.sequential:
+        final queue = PlaylistQueueService();
+        if (queue.hasQueue) {
+          final next = queue.peekNext();
+          return next == null ? null : _Upcoming(next, advancesQueue: true);
+        }
+        final fromHistory = PlayHistoryService().getNextTrack();
+        return fromHistory == null
+            ? null
+            : _Upcoming(fromHistory, advancesQueue: false);
+      case PlaybackMode.shuffle:
+        return null;
+    }
+  }
+
+  /// 队列或播放模式变化后重新决定预加载哪一首
+  void _onUpcomingChanged() {
+    if (_engine == null || !_upcomingRequested) return;
+    _queueUpcoming();
+  }
+
+  /// 获取下一首的播放地址并交给引擎预加载
+  Future<void> _queueUpcoming() async {
+    final engine = _engine;
+    if (engine == null) return;
+    final upcoming = _upcomingTrack();
+    final queued = _queuedTrack;
+    if (upcoming != null &&
+        queued != null &&
+        queued.track.id.toString() == upcoming.track.id.toString() &&
+        queued.track.source == upcoming.track.source &&
+        queued.advancesQueue == upcoming.advancesQueue) {
+      return;
+    }
+
+    final request = ++_upcomingRequest;
+    final prepared = upcoming == null ? null : await _prepareTrack(upcoming);
+    // 等待期间又切了歌或改了队列
+    if (request != _upcomingRequest || _engine == null) return;
+
+    if (prepared == null) {
+      if (_queuedTrack != null) engine.queueNext(0, null);
+      _queuedTrack = null;
+      return;
+    }
+    prepared.itemId = ++_engineItemId;
+    _queuedTrack = prepared;
+    engine.queueNext(prepared.itemId, prepared.uri, gain: prepared.gain);
+    print('⏭️ [PlayerService] 已预加载下一首: ${prepared.track.name}');
+  }
+
+  /// 解析歌曲的播放地址（不修改当前播放状态，也不生成临时文件）
+  Future<_PreparedTrack?> _prepareTrack(_Upcoming upcoming) async {
+    final track = upcoming.track;
+    try {
+      if (CacheService().isCached(track)) {
+        final metadata = CacheService().getCachedMetadata(track);
+        final url = await CacheService().getCachedStreamUrl(track);
+        if (metadata != null && url != null) {
+          return _PreparedTrack(upcoming, url, _songFromCache(track, metadata, url),
+              gain: _gainFor(metadata));
+        }
+      }
+
+      if (track.source == MusicSource.local) {
+        final filePath = track.id is String ? track.id as String : '';
+        if (filePath.isEmpty || !(await File(filePath).exists())) return null;
+        return _PreparedTrack(upcoming, filePath, _songFromLocal(track, filePath));
+      }
+
+      final quality = AudioQualityService().currentQuality;
+      final songDetail = PrefetchService().resolvedDetail(track, quality) ??
+          await MusicService().fetchSongDetail(
+            songId: track.id,
+            quality: quality,
+            source: track.source,
+          );
+      if (songDetail == null || songDetail.url.isEmpty) return null;
+
+      final qualityStr = quality.toString().split('.').last;
+      var uri = songDetail.url;
+      if (track.source == MusicSource.qq || track.source == MusicSource.kugou) {
+        // 没有代理时只能下载后播放，不做预加载
+        if (!ProxyService().isRunning && !ProxyService().isNativeRunning) return null;
+        final platform = track.source == MusicSource.qq ? 'qq' : 'kugou';
+        uri = ProxyService().getProxyUrl(
+          songDetail.url,
+          platform,
+          cacheKey: PrefetchService.streamKey(track, quality),
+        );
+      } else if (ProxyService().isNativeRunning) {
+        uri = ProxyService().getProxyUrl(
+          songDetail.url,
+          'netease',
+          cacheKey: PrefetchService.streamKey(track, quality),
+        );
+      }
+      return _PreparedTrack(upcoming, uri, songDetail,
+          cacheQuality: CacheService().isCached(track) ? null : qualityStr);
+    } catch (e) {
+      print('⚠️ [PlayerService] 预加载下一首失败: $e');
+      return null;
+    }
+  }
+
+  /// 引擎已无缝切到预加载的歌曲：更新当前歌曲、队列位置、历史和统计
+  void _commitQueuedTrack(_PreparedTrack prepared) {
+    final track = prepared.track;
+    print('🔗 [PlayerService] 无缝切换到: ${track.name}');
+    _queuedTrack = null;
+    _currentItemId = prepared.itemId;
+    _upcomingRequested = false;
+    _engineEndHandled = false;
+    _cleanupCurrentTempFile();
+
+    if (prepared.advancesQueue) {
+      PlaylistQueueService().getNext();
+    }
+    _currentTrack = track;
+    _currentSong = prepared.song;
+    _position = Duration.zero;
+    _duration = Duration.zero;
+    _errorMessage = null;
+    notifyListeners();
+
+    PlayHistoryService().addToHistory(track);
+    ListeningStatsService().recordPlayCount(track);
+    _loadLyricsForFloatingDisplay();
+    if (prepared.cacheQuality != null) {
+      _cacheSongInBackground(track, prepared.song, prepared.cacheQuality!);
+    }
+    _extractThemeColorInBackground(prepared.song.pic);
+  }
+
+  /// 自动切歌前的停顿；原生引擎切歌不重启设备，不需要
+  Future<void> _pauseBetweenTracks() async {
+    if (_engine != null) return;
+    await Future.delayed(const Duration(milliseconds: 500));
+  }
+
+  /// 设置歌曲之间的交叉淡入淡出时长（[Duration.zero] 为无缝衔接）
+  Future<void> setCrossfade(Duration duration) async {
+    _crossfade = duration;
+    _engine?.setCrossfade(duration);
+    notifyListeners();
+    try {
+      final prefs = await SharedPreferences.getInstance();
+      await prefs.setInt(_crossfadeKey, duration.inMilliseconds);
+      print('🔀 [PlayerService] 交叉淡入淡出: ${duration.inSeconds}秒');
+    } catch (e) {
+      print('❌ [PlayerService] 保存交叉淡入淡出设置失败: $e');
+    }
+  }
+
+  /// 开关响度均衡，从下一首开始生效
+  Future<void> setNormalizeLoudness(bool enabled) async {
+    _normalizeLoudness = enabled;
+    notifyListeners();
+    try {
+      final prefs = await SharedPreferences.getInstance();
+      await prefs.setBool(_normalizeLoudnessKey, enabled);
+      print('🎚️ [PlayerService] 响度均衡: ${enabled ? "开启" : "关闭"}');
+    } catch (e) {
+      print('❌ [PlayerService] 保存响度均衡设置失败: $e');
+    }
+  }
+
   /// 后台提取主题色（为播放器页面预加载）
   Future<void> _extractThemeColorInBackground(String imageUrl) async {
     if (imageUrl.isEmpty) {
@@ -436,8 +817,14 @@ class PlayerService extends ChangeNotifier {
       
       Color? themeColor;
       
-      // 移动端渐变模式：从封面底部区域提取颜色
-      if (isMobileGradientMode) {
+      // 原生取色：一次得到整图与底部区域的调色板（按 URL 缓存）
+      final palette = await CoverPaletteService().getPalette(imageUrl);
+      if (palette != null) {
+        themeColor = isMobileGradientMode
+            ? palette.region.themeColor
+            : palette.full.themeColor;
+      } else if (isMobileGradientMode) {
+        // 移动端渐变模式：从封面底部区域提取颜色
         themeColor = await _extractColorFromBottomRegion(imageUrl);
       } else {
         // 其他模式：从整张图片提取颜色
@@ -561,7 +948,12 @@ class PlayerService extends ChangeNotifier {
   /// 暂停
   Future<void> pause() async {
     try {
-      await _audioPlayer.pause();
+      if (_engine != null) {
+        _engine!.pause();
+        _applyEngineState(PlayerState.paused);
+      } else {
+        await _audioPlayer.pause();
+      }
       _pauseListeningTimeTracking();
       print('⏸️ [PlayerService] 暂停播放');
     } catch (e) {
@@ -572,7 +964,12 @@ class PlayerService extends ChangeNotifier {
   /// 继续播放
   Future<void> resume() async {
     try {
-      await _audioPlayer.resume();
+      if (_engine != null) {
+        _engine!.play();
+        _applyEngineState(PlayerState.playing);
+      } else {
+        await _audioPlayer.resume();
+      }
       _startListeningTimeTracking();
       print('▶️ [PlayerService] 继续播放');
     } catch (e) {
@@ -583,7 +980,15 @@ class PlayerService extends ChangeNotifier {
   /// 停止
   Future<void> stop() async {
     try {
-      await _audioPlayer.stop();
+      if (_engine != null) {
+        _engine!.stop();
+        _engineTimer?.cancel();
+        _engineTimer = null;
+        _queuedTrack = null;
+        _upcomingRequest++;
+      } else {
+        await _audioPlayer.stop();
+      }
       
       // 清理临时文件
       await _cleanupCurrentTempFile();
@@ -606,7 +1011,13 @@ class PlayerService extends ChangeNotifier {
   /// 跳转到指定位置
   Future<void> seek(Duration position) async {
     try {
-      await _audioPlayer.seek(position);
+      if (_engine != null) {
+        _engine!.seek(position);
+        _position = position;
+        notifyListeners();
+      } else {
+        await _audioPlayer.seek(position);
+      }
       print('⏩ [PlayerService] 跳转到: ${position.inSeconds}s');
     } catch (e) {
       print('❌ [PlayerService] 跳转失败: $e');
@@ -617,7 +1028,11 @@ class PlayerService extends ChangeNotifier {
   Future<void> setVolume(double volume) async {
     try {
       final clampedVolume = volume.clamp(0.0, 1.0);
-      await _audioPlayer.setVolume(clampedVolume);
+      if (_engine != null) {
+        _engine!.setVolume(clampedVolume);
+      } else {
+        await _audioPlayer.setVolume((clampedVolume * _trackGain).clamp(0.0, 1.0));
+      }
       _volume = clampedVolume;
       notifyListeners(); // 通知监听器音量已改变
       print('🔊 [PlayerService] 音量设置为: ${(clampedVolume * 100).toInt()}%');
@@ -708,6 +1123,9 @@ class PlayerService extends ChangeNotifier {
     _pauseListeningTimeTracking();
     // 同步清理当前临时文件
     _cleanupCurrentTempFile();
+    _engineTimer?.cancel();
+    _engine?.dispose();
+    _engine = null;
     _audioPlayer.stop();
     _audioPlayer.dispose();
     // 停止代理服务器
@@ -743,6 +1161,10 @@ class PlayerService extends ChangeNotifier {
       _position = Duration.zero;
       _duration = Duration.zero;
       
+      // 原生引擎只停止输出：释放时要等待仍在打开网络流的后台线程
+      _engineTimer?.cancel();
+      _engine?.stop();
+
       // 使用 unawaited 方式，不等待完成，直接继续
       // 因为应用即将退出，操作系统会自动清理资源
       _audioPlayer.stop().catchError((e) {
@@ -771,7 +1193,7 @@ class PlayerService extends ChangeNotifier {
           // 单曲循环：重新播放当前歌曲
           if (_currentTrack != null) {
             print('🔂 [PlayerService] 单曲循环，重新播放当前歌曲');
-            await Future.delayed(const Duration(milliseconds: 500));
+            await _pauseBetweenTracks();
             await playTrack(_currentTrack!);
           }
           break;
@@ -812,7 +1234,7 @@ class PlayerService extends ChangeNotifier {
         final nextTrack = PlaylistQueueService().getNext();
         if (nextTrack != null) {
           print('✅ [PlayerService] 从播放队列获取下一首: ${nextTrack.name}');
-          await Future.delayed(const Duration(milliseconds: 500));
+          await _pauseBetweenTracks();
           await playTrack(nextTrack);
           return;
         } else {
@@ -826,7 +1248,7 @@ class PlayerService extends ChangeNotifier {
       
       if (nextTrack != null) {
         print('✅ [PlayerService] 从播放历史获取下一首: ${nextTrack.name}');
-        await Future.delayed(const Duration(milliseconds: 500));
+        await _pauseBetweenTracks();
         await playTrack(nextTrack);
       } else {
         print('ℹ️ [PlayerService] 没有更多歌曲可播放');
@@ -877,7 +1299,7 @@ class PlayerService extends ChangeNotifier {
         final randomTrack = PlaylistQueueService().getRandomTrack();
         if (randomTrack != null) {
           print('✅ [PlayerService] 从播放队列随机选择: ${randomTrack.name}');
-          await Future.delayed(const Duration(milliseconds: 500));
+          await _pauseBetweenTracks();
           await playTrack(randomTrack);
           return;
         }
@@ -893,7 +1315,7 @@ class PlayerService extends ChangeNotifier {
         final randomTrack = history[randomIndex].toTrack();
         
         print('✅ [PlayerService] 从播放历史随机选择: ${randomTrack.name}');
-        await Future.delayed(const Duration(milliseconds: 500));
+        await _pauseBetweenTracks();
         await playTrack(randomTrack);
       } else {
         print('ℹ️ [PlayerService] 历史记录不足，无法随机播放');
@@ -931,8 +1353,8 @@ class PlayerService extends ChangeNotifier {
       _lyrics = [];
       _currentLyricIndex = -1;
       
-      // 清空歌词显示
-      if (Platform.isWindows && DesktopLyricService().isVisible) {
+      // 清空歌词显示（同时让桌面歌词退出上一首的卡拉OK模式）
+      if (DesktopLyricService.isSupported) {
         DesktopLyricService().setLyricText('');
       }
       if (Platform.isAndroid && AndroidFloatingLyricService().isVisible) {
@@ -972,6 +1394,12 @@ class PlayerService extends ChangeNotifier {
 
       _currentLyricIndex = -1;
       print('🎵 [PlayerService] 悬浮歌词已加载: ${_lyrics.length} 行');
+
+      // 整份歌词发送到桌面歌词，由原生层逐帧推进逐字高亮
+      if (DesktopLyricService.isSupported) {
+        DesktopLyricService().setLyricDocument(_lyrics);
+        DesktopLyricService().syncPosition(_position, playing: _state == PlayerState.playing);
+      }
       
       // 🔥 关键修复：将完整歌词数据发送到Android原生层
       // 这样即使应用退到后台，原生层也能独立更新歌词
@@ -1000,13 +1428,13 @@ class PlayerService extends ChangeNotifier {
     if (_lyrics.isEmpty) return;
     
     // 检查是否有可见的歌词服务
-    final isWindowsVisible = Platform.isWindows && DesktopLyricService().isVisible;
+    final isDesktopVisible = DesktopLyricService.isSupported && DesktopLyricService().isVisible;
     final isAndroidVisible = Platform.isAndroid && AndroidFloatingLyricService().isVisible;
     
-    if (!isWindowsVisible && !isAndroidVisible) return;
+    if (!isDesktopVisible && !isAndroidVisible) return;
 
     try {
-      final newIndex = LyricParser.findCurrentLineIndex(_lyrics, _position);
+      final newIndex = LyricParser.findCurrentLineIndex(_lyrics, _position, hint: _currentLyricIndex);
 
       if (newIndex != _currentLyricIndex && newIndex >= 0) {
         _currentLyricIndex = newIndex;
@@ -1018,8 +1446,8 @@ class PlayerService extends ChangeNotifier {
           displayText = '${currentLine.text}\n${currentLine.translation}';
         }
         
-        // 更新Windows桌面歌词
-        if (isWindowsVisible) {
+        // 更新桌面歌词（原生卡拉OK模式下由原生层自行换行）
+        if (isDesktopVisible && !DesktopLyricService().hasLyricDocument) {
           DesktopLyricService().setLyricText(displayText);
         }
         
@@ -1043,3 +1471,32 @@ class PlayerService extends ChangeNotifier {
   }
 }
 
+
+/// 自然播完后要播放的歌曲，以及切过去时是否要推进播放队列
+class _Upcoming {
+  _Upcoming(this.track, {required this.advancesQueue});
+
+  final Track track;
+  final bool advancesQueue;
+}
+
+/// 已解析出播放地址、交给原生引擎预加载的歌曲
+class _PreparedTrack {
+  _PreparedTrack(_Upcoming upcoming, this.uri, this.song,
+      {this.cacheQuality, this.gain = 1.0})
+      : track = upcoming.track,
+        advancesQueue = upcoming.advancesQueue;
+
+  final Track track;
+  final bool advancesQueue;
+  final String uri;
+  final SongDetail song;
+
+  /// 切换后需要后台缓存时的音质（已缓存或本地文件为 null）
+  final String? cacheQuality;
+
+  /// 响度均衡增益（线性）
+  final double gain;
+
+  int itemId = 0;
+}
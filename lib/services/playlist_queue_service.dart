@@ -69,6 +69,12 @@ class PlaylistQueueService extends ChangeNotifier {
     return null;
   }
 
+  /// 查看下一首但不移动当前位置（用于预加载）
+  Track? peekNext() {
+    if (!hasNext) return null;
+    return _queue[_currentIndex + 1];
+  }
+
   /// 获取上一首歌曲
   Track? getPrevious() {
     if (_queue.isEmpty) {
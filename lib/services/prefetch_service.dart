@@ -0,0 +1,199 @@
+import 'dart:async';
+import 'package:flutter/foundation.dart' show listEquals;
+import '../models/song_detail.dart';
+import '../models/track.dart';
+import 'audio_quality_service.dart';
+import 'cache_service.dart';
+import 'music_service.dart';
+import 'play_history_service.dart';
+import 'playback_mode_service.dart';
+import 'player_service.dart';
+import 'playlist_queue_service.dart';
+import 'proxy_service.dart';
+
+/// 已解析的播放地址（带签名的 URL 会过期，只在一段时间内复用）
+class _ResolvedSong {
+  _ResolvedSong(this.detail) : resolvedAt = DateTime.now();
+
+  final SongDetail detail;
+  final DateTime resolvedAt;
+}
+
+/// 下一首预取服务（Linux 原生回环代理）
+///
+/// 跟随播放队列、播放模式和当前歌曲，推测接下来最可能播放的几首，提前解析
+/// 播放地址并让原生代理（native/prefetch_scheduler.cc）把开头若干秒写入分段
+/// 缓存；接通电源或使用有线网络时预取整首。切到这些歌时播放地址和开头数据都
+/// 已在本地，起播只需几十毫秒。
+///
+/// 队列或模式变化后重新计算并整体替换预取列表，不再需要的请求由原生端立即
+/// 取消。并发数和总带宽有全局上限，不会挤占正在播放的歌曲。
+class PrefetchService {
+  static final PrefetchService _instance = PrefetchService._internal();
+  factory PrefetchService() => _instance;
+  PrefetchService._internal();
+
+  // 预取接下来的几首（顺序播放时）
+  static const int _lookahead = 2;
+  // 按流量计费或使用电池时，每首只预取开头这么多秒
+  static const int _prefixSeconds = 30;
+  // 全局并发窗口数和总带宽上限
+  static const int _concurrency = 2;
+  static const int _bytesPerSecond = 2 * 1024 * 1024;
+  // 预取列表合计最多占用的分段缓存字节数：整首预取无损音质时只取到这里，
+  // 猜错的预取不会挤掉真正播放过的内容（原生端也会优先淘汰未播放的预取）
+  static const int _maxBytes = 64 * 1024 * 1024;
+  // 已解析的播放地址复用时长（各平台签名 URL 的有效期都长于此）
+  static const Duration _resolvedTtl = Duration(minutes: 10);
+  static const Duration _debounce = Duration(milliseconds: 500);
+
+  final Map<String, _ResolvedSong> _resolved = {};
+  List<StreamPrefetch> _sent = const [];
+  Timer? _debounceTimer;
+  int _generation = 0;
+  String? _currentKey;
+  bool _initialized = false;
+
+  /// 开始跟随队列和播放模式（原生代理不可用时什么也不做）
+  Future<void> initialize() async {
+    if (_initialized || !ProxyService().isNativeRunning) return;
+    _initialized = true;
+
+    await ProxyService().setPrefetchLimits(
+      concurrency: _concurrency,
+      bytesPerSecond: _bytesPerSecond,
+      maxBytes: _maxBytes,
+    );
+    PlaylistQueueService().addListener(_scheduleRefresh);
+    PlaybackModeService().addListener(_scheduleRefresh);
+    AudioQualityService().addListener(_scheduleRefresh);
+    PlayerService().addListener(_onPlayerChanged);
+    print('📡 [PrefetchService] 已启用下一首预取');
+  }
+
+  /// 分段缓存和代理共用的缓存键（同一首歌同一音质保持不变）
+  static String streamKey(Track track, AudioQuality quality) {
+    final qualityStr = quality.toString().split('.').last;
+    return '${_platformOf(track)}_${track.id}_$qualityStr';
+  }
+
+  /// 预取时已解析、仍在有效期内的歌曲详情，没有时返回 null
+  SongDetail? resolvedDetail(Track track, AudioQuality quality) {
+    final resolved = _resolved[streamKey(track, quality)];
+    if (resolved == null ||
+        DateTime.now().difference(resolved.resolvedAt) > _resolvedTtl) {
+      return null;
+    }
+    return resolved.detail;
+  }
+
+  // 与代理 URL 的 platform 参数一致：qq / kugou / netease
+  static String _platformOf(Track track) => track.source.name;
+
+  /// 只在切歌时刷新（播放进度等频繁通知直接忽略）
+  void _onPlayerChanged() {
+    final track = PlayerService().currentTrack;
+    final key = track == null ? null : '${track.source.name}_${track.id}';
+    if (key == _currentKey) return;
+    _currentKey = key;
+    _scheduleRefresh();
+  }
+
+  void _scheduleRefresh() {
+    _debounceTimer?.cancel();
+    _debounceTimer = Timer(_debounce, _refresh);
+  }
+
+  /// 接下来最可能播放的歌曲，按可能性从高到低
+  List<Track> _likelyNext() {
+    switch (PlaybackModeService().currentMode) {
+      case PlaybackMode.repeatOne:
+        // 单曲循环一直在播当前歌曲，它已在缓存中
+        return const [];
+      case PlaybackMode.shuffle:
+        // 随机播放在切歌时才决定，无从预测
+        return const [];
+      case PlaybackMode.sequential:
+        final queue = PlaylistQueueService();
+        if (queue.hasQueue) {
+          final start = queue.currentIndex + 1;
+          final end = (start + _lookahead).clamp(0, queue.queue.length);
+          return start < end ? queue.queue.sublist(start, end) : const [];
+        }
+        final fromHistory = PlayHistoryService().getNextTrack();
+        return fromHistory == null ? const [] : [fromHistory];
+    }
+  }
+
+  /// 重新计算预取列表并交给原生代理
+  Future<void> _refresh() async {
+    final generation = ++_generation;
+    final quality = AudioQualityService().currentQuality;
+    final candidates = _likelyNext()
+        .where((track) =>
+            track.source != MusicSource.local &&
+            !CacheService().isCached(track))
+        .toList();
+
+    final conditions = await ProxyService().prefetchConditions();
+    final whole = conditions != null &&
+        (conditions.onAcPower || conditions.unmetered);
+    final prefixBytes = _prefixSeconds * _bytesPerSecondOf(quality);
+
+    final requests = <StreamPrefetch>[];
+    for (final track in candidates) {
+      final key = streamKey(track, quality);
+      var detail = resolvedDetail(track, quality);
+      if (detail == null) {
+        try {
+          detail = await MusicService().fetchSongDetail(
+            songId: track.id,
+            quality: quality,
+            source: track.source,
+          );
+        } catch (e) {
+          print('⚠️ [PrefetchService] 解析播放地址失败: ${track.name}, $e');
+        }
+        // 等待期间队列又变了，交给新一轮处理
+        if (generation != _generation) return;
+        if (detail == null || detail.url.isEmpty) continue;
+        _resolved[key] = _ResolvedSong(detail);
+      }
+      requests.add(StreamPrefetch(
+        cacheKey: key,
+        url: detail.url,
+        platform: _platformOf(track),
+        bytes: whole ? 0 : prefixBytes,
+      ));
+    }
+    if (generation != _generation) return;
+
+    // 丢掉不再需要的解析结果
+    final wanted = requests.map((request) => request.cacheKey).toSet();
+    _resolved.removeWhere((key, _) => !wanted.contains(key));
+
+    if (listEquals(requests, _sent)) return;
+    _sent = requests;
+    await ProxyService().setPrefetch(requests);
+    if (requests.isEmpty) {
+      print('📡 [PrefetchService] 已取消预取');
+    } else {
+      print('📡 [PrefetchService] 预取 ${requests.length} 首'
+          '（${whole ? '整首' : '开头 $_prefixSeconds 秒'}）');
+    }
+  }
+
+  /// 各音质的大致码率（字节/秒），用于把秒数换算成预取字节数
+  static int _bytesPerSecondOf(AudioQuality quality) {
+    switch (quality) {
+      case AudioQuality.standard:
+        return 128 * 1000 ~/ 8;
+      case AudioQuality.exhigh:
+        return 320 * 1000 ~/ 8;
+      case AudioQuality.lossless:
+        return 1100 * 1000 ~/ 8;
+      default:
+        return 3000 * 1000 ~/ 8;
+    }
+  }
+}
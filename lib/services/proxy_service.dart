@@ -1,8 +1,56 @@
 import 'dart:async';
 import 'dart:io';
+import 'dart:math';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+import 'package:path_provider/path_provider.dart';
 import 'package:shelf/shelf.dart' as shelf;
 import 'package:shelf/shelf_io.dart' as shelf_io;
 import 'package:http/http.dart' as http;
+import '../native/cyrene_file_native.dart';
+
+/// 已登记的缓存流
+class _CacheStreamEntry {
+  final String filePath;
+  final Uint8List key;
+
+  _CacheStreamEntry(this.filePath, this.key);
+}
+
+/// 一条预取请求（与播放时 [ProxyService.getProxyUrl] 的参数一一对应）
+class StreamPrefetch {
+  const StreamPrefetch({
+    required this.cacheKey,
+    required this.url,
+    required this.platform,
+    this.bytes = 0,
+  });
+
+  final String cacheKey;
+  final String url;
+  final String platform;
+
+  /// 预取开头的字节数，0 表示整首
+  final int bytes;
+
+  Map<String, Object> toMap() => {
+        'key': cacheKey,
+        'url': url,
+        'platform': platform,
+        'bytes': bytes,
+      };
+
+  @override
+  bool operator ==(Object other) =>
+      other is StreamPrefetch &&
+      other.cacheKey == cacheKey &&
+      other.url == url &&
+      other.platform == platform &&
+      other.bytes == bytes;
+
+  @override
+  int get hashCode => Object.hash(cacheKey, url, platform, bytes);
+}
 
 /// 本地 HTTP 代理服务
 /// 用于处理 QQ 音乐等需要特殊请求头的音频流
@@ -15,9 +63,26 @@ class ProxyService {
   int _port = 8888;
   bool _isRunning = false;
 
+  // Linux 原生回环代理（native/loopback_proxy.cc，由 runner 启动）
+  // 支持 Range 请求，并把音频分段缓存到磁盘，重复播放和拖动进度无需重新下载
+  static const MethodChannel _loopbackChannel =
+      MethodChannel('com.cyrene.music/loopback_proxy');
+  int? _nativePort;
+  // 分段缓存（临时目录下的 cyrene_stream_cache）容量上限，null 时用原生默认值
+  int? _streamCacheLimit;
+
+  // 缓存流分块大小（每次从原生读取器解密的字节数）
+  static const int _cacheChunkSize = 64 * 1024;
+
+  // 已登记的缓存流（流 ID -> 缓存文件）
+  final Map<String, _CacheStreamEntry> _cacheStreams = {};
+
   bool get isRunning => _isRunning;
   int get port => _port;
 
+  /// 原生回环代理是否在运行（仅 Linux）
+  bool get isNativeRunning => _nativePort != null;
+
   /// 启动代理服务器
   Future<bool> start() async {
     if (_isRunning) {
@@ -25,6 +90,8 @@ class ProxyService {
       return true;
     }
 
+    await _startNativeProxy();
+
     try {
       // 尝试多个端口，避免端口冲突
       for (int port = 8888; port < 8898; port++) {
@@ -53,8 +120,39 @@ class ProxyService {
     }
   }
 
+  /// 启动 Linux 原生回环代理（失败时继续使用 Dart 代理）
+  Future<void> _startNativeProxy() async {
+    if (!Platform.isLinux || _nativePort != null) return;
+
+    try {
+      final tempDir = await getTemporaryDirectory();
+      final cacheDir = '${tempDir.path}/cyrene_stream_cache';
+      final port = await _loopbackChannel.invokeMethod<int>('start', {
+        'cacheDir': cacheDir,
+      });
+      if (port != null && port > 0) {
+        _nativePort = port;
+        print('✅ [ProxyService] 原生回环代理已启动: http://127.0.0.1:$port (缓存: $cacheDir)');
+        if (_streamCacheLimit != null) {
+          await setStreamCacheLimit(_streamCacheLimit!);
+        }
+      }
+    } catch (e) {
+      print('⚠️ [ProxyService] 原生回环代理不可用，使用 Dart 代理: $e');
+      _nativePort = null;
+    }
+  }
+
   /// 停止代理服务器
   Future<void> stop() async {
+    if (_nativePort != null) {
+      _nativePort = null;
+      try {
+        await _loopbackChannel.invokeMethod('stop');
+      } catch (e) {
+        print('⚠️ [ProxyService] 停止原生回环代理失败: $e');
+      }
+    }
     if (_server != null) {
       await _server!.close();
       _server = null;
@@ -65,6 +163,11 @@ class ProxyService {
 
   /// 处理代理请求
   Future<shelf.Response> _handleRequest(shelf.Request request) async {
+    final segments = request.url.pathSegments;
+    if (segments.length == 2 && segments.first == 'cache') {
+      return _handleCacheRequest(request, segments[1]);
+    }
+
     try {
       // 获取原始 URL
       final targetUrl = request.url.queryParameters['url'];
@@ -89,6 +192,12 @@ class ProxyService {
         headers['referer'] = 'https://www.kugou.com';
       }
 
+      // 转发 Range 请求头，拖动进度时无需从头下载
+      final range = request.headers['range'];
+      if (range != null) {
+        headers['Range'] = range;
+      }
+
       // 发起请求（使用流式传输）
       final client = http.Client();
       final streamedRequest = http.Request('GET', Uri.parse(targetUrl));
@@ -96,7 +205,7 @@ class ProxyService {
 
       final streamedResponse = await client.send(streamedRequest);
 
-      if (streamedResponse.statusCode == 200) {
+      if (streamedResponse.statusCode == 200 || streamedResponse.statusCode == 206) {
         // 设置响应头
         final responseHeaders = {
           'Content-Type': streamedResponse.headers['content-type'] ?? 'audio/mpeg',
@@ -108,16 +217,28 @@ class ProxyService {
         if (streamedResponse.headers['content-length'] != null) {
           responseHeaders['Content-Length'] = streamedResponse.headers['content-length']!;
         }
+        if (streamedResponse.headers['content-range'] != null) {
+          responseHeaders['Content-Range'] = streamedResponse.headers['content-range']!;
+        }
 
         print('✅ [ProxyService] 开始流式传输音频数据');
 
-        // 流式传输响应数据
-        return shelf.Response.ok(
-          streamedResponse.stream,
+        // 流式传输响应数据（传输结束后关闭客户端）
+        return shelf.Response(
+          streamedResponse.statusCode,
+          body: streamedResponse.stream.transform(
+            StreamTransformer<List<int>, List<int>>.fromHandlers(
+              handleDone: (sink) {
+                client.close();
+                sink.close();
+              },
+            ),
+          ),
           headers: responseHeaders,
         );
       } else {
         print('❌ [ProxyService] 上游服务器返回: ${streamedResponse.statusCode}');
+        client.close();
         return shelf.Response(
           streamedResponse.statusCode,
           body: 'Upstream server error: ${streamedResponse.statusCode}',
@@ -132,14 +253,268 @@ class ProxyService {
     }
   }
 
+  /// 处理缓存流请求（支持 Range，按需解密，不生成临时文件）
+  Future<shelf.Response> _handleCacheRequest(
+    shelf.Request request,
+    String streamId,
+  ) async {
+    final entry = _cacheStreams[streamId];
+    if (entry == null) {
+      return shelf.Response.notFound('Unknown cache stream');
+    }
+
+    final file = NativeCyreneFile.open(entry.filePath, entry.key);
+    if (file == null) {
+      print('❌ [ProxyService] 无法打开缓存文件: ${entry.filePath}');
+      return shelf.Response.internalServerError(body: 'Failed to open cache file');
+    }
+
+    final total = file.audioSize;
+    final rangeHeader = request.headers['range'];
+    final range = _parseRange(rangeHeader, total);
+    if (range == null) {
+      file.close();
+      return shelf.Response(416, headers: {'Content-Range': 'bytes */$total'});
+    }
+
+    final (start, end) = range;
+    final headers = {
+      'Content-Type': _sniffContentType(file),
+      'Accept-Ranges': 'bytes',
+      'Cache-Control': 'no-cache',
+      'Content-Length': '${end - start + 1}',
+    };
+    final isPartial = rangeHeader != null;
+    if (isPartial) {
+      headers['Content-Range'] = 'bytes $start-$end/$total';
+    }
+
+    if (request.method == 'HEAD') {
+      file.close();
+      return shelf.Response(isPartial ? 206 : 200, headers: headers);
+    }
+
+    return shelf.Response(
+      isPartial ? 206 : 200,
+      body: _readCacheStream(file, start, end + 1),
+      headers: headers,
+    );
+  }
+
+  /// 解析 Range 请求头，返回闭区间 [start, end]；范围无法满足时返回 null
+  (int, int)? _parseRange(String? header, int total) {
+    if (header == null || !header.startsWith('bytes=')) {
+      return (0, total - 1);
+    }
+
+    // 只处理第一个区间，播放器不会请求多段
+    final spec = header.substring(6).split(',').first.trim();
+    final dash = spec.indexOf('-');
+    if (dash < 0) return null;
+
+    final startText = spec.substring(0, dash).trim();
+    final endText = spec.substring(dash + 1).trim();
+
+    int start;
+    int end;
+    if (startText.isEmpty) {
+      // bytes=-N：最后 N 个字节
+      final suffix = int.tryParse(endText);
+      if (suffix == null || suffix <= 0) return null;
+      start = max(0, total - suffix);
+      end = total - 1;
+    } else {
+      start = int.tryParse(startText) ?? -1;
+      end = endText.isEmpty ? total - 1 : (int.tryParse(endText) ?? -1);
+      if (end >= total) end = total - 1;
+    }
+
+    if (start < 0 || start >= total || end < start) return null;
+    return (start, end);
+  }
+
+  /// 分块读取并解密缓存数据
+  Stream<List<int>> _readCacheStream(
+    NativeCyreneFile file,
+    int start,
+    int end,
+  ) async* {
+    try {
+      var offset = start;
+      while (offset < end) {
+        final chunk = Uint8List(min(_cacheChunkSize, end - offset));
+        final count = file.read(offset, chunk);
+        if (count == NativeCyreneFile.corrupt) {
+          print('❌ [ProxyService] 缓存数据块校验失败，偏移: $offset');
+          break;
+        }
+        if (count <= 0) break;
+        offset += count;
+        yield count == chunk.length ? chunk : Uint8List.sublistView(chunk, 0, count);
+      }
+    } finally {
+      file.close();
+    }
+  }
+
+  /// 根据音频数据头部推断 Content-Type
+  String _sniffContentType(NativeCyreneFile file) {
+    final head = Uint8List(12);
+    final count = file.read(0, head);
+    if (count >= 4) {
+      if (head[0] == 0x66 && head[1] == 0x4C && head[2] == 0x61 && head[3] == 0x43) {
+        return 'audio/flac'; // fLaC
+      }
+      if (head[0] == 0x4F && head[1] == 0x67 && head[2] == 0x67 && head[3] == 0x53) {
+        return 'audio/ogg'; // OggS
+      }
+      if (head[0] == 0x52 && head[1] == 0x49 && head[2] == 0x46 && head[3] == 0x46) {
+        return 'audio/wav'; // RIFF
+      }
+    }
+    if (count >= 8 && head[4] == 0x66 && head[5] == 0x74 && head[6] == 0x79 && head[7] == 0x70) {
+      return 'audio/mp4'; // ftyp
+    }
+    return 'audio/mpeg';
+  }
+
+  /// 登记缓存文件，返回本地流式播放 URL
+  ///
+  /// 原生回环代理运行时由其直接输出（[segmentKey] 指向分段缓存中同一首歌的
+  /// 明文副本，完整时以 sendfile 零拷贝发送）；否则回退到 shelf 代理。
+  /// 代理未运行或原生读取器不可用时返回 null。
+  Future<String?> registerCacheStream(
+    String streamId,
+    String filePath,
+    Uint8List key, {
+    String? segmentKey,
+  }) async {
+    if (_nativePort != null) {
+      try {
+        await _loopbackChannel.invokeMethod('registerCache', {
+          'id': streamId,
+          'path': filePath,
+          'key': key,
+          if (segmentKey != null) 'segmentKey': segmentKey,
+        });
+        final streamUrl =
+            'http://127.0.0.1:$_nativePort/cache/${Uri.encodeComponent(streamId)}';
+        print('🔗 [ProxyService] 生成原生缓存流 URL: $streamUrl');
+        return streamUrl;
+      } catch (e) {
+        print('⚠️ [ProxyService] 原生代理登记缓存失败，回退到 Dart 代理: $e');
+      }
+    }
+
+    if (!_isRunning || !NativeCyreneFile.isAvailable) {
+      return null;
+    }
+
+    _cacheStreams[streamId] = _CacheStreamEntry(filePath, key);
+    final streamUrl = 'http://localhost:$_port/cache/${Uri.encodeComponent(streamId)}';
+    print('🔗 [ProxyService] 生成缓存流 URL: $streamUrl');
+    return streamUrl;
+  }
+
+  /// 取消登记缓存文件
+  void unregisterCacheStream(String streamId) {
+    _cacheStreams.remove(streamId);
+    if (_nativePort != null) {
+      _loopbackChannel
+          .invokeMethod('unregisterCache', {'id': streamId})
+          .catchError((e) => print('⚠️ [ProxyService] 原生代理取消登记失败: $e'));
+    }
+  }
+
+  /// 替换原生代理的预取列表（按可能性从高到低），空列表取消全部预取
+  ///
+  /// 预取写入与播放相同的分段缓存，之后以相同 cacheKey 播放时直接从磁盘输出。
+  /// 不在新列表中的请求立即取消，仍在列表中的保留已完成的进度。
+  Future<void> setPrefetch(List<StreamPrefetch> requests) async {
+    if (_nativePort == null) return;
+    try {
+      await _loopbackChannel.invokeMethod('setPrefetch', {
+        'requests': [for (final request in requests) request.toMap()],
+      });
+    } catch (e) {
+      print('⚠️ [ProxyService] 设置预取列表失败: $e');
+    }
+  }
+
+  /// 设置分段缓存的容量上限（字节，0 表示不限）
+  ///
+  /// 代理未启动时先记下，启动后生效；超出上限时原生端立即淘汰，
+  /// 未播放过的预取最先删除。
+  Future<void> setStreamCacheLimit(int bytes) async {
+    _streamCacheLimit = bytes;
+    if (_nativePort == null) return;
+    try {
+      await _loopbackChannel.invokeMethod('setCacheLimit', {'bytes': bytes});
+      print('💾 [ProxyService] 分段缓存上限: $bytes');
+    } catch (e) {
+      print('⚠️ [ProxyService] 设置分段缓存上限失败: $e');
+    }
+  }
+
+  /// 设置预取的全局并发数、总带宽上限（字节/秒，0 为不限）和预取总量上限
+  ///
+  /// [maxBytes] 是整个预取列表最多覆盖的字节数，按优先级分配，0 为不限。
+  Future<void> setPrefetchLimits({
+    required int concurrency,
+    required int bytesPerSecond,
+    required int maxBytes,
+  }) async {
+    if (_nativePort == null) return;
+    try {
+      await _loopbackChannel.invokeMethod('setPrefetchLimits', {
+        'concurrency': concurrency,
+        'bytesPerSecond': bytesPerSecond,
+        'maxBytes': maxBytes,
+      });
+    } catch (e) {
+      print('⚠️ [ProxyService] 设置预取限制失败: $e');
+    }
+  }
+
+  /// 当前是否接通电源、默认网络是否为不计流量的有线连接
+  ///
+  /// 原生代理未运行时返回 null。
+  Future<({bool onAcPower, bool unmetered})?> prefetchConditions() async {
+    if (_nativePort == null) return null;
+    try {
+      final result = await _loopbackChannel
+          .invokeMapMethod<String, bool>('prefetchConditions');
+      if (result == null) return null;
+      return (
+        onAcPower: result['onAcPower'] ?? false,
+        unmetered: result['unmetered'] ?? false,
+      );
+    } catch (e) {
+      print('⚠️ [ProxyService] 读取预取条件失败: $e');
+      return null;
+    }
+  }
+
   /// 生成代理 URL
-  String getProxyUrl(String originalUrl, String platform) {
-    if (!_isRunning) {
+  ///
+  /// [cacheKey] 用于原生回环代理的分段磁盘缓存（同一首歌同一音质保持不变，
+  /// 不随带签名的 URL 变化）；省略时按去掉查询参数的 URL 计算。
+  String getProxyUrl(String originalUrl, String platform, {String? cacheKey}) {
+    if (!_isRunning && _nativePort == null) {
       print('⚠️ [ProxyService] 代理服务器未运行，返回原始 URL');
       return originalUrl;
     }
     
     final encodedUrl = Uri.encodeComponent(originalUrl);
+    if (_nativePort != null) {
+      var proxyUrl = 'http://127.0.0.1:$_nativePort/proxy?url=$encodedUrl&platform=$platform';
+      if (cacheKey != null) {
+        proxyUrl += '&key=${Uri.encodeComponent(cacheKey)}';
+      }
+      print('🔗 [ProxyService] 生成原生代理 URL: $proxyUrl');
+      return proxyUrl;
+    }
+
     final proxyUrl = 'http://localhost:$_port/proxy?url=$encodedUrl&platform=$platform';
     
     print('🔗 [ProxyService] 生成代理 URL: $proxyUrl');
@@ -4,6 +4,7 @@ import 'package:http/http.dart' as http;
 import 'package:shared_preferences/shared_preferences.dart';
 import '../models/track.dart';
 import '../models/merged_track.dart';
+import '../native/search_merge_native.dart';
 import 'url_service.dart';
 
 /// 搜索结果模型
@@ -296,6 +297,20 @@ class SearchService extends ChangeNotifier {
     // 合并相同的歌曲
     final mergedMap = <String, List<Track>>{};
 
+    // 原生合并：NFKC/繁简折叠 + 模糊匹配，按组第一首的下标归组
+    final groups = NativeSearchMerger.group(allTracks);
+    if (groups != null) {
+      final mergedGroups = <int, List<Track>>{};
+      for (var i = 0; i < allTracks.length; i++) {
+        (mergedGroups[groups[i]] ??= []).add(allTracks[i]);
+      }
+      final mergedTracks = mergedGroups.values
+          .map((tracks) => MergedTrack.fromTracks(tracks))
+          .toList();
+      print('🔍 [SearchService] 合并结果: ${allTracks.length} 首 → ${mergedTracks.length} 首');
+      return mergedTracks;
+    }
+
     for (final track in allTracks) {
       // 生成唯一键（标准化后的歌曲名+歌手名）
       final key = _generateKey(track.name, track.artists);
@@ -1,11 +1,18 @@
 import '../models/lyric_line.dart';
+import '../native/lyric_parser_native.dart';
 
 /// 歌词解析器
 class LyricParser {
   /// 解析网易云音乐 LRC 格式歌词
+  ///
+  /// 优先使用原生解析器（单次扫描，额外支持多时间戳 LRC 与逐字 YRC/QRC），
+  /// 原生库不可用时回退到下面的 Dart 实现。
   static List<LyricLine> parseNeteaseLyric(String lyric, {String? translation}) {
     if (lyric.isEmpty) return [];
 
+    final nativeLines = NativeLyricParser.parse(lyric, translation: translation);
+    if (nativeLines != null) return nativeLines;
+
     final lines = <LyricLine>[];
     final lyricLines = lyric.split('\n');
     
@@ -70,16 +77,34 @@ class LyricParser {
   }
 
   /// 根据当前播放时间查找当前歌词行索引
-  static int findCurrentLineIndex(List<LyricLine> lyrics, Duration currentTime) {
-    if (lyrics.isEmpty) return -1;
+  ///
+  /// [hint] 为上一次的结果：播放时大多停留在当前行或进入下一行，可直接命中；
+  /// 否则（拖动进度等）二分查找。与 native/lyric_parser.h 中的 LineAt 一致。
+  static int findCurrentLineIndex(List<LyricLine> lyrics, Duration currentTime, {int hint = -1}) {
+    final count = lyrics.length;
+    if (count == 0 || currentTime < lyrics[0].startTime) return -1;
 
-    for (int i = lyrics.length - 1; i >= 0; i--) {
-      if (currentTime >= lyrics[i].startTime) {
-        return i;
+    if (hint >= 0 && hint < count && lyrics[hint].startTime <= currentTime) {
+      if (hint + 1 == count || currentTime < lyrics[hint + 1].startTime) {
+        return hint;
+      }
+      if (hint + 2 == count || currentTime < lyrics[hint + 2].startTime) {
+        return hint + 1;
       }
     }
 
-    return -1;
+    // 最后一个 startTime <= currentTime 的行
+    int low = 0;
+    int high = count;
+    while (low < high) {
+      final mid = (low + high) >> 1;
+      if (lyrics[mid].startTime <= currentTime) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low - 1;
   }
 
   /// 获取当前显示的歌词（带前后几行）
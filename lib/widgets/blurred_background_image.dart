@@ -0,0 +1,102 @@
+import 'dart:io';
+import 'dart:ui';
+import 'package:flutter/material.dart';
+import '../services/blurred_background_service.dart';
+
+/// 模糊背景图片
+///
+/// 铺满父组件显示 [imagePath]，以 [blurAmount] 模糊并叠加 30% 黑色遮罩。
+/// 原生库可用时绘制 [BlurredBackgroundService] 预先渲染好的静态图片；
+/// 不可用、渲染中或渲染失败时使用 BackdropFilter 实时模糊。
+class BlurredBackgroundImage extends StatefulWidget {
+  const BlurredBackgroundImage({
+    super.key,
+    required this.imagePath,
+    required this.blurAmount,
+  });
+
+  final String imagePath;
+  final double blurAmount;
+
+  @override
+  State<BlurredBackgroundImage> createState() => _BlurredBackgroundImageState();
+}
+
+class _BlurredBackgroundImageState extends State<BlurredBackgroundImage> {
+  /// 最近一次请求的参数，参数不变时不重复请求
+  String? _requestKey;
+  String? _renderedPath;
+  String? _renderedImage;
+
+  @override
+  Widget build(BuildContext context) {
+    if (!BlurredBackgroundService.isAvailable) return _buildLiveBlur();
+
+    return LayoutBuilder(
+      builder: (context, constraints) {
+        final size = constraints.biggest;
+        if (size.isFinite) _requestRender(size);
+
+        // 换了背景图时不显示上一张图的结果
+        final rendered =
+            _renderedImage == widget.imagePath ? _renderedPath : null;
+        if (rendered == null) return _buildLiveBlur();
+        return RepaintBoundary(
+          child: Image.file(
+            File(rendered),
+            fit: BoxFit.cover,
+            width: size.width,
+            height: size.height,
+            filterQuality: FilterQuality.medium,
+            gaplessPlayback: true, // 切换尺寸或模糊程度时保留上一张
+            errorBuilder: (context, error, stackTrace) => _buildLiveBlur(),
+          ),
+        );
+      },
+    );
+  }
+
+  void _requestRender(Size size) {
+    final imagePath = widget.imagePath;
+    final key = '$imagePath|${widget.blurAmount}|${size.width}x${size.height}';
+    if (key == _requestKey) return;
+    _requestKey = key;
+
+    BlurredBackgroundService()
+        .backgroundPath(imagePath, size, widget.blurAmount)
+        .then((rendered) {
+      // 只采用最新一次请求的结果
+      if (!mounted || key != _requestKey) return;
+      setState(() {
+        _renderedPath = rendered;
+        _renderedImage = imagePath;
+      });
+    });
+  }
+
+  Widget _buildLiveBlur() {
+    return Stack(
+      children: [
+        // 图片层
+        Positioned.fill(
+          child: Image.file(
+            File(widget.imagePath),
+            fit: BoxFit.cover, // 保持原比例裁剪
+          ),
+        ),
+        // 模糊层
+        Positioned.fill(
+          child: BackdropFilter(
+            filter: ImageFilter.blur(
+              sigmaX: widget.blurAmount,
+              sigmaY: widget.blurAmount,
+            ),
+            child: Container(
+              color: Colors.black.withOpacity(0.3), // 添加半透明遮罩
+            ),
+          ),
+        ),
+      ],
+    );
+  }
+}
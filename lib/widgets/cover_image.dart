@@ -0,0 +1,123 @@
+import 'dart:ui' as ui;
+import 'package:cached_network_image/cached_network_image.dart';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/material.dart';
+import '../services/cover_thumbnail_service.dart';
+
+/// 封面缩略图 ImageProvider
+///
+/// 加载 [CoverThumbnailService] 生成的 [level] 级缩略图，同一封面同一级别
+/// 在 ImageCache 中只有一份。
+@immutable
+class CoverThumbnailProvider extends ImageProvider<CoverThumbnailProvider> {
+  const CoverThumbnailProvider(this.imageUrl, this.level);
+
+  final String imageUrl;
+  final int level;
+
+  @override
+  Future<CoverThumbnailProvider> obtainKey(ImageConfiguration configuration) {
+    return SynchronousFuture<CoverThumbnailProvider>(this);
+  }
+
+  @override
+  ImageStreamCompleter loadImage(CoverThumbnailProvider key, ImageDecoderCallback decode) {
+    return MultiFrameImageStreamCompleter(
+      codec: _loadAsync(key, decode),
+      scale: 1.0,
+      debugLabel: '$imageUrl@$level',
+    );
+  }
+
+  Future<ui.Codec> _loadAsync(CoverThumbnailProvider key, ImageDecoderCallback decode) async {
+    final thumbnail = await CoverThumbnailService().thumbnailPath(key.imageUrl, key.level);
+    if (thumbnail == null) {
+      throw StateError('封面缩略图不可用: ${key.imageUrl}');
+    }
+    return decode(await ui.ImmutableBuffer.fromFilePath(thumbnail));
+  }
+
+  @override
+  bool operator ==(Object other) {
+    return other is CoverThumbnailProvider &&
+        other.imageUrl == imageUrl &&
+        other.level == level;
+  }
+
+  @override
+  int get hashCode => Object.hash(imageUrl, level);
+}
+
+/// 封面图片
+///
+/// 参数与 CachedNetworkImage 一致。原生缩略图可用时按绘制尺寸（乘以设备
+/// 像素比）加载最接近的缩略图级别；缩略图不可用、尺寸超过最大级别或
+/// 生成失败时加载原图。
+class CoverImage extends StatelessWidget {
+  const CoverImage({
+    super.key,
+    required this.imageUrl,
+    this.width,
+    this.height,
+    this.fit,
+    this.placeholder,
+    this.errorWidget,
+  });
+
+  final String imageUrl;
+  final double? width;
+  final double? height;
+  final BoxFit? fit;
+  final PlaceholderWidgetBuilder? placeholder;
+  final LoadingErrorWidgetBuilder? errorWidget;
+
+  @override
+  Widget build(BuildContext context) {
+    if (!CoverThumbnailService.isAvailable || imageUrl.isEmpty) {
+      return _buildOriginal();
+    }
+
+    final size = width != null && height != null
+        ? (width! > height! ? width : height)
+        : width ?? height;
+    if (size != null) return _buildForSize(context, size);
+    return LayoutBuilder(
+      builder: (context, constraints) {
+        final side = constraints.biggest.longestSide;
+        return side.isFinite ? _buildForSize(context, side) : _buildOriginal();
+      },
+    );
+  }
+
+  Widget _buildForSize(BuildContext context, double logicalSize) {
+    final pixels = (logicalSize * MediaQuery.devicePixelRatioOf(context)).ceil();
+    final level = CoverThumbnailService.levelFor(pixels);
+    if (level == null) return _buildOriginal();
+
+    return Image(
+      image: CoverThumbnailProvider(imageUrl, level),
+      width: width,
+      height: height,
+      fit: fit,
+      gaplessPlayback: true,
+      frameBuilder: (context, child, frame, wasSynchronouslyLoaded) {
+        if (frame != null || wasSynchronouslyLoaded || placeholder == null) {
+          return child;
+        }
+        return placeholder!(context, imageUrl);
+      },
+      errorBuilder: (context, error, stackTrace) => _buildOriginal(),
+    );
+  }
+
+  Widget _buildOriginal() {
+    return CachedNetworkImage(
+      imageUrl: imageUrl,
+      width: width,
+      height: height,
+      fit: fit,
+      placeholder: placeholder,
+      errorWidget: errorWidget,
+    );
+  }
+}
@@ -1,4 +1,3 @@
-import 'dart:io';
 import 'package:flutter/material.dart';
 import 'package:flutter_colorpicker/flutter_colorpicker.dart';
 import '../services/desktop_lyric_service.dart';
@@ -77,11 +76,11 @@ class _DesktopLyricSettingsState extends State<DesktopLyricSettings> {
 
   @override
   Widget build(BuildContext context) {
-    if (!Platform.isWindows) {
+    if (!DesktopLyricService.isSupported) {
       return const Card(
         child: Padding(
           padding: EdgeInsets.all(16.0),
-          child: Text('桌面歌词功能仅支持Windows平台'),
+          child: Text('桌面歌词功能仅支持Windows和Linux平台'),
         ),
       );
     }
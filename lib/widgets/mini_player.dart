@@ -1,6 +1,6 @@
 import 'package:flutter/material.dart';
 import 'dart:ui' as ui;
-import 'package:cached_network_image/cached_network_image.dart';
+import 'cover_image.dart';
 import '../services/player_service.dart';
 import '../pages/player_page.dart';
 import '../services/playlist_queue_service.dart';
@@ -435,7 +435,7 @@ class MiniPlayer extends StatelessWidget {
         fit: BoxFit.cover,
       );
     }
-    return CachedNetworkImage(
+    return CoverImage(
       imageUrl: imageUrl,
       width: size,
       height: size,
@@ -662,7 +662,7 @@ class MiniPlayer extends StatelessWidget {
                       tileColor: isCurrent ? Theme.of(context).colorScheme.surfaceContainerHigh : null,
                       leading: ClipRRect(
                         borderRadius: BorderRadius.circular(4),
-                        child: CachedNetworkImage(
+                        child: CoverImage(
                           imageUrl: t.picUrl,
                           width: 44,
                           height: 44,
@@ -3,6 +3,7 @@ import 'package:cached_network_image/cached_network_image.dart';
 import '../models/track.dart';
 import '../models/merged_track.dart';
 import '../services/search_service.dart';
+import '../services/local_search_service.dart';
 import '../services/netease_artist_service.dart';
 import '../pages/artist_detail_page.dart';
 import '../pages/album_detail_page.dart';
@@ -39,6 +40,10 @@ class _SearchWidgetState extends State<SearchWidget> {
   String? _secondaryArtistName;
   int? _secondaryAlbumId;
   String? _secondaryAlbumName;
+
+  // 本地搜索结果（按关键词缓存，关键词不变时不重复查询）
+  String? _localKeyword;
+  List<Track> _localResults = const [];
   
   @override
   void initState() {
@@ -336,8 +341,11 @@ class _SearchWidgetState extends State<SearchWidget> {
     // 获取合并后的结果
     final mergedResults = _searchService.getMergedResults();
 
+    // 设备上已有的歌曲，不用等网络搜索
+    final localResults = _localResultsFor(_searchService.currentKeyword);
+
     // 如果所有平台都加载完成且没有结果
-    if (result.allCompleted && mergedResults.isEmpty) {
+    if (result.allCompleted && mergedResults.isEmpty && localResults.isEmpty) {
       return _buildEmptyState(
         icon: Icons.music_off,
         title: '没有找到相关歌曲',
@@ -373,12 +381,33 @@ class _SearchWidgetState extends State<SearchWidget> {
             ),
           ),
         
+        // 本地、收藏与历史中的匹配
+        if (localResults.isNotEmpty) ...[
+          Padding(
+            padding: const EdgeInsets.only(left: 4, bottom: 8),
+            child: Text(
+              '本地与收藏',
+              style: Theme.of(context).textTheme.titleSmall,
+            ),
+          ),
+          ...localResults.map((track) => _buildLocalTrackItem(track)),
+          const SizedBox(height: 8),
+        ],
+
         // 合并后的歌曲列表
         ...mergedResults.map((mergedTrack) => _buildMergedTrackItem(mergedTrack)),
       ],
     );
   }
 
+  List<Track> _localResultsFor(String keyword) {
+    if (keyword != _localKeyword) {
+      _localKeyword = keyword;
+      _localResults = LocalSearchService().search(keyword, limit: 10);
+    }
+    return _localResults;
+  }
+
   Widget _buildArtistResults() {
     final keyword = _searchService.currentKeyword;
     if (keyword.isEmpty) {
@@ -570,6 +599,76 @@ class _SearchWidgetState extends State<SearchWidget> {
     );
   }
 
+  /// 构建本地搜索结果项
+  Widget _buildLocalTrackItem(Track track) {
+    final hasCover = track.picUrl.startsWith('http');
+    return Card(
+      margin: const EdgeInsets.only(bottom: 8),
+      child: ListTile(
+        leading: ClipRRect(
+          borderRadius: BorderRadius.circular(4),
+          child: hasCover
+              ? CachedNetworkImage(
+                  imageUrl: track.picUrl,
+                  width: 50,
+                  height: 50,
+                  fit: BoxFit.cover,
+                  errorWidget: (context, url, error) => _buildCoverPlaceholder(track),
+                )
+              : _buildCoverPlaceholder(track),
+        ),
+        title: Text(
+          track.name,
+          maxLines: 1,
+          overflow: TextOverflow.ellipsis,
+        ),
+        subtitle: Text(
+          '${track.artists} • ${track.album}',
+          maxLines: 1,
+          overflow: TextOverflow.ellipsis,
+          style: Theme.of(context).textTheme.bodySmall,
+        ),
+        trailing: Text(track.getSourceIcon()),
+        onTap: () => _playLocalTrack(track),
+      ),
+    );
+  }
+
+  Widget _buildCoverPlaceholder(Track track) {
+    return Container(
+      width: 50,
+      height: 50,
+      color: Theme.of(context).colorScheme.surfaceContainerHighest,
+      child: Icon(
+        track.source == MusicSource.local ? Icons.folder : Icons.music_note,
+        color: Theme.of(context).colorScheme.onSurfaceVariant,
+      ),
+    );
+  }
+
+  /// 播放本地搜索结果（本地文件不需要登录）
+  void _playLocalTrack(Track track) async {
+    if (track.source != MusicSource.local) {
+      final isLoggedIn = await _checkLoginStatus();
+      if (!isLoggedIn) return;
+    }
+
+    if (track.picUrl.startsWith('http')) {
+      final provider = CachedNetworkImageProvider(track.picUrl);
+      PlayerService().setCurrentCoverImageProvider(provider);
+    }
+    PlayerService().playTrack(track);
+
+    if (mounted) {
+      ScaffoldMessenger.of(context).showSnackBar(
+        SnackBar(
+          content: Text('正在播放: ${track.name}'),
+          duration: const Duration(seconds: 1),
+        ),
+      );
+    }
+  }
+
   /// 播放合并后的歌曲（按优先级选择平台）
   void _playMergedTrack(MergedTrack mergedTrack) async {
     // 检查登录状态
@@ -1,5 +1,6 @@
 import 'package:flutter/material.dart';
 import 'package:cached_network_image/cached_network_image.dart';
+import 'cover_image.dart';
 import '../models/track.dart';
 import '../services/player_service.dart';
 import '../services/auth_service.dart';
@@ -96,7 +97,7 @@ class _TrackListTileState extends State<TrackListTile> {
           // 封面
           ClipRRect(
             borderRadius: BorderRadius.circular(6),
-            child: CachedNetworkImage(
+            child: CoverImage(
               imageUrl: widget.track.picUrl,
               width: 50,
               height: 50,
@@ -0,0 +1,329 @@
+#include "desktop_lyric_plugin.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "desktop_lyric_window.h"
+#include "lyric_style.h"
+#include "lyric_timeline.h"
+
+namespace {
+
+struct DesktopLyricPlugin {
+  FlMethodChannel* channel;
+  std::unique_ptr<DesktopLyricWindow> window;
+};
+
+void desktop_lyric_plugin_free(gpointer data) {
+  auto* plugin = static_cast<DesktopLyricPlugin*>(data);
+  plugin->window.reset();
+  g_clear_object(&plugin->channel);
+  delete plugin;
+}
+
+// Looks up |key| in a method-call argument map.
+FlValue* lookup_value(FlValue* args, const char* key) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  return fl_value_lookup_string(args, key);
+}
+
+const gchar* lookup_string(FlValue* args, const char* key) {
+  FlValue* value = lookup_value(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+bool has_int(FlValue* args, const char* key) {
+  FlValue* value = lookup_value(args, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_INT;
+}
+
+int64_t lookup_int(FlValue* args, const char* key) {
+  return has_int(args, key) ? fl_value_get_int(lookup_value(args, key)) : 0;
+}
+
+bool has_bool(FlValue* args, const char* key) {
+  FlValue* value = lookup_value(args, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_BOOL;
+}
+
+std::string lookup_text(FlValue* args, const char* key) {
+  const gchar* text = lookup_string(args, key);
+  return text != nullptr ? text : "";
+}
+
+// Converts the setLyricDocument payload:
+//   [{time, text, translation?, words?: [{time, duration, text}]}]
+std::vector<cyrene::LyricTimelineLine> parse_lyric_document(FlValue* list) {
+  std::vector<cyrene::LyricTimelineLine> lines;
+  size_t count = fl_value_get_length(list);
+  lines.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    FlValue* item = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(item) != FL_VALUE_TYPE_MAP) continue;
+
+    cyrene::LyricTimelineLine line;
+    line.start_ms = lookup_int(item, "time");
+    line.text = lookup_text(item, "text");
+    line.translation = lookup_text(item, "translation");
+    FlValue* words = lookup_value(item, "words");
+    if (words != nullptr && fl_value_get_type(words) == FL_VALUE_TYPE_LIST) {
+      for (size_t j = 0; j < fl_value_get_length(words); ++j) {
+        FlValue* word_item = fl_value_get_list_value(words, j);
+        if (fl_value_get_type(word_item) != FL_VALUE_TYPE_MAP) continue;
+        cyrene::LyricWord word;
+        word.start_ms = lookup_int(word_item, "time");
+        word.duration_ms = lookup_int(word_item, "duration");
+        word.text = lookup_text(word_item, "text");
+        line.words.push_back(std::move(word));
+      }
+    }
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
+FlMethodResponse* success(bool value) {
+  g_autoptr(FlValue) result = fl_value_new_bool(value);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* invalid_argument(const std::string& message) {
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      "INVALID_ARGUMENT", message.c_str(), nullptr));
+}
+
+FlMethodResponse* on_create(DesktopLyricPlugin* plugin, FlMethodCall* call) {
+  return success(plugin->window->Create());
+}
+
+FlMethodResponse* on_destroy(DesktopLyricPlugin* plugin, FlMethodCall* call) {
+  plugin->window->Destroy();
+  return success(true);
+}
+
+FlMethodResponse* on_show(DesktopLyricPlugin* plugin, FlMethodCall* call) {
+  plugin->window->Show();
+  return success(true);
+}
+
+FlMethodResponse* on_hide(DesktopLyricPlugin* plugin, FlMethodCall* call) {
+  plugin->window->Hide();
+  return success(true);
+}
+
+FlMethodResponse* on_is_visible(DesktopLyricPlugin* plugin,
+                                FlMethodCall* call) {
+  return success(plugin->window->IsVisible());
+}
+
+FlMethodResponse* on_set_lyric_text(DesktopLyricPlugin* plugin,
+                                    FlMethodCall* call) {
+  const gchar* text = lookup_string(fl_method_call_get_args(call), "text");
+  if (text == nullptr) {
+    return invalid_argument("Missing 'text' argument");
+  }
+  plugin->window->SetLyricText(text);
+  return success(true);
+}
+
+FlMethodResponse* on_set_lyric_document(DesktopLyricPlugin* plugin,
+                                        FlMethodCall* call) {
+  FlValue* lines = lookup_value(fl_method_call_get_args(call), "lines");
+  if (lines == nullptr || fl_value_get_type(lines) != FL_VALUE_TYPE_LIST) {
+    return invalid_argument("Missing 'lines' argument");
+  }
+  plugin->window->SetLyricDocument(parse_lyric_document(lines));
+  return success(true);
+}
+
+FlMethodResponse* on_sync_position(DesktopLyricPlugin* plugin,
+                                   FlMethodCall* call) {
+  FlValue* args = fl_method_call_get_args(call);
+  if (!has_int(args, "position")) {
+    return invalid_argument("Missing 'position' argument");
+  }
+  bool playing = has_bool(args, "playing") &&
+                 fl_value_get_bool(lookup_value(args, "playing"));
+  plugin->window->SyncPosition(lookup_int(args, "position"), playing);
+  return success(true);
+}
+
+FlMethodResponse* on_set_position(DesktopLyricPlugin* plugin,
+                                  FlMethodCall* call) {
+  FlValue* args = fl_method_call_get_args(call);
+  if (!has_int(args, "x") || !has_int(args, "y")) {
+    return invalid_argument("Missing 'x' or 'y' argument");
+  }
+  plugin->window->SetPosition(static_cast<int>(lookup_int(args, "x")),
+                              static_cast<int>(lookup_int(args, "y")));
+  return success(true);
+}
+
+FlMethodResponse* on_get_position(DesktopLyricPlugin* plugin,
+                                  FlMethodCall* call) {
+  int x = 0, y = 0;
+  plugin->window->GetPosition(&x, &y);
+  g_autoptr(FlValue) position = fl_value_new_map();
+  fl_value_set_string_take(position, "x", fl_value_new_int(x));
+  fl_value_set_string_take(position, "y", fl_value_new_int(y));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(position));
+}
+
+FlMethodResponse* on_apply_style(DesktopLyricPlugin* plugin,
+                                 FlMethodCall* call) {
+  // A packed style update (see native/lyric_style.h) applied with one redraw.
+  FlValue* args = fl_method_call_get_args(call);
+  cyrene::LyricStyleUpdate update;
+  if (args == nullptr ||
+      fl_value_get_type(args) != FL_VALUE_TYPE_UINT8_LIST ||
+      !cyrene::DecodeLyricStyle(fl_value_get_uint8_list(args),
+                                fl_value_get_length(args), &update)) {
+    return invalid_argument("Malformed style update");
+  }
+  plugin->window->ApplyStyle(update);
+  return success(true);
+}
+
+FlMethodResponse* on_set_style_property(DesktopLyricPlugin* plugin,
+                                        FlMethodCall* call) {
+  // Single-property setters, kept for older callers: each maps onto a
+  // one-field style update.
+  struct Property {
+    const char* argument;
+    uint16_t field;
+    bool is_bool;
+  };
+  static const std::unordered_map<std::string, Property> properties = {
+      {"setFontSize", {"size", cyrene::kLyricStyleFontSize, false}},
+      {"setTextColor", {"color", cyrene::kLyricStyleTextColor, false}},
+      {"setStrokeColor", {"color", cyrene::kLyricStyleStrokeColor, false}},
+      {"setStrokeWidth", {"width", cyrene::kLyricStyleStrokeWidth, false}},
+      {"setHighlightColor",
+       {"color", cyrene::kLyricStyleHighlightColor, false}},
+      {"setDraggable", {"draggable", cyrene::kLyricStyleDraggable, true}},
+      {"setMouseTransparent",
+       {"transparent", cyrene::kLyricStyleMouseTransparent, true}},
+  };
+  const Property& property = properties.at(fl_method_call_get_name(call));
+
+  FlValue* args = fl_method_call_get_args(call);
+  bool present = property.is_bool ? has_bool(args, property.argument)
+                                  : has_int(args, property.argument);
+  if (!present) {
+    return invalid_argument(std::string("Missing '") + property.argument +
+                            "' argument");
+  }
+
+  cyrene::LyricStyleUpdate update;
+  update.fields = property.field;
+  cyrene::LyricStyle& values = update.values;
+  FlValue* value = lookup_value(args, property.argument);
+  if (property.is_bool) {
+    bool flag = fl_value_get_bool(value);
+    values.draggable = flag;
+    values.mouse_transparent = flag;
+  } else {
+    int64_t number = fl_value_get_int(value);
+    values.font_size = static_cast<int32_t>(number);
+    values.stroke_width = static_cast<int32_t>(number);
+    values.text_color = static_cast<uint32_t>(number);
+    values.stroke_color = static_cast<uint32_t>(number);
+    values.highlight_color = static_cast<uint32_t>(number);
+  }
+  plugin->window->ApplyStyle(update);
+  return success(true);
+}
+
+FlMethodResponse* on_get_render_stats(DesktopLyricPlugin* plugin,
+                                      FlMethodCall* call) {
+  // Frame times and glyph cache counters, for diagnostics.
+  const auto& frames = plugin->window->frame_stats();
+  const auto& cache = plugin->window->glyph_cache();
+  g_autoptr(FlValue) stats = fl_value_new_map();
+  fl_value_set_string_take(stats, "frames",
+                           fl_value_new_int(frames.frames()));
+  fl_value_set_string_take(stats, "lastFrameUs",
+                           fl_value_new_int(frames.last_us()));
+  fl_value_set_string_take(stats, "averageFrameUs",
+                           fl_value_new_int(frames.average_us()));
+  fl_value_set_string_take(stats, "maxFrameUs",
+                           fl_value_new_int(frames.max_us()));
+  fl_value_set_string_take(stats, "glyphBuilds",
+                           fl_value_new_int(cache.builds()));
+  fl_value_set_string_take(stats, "glyphHits", fl_value_new_int(cache.hits()));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(stats));
+}
+
+using Handler = FlMethodResponse* (*)(DesktopLyricPlugin*, FlMethodCall*);
+
+const std::unordered_map<std::string, Handler>& methods() {
+  // Built once; dispatch is a single hash lookup, as on Windows.
+  static const std::unordered_map<std::string, Handler> table = {
+      {"create", on_create},
+      {"destroy", on_destroy},
+      {"show", on_show},
+      {"hide", on_hide},
+      {"isVisible", on_is_visible},
+      {"setLyricText", on_set_lyric_text},
+      {"setLyricDocument", on_set_lyric_document},
+      {"syncPosition", on_sync_position},
+      {"setPosition", on_set_position},
+      {"getPosition", on_get_position},
+      {"applyStyle", on_apply_style},
+      {"setFontSize", on_set_style_property},
+      {"setTextColor", on_set_style_property},
+      {"setStrokeColor", on_set_style_property},
+      {"setStrokeWidth", on_set_style_property},
+      {"setHighlightColor", on_set_style_property},
+      {"setDraggable", on_set_style_property},
+      {"setMouseTransparent", on_set_style_property},
+      {"getRenderStats", on_get_render_stats},
+  };
+  return table;
+}
+
+void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                    gpointer user_data) {
+  auto* plugin = static_cast<DesktopLyricPlugin*>(user_data);
+  const auto& table = methods();
+  auto it = table.find(fl_method_call_get_name(method_call));
+
+  g_autoptr(FlMethodResponse) response =
+      it != table.end()
+          ? it->second(plugin, method_call)
+          : FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send desktop lyric response: %s", error->message);
+  }
+}
+
+}  // namespace
+
+void desktop_lyric_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  auto* plugin = new DesktopLyricPlugin{
+      nullptr, std::make_unique<DesktopLyricWindow>()};
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  plugin->channel = fl_method_channel_new(
+      fl_plugin_registrar_get_messenger(registrar), "desktop_lyric",
+      FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(plugin->channel, method_call_cb,
+                                            plugin, nullptr);
+
+  // The view owns the plugin: the lyric window is destroyed and the channel
+  // released when the view is destroyed.
+  g_object_set_data_full(G_OBJECT(fl_plugin_registrar_get_view(registrar)),
+                         "desktop-lyric-plugin", plugin,
+                         desktop_lyric_plugin_free);
+}
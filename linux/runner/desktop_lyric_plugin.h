@@ -0,0 +1,20 @@
+#ifndef RUNNER_DESKTOP_LYRIC_PLUGIN_H_
+#define RUNNER_DESKTOP_LYRIC_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+// Implements the "desktop_lyric" channel on Linux with the same methods and
+// arguments as windows/runner/desktop_lyric_plugin.cpp:
+//   create()  destroy()  show()  hide()  isVisible() -> bool
+//   setLyricText({text})  setLyricDocument({lines})
+//   syncPosition({position, playing})
+//   setPosition({x, y})  getPosition() -> {x, y}
+//   applyStyle(Uint8List, see native/lyric_style.h)
+//   setFontSize({size})  setTextColor({color})  setStrokeColor({color})
+//   setStrokeWidth({width})  setHighlightColor({color})
+//   setDraggable({draggable})  setMouseTransparent({transparent})
+//   getRenderStats() -> {frames, lastFrameUs, ..., glyphHits}
+// The lyric window lives as long as the registrar's view.
+void desktop_lyric_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_DESKTOP_LYRIC_PLUGIN_H_
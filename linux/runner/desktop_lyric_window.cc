@@ -0,0 +1,509 @@
+#include "desktop_lyric_window.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kWindowWidth = 800;
+const int kWindowHeight = 100;
+// Pango family list; the first installed CJK font wins.
+const char kFontFamily[] = "Noto Sans CJK SC,WenQuanYi Micro Hei,Sans";
+// Lines kept in the glyph cache (current line, previous one, repeats)
+const size_t kGlyphCacheSize = 16;
+// Karaoke frame timer: ~60 fps
+const guint kKaraokeFrameMs = 16;
+// Glyph key style bit for the two-row karaoke layout
+const int kKaraokeLayoutStyle = 1 << 16;
+// Translation row height and font scale in karaoke layout
+const double kTranslationRowRatio = 0.4;
+const double kTranslationFontRatio = 0.6;
+
+void SetSourceArgb(cairo_t* cr, uint32_t argb) {
+  cairo_set_source_rgba(cr, ((argb >> 16) & 0xFF) / 255.0,  // R
+                        ((argb >> 8) & 0xFF) / 255.0,       // G
+                        (argb & 0xFF) / 255.0,              // B
+                        ((argb >> 24) & 0xFF) / 255.0);     // A
+}
+
+// Pixel bounds of the current path of |cr| (stroked with |stroke_width| when
+// positive), padded by a pixel for anti-aliasing.
+cyrene::LyricRect PathBounds(cairo_t* cr, int stroke_width) {
+  double x1, y1, x2, y2;
+  if (stroke_width > 0) {
+    cairo_set_line_width(cr, stroke_width);
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+    cairo_stroke_extents(cr, &x1, &y1, &x2, &y2);
+  } else {
+    cairo_fill_extents(cr, &x1, &y1, &x2, &y2);
+  }
+  if (x2 <= x1 || y2 <= y1) {
+    return {};
+  }
+  cyrene::LyricRect rect;
+  rect.left = static_cast<int>(std::floor(x1)) - 1;
+  rect.top = static_cast<int>(std::floor(y1)) - 1;
+  rect.right = static_cast<int>(std::ceil(x2)) + 1;
+  rect.bottom = static_cast<int>(std::ceil(y2)) + 1;
+  return rect;
+}
+
+}  // namespace
+
+DesktopLyricWindow::DesktopLyricWindow()
+    : window_(nullptr),
+      surface_(nullptr),
+      cr_(nullptr),
+      layout_(nullptr),
+      translation_layout_(nullptr),
+      highlight_x_(-1),
+      timer_id_(0),
+      glyph_cache_(kGlyphCacheSize) {}
+
+DesktopLyricWindow::~DesktopLyricWindow() { Destroy(); }
+
+bool DesktopLyricWindow::Create() {
+  if (window_ != nullptr) {
+    return true;  // Window already exists
+  }
+
+  window_ = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  GtkWindow* window = GTK_WINDOW(window_);
+  gtk_window_set_title(window, "Desktop Lyric");
+  gtk_window_set_decorated(window, FALSE);
+  gtk_window_set_resizable(window, FALSE);
+  gtk_window_set_default_size(window, kWindowWidth, kWindowHeight);
+  gtk_window_set_type_hint(window, GDK_WINDOW_TYPE_HINT_UTILITY);
+  gtk_window_set_keep_above(window, TRUE);
+  gtk_window_set_skip_taskbar_hint(window, TRUE);
+  gtk_window_set_skip_pager_hint(window, TRUE);
+  gtk_window_set_accept_focus(window, FALSE);
+  gtk_window_set_focus_on_map(window, FALSE);
+
+  // Per-pixel alpha needs an ARGB visual; plain X servers (Xvfb) have none
+  // and keep the default one.
+  gtk_widget_set_app_paintable(window_, TRUE);
+  GdkScreen* screen = gtk_widget_get_screen(window_);
+  GdkVisual* visual = gdk_screen_get_rgba_visual(screen);
+  if (visual != nullptr) {
+    gtk_widget_set_visual(window_, visual);
+  }
+
+  gtk_widget_add_events(window_, GDK_BUTTON_PRESS_MASK);
+  g_signal_connect(window_, "draw", G_CALLBACK(OnDraw), this);
+  g_signal_connect(window_, "button-press-event", G_CALLBACK(OnButtonPress),
+                   this);
+  // Only Destroy() closes the window.
+  g_signal_connect(window_, "delete-event", G_CALLBACK(gtk_true), nullptr);
+
+  // Default position: centre bottom of the primary monitor's work area
+  GdkDisplay* display = gdk_screen_get_display(screen);
+  GdkMonitor* monitor = gdk_display_get_primary_monitor(display);
+  if (monitor == nullptr) {
+    monitor = gdk_display_get_monitor(display, 0);
+  }
+  if (monitor != nullptr) {
+    GdkRectangle area;
+    gdk_monitor_get_workarea(monitor, &area);
+    gtk_window_move(window, area.x + (area.width - kWindowWidth) / 2,
+                    area.y + area.height - kWindowHeight - 100);
+  }
+
+  UpdateMouseTransparency();
+
+  return CreateSurface();
+}
+
+void DesktopLyricWindow::Destroy() {
+  if (timer_id_ != 0) {
+    g_source_remove(timer_id_);
+    timer_id_ = 0;
+  }
+  DestroySurface();
+
+  if (window_ != nullptr) {
+    gtk_widget_destroy(window_);
+    window_ = nullptr;
+  }
+}
+
+void DesktopLyricWindow::Show() {
+  if (window_ != nullptr) {
+    dirty_.InvalidateAll();
+    UpdateWindow();
+    gtk_widget_show(window_);
+    Tick();
+    UpdateTimer();
+  }
+}
+
+void DesktopLyricWindow::Hide() {
+  if (window_ != nullptr) {
+    gtk_widget_hide(window_);
+    UpdateTimer();
+  }
+}
+
+bool DesktopLyricWindow::IsVisible() const {
+  return window_ != nullptr && gtk_widget_get_visible(window_);
+}
+
+void DesktopLyricWindow::SetLyricText(const std::string& text) {
+  bool was_karaoke = !timeline_.empty();
+  if (was_karaoke) {
+    timeline_.Clear();
+    karaoke_ = cyrene::KaraokeFrame();
+    UpdateTimer();
+  }
+  if (text == lyric_text_ && !was_karaoke) {
+    return;
+  }
+  lyric_text_ = text;
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::SetLyricDocument(
+    std::vector<cyrene::LyricTimelineLine> lines) {
+  timeline_.SetLines(std::move(lines));
+  karaoke_ = cyrene::KaraokeFrame();
+  lyric_text_.clear();
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+  Tick();
+  UpdateTimer();
+}
+
+void DesktopLyricWindow::SyncPosition(int64_t position_ms, bool playing) {
+  clock_.Sync(position_ms, playing, cyrene::LyricClock::Clock::now());
+  Tick();
+  UpdateTimer();
+}
+
+void DesktopLyricWindow::Tick() {
+  if (timeline_.empty()) {
+    return;
+  }
+
+  cyrene::KaraokeFrame frame = timeline_.FrameAt(
+      clock_.PositionAt(cyrene::LyricClock::Clock::now()));
+  if (frame == karaoke_) {
+    return;
+  }
+  if (frame.line != karaoke_.line) {
+    lyric_text_.clear();
+    if (frame.line >= 0) {
+      const cyrene::LyricTimelineLine& line = timeline_.line(frame.line);
+      lyric_text_ = line.text;
+      if (!line.translation.empty()) {
+        lyric_text_ += "\n" + line.translation;
+      }
+    }
+  }
+  karaoke_ = frame;
+
+  // Sub-pixel progress steps are absorbed by UpdateWindow's dirty check.
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::UpdateTimer() {
+  bool want = IsVisible() && !timeline_.empty() && clock_.playing();
+  if (want == (timer_id_ != 0)) {
+    return;
+  }
+  if (want) {
+    timer_id_ = g_timeout_add(kKaraokeFrameMs, OnTimer, this);
+  } else {
+    g_source_remove(timer_id_);
+    timer_id_ = 0;
+  }
+}
+
+void DesktopLyricWindow::SetPosition(int x, int y) {
+  if (window_ != nullptr) {
+    gtk_window_move(GTK_WINDOW(window_), x, y);
+  }
+}
+
+void DesktopLyricWindow::GetPosition(int* x, int* y) {
+  if (window_ != nullptr) {
+    gtk_window_get_position(GTK_WINDOW(window_), x, y);
+  }
+}
+
+void DesktopLyricWindow::ApplyStyle(const cyrene::LyricStyleUpdate& update) {
+  cyrene::LyricRedraw redraw = cyrene::ApplyLyricStyle(update, &style_);
+
+  if (update.fields & cyrene::kLyricStyleMouseTransparent) {
+    UpdateMouseTransparency();
+  }
+
+  if (redraw == cyrene::LyricRedraw::kNone) {
+    return;
+  }
+  if (redraw == cyrene::LyricRedraw::kRelayout) {
+    UpdateFont();
+  }
+
+  // One redraw however many properties changed. Colours are read at draw
+  // time; a relayout changes the glyph key, so UpdateWindow also picks up
+  // the new bounds.
+  dirty_.InvalidateContent();
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::UpdateMouseTransparency() {
+  if (window_ == nullptr) return;
+
+  // An empty input shape lets every click fall through to the windows below;
+  // GTK keeps the shape and reapplies it whenever the window is realized.
+  if (style_.mouse_transparent) {
+    cairo_region_t* region = cairo_region_create();
+    gtk_widget_input_shape_combine_region(window_, region);
+    cairo_region_destroy(region);
+  } else {
+    gtk_widget_input_shape_combine_region(window_, nullptr);
+  }
+}
+
+bool DesktopLyricWindow::CreateSurface() {
+  if (surface_ != nullptr) {
+    return true;
+  }
+
+  // Premultiplied ARGB back buffer, kept for the lifetime of the window so
+  // frames only repaint what changed. The layouts belong to its context and
+  // are reused for every line.
+  surface_ = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, kWindowWidth,
+                                        kWindowHeight);
+  if (cairo_surface_status(surface_) != CAIRO_STATUS_SUCCESS) {
+    DestroySurface();
+    return false;
+  }
+  cr_ = cairo_create(surface_);
+  cairo_set_operator(cr_, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr_);
+  cairo_set_operator(cr_, CAIRO_OPERATOR_OVER);
+
+  layout_ = pango_cairo_create_layout(cr_);
+  translation_layout_ = pango_cairo_create_layout(cr_);
+  for (PangoLayout* layout : {layout_, translation_layout_}) {
+    pango_layout_set_width(layout, kWindowWidth * PANGO_SCALE);
+    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+  }
+  UpdateFont();
+
+  highlight_x_ = -1;
+  dirty_.Reset(kWindowWidth, kWindowHeight);
+  return true;
+}
+
+void DesktopLyricWindow::DestroySurface() {
+  glyph_cache_.Clear();
+  g_clear_object(&translation_layout_);
+  g_clear_object(&layout_);
+
+  if (cr_ != nullptr) {
+    cairo_destroy(cr_);
+    cr_ = nullptr;
+  }
+  if (surface_ != nullptr) {
+    cairo_surface_destroy(surface_);
+    surface_ = nullptr;
+  }
+}
+
+void DesktopLyricWindow::UpdateFont() {
+  if (layout_ == nullptr) return;
+
+  // Layouts copy the description, so it is only needed while setting it.
+  PangoFontDescription* font = pango_font_description_from_string(kFontFamily);
+  pango_font_description_set_weight(font, PANGO_WEIGHT_BOLD);
+  pango_font_description_set_absolute_size(font,
+                                           style_.font_size * PANGO_SCALE);
+  pango_layout_set_font_description(layout_, font);
+  pango_font_description_set_absolute_size(
+      font, style_.font_size * kTranslationFontRatio * PANGO_SCALE);
+  pango_layout_set_font_description(translation_layout_, font);
+  pango_font_description_free(font);
+}
+
+void DesktopLyricWindow::AppendText(PangoLayout* layout,
+                                    const std::string& text, double top,
+                                    double height) {
+  pango_layout_set_text(layout, text.data(), static_cast<int>(text.size()));
+  int text_height = 0;
+  pango_layout_get_pixel_size(layout, nullptr, &text_height);
+  cairo_move_to(cr_, 0, top + (height - text_height) / 2);
+  pango_cairo_layout_path(cr_, layout);
+}
+
+cyrene::GlyphKey DesktopLyricWindow::CurrentGlyphKey() const {
+  bool karaoke = karaoke_.line >= 0;
+
+  cyrene::GlyphKey key;
+  key.text = lyric_text_;
+  key.font_family = kFontFamily;
+  key.font_size = static_cast<float>(style_.font_size);
+  key.stroke_width = static_cast<float>(style_.stroke_width);
+  key.style = PANGO_WEIGHT_BOLD | (karaoke ? kKaraokeLayoutStyle : 0);
+  return key;
+}
+
+const LyricGlyphs& DesktopLyricWindow::CurrentGlyphs(
+    const cyrene::GlyphKey& key) {
+  bool karaoke = karaoke_.line >= 0;
+  return glyph_cache_.Get(key, [this, karaoke]() {
+    LyricGlyphs glyphs;
+    double height = kWindowHeight;
+    cairo_new_path(cr_);
+
+    if (!karaoke) {
+      AppendText(layout_, lyric_text_, 0, height);
+    } else {
+      // Sung line on top, smaller translation underneath. The line gets its
+      // own path so the highlight can be filled over it alone.
+      const cyrene::LyricTimelineLine& line = timeline_.line(karaoke_.line);
+      double line_height = line.translation.empty()
+                               ? height
+                               : height * (1 - kTranslationRowRatio);
+      AppendText(layout_, line.text, 0, line_height);
+      glyphs.line.reset(cairo_copy_path_flat(cr_));
+      glyphs.line_bounds = PathBounds(cr_, 0);
+      if (!line.translation.empty()) {
+        AppendText(translation_layout_, line.translation, line_height,
+                   height - line_height);
+      }
+    }
+
+    // Flattening once here turns every later fill and stroke into plain
+    // line segments.
+    glyphs.fill.reset(cairo_copy_path_flat(cr_));
+    glyphs.bounds = PathBounds(cr_, style_.stroke_width);
+    cairo_new_path(cr_);
+    return glyphs;
+  });
+}
+
+void DesktopLyricWindow::UpdateWindow() {
+  if (window_ == nullptr || surface_ == nullptr) return;
+
+  cyrene::ScopedFrameTimer frame_timer(&frame_stats_);
+
+  cyrene::GlyphKey key;
+  const LyricGlyphs* glyphs = nullptr;
+  if (!lyric_text_.empty()) {
+    key = CurrentGlyphKey();
+    glyphs = &CurrentGlyphs(key);
+  }
+  dirty_.SetContent(glyphs != nullptr ? glyphs->bounds : cyrene::LyricRect{},
+                    key);
+
+  // Karaoke: repaint only the strip the highlight edge moved across.
+  int highlight_x = -1;
+  if (glyphs != nullptr && glyphs->line) {
+    const cyrene::LyricRect& line = glyphs->line_bounds;
+    highlight_x = line.left + static_cast<int>(std::lround(
+                                  karaoke_.progress * line.width()));
+  }
+  if (highlight_x != highlight_x_) {
+    if (glyphs != nullptr && glyphs->line) {
+      int from = highlight_x_ < 0 ? glyphs->line_bounds.left : highlight_x_;
+      dirty_.Invalidate({std::min(from, highlight_x) - 1,
+                         glyphs->line_bounds.top,
+                         std::max(from, highlight_x) + 1,
+                         glyphs->line_bounds.bottom});
+    }
+    highlight_x_ = highlight_x;
+  }
+
+  if (!dirty_.HasDirty()) {
+    return;  // Nothing visible changed
+  }
+  cyrene::LyricRect dirty = dirty_.Take();
+
+  DrawLyric(glyphs, dirty);
+  cairo_surface_flush(surface_);
+
+  // Only the dirty rectangle is exposed and copied to the window.
+  gtk_widget_queue_draw_area(window_, dirty.left, dirty.top, dirty.width(),
+                             dirty.height());
+}
+
+void DesktopLyricWindow::DrawLyric(const LyricGlyphs* glyphs,
+                                   const cyrene::LyricRect& dirty) {
+  cairo_save(cr_);
+
+  // Clear background (transparent) inside the dirty rectangle only
+  cairo_rectangle(cr_, dirty.left, dirty.top, dirty.width(), dirty.height());
+  cairo_clip(cr_);
+  cairo_set_operator(cr_, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr_);
+  cairo_set_operator(cr_, CAIRO_OPERATOR_OVER);
+
+  if (glyphs != nullptr) {
+    cairo_new_path(cr_);
+    cairo_append_path(cr_, glyphs->fill.get());
+    if (style_.stroke_width > 0) {
+      SetSourceArgb(cr_, style_.stroke_color);
+      cairo_set_line_width(cr_, style_.stroke_width);
+      cairo_set_line_join(cr_, CAIRO_LINE_JOIN_ROUND);
+      cairo_stroke_preserve(cr_);
+    }
+    SetSourceArgb(cr_, style_.text_color);
+    cairo_fill(cr_);
+
+    if (glyphs->line && highlight_x_ > glyphs->line_bounds.left) {
+      const cyrene::LyricRect& line = glyphs->line_bounds;
+      cairo_rectangle(cr_, line.left, line.top, highlight_x_ - line.left,
+                      line.height());
+      cairo_clip(cr_);
+      cairo_append_path(cr_, glyphs->line.get());
+      SetSourceArgb(cr_, style_.highlight_color);
+      cairo_fill(cr_);
+    }
+  }
+
+  cairo_restore(cr_);
+}
+
+// static
+gboolean DesktopLyricWindow::OnDraw(GtkWidget* widget, cairo_t* cr,
+                                    gpointer user_data) {
+  auto* self = static_cast<DesktopLyricWindow*>(user_data);
+  if (self->surface_ == nullptr) {
+    return FALSE;
+  }
+  // GTK has already clipped |cr| to the exposed area.
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(cr, self->surface_, 0, 0);
+  cairo_paint(cr);
+  return TRUE;
+}
+
+// static
+gboolean DesktopLyricWindow::OnButtonPress(GtkWidget* widget,
+                                           GdkEventButton* event,
+                                           gpointer user_data) {
+  auto* self = static_cast<DesktopLyricWindow*>(user_data);
+  if (event->type == GDK_BUTTON_PRESS && event->button == 1 &&
+      self->style_.draggable) {
+    // Let the window manager run the move, as a title bar drag would.
+    gtk_window_begin_move_drag(GTK_WINDOW(widget), event->button,
+                               static_cast<gint>(event->x_root),
+                               static_cast<gint>(event->y_root), event->time);
+  }
+  return TRUE;
+}
+
+// static
+gboolean DesktopLyricWindow::OnTimer(gpointer user_data) {
+  static_cast<DesktopLyricWindow*>(user_data)->Tick();
+  return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,137 @@
+#ifndef RUNNER_DESKTOP_LYRIC_WINDOW_H_
+#define RUNNER_DESKTOP_LYRIC_WINDOW_H_
+
+#include <gtk/gtk.h>
+#include <pango/pangocairo.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lyric_render_core.h"
+#include "lyric_style.h"
+#include "lyric_timeline.h"
+
+struct CairoPathDeleter {
+  void operator()(cairo_path_t* path) const { cairo_path_destroy(path); }
+};
+using CairoPath = std::unique_ptr<cairo_path_t, CairoPathDeleter>;
+
+// Cached outline of one lyric line, shaped by Pango and flattened once: the
+// text fill and the pixel bounds it covers once stroked. In karaoke mode
+// |line| is the sung line alone (without its translation), which the
+// highlight is clipped over.
+struct LyricGlyphs {
+  CairoPath fill;
+  cyrene::LyricRect bounds;
+  CairoPath line;
+  cyrene::LyricRect line_bounds;
+};
+
+// Always-on-top, undecorated RGBA window showing the desktop lyric; the GTK
+// counterpart of windows/runner/desktop_lyric_window.h.
+//
+// Frames are painted into a persistent cairo image surface and only the
+// dirty rectangle is queued for drawing, so a lyric change costs one outline
+// build (or a cache hit) plus a blit of the changed area. Nothing depends on
+// a compositor or GL, so the window also maps under Xvfb; without a
+// compositor the transparent background simply shows as black.
+class DesktopLyricWindow {
+ public:
+  DesktopLyricWindow();
+  ~DesktopLyricWindow();
+
+  DesktopLyricWindow(const DesktopLyricWindow&) = delete;
+  DesktopLyricWindow& operator=(const DesktopLyricWindow&) = delete;
+
+  bool Create();
+  void Destroy();
+
+  void Show();
+  void Hide();
+  bool IsVisible() const;
+
+  // Set lyric text, UTF-8 (leaves karaoke mode)
+  void SetLyricText(const std::string& text);
+
+  // Load a whole timed lyric document; see the Windows window for the
+  // karaoke model. An empty document leaves karaoke mode.
+  void SetLyricDocument(std::vector<cyrene::LyricTimelineLine> lines);
+
+  // Playback position report (milliseconds) and play state
+  void SyncPosition(int64_t position_ms, bool playing);
+
+  void SetPosition(int x, int y);
+  void GetPosition(int* x, int* y);
+
+  // Apply several style properties at once with a single redraw
+  void ApplyStyle(const cyrene::LyricStyleUpdate& update);
+
+  // Render statistics (frame times and glyph cache counters)
+  const cyrene::FrameStats& frame_stats() const { return frame_stats_; }
+  const cyrene::GlyphCache<LyricGlyphs>& glyph_cache() const {
+    return glyph_cache_;
+  }
+
+ private:
+  static gboolean OnDraw(GtkWidget* widget, cairo_t* cr, gpointer user_data);
+  static gboolean OnButtonPress(GtkWidget* widget, GdkEventButton* event,
+                                gpointer user_data);
+  static gboolean OnTimer(gpointer user_data);
+
+  // Repaint the dirty area of the back buffer and queue it for drawing
+  void UpdateWindow();
+
+  // Create/release the persistent back buffer and Pango objects
+  bool CreateSurface();
+  void DestroySurface();
+
+  // Apply style_.font_size to both layouts
+  void UpdateFont();
+
+  // Cache key of the current line's outline
+  cyrene::GlyphKey CurrentGlyphKey() const;
+
+  // Outline for |key|, built on first use and cached
+  const LyricGlyphs& CurrentGlyphs(const cyrene::GlyphKey& key);
+
+  // Lay out |text| centred in the given row and append its outline to the
+  // back buffer context's current path
+  void AppendText(PangoLayout* layout, const std::string& text, double top,
+                  double height);
+
+  // Draw lyric into the dirty rectangle of the back buffer
+  void DrawLyric(const LyricGlyphs* glyphs, const cyrene::LyricRect& dirty);
+
+  // Advance karaoke to the clock's current position
+  void Tick();
+
+  // Run the frame timer only while karaoke is visibly playing
+  void UpdateTimer();
+
+  // Apply style_.mouse_transparent to the window's input shape
+  void UpdateMouseTransparency();
+
+  GtkWidget* window_;
+  std::string lyric_text_;  // Also the glyph cache key
+  cyrene::LyricStyle style_;
+
+  // Back buffer and layout objects kept across frames
+  cairo_surface_t* surface_;
+  cairo_t* cr_;
+  PangoLayout* layout_;
+  PangoLayout* translation_layout_;
+
+  // Karaoke state
+  cyrene::LyricTimeline timeline_;
+  cyrene::LyricClock clock_;
+  cyrene::KaraokeFrame karaoke_;
+  int highlight_x_;  // Right edge of the highlight, or -1 for none
+  guint timer_id_;
+
+  cyrene::GlyphCache<LyricGlyphs> glyph_cache_;
+  cyrene::DirtyTracker dirty_;
+  cyrene::FrameStats frame_stats_;
+};
+
+#endif  // RUNNER_DESKTOP_LYRIC_WINDOW_H_
@@ -0,0 +1,336 @@
+#include "library_watcher.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR |
+                                IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+// Same list as LocalLibraryService.supportedAudioExts, plus sidecar lyrics.
+constexpr const char* kLibraryExtensions[] = {
+    "mp3", "wav", "flac", "aac", "m4a", "ogg",
+    "opus", "ape", "wma", "alac", "lrc",
+};
+
+bool IsLibraryFile(const char* name) {
+  const char* dot = std::strrchr(name, '.');
+  if (dot == nullptr || dot == name) return false;
+  for (const char* extension : kLibraryExtensions) {
+    if (!strcasecmp(dot + 1, extension)) return true;
+  }
+  return false;
+}
+
+bool IsUnder(const std::string& path, const std::string& directory) {
+  return path.size() > directory.size() &&
+         path.compare(0, directory.size(), directory) == 0 &&
+         path[directory.size()] == '/';
+}
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string StripTrailingSlash(std::string path) {
+  while (path.size() > 1 && path.back() == '/') path.pop_back();
+  return path;
+}
+
+}  // namespace
+
+LibraryWatcher::LibraryWatcher(Callback callback)
+    : callback_(std::move(callback)) {}
+
+LibraryWatcher::~LibraryWatcher() {
+  if (thread_.joinable()) {
+    stopping_ = true;
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+    thread_.join();
+  }
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+  if (wake_fd_ >= 0) close(wake_fd_);
+}
+
+bool LibraryWatcher::Start() {
+  if (inotify_fd_ >= 0) return true;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) return false;
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+    return false;
+  }
+  thread_ = std::thread(&LibraryWatcher::Run, this);
+  return true;
+}
+
+bool LibraryWatcher::Watch(const std::string& root) {
+  std::string directory = StripTrailingSlash(root);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Start()) return false;
+  if (std::find(roots_.begin(), roots_.end(), directory) == roots_.end()) {
+    roots_.push_back(directory);
+  }
+  AddTree(directory, false);
+  return watches_.count(directory) != 0;
+}
+
+void LibraryWatcher::Unwatch(const std::string& root) {
+  std::string directory = StripTrailingSlash(root);
+  std::lock_guard<std::mutex> lock(mutex_);
+  roots_.erase(std::remove(roots_.begin(), roots_.end(), directory),
+               roots_.end());
+  // Keep the watches if another root still covers the folder.
+  for (const std::string& other : roots_) {
+    if (directory == other || IsUnder(directory, other)) return;
+  }
+  RemoveTree(directory);
+}
+
+void LibraryWatcher::UnwatchAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& watch : directories_) {
+    inotify_rm_watch(inotify_fd_, watch.first);
+  }
+  roots_.clear();
+  directories_.clear();
+  watches_.clear();
+  batch_.clear();
+  batch_index_.clear();
+}
+
+size_t LibraryWatcher::watch_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return directories_.size();
+}
+
+void LibraryWatcher::Run() {
+  pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+  while (!stopping_) {
+    int timeout = -1;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!batch_.empty()) {
+        int64_t deadline = std::min(last_event_ms_ + kQuietMs,
+                                    batch_started_ms_ + kMaxDelayMs);
+        timeout = static_cast<int>(std::max<int64_t>(0, deadline - NowMs()));
+      }
+    }
+    int ready = poll(fds, 2, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[1].revents & POLLIN) continue;  // Woken up to stop
+    if (fds[0].revents & POLLIN) ReadEvents();
+    Flush();
+  }
+}
+
+void LibraryWatcher::ReadEvents() {
+  alignas(inotify_event) char buffer[64 * 1024];
+  // Cookie -> (source path, is directory) of moves waiting for their
+  // IN_MOVED_TO. The kernel queues both halves of a rename together, so
+  // whatever is still unmatched once the queue is drained moved out.
+  std::unordered_map<uint32_t, std::pair<std::string, bool>> moves;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (;;) {
+    ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) break;  // EAGAIN: drained
+
+    for (char* p = buffer; p < buffer + length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        for (const std::string& root : roots_) {
+          Record(root, LibraryChange::kRescan, true);
+        }
+        continue;
+      }
+      auto directory = directories_.find(event->wd);
+      if (directory == directories_.end()) continue;
+      if (event->mask & IN_IGNORED) {
+        watches_.erase(directory->second);
+        directories_.erase(directory);
+        continue;
+      }
+      if (event->len == 0) continue;  // Events on the directory itself
+
+      std::string path = directory->second + "/" + event->name;
+      bool is_directory = (event->mask & IN_ISDIR) != 0;
+      bool relevant = is_directory || IsLibraryFile(event->name);
+
+      if (event->mask & IN_MOVED_FROM) {
+        moves[event->cookie] = {std::move(path), is_directory};
+      } else if (event->mask & IN_MOVED_TO) {
+        auto source = moves.find(event->cookie);
+        if (source != moves.end()) {
+          const std::string& from = source->second.first;
+          bool was_relevant = is_directory || IsLibraryFile(
+              from.c_str() + from.rfind('/') + 1);
+          if (is_directory) RenameTree(from, path);
+          if (was_relevant && relevant) {
+            RecordRename(from, path, is_directory);
+          } else if (was_relevant) {
+            Record(from, LibraryChange::kRemoved, false);
+          } else if (relevant) {
+            Record(path, LibraryChange::kAdded, false);
+          }
+          moves.erase(source);
+        } else if (is_directory) {
+          AddTree(path, true);
+        } else if (relevant) {
+          Record(path, LibraryChange::kAdded, false);
+        }
+      } else if (event->mask & IN_CREATE) {
+        // Files are reported when closed after writing; directories are
+        // watched right away so that files written into them are seen.
+        if (is_directory) AddTree(path, true);
+      } else if (event->mask & IN_CLOSE_WRITE) {
+        if (relevant) Record(path, LibraryChange::kAdded, false);
+      } else if (event->mask & IN_DELETE) {
+        // A deleted directory's own watch is dropped with IN_IGNORED.
+        if (relevant) Record(path, LibraryChange::kRemoved, is_directory);
+      }
+    }
+  }
+
+  for (auto& move : moves) {
+    const std::string& path = move.second.first;
+    bool is_directory = move.second.second;
+    if (is_directory) {
+      RemoveTree(path);
+      Record(path, LibraryChange::kRemoved, true);
+    } else if (IsLibraryFile(path.c_str() + path.rfind('/') + 1)) {
+      Record(path, LibraryChange::kRemoved, false);
+    }
+  }
+}
+
+void LibraryWatcher::Flush() {
+  std::vector<LibraryChange> changes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (batch_.empty()) return;
+    int64_t now = NowMs();
+    if (now < last_event_ms_ + kQuietMs &&
+        now < batch_started_ms_ + kMaxDelayMs) {
+      return;
+    }
+    changes.swap(batch_);
+    batch_index_.clear();
+  }
+  callback_(std::move(changes));
+}
+
+void LibraryWatcher::AddTree(const std::string& directory, bool report) {
+  std::vector<std::string> stack{directory};
+  while (!stack.empty()) {
+    std::string path = std::move(stack.back());
+    stack.pop_back();
+
+    int wd = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+    if (wd < 0) {
+      if (errno == ENOSPC) ++failed_watches_;
+      continue;
+    }
+    // The same directory may come back under a new name.
+    auto known = directories_.find(wd);
+    if (known != directories_.end()) watches_.erase(known->second);
+    directories_[wd] = path;
+    watches_[path] = wd;
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) continue;
+    while (dirent* entry = readdir(dir)) {
+      const char* name = entry->d_name;
+      if (!std::strcmp(name, ".") || !std::strcmp(name, "..")) continue;
+      unsigned char type = entry->d_type;
+      if (type == DT_UNKNOWN) {
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        type = S_ISDIR(st.st_mode) ? DT_DIR
+               : S_ISREG(st.st_mode) ? DT_REG
+                                     : DT_UNKNOWN;
+      }
+      if (type == DT_DIR) {
+        stack.push_back(path + "/" + name);
+      } else if (report && (type == DT_REG || type == DT_LNK) &&
+                 IsLibraryFile(name)) {
+        Record(path + "/" + name, LibraryChange::kAdded, false);
+      }
+    }
+    closedir(dir);
+  }
+}
+
+void LibraryWatcher::RemoveTree(const std::string& directory) {
+  for (auto it = directories_.begin(); it != directories_.end();) {
+    if (it->second == directory || IsUnder(it->second, directory)) {
+      inotify_rm_watch(inotify_fd_, it->first);
+      watches_.erase(it->second);
+      it = directories_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void LibraryWatcher::RenameTree(const std::string& from,
+                                const std::string& to) {
+  for (auto& watch : directories_) {
+    std::string& path = watch.second;
+    if (path != from && !IsUnder(path, from)) continue;
+    watches_.erase(path);
+    path = to + path.substr(from.size());
+    watches_[path] = watch.first;
+  }
+}
+
+void LibraryWatcher::Record(const std::string& path, LibraryChange::Kind kind,
+                            bool is_directory) {
+  int64_t now = NowMs();
+  if (batch_.empty()) batch_started_ms_ = now;
+  last_event_ms_ = now;
+
+  auto known = batch_index_.find(path);
+  if (known != batch_index_.end()) {
+    LibraryChange& change = batch_[known->second];
+    change.kind = kind;
+    change.is_directory = is_directory;
+    return;
+  }
+  batch_index_[path] = batch_.size();
+  batch_.push_back({kind, path, std::string(), is_directory});
+}
+
+void LibraryWatcher::RecordRename(const std::string& from,
+                                  const std::string& to, bool is_directory) {
+  int64_t now = NowMs();
+  if (batch_.empty()) batch_started_ms_ = now;
+  last_event_ms_ = now;
+
+  batch_.push_back({LibraryChange::kRenamed, to, from, is_directory});
+  batch_index_.clear();
+}
@@ -0,0 +1,105 @@
+#ifndef RUNNER_LIBRARY_WATCHER_H_
+#define RUNNER_LIBRARY_WATCHER_H_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One change to a watched library folder. Paths are absolute.
+struct LibraryChange {
+  enum Kind {
+    kAdded,    // A file was written or moved in (also sent for rewrites)
+    kRemoved,  // A file, or a directory with everything under it, went away
+    kRenamed,  // |old_path| moved to |path| inside the watched folders
+    kRescan,   // Events were lost; |path| is the root to rescan
+  };
+
+  Kind kind;
+  std::string path;
+  std::string old_path;
+  bool is_directory = false;
+};
+
+// Watches library folders recursively with inotify and reports changes to
+// audio and .lrc files in debounced batches.
+//
+// A background thread reads the inotify queue. Changes are coalesced per
+// path and delivered once the folders have been quiet for kQuietMs, or at
+// the latest kMaxDelayMs after the first one, so a copy or move of thousands
+// of files arrives as a few large batches. Moves within the watched folders
+// become renames (directories once, not per file); a directory created or
+// moved in is watched and its existing files reported as added. A kernel
+// queue overflow is reported as kRescan.
+//
+// fanotify would avoid the per-directory watches but needs CAP_SYS_ADMIN,
+// which a desktop app does not have; the inotify watch limit
+// (fs.inotify.max_user_watches) caps the number of directories instead, and
+// directories past it are counted in failed_watches().
+//
+// The callback runs on the watcher thread.
+class LibraryWatcher {
+ public:
+  using Callback = std::function<void(std::vector<LibraryChange>)>;
+
+  static constexpr int kQuietMs = 300;
+  static constexpr int kMaxDelayMs = 2000;
+
+  explicit LibraryWatcher(Callback callback);
+  ~LibraryWatcher();
+
+  LibraryWatcher(const LibraryWatcher&) = delete;
+  LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+  // Starts watching |root| and everything below it. Returns false if |root|
+  // cannot be watched.
+  bool Watch(const std::string& root);
+  void Unwatch(const std::string& root);
+  void UnwatchAll();
+
+  size_t watch_count() const;
+  size_t failed_watches() const { return failed_watches_.load(); }
+
+ private:
+  bool Start();
+  void Run();
+  void ReadEvents();
+  void Flush();
+
+  // Adds watches for |directory| and its subdirectories. With |report|, the
+  // files found are reported as added (a directory that appeared later).
+  void AddTree(const std::string& directory, bool report);
+  void RemoveTree(const std::string& directory);
+  void RenameTree(const std::string& from, const std::string& to);
+
+  void Record(const std::string& path, LibraryChange::Kind kind,
+              bool is_directory);
+  void RecordRename(const std::string& from, const std::string& to,
+                    bool is_directory);
+
+  Callback callback_;
+  int inotify_fd_ = -1;
+  int wake_fd_ = -1;
+  std::thread thread_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<size_t> failed_watches_{0};
+
+  // Guards everything below; held by the thread while it handles events.
+  mutable std::mutex mutex_;
+  std::vector<std::string> roots_;
+  std::unordered_map<int, std::string> directories_;  // wd -> path
+  std::unordered_map<std::string, int> watches_;      // path -> wd
+
+  // The current batch, in order. Adds and removes of the same path replace
+  // each other in place; a rename starts a new coalescing window so that
+  // later changes are not reordered before it.
+  std::vector<LibraryChange> batch_;
+  std::unordered_map<std::string, size_t> batch_index_;
+  int64_t batch_started_ms_ = 0;
+  int64_t last_event_ms_ = 0;
+};
+
+#endif  // RUNNER_LIBRARY_WATCHER_H_
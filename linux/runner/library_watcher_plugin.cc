@@ -0,0 +1,167 @@
+#include "library_watcher_plugin.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "library_watcher.h"
+
+namespace {
+
+struct LibraryWatcherPlugin {
+  FlMethodChannel* channel;
+  FlEventChannel* events;
+  std::unique_ptr<LibraryWatcher> watcher;
+};
+
+void library_watcher_plugin_free(gpointer data) {
+  auto* plugin = static_cast<LibraryWatcherPlugin*>(data);
+  // Joins the watcher thread; batches already queued on the main loop hold
+  // their own reference to the event channel.
+  plugin->watcher.reset();
+  g_clear_object(&plugin->channel);
+  g_clear_object(&plugin->events);
+  delete plugin;
+}
+
+// A batch handed from the watcher thread to the main loop.
+struct ChangeBatch {
+  FlEventChannel* events;
+  std::vector<LibraryChange> changes;
+};
+
+const char* change_type(LibraryChange::Kind kind) {
+  switch (kind) {
+    case LibraryChange::kAdded:
+      return "added";
+    case LibraryChange::kRemoved:
+      return "removed";
+    case LibraryChange::kRenamed:
+      return "renamed";
+    case LibraryChange::kRescan:
+      return "rescan";
+  }
+  return "rescan";
+}
+
+gboolean send_batch(gpointer data) {
+  auto* batch = static_cast<ChangeBatch*>(data);
+  g_autoptr(FlValue) list = fl_value_new_list();
+  for (const LibraryChange& change : batch->changes) {
+    FlValue* item = fl_value_new_map();
+    fl_value_set_string_take(item, "type",
+                             fl_value_new_string(change_type(change.kind)));
+    fl_value_set_string_take(item, "path",
+                             fl_value_new_string(change.path.c_str()));
+    if (change.kind == LibraryChange::kRenamed) {
+      fl_value_set_string_take(item, "oldPath",
+                               fl_value_new_string(change.old_path.c_str()));
+    }
+    fl_value_set_string_take(item, "isDirectory",
+                             fl_value_new_bool(change.is_directory));
+    fl_value_append_take(list, item);
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(batch->events, list, nullptr, &error)) {
+    g_warning("Failed to send library changes: %s", error->message);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+void free_batch(gpointer data) {
+  auto* batch = static_cast<ChangeBatch*>(data);
+  g_object_unref(batch->events);
+  delete batch;
+}
+
+const gchar* lookup_path(FlValue* args) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, "path");
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                    gpointer user_data) {
+  auto* plugin = static_cast<LibraryWatcherPlugin*>(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  const gchar* path = lookup_path(fl_method_call_get_args(method_call));
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (g_strcmp0(method, "watch") == 0 || g_strcmp0(method, "unwatch") == 0) {
+    if (path == nullptr) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "path is required", nullptr));
+    } else if (g_strcmp0(method, "watch") == 0) {
+      bool watching = plugin->watcher->Watch(path);
+      if (plugin->watcher->failed_watches() > 0) {
+        g_warning("inotify watch limit reached; %zu folders are not watched",
+                  plugin->watcher->failed_watches());
+      }
+      g_autoptr(FlValue) result = fl_value_new_bool(watching);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    } else {
+      plugin->watcher->Unwatch(path);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  } else if (g_strcmp0(method, "unwatchAll") == 0) {
+    plugin->watcher->UnwatchAll();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send library watcher response: %s", error->message);
+  }
+}
+
+FlMethodErrorResponse* listen_cb(FlEventChannel* channel, FlValue* args,
+                                 gpointer user_data) {
+  return nullptr;
+}
+
+FlMethodErrorResponse* cancel_cb(FlEventChannel* channel, FlValue* args,
+                                 gpointer user_data) {
+  return nullptr;
+}
+
+}  // namespace
+
+void library_watcher_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  auto* plugin = new LibraryWatcherPlugin{nullptr, nullptr, nullptr};
+
+  FlBinaryMessenger* messenger = fl_plugin_registrar_get_messenger(registrar);
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  plugin->channel = fl_method_channel_new(
+      messenger, "com.cyrene.music/library_watcher", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(plugin->channel, method_call_cb,
+                                            plugin, nullptr);
+  plugin->events = fl_event_channel_new(
+      messenger, "com.cyrene.music/library_watcher/events",
+      FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->events, listen_cb, cancel_cb,
+                                       plugin, nullptr);
+
+  // Batches arrive on the watcher thread and are sent from the main loop.
+  FlEventChannel* events = plugin->events;
+  plugin->watcher = std::make_unique<LibraryWatcher>(
+      [events](std::vector<LibraryChange> changes) {
+        auto* batch = new ChangeBatch{
+            FL_EVENT_CHANNEL(g_object_ref(events)), std::move(changes)};
+        g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, send_batch, batch,
+                        free_batch);
+      });
+
+  // The view owns the plugin: the watcher is stopped and the channels
+  // released when the view is destroyed.
+  g_object_set_data_full(G_OBJECT(fl_plugin_registrar_get_view(registrar)),
+                         "library-watcher-plugin", plugin,
+                         library_watcher_plugin_free);
+}
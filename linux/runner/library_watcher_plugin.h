@@ -0,0 +1,17 @@
+#ifndef RUNNER_LIBRARY_WATCHER_PLUGIN_H_
+#define RUNNER_LIBRARY_WATCHER_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+// Exposes LibraryWatcher (library_watcher.h) to Dart.
+//
+// "com.cyrene.music/library_watcher" methods:
+//   watch({path}) -> bool   unwatch({path})   unwatchAll()
+// "com.cyrene.music/library_watcher/events" sends one list per debounced
+// batch:
+//   [{type: added|removed|renamed|rescan, path, oldPath?, isDirectory}]
+// The watcher runs for the lifetime of the registrar's view.
+void library_watcher_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_LIBRARY_WATCHER_PLUGIN_H_
@@ -0,0 +1,198 @@
+#include "loopback_proxy_plugin.h"
+
+#include <vector>
+
+#include "loopback_proxy.h"
+
+namespace {
+
+struct LoopbackProxyPlugin {
+  FlMethodChannel* channel;
+  void* proxy;
+};
+
+void loopback_proxy_plugin_free(gpointer data) {
+  auto* plugin = static_cast<LoopbackProxyPlugin*>(data);
+  cyrene_proxy_stop(plugin->proxy);
+  g_clear_object(&plugin->channel);
+  delete plugin;
+}
+
+const gchar* lookup_string(FlValue* args, const char* key) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+FlMethodResponse* start_proxy(LoopbackProxyPlugin* plugin, FlValue* args) {
+  if (plugin->proxy == nullptr) {
+    const gchar* dir = lookup_string(args, "cacheDir");
+    if (dir == nullptr) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "cacheDir is required", nullptr));
+    }
+    plugin->proxy = cyrene_proxy_start(dir);
+    if (plugin->proxy == nullptr) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "START_FAILED", "Failed to start loopback proxy", nullptr));
+    }
+  }
+  g_autoptr(FlValue) port = fl_value_new_int(cyrene_proxy_port(plugin->proxy));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(port));
+}
+
+FlMethodResponse* register_cache(LoopbackProxyPlugin* plugin, FlValue* args) {
+  const gchar* id = lookup_string(args, "id");
+  const gchar* path = lookup_string(args, "path");
+  FlValue* key = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                     ? fl_value_lookup_string(args, "key")
+                     : nullptr;
+  if (plugin->proxy == nullptr || id == nullptr || path == nullptr ||
+      key == nullptr || fl_value_get_type(key) != FL_VALUE_TYPE_UINT8_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENT", "Proxy not running or bad arguments", nullptr));
+  }
+  cyrene_proxy_register_cache(
+      plugin->proxy, id, path, fl_value_get_uint8_list(key),
+      static_cast<int32_t>(fl_value_get_length(key)),
+      lookup_string(args, "segmentKey"));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+int64_t lookup_int(FlValue* map, const char* key, int64_t fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return fallback;
+  }
+  return fl_value_get_int(value);
+}
+
+FlMethodResponse* set_prefetch(LoopbackProxyPlugin* plugin, FlValue* args) {
+  FlValue* list =
+      args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+          ? fl_value_lookup_string(args, "requests")
+          : nullptr;
+  if (plugin->proxy == nullptr || list == nullptr ||
+      fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENT", "Proxy not running or bad arguments", nullptr));
+  }
+  std::vector<const char*> keys;
+  std::vector<const char*> urls;
+  std::vector<const char*> platforms;
+  std::vector<int64_t> bytes;
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* request = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(request) != FL_VALUE_TYPE_MAP) continue;
+    const gchar* key = lookup_string(request, "key");
+    const gchar* url = lookup_string(request, "url");
+    if (key == nullptr || url == nullptr) continue;
+    keys.push_back(key);
+    urls.push_back(url);
+    platforms.push_back(lookup_string(request, "platform"));
+    bytes.push_back(lookup_int(request, "bytes", 0));
+  }
+  cyrene_proxy_set_prefetch(plugin->proxy, keys.data(), urls.data(),
+                            platforms.data(), bytes.data(),
+                            static_cast<int32_t>(keys.size()));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+FlMethodResponse* set_prefetch_limits(LoopbackProxyPlugin* plugin,
+                                      FlValue* args) {
+  if (plugin->proxy == nullptr || args == nullptr ||
+      fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENT", "Proxy not running or bad arguments", nullptr));
+  }
+  cyrene_proxy_set_prefetch_limits(
+      plugin->proxy, static_cast<int32_t>(lookup_int(args, "concurrency", 2)),
+      lookup_int(args, "bytesPerSecond", 0),
+      lookup_int(args, "maxBytes", -1));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+FlMethodResponse* set_cache_limit(LoopbackProxyPlugin* plugin,
+                                  FlValue* args) {
+  if (plugin->proxy == nullptr || args == nullptr ||
+      fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENT", "Proxy not running or bad arguments", nullptr));
+  }
+  cyrene_proxy_set_cache_limit(plugin->proxy, lookup_int(args, "bytes", 0));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+FlMethodResponse* prefetch_conditions() {
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "onAcPower",
+                           fl_value_new_bool(cyrene_power_on_ac() != 0));
+  fl_value_set_string_take(result, "unmetered",
+                           fl_value_new_bool(cyrene_link_unmetered() != 0));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                    gpointer user_data) {
+  auto* plugin = static_cast<LoopbackProxyPlugin*>(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (g_strcmp0(method, "start") == 0) {
+    response = start_proxy(plugin, fl_method_call_get_args(method_call));
+  } else if (g_strcmp0(method, "registerCache") == 0) {
+    response = register_cache(plugin, fl_method_call_get_args(method_call));
+  } else if (g_strcmp0(method, "unregisterCache") == 0) {
+    const gchar* id =
+        lookup_string(fl_method_call_get_args(method_call), "id");
+    if (plugin->proxy != nullptr && id != nullptr) {
+      cyrene_proxy_unregister_cache(plugin->proxy, id);
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else if (g_strcmp0(method, "setPrefetch") == 0) {
+    response = set_prefetch(plugin, fl_method_call_get_args(method_call));
+  } else if (g_strcmp0(method, "setPrefetchLimits") == 0) {
+    response =
+        set_prefetch_limits(plugin, fl_method_call_get_args(method_call));
+  } else if (g_strcmp0(method, "setCacheLimit") == 0) {
+    response = set_cache_limit(plugin, fl_method_call_get_args(method_call));
+  } else if (g_strcmp0(method, "prefetchConditions") == 0) {
+    response = prefetch_conditions();
+  } else if (g_strcmp0(method, "stop") == 0) {
+    cyrene_proxy_stop(plugin->proxy);
+    plugin->proxy = nullptr;
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send loopback proxy response: %s", error->message);
+  }
+}
+
+}  // namespace
+
+void loopback_proxy_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  auto* plugin = new LoopbackProxyPlugin{nullptr, nullptr};
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  plugin->channel = fl_method_channel_new(
+      fl_plugin_registrar_get_messenger(registrar),
+      "com.cyrene.music/loopback_proxy", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(plugin->channel, method_call_cb,
+                                            plugin, nullptr);
+
+  // The view owns the plugin: the proxy is stopped and the channel released
+  // when the view is destroyed.
+  g_object_set_data_full(G_OBJECT(fl_plugin_registrar_get_view(registrar)),
+                         "loopback-proxy-plugin", plugin,
+                         loopback_proxy_plugin_free);
+}
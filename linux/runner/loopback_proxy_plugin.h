@@ -0,0 +1,17 @@
+#ifndef RUNNER_LOOPBACK_PROXY_PLUGIN_H_
+#define RUNNER_LOOPBACK_PROXY_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+// Exposes the native loopback audio proxy (native/loopback_proxy.h) to Dart
+// on the "com.cyrene.music/loopback_proxy" channel:
+//   start({cacheDir}) -> port   stop() -> null
+//   registerCache({id, path, key, segmentKey?})   unregisterCache({id})
+//   setPrefetch({requests: [{key, url, platform, bytes}]})
+//   setPrefetchLimits({concurrency, bytesPerSecond})
+//   prefetchConditions() -> {onAcPower, unmetered}
+// The proxy runs for the lifetime of the registrar's view.
+void loopback_proxy_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_LOOPBACK_PROXY_PLUGIN_H_
@@ -6,6 +6,9 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#include "desktop_lyric_plugin.h"
+#include "library_watcher_plugin.h"
+#include "loopback_proxy_plugin.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
@@ -59,6 +62,21 @@ static void my_application_activate(GApplication* application) {
 
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
 
+  g_autoptr(FlPluginRegistrar) loopback_proxy_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view),
+                                                  "LoopbackProxyPlugin");
+  loopback_proxy_plugin_register_with_registrar(loopback_proxy_registrar);
+
+  g_autoptr(FlPluginRegistrar) desktop_lyric_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view),
+                                                  "DesktopLyricPlugin");
+  desktop_lyric_plugin_register_with_registrar(desktop_lyric_registrar);
+
+  g_autoptr(FlPluginRegistrar) library_watcher_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view),
+                                                  "LibraryWatcherPlugin");
+  library_watcher_plugin_register_with_registrar(library_watcher_registrar);
+
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
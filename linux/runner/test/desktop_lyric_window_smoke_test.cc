@@ -0,0 +1,131 @@
+// Smoke test for the GTK desktop lyric window: creates it on a real (Xvfb)
+// display, pushes text, style and karaoke updates the way the plugin does,
+// and checks that frames were rendered and outlines cached. Exits 77 (skip)
+// when no display is available.
+
+#include <gtk/gtk.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "desktop_lyric_window.h"
+#include "lyric_style.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                             \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, \
+                   #condition);                                       \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+gboolean QuitLoop(gpointer loop) {
+  g_main_loop_quit(static_cast<GMainLoop*>(loop));
+  return G_SOURCE_REMOVE;
+}
+
+// Runs the GTK main loop for |ms| so draws, maps and timers are processed.
+void Pump(guint ms) {
+  GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+  g_timeout_add(ms, QuitLoop, loop);
+  g_main_loop_run(loop);
+  g_main_loop_unref(loop);
+}
+
+cyrene::LyricTimelineLine Line(int64_t start_ms, const std::string& text,
+                               const std::string& translation) {
+  cyrene::LyricTimelineLine line;
+  line.start_ms = start_ms;
+  line.text = text;
+  line.translation = translation;
+  // One timed word per character pair, 100 ms each.
+  for (size_t i = 0; i < text.size(); i += 2) {
+    line.words.push_back({start_ms + static_cast<int64_t>(i) * 50, 100,
+                          text.substr(i, 2)});
+  }
+  return line;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!gtk_init_check(&argc, &argv)) {
+    std::fprintf(stderr, "no display; skipping\n");
+    return 77;
+  }
+
+  DesktopLyricWindow window;
+  EXPECT(window.Create());
+  window.Show();
+  Pump(200);
+  EXPECT(window.IsVisible());
+
+  // Plain lines, as "setLyricText" pushes them. A repeated line is a glyph
+  // cache hit.
+  uint64_t frames = window.frame_stats().frames();
+  window.SetLyricText("\xE6\xB5\x8B\xE8\xAF\x95 first line");
+  Pump(50);
+  window.SetLyricText("second line");
+  Pump(50);
+  window.SetLyricText("\xE6\xB5\x8B\xE8\xAF\x95 first line");
+  Pump(50);
+  EXPECT(window.frame_stats().frames() >= frames + 3);
+  EXPECT(window.glyph_cache().builds() >= 2);
+  EXPECT(window.glyph_cache().hits() >= 1);
+
+  // A whole theme in one "applyStyle" message: one frame.
+  cyrene::LyricStyleUpdate theme;
+  theme.fields = cyrene::kLyricStyleFontSize | cyrene::kLyricStyleTextColor |
+                 cyrene::kLyricStyleStrokeColor |
+                 cyrene::kLyricStyleStrokeWidth |
+                 cyrene::kLyricStyleHighlightColor |
+                 cyrene::kLyricStyleMouseTransparent;
+  theme.values.font_size = 40;
+  theme.values.text_color = 0xFFFFEE00;
+  theme.values.stroke_color = 0xFF202020;
+  theme.values.stroke_width = 3;
+  theme.values.highlight_color = 0xFFFF4081;
+  theme.values.mouse_transparent = true;
+  std::vector<uint8_t> message = cyrene::EncodeLyricStyle(theme);
+  cyrene::LyricStyleUpdate decoded;
+  EXPECT(cyrene::DecodeLyricStyle(message.data(), message.size(), &decoded));
+  frames = window.frame_stats().frames();
+  window.ApplyStyle(decoded);
+  Pump(50);
+  EXPECT(window.frame_stats().frames() == frames + 1);
+
+  // Karaoke: the frame timer advances the highlight on its own between
+  // position reports.
+  window.SetLyricDocument({Line(0, "abcdefgh", "translation"),
+                           Line(400, "ijklmnop", ""),
+                           Line(800, "qrstuvwx", "")});
+  window.SyncPosition(0, true);
+  frames = window.frame_stats().frames();
+  Pump(600);
+  EXPECT(window.frame_stats().frames() >= frames + 5);
+  window.SyncPosition(600, false);
+  Pump(50);
+
+  window.Hide();
+  Pump(50);
+  EXPECT(!window.IsVisible());
+  window.Destroy();
+
+  std::printf("frames %llu, max %lld us, glyph builds %llu, hits %llu\n",
+              static_cast<unsigned long long>(window.frame_stats().frames()),
+              static_cast<long long>(window.frame_stats().max_us()),
+              static_cast<unsigned long long>(window.glyph_cache().builds()),
+              static_cast<unsigned long long>(window.glyph_cache().hits()));
+  if (g_failures != 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+// Stress test for LibraryWatcher: writes, moves and deletes tens of
+// thousands of files and whole directories under a watched folder while
+// applying every batch to an in-memory index the way
+// LocalLibraryService._applyChanges does, then checks that the index
+// converges to what is on disk. Needs inotify only, no display.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "library_watcher.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                             \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, \
+                   #condition);                                       \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+bool IsTrack(const std::string& path) {
+  size_t dot = path.rfind('.');
+  return dot != std::string::npos && path.compare(dot, 4, ".mp3") == 0;
+}
+
+bool StartsWith(const std::string& path, const std::string& prefix) {
+  return path.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Library files under |directory|, as a full scan would find them.
+void Walk(const std::string& directory, std::set<std::string>* found) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) return;
+  while (dirent* entry = readdir(dir)) {
+    if (!std::strcmp(entry->d_name, ".") || !std::strcmp(entry->d_name, ".."))
+      continue;
+    std::string path = directory + "/" + entry->d_name;
+    if (entry->d_type == DT_DIR) {
+      Walk(path, found);
+    } else if (IsTrack(path)) {
+      found->insert(path);
+    }
+  }
+  closedir(dir);
+}
+
+void RemoveAll(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) return;
+  while (dirent* entry = readdir(dir)) {
+    if (!std::strcmp(entry->d_name, ".") || !std::strcmp(entry->d_name, ".."))
+      continue;
+    std::string path = directory + "/" + entry->d_name;
+    if (entry->d_type == DT_DIR) {
+      RemoveAll(path);
+    } else {
+      unlink(path.c_str());
+    }
+  }
+  closedir(dir);
+  rmdir(directory.c_str());
+}
+
+void WriteFile(const std::string& path) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return;
+  ssize_t ignored = write(fd, "ID3", 3);
+  (void)ignored;
+  close(fd);
+}
+
+// The track list kept by LocalLibraryService, reduced to its ids (paths).
+class Index {
+ public:
+  void Apply(std::vector<LibraryChange> changes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const LibraryChange& change : changes) {
+      switch (change.kind) {
+        case LibraryChange::kAdded:
+          if (IsTrack(change.path)) tracks_.insert(change.path);
+          break;
+        case LibraryChange::kRemoved:
+          if (change.is_directory) {
+            ErasePrefix(change.path + "/");
+          } else {
+            tracks_.erase(change.path);
+          }
+          break;
+        case LibraryChange::kRenamed:
+          if (change.is_directory) {
+            std::string prefix = change.old_path + "/";
+            std::vector<std::string> moved;
+            for (auto it = tracks_.lower_bound(prefix);
+                 it != tracks_.end() && StartsWith(*it, prefix);) {
+              moved.push_back(change.path + it->substr(change.old_path.size()));
+              it = tracks_.erase(it);
+            }
+            tracks_.insert(moved.begin(), moved.end());
+          } else if (tracks_.erase(change.old_path)) {
+            tracks_.insert(change.path);
+          }
+          break;
+        case LibraryChange::kRescan: {
+          ++rescans_;
+          ErasePrefix(change.path + "/");
+          Walk(change.path, &tracks_);
+          break;
+        }
+      }
+    }
+    ++batches_;
+    changed_.notify_all();
+  }
+
+  // Waits until the index matches the disk under |root|, or |timeout_ms|.
+  bool Converge(const std::string& root, int timeout_ms) {
+    std::set<std::string> disk;
+    Walk(root, &disk);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (tracks_ != disk) {
+      if (changed_.wait_until(lock, deadline) == std::cv_status::timeout) {
+        return tracks_ == disk;
+      }
+    }
+    return true;
+  }
+
+  void Report(const std::string& root) {
+    std::set<std::string> disk;
+    Walk(root, &disk);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t missing = 0;
+    size_t stale = 0;
+    for (const std::string& path : disk) missing += !tracks_.count(path);
+    for (const std::string& path : tracks_) stale += !disk.count(path);
+    std::fprintf(stderr,
+                 "%zu on disk, %zu indexed, %zu missing, %zu stale, "
+                 "%zu batches, %zu rescans\n",
+                 disk.size(), tracks_.size(), missing, stale, batches_,
+                 rescans_);
+  }
+
+  void Seed(const std::string& root) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Walk(root, &tracks_);
+  }
+
+ private:
+  void ErasePrefix(const std::string& prefix) {
+    auto it = tracks_.lower_bound(prefix);
+    while (it != tracks_.end() && StartsWith(*it, prefix)) {
+      it = tracks_.erase(it);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::set<std::string> tracks_;
+  size_t batches_ = 0;
+  size_t rescans_ = 0;
+};
+
+std::string Name(const char* format, int a, int b) {
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), format, a, b);
+  return buffer;
+}
+
+}  // namespace
+
+int main() {
+  char base_template[] = "/tmp/cyrene_watch_XXXXXX";
+  if (mkdtemp(base_template) == nullptr) return 1;
+  const std::string base = base_template;
+  const std::string root = base + "/library";
+  const std::string outside = base + "/outside";
+  mkdir(root.c_str(), 0755);
+  mkdir(outside.c_str(), 0755);
+
+  constexpr int kAlbums = 40;
+  constexpr int kTracks = 500;  // 20000 tracks
+
+  // A library that already exists when watching starts, plus an album
+  // outside that is moved in later.
+  for (int album = 0; album < kAlbums / 2; ++album) {
+    std::string directory = root + Name("/album%03d", album, 0);
+    mkdir(directory.c_str(), 0755);
+    for (int track = 0; track < kTracks; ++track) {
+      WriteFile(directory + Name("/%03d-%04d.mp3", album, track));
+    }
+  }
+  mkdir((outside + "/imported").c_str(), 0755);
+  for (int track = 0; track < kTracks; ++track) {
+    WriteFile(outside + Name("/imported/%04d.mp3", track, 0));
+  }
+
+  Index index;
+  index.Seed(root);
+  LibraryWatcher watcher(
+      [&](std::vector<LibraryChange> changes) { index.Apply(changes); });
+  EXPECT(watcher.Watch(root));
+  EXPECT(watcher.watch_count() == kAlbums / 2 + 1);
+
+  // Writes: the other half of the albums, each file written and closed,
+  // with cover art that must be ignored.
+  for (int album = kAlbums / 2; album < kAlbums; ++album) {
+    std::string directory = root + Name("/album%03d", album, 0);
+    mkdir(directory.c_str(), 0755);
+    for (int track = 0; track < kTracks; ++track) {
+      WriteFile(directory + Name("/%03d-%04d.mp3", album, track));
+    }
+    WriteFile(directory + "/cover.jpg");
+  }
+
+  // File moves: every other track of the first albums into a sorted
+  // folder, renamed on the way.
+  mkdir((root + "/sorted").c_str(), 0755);
+  for (int album = 0; album < 10; ++album) {
+    for (int track = 0; track < kTracks; track += 2) {
+      std::string from = root + Name("/album%03d", album, 0) +
+                         Name("/%03d-%04d.mp3", album, track);
+      std::string to = root + Name("/sorted/%03d_%04d.mp3", album, track);
+      rename(from.c_str(), to.c_str());
+    }
+  }
+
+  // Directory moves: nest albums under an artist folder, rename some
+  // tracks to a non-library extension and back, move an album out of the
+  // library and another one in.
+  mkdir((root + "/artist").c_str(), 0755);
+  for (int album = 20; album < 30; ++album) {
+    std::string name = Name("/album%03d", album, 0);
+    rename((root + name).c_str(), (root + "/artist" + name).c_str());
+  }
+  for (int track = 0; track < kTracks; ++track) {
+    std::string path = root + Name("/artist/album025/025-%04d.mp3", track, 0);
+    rename(path.c_str(), (path + ".part").c_str());
+    if (track % 2) rename((path + ".part").c_str(), path.c_str());
+  }
+  rename((root + "/album030").c_str(), (outside + "/album030").c_str());
+  rename((outside + "/imported").c_str(), (root + "/imported").c_str());
+  rename((root + "/artist").c_str(), (root + "/various").c_str());
+
+  // Deletes: single files, then a whole album.
+  for (int track = 0; track < kTracks; track += 3) {
+    unlink((root + Name("/album031/031-%04d.mp3", track, 0)).c_str());
+  }
+  RemoveAll(root + "/album032");
+
+  // Rewrites of existing files report them as added again.
+  for (int track = 1; track < kTracks; track += 2) {
+    WriteFile(root + Name("/album001/001-%04d.mp3", track, 0));
+  }
+
+  bool converged = index.Converge(root, 30000);
+  index.Report(root);
+  EXPECT(converged);
+  EXPECT(watcher.failed_watches() == 0);
+
+  // Later changes still arrive once the burst is over.
+  WriteFile(root + "/various/album020/late.mp3");
+  rename((root + "/sorted").c_str(), (root + "/various/sorted").c_str());
+  converged = index.Converge(root, 10000);
+  index.Report(root);
+  EXPECT(converged);
+
+  watcher.UnwatchAll();
+  EXPECT(watcher.watch_count() == 0);
+  RemoveAll(base);
+
+  if (g_failures) {
+    std::fprintf(stderr, "%d failure(s)\n", g_failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,451 @@
+#include "aes_ctr.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CYRENE_AES_X86 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+constexpr size_t kBlock = 16;
+
+// Encrypts |blocks| whole counter blocks starting at counter (hi, lo) and
+// writes them XORed with |in| to |out|, which may be the same buffer.
+// |round_keys| holds rounds + 1 keys, FIPS-197 byte order.
+using CtrKernel = void (*)(const uint8_t* round_keys, int rounds,
+                           const uint8_t* in, uint8_t* out, size_t blocks,
+                           uint64_t hi, uint64_t lo);
+
+constexpr uint8_t kSbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16,
+};
+
+// FIPS-197 key expansion into (rounds + 1) * 16 bytes.
+void ExpandKey(const uint8_t* key, size_t key_length, int rounds,
+               uint8_t* out) {
+  const size_t nk = key_length / 4;
+  const size_t words = 4 * static_cast<size_t>(rounds + 1);
+  std::memcpy(out, key, key_length);
+  uint8_t rcon = 1;
+  for (size_t i = nk; i < words; ++i) {
+    uint8_t t[4];
+    std::memcpy(t, out + 4 * (i - 1), 4);
+    if (i % nk == 0) {
+      uint8_t first = t[0];
+      t[0] = static_cast<uint8_t>(kSbox[t[1]] ^ rcon);
+      t[1] = kSbox[t[2]];
+      t[2] = kSbox[t[3]];
+      t[3] = kSbox[first];
+      rcon = static_cast<uint8_t>((rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0));
+    } else if (nk > 6 && i % nk == 4) {
+      for (uint8_t& byte : t) byte = kSbox[byte];
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      out[4 * i + j] = out[4 * (i - nk) + j] ^ t[j];
+    }
+  }
+}
+
+inline void AddCounter(uint64_t* hi, uint64_t* lo, uint64_t n) {
+  uint64_t sum = *lo + n;
+  if (sum < *lo) ++*hi;
+  *lo = sum;
+}
+
+// Writes |count| consecutive big-endian counter blocks to |out|.
+inline void FillCounters(uint8_t* out, size_t count, uint64_t hi,
+                         uint64_t lo) {
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t be_hi = __builtin_bswap64(hi);
+    uint64_t be_lo = __builtin_bswap64(lo);
+    std::memcpy(out + i * kBlock, &be_hi, 8);
+    std::memcpy(out + i * kBlock + 8, &be_lo, 8);
+    AddCounter(&hi, &lo, 1);
+  }
+}
+
+#if defined(CYRENE_AES_X86)
+
+// The kernels keep the counter as a little-endian (lo, hi) pair in each
+// 128-bit lane, step it with a 64-bit vector add and byte-reverse each lane
+// into the big-endian counter block. A batch that would carry out of |lo|
+// (once per 2^64 blocks of a random nonce) is filled by FillCounters()
+// instead.
+
+__attribute__((target("aes,ssse3"))) void CtrAesNi(
+    const uint8_t* round_keys, int rounds, const uint8_t* in, uint8_t* out,
+    size_t blocks, uint64_t hi, uint64_t lo) {
+  constexpr size_t kLanes = 8;
+  const __m128i reverse =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i one = _mm_set_epi64x(0, 1);
+  __m128i rk[15];
+  for (int r = 0; r <= rounds; ++r) {
+    rk[r] = _mm_load_si128(
+        reinterpret_cast<const __m128i*>(round_keys + r * kBlock));
+  }
+  while (blocks > 0) {
+    size_t lanes = std::min(blocks, kLanes);
+    __m128i x[kLanes];
+    if (lo <= UINT64_MAX - kLanes) {
+      __m128i counter = _mm_set_epi64x(static_cast<int64_t>(hi),
+                                       static_cast<int64_t>(lo));
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm_xor_si128(_mm_shuffle_epi8(counter, reverse), rk[0]);
+        counter = _mm_add_epi64(counter, one);
+      }
+    } else {
+      alignas(16) uint8_t counters[kLanes * kBlock];
+      FillCounters(counters, kLanes, hi, lo);
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm_xor_si128(
+            _mm_load_si128(reinterpret_cast<const __m128i*>(counters) + j),
+            rk[0]);
+      }
+    }
+    for (int r = 1; r < rounds; ++r) {
+      for (size_t j = 0; j < kLanes; ++j) x[j] = _mm_aesenc_si128(x[j], rk[r]);
+    }
+    for (size_t j = 0; j < lanes; ++j) {
+      __m128i data =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + j);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(out) + j,
+          _mm_xor_si128(data, _mm_aesenclast_si128(x[j], rk[rounds])));
+    }
+    in += lanes * kBlock;
+    out += lanes * kBlock;
+    blocks -= lanes;
+    AddCounter(&hi, &lo, lanes);
+  }
+}
+
+__attribute__((target("vaes,avx2"))) void CtrVaes256(
+    const uint8_t* round_keys, int rounds, const uint8_t* in, uint8_t* out,
+    size_t blocks, uint64_t hi, uint64_t lo) {
+  constexpr size_t kLanes = 8;  // Registers of two blocks each.
+  constexpr size_t kStep = 2 * kLanes;
+  const __m256i reverse = _mm256_broadcastsi128_si256(
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  const __m256i two = _mm256_set_epi64x(0, 2, 0, 2);
+  __m256i rk[15];
+  for (int r = 0; r <= rounds; ++r) {
+    rk[r] = _mm256_broadcastsi128_si256(_mm_load_si128(
+        reinterpret_cast<const __m128i*>(round_keys + r * kBlock)));
+  }
+  while (blocks >= kStep) {
+    __m256i x[kLanes];
+    if (lo <= UINT64_MAX - kStep) {
+      __m256i counter = _mm256_set_epi64x(
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo + 1),
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo));
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] =
+            _mm256_xor_si256(_mm256_shuffle_epi8(counter, reverse), rk[0]);
+        counter = _mm256_add_epi64(counter, two);
+      }
+    } else {
+      alignas(32) uint8_t counters[kStep * kBlock];
+      FillCounters(counters, kStep, hi, lo);
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm256_xor_si256(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(counters) + j),
+            rk[0]);
+      }
+    }
+    for (int r = 1; r < rounds; ++r) {
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm256_aesenc_epi128(x[j], rk[r]);
+      }
+    }
+    for (size_t j = 0; j < kLanes; ++j) {
+      __m256i data =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in) + j);
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(out) + j,
+          _mm256_xor_si256(data, _mm256_aesenclast_epi128(x[j], rk[rounds])));
+    }
+    in += kStep * kBlock;
+    out += kStep * kBlock;
+    blocks -= kStep;
+    AddCounter(&hi, &lo, kStep);
+  }
+  if (blocks > 0) CtrAesNi(round_keys, rounds, in, out, blocks, hi, lo);
+}
+
+__attribute__((target("vaes,avx512f,avx512bw"))) void CtrVaes512(
+    const uint8_t* round_keys, int rounds, const uint8_t* in, uint8_t* out,
+    size_t blocks, uint64_t hi, uint64_t lo) {
+  constexpr size_t kLanes = 8;  // Registers of four blocks each.
+  constexpr size_t kStep = 4 * kLanes;
+  // Broadcasts go through memory: GCC 12's lane broadcast and shuffle
+  // intrinsics trip -Wmaybe-uninitialized on their undefined passthrough.
+  alignas(64) uint8_t lanes[4 * kBlock];
+  for (size_t lane = 0; lane < 4; ++lane) {
+    for (size_t i = 0; i < kBlock; ++i) {
+      lanes[lane * kBlock + i] = static_cast<uint8_t>(kBlock - 1 - i);
+    }
+  }
+  const __m512i reverse = _mm512_load_si512(lanes);
+  const __m512i four = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+  __m512i rk[15];
+  for (int r = 0; r <= rounds; ++r) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      std::memcpy(lanes + lane * kBlock, round_keys + r * kBlock, kBlock);
+    }
+    rk[r] = _mm512_load_si512(lanes);
+  }
+  while (blocks >= kStep) {
+    __m512i x[kLanes];
+    if (lo <= UINT64_MAX - kStep) {
+      __m512i counter = _mm512_set_epi64(
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo + 3),
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo + 2),
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo + 1),
+          static_cast<int64_t>(hi), static_cast<int64_t>(lo));
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] =
+            _mm512_xor_si512(_mm512_shuffle_epi8(counter, reverse), rk[0]);
+        counter = _mm512_add_epi64(counter, four);
+      }
+    } else {
+      alignas(64) uint8_t counters[kStep * kBlock];
+      FillCounters(counters, kStep, hi, lo);
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm512_xor_si512(_mm512_load_si512(counters + j * 64), rk[0]);
+      }
+    }
+    for (int r = 1; r < rounds; ++r) {
+      for (size_t j = 0; j < kLanes; ++j) {
+        x[j] = _mm512_aesenc_epi128(x[j], rk[r]);
+      }
+    }
+    for (size_t j = 0; j < kLanes; ++j) {
+      __m512i data = _mm512_loadu_si512(in + j * 64);
+      _mm512_storeu_si512(
+          out + j * 64,
+          _mm512_xor_si512(data, _mm512_aesenclast_epi128(x[j], rk[rounds])));
+    }
+    in += kStep * kBlock;
+    out += kStep * kBlock;
+    blocks -= kStep;
+    AddCounter(&hi, &lo, kStep);
+  }
+  if (blocks > 0) CtrAesNi(round_keys, rounds, in, out, blocks, hi, lo);
+}
+
+#endif  // CYRENE_AES_X86
+
+struct KernelChoice {
+  CtrKernel kernel;  // Null: use OpenSSL for everything.
+  const char* name;
+};
+
+// Every kernel the CPU supports, best first; "openssl" is always last.
+std::vector<KernelChoice> SupportedChoices() {
+  std::vector<KernelChoice> choices;
+#if defined(CYRENE_AES_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3")) {
+    if (__builtin_cpu_supports("vaes") &&
+        __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+      choices.push_back({CtrVaes512, "vaes512"});
+    }
+    if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2")) {
+      choices.push_back({CtrVaes256, "vaes256"});
+    }
+    choices.push_back({CtrAesNi, "aesni"});
+  }
+#endif
+  choices.push_back({nullptr, "openssl"});
+  return choices;
+}
+
+const KernelChoice& Kernel() {
+  static const KernelChoice choice = SupportedChoices().front();
+  return choice;
+}
+
+void ApplyOpenSsl(const uint8_t* key, size_t key_length, const uint8_t* iv,
+                  size_t skip, const uint8_t* in, uint8_t* out,
+                  size_t length) {
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if (ctx == nullptr) return;
+  const EVP_CIPHER* cipher =
+      key_length == 16 ? EVP_aes_128_ctr() : EVP_aes_256_ctr();
+  int written = 0;
+  if (EVP_EncryptInit_ex(ctx, cipher, nullptr, key, iv) == 1) {
+    uint8_t discard[kBlock] = {0};
+    if (skip > 0) {
+      EVP_EncryptUpdate(ctx, discard, &written, discard,
+                        static_cast<int>(skip));
+    }
+    while (length > 0) {
+      int chunk = static_cast<int>(std::min<size_t>(length, INT_MAX / 2));
+      EVP_EncryptUpdate(ctx, out, &written, in, chunk);
+      in += chunk;
+      out += chunk;
+      length -= static_cast<size_t>(chunk);
+    }
+  }
+  EVP_CIPHER_CTX_free(ctx);
+}
+
+// Apply() through |kernel|, or OpenSSL when it is null.
+void ApplyCtr(CtrKernel kernel, const uint8_t* key, size_t key_length,
+              const uint8_t* round_keys, int rounds, const uint8_t* nonce,
+              const uint8_t* in, uint8_t* out, size_t length,
+              uint64_t offset) {
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+  std::memcpy(&hi, nonce, 8);
+  std::memcpy(&lo, nonce + 8, 8);
+  hi = __builtin_bswap64(hi);
+  lo = __builtin_bswap64(lo);
+  AddCounter(&hi, &lo, offset / kBlock);
+  size_t skip = static_cast<size_t>(offset % kBlock);
+
+  if (kernel == nullptr) {
+    uint8_t iv[kBlock];
+    FillCounters(iv, 1, hi, lo);
+    ApplyOpenSsl(key, key_length, iv, skip, in, out, length);
+    return;
+  }
+
+  // A range that starts or ends inside a block goes through one block of
+  // keystream; everything between is whole blocks.
+  if (skip > 0) {
+    uint8_t keystream[kBlock] = {0};
+    kernel(round_keys, rounds, keystream, keystream, 1, hi, lo);
+    size_t take = std::min(length, kBlock - skip);
+    for (size_t i = 0; i < take; ++i) out[i] = in[i] ^ keystream[skip + i];
+    in += take;
+    out += take;
+    length -= take;
+    AddCounter(&hi, &lo, 1);
+  }
+  size_t blocks = length / kBlock;
+  if (blocks > 0) {
+    kernel(round_keys, rounds, in, out, blocks, hi, lo);
+    in += blocks * kBlock;
+    out += blocks * kBlock;
+    length -= blocks * kBlock;
+    AddCounter(&hi, &lo, blocks);
+  }
+  if (length > 0) {
+    uint8_t keystream[kBlock] = {0};
+    kernel(round_keys, rounds, keystream, keystream, 1, hi, lo);
+    for (size_t i = 0; i < length; ++i) out[i] = in[i] ^ keystream[i];
+  }
+}
+
+}  // namespace
+
+AesCtr::AesCtr(const uint8_t* key, size_t key_length)
+    : key_length_(key_length), rounds_(0) {
+  if (key == nullptr || (key_length != 16 && key_length != 32)) return;
+  rounds_ = key_length == 16 ? 10 : 14;
+  std::memcpy(key_, key, key_length);
+  ExpandKey(key_, key_length, rounds_, round_keys_);
+}
+
+AesCtr::~AesCtr() {
+  OPENSSL_cleanse(key_, sizeof(key_));
+  OPENSSL_cleanse(round_keys_, sizeof(round_keys_));
+}
+
+void AesCtr::Apply(const uint8_t* nonce, uint8_t* buffer, size_t length,
+                   uint64_t offset) const {
+  Apply(nonce, buffer, buffer, length, offset);
+}
+
+void AesCtr::Apply(const uint8_t* nonce, const uint8_t* in, uint8_t* out,
+                   size_t length, uint64_t offset) const {
+  if (rounds_ == 0 || length == 0) return;
+  ApplyCtr(Kernel().kernel, key_, key_length_, round_keys_, rounds_, nonce, in,
+           out, length, offset);
+}
+
+const char* AesCtr::KernelName() {
+  return Kernel().name;
+}
+
+std::vector<const char*> AesCtr::SupportedKernels() {
+  std::vector<const char*> names;
+  for (const KernelChoice& choice : SupportedChoices()) {
+    names.push_back(choice.name);
+  }
+  return names;
+}
+
+bool AesCtr::ApplyWithKernel(const char* kernel, const uint8_t* nonce,
+                             const uint8_t* in, uint8_t* out, size_t length,
+                             uint64_t offset) const {
+  for (const KernelChoice& choice : SupportedChoices()) {
+    if (std::strcmp(choice.name, kernel) != 0) continue;
+    if (rounds_ != 0 && length != 0) {
+      ApplyCtr(choice.kernel, key_, key_length_, round_keys_, rounds_, nonce,
+               in, out, length, offset);
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_aes_create(const uint8_t* key, int32_t key_length) {
+  if (key == nullptr || (key_length != 16 && key_length != 32)) return nullptr;
+  return new cyrene::AesCtr(key, static_cast<size_t>(key_length));
+}
+
+void cyrene_aes_destroy(void* handle) {
+  delete static_cast<cyrene::AesCtr*>(handle);
+}
+
+void cyrene_aes_apply(void* handle, const uint8_t* nonce, uint8_t* buffer,
+                      int64_t length, int64_t offset) {
+  if (handle == nullptr || nonce == nullptr || buffer == nullptr ||
+      length <= 0 || offset < 0) {
+    return;
+  }
+  static_cast<cyrene::AesCtr*>(handle)->Apply(
+      nonce, buffer, static_cast<size_t>(length),
+      static_cast<uint64_t>(offset));
+}
+
+}  // extern "C"
@@ -0,0 +1,82 @@
+#ifndef CYRENE_NATIVE_AES_CTR_H_
+#define CYRENE_NATIVE_AES_CTR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// AES-128/256 in CTR mode, for .cyrene v3 payloads and cache index records.
+//
+// The counter block for byte |offset| of a stream is the big-endian 128-bit
+// sum nonce + offset / 16, so any range can be processed on its own and a
+// seek costs nothing, as with XorCipher. Apply() encrypts counters with VAES
+// on 512-bit or 256-bit registers when the CPU has it and AES-NI otherwise
+// (32, 16 or 8 blocks in flight to hide the round latency), and uses
+// OpenSSL's EVP implementation on CPUs without AES instructions and on other
+// architectures; the choice is made once per process.
+class AesCtr {
+ public:
+  static constexpr size_t kNonceSize = 16;
+
+  // |key_length| must be 16 (AES-128) or 32 (AES-256); other lengths give
+  // an instance whose valid() is false and whose Apply() does nothing.
+  AesCtr(const uint8_t* key, size_t key_length);
+  ~AesCtr();
+
+  AesCtr(const AesCtr&) = delete;
+  AesCtr& operator=(const AesCtr&) = delete;
+
+  bool valid() const { return rounds_ != 0; }
+  size_t key_length() const { return key_length_; }
+
+  // XORs |length| bytes of |buffer| in place with the keystream of |nonce|
+  // starting at stream position |offset|.
+  void Apply(const uint8_t* nonce, uint8_t* buffer, size_t length,
+             uint64_t offset) const;
+
+  // Same, reading from |in| and writing to |out| (which may alias), so a
+  // decrypting copy is a single pass over the data.
+  void Apply(const uint8_t* nonce, const uint8_t* in, uint8_t* out,
+             size_t length, uint64_t offset) const;
+
+  // Name of the kernel selected for this CPU ("vaes512", "vaes256",
+  // "aesni" or "openssl").
+  static const char* KernelName();
+
+  // Kernels this CPU can run, best first; the last is always "openssl".
+  // For benchmarks and tests, together with ApplyWithKernel().
+  static std::vector<const char*> SupportedKernels();
+
+  // Apply() through the named kernel instead of the selected one. Returns
+  // false, leaving |out| untouched, if the kernel is not supported.
+  bool ApplyWithKernel(const char* kernel, const uint8_t* nonce,
+                       const uint8_t* in, uint8_t* out, size_t length,
+                       uint64_t offset) const;
+
+ private:
+  size_t key_length_;
+  int rounds_;  // 10 or 14, 0 when the key length is unsupported.
+  uint8_t key_[32];
+  alignas(16) uint8_t round_keys_[15 * 16];
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/aes_ctr_native.dart. Handles returned by
+// cyrene_aes_create() (null for a bad key length) must be released with
+// cyrene_aes_destroy(). |nonce| is AesCtr::kNonceSize bytes.
+CYRENE_EXPORT void* cyrene_aes_create(const uint8_t* key, int32_t key_length);
+CYRENE_EXPORT void cyrene_aes_destroy(void* handle);
+CYRENE_EXPORT void cyrene_aes_apply(void* handle, const uint8_t* nonce,
+                                    uint8_t* buffer, int64_t length,
+                                    int64_t offset);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_AES_CTR_H_
@@ -0,0 +1,500 @@
+#include "audio_decoder.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// RIFF WAVE
+
+uint16_t Le16(const uint8_t* p) { return p[0] | p[1] << 8; }
+uint32_t Le32(const uint8_t* p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+constexpr uint16_t kWavePcm = 1;
+constexpr uint16_t kWaveFloat = 3;
+constexpr uint16_t kWaveExtensible = 0xFFFE;
+// Source frames decoded per refill of the resampling window.
+constexpr size_t kWavBlockFrames = 4096;
+
+// Uncompressed WAVE (8/16/24/32-bit PCM, 32/64-bit float) at any rate,
+// mixed down to the first two channels and linearly resampled.
+class WavDecoder : public AudioDecoder {
+ public:
+  static std::unique_ptr<AudioDecoder> Open(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    std::unique_ptr<WavDecoder> decoder(new WavDecoder(fd));
+    if (!decoder->ParseHeader()) return nullptr;
+    return decoder;
+  }
+
+  ~WavDecoder() override { close(fd_); }
+
+  size_t Read(float* out, size_t frames) override {
+    size_t done = 0;
+    while (done < frames && !finished_ && !failed_) {
+      // Output frame |done| samples the source at position_ (in source
+      // frames), between frames |index| and |index + 1|.
+      int64_t index = static_cast<int64_t>(position_);
+      int64_t needed = rate_ == kEngineRate ? index : index + 1;
+      if (needed >= source_frames_) {
+        finished_ = true;
+        break;
+      }
+      if (index < block_start_ || needed >= block_start_ + block_frames_) {
+        if (!LoadBlock(index)) break;
+      }
+      const float* a = &block_[(index - block_start_) * 2];
+      if (rate_ == kEngineRate) {
+        out[done * 2] = a[0];
+        out[done * 2 + 1] = a[1];
+        position_ += 1;
+      } else {
+        const float* b = a + 2;
+        float t = static_cast<float>(position_ - index);
+        out[done * 2] = a[0] + (b[0] - a[0]) * t;
+        out[done * 2 + 1] = a[1] + (b[1] - a[1]) * t;
+        position_ += step_;
+      }
+      ++done;
+    }
+    return done;
+  }
+
+  bool Seek(int64_t frame) override {
+    position_ = std::max<int64_t>(frame, 0) * step_;
+    finished_ = false;
+    return true;
+  }
+
+  int64_t length() const override {
+    return static_cast<int64_t>(source_frames_ / step_);
+  }
+
+  bool finished() const override { return finished_; }
+  bool failed() const override { return failed_; }
+
+ private:
+  explicit WavDecoder(int fd) : fd_(fd) {}
+
+  bool ParseHeader() {
+    uint8_t header[12];
+    if (!PReadFully(fd_, header, sizeof(header), 0) ||
+        std::memcmp(header, "RIFF", 4) != 0 ||
+        std::memcmp(header + 8, "WAVE", 4) != 0) {
+      return false;
+    }
+    bool have_format = false;
+    uint64_t offset = 12;
+    for (;;) {
+      uint8_t chunk[8];
+      if (!PReadFully(fd_, chunk, sizeof(chunk), offset)) return false;
+      uint32_t size = Le32(chunk + 4);
+      offset += 8;
+      if (std::memcmp(chunk, "fmt ", 4) == 0) {
+        uint8_t format[40] = {};
+        if (size < 16 ||
+            !PReadFully(fd_, format, std::min<uint32_t>(size, 40), offset)) {
+          return false;
+        }
+        uint16_t tag = Le16(format);
+        channels_ = Le16(format + 2);
+        rate_ = static_cast<int>(Le32(format + 4));
+        bits_ = Le16(format + 14);
+        if (tag == kWaveExtensible && size >= 40) tag = Le16(format + 24);
+        is_float_ = tag == kWaveFloat;
+        if ((tag != kWavePcm && tag != kWaveFloat) || channels_ == 0 ||
+            rate_ <= 0 || (is_float_ && bits_ != 32 && bits_ != 64) ||
+            (!is_float_ && bits_ != 8 && bits_ != 16 && bits_ != 24 &&
+             bits_ != 32)) {
+          return false;
+        }
+        have_format = true;
+      } else if (std::memcmp(chunk, "data", 4) == 0) {
+        if (!have_format) return false;
+        data_offset_ = offset;
+        frame_bytes_ = channels_ * (bits_ / 8);
+        // Streams written on the fly leave the size at 0 or 0xFFFFFFFF.
+        off_t file_size = lseek(fd_, 0, SEEK_END);
+        uint64_t available =
+            file_size > 0 && static_cast<uint64_t>(file_size) > offset
+                ? static_cast<uint64_t>(file_size) - offset
+                : 0;
+        uint64_t data_size = size == 0 || size == 0xFFFFFFFF
+                                 ? available
+                                 : std::min<uint64_t>(size, available);
+        source_frames_ = static_cast<int64_t>(data_size / frame_bytes_);
+        step_ = static_cast<double>(rate_) / kEngineRate;
+        return source_frames_ > 0;
+      }
+      offset += size + (size & 1);
+    }
+  }
+
+  // Decodes source frames from |first| into the window.
+  bool LoadBlock(int64_t first) {
+    size_t count = static_cast<size_t>(
+        std::min<int64_t>(kWavBlockFrames, source_frames_ - first));
+    raw_.resize(count * frame_bytes_);
+    if (!PReadFully(fd_, raw_.data(), raw_.size(),
+                    data_offset_ + static_cast<uint64_t>(first) *
+                                       frame_bytes_)) {
+      failed_ = true;
+      return false;
+    }
+    block_.resize(count * 2);
+    int bytes = bits_ / 8;
+    for (size_t i = 0; i < count; ++i) {
+      const uint8_t* frame = &raw_[i * frame_bytes_];
+      float left = Sample(frame);
+      float right = channels_ > 1 ? Sample(frame + bytes) : left;
+      block_[i * 2] = left;
+      block_[i * 2 + 1] = right;
+    }
+    block_start_ = first;
+    block_frames_ = static_cast<int64_t>(count);
+    return true;
+  }
+
+  float Sample(const uint8_t* p) const {
+    if (is_float_) {
+      if (bits_ == 32) {
+        float value;
+        uint32_t bits = Le32(p);
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+      }
+      double value;
+      uint64_t bits = Le32(p) | static_cast<uint64_t>(Le32(p + 4)) << 32;
+      std::memcpy(&value, &bits, sizeof(value));
+      return static_cast<float>(value);
+    }
+    switch (bits_) {
+      case 8:
+        return (p[0] - 128) / 128.0f;
+      case 16:
+        return static_cast<int16_t>(Le16(p)) / 32768.0f;
+      case 24:
+        return static_cast<int32_t>(p[0] << 8 | p[1] << 16 |
+                                    static_cast<uint32_t>(p[2]) << 24) /
+               2147483648.0f;
+      default:
+        return static_cast<int32_t>(Le32(p)) / 2147483648.0f;
+    }
+  }
+
+  int fd_;
+  int channels_ = 0;
+  int rate_ = 0;
+  int bits_ = 0;
+  bool is_float_ = false;
+  int frame_bytes_ = 0;
+  uint64_t data_offset_ = 0;
+  int64_t source_frames_ = 0;
+  double step_ = 1;
+  double position_ = 0;
+  std::vector<uint8_t> raw_;
+  std::vector<float> block_;
+  int64_t block_start_ = 0;
+  int64_t block_frames_ = 0;
+  bool finished_ = false;
+  bool failed_ = false;
+};
+
+// ---------------------------------------------------------------------------
+// GStreamer
+//
+// Loaded with dlopen so the library neither links against nor requires
+// GStreamer at startup. Only opaque pointers and these ABI-stable constants
+// and structs are used.
+
+constexpr int kGstStateNull = 1;
+constexpr int kGstStatePaused = 3;
+constexpr int kGstStatePlaying = 4;
+constexpr int kGstStateChangeFailure = 0;
+constexpr int kGstStateChangeSuccess = 1;
+constexpr int kGstFormatTime = 3;
+constexpr int kGstSeekFlagFlush = 1 << 0;
+constexpr int kGstSeekFlagAccurate = 1 << 1;
+constexpr int kGstMessageError = 1 << 1;
+constexpr int kGstMapRead = 1 << 0;
+constexpr uint64_t kGstSecond = 1000000000ull;
+// Opening a stream waits this long for the first buffer (preroll).
+constexpr uint64_t kPrerollTimeout = 8 * kGstSecond;
+// A single pull waits this long before giving control back to the engine.
+constexpr uint64_t kPullTimeout = 20 * 1000000ull;
+
+struct GstMapInfo {
+  void* memory;
+  int flags;
+  uint8_t* data;
+  size_t size;
+  size_t maxsize;
+  void* user_data[4];
+  void* reserved[4];
+};
+
+struct GstApi {
+  int (*init_check)(int*, char***, void**);
+  void* (*parse_launch)(const char*, void**);
+  void* (*bin_get_by_name)(void*, const char*);
+  int (*element_set_state)(void*, int);
+  int (*element_get_state)(void*, int*, int*, uint64_t);
+  int (*element_query_duration)(void*, int, int64_t*);
+  int (*element_seek_simple)(void*, int, int, int64_t);
+  void* (*element_get_bus)(void*);
+  void* (*bus_pop_filtered)(void*, int);
+  void* (*sample_get_buffer)(void*);
+  int (*buffer_map)(void*, GstMapInfo*, int);
+  void (*buffer_unmap)(void*, GstMapInfo*);
+  void (*mini_object_unref)(void*);
+  void (*object_unref)(void*);
+  void* (*app_sink_try_pull_sample)(void*, uint64_t);
+  int (*app_sink_is_eos)(void*);
+  void (*object_set)(void*, const char*, ...);
+};
+
+template <typename F>
+bool Resolve(void* library, const char* name, F* function) {
+  *function = reinterpret_cast<F>(dlsym(library, name));
+  return *function != nullptr;
+}
+
+// Null when GStreamer or its app library is not installed.
+const GstApi* Gst() {
+  static const GstApi* api = []() -> const GstApi* {
+    void* core = dlopen("libgstreamer-1.0.so.0", RTLD_NOW | RTLD_GLOBAL);
+    void* app = dlopen("libgstapp-1.0.so.0", RTLD_NOW | RTLD_GLOBAL);
+    void* gobject = dlopen("libgobject-2.0.so.0", RTLD_NOW | RTLD_GLOBAL);
+    if (core == nullptr || app == nullptr || gobject == nullptr) {
+      return nullptr;
+    }
+    static GstApi loaded;
+    bool ok =
+        Resolve(core, "gst_init_check", &loaded.init_check) &&
+        Resolve(core, "gst_parse_launch", &loaded.parse_launch) &&
+        Resolve(core, "gst_bin_get_by_name", &loaded.bin_get_by_name) &&
+        Resolve(core, "gst_element_set_state", &loaded.element_set_state) &&
+        Resolve(core, "gst_element_get_state", &loaded.element_get_state) &&
+        Resolve(core, "gst_element_query_duration",
+                &loaded.element_query_duration) &&
+        Resolve(core, "gst_element_seek_simple",
+                &loaded.element_seek_simple) &&
+        Resolve(core, "gst_element_get_bus", &loaded.element_get_bus) &&
+        Resolve(core, "gst_bus_pop_filtered", &loaded.bus_pop_filtered) &&
+        Resolve(core, "gst_sample_get_buffer", &loaded.sample_get_buffer) &&
+        Resolve(core, "gst_buffer_map", &loaded.buffer_map) &&
+        Resolve(core, "gst_buffer_unmap", &loaded.buffer_unmap) &&
+        Resolve(core, "gst_mini_object_unref", &loaded.mini_object_unref) &&
+        Resolve(core, "gst_object_unref", &loaded.object_unref) &&
+        Resolve(app, "gst_app_sink_try_pull_sample",
+                &loaded.app_sink_try_pull_sample) &&
+        Resolve(app, "gst_app_sink_is_eos", &loaded.app_sink_is_eos) &&
+        Resolve(gobject, "g_object_set", &loaded.object_set);
+    if (!ok || !loaded.init_check(nullptr, nullptr, nullptr)) return nullptr;
+    return &loaded;
+  }();
+  return api;
+}
+
+// uridecodebin -> audioconvert -> audioresample -> appsink in the engine
+// format. The appsink does not sync to a clock, so decoding runs as fast as
+// the engine pulls and max-buffers bounds what is queued.
+constexpr char kPipeline[] =
+    "uridecodebin name=src ! audioconvert ! audioresample ! "
+    "appsink name=sink sync=false max-buffers=16 "
+    "caps=audio/x-raw,format=F32LE,layout=interleaved,rate=48000,channels=2";
+
+class GstDecoder : public AudioDecoder {
+ public:
+  static std::unique_ptr<AudioDecoder> Open(const std::string& uri) {
+    const GstApi* gst = Gst();
+    if (gst == nullptr) return nullptr;
+    std::unique_ptr<GstDecoder> decoder(new GstDecoder(gst));
+    if (!decoder->Start(uri)) return nullptr;
+    return decoder;
+  }
+
+  ~GstDecoder() override {
+    if (pipeline_ != nullptr) gst_->element_set_state(pipeline_, kGstStateNull);
+    if (bus_ != nullptr) gst_->object_unref(bus_);
+    if (sink_ != nullptr) gst_->object_unref(sink_);
+    if (pipeline_ != nullptr) gst_->object_unref(pipeline_);
+  }
+
+  size_t Read(float* out, size_t frames) override {
+    size_t done = 0;
+    while (done < frames) {
+      if (pending_at_ == pending_.size() && !Pull()) break;
+      size_t count = std::min(frames - done, (pending_.size() - pending_at_) /
+                                                 kEngineChannels);
+      std::memcpy(out + done * kEngineChannels, &pending_[pending_at_],
+                  count * kEngineChannels * sizeof(float));
+      pending_at_ += count * kEngineChannels;
+      done += count;
+    }
+    return done;
+  }
+
+  bool Seek(int64_t frame) override {
+    int64_t time = std::max<int64_t>(frame, 0) *
+                   static_cast<int64_t>(kGstSecond) / kEngineRate;
+    if (!gst_->element_seek_simple(pipeline_, kGstFormatTime,
+                                   kGstSeekFlagFlush | kGstSeekFlagAccurate,
+                                   time)) {
+      return false;
+    }
+    pending_.clear();
+    pending_at_ = 0;
+    finished_ = false;
+    return true;
+  }
+
+  int64_t length() const override { return length_; }
+  bool finished() const override { return finished_; }
+  bool failed() const override { return failed_; }
+
+ private:
+  explicit GstDecoder(const GstApi* gst) : gst_(gst) {}
+
+  bool Start(const std::string& uri) {
+    pipeline_ = gst_->parse_launch(kPipeline, nullptr);
+    if (pipeline_ == nullptr) return false;
+    sink_ = gst_->bin_get_by_name(pipeline_, "sink");
+    void* source = gst_->bin_get_by_name(pipeline_, "src");
+    bus_ = gst_->element_get_bus(pipeline_);
+    if (sink_ == nullptr || source == nullptr || bus_ == nullptr) {
+      if (source != nullptr) gst_->object_unref(source);
+      return false;
+    }
+    gst_->object_set(source, "uri", uri.c_str(), nullptr);
+    gst_->object_unref(source);
+
+    // PAUSED prerolls: the first buffer reaches the appsink.
+    if (gst_->element_set_state(pipeline_, kGstStatePaused) ==
+            kGstStateChangeFailure ||
+        gst_->element_get_state(pipeline_, nullptr, nullptr,
+                                kPrerollTimeout) != kGstStateChangeSuccess) {
+      return false;
+    }
+    int64_t duration = -1;
+    if (gst_->element_query_duration(pipeline_, kGstFormatTime, &duration) &&
+        duration > 0) {
+      length_ = static_cast<int64_t>(static_cast<double>(duration) *
+                                     kEngineRate / kGstSecond);
+    }
+    return gst_->element_set_state(pipeline_, kGstStatePlaying) !=
+           kGstStateChangeFailure;
+  }
+
+  // Moves the next decoded buffer into pending_. Returns false when none
+  // arrived in time, at the end of the stream or on errors.
+  bool Pull() {
+    pending_.clear();
+    pending_at_ = 0;
+    if (finished_ || failed_) return false;
+    void* sample = gst_->app_sink_try_pull_sample(sink_, kPullTimeout);
+    if (sample == nullptr) {
+      if (gst_->app_sink_is_eos(sink_)) {
+        finished_ = true;
+      } else if (void* error = gst_->bus_pop_filtered(bus_, kGstMessageError)) {
+        gst_->mini_object_unref(error);
+        failed_ = true;
+      }
+      return false;
+    }
+    void* buffer = gst_->sample_get_buffer(sample);
+    GstMapInfo map;
+    if (buffer != nullptr && gst_->buffer_map(buffer, &map, kGstMapRead)) {
+      size_t floats = map.size / sizeof(float);
+      floats -= floats % kEngineChannels;
+      pending_.resize(floats);
+      std::memcpy(pending_.data(), map.data, floats * sizeof(float));
+      gst_->buffer_unmap(buffer, &map);
+    }
+    gst_->mini_object_unref(sample);
+    return true;
+  }
+
+  const GstApi* gst_;
+  void* pipeline_ = nullptr;
+  void* sink_ = nullptr;
+  void* bus_ = nullptr;
+  std::vector<float> pending_;
+  size_t pending_at_ = 0;
+  int64_t length_ = -1;
+  bool finished_ = false;
+  bool failed_ = false;
+};
+
+// ---------------------------------------------------------------------------
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// The local path |uri| names, or "" for URIs of other schemes.
+std::string LocalPath(const std::string& uri) {
+  if (!uri.empty() && uri[0] == '/') return uri;
+  if (uri.compare(0, 7, "file://") != 0) return std::string();
+  std::string path;
+  for (size_t i = 7; i < uri.size(); ++i) {
+    if (uri[i] == '%' && i + 2 < uri.size() && HexValue(uri[i + 1]) >= 0 &&
+        HexValue(uri[i + 2]) >= 0) {
+      path.push_back(
+          static_cast<char>(HexValue(uri[i + 1]) << 4 | HexValue(uri[i + 2])));
+      i += 2;
+    } else {
+      path.push_back(uri[i]);
+    }
+  }
+  return path;
+}
+
+std::string FileUri(const std::string& path) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string uri = "file://";
+  for (unsigned char c : path) {
+    if (std::isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' ||
+        c == '~') {
+      uri.push_back(static_cast<char>(c));
+    } else {
+      uri.push_back('%');
+      uri.push_back(kHex[c >> 4]);
+      uri.push_back(kHex[c & 15]);
+    }
+  }
+  return uri;
+}
+
+}  // namespace
+
+std::unique_ptr<AudioDecoder> OpenAudioDecoder(const std::string& uri) {
+  std::string path = LocalPath(uri);
+  if (!path.empty()) {
+    if (std::unique_ptr<AudioDecoder> wav = WavDecoder::Open(path)) {
+      return wav;
+    }
+    return GstDecoder::Open(FileUri(path));
+  }
+  return GstDecoder::Open(uri);
+}
+
+}  // namespace cyrene
@@ -0,0 +1,44 @@
+#ifndef CYRENE_NATIVE_AUDIO_DECODER_H_
+#define CYRENE_NATIVE_AUDIO_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace cyrene {
+
+// The playback engine's sample format: interleaved stereo float frames.
+constexpr int kEngineRate = 48000;
+constexpr int kEngineChannels = 2;
+
+// Pulls decoded audio from one source in the engine's format.
+class AudioDecoder {
+ public:
+  virtual ~AudioDecoder() = default;
+
+  // Decodes up to |frames| frames into |out|. Returns 0 at the end of the
+  // stream, on errors (see failed()) and when a network source has no data
+  // yet; the caller tells these apart with finished() and failed().
+  virtual size_t Read(float* out, size_t frames) = 0;
+
+  // Moves to |frame|. Returns false if the source cannot seek.
+  virtual bool Seek(int64_t frame) = 0;
+
+  // Total frames, or -1 when the length is unknown.
+  virtual int64_t length() const = 0;
+
+  virtual bool finished() const = 0;
+  virtual bool failed() const = 0;
+};
+
+// Opens |uri|: a local path, a file:// URI or anything GStreamer can read
+// (http:// streams from the loopback proxy included). RIFF WAVE files are
+// decoded directly; everything else goes through GStreamer, which the
+// Linux build already ships for audioplayers and which is loaded on first
+// use. Blocks until the first audio is available. Returns null on failure.
+std::unique_ptr<AudioDecoder> OpenAudioDecoder(const std::string& uri);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_AUDIO_DECODER_H_
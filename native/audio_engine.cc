@@ -0,0 +1,603 @@
+#include "audio_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace cyrene {
+
+namespace {
+
+// Frames per sink write and per decode step (about 21 ms).
+constexpr int kPeriodFrames = 1024;
+constexpr size_t kChunkFrames = 1024;
+// About 1.4 s of audio between the decode and output threads.
+constexpr size_t kRingSamples = size_t{1} << 17;
+constexpr size_t kMaxMarkers = 64;
+// Decoded by the loader before an item is handed over, so a transition
+// does not wait for the network.
+constexpr size_t kPrerollFrames = kEngineRate;
+constexpr auto kPrerollTimeout = std::chrono::seconds(3);
+// How long an idle thread sleeps before looking again.
+constexpr auto kIdleWait = std::chrono::milliseconds(5);
+// Volume changes ramp over 10 ms instead of clicking.
+constexpr float kVolumeStep = 1.0f / (kEngineRate / 100);
+constexpr int64_t kMaxCrossfadeMs = 12000;
+// Loudness normalization may boost quiet items by up to +12 dB.
+constexpr double kMaxItemGain = 4;
+constexpr int32_t kStatusFields = 7;
+
+int64_t FramesToMs(int64_t frames) { return frames * 1000 / kEngineRate; }
+
+}  // namespace
+
+struct AudioEngine::Item {
+  int64_t id = 0;
+  std::unique_ptr<AudioDecoder> decoder;
+  std::vector<float> preroll;
+  size_t preroll_at = 0;
+  int64_t position = 0;  // Frames read so far
+  float gain = 1;
+
+  // Opens |uri| and decodes its first frames. Blocks; runs on a loader.
+  static std::unique_ptr<Item> Open(const DecoderOpener& open, int64_t id,
+                                    const std::string& uri, float gain) {
+    std::unique_ptr<AudioDecoder> decoder = open(uri);
+    if (!decoder) return nullptr;
+    auto item = std::make_unique<Item>();
+    item->id = id;
+    item->gain = gain;
+    item->preroll.resize(kPrerollFrames * kEngineChannels);
+    auto deadline = std::chrono::steady_clock::now() + kPrerollTimeout;
+    size_t filled = 0;
+    while (filled < kPrerollFrames) {
+      size_t got =
+          decoder->Read(item->preroll.data() + filled * kEngineChannels,
+                        kPrerollFrames - filled);
+      filled += got;
+      if (got == 0 && (decoder->finished() || decoder->failed() ||
+                       std::chrono::steady_clock::now() > deadline)) {
+        break;
+      }
+    }
+    if (filled == 0 && decoder->failed()) return nullptr;
+    item->preroll.resize(filled * kEngineChannels);
+    item->decoder = std::move(decoder);
+    return item;
+  }
+
+  size_t Read(float* out, size_t frames) {
+    size_t got = std::min(frames, (preroll.size() - preroll_at) /
+                                      kEngineChannels);
+    std::memcpy(out, preroll.data() + preroll_at,
+                got * kEngineChannels * sizeof(float));
+    preroll_at += got * kEngineChannels;
+    if (got < frames) {
+      got += decoder->Read(out + got * kEngineChannels, frames - got);
+    }
+    if (gain != 1) {
+      for (size_t i = 0; i < got * kEngineChannels; ++i) out[i] *= gain;
+    }
+    position += static_cast<int64_t>(got);
+    return got;
+  }
+
+  bool Seek(int64_t frame) {
+    if (!decoder->Seek(frame)) return false;
+    preroll.clear();
+    preroll_at = 0;
+    position = frame;
+    return true;
+  }
+
+  int64_t length() const { return decoder->length(); }
+  bool finished() const {
+    return preroll_at == preroll.size() && decoder->finished();
+  }
+  bool failed() const {
+    return preroll_at == preroll.size() && decoder->failed();
+  }
+};
+
+struct AudioEngine::Loader {
+  std::thread thread;
+  std::atomic<bool> done{false};
+};
+
+AudioEngine::AudioEngine(std::unique_ptr<AudioSink> sink,
+                         DecoderOpener open)
+    : sink_(std::move(sink)),
+      open_(std::move(open)),
+      ring_(kRingSamples),
+      markers_(kMaxMarkers) {
+  decode_thread_ = std::thread(&AudioEngine::DecodeLoop, this);
+  output_thread_ = std::thread(&AudioEngine::OutputLoop, this);
+}
+
+AudioEngine::~AudioEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cv_.notify_all();
+  decode_thread_.join();
+  output_thread_.join();
+  // Loaders only touch the engine under |mutex_| and are never started
+  // again, so they can be joined without it.
+  for (Loader& loader : loaders_) loader.thread.join();
+}
+
+void AudioEngine::Load(int64_t item_id, const std::string& uri, bool play,
+                       double gain) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  commands_ = Commands();
+  commands_.stop = true;
+  ++next_generation_;
+  load_id_ = item_id;
+  loading_ = true;
+  error_ = false;
+  decoder_done_ = false;
+  playing_ = play;
+  StartLoader(item_id, uri, gain, false);
+  cv_.notify_all();
+}
+
+void AudioEngine::QueueNext(int64_t item_id, const std::string& uri,
+                            double gain) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  commands_.has_next = true;
+  commands_.next.reset();
+  if (uri.empty()) {
+    ++next_generation_;
+  } else {
+    StartLoader(item_id, uri, gain, true);
+  }
+  cv_.notify_all();
+}
+
+void AudioEngine::Play() { playing_ = true; }
+
+void AudioEngine::Pause() { playing_ = false; }
+
+void AudioEngine::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  commands_ = Commands();
+  commands_.stop = true;
+  ++load_generation_;
+  ++next_generation_;
+  loading_ = false;
+  error_ = false;
+  active_ = false;
+  decoder_done_ = false;
+  playing_ = false;
+  cv_.notify_all();
+}
+
+void AudioEngine::Seek(int64_t position_ms) {
+  int64_t item_id;
+  {
+    std::lock_guard<std::mutex> lock(status_mutex_);
+    item_id = published_.item_id;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Before the loaded item is heard, a seek is meant for it.
+  if (loading_ || commands_.load) item_id = load_id_;
+  commands_.seek = std::max<int64_t>(position_ms, 0) * kEngineRate / 1000;
+  commands_.seek_item = item_id;
+  cv_.notify_all();
+}
+
+void AudioEngine::SetVolume(double volume) {
+  volume_ = static_cast<float>(std::min(std::max(volume, 0.0), 1.0));
+}
+
+void AudioEngine::SetCrossfade(int32_t milliseconds) {
+  int64_t clamped = std::min<int64_t>(std::max(milliseconds, 0),
+                                      kMaxCrossfadeMs);
+  crossfade_frames_ = clamped * kEngineRate / 1000;
+}
+
+AudioEngine::Status AudioEngine::status() const {
+  Status status;
+  int64_t drained_through;
+  {
+    std::lock_guard<std::mutex> lock(status_mutex_);
+    status = published_;
+    drained_through = drained_through_;
+  }
+  status.next_item_id = next_id_;
+  if (error_) {
+    status.state = State::kError;
+  } else if (loading_) {
+    status.state = State::kLoading;
+  } else if (!active_) {
+    status.state = State::kIdle;
+  } else if (decoder_done_ && drained_through >= end_frame_) {
+    status.state = State::kEnded;
+  } else {
+    status.state = playing_ ? State::kPlaying : State::kPaused;
+  }
+  return status;
+}
+
+// Called with |mutex_| held. A newer request for the same slot bumps the
+// generation, which makes an older loader drop its result.
+void AudioEngine::StartLoader(int64_t item_id, const std::string& uri,
+                              double gain, bool next) {
+  ReapLoaders();
+  uint64_t generation = next ? ++next_generation_ : ++load_generation_;
+  loaders_.emplace_back();
+  Loader* loader = &loaders_.back();
+  float item_gain = static_cast<float>(std::min(std::max(gain, 0.0),
+                                                kMaxItemGain));
+  loader->thread = std::thread([this, loader, item_id, uri, item_gain, next,
+                                generation] {
+    std::unique_ptr<Item> item = Item::Open(open_, item_id, uri, item_gain);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (next && generation == next_generation_) {
+        if (item) {
+          commands_.has_next = true;
+          commands_.next = std::move(item);
+        }
+      } else if (!next && generation == load_generation_) {
+        if (item) {
+          commands_.load = std::move(item);
+        } else {
+          loading_ = false;
+          error_ = true;
+        }
+      }
+      cv_.notify_all();
+    }
+    loader->done = true;
+  });
+}
+
+void AudioEngine::ReapLoaders() {
+  for (auto it = loaders_.begin(); it != loaders_.end();) {
+    if (it->done) {
+      it->thread.join();
+      it = loaders_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Decode thread
+
+void AudioEngine::DecodeLoop() {
+  std::vector<float> buffer(kChunkFrames * kEngineChannels);
+  std::vector<float> other(kChunkFrames * kEngineChannels);
+  bool progressed = false;
+  while (true) {
+    Commands commands;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!progressed && !commands_.pending() && !quit_) {
+        cv_.wait_for(lock, kIdleWait);
+      }
+      if (quit_) return;
+      std::swap(commands, commands_);
+      if (commands.load) {
+        loading_ = false;
+        active_ = true;
+        decoder_done_ = false;
+      }
+    }
+    Apply(&commands);
+    progressed = Decode(buffer.data(), other.data());
+  }
+}
+
+void AudioEngine::Apply(Commands* commands) {
+  if (commands->stop) {
+    current_.reset();
+    SetNext(nullptr);
+    deferred_ = Commands();
+    fading_ = false;
+    FlushOutput();
+  }
+  if (commands->load) {
+    current_ = std::move(commands->load);
+    PushMarker(*current_);
+  }
+  if (commands->has_next) {
+    if (fading_) {
+      // The transition is under way; this is the item after it.
+      deferred_.has_next = true;
+      deferred_.next = std::move(commands->next);
+    } else {
+      SetNext(std::move(commands->next));
+    }
+  }
+  if (commands->seek >= 0) SeekTo(commands->seek_item, commands->seek);
+}
+
+void AudioEngine::SetNext(std::unique_ptr<Item> item) {
+  next_ = std::move(item);
+  next_id_ = next_ ? next_->id : 0;
+}
+
+// Seeks within the item being heard, which during a crossfade may be the
+// incoming one. Seeks meant for an item the decoder already left behind
+// are ignored.
+void AudioEngine::SeekTo(int64_t item_id, int64_t frame) {
+  if (fading_ && next_->id == item_id) Promote();
+  if (!current_ || current_->id != item_id) return;
+  if (fading_) {
+    fading_ = false;
+    if (!next_->Seek(0)) SetNext(nullptr);
+  }
+  if (!current_->Seek(frame)) return;
+  decoder_done_ = false;
+  FlushOutput();
+  PushMarker(*current_);
+}
+
+// Makes the queued item current, after its marker has been written.
+void AudioEngine::Promote() {
+  current_ = std::move(next_);
+  SetNext(nullptr);
+  fading_ = false;
+  if (deferred_.has_next) SetNext(std::move(deferred_.next));
+  deferred_ = Commands();
+}
+
+bool AudioEngine::Decode(float* buffer, float* other) {
+  if (!current_ || (decoder_done_ && !next_)) return false;
+  if (ring_.WriteAvailable() < kChunkFrames * kEngineChannels) return false;
+
+  int64_t crossfade = crossfade_frames_;
+  int64_t length = current_->length();
+  if (!fading_ && next_ && crossfade > 0 && length > 0 &&
+      length - current_->position <= crossfade) {
+    fading_ = true;
+    fade_at_ = 0;
+    fade_length_ = std::max<int64_t>(length - current_->position, 1);
+    PushMarker(*next_);
+  }
+
+  size_t got = current_->Read(buffer, kChunkFrames);
+  if (got == 0) {
+    if (!current_->finished() && !current_->failed()) return false;
+    if (next_) {
+      // Possibly queued after this item was decoded to its end.
+      decoder_done_ = false;
+      bool faded = fading_;
+      Promote();
+      if (!faded) PushMarker(*current_);
+      return true;
+    }
+    // The item stays current so that a seek back into its tail, which is
+    // still being heard, has something to seek.
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A pending load or stop supersedes the end of this item.
+    if (!commands_.pending()) {
+      end_frame_ = written_;
+      decoder_done_ = true;
+      if (current_->failed()) error_ = true;
+    }
+    return false;
+  }
+
+  if (fading_) {
+    size_t mixed = next_->Read(other, got);
+    std::fill(other + mixed * kEngineChannels, other + got * kEngineChannels,
+              0.0f);
+    for (size_t i = 0; i < got; ++i) {
+      double t = std::min(
+          1.0, static_cast<double>(fade_at_ + static_cast<int64_t>(i)) /
+                   static_cast<double>(fade_length_));
+      float out_gain = static_cast<float>(std::cos(t * M_PI / 2));
+      float in_gain = static_cast<float>(std::sin(t * M_PI / 2));
+      for (int c = 0; c < kEngineChannels; ++c) {
+        float& sample = buffer[i * kEngineChannels + c];
+        sample = sample * out_gain + other[i * kEngineChannels + c] * in_gain;
+      }
+    }
+    fade_at_ += static_cast<int64_t>(got);
+  }
+  WriteFrames(buffer, got);
+  if (fading_ && fade_at_ >= fade_length_) Promote();
+  return true;
+}
+
+void AudioEngine::WriteFrames(const float* frames, size_t count) {
+  ring_.Write(frames, count * kEngineChannels);
+  written_ += static_cast<int64_t>(count);
+}
+
+void AudioEngine::PushMarker(const Item& item) {
+  Marker marker{written_, item.id, item.position, item.length()};
+  markers_.Write(&marker, 1);
+}
+
+// Has the output thread drop everything in the ring and the device. The
+// decode thread writes nothing meanwhile, so afterwards both sides agree
+// that stream frame |written_| is the next one heard.
+void AudioEngine::FlushOutput() {
+  uint64_t request = flush_request_ + 1;
+  flush_request_ = request;
+  while (flush_ack_ != request && !quit_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Output thread
+
+void AudioEngine::OutputLoop() {
+  std::vector<float> period(kPeriodFrames * kEngineChannels);
+  bool sink_paused = false;
+  float gain = volume_;
+  while (!quit_) {
+    ServiceFlush();
+    bool hold = !playing_;
+    if (hold != sink_paused) {
+      sink_->SetPaused(hold);
+      sink_paused = hold;
+    }
+    size_t got =
+        hold ? 0 : ring_.Read(period.data(), period.size()) / kEngineChannels;
+    if (got == 0) {
+      // Running dry is an underrun only while an item is mid-stream; not
+      // while loading, after a flush or at the end.
+      if (!hold && !starving_ && active_ && !decoder_done_ && !loading_) {
+        ++starvations_;
+      }
+      starving_ = true;
+      PublishStatus();
+      std::this_thread::sleep_for(kIdleWait);
+      continue;
+    }
+    if (starving_) {
+      // The device ran out during the same gap; don't count it twice.
+      sink_->SetPaused(false);
+    }
+    starving_ = false;
+
+    float target = volume_;
+    for (size_t i = 0; i < got; ++i) {
+      if (gain < target) {
+        gain = std::min(gain + kVolumeStep, target);
+      } else if (gain > target) {
+        gain = std::max(gain - kVolumeStep, target);
+      }
+      for (int c = 0; c < kEngineChannels; ++c) {
+        period[i * kEngineChannels + c] *= gain;
+      }
+    }
+    if (!sink_->Write(period.data(), got)) {
+      error_ = true;
+      std::this_thread::sleep_for(kIdleWait);
+    }
+    played_ += static_cast<int64_t>(got);
+    PublishStatus();
+  }
+}
+
+void AudioEngine::ServiceFlush() {
+  uint64_t request = flush_request_;
+  if (request == flush_ack_) return;
+  played_ += static_cast<int64_t>(ring_.Discard(ring_.ReadAvailable()) /
+                                  kEngineChannels);
+  markers_.Discard(markers_.ReadAvailable());
+  sink_->Flush();
+  starving_ = true;
+  flush_ack_ = request;
+}
+
+void AudioEngine::PublishStatus() {
+  int64_t delay = sink_->DelayFrames();
+  int64_t heard = played_ - delay;
+  Marker marker;
+  while (markers_.Peek(&marker, 1) == 1 && marker.frame <= heard) {
+    markers_.Discard(1);
+    heard_ = marker;
+  }
+  int64_t position = heard_.base + std::max<int64_t>(heard - heard_.frame, 0);
+  if (heard_.length > 0) position = std::min(position, heard_.length);
+  int64_t buffered =
+      static_cast<int64_t>(ring_.ReadAvailable() / kEngineChannels);
+
+  std::lock_guard<std::mutex> lock(status_mutex_);
+  published_.item_id = heard_.item_id;
+  published_.position_ms = FramesToMs(position);
+  published_.duration_ms = heard_.length > 0 ? FramesToMs(heard_.length) : 0;
+  published_.latency_ms = FramesToMs(delay + buffered);
+  published_.underruns = starvations_ + sink_->underruns();
+  drained_through_ = delay <= 0 && buffered == 0 ? played_ : -1;
+}
+
+}  // namespace cyrene
+
+void* cyrene_audio_engine_create(int32_t backend) {
+  if (backend < 0 ||
+      backend > static_cast<int32_t>(cyrene::SinkBackend::kNull)) {
+    return nullptr;
+  }
+  std::unique_ptr<cyrene::AudioSink> sink = cyrene::OpenAudioSink(
+      static_cast<cyrene::SinkBackend>(backend), cyrene::kPeriodFrames);
+  if (!sink) return nullptr;
+  return new cyrene::AudioEngine(std::move(sink));
+}
+
+void cyrene_audio_engine_destroy(void* handle) {
+  delete static_cast<cyrene::AudioEngine*>(handle);
+}
+
+int32_t cyrene_audio_engine_load(void* handle, int64_t item_id,
+                                 const char* uri, int32_t play, double gain) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine == nullptr || uri == nullptr || *uri == '\0') return 0;
+  engine->Load(item_id, uri, play != 0, gain);
+  return 1;
+}
+
+int32_t cyrene_audio_engine_queue_next(void* handle, int64_t item_id,
+                                       const char* uri, double gain) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine == nullptr) return 0;
+  engine->QueueNext(item_id, uri != nullptr ? uri : "", gain);
+  return 1;
+}
+
+void cyrene_audio_engine_play(void* handle) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->Play();
+}
+
+void cyrene_audio_engine_pause(void* handle) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->Pause();
+}
+
+void cyrene_audio_engine_stop(void* handle) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->Stop();
+}
+
+void cyrene_audio_engine_seek(void* handle, int64_t position_ms) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->Seek(position_ms);
+}
+
+void cyrene_audio_engine_set_volume(void* handle, double volume) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->SetVolume(volume);
+}
+
+void cyrene_audio_engine_set_crossfade(void* handle, int32_t milliseconds) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine != nullptr) engine->SetCrossfade(milliseconds);
+}
+
+int32_t cyrene_audio_engine_status(void* handle, int64_t* out,
+                                   int32_t capacity) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  if (engine == nullptr || out == nullptr || capacity <= 0) return 0;
+  cyrene::AudioEngine::Status status = engine->status();
+  const int64_t fields[cyrene::kStatusFields] = {
+      static_cast<int64_t>(status.state),
+      status.item_id,
+      status.position_ms,
+      status.duration_ms,
+      status.latency_ms,
+      status.underruns,
+      status.next_item_id,
+  };
+  int32_t count = std::min(capacity, cyrene::kStatusFields);
+  std::copy(fields, fields + count, out);
+  return count;
+}
+
+const char* cyrene_audio_engine_sink_name(void* handle) {
+  auto* engine = static_cast<cyrene::AudioEngine*>(handle);
+  return engine != nullptr ? engine->sink_name() : "";
+}
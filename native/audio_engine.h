@@ -0,0 +1,220 @@
+#ifndef CYRENE_NATIVE_AUDIO_ENGINE_H_
+#define CYRENE_NATIVE_AUDIO_ENGINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "audio_decoder.h"
+#include "audio_sink.h"
+#include "native_export.h"
+#include "spsc_ring.h"
+
+namespace cyrene {
+
+// Playback engine for the Linux build: a decode thread fills a lock-free
+// ring that the output thread drains into the sink, so decoding, network
+// stalls and commands never block the device.
+//
+// Items are identified by caller-chosen ids. Load() replaces whatever is
+// playing; QueueNext() opens the following item in the background and
+// pre-decodes its first second, so when the current item ends the decode
+// thread continues with it in the same ring: no gap, and no device
+// restart. With a crossfade set and a known length, the two items are
+// mixed with equal-power gains over the last |crossfade| of the current
+// one instead. Item boundaries travel through the ring as markers, so
+// status() reports an item only once it is actually heard.
+class AudioEngine {
+ public:
+  enum class State : int64_t {
+    kIdle = 0,
+    kLoading = 1,
+    kPlaying = 2,
+    kPaused = 3,
+    kEnded = 4,
+    kError = 5,
+  };
+
+  struct Status {
+    State state = State::kIdle;
+    int64_t item_id = 0;
+    int64_t position_ms = 0;
+    int64_t duration_ms = 0;  // 0 when unknown
+    // Audio decoded but not heard yet: what the device holds plus the ring.
+    int64_t latency_ms = 0;
+    // Times the ring ran dry while playing, plus device underruns.
+    int64_t underruns = 0;
+    // The queued item, once it is open and ready to take over; else 0.
+    int64_t next_item_id = 0;
+  };
+
+  // Opens the decoder for an item's uri; called on a loader thread.
+  using DecoderOpener =
+      std::function<std::unique_ptr<AudioDecoder>(const std::string& uri)>;
+
+  // |open| defaults to OpenAudioDecoder; tests pass their own to simulate
+  // slow sources.
+  explicit AudioEngine(std::unique_ptr<AudioSink> sink,
+                       DecoderOpener open = OpenAudioDecoder);
+  ~AudioEngine();
+
+  AudioEngine(const AudioEngine&) = delete;
+  AudioEngine& operator=(const AudioEngine&) = delete;
+
+  // Stops the current item and opens |uri| (see OpenAudioDecoder) as
+  // |item_id|, starting paused unless |play|. Also drops the queued item.
+  // |gain| is a linear factor applied to this item's samples before
+  // mixing and volume, e.g. its loudness normalization.
+  void Load(int64_t item_id, const std::string& uri, bool play,
+            double gain = 1);
+  // Makes |uri| the item after the current one; an empty |uri| clears it.
+  void QueueNext(int64_t item_id, const std::string& uri, double gain = 1);
+
+  void Play();
+  void Pause();
+  void Stop();
+  void Seek(int64_t position_ms);
+  void SetVolume(double volume);
+  void SetCrossfade(int32_t milliseconds);
+
+  Status status() const;
+  const char* sink_name() const { return sink_->name(); }
+
+ private:
+  struct Item;
+  struct Loader;
+
+  // Written through the ring alongside the audio: from stream frame
+  // |frame| on, the output is |item_id| at position |base|.
+  struct Marker {
+    int64_t frame;
+    int64_t item_id;
+    int64_t base;
+    int64_t length;
+  };
+
+  // Requests for the decode thread, applied in this order.
+  struct Commands {
+    bool stop = false;
+    std::unique_ptr<Item> load;
+    bool has_next = false;
+    std::unique_ptr<Item> next;  // Null with |has_next| clears it.
+    int64_t seek = -1;  // Frame
+    int64_t seek_item = 0;
+
+    bool pending() const { return stop || load || has_next || seek >= 0; }
+  };
+
+  void StartLoader(int64_t item_id, const std::string& uri, double gain,
+                   bool next);
+  void ReapLoaders();
+
+  // Decode thread.
+  void DecodeLoop();
+  void Apply(Commands* commands);
+  void SetNext(std::unique_ptr<Item> item);
+  void SeekTo(int64_t item_id, int64_t frame);
+  void Promote();
+  bool Decode(float* buffer, float* other);
+  void WriteFrames(const float* frames, size_t count);
+  void PushMarker(const Item& item);
+  void FlushOutput();
+
+  // Output thread.
+  void OutputLoop();
+  void ServiceFlush();
+  void PublishStatus();
+
+  std::unique_ptr<AudioSink> sink_;
+  const DecoderOpener open_;
+  SpscRing<float> ring_;
+  SpscRing<Marker> markers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  Commands commands_;
+  uint64_t load_generation_ = 0;
+  uint64_t next_generation_ = 0;
+  std::list<Loader> loaders_;
+  int64_t load_id_ = 0;
+
+  std::atomic<bool> quit_{false};
+  std::atomic<bool> playing_{false};
+  std::atomic<bool> loading_{false};
+  std::atomic<bool> active_{false};
+  std::atomic<bool> decoder_done_{false};
+  std::atomic<int64_t> end_frame_{0};  // |written_| when it was set
+  std::atomic<bool> error_{false};
+  std::atomic<float> volume_{1};
+  std::atomic<int64_t> crossfade_frames_{0};
+  std::atomic<int64_t> next_id_{0};
+  std::atomic<uint64_t> flush_request_{0};
+  std::atomic<uint64_t> flush_ack_{0};
+  std::atomic<int64_t> starvations_{0};
+
+  // Decode thread only.
+  std::unique_ptr<Item> current_;
+  std::unique_ptr<Item> next_;
+  Commands deferred_;  // Queue changes arriving mid-crossfade.
+  bool fading_ = false;
+  int64_t fade_at_ = 0;
+  int64_t fade_length_ = 0;
+  int64_t written_ = 0;
+
+  // Output thread only.
+  int64_t played_ = 0;
+  Marker heard_{0, 0, 0, -1};
+  bool starving_ = true;
+
+  mutable std::mutex status_mutex_;
+  Status published_;
+  // |played_| when the ring and the device were last seen empty, else -1.
+  // Compared against |end_frame_|, so that an item that fits in the ring is
+  // not reported ended before the output has even started on it.
+  int64_t drained_through_ = -1;
+
+  std::thread decode_thread_;
+  std::thread output_thread_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/audio_engine_native.dart. |backend| is a
+// SinkBackend; cyrene_audio_engine_create() returns null when it cannot be
+// opened. Strings are UTF-8. cyrene_audio_engine_status() writes up to
+// |capacity| of: state, item id, position ms, duration ms, latency ms,
+// underruns, next item id, and returns how many it wrote.
+CYRENE_EXPORT void* cyrene_audio_engine_create(int32_t backend);
+CYRENE_EXPORT void cyrene_audio_engine_destroy(void* handle);
+CYRENE_EXPORT int32_t cyrene_audio_engine_load(void* handle, int64_t item_id,
+                                               const char* uri, int32_t play,
+                                               double gain);
+CYRENE_EXPORT int32_t cyrene_audio_engine_queue_next(void* handle,
+                                                     int64_t item_id,
+                                                     const char* uri,
+                                                     double gain);
+CYRENE_EXPORT void cyrene_audio_engine_play(void* handle);
+CYRENE_EXPORT void cyrene_audio_engine_pause(void* handle);
+CYRENE_EXPORT void cyrene_audio_engine_stop(void* handle);
+CYRENE_EXPORT void cyrene_audio_engine_seek(void* handle,
+                                            int64_t position_ms);
+CYRENE_EXPORT void cyrene_audio_engine_set_volume(void* handle,
+                                                  double volume);
+CYRENE_EXPORT void cyrene_audio_engine_set_crossfade(void* handle,
+                                                     int32_t milliseconds);
+CYRENE_EXPORT int32_t cyrene_audio_engine_status(void* handle, int64_t* out,
+                                                 int32_t capacity);
+CYRENE_EXPORT const char* cyrene_audio_engine_sink_name(void* handle);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_AUDIO_ENGINE_H_
@@ -0,0 +1,298 @@
+#include "audio_sink.h"
+
+#include <dlfcn.h>
+
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#include "audio_decoder.h"
+
+namespace cyrene {
+
+namespace {
+
+constexpr size_t kFrameBytes = kEngineChannels * sizeof(float);
+// Device buffer in periods: enough to ride out scheduling hiccups, short
+// enough that pause and seek feel immediate.
+constexpr int kBufferPeriods = 4;
+
+template <typename F>
+bool Resolve(void* library, const char* name, F* function) {
+  *function = reinterpret_cast<F>(dlsym(library, name));
+  return *function != nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Null sink: consumes frames in real time, for tests and machines without
+// an audio server.
+
+class NullSink : public AudioSink {
+ public:
+  explicit NullSink(int period_frames)
+      : buffered_(Frames(period_frames * kBufferPeriods)) {}
+
+  bool Write(const float*, size_t count) override {
+    Clock::time_point now = Clock::now();
+    if (end_ < now) end_ = now;
+    end_ += Frames(static_cast<int64_t>(count));
+    std::this_thread::sleep_until(end_ - buffered_);
+    return true;
+  }
+
+  int64_t DelayFrames() override {
+    Clock::duration left = end_ - Clock::now();
+    if (left <= Clock::duration::zero()) return 0;
+    return std::chrono::duration_cast<std::chrono::microseconds>(left)
+               .count() *
+           kEngineRate / 1000000;
+  }
+
+  void Flush() override { end_ = Clock::now(); }
+  void SetPaused(bool) override { end_ = Clock::now(); }
+  int64_t underruns() const override { return 0; }
+  const char* name() const override { return "null"; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static Clock::duration Frames(int64_t count) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::microseconds(count * 1000000 / kEngineRate));
+  }
+
+  Clock::duration buffered_;
+  Clock::time_point end_ = Clock::now();
+};
+
+// ---------------------------------------------------------------------------
+// PulseAudio (and PipeWire through pipewire-pulse) via the simple API.
+
+constexpr int kPaSampleFloat32Le = 5;
+constexpr int kPaStreamPlayback = 1;
+
+struct PaSampleSpec {
+  int format;
+  uint32_t rate;
+  uint8_t channels;
+};
+
+struct PaBufferAttr {
+  uint32_t maxlength;
+  uint32_t tlength;
+  uint32_t prebuf;
+  uint32_t minreq;
+  uint32_t fragsize;
+};
+
+struct PulseApi {
+  void* (*simple_new)(const char*, const char*, int, const char*,
+                      const char*, const PaSampleSpec*, const void*,
+                      const PaBufferAttr*, int*);
+  int (*simple_write)(void*, const void*, size_t, int*);
+  uint64_t (*simple_get_latency)(void*, int*);
+  int (*simple_flush)(void*, int*);
+  void (*simple_free)(void*);
+};
+
+const PulseApi* Pulse() {
+  static const PulseApi* api = []() -> const PulseApi* {
+    void* library = dlopen("libpulse-simple.so.0", RTLD_NOW);
+    if (library == nullptr) return nullptr;
+    static PulseApi loaded;
+    bool ok =
+        Resolve(library, "pa_simple_new", &loaded.simple_new) &&
+        Resolve(library, "pa_simple_write", &loaded.simple_write) &&
+        Resolve(library, "pa_simple_get_latency",
+                &loaded.simple_get_latency) &&
+        Resolve(library, "pa_simple_flush", &loaded.simple_flush) &&
+        Resolve(library, "pa_simple_free", &loaded.simple_free);
+    return ok ? &loaded : nullptr;
+  }();
+  return api;
+}
+
+class PulseSink : public AudioSink {
+ public:
+  static std::unique_ptr<AudioSink> Open(int period_frames) {
+    const PulseApi* pulse = Pulse();
+    if (pulse == nullptr) return nullptr;
+    PaSampleSpec spec{kPaSampleFloat32Le, kEngineRate, kEngineChannels};
+    PaBufferAttr attributes{
+        UINT32_MAX,
+        static_cast<uint32_t>(period_frames * kBufferPeriods * kFrameBytes),
+        UINT32_MAX, UINT32_MAX, UINT32_MAX};
+    int error = 0;
+    void* stream = pulse->simple_new(nullptr, "Cyrene Music",
+                                     kPaStreamPlayback, nullptr, "Playback",
+                                     &spec, nullptr, &attributes, &error);
+    if (stream == nullptr) return nullptr;
+    return std::unique_ptr<AudioSink>(new PulseSink(pulse, stream));
+  }
+
+  ~PulseSink() override { pulse_->simple_free(stream_); }
+
+  bool Write(const float* frames, size_t count) override {
+    int error = 0;
+    return pulse_->simple_write(stream_, frames, count * kFrameBytes,
+                                &error) == 0;
+  }
+
+  int64_t DelayFrames() override {
+    int error = 0;
+    uint64_t latency = pulse_->simple_get_latency(stream_, &error);
+    if (latency == UINT64_MAX) return 0;
+    return static_cast<int64_t>(latency * kEngineRate / 1000000);
+  }
+
+  void Flush() override {
+    int error = 0;
+    pulse_->simple_flush(stream_, &error);
+  }
+
+  // The simple API cannot cork; the server simply runs out of data, which
+  // it does not treat as an error.
+  void SetPaused(bool) override {}
+
+  int64_t underruns() const override { return 0; }
+  const char* name() const override { return "pulse"; }
+
+ private:
+  PulseSink(const PulseApi* pulse, void* stream)
+      : pulse_(pulse), stream_(stream) {}
+
+  const PulseApi* pulse_;
+  void* stream_;
+};
+
+// ---------------------------------------------------------------------------
+// ALSA
+
+constexpr int kSndPcmStreamPlayback = 0;
+constexpr int kSndPcmFormatFloatLe = 14;
+constexpr int kSndPcmAccessRwInterleaved = 3;
+
+struct AlsaApi {
+  int (*pcm_open)(void**, const char*, int, int);
+  int (*pcm_set_params)(void*, int, int, unsigned, unsigned, int, unsigned);
+  long (*pcm_writei)(void*, const void*, unsigned long);  // NOLINT
+  int (*pcm_recover)(void*, int, int);
+  int (*pcm_delay)(void*, long*);  // NOLINT
+  int (*pcm_drop)(void*);
+  int (*pcm_prepare)(void*);
+  int (*pcm_pause)(void*, int);
+  int (*pcm_close)(void*);
+};
+
+const AlsaApi* Alsa() {
+  static const AlsaApi* api = []() -> const AlsaApi* {
+    void* library = dlopen("libasound.so.2", RTLD_NOW);
+    if (library == nullptr) return nullptr;
+    static AlsaApi loaded;
+    bool ok = Resolve(library, "snd_pcm_open", &loaded.pcm_open) &&
+              Resolve(library, "snd_pcm_set_params", &loaded.pcm_set_params) &&
+              Resolve(library, "snd_pcm_writei", &loaded.pcm_writei) &&
+              Resolve(library, "snd_pcm_recover", &loaded.pcm_recover) &&
+              Resolve(library, "snd_pcm_delay", &loaded.pcm_delay) &&
+              Resolve(library, "snd_pcm_drop", &loaded.pcm_drop) &&
+              Resolve(library, "snd_pcm_prepare", &loaded.pcm_prepare) &&
+              Resolve(library, "snd_pcm_pause", &loaded.pcm_pause) &&
+              Resolve(library, "snd_pcm_close", &loaded.pcm_close);
+    return ok ? &loaded : nullptr;
+  }();
+  return api;
+}
+
+class AlsaSink : public AudioSink {
+ public:
+  static std::unique_ptr<AudioSink> Open(int period_frames) {
+    const AlsaApi* alsa = Alsa();
+    if (alsa == nullptr) return nullptr;
+    void* pcm = nullptr;
+    if (alsa->pcm_open(&pcm, "default", kSndPcmStreamPlayback, 0) < 0) {
+      return nullptr;
+    }
+    unsigned latency_us = static_cast<unsigned>(
+        static_cast<int64_t>(period_frames) * kBufferPeriods * 1000000 /
+        kEngineRate);
+    if (alsa->pcm_set_params(pcm, kSndPcmFormatFloatLe,
+                             kSndPcmAccessRwInterleaved, kEngineChannels,
+                             kEngineRate, 1, latency_us) < 0) {
+      alsa->pcm_close(pcm);
+      return nullptr;
+    }
+    return std::unique_ptr<AudioSink>(new AlsaSink(alsa, pcm));
+  }
+
+  ~AlsaSink() override { alsa_->pcm_close(pcm_); }
+
+  bool Write(const float* frames, size_t count) override {
+    while (count > 0) {
+      long written = alsa_->pcm_writei(pcm_, frames, count);  // NOLINT
+      if (written < 0) {
+        // -EPIPE is an underrun; after a pause the device could not hold
+        // on to, it is expected and not counted.
+        if (written == -EPIPE && !resuming_) ++underruns_;
+        if (alsa_->pcm_recover(pcm_, static_cast<int>(written), 1) < 0) {
+          return false;
+        }
+        continue;
+      }
+      frames += written * kEngineChannels;
+      count -= static_cast<size_t>(written);
+    }
+    resuming_ = false;
+    return true;
+  }
+
+  int64_t DelayFrames() override {
+    long delay = 0;  // NOLINT
+    return alsa_->pcm_delay(pcm_, &delay) == 0 && delay > 0 ? delay : 0;
+  }
+
+  void Flush() override {
+    alsa_->pcm_drop(pcm_);
+    alsa_->pcm_prepare(pcm_);
+  }
+
+  void SetPaused(bool paused) override {
+    if (paused) {
+      hardware_paused_ = alsa_->pcm_pause(pcm_, 1) == 0;
+    } else if (hardware_paused_) {
+      alsa_->pcm_pause(pcm_, 0);
+      hardware_paused_ = false;
+    } else {
+      resuming_ = true;
+    }
+  }
+
+  int64_t underruns() const override { return underruns_; }
+  const char* name() const override { return "alsa"; }
+
+ private:
+  AlsaSink(const AlsaApi* alsa, void* pcm) : alsa_(alsa), pcm_(pcm) {}
+
+  const AlsaApi* alsa_;
+  void* pcm_;
+  int64_t underruns_ = 0;
+  bool hardware_paused_ = false;
+  bool resuming_ = false;
+};
+
+}  // namespace
+
+std::unique_ptr<AudioSink> OpenAudioSink(SinkBackend backend,
+                                         int period_frames) {
+  std::unique_ptr<AudioSink> sink;
+  if (backend == SinkBackend::kAuto || backend == SinkBackend::kPulse) {
+    sink = PulseSink::Open(period_frames);
+    if (sink || backend == SinkBackend::kPulse) return sink;
+  }
+  if (backend == SinkBackend::kAuto || backend == SinkBackend::kAlsa) {
+    sink = AlsaSink::Open(period_frames);
+    if (sink || backend == SinkBackend::kAlsa) return sink;
+  }
+  return std::unique_ptr<AudioSink>(new NullSink(period_frames));
+}
+
+}  // namespace cyrene
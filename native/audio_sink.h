@@ -0,0 +1,53 @@
+#ifndef CYRENE_NATIVE_AUDIO_SINK_H_
+#define CYRENE_NATIVE_AUDIO_SINK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace cyrene {
+
+// Where the engine's audio goes. kAuto tries PulseAudio (which PipeWire
+// also serves through pipewire-pulse), then ALSA, then the null sink.
+enum class SinkBackend : int32_t {
+  kAuto = 0,
+  kPulse = 1,
+  kAlsa = 2,
+  kNull = 3,
+};
+
+// An output device taking interleaved stereo float frames at kEngineRate.
+// All calls come from the engine's output thread.
+class AudioSink {
+ public:
+  virtual ~AudioSink() = default;
+
+  // Blocks until the device has taken all |count| frames. Returns false
+  // when the device failed.
+  virtual bool Write(const float* frames, size_t count) = 0;
+
+  // Frames written but not heard yet.
+  virtual int64_t DelayFrames() = 0;
+
+  // Drops what the device still holds (after seeks and track changes).
+  virtual void Flush() = 0;
+
+  // Stops taking frames without counting the gap as an underrun.
+  virtual void SetPaused(bool paused) = 0;
+
+  // Underruns the device reported.
+  virtual int64_t underruns() const = 0;
+
+  virtual const char* name() const = 0;
+};
+
+// Opens |backend|, writing in periods of |period_frames|. The PulseAudio and
+// ALSA client libraries are loaded with dlopen, so a missing library or
+// server only makes kAuto fall through to the next backend. Returns null
+// when the requested backend is unavailable.
+std::unique_ptr<AudioSink> OpenAudioSink(SinkBackend backend,
+                                         int period_frames);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_AUDIO_SINK_H_
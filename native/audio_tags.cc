@@ -0,0 +1,715 @@
+#include "audio_tags.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// Longest tag value kept; longer ones are cut at a character boundary.
+constexpr size_t kMaxTextLength = 1024;
+// Largest text frame, ilst item or INFO list read; anything bigger is not a
+// title.
+constexpr size_t kMaxTextFrame = 64 * 1024;
+// Bytes searched for the first MPEG frame after the ID3v2 tag.
+constexpr size_t kSyncSearchBytes = 64 * 1024;
+// Bytes read from the start and the end of an Ogg stream.
+constexpr size_t kOggHeadBytes = 128 * 1024;
+constexpr size_t kOggTailBytes = 64 * 1024;
+// Largest FLAC Vorbis comment block read.
+constexpr size_t kMaxCommentBytes = 1024 * 1024;
+
+uint16_t ReadLE16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t ReadLE64(const uint8_t* p) {
+  return static_cast<uint64_t>(ReadLE32(p)) |
+         (static_cast<uint64_t>(ReadLE32(p + 4)) << 32);
+}
+
+uint32_t ReadSyncsafe(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0] & 0x7F) << 21) |
+         (static_cast<uint32_t>(p[1] & 0x7F) << 14) |
+         (static_cast<uint32_t>(p[2] & 0x7F) << 7) |
+         static_cast<uint32_t>(p[3] & 0x7F);
+}
+
+// Bounds-checked positional reads of the file being inspected.
+class Reader {
+ public:
+  Reader(int fd, uint64_t size) : fd_(fd), size_(size) {}
+
+  uint64_t size() const { return size_; }
+
+  bool Read(uint64_t offset, void* data, size_t length) const {
+    return offset <= size_ && length <= size_ - offset &&
+           PReadFully(fd_, static_cast<uint8_t*>(data), length, offset);
+  }
+
+  // Up to |length| bytes at |offset|, fewer at the end of the file.
+  std::vector<uint8_t> ReadAt(uint64_t offset, size_t length) const {
+    if (offset >= size_) return {};
+    length = static_cast<size_t>(std::min<uint64_t>(length, size_ - offset));
+    std::vector<uint8_t> data(length);
+    if (!Read(offset, data.data(), length)) data.clear();
+    return data;
+  }
+
+ private:
+  int fd_;
+  uint64_t size_;
+};
+
+void AppendUtf8(std::string* out, uint32_t cp) {
+  if (cp < 0x80) {
+    out->push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+bool IsValidUtf8(const uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n;) {
+    uint8_t c = p[i];
+    size_t extra;
+    if (c < 0x80) {
+      extra = 0;
+    } else if (c >= 0xC2 && c < 0xE0) {
+      extra = 1;
+    } else if (c >= 0xE0 && c < 0xF0) {
+      extra = 2;
+    } else if (c >= 0xF0 && c < 0xF5) {
+      extra = 3;
+    } else {
+      return false;
+    }
+    if (extra >= n - i) return false;
+    for (size_t k = 1; k <= extra; ++k) {
+      if ((p[i + k] & 0xC0) != 0x80) return false;
+    }
+    i += extra + 1;
+  }
+  return true;
+}
+
+// ISO-8859-1 text, as the specs say. Many taggers write UTF-8 there anyway;
+// that is kept as is.
+std::string Latin1OrUtf8(const uint8_t* p, size_t n) {
+  n = strnlen(reinterpret_cast<const char*>(p), n);
+  if (IsValidUtf8(p, n)) {
+    return std::string(reinterpret_cast<const char*>(p), n);
+  }
+  std::string out;
+  out.reserve(n * 2);
+  for (size_t i = 0; i < n; ++i) AppendUtf8(&out, p[i]);
+  return out;
+}
+
+// UTF-16 up to the first NUL.
+std::string Utf16ToUtf8(const uint8_t* p, size_t n, bool big_endian) {
+  std::string out;
+  auto unit = [p, big_endian](size_t i) -> uint32_t {
+    return big_endian ? (p[i] << 8) | p[i + 1] : p[i] | (p[i + 1] << 8);
+  };
+  for (size_t i = 0; i + 1 < n; i += 2) {
+    uint32_t cp = unit(i);
+    if (cp == 0) break;
+    if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < n) {
+      uint32_t low = unit(i + 2);
+      if (low >= 0xDC00 && low < 0xE000) {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+    }
+    AppendUtf8(&out, cp);
+  }
+  return out;
+}
+
+// Stores |value| into an empty |field|, trimmed and length-capped. Fields
+// already set by a better source (ID3v2 over ID3v1) are kept.
+void SetText(std::string* field, std::string value) {
+  if (!field->empty()) return;
+  size_t begin = value.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) return;
+  size_t end = value.find_last_not_of(" \t\r\n") + 1;
+  value = value.substr(begin, end - begin);
+  if (value.size() > kMaxTextLength) {
+    size_t cut = kMaxTextLength;
+    while (cut > 0 && (static_cast<uint8_t>(value[cut]) & 0xC0) == 0x80) {
+      --cut;
+    }
+    value.resize(cut);
+  }
+  *field = std::move(value);
+}
+
+// ---------------------------------------------------------------------------
+// ID3v2 / ID3v1 / MPEG
+
+std::string DecodeId3Text(const uint8_t* p, size_t n) {
+  if (n == 0) return {};
+  uint8_t encoding = p[0];
+  ++p;
+  --n;
+  switch (encoding) {
+    case 0:
+      return Latin1OrUtf8(p, n);
+    case 1:
+      if (n >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+        return Utf16ToUtf8(p + 2, n - 2, true);
+      }
+      if (n >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+        return Utf16ToUtf8(p + 2, n - 2, false);
+      }
+      return Utf16ToUtf8(p, n, false);
+    case 2:
+      return Utf16ToUtf8(p, n, true);
+    case 3:
+      return std::string(reinterpret_cast<const char*>(p),
+                         strnlen(reinterpret_cast<const char*>(p), n));
+    default:
+      return {};
+  }
+}
+
+// Undoes ID3 unsynchronisation (FF 00 -> FF) in place.
+void RemoveUnsync(std::vector<uint8_t>* data) {
+  size_t out = 0;
+  for (size_t i = 0; i < data->size(); ++i) {
+    (*data)[out++] = (*data)[i];
+    if ((*data)[i] == 0xFF && i + 1 < data->size() && (*data)[i + 1] == 0) {
+      ++i;
+    }
+  }
+  data->resize(out);
+}
+
+// Reads the ID3v2 tag at |offset|, if any, and returns its total size so the
+// caller can skip it (0 when there is no tag). Only text frames are read.
+uint64_t ReadId3v2(const Reader& r, uint64_t offset, AudioTags* tags,
+                   int64_t* tag_length_ms) {
+  uint8_t h[10];
+  if (!r.Read(offset, h, sizeof(h)) || std::memcmp(h, "ID3", 3) != 0 ||
+      ((h[6] | h[7] | h[8] | h[9]) & 0x80)) {
+    return 0;
+  }
+  uint8_t major = h[3];
+  uint8_t flags = h[5];
+  uint64_t size = ReadSyncsafe(h + 6);
+  uint64_t total = 10 + size + ((flags & 0x10) ? 10 : 0);
+  if (major < 2 || major > 4) return total;
+
+  uint64_t pos = offset + 10;
+  uint64_t end = std::min(offset + 10 + size, r.size());
+  if ((flags & 0x40) && major >= 3) {
+    uint8_t e[4];
+    if (!r.Read(pos, e, sizeof(e))) return total;
+    pos += major == 4 ? ReadSyncsafe(e) : format::ReadU32(e) + 4;
+  }
+
+  size_t header_size = major == 2 ? 6 : 10;
+  while (pos + header_size <= end) {
+    uint8_t fh[10];
+    if (!r.Read(pos, fh, header_size) || fh[0] == 0) break;  // Padding
+
+    char id[5] = {};
+    uint64_t frame_size;
+    uint16_t frame_flags = 0;
+    if (major == 2) {
+      std::memcpy(id, fh, 3);
+      frame_size = (fh[3] << 16) | (fh[4] << 8) | fh[5];
+    } else {
+      std::memcpy(id, fh, 4);
+      frame_size = major == 4 ? ReadSyncsafe(fh + 4) : format::ReadU32(fh + 4);
+      frame_flags = format::ReadU16(fh + 8);
+    }
+    uint64_t body = pos + header_size;
+    if (frame_size > end - body) break;
+    pos = body + frame_size;
+
+    std::string* field = nullptr;
+    bool is_length = false;
+    if (!std::strcmp(id, "TIT2") || !std::strcmp(id, "TT2")) {
+      field = &tags->title;
+    } else if (!std::strcmp(id, "TPE1") || !std::strcmp(id, "TP1")) {
+      field = &tags->artist;
+    } else if (!std::strcmp(id, "TALB") || !std::strcmp(id, "TAL")) {
+      field = &tags->album;
+    } else if (!std::strcmp(id, "TLEN") || !std::strcmp(id, "TLE")) {
+      is_length = true;
+    }
+    if ((field == nullptr && !is_length) || frame_size > kMaxTextFrame) {
+      continue;
+    }
+
+    size_t skip = 0;
+    bool unsync = (flags & 0x80) != 0;
+    if (major == 4) {
+      if (frame_flags & 0x000C) continue;  // Compressed or encrypted
+      if (frame_flags & 0x0040) skip += 1;  // Group id
+      if (frame_flags & 0x0001) skip += 4;  // Data length indicator
+      unsync = unsync || (frame_flags & 0x0002);
+    } else if (major == 3) {
+      if (frame_flags & 0x00C0) continue;  // Compressed or encrypted
+      if (frame_flags & 0x0020) skip += 1;  // Group id
+    }
+
+    std::vector<uint8_t> data = r.ReadAt(body, static_cast<size_t>(frame_size));
+    if (data.size() != frame_size) break;
+    if (unsync) RemoveUnsync(&data);
+    if (skip >= data.size()) continue;
+    std::string text = DecodeId3Text(data.data() + skip, data.size() - skip);
+    if (is_length) {
+      *tag_length_ms = std::strtoll(text.c_str(), nullptr, 10);
+    } else {
+      SetText(field, std::move(text));
+    }
+  }
+  return total;
+}
+
+bool ReadId3v1(const Reader& r, AudioTags* tags) {
+  uint8_t t[128];
+  if (r.size() < sizeof(t) || !r.Read(r.size() - sizeof(t), t, sizeof(t)) ||
+      std::memcmp(t, "TAG", 3) != 0) {
+    return false;
+  }
+  SetText(&tags->title, Latin1OrUtf8(t + 3, 30));
+  SetText(&tags->artist, Latin1OrUtf8(t + 33, 30));
+  SetText(&tags->album, Latin1OrUtf8(t + 63, 30));
+  return true;
+}
+
+struct MpegHeader {
+  bool v1;
+  bool mono;
+  int bitrate_kbps;
+  int sample_rate;
+  int samples;
+  int frame_size;
+};
+
+bool ParseMpegHeader(const uint8_t* p, MpegHeader* h) {
+  static const int16_t kBitrates[5][16] = {
+      {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+      {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+      {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+      {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+      {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+  };
+  static const int kSampleRates[3] = {44100, 48000, 32000};
+
+  if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+  int version = (p[1] >> 3) & 3;  // 0: 2.5, 2: 2, 3: 1
+  int layer = 4 - ((p[1] >> 1) & 3);
+  int bitrate_index = p[2] >> 4;
+  int rate_index = (p[2] >> 2) & 3;
+  if (version == 1 || layer == 4 || bitrate_index == 0 ||
+      bitrate_index == 15 || rate_index == 3) {
+    return false;
+  }
+
+  h->v1 = version == 3;
+  h->mono = (p[3] >> 6) == 3;
+  h->bitrate_kbps = kBitrates[h->v1 ? layer - 1 : (layer == 1 ? 3 : 4)]
+                             [bitrate_index];
+  h->sample_rate =
+      kSampleRates[rate_index] >> (h->v1 ? 0 : version == 2 ? 1 : 2);
+  h->samples = layer == 1 ? 384 : (layer == 2 || h->v1) ? 1152 : 576;
+  int padding = (p[2] >> 1) & 1;
+  h->frame_size =
+      layer == 1
+          ? (12 * h->bitrate_kbps * 1000 / h->sample_rate + padding) * 4
+          : h->samples / 8 * h->bitrate_kbps * 1000 / h->sample_rate + padding;
+  return h->frame_size > 4;
+}
+
+// Duration of the MPEG stream starting at or after |start|: from the
+// Xing/Info or VBRI frame count when the encoder wrote one, else from the
+// bitrate of the first frame (exact for CBR).
+bool ReadMpegDuration(const Reader& r, uint64_t start, bool has_id3v1,
+                      AudioTags* tags) {
+  std::vector<uint8_t> buf = r.ReadAt(start, kSyncSearchBytes);
+  MpegHeader h;
+  size_t i = 0;
+  for (; i + 4 <= buf.size(); ++i) {
+    if (!ParseMpegHeader(buf.data() + i, &h)) continue;
+    // A second header where the first frame ends rules out a false sync.
+    size_t next = i + h.frame_size;
+    MpegHeader second;
+    if (next + 4 > buf.size() || ParseMpegHeader(buf.data() + next, &second)) {
+      break;
+    }
+  }
+  if (i + 4 > buf.size()) return false;
+
+  uint64_t frames = 0;
+  size_t side_info = h.v1 ? (h.mono ? 17 : 32) : (h.mono ? 9 : 17);
+  size_t xing = i + 4 + side_info;
+  size_t vbri = i + 4 + 32;
+  if (xing + 12 <= buf.size() &&
+      (!std::memcmp(&buf[xing], "Xing", 4) ||
+       !std::memcmp(&buf[xing], "Info", 4)) &&
+      (format::ReadU32(&buf[xing + 4]) & 1)) {
+    frames = format::ReadU32(&buf[xing + 8]);
+  } else if (vbri + 18 <= buf.size() && !std::memcmp(&buf[vbri], "VBRI", 4)) {
+    frames = format::ReadU32(&buf[vbri + 14]);
+  }
+
+  if (frames > 0) {
+    tags->duration_ms = static_cast<int64_t>(
+        frames * h.samples * 1000 / static_cast<uint64_t>(h.sample_rate));
+  } else {
+    uint64_t audio_start = start + i;
+    uint64_t audio_end = r.size() - (has_id3v1 ? 128 : 0);
+    if (audio_end <= audio_start) return false;
+    // kbps is bits per millisecond.
+    tags->duration_ms = static_cast<int64_t>((audio_end - audio_start) * 8 /
+                                             h.bitrate_kbps);
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// FLAC / Ogg
+
+void ParseVorbisComments(const uint8_t* p, size_t n, AudioTags* tags) {
+  if (n < 4) return;
+  uint64_t vendor = ReadLE32(p);
+  if (vendor > n - 4 || n - 4 - vendor < 4) return;
+  size_t off = 4 + static_cast<size_t>(vendor);
+  uint32_t count = ReadLE32(p + off);
+  off += 4;
+  for (uint32_t i = 0; i < count && off + 4 <= n; ++i) {
+    uint32_t length = ReadLE32(p + off);
+    off += 4;
+    if (length > n - off) break;  // Truncated (the head read ran out)
+    const char* field = reinterpret_cast<const char*>(p + off);
+    off += length;
+
+    const char* eq = static_cast<const char*>(std::memchr(field, '=', length));
+    if (eq == nullptr) continue;
+    size_t key_length = eq - field;
+    std::string value(eq + 1, field + length);
+    if (key_length == 5 && !strncasecmp(field, "TITLE", 5)) {
+      SetText(&tags->title, std::move(value));
+    } else if (key_length == 6 && !strncasecmp(field, "ARTIST", 6)) {
+      SetText(&tags->artist, std::move(value));
+    } else if (key_length == 5 && !strncasecmp(field, "ALBUM", 5)) {
+      SetText(&tags->album, std::move(value));
+    }
+  }
+}
+
+bool ReadFlac(const Reader& r, uint64_t offset, AudioTags* tags) {
+  uint64_t pos = offset + 4;  // "fLaC"
+  for (;;) {
+    uint8_t h[4];
+    if (!r.Read(pos, h, sizeof(h))) break;
+    bool last = (h[0] & 0x80) != 0;
+    int type = h[0] & 0x7F;
+    uint32_t length = (h[1] << 16) | (h[2] << 8) | h[3];
+    uint64_t body = pos + 4;
+
+    if (type == 0 && length >= 18) {  // STREAMINFO
+      uint8_t s[18];
+      if (r.Read(body, s, sizeof(s))) {
+        uint32_t rate = (s[10] << 12) | (s[11] << 4) | (s[12] >> 4);
+        uint64_t samples = (static_cast<uint64_t>(s[13] & 0x0F) << 32) |
+                           format::ReadU32(s + 14);
+        if (rate > 0) {
+          tags->duration_ms = static_cast<int64_t>(samples * 1000 / rate);
+        }
+      }
+    } else if (type == 4 && length <= kMaxCommentBytes) {  // VORBIS_COMMENT
+      std::vector<uint8_t> data = r.ReadAt(body, length);
+      ParseVorbisComments(data.data(), data.size(), tags);
+    }
+    pos = body + length;  // PICTURE and the rest are skipped unread
+    if (last) break;
+  }
+  return true;
+}
+
+bool ReadOgg(const Reader& r, AudioTags* tags) {
+  // Reassemble the first two packets of the first logical stream: the
+  // identification and comment headers.
+  std::vector<uint8_t> head = r.ReadAt(0, kOggHeadBytes);
+  std::vector<std::vector<uint8_t>> packets;
+  std::vector<uint8_t> packet;
+  uint32_t serial = 0;
+  bool have_serial = false;
+  size_t pos = 0;
+  while (packets.size() < 2 && pos + 27 <= head.size() &&
+         !std::memcmp(&head[pos], "OggS", 4)) {
+    size_t segments = head[pos + 26];
+    size_t data = pos + 27 + segments;
+    if (data > head.size()) break;
+    uint32_t page_serial = ReadLE32(&head[pos + 14]);
+    if (!have_serial) {
+      serial = page_serial;
+      have_serial = true;
+    }
+    size_t next = data;
+    for (size_t s = 0; s < segments; ++s) {
+      size_t length = head[pos + 27 + s];
+      if (page_serial == serial && packets.size() < 2) {
+        size_t available = next < head.size() ? head.size() - next : 0;
+        packet.insert(packet.end(), head.begin() + next,
+                      head.begin() + next + std::min(length, available));
+        if (length < 255) {
+          packets.push_back(std::move(packet));
+          packet.clear();
+        }
+      }
+      next += length;
+    }
+    pos = next;
+  }
+  // A comment packet cut off by the head read still has its leading fields.
+  if (packets.size() == 1 && !packet.empty()) packets.push_back(packet);
+  if (packets.empty()) return false;
+
+  uint32_t rate = 0;
+  uint64_t pre_skip = 0;
+  const std::vector<uint8_t>& id = packets[0];
+  size_t comment_offset = 0;
+  if (id.size() >= 16 && !std::memcmp(id.data(), "\x01vorbis", 7)) {
+    rate = ReadLE32(&id[12]);
+    comment_offset = 7;  // "\x03vorbis"
+  } else if (id.size() >= 12 && !std::memcmp(id.data(), "OpusHead", 8)) {
+    rate = 48000;  // Opus granule positions are always 48 kHz
+    pre_skip = ReadLE16(&id[10]);
+    comment_offset = 8;  // "OpusTags"
+  } else {
+    return false;
+  }
+  if (packets.size() > 1 && packets[1].size() > comment_offset) {
+    ParseVorbisComments(packets[1].data() + comment_offset,
+                        packets[1].size() - comment_offset, tags);
+  }
+
+  // Duration: granule position of the stream's last page.
+  uint64_t tail_offset =
+      r.size() > kOggTailBytes ? r.size() - kOggTailBytes : 0;
+  std::vector<uint8_t> tail = r.ReadAt(tail_offset, kOggTailBytes);
+  for (size_t i = tail.size() >= 27 ? tail.size() - 27 : 0;
+       tail.size() >= 27; --i) {
+    if (!std::memcmp(&tail[i], "OggS", 4) &&
+        ReadLE32(&tail[i + 14]) == serial) {
+      uint64_t granule = ReadLE64(&tail[i + 6]);
+      if (granule != ~0ull) {
+        if (rate > 0 && granule > pre_skip) {
+          tags->duration_ms =
+              static_cast<int64_t>((granule - pre_skip) * 1000 / rate);
+        }
+        break;
+      }
+    }
+    if (i == 0) break;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// MP4
+
+struct Atom {
+  uint64_t offset;  // Of the body
+  uint64_t size;    // Of the body
+  char type[4];
+
+  bool Is(const char* name) const { return !std::memcmp(type, name, 4); }
+  uint64_t end() const { return offset + size; }
+};
+
+bool ReadAtomHeader(const Reader& r, uint64_t pos, uint64_t end, Atom* atom) {
+  uint8_t h[16];
+  if (end < pos || end - pos < 8 || !r.Read(pos, h, 8)) return false;
+  uint64_t size = format::ReadU32(h);
+  uint64_t header = 8;
+  if (size == 1) {
+    if (end - pos < 16 || !r.Read(pos + 8, h + 8, 8)) return false;
+    size = format::ReadU64(h + 8);
+    header = 16;
+  } else if (size == 0) {
+    size = end - pos;  // Extends to the end of the enclosing box
+  }
+  if (size < header || size > end - pos) return false;
+  std::memcpy(atom->type, h + 4, 4);
+  atom->offset = pos + header;
+  atom->size = size - header;
+  return true;
+}
+
+// Calls |visit| for each child box in [begin, end) until it returns false.
+// Only box headers are read, so mdat and the sample tables cost nothing.
+template <typename Visit>
+void ForEachAtom(const Reader& r, uint64_t begin, uint64_t end, Visit visit) {
+  Atom atom;
+  for (uint64_t pos = begin; ReadAtomHeader(r, pos, end, &atom);
+       pos = atom.end()) {
+    if (!visit(atom)) return;
+  }
+}
+
+void ReadIlst(const Reader& r, const Atom& ilst, AudioTags* tags) {
+  ForEachAtom(r, ilst.offset, ilst.end(), [&](const Atom& item) {
+    std::string* field = nullptr;
+    if (item.Is("\xA9" "nam")) {
+      field = &tags->title;
+    } else if (item.Is("\xA9" "ART") || item.Is("aART")) {
+      field = &tags->artist;
+    } else if (item.Is("\xA9" "alb")) {
+      field = &tags->album;
+    }
+    if (field == nullptr || item.size > kMaxTextFrame) return true;
+    ForEachAtom(r, item.offset, item.end(), [&](const Atom& data) {
+      if (!data.Is("data") || data.size < 8) return true;
+      // [u32 type][u32 locale][UTF-8 value]
+      std::vector<uint8_t> value =
+          r.ReadAt(data.offset + 8, static_cast<size_t>(data.size - 8));
+      SetText(field, std::string(value.begin(), value.end()));
+      return false;
+    });
+    return true;
+  });
+}
+
+bool ReadMp4(const Reader& r, AudioTags* tags) {
+  ForEachAtom(r, 0, r.size(), [&](const Atom& top) {
+    if (!top.Is("moov")) return true;
+    ForEachAtom(r, top.offset, top.end(), [&](const Atom& box) {
+      if (box.Is("mvhd")) {
+        uint8_t m[32];
+        if (box.size >= 20 && r.Read(box.offset, m, 20)) {
+          uint64_t timescale, duration;
+          if (m[0] == 1) {
+            if (box.size < 32 || !r.Read(box.offset, m, 32)) return true;
+            timescale = format::ReadU32(m + 20);
+            duration = format::ReadU64(m + 24);
+          } else {
+            timescale = format::ReadU32(m + 12);
+            duration = format::ReadU32(m + 16);
+          }
+          if (timescale > 0) {
+            tags->duration_ms =
+                static_cast<int64_t>(duration * 1000 / timescale);
+          }
+        }
+      } else if (box.Is("udta")) {
+        ForEachAtom(r, box.offset, box.end(), [&](const Atom& meta) {
+          // meta is a full box: version and flags precede its children.
+          if (!meta.Is("meta") || meta.size < 4) return true;
+          ForEachAtom(r, meta.offset + 4, meta.end(), [&](const Atom& ilst) {
+            if (ilst.Is("ilst")) ReadIlst(r, ilst, tags);
+            return true;
+          });
+          return true;
+        });
+      }
+      return true;
+    });
+    return false;  // One movie per file
+  });
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// RIFF WAVE
+
+bool ReadWav(const Reader& r, AudioTags* tags) {
+  uint64_t byte_rate = 0;
+  uint64_t data_size = 0;
+  uint64_t pos = 12;
+  uint8_t h[12];
+  while (r.Read(pos, h, 8)) {
+    uint32_t length = ReadLE32(h + 4);
+    uint64_t body = pos + 8;
+    if (!std::memcmp(h, "fmt ", 4) && length >= 12 && r.Read(body, h, 12)) {
+      byte_rate = ReadLE32(h + 8);
+    } else if (!std::memcmp(h, "data", 4)) {
+      data_size = std::min<uint64_t>(length, r.size() - body);
+    } else if (!std::memcmp(h, "LIST", 4) && length >= 4 &&
+               length <= kMaxTextFrame) {
+      std::vector<uint8_t> list = r.ReadAt(body, length);
+      if (list.size() >= 4 && !std::memcmp(list.data(), "INFO", 4)) {
+        for (size_t i = 4; i + 8 <= list.size();) {
+          size_t size = ReadLE32(&list[i + 4]);
+          if (size > list.size() - i - 8) break;
+          const uint8_t* value = &list[i + 8];
+          if (!std::memcmp(&list[i], "INAM", 4)) {
+            SetText(&tags->title, Latin1OrUtf8(value, size));
+          } else if (!std::memcmp(&list[i], "IART", 4)) {
+            SetText(&tags->artist, Latin1OrUtf8(value, size));
+          } else if (!std::memcmp(&list[i], "IPRD", 4)) {
+            SetText(&tags->album, Latin1OrUtf8(value, size));
+          }
+          i += 8 + size + (size & 1);
+        }
+      }
+    }
+    pos = body + length + (length & 1);
+  }
+  if (byte_rate > 0 && data_size > 0) {
+    tags->duration_ms = static_cast<int64_t>(data_size * 1000 / byte_rate);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadAudioTags(int fd, uint64_t file_size, AudioTags* tags) {
+  Reader r(fd, file_size);
+  uint8_t magic[12];
+  if (!r.Read(0, magic, sizeof(magic))) return false;
+
+  if (!std::memcmp(magic, "fLaC", 4)) return ReadFlac(r, 0, tags);
+  if (!std::memcmp(magic, "OggS", 4)) return ReadOgg(r, tags);
+  if (!std::memcmp(magic + 4, "ftyp", 4)) return ReadMp4(r, tags);
+  if (!std::memcmp(magic, "RIFF", 4) && !std::memcmp(magic + 8, "WAVE", 4)) {
+    return ReadWav(r, tags);
+  }
+
+  // MPEG audio, usually behind an ID3v2 tag (which FLAC files sometimes
+  // carry too).
+  int64_t tag_length_ms = 0;
+  uint64_t start = ReadId3v2(r, 0, tags, &tag_length_ms);
+  uint8_t after[4];
+  if (start > 0 && r.Read(start, after, sizeof(after)) &&
+      !std::memcmp(after, "fLaC", 4)) {
+    return ReadFlac(r, start, tags);
+  }
+  bool has_id3v1 = ReadId3v1(r, tags);
+  bool mpeg = ReadMpegDuration(r, start, has_id3v1, tags);
+  if (!mpeg && tag_length_ms > 0) tags->duration_ms = tag_length_ms;
+  return start > 0 || has_id3v1 || mpeg;
+}
+
+}  // namespace cyrene
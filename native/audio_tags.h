@@ -0,0 +1,32 @@
+#ifndef CYRENE_NATIVE_AUDIO_TAGS_H_
+#define CYRENE_NATIVE_AUDIO_TAGS_H_
+
+#include <cstdint>
+#include <string>
+
+namespace cyrene {
+
+// Display metadata of a local audio file. Strings are UTF-8 and empty when
+// the file has no such tag; a zero duration means it could not be worked out
+// from the headers.
+struct AudioTags {
+  std::string title;
+  std::string artist;
+  std::string album;
+  int64_t duration_ms = 0;
+};
+
+// Reads tags and duration from the open file |fd| of |file_size| bytes,
+// touching only headers: ID3v2 (frame bodies other than text are skipped,
+// so embedded covers are never read) and ID3v1 with the MPEG Xing/VBRI or
+// CBR duration, FLAC STREAMINFO and Vorbis comments, Ogg Vorbis/Opus (first
+// pages plus the last page for the granule position), MP4/M4A (mvhd and the
+// ilst atoms) and RIFF WAVE (fmt, data and LIST INFO).
+//
+// The container is detected from the content, not the extension. Returns
+// false for formats it does not know; |tags| may then still be partly set.
+bool ReadAudioTags(int fd, uint64_t file_size, AudioTags* tags);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_AUDIO_TAGS_H_
@@ -0,0 +1,358 @@
+#include "background_blur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "fd_util.h"
+#include "image_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CYRENE_BLUR_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CYRENE_BLUR_NEON 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+// Long side of the working image. Even an unblurred background is drawn
+// from at most this many pixels across, which a full-screen tint hides.
+constexpr int kMaxWorkingSide = 512;
+// Blur sigma, in working pixels, that the working size aims for: large
+// enough that three boxes still approximate a Gaussian, small enough that
+// strong blurs run on a thumbnail-sized image.
+constexpr double kWorkingSigma = 6.0;
+constexpr int kJpegQuality = 90;
+
+// All kernels emit one output row of a vertical box pass and slide the
+// window: out = round(acc / box), then acc += add - sub, for |lanes| bytes.
+// |scale| is 65536 / box, rounded.
+using BoxRowKernel = void (*)(uint32_t* acc, const uint8_t* add,
+                              const uint8_t* sub, uint8_t* out, int lanes,
+                              uint32_t scale);
+
+void BoxRowScalar(uint32_t* acc, const uint8_t* add, const uint8_t* sub,
+                  uint8_t* out, int lanes, uint32_t scale) {
+  for (int i = 0; i < lanes; ++i) {
+    uint32_t value = (acc[i] * scale + 0x8000) >> 16;
+    out[i] = static_cast<uint8_t>(std::min<uint32_t>(value, 255));
+    acc[i] += add[i] - sub[i];
+  }
+}
+
+#if defined(CYRENE_BLUR_X86)
+
+__attribute__((target("avx2"))) void BoxRowAvx2(uint32_t* acc,
+                                                const uint8_t* add,
+                                                const uint8_t* sub,
+                                                uint8_t* out, int lanes,
+                                                uint32_t scale) {
+  const __m256i factor = _mm256_set1_epi32(static_cast<int>(scale));
+  const __m256i half = _mm256_set1_epi32(0x8000);
+  int i = 0;
+  for (; i + 8 <= lanes; i += 8) {
+    __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+    __m256i value = _mm256_srli_epi32(
+        _mm256_add_epi32(_mm256_mullo_epi32(sum, factor), half), 16);
+    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(value),
+                                     _mm256_extracti128_si256(value, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(words, words));
+    __m256i in = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(add + i)));
+    __m256i gone = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(sub + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i),
+                        _mm256_sub_epi32(_mm256_add_epi32(sum, in), gone));
+  }
+  BoxRowScalar(acc + i, add + i, sub + i, out + i, lanes - i, scale);
+}
+
+#endif  // CYRENE_BLUR_X86
+
+#if defined(CYRENE_BLUR_NEON)
+
+void BoxRowNeon(uint32_t* acc, const uint8_t* add, const uint8_t* sub,
+                uint8_t* out, int lanes, uint32_t scale) {
+  const uint32x4_t factor = vdupq_n_u32(scale);
+  int i = 0;
+  for (; i + 8 <= lanes; i += 8) {
+    uint32x4_t low = vld1q_u32(acc + i);
+    uint32x4_t high = vld1q_u32(acc + i + 4);
+    uint16x8_t words =
+        vcombine_u16(vqmovn_u32(vrshrq_n_u32(vmulq_u32(low, factor), 16)),
+                     vqmovn_u32(vrshrq_n_u32(vmulq_u32(high, factor), 16)));
+    vst1_u8(out + i, vqmovn_u16(words));
+    uint16x8_t in = vmovl_u8(vld1_u8(add + i));
+    uint16x8_t gone = vmovl_u8(vld1_u8(sub + i));
+    low = vsubq_u32(vaddq_u32(low, vmovl_u16(vget_low_u16(in))),
+                    vmovl_u16(vget_low_u16(gone)));
+    high = vsubq_u32(vaddq_u32(high, vmovl_u16(vget_high_u16(in))),
+                     vmovl_u16(vget_high_u16(gone)));
+    vst1q_u32(acc + i, low);
+    vst1q_u32(acc + i + 4, high);
+  }
+  BoxRowScalar(acc + i, add + i, sub + i, out + i, lanes - i, scale);
+}
+
+#endif  // CYRENE_BLUR_NEON
+
+struct KernelChoice {
+  BoxRowKernel kernel;
+  const char* name;
+};
+
+KernelChoice SelectKernel() {
+#if defined(CYRENE_BLUR_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return {BoxRowAvx2, "avx2"};
+#elif defined(CYRENE_BLUR_NEON)
+  return {BoxRowNeon, "neon"};
+#endif
+  return {BoxRowScalar, "scalar"};
+}
+
+const KernelChoice& Kernel() {
+  static const KernelChoice choice = SelectKernel();
+  return choice;
+}
+
+// Packed RGBA pixels.
+struct Image {
+  std::vector<uint8_t> pixels;
+  int width = 0;
+  int height = 0;
+};
+
+// Radii of three box filters whose composition approximates a Gaussian of
+// |sigma| (Kovesi, "Fast almost-Gaussian filtering").
+void BoxRadii(double sigma, int radii[3]) {
+  constexpr int kPasses = 3;
+  double ideal = std::sqrt(12.0 * sigma * sigma / kPasses + 1.0);
+  int lower = static_cast<int>(ideal);
+  if (lower % 2 == 0) --lower;
+  int upper = lower + 2;
+  double m = (12.0 * sigma * sigma - kPasses * lower * lower -
+              4.0 * kPasses * lower - 3.0 * kPasses) /
+             (-4.0 * lower - 4.0);
+  int lower_count = static_cast<int>(std::lround(m));
+  for (int i = 0; i < kPasses; ++i) {
+    radii[i] = ((i < lower_count ? lower : upper) - 1) / 2;
+  }
+}
+
+// One vertical box pass of |radius| over |height| rows of |lanes| bytes,
+// clamping at the edges like ImageFilter.blur's default tile mode.
+void BoxColumns(const uint8_t* in, uint8_t* out, int lanes, int height,
+                int radius, std::vector<uint32_t>* acc) {
+  auto row = [&](int y) {
+    return in + static_cast<size_t>(std::clamp(y, 0, height - 1)) * lanes;
+  };
+  acc->assign(lanes, 0);
+  uint32_t* sums = acc->data();
+  for (int i = 0; i < lanes; ++i) sums[i] = (radius + 1u) * in[i];
+  for (int k = 1; k <= radius; ++k) {
+    const uint8_t* r = row(k);
+    for (int i = 0; i < lanes; ++i) sums[i] += r[i];
+  }
+
+  uint32_t scale = static_cast<uint32_t>(
+      std::lround(65536.0 / (2 * radius + 1)));
+  BoxRowKernel kernel = Kernel().kernel;
+  for (int y = 0; y < height; ++y) {
+    kernel(sums, row(y + radius + 1), row(y - radius),
+           out + static_cast<size_t>(y) * lanes, lanes, scale);
+  }
+}
+
+// Swaps rows and columns, so horizontal passes can run as vertical ones.
+void Transpose(const Image& in, Image* out) {
+  out->width = in.height;
+  out->height = in.width;
+  out->pixels.resize(in.pixels.size());
+  for (int y = 0; y < in.height; ++y) {
+    const uint8_t* src =
+        in.pixels.data() + static_cast<size_t>(y) * in.width * 4;
+    uint8_t* dst = out->pixels.data() + static_cast<size_t>(y) * 4;
+    for (int x = 0; x < in.width; ++x) {
+      std::memcpy(dst + static_cast<size_t>(x) * in.height * 4, src + x * 4,
+                  4);
+    }
+  }
+}
+
+// Three vertical box passes over |image|, using |scratch| as the other
+// buffer.
+void BlurColumns(Image* image, Image* scratch, const int radii[3],
+                 std::vector<uint32_t>* acc) {
+  scratch->pixels.resize(image->pixels.size());
+  for (int i = 0; i < 3; ++i) {
+    if (radii[i] == 0) continue;
+    BoxColumns(image->pixels.data(), scratch->pixels.data(), image->width * 4,
+               image->height, radii[i], acc);
+    image->pixels.swap(scratch->pixels);
+  }
+}
+
+void Blur(Image* image, double sigma) {
+  int radii[3];
+  BoxRadii(sigma, radii);
+  if (radii[0] == 0 && radii[2] == 0) return;
+
+  Image scratch;
+  Image transposed;
+  std::vector<uint32_t> acc;
+  BlurColumns(image, &scratch, radii, &acc);
+  Transpose(*image, &transposed);
+  BlurColumns(&transposed, &scratch, radii, &acc);
+  Transpose(transposed, image);
+}
+
+// Averages the source pixels under each working pixel of the |crop_width|
+// x |crop_height| rectangle at (|left|, |top|). The boxes have integer
+// bounds; the blur that follows hides the rounding.
+Image Shrink(const DecodedImage& image, int left, int top, int crop_width,
+             int crop_height, int width, int height) {
+  std::vector<int> columns(width + 1);
+  for (int x = 0; x <= width; ++x) {
+    columns[x] = left + static_cast<int>(
+                            static_cast<int64_t>(x) * crop_width / width);
+  }
+
+  Image out;
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(static_cast<size_t>(width) * height * 4);
+  std::vector<uint32_t> sums(static_cast<size_t>(width) * 3);
+  for (int y = 0; y < height; ++y) {
+    int first = top + static_cast<int>(
+                          static_cast<int64_t>(y) * crop_height / height);
+    int last = top + static_cast<int>(
+                         static_cast<int64_t>(y + 1) * crop_height / height);
+    std::fill(sums.begin(), sums.end(), 0);
+    for (int sy = first; sy < last; ++sy) {
+      const uint8_t* src =
+          image.pixels.data() +
+          static_cast<size_t>(sy) * image.width * image.channels;
+      for (int x = 0; x < width; ++x) {
+        for (int sx = columns[x]; sx < columns[x + 1]; ++sx) {
+          const uint8_t* p = src + sx * image.channels;
+          sums[x * 3] += p[0];
+          sums[x * 3 + 1] += p[1];
+          sums[x * 3 + 2] += p[2];
+        }
+      }
+    }
+
+    uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * width * 4;
+    for (int x = 0; x < width; ++x) {
+      uint32_t count =
+          static_cast<uint32_t>((last - first) * (columns[x + 1] - columns[x]));
+      for (int c = 0; c < 3; ++c) {
+        dst[x * 4 + c] =
+            static_cast<uint8_t>((sums[x * 3 + c] + count / 2) / count);
+      }
+      dst[x * 4 + 3] = 0xFF;
+    }
+  }
+  return out;
+}
+
+// Source-over composite of the ARGB |tint| onto every pixel.
+void ApplyTint(Image* image, uint32_t tint) {
+  uint32_t alpha = tint >> 24;
+  if (alpha == 0) return;
+  const uint32_t color[3] = {(tint >> 16) & 0xFF, (tint >> 8) & 0xFF,
+                             tint & 0xFF};
+  uint8_t* p = image->pixels.data();
+  size_t count = static_cast<size_t>(image->width) * image->height;
+  for (size_t i = 0; i < count; ++i, p += 4) {
+    for (int c = 0; c < 3; ++c) {
+      p[c] = static_cast<uint8_t>(
+          (p[c] * (255 - alpha) + color[c] * alpha + 127) / 255);
+    }
+  }
+}
+
+}  // namespace
+
+bool RenderBlurredBackground(const uint8_t* data, size_t size,
+                             const BackgroundRequest& request,
+                             std::vector<uint8_t>* out) {
+  if (data == nullptr || size == 0 || request.display_width <= 0 ||
+      request.display_height <= 0 || !(request.sigma >= 0)) {
+    return false;
+  }
+  DecodedImage image;
+  if (!DecodeImage(data, size, kMaxWorkingSide, &image) ||
+      image.width == 0 || image.height == 0) {
+    return false;
+  }
+
+  // The part of the image BoxFit.cover would show.
+  double aspect =
+      static_cast<double>(request.display_width) / request.display_height;
+  int crop_width = image.width;
+  int crop_height = image.height;
+  if (image.width > image.height * aspect) {
+    crop_width = std::max(1, static_cast<int>(image.height * aspect));
+  } else {
+    crop_height = std::max(1, static_cast<int>(image.width / aspect));
+  }
+
+  // Working pixels per logical pixel: bounded by the working side, by the
+  // blur and by the crop itself (never upsample before blurring).
+  double scale = static_cast<double>(kMaxWorkingSide) /
+                 std::max(request.display_width, request.display_height);
+  if (request.sigma > 0) {
+    scale = std::min(scale, kWorkingSigma / request.sigma);
+  }
+  scale = std::min(scale,
+                   static_cast<double>(crop_width) / request.display_width);
+  int width = std::clamp(
+      static_cast<int>(std::lround(request.display_width * scale)), 1,
+      crop_width);
+  int height = std::clamp(
+      static_cast<int>(std::lround(request.display_height * scale)), 1,
+      crop_height);
+
+  Image working =
+      Shrink(image, (image.width - crop_width) / 2,
+             (image.height - crop_height) / 2, crop_width, crop_height, width,
+             height);
+  image.pixels = std::vector<uint8_t>();
+  Blur(&working, request.sigma * width / request.display_width);
+  ApplyTint(&working, request.tint);
+  return EncodeJpeg(working.pixels.data(), working.width, working.height,
+                    kJpegQuality, out);
+}
+
+const char* BackgroundBlurKernelName() { return Kernel().name; }
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_background_render(const char* path, const uint8_t* data,
+                                 int64_t length, int32_t display_width,
+                                 int32_t display_height, float sigma,
+                                 uint32_t tint) {
+  if (path == nullptr || length <= 0) return 0;
+  cyrene::BackgroundRequest request;
+  request.display_width = display_width;
+  request.display_height = display_height;
+  request.sigma = sigma;
+  request.tint = tint;
+  std::vector<uint8_t> jpeg;
+  if (!cyrene::RenderBlurredBackground(data, static_cast<size_t>(length),
+                                       request, &jpeg)) {
+    return 0;
+  }
+  return cyrene::WriteFileAtomically(path, jpeg.data(), jpeg.size()) ? 1 : 0;
+}
+
+}  // extern "C"
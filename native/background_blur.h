@@ -0,0 +1,59 @@
+#ifndef CYRENE_NATIVE_BACKGROUND_BLUR_H_
+#define CYRENE_NATIVE_BACKGROUND_BLUR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// Pre-blurred player backgrounds.
+//
+// The player page used to run a Gaussian BackdropFilter over a full-screen
+// image on every frame. This renders the same picture once instead: the
+// image is center-cropped to the display's aspect ratio (as BoxFit.cover
+// shows it), shrunk so the blur is only a few working pixels wide, blurred
+// with three separable box passes (which approximate a Gaussian to within
+// a few percent) and composited with a translucent tint. The result is a
+// small JPEG the page can draw stretched; bilinear upscaling of an image
+// that has no detail left above the blur's cutoff is indistinguishable
+// from blurring at full size.
+struct BackgroundRequest {
+  // Logical size the background is drawn at; only the aspect ratio and the
+  // blur's size relative to it matter.
+  int display_width = 0;
+  int display_height = 0;
+  // Gaussian sigma in logical pixels, as given to ImageFilter.blur.
+  float sigma = 0;
+  // ARGB color composited over the blurred image (alpha 0 for none).
+  uint32_t tint = 0;
+};
+
+// Renders |data| (JPEG or PNG) for |request| as a JPEG into |out|. Returns
+// false if the image cannot be decoded or the request is empty.
+bool RenderBlurredBackground(const uint8_t* data, size_t size,
+                             const BackgroundRequest& request,
+                             std::vector<uint8_t>* out);
+
+// Name of the box blur kernel in use ("avx2", "neon" or "scalar").
+const char* BackgroundBlurKernelName();
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/background_blur_native.dart. Renders the
+// background and writes it to |path| atomically; returns 0 on failure.
+CYRENE_EXPORT int32_t cyrene_background_render(const char* path,
+                                               const uint8_t* data,
+                                               int64_t length,
+                                               int32_t display_width,
+                                               int32_t display_height,
+                                               float sigma, uint32_t tint);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_BACKGROUND_BLUR_H_
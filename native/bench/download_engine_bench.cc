@@ -0,0 +1,138 @@
+// DownloadEngine throughput against a local stand-in CDN.
+//
+// CDNs cap the rate of each connection, which is what the engine's
+// segmented mode works around. The server here throttles every connection
+// to the given rate, and the engine downloads the same track with
+// 1, 2, 4 and 8 connections per task, then several tracks at once, then
+// from a server that ignores ranges (one sequential stream). A last run is
+// unthrottled, to show the engine's own ceiling (pwrite, the per-piece
+// sync and MD5).
+//
+// Reports MB/s, upstream requests and process CPU time per GB.
+//
+//   download_engine_bench [track MiB] [per-connection KiB/s]
+
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "download_engine.h"
+#include "http_test_server.h"
+
+namespace {
+
+using cyrene::DownloadEngine;
+using cyrene::DownloadOptions;
+using cyrene::DownloadProgress;
+using cyrene::DownloadState;
+using cyrene::testing::HttpTestServer;
+using cyrene::testing::TempDirectory;
+using cyrene::testing::TestResource;
+
+double CpuSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) + now.tv_nsec / 1e9;
+}
+
+// Downloads every path in |paths| from |server| into |dir| at once with
+// the given limits and prints a result row. Returns false on a failure.
+bool Run(const char* name, HttpTestServer* server, const TempDirectory& dir,
+         const std::vector<std::string>& paths, int connections,
+         int per_task) {
+  // A fresh engine per run, so no pooled connection carries over.
+  DownloadEngine engine;
+  engine.SetLimits(connections, per_task);
+  int requests_before = server->requests();
+  double cpu_start = CpuSeconds();
+  auto wall_start = std::chrono::steady_clock::now();
+
+  std::vector<int64_t> ids;
+  std::vector<std::string> files;
+  for (const std::string& path : paths) {
+    DownloadOptions options;
+    options.url = server->Url(path);
+    options.path = dir.path() + path;
+    files.push_back(options.path);
+    ids.push_back(engine.Add(options));
+  }
+
+  uint64_t bytes = 0;
+  for (int64_t id : ids) {
+    DownloadProgress progress;
+    while (engine.Progress(id, &progress) &&
+           (progress.state == DownloadState::kQueued ||
+            progress.state == DownloadState::kRunning ||
+            progress.state == DownloadState::kVerifying)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    if (progress.state != DownloadState::kDone) {
+      std::fprintf(stderr, "%s: download failed (HTTP %d)\n", name,
+                   progress.http_status);
+      return false;
+    }
+    bytes += progress.total;
+  }
+
+  std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - wall_start;
+  double cpu = CpuSeconds() - cpu_start;
+  double gigabytes = static_cast<double>(bytes) / 1e9;
+  std::printf("%-22s %8.1f %9d %14.1f\n", name,
+              gigabytes * 1000 / wall.count(),
+              server->requests() - requests_before, cpu * 1000 / gigabytes);
+  for (const std::string& file : files) unlink(file.c_str());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+  uint64_t rate = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2048;
+  if (mib == 0 || rate == 0) {
+    std::fprintf(stderr, "usage: %s [track MiB] [per-connection KiB/s]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::string body(mib << 20, '\0');
+  for (size_t i = 0; i < body.size(); ++i) {
+    body[i] = static_cast<char>((i * 2654435761u) >> 13);
+  }
+  HttpTestServer server;
+  if (!server.Start()) {
+    std::fprintf(stderr, "failed to start the server\n");
+    return 1;
+  }
+  std::vector<std::string> tracks;
+  for (int i = 0; i < 4; ++i) {
+    tracks.push_back("/track" + std::to_string(i) + ".flac");
+    server.Put(tracks.back(), TestResource{body});
+  }
+  TestResource plain{body};
+  plain.ranges = false;
+  server.Put("/plain.flac", plain);
+  TempDirectory dir;
+
+  std::printf("%zu MiB tracks, %llu KiB/s per connection\n", mib,
+              static_cast<unsigned long long>(rate));
+  std::printf("%-22s %8s %9s %14s\n", "run", "MB/s", "requests",
+              "CPU ms per GB");
+  server.set_bytes_per_second(rate * 1024);
+  bool ok = Run("1 track, 1 conn", &server, dir, {tracks[0]}, 1, 1) &&
+            Run("1 track, 2 conns", &server, dir, {tracks[0]}, 2, 2) &&
+            Run("1 track, 4 conns", &server, dir, {tracks[0]}, 4, 4) &&
+            Run("1 track, 8 conns", &server, dir, {tracks[0]}, 8, 8) &&
+            Run("4 tracks, 8 conns", &server, dir, tracks, 8, 4) &&
+            Run("no ranges", &server, dir, {"/plain.flac"}, 8, 8);
+  server.set_bytes_per_second(0);
+  ok = ok && Run("unthrottled, 4 conns", &server, dir, {tracks[0]}, 4, 4);
+  return ok ? 0 : 1;
+}
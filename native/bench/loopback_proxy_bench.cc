@@ -0,0 +1,151 @@
+// Serving a cached track to the player, three ways:
+//
+//   temp file  the old path: decrypt the .cyrene file into a temporary file
+//              (cyrene_file_extract) and read that back, as the player does
+//   decrypt    GET /cache/<id> from the loopback proxy, which decrypts the
+//              .cyrene file chunk by chunk into its send buffer
+//   sendfile   GET /cache/<id> for a track whose plain copy is complete in
+//              the segment cache, sent with sendfile()
+//
+// Reports throughput and the process CPU time (proxy and client threads
+// together) per GB served.
+//
+//   loopback_proxy_bench [track MiB] [rounds]
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cyrene_file.h"
+#include "cyrene_format.h"
+#include "cyrene_writer.h"
+#include "http_test_server.h"
+#include "loopback_proxy.h"
+#include "segment_cache.h"
+#include "upstream_client.h"
+
+namespace {
+
+double CpuSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) + now.tv_nsec / 1e9;
+}
+
+// Runs |serve| |rounds| times; each call must deliver |bytes| bytes.
+void Measure(const char* name, int rounds, uint64_t bytes,
+             const std::function<uint64_t()>& serve) {
+  if (serve() != bytes) {  // Warm-up, and a check that the path works.
+    std::fprintf(stderr, "%s: short or failed response\n", name);
+    std::exit(1);
+  }
+  double cpu_start = CpuSeconds();
+  auto wall_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) serve();
+  std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - wall_start;
+  double cpu = CpuSeconds() - cpu_start;
+  double gigabytes = static_cast<double>(bytes) * rounds / 1e9;
+  std::printf("%-10s %10.0f %14.1f\n", name, gigabytes * 1000 / wall.count(),
+              cpu * 1000 / gigabytes);
+}
+
+uint64_t Download(const std::string& url) {
+  cyrene::UpstreamClient client;
+  uint64_t received = 0;
+  bool ok = client.Get(
+      url, {}, [](const cyrene::UpstreamResponse& response) {
+        return response.status == 200;
+      },
+      [&](const uint8_t*, size_t length) {
+        received += length;
+        return true;
+      });
+  return ok ? received : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+  if (mib == 0 || rounds <= 0) {
+    std::fprintf(stderr, "usage: %s [track MiB] [rounds]\n", argv[0]);
+    return 2;
+  }
+
+  cyrene::testing::TempDirectory dir;
+  std::string segments = dir.path() + "/segments";
+  std::string track_path = dir.path() + "/track.cyrene";
+  std::string temp_path = dir.path() + "/temp_track.mp3";
+
+  std::vector<uint8_t> audio(mib << 20);
+  for (size_t i = 0; i < audio.size(); ++i) {
+    audio[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+  }
+  std::vector<uint8_t> key(32);
+  for (size_t i = 0; i < key.size(); ++i) key[i] = static_cast<uint8_t>(i);
+
+  cyrene::CyreneWriter writer;
+  if (!writer.Open(track_path, key.data(), key.size(), nullptr, 0,
+                   cyrene::format::kDefaultBlockSize) ||
+      !writer.Append(audio.data(), audio.size()) || !writer.Finish()) {
+    std::fprintf(stderr, "failed to write %s\n", track_path.c_str());
+    return 1;
+  }
+  {
+    cyrene::SegmentCache cache(segments, 0);
+    auto entry = cache.Acquire("plain");
+    entry->SetTotalSize(audio.size(), "audio/mpeg");
+    for (uint32_t i = 0; i < entry->segment_count(); ++i) {
+      size_t offset = static_cast<size_t>(i) * cyrene::kSegmentSize;
+      size_t length = std::min<size_t>(cyrene::kSegmentSize,
+                                       audio.size() - offset);
+      entry->WriteSegment(i, audio.data() + offset, length);
+    }
+  }
+
+  cyrene::LoopbackProxy proxy(segments);
+  if (!proxy.Start()) {
+    std::fprintf(stderr, "failed to start the proxy\n");
+    return 1;
+  }
+  proxy.SetCacheLimit(0);
+  proxy.RegisterCacheFile("encrypted", track_path, key, "");
+  proxy.RegisterCacheFile("plain", track_path, key, "plain");
+  std::string base = "http://127.0.0.1:" + std::to_string(proxy.port());
+
+  std::printf("%zu MiB track, %d rounds\n", mib, rounds);
+  std::printf("%-10s %10s %14s\n", "path", "MB/s", "CPU ms per GB");
+
+  Measure("temp file", rounds, audio.size(), [&]() -> uint64_t {
+    if (!cyrene_file_extract(track_path.c_str(), key.data(),
+                             static_cast<int32_t>(key.size()),
+                             temp_path.c_str())) {
+      return 0;
+    }
+    int fd = open(temp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    std::vector<uint8_t> buffer(256 * 1024);
+    uint64_t total = 0;
+    ssize_t count;
+    while ((count = read(fd, buffer.data(), buffer.size())) > 0) {
+      total += static_cast<uint64_t>(count);
+    }
+    close(fd);
+    unlink(temp_path.c_str());
+    return total;
+  });
+  Measure("decrypt", rounds, audio.size(),
+          [&] { return Download(base + "/cache/encrypted"); });
+  Measure("sendfile", rounds, audio.size(),
+          [&] { return Download(base + "/cache/plain"); });
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Lyric parsing and current-line lookup.
+//
+//   lyric_parser_bench [lyric files...]
+//
+// Parses each file (LRC, YRC or QRC, as saved from the music APIs) and
+// reports MB/s over the corpus, then times LyricDocument::LineAt for the
+// two patterns playback produces: position ticks moving forward with the
+// previous index as the hint, and random seeks. Without arguments a
+// synthetic corpus of the same shapes is used: NetEase LRC with a
+// translation, multi-timestamp LRC, and word-timed YRC.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lyric_parser.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Lyric {
+  std::string name;
+  std::string text;
+  std::string translation;
+};
+
+std::string Timestamp(int64_t ms) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "[%02lld:%02lld.%02lld]",
+                static_cast<long long>(ms / 60000),
+                static_cast<long long>(ms / 1000 % 60),
+                static_cast<long long>(ms % 1000 / 10));
+  return buffer;
+}
+
+std::vector<Lyric> SyntheticCorpus() {
+  std::vector<Lyric> corpus;
+  std::mt19937 random(42);
+  // Mixed CJK and Latin lines of typical length.
+  const char* words[] = {"\xE6\x98\x9F\xE5\x85\x89", "\xE5\xA4\x9C\xE7\xA9\xBA",
+                         "love", "tonight", "\xE6\xA2\xA6", "we", "run",
+                         "\xE4\xBD\xA0\xE7\x9A\x84"};
+  auto sentence = [&](int count) {
+    std::string line;
+    for (int i = 0; i < count; ++i) {
+      if (i) line += ' ';
+      line += words[random() % 8];
+    }
+    return line;
+  };
+
+  for (int song = 0; song < 200; ++song) {
+    Lyric lrc{"lrc", "[ar:Artist]\n[ti:Title]\n", ""};
+    Lyric yrc{"yrc", "{\"t\":0,\"c\":[{\"tx\":\"credits\"}]}\n", ""};
+    Lyric repeat{"multi", "", ""};
+    int64_t time = 0;
+    for (int line = 0; line < 60; ++line) {
+      time += 2000 + random() % 3000;
+      lrc.text += Timestamp(time) + sentence(6) + "\n";
+      lrc.translation += Timestamp(time) + sentence(4) + "\n";
+
+      yrc.text += "[" + std::to_string(time) + ",3000]";
+      for (int w = 0; w < 8; ++w) {
+        yrc.text += "(" + std::to_string(time + w * 300) + ",300,0)" +
+                    words[random() % 8] + " ";
+      }
+      yrc.text += "\n";
+      if (line % 3 == 0) {
+        repeat.text += Timestamp(time) + Timestamp(time + 200000) +
+                       Timestamp(time + 400000) + sentence(5) + "\n";
+      }
+    }
+    corpus.push_back(std::move(lrc));
+    corpus.push_back(std::move(yrc));
+    corpus.push_back(std::move(repeat));
+  }
+  return corpus;
+}
+
+double Seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<Lyric> corpus;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      std::fprintf(stderr, "cannot read %s\n", argv[i]);
+      return 1;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    corpus.push_back({argv[i], text.str(), ""});
+  }
+  if (corpus.empty()) corpus = SyntheticCorpus();
+
+  size_t bytes = 0;
+  for (const Lyric& lyric : corpus) {
+    bytes += lyric.text.size() + lyric.translation.size();
+  }
+
+  // Parse the whole corpus repeatedly for a stable figure.
+  const int kParseRounds = 20;
+  size_t lines = 0;
+  Clock::time_point start = Clock::now();
+  for (int round = 0; round < kParseRounds; ++round) {
+    lines = 0;
+    for (const Lyric& lyric : corpus) {
+      lines += cyrene::ParseLyrics(lyric.text, lyric.translation).size();
+    }
+  }
+  double parse = Seconds(start) / kParseRounds;
+  std::printf("%zu lyrics, %zu lines, %.1f KB\n", corpus.size(), lines,
+              bytes / 1024.0);
+  std::printf("parse     %8.1f MB/s  %8.2f us per lyric\n",
+              bytes / parse / 1e6, parse * 1e6 / corpus.size());
+
+  std::vector<cyrene::LyricDocument> documents;
+  for (const Lyric& lyric : corpus) {
+    documents.push_back(cyrene::ParseLyrics(lyric.text, lyric.translation));
+  }
+
+  // Playback: a tick every 16 ms through each song, hinted.
+  size_t lookups = 0;
+  int64_t checksum = 0;
+  start = Clock::now();
+  for (const cyrene::LyricDocument& document : documents) {
+    if (document.size() == 0) continue;
+    int64_t end = document.start_ms.back() + 5000;
+    int hint = -1;
+    for (int64_t position = 0; position < end; position += 16) {
+      hint = document.LineAt(position, hint);
+      checksum += hint;
+      ++lookups;
+    }
+  }
+  double ticks = Seconds(start);
+  std::printf("ticks     %8.1f ns per lookup (hinted, %zu lookups)\n",
+              ticks * 1e9 / lookups, lookups);
+
+  // Seeks: random positions, no hint.
+  std::mt19937 random(7);
+  lookups = 0;
+  start = Clock::now();
+  for (int round = 0; round < 200; ++round) {
+    for (const cyrene::LyricDocument& document : documents) {
+      if (document.size() == 0) continue;
+      int64_t end = document.start_ms.back() + 5000;
+      checksum += document.LineAt(static_cast<int64_t>(random() % end));
+      ++lookups;
+    }
+  }
+  double seeks = Seconds(start);
+  std::printf("seeks     %8.1f ns per lookup (binary search)\n",
+              seeks * 1e9 / lookups);
+  return checksum == 42 ? 1 : 0;  // Keeps the lookups from being elided.
+}
@@ -0,0 +1,139 @@
+// Local search index build and query latency.
+//
+//   search_index_bench [entries]
+//
+// Fills a SearchIndex with |entries| (default 100000) synthetic tracks:
+// Latin titles made of pseudo-words from a large vocabulary, as a big
+// library has, and Han titles and artists with their pinyin. Then times
+// the kinds of query LocalSearchService sends while the user types:
+// exact words, prefixes, typos, pinyin, initials and single letters.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "search_index.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const kOnsets[] = {"b", "c", "d", "f", "g", "h", "j", "k",
+                               "l", "m", "n", "p", "r", "s", "t", "v",
+                               "w", "z", "br", "st", "tr", "sh", "ch"};
+const char* const kVowels[] = {"a", "e", "i", "o", "u", "ai", "ou", "ee"};
+
+std::string PseudoWord(std::mt19937& random) {
+  std::string word;
+  int syllables = 1 + random() % 3;
+  for (int i = 0; i < syllables; ++i) {
+    word += kOnsets[random() % std::size(kOnsets)];
+    word += kVowels[random() % std::size(kVowels)];
+  }
+  if (random() % 2) word += kOnsets[random() % 16];
+  return word;
+}
+
+std::string HanRun(std::mt19937& random, int length) {
+  // Common characters from U+4E00..U+62FF, UTF-8 encoded.
+  std::string run;
+  for (int i = 0; i < length; ++i) {
+    char32_t c = 0x4E00 + random() % 0x1500;
+    run.push_back(static_cast<char>(0xE0 | c >> 12));
+    run.push_back(static_cast<char>(0x80 | (c >> 6 & 0x3F)));
+    run.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+  return run;
+}
+
+double Micros(Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  std::mt19937 random(1);
+
+  std::vector<std::string> vocabulary;
+  for (int i = 0; i < 60000; ++i) vocabulary.push_back(PseudoWord(random));
+  vocabulary.push_back("title");
+  vocabulary.push_back("yesterday");
+
+  struct Track {
+    std::string key;
+    std::string title;
+    std::string artists;
+    std::string album;
+  };
+  std::vector<Track> tracks(count);
+  auto words = [&](int n) {
+    std::string text;
+    for (int i = 0; i < n; ++i) {
+      if (i) text += ' ';
+      text += vocabulary[random() % vocabulary.size()];
+    }
+    return text;
+  };
+  for (size_t i = 0; i < count; ++i) {
+    Track& track = tracks[i];
+    track.key = "track:" + std::to_string(i);
+    if (i % 3 == 0) {
+      track.title = HanRun(random, 2 + random() % 4);
+      track.artists = HanRun(random, 3);
+      track.album = HanRun(random, 4);
+    } else {
+      track.title = words(1 + random() % 4);
+      track.artists = words(2);
+      track.album = words(1 + random() % 3);
+    }
+  }
+  tracks[7].title = "Title Track";
+  tracks[8].title = "Yesterday Once More";
+  tracks[9].artists = "\xE5\x91\xA8\xE6\x9D\xB0\xE4\xBC\xA6";  // 周杰伦
+
+  cyrene::SearchIndex index;
+  Clock::time_point start = Clock::now();
+  const size_t kBatch = 2000;
+  std::vector<std::string_view> keys;
+  std::vector<cyrene::IndexEntry> entries;
+  for (size_t i = 0; i < count; i += kBatch) {
+    keys.clear();
+    entries.clear();
+    for (size_t j = i; j < std::min(count, i + kBatch); ++j) {
+      keys.push_back(tracks[j].key);
+      entries.push_back({tracks[j].title, tracks[j].artists,
+                         tracks[j].album, 0});
+    }
+    index.PutBatch(keys.data(), entries.data(), keys.size());
+  }
+  std::printf("%zu entries indexed in %.0f ms\n\n", count,
+              Micros(Clock::now() - start) / 1000);
+
+  const char* queries[] = {
+      "title",      "tit",     "tilte",   "yesterdya", "title trakc",
+      "zhoujielun", "zjl",     "t",       "z",
+      "\xE5\x91\xA8\xE6\x9D\xB0\xE4\xBC\xA6",
+  };
+  std::printf("%-14s %6s %10s %10s\n", "query", "hits", "median us",
+              "p99 us");
+  const int kRuns = 200;
+  for (const char* query : queries) {
+    std::vector<double> times;
+    size_t hits = 0;
+    for (int run = 0; run < kRuns; ++run) {
+      Clock::time_point begin = Clock::now();
+      hits = index.Search(query, 50).size();
+      times.push_back(Micros(Clock::now() - begin));
+    }
+    std::sort(times.begin(), times.end());
+    std::printf("%-14s %6zu %10.1f %10.1f\n", query, hits,
+                times[kRuns / 2], times[kRuns * 99 / 100]);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "cache_ingest.h"
+
+#include <openssl/evp.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "cyrene_format.h"
+#include "cyrene_writer.h"
+#include "http_util.h"
+#include "upstream_client.h"
+
+namespace cyrene {
+
+bool IngestToCache(UpstreamClient* client, const std::string& url,
+                   const std::string& path, const uint8_t* key,
+                   size_t key_length, const uint8_t* metadata,
+                   size_t metadata_length, const std::string& expected_md5,
+                   IngestResult* result) {
+  *result = IngestResult();
+  std::unique_ptr<EVP_MD_CTX, DigestDeleter> digest(EVP_MD_CTX_new());
+  if (!digest || EVP_DigestInit_ex(digest.get(), EVP_md5(), nullptr) != 1) {
+    return false;
+  }
+
+  CyreneWriter writer;
+  bool opened = false;
+  bool failed = false;
+  uint64_t expected = 0;
+  uint64_t received = 0;
+
+  auto on_head = [&](const UpstreamResponse& response) {
+    result->status = response.status;
+    if (response.status != 200) return false;
+    if (const std::string* length = response.Header("content-length")) {
+      expected = std::strtoull(length->c_str(), nullptr, 10);
+    }
+    // Opened only now, so an error status never creates a .part file.
+    opened = writer.Open(path, key, key_length, metadata, metadata_length,
+                         format::kDefaultBlockSize);
+    return opened;
+  };
+  auto on_body = [&](const uint8_t* data, size_t length) {
+    if (EVP_DigestUpdate(digest.get(), data, length) != 1 ||
+        !writer.Append(data, length)) {
+      failed = true;
+      return false;
+    }
+    received += length;
+    return true;
+  };
+
+  UpstreamClient::Headers headers = {{"User-Agent", kUpstreamUserAgent}};
+  bool fetched = client->Get(url, headers, on_head, on_body);
+  result->size = received;
+  if (!fetched || !opened || failed ||
+      (expected > 0 && received != expected)) {
+    writer.Abort();
+    return false;
+  }
+
+  uint8_t md5[EVP_MAX_MD_SIZE];
+  unsigned int md5_length = 0;
+  if (EVP_DigestFinal_ex(digest.get(), md5, &md5_length) != 1) {
+    writer.Abort();
+    return false;
+  }
+  result->md5 = Hex(md5, md5_length);
+  if (!expected_md5.empty() && ToLower(expected_md5) != result->md5) {
+    writer.Abort();
+    return false;
+  }
+  return writer.Finish();
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_cache_ingest(const char* url, const char* path,
+                            const uint8_t* key, int32_t key_length,
+                            const uint8_t* metadata, int32_t metadata_length,
+                            const char* expected_md5, int64_t* out,
+                            char* md5_hex) {
+  if (url == nullptr || path == nullptr || key_length < 0 ||
+      metadata_length < 0 || out == nullptr || md5_hex == nullptr) {
+    return 0;
+  }
+  static cyrene::UpstreamClient client;
+  cyrene::IngestResult result;
+  bool ok = cyrene::IngestToCache(
+      &client, url, path, key, static_cast<size_t>(key_length), metadata,
+      static_cast<size_t>(metadata_length),
+      expected_md5 ? expected_md5 : "", &result);
+  out[0] = result.status;
+  out[1] = static_cast<int64_t>(result.size);
+  if (!ok) return 0;
+  std::memcpy(md5_hex, result.md5.c_str(), result.md5.size() + 1);
+  return 1;
+}
+
+}  // extern "C"
@@ -0,0 +1,57 @@
+#ifndef CYRENE_NATIVE_CACHE_INGEST_H_
+#define CYRENE_NATIVE_CACHE_INGEST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+class UpstreamClient;
+
+struct IngestResult {
+  int status = 0;    // Final HTTP status, 0 if no response arrived.
+  uint64_t size = 0;  // Plain audio bytes stored.
+  std::string md5;    // Lower-case hex digest of those bytes.
+};
+
+// Downloads |url| straight into a .cyrene file at |path|: v3 (AES-CTR)
+// when |key| is 16 or 32 bytes, v2 (XOR with |key|) otherwise, as chosen by
+// CyreneWriter::Open().
+//
+// The body is never held whole: each piece the client reads is fed to an
+// incremental MD5 and to CyreneWriter, which encrypts and writes a block at
+// a time into "<path>.part" and renames it into place once everything is
+// on disk. Memory per call is one writer block plus one socket read,
+// whatever the size of the track. Returns false, leaving no file behind,
+// on a non-200 status, a network error, a body shorter than its
+// Content-Length or, when |expected_md5| (hex, any case) is not empty, a
+// digest that differs from it; |result| still has the digest computed.
+bool IngestToCache(UpstreamClient* client, const std::string& url,
+                   const std::string& path, const uint8_t* key,
+                   size_t key_length, const uint8_t* metadata,
+                   size_t metadata_length, const std::string& expected_md5,
+                   IngestResult* result);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/cache_ingest_native.dart. Blocks until the
+// download finishes; call it off the UI isolate. Requests share one pooled
+// client. |expected_md5| may be null. Writes the HTTP status and the stored
+// size to out[0..1] and the MD5 as 32 hex digits plus a terminator to
+// |md5_hex|, and returns 1 on success.
+CYRENE_EXPORT int32_t cyrene_cache_ingest(const char* url, const char* path,
+                                          const uint8_t* key,
+                                          int32_t key_length,
+                                          const uint8_t* metadata,
+                                          int32_t metadata_length,
+                                          const char* expected_md5,
+                                          int64_t* out, char* md5_hex);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_CACHE_INGEST_H_
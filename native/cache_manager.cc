@@ -0,0 +1,583 @@
+#include "cache_manager.h"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "cyrene_format.h"
+
+namespace cyrene {
+
+namespace {
+
+constexpr char kStoreName[] = "cache_access.store";
+constexpr char kSongSuffix[] = ".cyrene";
+// CacheService's old JSON index shares the suffix.
+constexpr char kLegacyIndexName[] = "cache_index.cyrene";
+// Store key of ARC's target size for T1; song keys never start with '#'.
+constexpr char kTargetKey[] = "#arc_target";
+
+// u8 list | u8[3] 0 | u32 plays | u64 last access | u64 size
+constexpr size_t kRecordSize = 24;
+
+constexpr double kPlayHalfLifeMs = 14.0 * 24 * 3600 * 1000;
+
+constexpr auto kCheckpointInterval = std::chrono::seconds(5);
+constexpr auto kFirstSweepDelay = std::chrono::minutes(1);
+constexpr auto kSweepInterval = std::chrono::hours(6);
+// Files untouched for this long are no longer being written or played.
+constexpr int64_t kPartFileAge = 3600;
+constexpr int64_t kTempFileAge = 12 * 3600;
+
+// IOPRIO_WHO_PROCESS and IOPRIO_CLASS_IDLE from <linux/ioprio.h>.
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioIdle = 3 << 13;
+
+uint64_t NowMs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+bool StartsWith(const std::string& s, const char* prefix) {
+  return !s.compare(0, std::strlen(prefix), prefix);
+}
+
+bool EndsWith(const std::string& s, const char* suffix) {
+  size_t n = std::strlen(suffix);
+  return s.size() >= n && !s.compare(s.size() - n, n, suffix);
+}
+
+std::string SourceOf(const std::string& key) {
+  return key.substr(0, key.find('_'));
+}
+
+// Deletes the files in |directory| accepted by |orphan| that belong to this
+// user and have not been modified for |age| seconds.
+template <typename Predicate>
+void RemoveStale(const std::string& directory, int64_t age, Predicate orphan,
+                 uint64_t* count, uint64_t* bytes) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) return;
+  time_t now = time(nullptr);
+  while (dirent* item = readdir(dir)) {
+    std::string name = item->d_name;
+    if (!orphan(name)) continue;
+    std::string path = directory + "/" + name;
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || now - st.st_mtime < age) {
+      continue;
+    }
+    if (unlink(path.c_str()) == 0) {
+      ++*count;
+      *bytes += static_cast<uint64_t>(st.st_size);
+    }
+  }
+  closedir(dir);
+}
+
+}  // namespace
+
+CacheManager::CacheManager(std::string directory, std::string temp_directory)
+    : directory_(std::move(directory)),
+      temp_directory_(std::move(temp_directory)),
+      t1_target_(0),
+      budget_(0),
+      policy_(EvictionPolicy::kLru),
+      dirty_(false),
+      open_(false),
+      stopping_(false) {}
+
+CacheManager::~CacheManager() { Close(); }
+
+bool CacheManager::Open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (open_) return true;
+  if (!store_.Open(directory_ + "/" + kStoreName)) return false;
+  // Private to this user; does nothing if it exists already.
+  mkdir(temp_directory_.c_str(), 0700);
+
+  entries_.clear();
+  source_counts_.clear();
+  std::fill(std::begin(list_bytes_), std::end(list_bytes_), 0);
+  stats_ = CacheManagerStats();
+  t1_target_ = 0;
+
+  size_t length = 0;
+  const uint8_t* data = store_.Entries(&length);
+  for (size_t at = 0; at + 4 <= length;) {
+    uint32_t key_length = format::ReadU32(data + at);
+    std::string key(reinterpret_cast<const char*>(data + at + 4), key_length);
+    at += 4 + key_length;
+    uint32_t value_length = format::ReadU32(data + at);
+    const uint8_t* value = data + at + 4;
+    at += 4 + value_length;
+
+    if (key == kTargetKey && value_length == 8) {
+      t1_target_ = format::ReadU64(value);
+    } else if (value_length == kRecordSize && value[0] <= kB2) {
+      Entry entry;
+      entry.list = static_cast<List>(value[0]);
+      entry.plays = format::ReadU32(value + 4);
+      entry.last_access = format::ReadU64(value + 8);
+      entry.size = format::ReadU64(value + 16);
+      entries_.emplace(std::move(key), entry);
+    }
+  }
+
+  // The files on disk are the truth: adopt songs cached without a record
+  // (an older version, or a crash before the record was written) and drop
+  // records of songs deleted behind our back.
+  std::unordered_map<std::string, Entry> on_disk;
+  if (DIR* dir = opendir(directory_.c_str())) {
+    while (dirent* item = readdir(dir)) {
+      std::string name = item->d_name;
+      if (name[0] == '.' || !EndsWith(name, kSongSuffix) ||
+          name == kLegacyIndexName) {
+        continue;
+      }
+      struct stat st;
+      if (stat((directory_ + "/" + name).c_str(), &st) != 0 ||
+          !S_ISREG(st.st_mode)) {
+        continue;
+      }
+      Entry entry;
+      entry.plays = 1;
+      entry.last_access = static_cast<uint64_t>(st.st_mtime) * 1000;
+      entry.size = static_cast<uint64_t>(st.st_size);
+      on_disk.emplace(name.substr(0, name.size() - std::strlen(kSongSuffix)),
+                      entry);
+    }
+    closedir(dir);
+  }
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.list <= kT2 && !on_disk.count(it->first)) {
+      store_.Delete(it->first);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const auto& [key, found] : on_disk) {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.list > kT2) {
+      entries_[key] = found;
+      Store(key, found);
+    } else if (it->second.size != found.size) {
+      it->second.size = found.size;
+      Store(key, it->second);
+    }
+  }
+  for (const auto& [key, entry] : entries_) Account(key, entry, 1);
+
+  open_ = true;
+  stopping_ = false;
+  thread_ = std::thread(&CacheManager::Run, this);
+  return true;
+}
+
+void CacheManager::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) return;
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  store_.Checkpoint();
+  store_.Close();
+  entries_.clear();
+  open_ = false;
+}
+
+void CacheManager::Insert(const std::string& key) {
+  struct stat st;
+  if (stat((directory_ + "/" + key + kSongSuffix).c_str(), &st) != 0) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_) return;
+  Entry entry;
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    entry = it->second;
+    Account(key, entry, -1);
+  }
+  uint64_t size = static_cast<uint64_t>(st.st_size);
+
+  if (it == entries_.end()) {
+    entry.list = kT1;
+    entry.plays = 0;
+  } else if (entry.list == kB1 || entry.list == kB2) {
+    // A ghost hit: the list that lost this song was too small. Move the
+    // target towards it by the song's size, more when the other ghost list
+    // is the larger one.
+    uint64_t b1 = std::max<uint64_t>(list_bytes_[kB1], 1);
+    uint64_t b2 = std::max<uint64_t>(list_bytes_[kB2], 1);
+    if (entry.list == kB1) {
+      uint64_t delta = std::max(size, size * b2 / b1);
+      t1_target_ = budget_ == 0 ? t1_target_ + delta
+                                : std::min(budget_, t1_target_ + delta);
+    } else {
+      uint64_t delta = std::max(size, size * b1 / b2);
+      t1_target_ = t1_target_ - std::min(t1_target_, delta);
+    }
+    uint8_t value[8];
+    format::WriteU64(value, t1_target_);
+    store_.Put(kTargetKey, std::string_view(reinterpret_cast<char*>(value), 8));
+    entry.list = kT2;
+  } else {
+    entry.list = kT2;
+  }
+  entry.plays++;
+  entry.last_access = NowMs();
+  entry.size = size;
+
+  entries_[key] = entry;
+  Account(key, entry, 1);
+  Store(key, entry);
+  last_touched_ = key;
+}
+
+void CacheManager::Touch(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end() || it->second.list > kT2) return;
+
+  Entry& entry = it->second;
+  Account(key, entry, -1);
+  entry.list = kT2;
+  entry.plays++;
+  entry.last_access = NowMs();
+  Account(key, entry, 1);
+  Store(key, entry);
+  last_touched_ = key;
+}
+
+void CacheManager::Erase(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.count(key)) Forget(key);
+}
+
+void CacheManager::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_) return;
+  entries_.clear();
+  source_counts_.clear();
+  std::fill(std::begin(list_bytes_), std::end(list_bytes_), 0);
+  stats_.bytes = 0;
+  stats_.count = 0;
+  t1_target_ = 0;
+  last_touched_.clear();
+  store_.Clear();
+  dirty_ = true;
+}
+
+void CacheManager::SetBudget(uint64_t bytes, EvictionPolicy policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = bytes;
+  policy_ = policy;
+  if (budget_ > 0) t1_target_ = std::min(t1_target_, budget_);
+}
+
+std::vector<std::string> CacheManager::Evict() {
+  std::vector<std::string> evicted;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_ || budget_ == 0) return evicted;
+
+  std::string key;
+  while (list_bytes_[kT1] + list_bytes_[kT2] > budget_ && PickVictim(&key)) {
+    std::string path = directory_ + "/" + key + kSongSuffix;
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) break;
+
+    Entry& entry = entries_[key];
+    Account(key, entry, -1);
+    entry.list = entry.list == kT1 ? kB1 : kB2;
+    Account(key, entry, 1);
+    Store(key, entry);
+    stats_.evicted_count++;
+    stats_.evicted_bytes += entry.size;
+    evicted.push_back(key);
+  }
+  TrimGhosts();
+  return evicted;
+}
+
+CacheManagerStats CacheManager::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+uint64_t CacheManager::SourceCount(const std::string& source) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = source_counts_.find(source);
+  return it == source_counts_.end() ? 0 : it->second;
+}
+
+void CacheManager::Account(const std::string& key, const Entry& entry,
+                           int sign) {
+  list_bytes_[entry.list] += sign * entry.size;
+  if (entry.list > kT2) return;
+  stats_.bytes += sign * entry.size;
+  stats_.count += sign;
+  uint64_t& count = source_counts_[SourceOf(key)];
+  count += sign;
+}
+
+void CacheManager::Store(const std::string& key, const Entry& entry) {
+  uint8_t value[kRecordSize] = {0};
+  value[0] = entry.list;
+  format::WriteU32(value + 4, entry.plays);
+  format::WriteU64(value + 8, entry.last_access);
+  format::WriteU64(value + 16, entry.size);
+  store_.Put(key, std::string_view(reinterpret_cast<char*>(value),
+                                   kRecordSize));
+  dirty_ = true;
+}
+
+void CacheManager::Forget(const std::string& key) {
+  auto it = entries_.find(key);
+  Account(key, it->second, -1);
+  entries_.erase(it);
+  store_.Delete(key);
+  dirty_ = true;
+}
+
+bool CacheManager::PickVictim(std::string* key) {
+  const uint64_t now = NowMs();
+  const std::string* oldest = nullptr;
+  const std::string* oldest_in[2] = {nullptr, nullptr};
+  const std::string* least_played = nullptr;
+  uint64_t oldest_time = UINT64_MAX;
+  uint64_t oldest_time_in[2] = {UINT64_MAX, UINT64_MAX};
+  uint64_t least_played_time = UINT64_MAX;
+  double least_score = HUGE_VAL;
+
+  for (const auto& [candidate, entry] : entries_) {
+    if (entry.list > kT2 || candidate == last_touched_) continue;
+    if (entry.last_access < oldest_time) {
+      oldest_time = entry.last_access;
+      oldest = &candidate;
+    }
+    if (entry.last_access < oldest_time_in[entry.list]) {
+      oldest_time_in[entry.list] = entry.last_access;
+      oldest_in[entry.list] = &candidate;
+    }
+    double age = now > entry.last_access
+                     ? static_cast<double>(now - entry.last_access)
+                     : 0.0;
+    double score = entry.plays * std::exp2(-age / kPlayHalfLifeMs);
+    if (score < least_score ||
+        (score == least_score && entry.last_access < least_played_time)) {
+      least_score = score;
+      least_played_time = entry.last_access;
+      least_played = &candidate;
+    }
+  }
+
+  const std::string* victim = nullptr;
+  switch (policy_) {
+    case EvictionPolicy::kLru:
+      victim = oldest;
+      break;
+    case EvictionPolicy::kLfu:
+      victim = least_played;
+      break;
+    case EvictionPolicy::kArc: {
+      bool from_t1 = oldest_in[kT2] == nullptr ||
+                     (oldest_in[kT1] != nullptr &&
+                      list_bytes_[kT1] > t1_target_);
+      victim = oldest_in[from_t1 ? kT1 : kT2];
+      break;
+    }
+  }
+  if (victim == nullptr) return false;
+  *key = *victim;
+  return true;
+}
+
+void CacheManager::TrimGhosts() {
+  // As in ARC: T1 and B1 together hold at most one budget of songs, and
+  // everything tracked at most two.
+  auto drop_oldest = [this](List list) {
+    const std::string* oldest = nullptr;
+    uint64_t oldest_time = UINT64_MAX;
+    for (const auto& [key, entry] : entries_) {
+      if (entry.list == list && entry.last_access < oldest_time) {
+        oldest_time = entry.last_access;
+        oldest = &key;
+      }
+    }
+    if (oldest == nullptr) return false;
+    Forget(std::string(*oldest));
+    return true;
+  };
+  while (list_bytes_[kT1] + list_bytes_[kB1] > budget_ && drop_oldest(kB1)) {
+  }
+  while (list_bytes_[kT1] + list_bytes_[kT2] + list_bytes_[kB1] +
+                 list_bytes_[kB2] >
+             2 * budget_ &&
+         drop_oldest(kB2)) {
+  }
+}
+
+void CacheManager::Run() {
+  // Bookkeeping and sweeping never compete with playback or the UI.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+  syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioIdle);
+
+  auto next_sweep = std::chrono::steady_clock::now() + kFirstSweepDelay;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    cv_.wait_for(lock, kCheckpointInterval, [this] { return stopping_; });
+    if (stopping_) break;
+    if (dirty_) {
+      dirty_ = false;
+      store_.Checkpoint();
+    }
+    if (std::chrono::steady_clock::now() >= next_sweep) {
+      lock.unlock();
+      Sweep();
+      lock.lock();
+      next_sweep = std::chrono::steady_clock::now() + kSweepInterval;
+    }
+  }
+}
+
+void CacheManager::Sweep() {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  // "<key>.cyrene.part" from a download that never finished.
+  RemoveStale(
+      directory_, kPartFileAge,
+      [](const std::string& name) { return EndsWith(name, ".part"); }, &count,
+      &bytes);
+  // Decrypted copies (see CacheService.getCachedFilePath), only
+  // in a directory of our own: never sweep a shared /tmp or a directory
+  // someone else created under the same name.
+  struct stat st;
+  bool own_temp = lstat(temp_directory_.c_str(), &st) == 0 &&
+                  S_ISDIR(st.st_mode) && st.st_uid == geteuid() &&
+                  (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+  if (own_temp) {
+    RemoveStale(
+        temp_directory_, kTempFileAge,
+        [](const std::string& name) {
+          return StartsWith(name, "temp_") && EndsWith(name, ".mp3");
+        },
+        &count, &bytes);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.swept_count += count;
+  stats_.swept_bytes += bytes;
+}
+
+}  // namespace cyrene
+
+namespace {
+
+// The manager plus the buffer cyrene_cache_manager_evict() hands out.
+struct CacheManagerHandle {
+  CacheManagerHandle(const char* directory, const char* temp_directory)
+      : manager(directory, temp_directory) {}
+
+  cyrene::CacheManager manager;
+  std::string evicted;
+};
+
+cyrene::CacheManager* ManagerOf(void* handle) {
+  return handle != nullptr
+             ? &static_cast<CacheManagerHandle*>(handle)->manager
+             : nullptr;
+}
+
+}  // namespace
+
+extern "C" {
+
+void* cyrene_cache_manager_open(const char* directory,
+                                const char* temp_directory) {
+  if (directory == nullptr || temp_directory == nullptr) return nullptr;
+  auto* handle = new CacheManagerHandle(directory, temp_directory);
+  if (!handle->manager.Open()) {
+    delete handle;
+    return nullptr;
+  }
+  return handle;
+}
+
+void cyrene_cache_manager_close(void* handle) {
+  delete static_cast<CacheManagerHandle*>(handle);
+}
+
+void cyrene_cache_manager_insert(void* handle, const char* key) {
+  if (auto* manager = ManagerOf(handle); manager && key) manager->Insert(key);
+}
+
+void cyrene_cache_manager_touch(void* handle, const char* key) {
+  if (auto* manager = ManagerOf(handle); manager && key) manager->Touch(key);
+}
+
+void cyrene_cache_manager_erase(void* handle, const char* key) {
+  if (auto* manager = ManagerOf(handle); manager && key) manager->Erase(key);
+}
+
+void cyrene_cache_manager_clear(void* handle) {
+  if (auto* manager = ManagerOf(handle)) manager->Clear();
+}
+
+void cyrene_cache_manager_set_budget(void* handle, int64_t bytes,
+                                     int32_t policy) {
+  auto* manager = ManagerOf(handle);
+  if (manager == nullptr || policy < 0 ||
+      policy > static_cast<int32_t>(cyrene::EvictionPolicy::kArc)) {
+    return;
+  }
+  manager->SetBudget(bytes > 0 ? static_cast<uint64_t>(bytes) : 0,
+                     static_cast<cyrene::EvictionPolicy>(policy));
+}
+
+const char* cyrene_cache_manager_evict(void* handle, int64_t* length) {
+  if (length != nullptr) *length = 0;
+  if (handle == nullptr) return nullptr;
+  auto* state = static_cast<CacheManagerHandle*>(handle);
+  state->evicted.clear();
+  for (const std::string& key : state->manager.Evict()) {
+    state->evicted += key;
+    state->evicted.push_back('\0');
+  }
+  if (length != nullptr) *length = static_cast<int64_t>(state->evicted.size());
+  return state->evicted.data();
+}
+
+void cyrene_cache_manager_stats(void* handle, int64_t* out) {
+  auto* manager = ManagerOf(handle);
+  if (manager == nullptr || out == nullptr) return;
+  cyrene::CacheManagerStats stats = manager->Stats();
+  out[0] = static_cast<int64_t>(stats.bytes);
+  out[1] = static_cast<int64_t>(stats.count);
+  out[2] = static_cast<int64_t>(stats.evicted_count);
+  out[3] = static_cast<int64_t>(stats.evicted_bytes);
+  out[4] = static_cast<int64_t>(stats.swept_count);
+  out[5] = static_cast<int64_t>(stats.swept_bytes);
+}
+
+int64_t cyrene_cache_manager_source_count(void* handle, const char* source) {
+  auto* manager = ManagerOf(handle);
+  if (manager == nullptr || source == nullptr) return 0;
+  return static_cast<int64_t>(manager->SourceCount(source));
+}
+
+}  // extern "C"
@@ -0,0 +1,162 @@
+#ifndef CYRENE_NATIVE_CACHE_MANAGER_H_
+#define CYRENE_NATIVE_CACHE_MANAGER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "native_export.h"
+#include "record_store.h"
+
+namespace cyrene {
+
+enum class EvictionPolicy : int32_t {
+  kLru = 0,  // Least recently played first.
+  kLfu = 1,  // Fewest plays first, plays decaying with a 14-day half-life.
+  kArc = 2,  // Adaptive replacement, balancing recency against frequency.
+};
+
+struct CacheManagerStats {
+  uint64_t bytes = 0;  // On disk, over every cached song.
+  uint64_t count = 0;
+  uint64_t evicted_count = 0;  // Since Open().
+  uint64_t evicted_bytes = 0;
+  uint64_t swept_count = 0;  // Orphaned files removed since Open().
+  uint64_t swept_bytes = 0;
+};
+
+// Size-bounded bookkeeping for the song cache ("<directory>/<key>.cyrene",
+// keys "<source>_<id>").
+//
+// Opening scans the directory once; after that the caller reports every
+// change (Insert, Touch, Erase) and the totals are kept as running counters.
+// Per-song recency, play count and ARC list membership live in a RecordStore
+// ("<directory>/cache_access.store"), one small record per change.
+//
+// Evict() removes songs, by the configured policy, until the cache fits its
+// byte budget. All policies share one model: songs played once sit in T1,
+// songs played again in T2, and evicted songs leave a ghost (key and size)
+// in B1 or B2. Under ARC a song cached again while its ghost is in B1 grows
+// T1's target share, one in B2 shrinks it, and the victim comes from
+// whichever list is over its share. The song touched last is never evicted,
+// since it is the one playing. Victims are found by scanning, which costs
+// well under a millisecond for the few thousand songs a cache holds.
+//
+// A background thread at idle CPU and I/O priority checkpoints the store
+// and, some time after opening and then every few hours, removes ".part"
+// files left in the cache by interrupted downloads and "temp_*.mp3" files
+// left in |temp_directory| by interrupted playback, once they are old
+// enough not to be in use. |temp_directory| is
+// the app's own (created 0700 by Open() if missing), never a shared /tmp:
+// it is only swept when it is a directory owned by this user that no one
+// else can write to.
+//
+// All methods are thread-safe.
+class CacheManager {
+ public:
+  CacheManager(std::string directory, std::string temp_directory);
+  ~CacheManager();
+
+  CacheManager(const CacheManager&) = delete;
+  CacheManager& operator=(const CacheManager&) = delete;
+
+  bool Open();
+  void Close();
+
+  // Records the song just written to "<key>.cyrene" (its size is read from
+  // disk). Caching a song again counts as playing it.
+  void Insert(const std::string& key);
+
+  // Records a play of a cached song.
+  void Touch(const std::string& key);
+
+  // Forgets a song whose file the caller has deleted.
+  void Erase(const std::string& key);
+  void Clear();
+
+  // |bytes| 0 removes the limit.
+  void SetBudget(uint64_t bytes, EvictionPolicy policy);
+
+  // Deletes songs until the cache fits its budget and returns their keys.
+  std::vector<std::string> Evict();
+
+  CacheManagerStats Stats() const;
+
+  // Number of cached songs whose key starts with "<source>_".
+  uint64_t SourceCount(const std::string& source) const;
+
+ private:
+  enum List : uint8_t { kT1 = 0, kT2 = 1, kB1 = 2, kB2 = 3 };
+
+  struct Entry {
+    List list = kT1;
+    uint32_t plays = 0;
+    uint64_t last_access = 0;  // Unix milliseconds.
+    uint64_t size = 0;
+  };
+
+  void Run();
+  void Sweep();
+
+  // Called with |mutex_| held.
+  void Account(const std::string& key, const Entry& entry, int sign);
+  void Store(const std::string& key, const Entry& entry);
+  void Forget(const std::string& key);
+  bool PickVictim(std::string* key);
+  void TrimGhosts();
+
+  const std::string directory_;
+  const std::string temp_directory_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  RecordStore store_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::unordered_map<std::string, uint64_t> source_counts_;
+  uint64_t list_bytes_[4] = {0, 0, 0, 0};
+  uint64_t t1_target_;  // ARC's "p", in bytes.
+  uint64_t budget_;
+  EvictionPolicy policy_;
+  std::string last_touched_;
+  CacheManagerStats stats_;
+  bool dirty_;
+  bool open_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/cache_manager_native.dart. Handles from
+// cyrene_cache_manager_open() (null on failure) are released with
+// cyrene_cache_manager_close().
+CYRENE_EXPORT void* cyrene_cache_manager_open(const char* directory,
+                                              const char* temp_directory);
+CYRENE_EXPORT void cyrene_cache_manager_close(void* handle);
+CYRENE_EXPORT void cyrene_cache_manager_insert(void* handle, const char* key);
+CYRENE_EXPORT void cyrene_cache_manager_touch(void* handle, const char* key);
+CYRENE_EXPORT void cyrene_cache_manager_erase(void* handle, const char* key);
+CYRENE_EXPORT void cyrene_cache_manager_clear(void* handle);
+CYRENE_EXPORT void cyrene_cache_manager_set_budget(void* handle, int64_t bytes,
+                                                   int32_t policy);
+
+// Evicts as CacheManager::Evict() and returns the keys, each followed by a
+// NUL, in |length| bytes. The buffer stays valid until the next call.
+CYRENE_EXPORT const char* cyrene_cache_manager_evict(void* handle,
+                                                     int64_t* length);
+
+// Writes the CacheManagerStats fields, in order, to out[0..5].
+CYRENE_EXPORT void cyrene_cache_manager_stats(void* handle, int64_t* out);
+CYRENE_EXPORT int64_t cyrene_cache_manager_source_count(void* handle,
+                                                        const char* source);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_CACHE_MANAGER_H_
@@ -0,0 +1,104 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define CYRENE_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CYRENE_CRC32C_ARMV8 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+// Reflected Castagnoli polynomial.
+constexpr uint32_t kPolynomial = 0x82F63B78u;
+
+struct Table {
+  uint32_t entries[256];
+
+  Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ ((crc & 1u) ? kPolynomial : 0u);
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+uint32_t Crc32cTable(const uint8_t* data, size_t length, uint32_t crc) {
+  static const Table table;
+  for (size_t i = 0; i < length; ++i) {
+    crc = table.entries[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(CYRENE_CRC32C_SSE42)
+
+__attribute__((target("sse4.2"))) uint32_t Crc32cSse42(const uint8_t* data,
+                                                       size_t length,
+                                                       uint32_t crc) {
+  uint64_t crc64 = crc;
+  while (length >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    length -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (length > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+    --length;
+  }
+  return crc;
+}
+
+bool HasSse42() {
+  static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+  }();
+  return supported;
+}
+
+#endif  // CYRENE_CRC32C_SSE42
+
+#if defined(CYRENE_CRC32C_ARMV8)
+
+uint32_t Crc32cArmv8(const uint8_t* data, size_t length, uint32_t crc) {
+  while (length >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    length -= 8;
+  }
+  while (length > 0) {
+    crc = __crc32cb(crc, *data++);
+    --length;
+  }
+  return crc;
+}
+
+#endif  // CYRENE_CRC32C_ARMV8
+
+}  // namespace
+
+uint32_t Crc32c(const uint8_t* data, size_t length, uint32_t crc) {
+  crc = ~crc;
+#if defined(CYRENE_CRC32C_SSE42)
+  if (HasSse42()) return ~Crc32cSse42(data, length, crc);
+#elif defined(CYRENE_CRC32C_ARMV8)
+  return ~Crc32cArmv8(data, length, crc);
+#endif
+  return ~Crc32cTable(data, length, crc);
+}
+
+}  // namespace cyrene
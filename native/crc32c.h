@@ -0,0 +1,18 @@
+#ifndef CYRENE_NATIVE_CRC32C_H_
+#define CYRENE_NATIVE_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cyrene {
+
+// CRC-32C (Castagnoli), as used by the .cyrene v2 block index.
+//
+// Uses the SSE4.2 crc32 instruction on x86-64 and the ARMv8 CRC extension
+// when the compiler targets it, with a table-driven fallback otherwise.
+// Pass the previous return value as |crc| to checksum data incrementally.
+uint32_t Crc32c(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_CRC32C_H_
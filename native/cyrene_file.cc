@@ -0,0 +1,347 @@
+#include "cyrene_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "crc32c.h"
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// Chunk size used when extracting a payload to a plain file.
+constexpr size_t kExtractChunkSize = 1 << 20;
+
+enum BlockState : uint8_t {
+  kUnchecked = 0,
+  kIntact = 1,
+  kBroken = 2,
+};
+
+}  // namespace
+
+CyreneFile::CyreneFile()
+    : data_(nullptr),
+      size_(0),
+      version_(0),
+      metadata_offset_(0),
+      metadata_length_(0),
+      audio_offset_(0),
+      audio_size_(0),
+      block_size_(0),
+      nonce_() {}
+
+CyreneFile::~CyreneFile() {
+  Close();
+}
+
+bool CyreneFile::Open(const std::string& path, const uint8_t* key,
+                      size_t key_length) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(format::kV1HeaderSize)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  data_ = static_cast<const uint8_t*>(mapped);
+  size_ = size;
+
+  // A v1 header starting with the v2 magic would claim ~1.1 GB of metadata,
+  // so the magic alone is enough to tell the layouts apart.
+  bool parsed = std::memcmp(data_, format::kV2Magic, 4) == 0
+                    ? ParseV2(key, key_length)
+                    : ParseV1();
+  if (!parsed) {
+    Close();
+    return false;
+  }
+
+  // Playback reads the payload front to back; let the kernel read ahead.
+  madvise(mapped, size, MADV_SEQUENTIAL);
+
+  if (version_ < 3) {
+    bool aes_key = key_length == 16 || key_length == 32;
+    cipher_ = aes_key ? std::make_unique<XorCipher>(
+                            format::kXorKey, sizeof(format::kXorKey))
+                      : std::make_unique<XorCipher>(key, key_length);
+  }
+  return true;
+}
+
+bool CyreneFile::ParseV1() {
+  uint64_t metadata_length = format::ReadU32(data_);
+  if (format::kV1HeaderSize + metadata_length > size_) return false;
+
+  version_ = 1;
+  metadata_offset_ = format::kV1HeaderSize;
+  metadata_length_ = static_cast<size_t>(metadata_length);
+  audio_offset_ = format::kV1HeaderSize + metadata_length;
+  audio_size_ = size_ - audio_offset_;
+  return true;
+}
+
+bool CyreneFile::ParseV2(const uint8_t* key, size_t key_length) {
+  if (size_ < format::kV2HeaderSize + format::kV2FooterSize) return false;
+  uint16_t version = format::ReadU16(data_ + 4);
+  if (version != format::kV2Version && version != format::kV3Version) {
+    return false;
+  }
+
+  size_t header_size = format::kV2HeaderSize;
+  if (version == format::kV3Version) {
+    uint16_t cipher = format::ReadU16(data_ + 6);
+    size_t expected = cipher == format::kCipherAes128Ctr   ? 16
+                      : cipher == format::kCipherAes256Ctr ? 32
+                                                           : 0;
+    if (expected == 0 || key == nullptr || key_length != expected ||
+        size_ < format::kV3HeaderSize + format::kV2FooterSize) {
+      return false;
+    }
+    header_size = format::kV3HeaderSize;
+  }
+
+  uint32_t block_size = format::ReadU32(data_ + 8);
+  uint64_t metadata_length = format::ReadU32(data_ + 12);
+  uint64_t audio_offset = header_size + metadata_length;
+  if (block_size == 0 || audio_offset > size_ - format::kV2FooterSize) {
+    return false;
+  }
+
+  const uint8_t* footer = data_ + size_ - format::kV2FooterSize;
+  if (std::memcmp(footer + 16, format::kV2FooterMagic, 4) != 0) return false;
+
+  uint64_t index_offset = format::ReadU64(footer);
+  uint64_t block_count = format::ReadU32(footer + 8);
+  uint32_t index_crc = format::ReadU32(footer + 12);
+  uint64_t index_size = block_count * format::kV2IndexEntrySize;
+  if (index_offset < audio_offset || index_offset > size_ ||
+      index_size != size_ - format::kV2FooterSize - index_offset) {
+    return false;
+  }
+
+  const uint8_t* index = data_ + index_offset;
+  if (Crc32c(index, static_cast<size_t>(index_size)) != index_crc) {
+    return false;
+  }
+
+  // Blocks hold consecutive payload ranges; all but the last are full.
+  std::vector<Block> blocks(static_cast<size_t>(block_count));
+  uint64_t audio_size = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const uint8_t* entry = index + i * format::kV2IndexEntrySize;
+    Block& block = blocks[i];
+    block.offset = format::ReadU64(entry);
+    block.length = format::ReadU32(entry + 8);
+    block.crc = format::ReadU32(entry + 12);
+
+    bool is_last = i + 1 == blocks.size();
+    if (block.length == 0 || block.length > block_size ||
+        (!is_last && block.length != block_size) ||
+        block.offset < audio_offset ||
+        block.offset + block.length > index_offset) {
+      return false;
+    }
+    audio_size += block.length;
+  }
+
+  if (version == format::kV3Version) {
+    std::memcpy(nonce_, data_ + format::kV3NonceOffset, sizeof(nonce_));
+    aes_ = std::make_unique<AesCtr>(key, key_length);
+  }
+
+  version_ = version;
+  metadata_offset_ = header_size;
+  metadata_length_ = static_cast<size_t>(metadata_length);
+  audio_offset_ = audio_offset;
+  audio_size_ = audio_size;
+  block_size_ = block_size;
+  blocks_ = std::move(blocks);
+  block_state_.assign(blocks_.size(), kUnchecked);
+  return true;
+}
+
+void CyreneFile::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+  version_ = 0;
+  metadata_offset_ = 0;
+  metadata_length_ = 0;
+  audio_offset_ = 0;
+  audio_size_ = 0;
+  block_size_ = 0;
+  blocks_.clear();
+  block_state_.clear();
+  cipher_.reset();
+  aes_.reset();
+}
+
+const char* CyreneFile::metadata() const {
+  if (data_ == nullptr) return nullptr;
+  return reinterpret_cast<const char*>(data_ + metadata_offset_);
+}
+
+bool CyreneFile::VerifyBlock(size_t index) const {
+  if (block_state_[index] == kUnchecked) {
+    const Block& block = blocks_[index];
+    bool intact = Crc32c(data_ + block.offset, block.length) == block.crc;
+    block_state_[index] = intact ? kIntact : kBroken;
+  }
+  return block_state_[index] == kIntact;
+}
+
+int64_t CyreneFile::ReadAudio(uint64_t offset, uint8_t* buffer,
+                              size_t length) const {
+  if (data_ == nullptr || offset >= audio_size_) return 0;
+
+  size_t count = static_cast<size_t>(
+      std::min<uint64_t>(length, audio_size_ - offset));
+
+  if (version_ == 1) {
+    std::memcpy(buffer, data_ + audio_offset_ + offset, count);
+  } else {
+    // Seeking is O(1): the block holding any payload offset is a division.
+    size_t copied = 0;
+    while (copied < count) {
+      uint64_t position = offset + copied;
+      size_t index = static_cast<size_t>(position / block_size_);
+      size_t within = static_cast<size_t>(position % block_size_);
+      if (!VerifyBlock(index)) return kCorrupt;
+
+      const Block& block = blocks_[index];
+      size_t take = std::min<size_t>(block.length - within, count - copied);
+      const uint8_t* source = data_ + block.offset + within;
+      if (aes_) {
+        // Decrypt straight out of the mapping rather than copying first.
+        aes_->Apply(nonce_, source, buffer + copied, take, position);
+      } else {
+        std::memcpy(buffer + copied, source, take);
+      }
+      copied += take;
+    }
+    if (aes_) return static_cast<int64_t>(count);
+  }
+
+  cipher_->Apply(buffer, count, offset);
+  return static_cast<int64_t>(count);
+}
+
+int64_t CyreneFile::Verify() const {
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    if (!VerifyBlock(i)) return static_cast<int64_t>(i);
+  }
+  return -1;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_file_open(const char* path, const uint8_t* key,
+                       int32_t key_length) {
+  if (path == nullptr || key_length < 0) return nullptr;
+  auto file = std::make_unique<cyrene::CyreneFile>();
+  if (!file->Open(path, key, static_cast<size_t>(key_length))) {
+    return nullptr;
+  }
+  return file.release();
+}
+
+void cyrene_file_close(void* handle) {
+  delete static_cast<cyrene::CyreneFile*>(handle);
+}
+
+int32_t cyrene_file_version(void* handle) {
+  if (handle == nullptr) return -1;
+  return static_cast<cyrene::CyreneFile*>(handle)->version();
+}
+
+int64_t cyrene_file_audio_size(void* handle) {
+  if (handle == nullptr) return -1;
+  return static_cast<int64_t>(
+      static_cast<cyrene::CyreneFile*>(handle)->audio_size());
+}
+
+int32_t cyrene_file_metadata_length(void* handle) {
+  if (handle == nullptr) return -1;
+  return static_cast<int32_t>(
+      static_cast<cyrene::CyreneFile*>(handle)->metadata_length());
+}
+
+int32_t cyrene_file_copy_metadata(void* handle, uint8_t* buffer,
+                                  int32_t capacity) {
+  if (handle == nullptr || buffer == nullptr || capacity < 0) return -1;
+  auto* file = static_cast<cyrene::CyreneFile*>(handle);
+  size_t count =
+      std::min(file->metadata_length(), static_cast<size_t>(capacity));
+  std::memcpy(buffer, file->metadata(), count);
+  return static_cast<int32_t>(count);
+}
+
+int64_t cyrene_file_read(void* handle, int64_t offset, uint8_t* buffer,
+                         int64_t length) {
+  if (handle == nullptr || buffer == nullptr || offset < 0 || length < 0) {
+    return -1;
+  }
+  return static_cast<cyrene::CyreneFile*>(handle)->ReadAudio(
+      static_cast<uint64_t>(offset), buffer, static_cast<size_t>(length));
+}
+
+int64_t cyrene_file_verify(void* handle) {
+  if (handle == nullptr) return -1;
+  return static_cast<cyrene::CyreneFile*>(handle)->Verify();
+}
+
+int32_t cyrene_file_extract(const char* path, const uint8_t* key,
+                            int32_t key_length, const char* output_path) {
+  if (path == nullptr || output_path == nullptr || key_length < 0) return 0;
+
+  cyrene::CyreneFile file;
+  if (!file.Open(path, key, static_cast<size_t>(key_length))) return 0;
+
+  int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return 0;
+
+  std::unique_ptr<uint8_t[]> chunk(new uint8_t[cyrene::kExtractChunkSize]);
+  uint64_t offset = 0;
+  bool ok = true;
+  while (offset < file.audio_size()) {
+    int64_t count =
+        file.ReadAudio(offset, chunk.get(), cyrene::kExtractChunkSize);
+    if (count <= 0 ||
+        !cyrene::WriteFully(fd, chunk.get(), static_cast<size_t>(count))) {
+      ok = false;
+      break;
+    }
+    offset += static_cast<uint64_t>(count);
+  }
+
+  if (close(fd) != 0) ok = false;
+  if (!ok) std::remove(output_path);
+  return ok ? 1 : 0;
+}
+
+}  // extern "C"
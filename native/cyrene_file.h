@@ -0,0 +1,134 @@
+#ifndef CYRENE_NATIVE_CYRENE_FILE_H_
+#define CYRENE_NATIVE_CYRENE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aes_ctr.h"
+#include "native_export.h"
+#include "xor_cipher.h"
+
+namespace cyrene {
+
+// Read-only view of a .cyrene cache file (docs/CYRENE_FILE_FORMAT.md).
+//
+// The file is memory-mapped once and the audio payload is decrypted on demand
+// into the caller's buffer. Both ciphers are seekable (the XOR keystream
+// position of a payload byte is offset % key length, the AES-CTR counter is
+// nonce + offset / 16), so reads can start anywhere and playback never needs
+// a decrypted copy of the track in memory or on disk.
+//
+// All layouts are supported: v1 files are one encrypted blob, v2 and v3 files
+// split the payload into fixed-size blocks with a trailing CRC-32C index. For
+// v2 and v3, each block is verified the first time a read touches it.
+class CyreneFile {
+ public:
+  // ReadAudio() result when a v2 block fails its checksum.
+  static constexpr int64_t kCorrupt = -2;
+
+  CyreneFile();
+  ~CyreneFile();
+
+  CyreneFile(const CyreneFile&) = delete;
+  CyreneFile& operator=(const CyreneFile&) = delete;
+
+  // Maps |path| and parses its header. Returns false if the file cannot be
+  // opened or is not a well-formed .cyrene file.
+  //
+  // A 16- or 32-byte |key| is an AES key: v3 files need one of the length
+  // their header names, and v1/v2 files are then read with the built-in
+  // format::kXorKey. Any other |key| is used as the XOR key of v1/v2 files
+  // and cannot open v3 files.
+  bool Open(const std::string& path, const uint8_t* key, size_t key_length);
+
+  // Unmaps the file. Safe to call on a closed instance.
+  void Close();
+
+  bool IsOpen() const { return data_ != nullptr; }
+
+  // Container version (1, 2 or 3), 0 when closed.
+  int version() const { return version_; }
+
+  // Raw metadata JSON (UTF-8, not NUL-terminated).
+  const char* metadata() const;
+  size_t metadata_length() const { return metadata_length_; }
+
+  // Size of the decrypted audio payload in bytes.
+  uint64_t audio_size() const { return audio_size_; }
+
+  // Payload bytes per block (0 for v1 files).
+  uint32_t block_size() const { return block_size_; }
+
+  // Number of indexed blocks (always 0 for v1 files).
+  size_t block_count() const { return blocks_.size(); }
+
+  // Decrypts up to |length| payload bytes starting at |offset| into |buffer|.
+  // Returns the number of bytes written, 0 at or past the end of the payload,
+  // or kCorrupt if a block in the range fails its checksum.
+  int64_t ReadAudio(uint64_t offset, uint8_t* buffer, size_t length) const;
+
+  // Checks every v2/v3 block. Returns the index of the first corrupt block, or
+  // -1 if all blocks are intact (and for v1 files, which carry no index).
+  int64_t Verify() const;
+
+ private:
+  struct Block {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t crc;
+  };
+
+  bool ParseV1();
+  bool ParseV2(const uint8_t* key, size_t key_length);
+  bool VerifyBlock(size_t index) const;
+
+  const uint8_t* data_;
+  size_t size_;
+  int version_;
+  size_t metadata_offset_;
+  size_t metadata_length_;
+  uint64_t audio_offset_;
+  uint64_t audio_size_;
+  uint32_t block_size_;
+  std::vector<Block> blocks_;
+  // Per-block state: 0 = unchecked, 1 = intact, 2 = corrupt.
+  mutable std::vector<uint8_t> block_state_;
+  // Exactly one of the two is set while the file is open.
+  std::unique_ptr<XorCipher> cipher_;
+  std::unique_ptr<AesCtr> aes_;
+  uint8_t nonce_[AesCtr::kNonceSize];
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/cyrene_file_native.dart. Handles returned by
+// cyrene_file_open() must be released with cyrene_file_close().
+CYRENE_EXPORT void* cyrene_file_open(const char* path, const uint8_t* key,
+                                     int32_t key_length);
+CYRENE_EXPORT void cyrene_file_close(void* handle);
+CYRENE_EXPORT int32_t cyrene_file_version(void* handle);
+CYRENE_EXPORT int64_t cyrene_file_audio_size(void* handle);
+CYRENE_EXPORT int32_t cyrene_file_metadata_length(void* handle);
+CYRENE_EXPORT int32_t cyrene_file_copy_metadata(void* handle, uint8_t* buffer,
+                                                int32_t capacity);
+// Returns bytes read, 0 at the end, -1 on bad arguments or -2 (kCorrupt) on a
+// checksum mismatch.
+CYRENE_EXPORT int64_t cyrene_file_read(void* handle, int64_t offset,
+                                       uint8_t* buffer, int64_t length);
+CYRENE_EXPORT int64_t cyrene_file_verify(void* handle);
+
+// Decrypts the audio payload of |path| into |output_path| in fixed-size
+// chunks. |key| is interpreted as by CyreneFile::Open(). Returns 1 on
+// success, 0 on failure (the partial output is removed).
+CYRENE_EXPORT int32_t cyrene_file_extract(const char* path, const uint8_t* key,
+                                          int32_t key_length,
+                                          const char* output_path);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_CYRENE_FILE_H_
@@ -0,0 +1,85 @@
+#ifndef CYRENE_NATIVE_CYRENE_FORMAT_H_
+#define CYRENE_NATIVE_CYRENE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout constants shared by CyreneFile and CyreneWriter. See
+// docs/CYRENE_FILE_FORMAT.md for the full description. All integers are
+// big-endian, like the v1 metadata length prefix.
+namespace cyrene {
+namespace format {
+
+// v1: [u32 metadata length][metadata JSON][encrypted audio].
+constexpr size_t kV1HeaderSize = 4;
+
+// v2 header: [magic "CYR2"][u16 version][u16 flags][u32 block size]
+//            [u32 metadata length], followed by the metadata JSON and the
+//            encrypted audio blocks.
+constexpr uint8_t kV2Magic[4] = {'C', 'Y', 'R', '2'};
+constexpr uint16_t kV2Version = 2;
+constexpr size_t kV2HeaderSize = 16;
+
+// v3 reuses the v2 container and marks the payload as AES-CTR encrypted
+// (aes_ctr.h) with a per-file random nonce: the flags field holds the cipher
+// id and the 16-byte nonce follows the header, before the metadata. v2
+// readers reject it on the version field.
+constexpr uint16_t kV3Version = 3;
+constexpr size_t kV3HeaderSize = 32;
+constexpr size_t kV3NonceOffset = 16;
+constexpr uint16_t kCipherAes128Ctr = 1;
+constexpr uint16_t kCipherAes256Ctr = 2;
+
+// Repeating XOR key of v1 and v2 payloads. It is the same for every
+// installation, which is why new files are written as v3.
+constexpr uint8_t kXorKey[] = {'C', 'y', 'r', 'e', 'n', 'e', 'M', 'u',
+                               's', 'i', 'c', 'C', 'a', 'c', 'h', 'e',
+                               'K', 'e', 'y', '2', '0', '2', '5'};
+
+// v2 index entry: [u64 file offset][u32 stored length][u32 CRC-32C of the
+// stored (encrypted) bytes].
+constexpr size_t kV2IndexEntrySize = 16;
+
+// v2 footer: [u64 index offset][u32 block count][u32 CRC-32C of the index]
+//            [magic "CYRI"].
+constexpr uint8_t kV2FooterMagic[4] = {'C', 'Y', 'R', 'I'};
+constexpr size_t kV2FooterSize = 20;
+
+// Default audio block size for new v2 and v3 files.
+constexpr uint32_t kDefaultBlockSize = 256 * 1024;
+
+inline uint16_t ReadU16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t ReadU32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline uint64_t ReadU64(const uint8_t* p) {
+  return (static_cast<uint64_t>(ReadU32(p)) << 32) | ReadU32(p + 4);
+}
+
+inline void WriteU16(uint8_t* p, uint16_t value) {
+  p[0] = static_cast<uint8_t>(value >> 8);
+  p[1] = static_cast<uint8_t>(value);
+}
+
+inline void WriteU32(uint8_t* p, uint32_t value) {
+  p[0] = static_cast<uint8_t>(value >> 24);
+  p[1] = static_cast<uint8_t>(value >> 16);
+  p[2] = static_cast<uint8_t>(value >> 8);
+  p[3] = static_cast<uint8_t>(value);
+}
+
+inline void WriteU64(uint8_t* p, uint64_t value) {
+  WriteU32(p, static_cast<uint32_t>(value >> 32));
+  WriteU32(p + 4, static_cast<uint32_t>(value));
+}
+
+}  // namespace format
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_CYRENE_FORMAT_H_
@@ -0,0 +1,253 @@
+#include "cyrene_writer.h"
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "crc32c.h"
+#include "cyrene_file.h"
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+CyreneWriter::CyreneWriter()
+    : fd_(-1),
+      block_size_(0),
+      file_offset_(0),
+      audio_size_(0),
+      block_count_(0),
+      nonce_() {}
+
+CyreneWriter::~CyreneWriter() {
+  Abort();
+}
+
+bool CyreneWriter::Open(const std::string& path, const uint8_t* key,
+                        size_t key_length, const uint8_t* metadata,
+                        size_t metadata_length, uint32_t block_size) {
+  Abort();
+  if (block_size == 0 || metadata_length > UINT32_MAX) return false;
+
+  path_ = path;
+  part_path_ = path + ".part";
+  fd_ = open(part_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0644);
+  if (fd_ < 0) return false;
+
+  block_size_ = block_size;
+  block_.reserve(block_size);
+
+  uint8_t header[format::kV3HeaderSize];
+  size_t header_size = format::kV2HeaderSize;
+  uint16_t version = format::kV2Version;
+  uint16_t flags = 0;
+  if (key != nullptr && (key_length == 16 || key_length == 32)) {
+    // A nonce is never reused under one key, so two files holding the same
+    // track do not share a keystream.
+    if (RAND_bytes(nonce_, sizeof(nonce_)) != 1) {
+      Abort();
+      return false;
+    }
+    aes_ = std::make_unique<AesCtr>(key, key_length);
+    header_size = format::kV3HeaderSize;
+    version = format::kV3Version;
+    flags = key_length == 16 ? format::kCipherAes128Ctr
+                             : format::kCipherAes256Ctr;
+    std::memcpy(header + format::kV3NonceOffset, nonce_, sizeof(nonce_));
+  } else {
+    cipher_ = std::make_unique<XorCipher>(key, key_length);
+  }
+
+  std::memcpy(header, format::kV2Magic, 4);
+  format::WriteU16(header + 4, version);
+  format::WriteU16(header + 6, flags);
+  format::WriteU32(header + 8, block_size);
+  format::WriteU32(header + 12, static_cast<uint32_t>(metadata_length));
+  if (!Write(header, header_size) || !Write(metadata, metadata_length)) {
+    Abort();
+    return false;
+  }
+  return true;
+}
+
+bool CyreneWriter::Append(const uint8_t* data, size_t length) {
+  if (fd_ < 0) return false;
+
+  while (length > 0) {
+    size_t take = std::min<size_t>(length, block_size_ - block_.size());
+    block_.insert(block_.end(), data, data + take);
+    data += take;
+    length -= take;
+    if (block_.size() == block_size_ && !FlushBlock()) return false;
+  }
+  return true;
+}
+
+bool CyreneWriter::FlushBlock() {
+  if (block_.empty()) return true;
+
+  // The keystream position is the payload offset, exactly as in v1, so the
+  // stored bytes of a v2 file match the v1 ciphertext of the same track.
+  if (aes_) {
+    aes_->Apply(nonce_, block_.data(), block_.size(), audio_size_);
+  } else {
+    cipher_->Apply(block_.data(), block_.size(), audio_size_);
+  }
+
+  uint8_t entry[format::kV2IndexEntrySize];
+  format::WriteU64(entry, file_offset_);
+  format::WriteU32(entry + 8, static_cast<uint32_t>(block_.size()));
+  format::WriteU32(entry + 12, Crc32c(block_.data(), block_.size()));
+  index_.insert(index_.end(), entry, entry + sizeof(entry));
+
+  audio_size_ += block_.size();
+  ++block_count_;
+  bool ok = Write(block_.data(), block_.size());
+  block_.clear();
+  return ok;
+}
+
+bool CyreneWriter::Finish() {
+  if (fd_ < 0) return false;
+
+  if (!FlushBlock()) {
+    Abort();
+    return false;
+  }
+
+  uint8_t footer[format::kV2FooterSize];
+  format::WriteU64(footer, file_offset_);
+  format::WriteU32(footer + 8, block_count_);
+  format::WriteU32(footer + 12, Crc32c(index_.data(), index_.size()));
+  std::memcpy(footer + 16, format::kV2FooterMagic, 4);
+
+  if (!Write(index_.data(), index_.size()) ||
+      !Write(footer, sizeof(footer)) || fsync(fd_) != 0) {
+    Abort();
+    return false;
+  }
+
+  int fd = fd_;
+  fd_ = -1;
+  if (close(fd) != 0 || rename(part_path_.c_str(), path_.c_str()) != 0) {
+    std::remove(part_path_.c_str());
+    return false;
+  }
+  return true;
+}
+
+void CyreneWriter::Abort() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+    std::remove(part_path_.c_str());
+  }
+  file_offset_ = 0;
+  audio_size_ = 0;
+  block_count_ = 0;
+  block_.clear();
+  index_.clear();
+  cipher_.reset();
+  aes_.reset();
+}
+
+bool CyreneWriter::Write(const uint8_t* data, size_t length) {
+  if (!WriteFully(fd_, data, length)) return false;
+  file_offset_ += length;
+  return true;
+}
+
+bool UpgradeCyreneFile(const std::string& path, const uint8_t* key,
+                       size_t key_length) {
+  if (key == nullptr || (key_length != 16 && key_length != 32)) return false;
+
+  CyreneFile source;
+  if (!source.Open(path, key, key_length)) return false;
+  if (source.version() >= 3) return true;
+
+  // Same block size as the source where there is one, so the upgraded file
+  // verifies and seeks the same way.
+  uint32_t block_size = source.block_size() > 0 ? source.block_size()
+                                                : format::kDefaultBlockSize;
+
+  CyreneWriter writer;
+  if (!writer.Open(path, key, key_length,
+                   reinterpret_cast<const uint8_t*>(source.metadata()),
+                   source.metadata_length(), block_size)) {
+    return false;
+  }
+
+  std::vector<uint8_t> chunk(block_size);
+  uint64_t offset = 0;
+  while (offset < source.audio_size()) {
+    int64_t count = source.ReadAudio(offset, chunk.data(), chunk.size());
+    if (count <= 0 ||
+        !writer.Append(chunk.data(), static_cast<size_t>(count))) {
+      writer.Abort();
+      return false;
+    }
+    offset += static_cast<uint64_t>(count);
+  }
+  return writer.Finish();
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_writer_open(const char* path, const uint8_t* key,
+                         int32_t key_length, const uint8_t* metadata,
+                         int32_t metadata_length, int32_t block_size) {
+  if (path == nullptr || key_length < 0 || metadata_length < 0) {
+    return nullptr;
+  }
+  if (block_size <= 0) {
+    block_size = static_cast<int32_t>(cyrene::format::kDefaultBlockSize);
+  }
+
+  auto writer = std::make_unique<cyrene::CyreneWriter>();
+  if (!writer->Open(path, key, static_cast<size_t>(key_length), metadata,
+                    static_cast<size_t>(metadata_length),
+                    static_cast<uint32_t>(block_size))) {
+    return nullptr;
+  }
+  return writer.release();
+}
+
+int32_t cyrene_writer_append(void* handle, const uint8_t* data,
+                             int64_t length) {
+  if (handle == nullptr || length < 0 || (data == nullptr && length > 0)) {
+    return 0;
+  }
+  return static_cast<cyrene::CyreneWriter*>(handle)->Append(
+             data, static_cast<size_t>(length))
+             ? 1
+             : 0;
+}
+
+int32_t cyrene_writer_finish(void* handle) {
+  if (handle == nullptr) return 0;
+  auto* writer = static_cast<cyrene::CyreneWriter*>(handle);
+  bool ok = writer->Finish();
+  delete writer;
+  return ok ? 1 : 0;
+}
+
+void cyrene_writer_abort(void* handle) {
+  delete static_cast<cyrene::CyreneWriter*>(handle);
+}
+
+int32_t cyrene_writer_upgrade(const char* path, const uint8_t* key,
+                              int32_t key_length) {
+  if (path == nullptr || key_length < 0) return 0;
+  return cyrene::UpgradeCyreneFile(path, key, static_cast<size_t>(key_length))
+             ? 1
+             : 0;
+}
+
+}  // extern "C"
@@ -0,0 +1,99 @@
+#ifndef CYRENE_NATIVE_CYRENE_WRITER_H_
+#define CYRENE_NATIVE_CYRENE_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aes_ctr.h"
+#include "native_export.h"
+#include "xor_cipher.h"
+
+namespace cyrene {
+
+// Streaming writer for .cyrene v2 and v3 files (docs/CYRENE_FILE_FORMAT.md).
+//
+// Audio is appended in arbitrary pieces; it is buffered up to one block,
+// encrypted, checksummed and written out, so memory use is bounded by the
+// block size regardless of track length. Output goes to "<path>.part" and is
+// renamed over |path| by Finish(), so readers never observe a partial file.
+class CyreneWriter {
+ public:
+  CyreneWriter();
+  ~CyreneWriter();
+
+  CyreneWriter(const CyreneWriter&) = delete;
+  CyreneWriter& operator=(const CyreneWriter&) = delete;
+
+  // Creates "<path>.part" and writes the header and metadata. A 16- or
+  // 32-byte |key| writes a v3 file encrypted with AES-CTR under a fresh
+  // random nonce; any other key writes a v2 file with that XOR key.
+  bool Open(const std::string& path, const uint8_t* key, size_t key_length,
+            const uint8_t* metadata, size_t metadata_length,
+            uint32_t block_size);
+
+  // Appends plain audio bytes. |data| is not modified.
+  bool Append(const uint8_t* data, size_t length);
+
+  // Flushes the last block, writes the index and footer, syncs and renames
+  // the file into place. The writer is closed afterwards either way.
+  bool Finish();
+
+  // Closes the writer and removes the partial file.
+  void Abort();
+
+  // Plain audio bytes appended so far.
+  uint64_t audio_size() const { return audio_size_; }
+
+ private:
+  bool FlushBlock();
+  bool Write(const uint8_t* data, size_t length);
+
+  int fd_;
+  std::string path_;
+  std::string part_path_;
+  uint32_t block_size_;
+  uint64_t file_offset_;
+  uint64_t audio_size_;
+  std::vector<uint8_t> block_;
+  std::vector<uint8_t> index_;
+  uint32_t block_count_;
+  // Exactly one of the two is set while the writer is open.
+  std::unique_ptr<XorCipher> cipher_;
+  std::unique_ptr<AesCtr> aes_;
+  uint8_t nonce_[AesCtr::kNonceSize];
+};
+
+// Rewrites the v1 or v2 file at |path| as v3 under the AES |key| (16 or 32
+// bytes), through a CyreneWriter so the original stays in place until the
+// new file is complete. Files that are already v3 are left alone. Fails
+// without touching |path| if it cannot be read or a block is corrupt.
+bool UpgradeCyreneFile(const std::string& path, const uint8_t* key,
+                       size_t key_length);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/cyrene_writer_native.dart. Every handle from
+// cyrene_writer_open() must be passed to exactly one of cyrene_writer_finish()
+// or cyrene_writer_abort(), which both release it.
+CYRENE_EXPORT void* cyrene_writer_open(const char* path, const uint8_t* key,
+                                       int32_t key_length,
+                                       const uint8_t* metadata,
+                                       int32_t metadata_length,
+                                       int32_t block_size);
+CYRENE_EXPORT int32_t cyrene_writer_append(void* handle, const uint8_t* data,
+                                           int64_t length);
+CYRENE_EXPORT int32_t cyrene_writer_finish(void* handle);
+CYRENE_EXPORT void cyrene_writer_abort(void* handle);
+// Returns 1 if |path| is v3 afterwards, 0 on failure.
+CYRENE_EXPORT int32_t cyrene_writer_upgrade(const char* path,
+                                            const uint8_t* key,
+                                            int32_t key_length);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_CYRENE_WRITER_H_
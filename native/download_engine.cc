@@ -0,0 +1,651 @@
+#include "download_engine.h"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "cyrene_format.h"
+#include "fd_util.h"
+#include "http_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// Unit of concurrency, presence tracking and retry.
+constexpr uint64_t kPieceSize = 1024 * 1024;
+
+constexpr uint8_t kStateMagic[4] = {'C', 'Y', 'D', 'L'};
+constexpr uint16_t kStateVersion = 1;
+
+// magic + version + validator length + total size + piece size.
+constexpr size_t kStateHeaderSize = 4 + 2 + 2 + 8 + 4;
+
+// Failed attempts per piece (or per probe) before the task gives up; the
+// wait doubles from kRetryBase after each one.
+constexpr int kMaxAttempts = 5;
+constexpr auto kRetryBase = std::chrono::milliseconds(500);
+
+constexpr size_t kHashChunkSize = 1024 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
+// Statuses a retry with the same URL cannot fix (expired signatures show up
+// as 403 on the CDNs).
+bool IsPermanent(int status) {
+  return status == 401 || status == 403 || status == 404 || status == 410;
+}
+
+// Parses "bytes <first>-<last>/<size>".
+bool ParseContentRange(const std::string* header, uint64_t* first,
+                       uint64_t* last, uint64_t* size) {
+  unsigned long long a = 0;
+  unsigned long long b = 0;
+  unsigned long long c = 0;
+  if (header == nullptr ||
+      std::sscanf(header->c_str(), "bytes %llu-%llu/%llu", &a, &b, &c) != 3 ||
+      a > b || b >= c) {
+    return false;
+  }
+  *first = a;
+  *last = b;
+  *size = c;
+  return true;
+}
+
+}  // namespace
+
+struct DownloadEngine::Piece {
+  uint64_t start = 0;
+  uint64_t length = 0;
+  uint64_t done = 0;  // Bytes written from |start|, kept across retries.
+  bool active = false;
+  int attempts = 0;
+  Clock::time_point retry_at;
+};
+
+struct DownloadEngine::Task {
+  ~Task() {
+    if (data_fd >= 0) close(data_fd);
+    if (state_fd >= 0) close(state_fd);
+  }
+
+  std::string part_path() const { return options.path + ".part"; }
+  std::string state_path() const { return options.path + ".part.state"; }
+
+  bool Running() const {
+    return state == DownloadState::kQueued || state == DownloadState::kRunning;
+  }
+
+  int64_t id = 0;
+  DownloadOptions options;  // Immutable after Add().
+  DownloadState state = DownloadState::kQueued;
+  int http_status = 0;
+
+  // Before the probe has answered, |ranged| is false and one worker at a
+  // time probes (or streams, for servers without range support).
+  bool probing = false;
+  bool ranged = false;
+  int attempts = 0;
+  Clock::time_point retry_at;
+
+  int active = 0;  // Workers currently on this task.
+  uint64_t total = 0;
+  uint64_t received = 0;
+  uint64_t resumed = 0;  // Part of |received| found on disk at start.
+  Clock::time_point started;
+  Clock::time_point finished;
+
+  std::vector<Piece> pieces;
+  std::vector<uint8_t> bitmap;
+  size_t bitmap_offset = 0;
+  int data_fd = -1;
+  int state_fd = -1;
+  std::string md5;
+};
+
+DownloadEngine::DownloadEngine()
+    : stopping_(false),
+      connections_(8),
+      per_task_(4),
+      active_(0),
+      next_id_(1) {}
+
+DownloadEngine::~DownloadEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+int64_t DownloadEngine::Add(DownloadOptions options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& task : tasks_) {
+    if (task->options.path == options.path &&
+        (task->Running() || task->state == DownloadState::kVerifying)) {
+      return task->id;
+    }
+  }
+  auto task = std::make_shared<Task>();
+  task->id = next_id_++;
+  task->options = std::move(options);
+  tasks_.push_back(task);
+
+  if (threads_.empty()) {
+    for (int i = 0; i < kMaxConnections; ++i) {
+      threads_.emplace_back(&DownloadEngine::Run, this);
+    }
+  }
+  cv_.notify_all();
+  return task->id;
+}
+
+bool DownloadEngine::Progress(int64_t id, DownloadProgress* progress) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& task : tasks_) {
+    if (task->id != id) continue;
+    progress->state = task->state;
+    progress->received = task->received;
+    progress->total = task->total;
+    progress->http_status = task->http_status;
+    progress->md5 = task->md5;
+    progress->bytes_per_second = 0;
+    if (task->state != DownloadState::kQueued) {
+      Clock::time_point end =
+          task->Running() || task->state == DownloadState::kVerifying
+              ? Clock::now()
+              : task->finished;
+      auto elapsed =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              end - task->started)
+              .count();
+      if (elapsed > 0) {
+        progress->bytes_per_second =
+            (task->received - task->resumed) * 1000000 /
+            static_cast<uint64_t>(elapsed);
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+void DownloadEngine::Cancel(int64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& task : tasks_) {
+    if (task->id == id && task->Running()) {
+      task->state = DownloadState::kCancelled;
+      task->finished = Clock::now();
+    }
+  }
+  cv_.notify_all();
+}
+
+void DownloadEngine::Remove(int64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = tasks_.begin(); it != tasks_.end(); ++it) {
+    if ((*it)->id != id) continue;
+    // Workers still holding the task see it cancelled and let go of it.
+    if ((*it)->Running()) (*it)->state = DownloadState::kCancelled;
+    tasks_.erase(it);
+    break;
+  }
+  cv_.notify_all();
+}
+
+void DownloadEngine::SetLimits(int connections, int per_task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_ = std::max(1, std::min(connections, kMaxConnections));
+  per_task_ = std::max(1, std::min(per_task, connections_));
+  cv_.notify_all();
+}
+
+void DownloadEngine::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    std::shared_ptr<Task> task;
+    size_t piece = 0;
+    Clock::time_point wake = Clock::time_point::max();
+    WorkKind kind = active_ < connections_ ? Pick(&task, &piece, &wake)
+                                           : WorkKind::kNone;
+    if (kind == WorkKind::kNone) {
+      if (wake == Clock::time_point::max()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, wake);
+      }
+      continue;
+    }
+
+    ++active_;
+    ++task->active;
+    lock.unlock();
+    switch (kind) {
+      case WorkKind::kProbe:
+        Probe(task);
+        break;
+      case WorkKind::kPiece:
+        FetchPiece(task, piece);
+        break;
+      case WorkKind::kVerify:
+        Verify(task);
+        break;
+      case WorkKind::kNone:
+        break;
+    }
+    lock.lock();
+    --active_;
+    --task->active;
+    cv_.notify_all();
+  }
+}
+
+DownloadEngine::WorkKind DownloadEngine::Pick(std::shared_ptr<Task>* task,
+                                              size_t* piece,
+                                              Clock::time_point* wake) {
+  Clock::time_point now = Clock::now();
+  // Queue order: a later task only gets the slots an earlier one cannot use.
+  for (const auto& candidate : tasks_) {
+    if (!candidate->Running()) continue;
+    if (!candidate->ranged) {
+      if (candidate->probing || candidate->active > 0) continue;
+      if (candidate->retry_at > now) {
+        *wake = std::min(*wake, candidate->retry_at);
+        continue;
+      }
+      candidate->probing = true;
+      if (candidate->state == DownloadState::kQueued) {
+        candidate->state = DownloadState::kRunning;
+        candidate->started = now;
+      }
+      *task = candidate;
+      return WorkKind::kProbe;
+    }
+
+    bool complete = std::all_of(
+        candidate->pieces.begin(), candidate->pieces.end(),
+        [](const Piece& item) { return item.done == item.length; });
+    if (complete) {
+      // Verified once the last piece's worker has recorded it.
+      if (candidate->active > 0) continue;
+      candidate->state = DownloadState::kVerifying;
+      *task = candidate;
+      return WorkKind::kVerify;
+    }
+    if (candidate->active >= per_task_) continue;
+    for (size_t i = 0; i < candidate->pieces.size(); ++i) {
+      Piece& item = candidate->pieces[i];
+      if (item.active || item.done == item.length) continue;
+      if (item.retry_at > now) {
+        *wake = std::min(*wake, item.retry_at);
+        continue;
+      }
+      item.active = true;
+      *task = candidate;
+      *piece = i;
+      return WorkKind::kPiece;
+    }
+  }
+  return WorkKind::kNone;
+}
+
+void DownloadEngine::Probe(const std::shared_ptr<Task>& task) {
+  const DownloadOptions& options = task->options;
+  // Only the probing worker touches the descriptors until |ranged| is set.
+  if (task->data_fd < 0) {
+    task->data_fd =
+        open(task->part_path().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  }
+  if (task->state_fd < 0) {
+    task->state_fd =
+        open(task->state_path().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  }
+  if (task->data_fd < 0 || task->state_fd < 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task->probing = false;
+    Fail(task.get());
+    return;
+  }
+
+  UpstreamClient::Headers headers = {{"User-Agent", kUpstreamUserAgent},
+                                     {"Range", "bytes=0-0"}};
+  if (!options.referer.empty()) {
+    headers.emplace_back("Referer", options.referer);
+  }
+
+  int status = 0;
+  uint64_t total = 0;
+  std::string validator;
+  // Set when the server ignores the range: the body is the whole file.
+  bool streaming = false;
+  bool failed = false;
+  uint64_t expected = 0;
+  uint64_t offset = 0;
+
+  auto on_head = [&](const UpstreamResponse& response) {
+    status = response.status;
+    if (status == 206) {
+      uint64_t first = 0;
+      uint64_t last = 0;
+      if (!ParseContentRange(response.Header("content-range"), &first, &last,
+                             &total)) {
+        total = 0;
+        return false;
+      }
+      const std::string* etag = response.Header("etag");
+      const std::string* modified = response.Header("last-modified");
+      validator = etag ? *etag : modified ? *modified : std::string();
+      return true;
+    }
+    if (status != 200) return false;
+    streaming = true;
+    if (const std::string* length = response.Header("content-length")) {
+      expected = std::strtoull(length->c_str(), nullptr, 10);
+    }
+    failed = ftruncate(task->data_fd, 0) != 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    task->received = 0;
+    task->total = expected;
+    return !failed;
+  };
+  auto on_body = [&](const uint8_t* data, size_t length) {
+    if (!streaming) return true;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!task->Running() || stopping_) return false;
+    }
+    if (!PWriteFully(task->data_fd, data, length, offset)) {
+      failed = true;
+      return false;
+    }
+    offset += length;
+    std::lock_guard<std::mutex> lock(mutex_);
+    task->received = offset;
+    return true;
+  };
+
+  bool ok = upstream_.Get(options.url, headers, on_head, on_body);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task->probing = false;
+  if (status != 0) task->http_status = status;
+  if (!task->Running()) return;
+  if (failed) {
+    Fail(task.get());
+    return;
+  }
+  if (ok && status == 206 && total > 0) {
+    if (!PrepareRanged(task.get(), total, validator)) Fail(task.get());
+    return;
+  }
+  if (ok && streaming && (expected == 0 || offset == expected)) {
+    task->total = offset;
+    task->state = DownloadState::kVerifying;
+    lock.unlock();
+    Verify(task);
+    return;
+  }
+  RetryLater(task.get(), &task->attempts, &task->retry_at, status);
+}
+
+bool DownloadEngine::PrepareRanged(Task* task, uint64_t total,
+                                   const std::string& validator) {
+  size_t count = static_cast<size_t>((total + kPieceSize - 1) / kPieceSize);
+  size_t bitmap_length = (count + 7) / 8;
+  std::vector<uint8_t> bitmap(bitmap_length, 0);
+
+  // Resume only if the state describes this very resource.
+  struct stat st;
+  bool resumed = false;
+  if (fstat(task->state_fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= kStateHeaderSize) {
+    std::vector<uint8_t> state(static_cast<size_t>(st.st_size));
+    if (PReadFully(task->state_fd, state.data(), state.size(), 0)) {
+      uint16_t validator_length = format::ReadU16(state.data() + 6);
+      resumed =
+          std::memcmp(state.data(), kStateMagic, 4) == 0 &&
+          format::ReadU16(state.data() + 4) == kStateVersion &&
+          format::ReadU64(state.data() + 8) == total &&
+          format::ReadU32(state.data() + 16) == kPieceSize &&
+          state.size() ==
+              kStateHeaderSize + validator_length + bitmap_length &&
+          std::string(reinterpret_cast<const char*>(state.data()) +
+                          kStateHeaderSize,
+                      validator_length) == validator;
+      if (resumed) {
+        std::memcpy(bitmap.data(),
+                    state.data() + kStateHeaderSize + validator_length,
+                    bitmap_length);
+      }
+    }
+  }
+  if (!resumed && ftruncate(task->data_fd, 0) != 0) return false;
+  if (ftruncate(task->data_fd, static_cast<off_t>(total)) != 0) return false;
+
+  std::vector<uint8_t> header(kStateHeaderSize);
+  std::memcpy(header.data(), kStateMagic, 4);
+  format::WriteU16(header.data() + 4, kStateVersion);
+  format::WriteU16(header.data() + 6, static_cast<uint16_t>(validator.size()));
+  format::WriteU64(header.data() + 8, total);
+  format::WriteU32(header.data() + 16, static_cast<uint32_t>(kPieceSize));
+  header.insert(header.end(), validator.begin(), validator.end());
+  task->bitmap_offset = header.size();
+  header.insert(header.end(), bitmap.begin(), bitmap.end());
+  if (!PWriteFully(task->state_fd, header.data(), header.size(), 0) ||
+      ftruncate(task->state_fd, static_cast<off_t>(header.size())) != 0) {
+    return false;
+  }
+
+  task->received = 0;
+  task->pieces.assign(count, Piece());
+  for (size_t i = 0; i < count; ++i) {
+    Piece& piece = task->pieces[i];
+    piece.start = i * kPieceSize;
+    piece.length = std::min(kPieceSize, total - piece.start);
+    if (bitmap[i / 8] & (1 << (i % 8))) {
+      piece.done = piece.length;
+      task->received += piece.length;
+    }
+  }
+  task->bitmap = std::move(bitmap);
+  task->resumed = task->received;
+  task->total = total;
+  task->ranged = true;
+  cv_.notify_all();
+  return true;
+}
+
+void DownloadEngine::FetchPiece(const std::shared_ptr<Task>& task,
+                                size_t index) {
+  const DownloadOptions& options = task->options;
+  uint64_t from = 0;
+  uint64_t last = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Piece& piece = task->pieces[index];
+    from = piece.start + piece.done;
+    last = piece.start + piece.length - 1;
+  }
+
+  UpstreamClient::Headers headers = {
+      {"User-Agent", kUpstreamUserAgent},
+      {"Range", "bytes=" + std::to_string(from) + "-" + std::to_string(last)},
+  };
+  if (!options.referer.empty()) {
+    headers.emplace_back("Referer", options.referer);
+  }
+
+  int status = 0;
+  bool failed = false;
+  uint64_t offset = from;
+
+  auto on_head = [&](const UpstreamResponse& response) {
+    status = response.status;
+    uint64_t first = 0;
+    uint64_t end = 0;
+    uint64_t size = 0;
+    return status == 206 &&
+           ParseContentRange(response.Header("content-range"), &first, &end,
+                             &size) &&
+           first == from && size == task->total;
+  };
+  auto on_body = [&](const uint8_t* data, size_t length) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!task->Running() || stopping_) return false;
+    }
+    // Anything past the requested range means the connection is confused;
+    // keep what was asked for and drop the connection.
+    size_t wanted = static_cast<size_t>(
+        std::min<uint64_t>(length, last + 1 - offset));
+    if (!PWriteFully(task->data_fd, data, wanted, offset)) {
+      failed = true;
+      return false;
+    }
+    offset += wanted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    task->pieces[index].done += wanted;
+    task->received += wanted;
+    return wanted == length;
+  };
+
+  upstream_.Get(options.url, headers, on_head, on_body);
+
+  // The bit may only be set once the data under it is durable.
+  bool complete = offset == last + 1 && fdatasync(task->data_fd) == 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Piece& piece = task->pieces[index];
+  piece.active = false;
+  if (status != 0) task->http_status = status;
+  if (complete) {
+    piece.attempts = 0;
+    size_t byte = index / 8;
+    task->bitmap[byte] |= static_cast<uint8_t>(1 << (index % 8));
+    if (!PWriteFully(task->state_fd, &task->bitmap[byte], 1,
+                     task->bitmap_offset + byte)) {
+      Fail(task.get());
+    }
+  } else if (task->Running()) {
+    if (failed) {
+      Fail(task.get());
+    } else {
+      RetryLater(task.get(), &piece.attempts, &piece.retry_at, status);
+    }
+  }
+}
+
+void DownloadEngine::Verify(const std::shared_ptr<Task>& task) {
+  const DownloadOptions& options = task->options;
+  std::unique_ptr<EVP_MD_CTX, DigestDeleter> digest(EVP_MD_CTX_new());
+  bool hashed =
+      digest && EVP_DigestInit_ex(digest.get(), EVP_md5(), nullptr) == 1;
+  std::vector<uint8_t> buffer(kHashChunkSize);
+  uint64_t offset = 0;
+  while (hashed && offset < task->total) {
+    size_t length = static_cast<size_t>(
+        std::min<uint64_t>(buffer.size(), task->total - offset));
+    hashed = PReadFully(task->data_fd, buffer.data(), length, offset) &&
+             EVP_DigestUpdate(digest.get(), buffer.data(), length) == 1;
+    offset += length;
+  }
+  uint8_t md5[EVP_MAX_MD_SIZE];
+  unsigned int md5_length = 0;
+  hashed = hashed && EVP_DigestFinal_ex(digest.get(), md5, &md5_length) == 1;
+  std::string hex = hashed ? Hex(md5, md5_length) : std::string();
+  bool matches = options.expected_md5.empty() ||
+                 ToLower(options.expected_md5) == hex;
+
+  bool renamed = hashed && matches &&
+                 rename(task->part_path().c_str(), options.path.c_str()) == 0;
+  if (renamed || (hashed && !matches)) {
+    // Done, or corrupt beyond what resuming could fix.
+    if (!renamed) unlink(task->part_path().c_str());
+    unlink(task->state_path().c_str());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  task->finished = Clock::now();
+  if (renamed) {
+    task->md5 = hex;
+    task->state = DownloadState::kDone;
+  } else {
+    task->state = DownloadState::kFailed;
+  }
+}
+
+void DownloadEngine::RetryLater(Task* task, int* attempts,
+                                Clock::time_point* retry_at, int status) {
+  if (IsPermanent(status) || ++*attempts > kMaxAttempts) {
+    Fail(task);
+    return;
+  }
+  *retry_at = Clock::now() + kRetryBase * (1 << (*attempts - 1));
+}
+
+void DownloadEngine::Fail(Task* task) {
+  if (!task->Running()) return;
+  task->state = DownloadState::kFailed;
+  task->finished = Clock::now();
+}
+
+}  // namespace cyrene
+
+namespace {
+
+cyrene::DownloadEngine* Engine() {
+  // Leaked on purpose: workers may still be inside a request at exit.
+  static cyrene::DownloadEngine* engine = new cyrene::DownloadEngine();
+  return engine;
+}
+
+}  // namespace
+
+extern "C" {
+
+int64_t cyrene_download_add(const char* url, const char* path,
+                            const char* referer, const char* expected_md5) {
+  if (url == nullptr || path == nullptr || *path == 0) return 0;
+  cyrene::DownloadOptions options;
+  options.url = url;
+  options.path = path;
+  options.referer = referer ? referer : "";
+  options.expected_md5 = expected_md5 ? expected_md5 : "";
+  return Engine()->Add(std::move(options));
+}
+
+int32_t cyrene_download_progress(int64_t id, int64_t* out, char* md5_hex) {
+  if (out == nullptr) return 0;
+  cyrene::DownloadProgress progress;
+  if (!Engine()->Progress(id, &progress)) return 0;
+  out[0] = static_cast<int64_t>(progress.state);
+  out[1] = static_cast<int64_t>(progress.received);
+  out[2] = static_cast<int64_t>(progress.total);
+  out[3] = static_cast<int64_t>(progress.bytes_per_second);
+  out[4] = progress.http_status;
+  if (md5_hex != nullptr) {
+    std::snprintf(md5_hex, 33, "%s", progress.md5.c_str());
+  }
+  return 1;
+}
+
+void cyrene_download_cancel(int64_t id) {
+  Engine()->Cancel(id);
+}
+
+void cyrene_download_remove(int64_t id) {
+  Engine()->Remove(id);
+}
+
+void cyrene_download_set_limits(int32_t connections, int32_t per_task) {
+  Engine()->SetLimits(connections, per_task);
+}
+
+}  // extern "C"
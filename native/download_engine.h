@@ -0,0 +1,143 @@
+#ifndef CYRENE_NATIVE_DOWNLOAD_ENGINE_H_
+#define CYRENE_NATIVE_DOWNLOAD_ENGINE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native_export.h"
+#include "upstream_client.h"
+
+namespace cyrene {
+
+enum class DownloadState : int32_t {
+  kQueued = 0,
+  kRunning = 1,
+  kVerifying = 2,
+  kDone = 3,
+  kFailed = 4,
+  kCancelled = 5,
+};
+
+struct DownloadOptions {
+  std::string url;
+  std::string path;          // Final file name.
+  std::string referer;       // Sent when not empty.
+  std::string expected_md5;  // Hex; checked when not empty.
+};
+
+struct DownloadProgress {
+  DownloadState state = DownloadState::kQueued;
+  uint64_t received = 0;          // Bytes on disk, including resumed ones.
+  uint64_t total = 0;             // 0 while unknown.
+  uint64_t bytes_per_second = 0;  // Average over this run.
+  int http_status = 0;            // Last status seen, 0 if none.
+  std::string md5;                // Lower-case hex once kDone.
+};
+
+// Segmented, resumable downloads for DownloadService.
+//
+// A task first sends "Range: bytes=0-0" to learn the size and whether the
+// server honours ranges. If it does, the file is split into 1 MB pieces
+// fetched concurrently over pooled keep-alive connections and written in
+// place with pwrite() into "<path>.part". After each piece lands, the data
+// is synced and its bit is set in "<path>.part.state":
+//   "CYDL" | u16 version | u16 validator length | u64 total size |
+//   u32 piece size | validator (ETag or Last-Modified) | piece bitmap
+// so a crash or a cancelled task resumes from the pieces on disk, provided
+// the resource keeps its size and validator (signed URLs may change between
+// runs). A dropped connection retries only the rest of its piece, with
+// backoff. Servers that ignore ranges get a single sequential stream.
+//
+// Finished files are hashed (MD5, checked against the expected digest when
+// one is given) and renamed into place. Tasks form one FIFO queue served by
+// a shared pool of connection slots: at most |connections| requests are in
+// flight overall and |per_task| for any one task, earlier tasks first.
+//
+// All methods are thread-safe and never block on the network.
+class DownloadEngine {
+ public:
+  DownloadEngine();
+  ~DownloadEngine();
+
+  DownloadEngine(const DownloadEngine&) = delete;
+  DownloadEngine& operator=(const DownloadEngine&) = delete;
+
+  // Queues a download and returns its id. A task already queued or running
+  // for the same path is returned instead of a second one.
+  int64_t Add(DownloadOptions options);
+
+  bool Progress(int64_t id, DownloadProgress* progress);
+
+  // Stops a task, keeping its partial file for a later resume.
+  void Cancel(int64_t id);
+
+  // Forgets a task that is no longer running.
+  void Remove(int64_t id);
+
+  void SetLimits(int connections, int per_task);
+
+  static constexpr int kMaxConnections = 16;
+
+ private:
+  struct Piece;
+  struct Task;
+
+  enum class WorkKind { kNone, kProbe, kPiece, kVerify };
+
+  void Run();
+  WorkKind Pick(std::shared_ptr<Task>* task, size_t* piece,
+                std::chrono::steady_clock::time_point* wake);
+  void Probe(const std::shared_ptr<Task>& task);
+  void FetchPiece(const std::shared_ptr<Task>& task, size_t index);
+  void Verify(const std::shared_ptr<Task>& task);
+
+  // Called with |mutex_| held.
+  bool PrepareRanged(Task* task, uint64_t total, const std::string& validator);
+  void RetryLater(Task* task, int* attempts,
+                  std::chrono::steady_clock::time_point* retry_at, int status);
+  void Fail(Task* task);
+
+  UpstreamClient upstream_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::shared_ptr<Task>> tasks_;  // Queue order.
+  std::vector<std::thread> threads_;
+  bool stopping_;
+  int connections_;
+  int per_task_;
+  int active_;
+  int64_t next_id_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/download_engine_native.dart. The engine is
+// process-wide and starts with the first download. |referer| and
+// |expected_md5| may be null. Returns the task id, or 0 on bad arguments.
+CYRENE_EXPORT int64_t cyrene_download_add(const char* url, const char* path,
+                                          const char* referer,
+                                          const char* expected_md5);
+
+// Writes state, received, total, bytes/second and HTTP status to out[0..4]
+// and, once done, the MD5 (32 hex digits plus a terminator) to |md5_hex|.
+// Returns 0 for an unknown id.
+CYRENE_EXPORT int32_t cyrene_download_progress(int64_t id, int64_t* out,
+                                               char* md5_hex);
+
+CYRENE_EXPORT void cyrene_download_cancel(int64_t id);
+CYRENE_EXPORT void cyrene_download_remove(int64_t id);
+CYRENE_EXPORT void cyrene_download_set_limits(int32_t connections,
+                                              int32_t per_task);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_DOWNLOAD_ENGINE_H_
@@ -0,0 +1,74 @@
+#ifndef CYRENE_NATIVE_FD_UTIL_H_
+#define CYRENE_NATIVE_FD_UTIL_H_
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace cyrene {
+
+// Writes all of |data| to |fd|, retrying short writes and EINTR.
+inline bool WriteFully(int fd, const uint8_t* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+// Writes all of |data| to |fd| at |offset| without moving the file position.
+inline bool PWriteFully(int fd, const uint8_t* data, size_t length,
+                        uint64_t offset) {
+  while (length > 0) {
+    ssize_t written = pwrite(fd, data, length, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    offset += static_cast<uint64_t>(written);
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+// Reads exactly |length| bytes from |fd| at |offset|. Fails on a short file.
+inline bool PReadFully(int fd, uint8_t* data, size_t length, uint64_t offset) {
+  while (length > 0) {
+    ssize_t n = pread(fd, data, length, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    offset += static_cast<uint64_t>(n);
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Writes |data| to a temporary file next to |path| and renames it into
+// place, so readers see either no file or the whole of it.
+inline bool WriteFileAtomically(const std::string& path, const uint8_t* data,
+                                size_t length) {
+  std::string temp = path + ".XXXXXX";
+  int fd = mkstemp(&temp[0]);
+  if (fd < 0) return false;
+  bool ok = WriteFully(fd, data, length);
+  ok = close(fd) == 0 && ok;
+  if (ok && std::rename(temp.c_str(), path.c_str()) == 0) return true;
+  std::remove(temp.c_str());
+  return false;
+}
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_FD_UTIL_H_
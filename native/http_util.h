@@ -0,0 +1,39 @@
+#ifndef CYRENE_NATIVE_HTTP_UTIL_H_
+#define CYRENE_NATIVE_HTTP_UTIL_H_
+
+#include <openssl/evp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cyrene {
+
+// For std::unique_ptr<EVP_MD_CTX, DigestDeleter>.
+struct DigestDeleter {
+  void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+};
+
+// Lower-case hex of |data|, as digests are compared and reported.
+inline std::string Hex(const uint8_t* data, size_t length) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string text(length * 2, '0');
+  for (size_t i = 0; i < length; ++i) {
+    text[i * 2] = kHex[data[i] >> 4];
+    text[i * 2 + 1] = kHex[data[i] & 15];
+  }
+  return text;
+}
+
+// ASCII lower-casing for header names, schemes and tokens, independent of
+// the locale.
+inline std::string ToLower(std::string text) {
+  for (char& c : text) {
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+  }
+  return text;
+}
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_HTTP_UTIL_H_
@@ -0,0 +1,71 @@
+#include "icu_loader.h"
+
+#include <dlfcn.h>
+
+#include <cstdio>
+#include <string>
+
+namespace cyrene {
+
+namespace {
+
+// ICU 50 (2012) through releases well past the current one; the newest
+// installed version wins.
+constexpr int kNewestVersion = 99;
+constexpr int kOldestVersion = 50;
+
+// Resolves |name| with the version suffix ICU normally renames symbols
+// with, or without it for builds configured with renaming disabled.
+template <typename F>
+bool Resolve(void* library, const char* name, int version, F* function) {
+  std::string versioned = std::string(name) + "_" + std::to_string(version);
+  void* symbol = dlsym(library, versioned.c_str());
+  if (symbol == nullptr) symbol = dlsym(library, name);
+  *function = reinterpret_cast<F>(symbol);
+  return symbol != nullptr;
+}
+
+bool Load(int version, IcuApi* api) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "libicuuc.so.%d", version);
+  void* uc = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+  if (uc == nullptr) return false;
+  std::snprintf(name, sizeof(name), "libicui18n.so.%d", version);
+  void* i18n = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+  if (i18n == nullptr) {
+    dlclose(uc);
+    return false;
+  }
+  bool ok =
+      Resolve(uc, "u_isalnum", version, &api->isalnum) &&
+      Resolve(uc, "u_strFromUTF8WithSub", version,
+              &api->str_from_utf8_with_sub) &&
+      Resolve(uc, "unorm2_getNFKCCasefoldInstance", version,
+              &api->nfkc_casefold_instance) &&
+      Resolve(uc, "unorm2_normalize", version, &api->normalize) &&
+      Resolve(uc, "unorm2_spanQuickCheckYes", version,
+              &api->span_quick_check_yes) &&
+      Resolve(i18n, "utrans_openU", version, &api->trans_open) &&
+      Resolve(i18n, "utrans_close", version, &api->trans_close) &&
+      Resolve(i18n, "utrans_transUChars", version, &api->trans_uchars);
+  if (!ok) {
+    dlclose(i18n);
+    dlclose(uc);
+  }
+  return ok;
+}
+
+}  // namespace
+
+const IcuApi* Icu() {
+  static const IcuApi* api = []() -> const IcuApi* {
+    static IcuApi loaded;
+    for (int version = kNewestVersion; version >= kOldestVersion; --version) {
+      if (Load(version, &loaded)) return &loaded;
+    }
+    return nullptr;
+  }();
+  return api;
+}
+
+}  // namespace cyrene
@@ -0,0 +1,57 @@
+#ifndef CYRENE_NATIVE_ICU_LOADER_H_
+#define CYRENE_NATIVE_ICU_LOADER_H_
+
+#include <cstdint>
+
+namespace cyrene {
+
+// The parts of ICU's C API that text folding and pinyin use, loaded with
+// dlopen so the library neither links against ICU nor needs its headers.
+// ICU's SONAMEs (libicuuc.so.72) and symbol names (u_isalnum_72) carry the
+// major version, which differs between distributions, so the newest
+// installed version is probed for at first use.
+//
+// Only opaque pointers and these ABI-stable types are used: UErrorCode is
+// an int (> 0 is a failure), UChar is char16_t and UBool is int8_t.
+constexpr int kIcuZeroError = 0;
+constexpr int kIcuBufferOverflowError = 15;
+
+inline bool IcuFailure(int status) { return status > kIcuZeroError; }
+
+struct IcuParseError {
+  int32_t line;
+  int32_t offset;
+  char16_t pre_context[16];
+  char16_t post_context[16];
+};
+
+struct IcuApi {
+  // libicuuc
+  int8_t (*isalnum)(int32_t c);
+  char16_t* (*str_from_utf8_with_sub)(char16_t* dest, int32_t capacity,
+                                      int32_t* length, const char* src,
+                                      int32_t src_length, int32_t sub,
+                                      int32_t* substitutions, int* status);
+  const void* (*nfkc_casefold_instance)(int* status);
+  int32_t (*normalize)(const void* normalizer, const char16_t* src,
+                       int32_t length, char16_t* dest, int32_t capacity,
+                       int* status);
+  int32_t (*span_quick_check_yes)(const void* normalizer, const char16_t* s,
+                                  int32_t length, int* status);
+  // libicui18n
+  void* (*trans_open)(const char16_t* id, int32_t id_length, int direction,
+                      const char16_t* rules, int32_t rules_length,
+                      IcuParseError* parse_error, int* status);
+  void (*trans_close)(void* transliterator);
+  void (*trans_uchars)(const void* transliterator, char16_t* text,
+                       int32_t* length, int32_t capacity, int32_t start,
+                       int32_t* limit, int* status);
+};
+
+// Null when no supported ICU version is installed; callers fall back to
+// what they can do without it. The result is computed once per process.
+const IcuApi* Icu();
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_ICU_LOADER_H_
@@ -0,0 +1,166 @@
+#include "image_codec.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>  // Before jpeglib.h, which uses FILE
+#include <cstdlib>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <png.h>
+
+namespace cyrene {
+
+namespace {
+
+constexpr uint64_t kMaxPixels = 40u * 1000 * 1000;
+
+struct JpegError {
+  jpeg_error_mgr manager;
+  jmp_buf jump;
+};
+
+void JpegErrorExit(j_common_ptr info) {
+  longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+}
+
+void JpegSilence(j_common_ptr) {}
+
+bool DecodeJpeg(const uint8_t* data, size_t size, int min_short_side,
+                DecodedImage* image) {
+  jpeg_decompress_struct info;
+  JpegError error;
+  info.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  error.manager.output_message = JpegSilence;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, const_cast<uint8_t*>(data),
+               static_cast<unsigned long>(size));
+  jpeg_read_header(&info, TRUE);
+  // libjpeg cannot convert these to RGB.
+  if (info.jpeg_color_space == JCS_CMYK ||
+      info.jpeg_color_space == JCS_YCCK) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  unsigned denominator = 1;
+  if (min_short_side > 0) {
+    unsigned short_side = std::min(info.image_width, info.image_height);
+    denominator = 8;
+    while (denominator > 1 &&
+           short_side / denominator < static_cast<unsigned>(min_short_side)) {
+      denominator /= 2;
+    }
+  }
+  info.scale_num = 1;
+  info.scale_denom = denominator;
+  info.out_color_space = JCS_RGB;
+  info.dct_method = JDCT_IFAST;
+  info.do_fancy_upsampling = FALSE;
+  jpeg_calc_output_dimensions(&info);
+  if (static_cast<uint64_t>(info.output_width) * info.output_height >
+      kMaxPixels) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+  jpeg_start_decompress(&info);
+
+  image->width = static_cast<int>(info.output_width);
+  image->height = static_cast<int>(info.output_height);
+  image->channels = 3;
+  image->pixels.resize(static_cast<size_t>(image->width) * image->height * 3);
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = image->pixels.data() +
+                   static_cast<size_t>(info.output_scanline) * image->width * 3;
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  return true;
+}
+
+bool DecodePng(const uint8_t* data, size_t size, DecodedImage* image) {
+  png_image png;
+  std::memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&png, data, size)) return false;
+  if (static_cast<uint64_t>(png.width) * png.height > kMaxPixels) {
+    png_image_free(&png);
+    return false;
+  }
+  png.format = PNG_FORMAT_RGBA;
+  image->width = static_cast<int>(png.width);
+  image->height = static_cast<int>(png.height);
+  image->channels = 4;
+  image->pixels.resize(PNG_IMAGE_SIZE(png));
+  if (!png_image_finish_read(&png, nullptr, image->pixels.data(), 0,
+                             nullptr)) {
+    png_image_free(&png);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool EncodeJpeg(const uint8_t* rgba, int width, int height, int quality,
+                std::vector<uint8_t>* out) {
+  jpeg_compress_struct info;
+  JpegError error;
+  unsigned char* buffer = nullptr;
+  unsigned long size = 0;
+  // Declared before setjmp(), which skips destructors on the way back.
+  std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+  info.err = jpeg_std_error(&error.manager);
+  error.manager.error_exit = JpegErrorExit;
+  error.manager.output_message = JpegSilence;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_compress(&info);
+    std::free(buffer);
+    return false;
+  }
+
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &buffer, &size);
+  info.image_width = static_cast<JDIMENSION>(width);
+  info.image_height = static_cast<JDIMENSION>(height);
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, quality, TRUE);
+  jpeg_start_compress(&info, TRUE);
+
+  while (info.next_scanline < info.image_height) {
+    const uint8_t* in =
+        rgba + static_cast<size_t>(info.next_scanline) * width * 4;
+    for (int x = 0; x < width; ++x) {
+      std::memcpy(&row[x * 3], in + x * 4, 3);
+    }
+    JSAMPROW pointer = row.data();
+    jpeg_write_scanlines(&info, &pointer, 1);
+  }
+  jpeg_finish_compress(&info);
+  out->assign(buffer, buffer + size);
+  jpeg_destroy_compress(&info);
+  std::free(buffer);
+  return true;
+}
+
+bool DecodeImage(const uint8_t* data, size_t size, int min_short_side,
+                 DecodedImage* image) {
+  if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+    return DecodeJpeg(data, size, min_short_side, image);
+  }
+  if (size >= 8 && !png_sig_cmp(data, 0, 8)) {
+    return DecodePng(data, size, image);
+  }
+  return false;
+}
+
+}  // namespace cyrene
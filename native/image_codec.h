@@ -0,0 +1,32 @@
+#ifndef CYRENE_NATIVE_IMAGE_CODEC_H_
+#define CYRENE_NATIVE_IMAGE_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cyrene {
+
+// Decoded pixels, rows packed: RGB for JPEG, RGBA for PNG.
+struct DecodedImage {
+  std::vector<uint8_t> pixels;
+  int width = 0;
+  int height = 0;
+  int channels = 3;
+};
+
+// Decodes a JPEG or PNG cover. JPEGs are decoded with the largest DCT
+// scaling (1/2, 1/4 or 1/8) that keeps the short side at least
+// |min_short_side| pixels, or at full size when it is 0; PNGs are always
+// decoded at full size. Returns false for other formats, CMYK JPEGs,
+// corrupt data and images over 40 megapixels.
+bool DecodeImage(const uint8_t* data, size_t size, int min_short_side,
+                 DecodedImage* image);
+
+// Encodes packed RGBA pixels (alpha ignored) as a baseline JPEG.
+bool EncodeJpeg(const uint8_t* rgba, int width, int height, int quality,
+                std::vector<uint8_t>* out);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_IMAGE_CODEC_H_
@@ -0,0 +1,588 @@
+#include "library_scanner.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+constexpr char kIndexMagic[4] = {'C', 'Y', 'L', 'I'};
+constexpr uint16_t kIndexVersion = 1;
+
+// Files handed to a worker at a time: large enough to amortize the deque
+// locking, small enough that a big folder still spreads over all workers.
+constexpr size_t kFileBatch = 64;
+
+// Same list as LocalLibraryService.supportedAudioExts.
+constexpr const char* kAudioExtensions[] = {
+    "mp3", "wav", "flac", "aac", "m4a", "ogg", "opus", "ape", "wma", "alac",
+};
+
+bool IsAudioFile(const std::string& name) {
+  size_t dot = name.rfind('.');
+  if (dot == std::string::npos || dot == 0) return false;
+  const char* extension = name.c_str() + dot + 1;
+  for (const char* candidate : kAudioExtensions) {
+    if (!strcasecmp(extension, candidate)) return true;
+  }
+  return false;
+}
+
+bool EndsWith(const std::string& s, const char* suffix) {
+  size_t n = std::strlen(suffix);
+  return s.size() >= n && !s.compare(s.size() - n, n, suffix);
+}
+
+std::string Stem(const std::string& name) {
+  size_t dot = name.rfind('.');
+  return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+int64_t MtimeNs(const struct stat& st) {
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+         st.st_mtim.tv_nsec;
+}
+
+// Names of the "*.lrc" files in |directory|.
+void ListLyrics(const std::string& directory,
+                std::unordered_set<std::string>* names) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) return;
+  while (dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (EndsWith(name, ".lrc")) names->insert(std::move(name));
+  }
+  closedir(dir);
+}
+
+void PutString(std::vector<uint8_t>* out, const std::string& s) {
+  size_t length = std::min<size_t>(s.size(), UINT16_MAX);
+  size_t at = out->size();
+  out->resize(at + 2 + length);
+  format::WriteU16(out->data() + at, static_cast<uint16_t>(length));
+  std::memcpy(out->data() + at + 2, s.data(), length);
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+  size_t at = out->size();
+  out->resize(at + 4);
+  format::WriteU32(out->data() + at, value);
+}
+
+void PutU64(std::vector<uint8_t>* out, uint64_t value) {
+  size_t at = out->size();
+  out->resize(at + 8);
+  format::WriteU64(out->data() + at, value);
+}
+
+uint32_t ClampDuration(int64_t duration_ms) {
+  return static_cast<uint32_t>(
+      std::clamp<int64_t>(duration_ms, 0, UINT32_MAX));
+}
+
+// Bounds-checked reader over a loaded index file.
+class Cursor {
+ public:
+  Cursor(const uint8_t* data, size_t length) : p_(data), end_(data + length) {}
+
+  bool Skip(size_t n) {
+    if (static_cast<size_t>(end_ - p_) < n) return false;
+    p_ += n;
+    return true;
+  }
+  bool U16(uint16_t* v) {
+    if (end_ - p_ < 2) return false;
+    *v = format::ReadU16(p_);
+    p_ += 2;
+    return true;
+  }
+  bool U32(uint32_t* v) {
+    if (end_ - p_ < 4) return false;
+    *v = format::ReadU32(p_);
+    p_ += 4;
+    return true;
+  }
+  bool U64(uint64_t* v) {
+    if (end_ - p_ < 8) return false;
+    *v = format::ReadU64(p_);
+    p_ += 8;
+    return true;
+  }
+  bool String(std::string* s) {
+    uint16_t length;
+    if (!U16(&length) || end_ - p_ < length) return false;
+    s->assign(reinterpret_cast<const char*>(p_), length);
+    p_ += length;
+    return true;
+  }
+
+ private:
+  const uint8_t* p_;
+  const uint8_t* end_;
+};
+
+// Fills |entry| for the regular file |path|, from |index| when its identity
+// is unchanged, else from the file headers. False if it is not a file.
+bool ReadEntry(std::string path, const LibraryIndex& index,
+               LibraryEntry* entry, bool* reused) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+  entry->path = std::move(path);
+  entry->inode = static_cast<uint64_t>(st.st_ino);
+  entry->size = static_cast<uint64_t>(st.st_size);
+  entry->mtime_ns = MtimeNs(st);
+
+  if (const LibraryEntry* known = index.Find(entry->path, entry->inode,
+                                             entry->size, entry->mtime_ns)) {
+    entry->tags = known->tags;
+    *reused = true;
+    return true;
+  }
+  int fd = open(entry->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    ReadAudioTags(fd, entry->size, &entry->tags);
+    close(fd);
+  }
+  *reused = false;
+  return true;
+}
+
+// Sidecar lyric of a single file, probed on disk (the scan matches them
+// against directory listings instead).
+std::string FindSidecarLyric(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if (slash == std::string::npos) return {};
+  std::string directory = path.substr(0, slash);
+  std::string lyric = Stem(path.substr(slash + 1)) + ".lrc";
+  for (std::string candidate :
+       {directory + "/" + lyric, directory + "/Lyrics/" + lyric}) {
+    if (access(candidate.c_str(), R_OK) == 0) return candidate;
+  }
+  return {};
+}
+
+// A directory to list, or a batch of files (with their resolved lyric paths)
+// to stat and read.
+struct ScanTask {
+  std::string directory;
+  std::vector<std::pair<std::string, std::string>> files;
+};
+
+class ScanPool {
+ public:
+  ScanPool(const LibraryIndex& index, size_t threads)
+      : index_(index), workers_(threads) {}
+
+  void Run(const std::string& root) {
+    Push(0, ScanTask{root, {}});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      threads.emplace_back(&ScanPool::Work, this, i);
+    }
+    Work(0);
+    for (std::thread& thread : threads) thread.join();
+  }
+
+  std::vector<LibraryEntry> TakeResults(LibraryScanStats* stats) {
+    std::vector<LibraryEntry> results;
+    size_t total = 0;
+    for (Worker& worker : workers_) total += worker.results.size();
+    results.reserve(total);
+    for (Worker& worker : workers_) {
+      std::move(worker.results.begin(), worker.results.end(),
+                std::back_inserter(results));
+      stats->files += worker.stats.files;
+      stats->parsed += worker.stats.parsed;
+      stats->reused += worker.stats.reused;
+      stats->directories += worker.stats.directories;
+    }
+    return results;
+  }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<ScanTask> tasks;
+    // Touched only by the owning thread until the scan has finished.
+    std::vector<LibraryEntry> results;
+    LibraryScanStats stats;
+  };
+
+  void Push(size_t self, ScanTask task) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(workers_[self].mutex);
+    workers_[self].tasks.push_back(std::move(task));
+  }
+
+  // Own work is taken newest first (depth first, cache-warm directories);
+  // stolen work oldest first, which tends to be the biggest subtrees.
+  bool Take(size_t self, ScanTask* task) {
+    {
+      Worker& own = workers_[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        *task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      Worker& victim = workers_[(self + i) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        *task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Work(size_t self) {
+    int idle = 0;
+    // A task in flight can still spawn more, so workers only stop once
+    // nothing is queued or running.
+    while (pending_.load(std::memory_order_acquire) > 0) {
+      ScanTask task;
+      if (!Take(self, &task)) {
+        if (++idle < 64) {
+          std::this_thread::yield();
+        } else {
+          std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        continue;
+      }
+      idle = 0;
+      if (!task.directory.empty()) {
+        ListDirectory(self, task.directory);
+      } else {
+        for (auto& file : task.files) {
+          ReadFile(self, std::move(file.first), std::move(file.second));
+        }
+      }
+      pending_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  void ListDirectory(size_t self, const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) return;
+    ++workers_[self].stats.directories;
+
+    std::vector<std::string> audio;
+    std::unordered_set<std::string> lyrics;
+    bool has_lyrics_directory = false;
+    while (dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..") continue;
+
+      unsigned char type = entry->d_type;
+      if (type == DT_UNKNOWN || type == DT_LNK) {
+        // Symlinked files are followed, symlinked directories are not (they
+        // can form cycles).
+        struct stat st;
+        int flags = type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+        if (fstatat(dirfd(dir), name.c_str(), &st, flags) != 0) continue;
+        type = S_ISREG(st.st_mode)                        ? DT_REG
+               : S_ISDIR(st.st_mode) && type != DT_LNK ? DT_DIR
+                                                          : DT_UNKNOWN;
+      }
+
+      if (type == DT_DIR) {
+        if (name == "Lyrics") has_lyrics_directory = true;
+        Push(self, ScanTask{path + "/" + name, {}});
+      } else if (type == DT_REG) {
+        if (IsAudioFile(name)) {
+          audio.push_back(std::move(name));
+        } else if (EndsWith(name, ".lrc")) {
+          lyrics.insert(std::move(name));
+        }
+      }
+    }
+    closedir(dir);
+    if (audio.empty()) return;
+
+    // Sidecar lyrics are matched against the listings instead of probing
+    // two paths per file.
+    std::unordered_set<std::string> nested_lyrics;
+    if (has_lyrics_directory) ListLyrics(path + "/Lyrics", &nested_lyrics);
+
+    ScanTask batch;
+    for (std::string& name : audio) {
+      std::string lyric = Stem(name) + ".lrc";
+      std::string lyric_path;
+      if (lyrics.count(lyric)) {
+        lyric_path = path + "/" + lyric;
+      } else if (nested_lyrics.count(lyric)) {
+        lyric_path = path + "/Lyrics/" + lyric;
+      }
+      batch.files.emplace_back(path + "/" + name, std::move(lyric_path));
+      if (batch.files.size() == kFileBatch) {
+        Push(self, std::move(batch));
+        batch = ScanTask();
+      }
+    }
+    if (!batch.files.empty()) Push(self, std::move(batch));
+  }
+
+  void ReadFile(size_t self, std::string path, std::string lyric_path) {
+    Worker& worker = workers_[self];
+    LibraryEntry entry;
+    bool reused;
+    if (!ReadEntry(std::move(path), index_, &entry, &reused)) return;
+    entry.lyric_path = std::move(lyric_path);
+    ++(reused ? worker.stats.reused : worker.stats.parsed);
+    ++worker.stats.files;
+    worker.results.push_back(std::move(entry));
+  }
+
+  const LibraryIndex& index_;
+  std::vector<Worker> workers_;
+  std::atomic<size_t> pending_{0};
+};
+
+struct LibraryScanResult {
+  std::vector<uint8_t> data;
+};
+
+// Serializes a result in the layout documented for cyrene_library_scan().
+LibraryScanResult* EncodeScanResult(const std::vector<LibraryEntry>& entries,
+                                    const LibraryScanStats& stats) {
+  auto* result = new LibraryScanResult();
+  std::vector<uint8_t>& data = result->data;
+  PutU32(&data, stats.files);
+  PutU32(&data, stats.parsed);
+  PutU32(&data, stats.reused);
+  PutU32(&data, stats.directories);
+  for (const LibraryEntry& entry : entries) {
+    PutString(&data, entry.path);
+    PutString(&data, entry.tags.title);
+    PutString(&data, entry.tags.artist);
+    PutString(&data, entry.tags.album);
+    PutString(&data, entry.lyric_path);
+    PutU32(&data, ClampDuration(entry.tags.duration_ms));
+  }
+  return result;
+}
+
+}  // namespace
+
+bool LibraryIndex::Load(const std::string& path) {
+  entries_.clear();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  std::vector<uint8_t> data;
+  bool read = fstat(fd, &st) == 0;
+  if (read) {
+    data.resize(static_cast<size_t>(st.st_size));
+    read = PReadFully(fd, data.data(), data.size(), 0);
+  }
+  close(fd);
+  if (!read) return false;
+
+  Cursor cursor(data.data(), data.size());
+  uint16_t version;
+  uint32_t count;
+  if (data.size() < 4 || std::memcmp(data.data(), kIndexMagic, 4) != 0 ||
+      !cursor.Skip(4) || !cursor.U16(&version) || version != kIndexVersion ||
+      !cursor.U32(&count)) {
+    return false;
+  }
+  entries_.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    LibraryEntry entry;
+    uint64_t mtime_ns;
+    uint32_t duration_ms;
+    if (!cursor.U64(&entry.inode) || !cursor.U64(&entry.size) ||
+        !cursor.U64(&mtime_ns) || !cursor.U32(&duration_ms) ||
+        !cursor.String(&entry.path) || !cursor.String(&entry.tags.title) ||
+        !cursor.String(&entry.tags.artist) ||
+        !cursor.String(&entry.tags.album)) {
+      entries_.clear();
+      return false;
+    }
+    entry.mtime_ns = static_cast<int64_t>(mtime_ns);
+    entry.tags.duration_ms = duration_ms;
+    std::string key = entry.path;
+    entries_.emplace(std::move(key), std::move(entry));
+  }
+  return true;
+}
+
+bool LibraryIndex::Save(const std::string& path) const {
+  std::vector<uint8_t> data(kIndexMagic, kIndexMagic + 4);
+  data.resize(10);
+  format::WriteU16(data.data() + 4, kIndexVersion);
+  format::WriteU32(data.data() + 6, static_cast<uint32_t>(entries_.size()));
+  for (const auto& item : entries_) {
+    const LibraryEntry& entry = item.second;
+    PutU64(&data, entry.inode);
+    PutU64(&data, entry.size);
+    PutU64(&data, static_cast<uint64_t>(entry.mtime_ns));
+    PutU32(&data, ClampDuration(entry.tags.duration_ms));
+    PutString(&data, entry.path);
+    PutString(&data, entry.tags.title);
+    PutString(&data, entry.tags.artist);
+    PutString(&data, entry.tags.album);
+  }
+
+  std::string temp_path = path + ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if (fd < 0) return false;
+  bool written = WriteFully(fd, data.data(), data.size());
+  if (close(fd) != 0 || !written ||
+      rename(temp_path.c_str(), path.c_str()) != 0) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+const LibraryEntry* LibraryIndex::Find(const std::string& path, uint64_t inode,
+                                       uint64_t size, int64_t mtime_ns) const {
+  auto it = entries_.find(path);
+  if (it == entries_.end() || it->second.inode != inode ||
+      it->second.size != size || it->second.mtime_ns != mtime_ns) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void LibraryIndex::ReplaceUnder(const std::string& root,
+                                const std::vector<LibraryEntry>& entries) {
+  std::string prefix = root + "/";
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->first.compare(0, prefix.size(), prefix) == 0) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const LibraryEntry& entry : entries) {
+    LibraryEntry stored = entry;
+    stored.lyric_path.clear();
+    entries_[entry.path] = std::move(stored);
+  }
+}
+
+std::vector<LibraryEntry> ScanLibrary(const std::string& root,
+                                      const LibraryIndex& index, int threads,
+                                      LibraryScanStats* stats) {
+  *stats = LibraryScanStats();
+  std::string directory = root;
+  while (directory.size() > 1 && directory.back() == '/') directory.pop_back();
+
+  size_t workers = threads > 0
+                       ? static_cast<size_t>(threads)
+                       : std::max(2u, std::thread::hardware_concurrency());
+  ScanPool pool(index, workers);
+  pool.Run(directory);
+  std::vector<LibraryEntry> entries = pool.TakeResults(stats);
+  std::sort(entries.begin(), entries.end(),
+            [](const LibraryEntry& a, const LibraryEntry& b) {
+              return a.path < b.path;
+            });
+  return entries;
+}
+
+std::vector<LibraryEntry> ReadLibraryFiles(
+    const std::vector<std::string>& paths, const LibraryIndex& index,
+    LibraryScanStats* stats) {
+  *stats = LibraryScanStats();
+  std::vector<LibraryEntry> entries;
+  entries.reserve(paths.size());
+  for (const std::string& path : paths) {
+    LibraryEntry entry;
+    bool reused;
+    if (!ReadEntry(path, index, &entry, &reused)) continue;
+    entry.lyric_path = FindSidecarLyric(entry.path);
+    ++(reused ? stats->reused : stats->parsed);
+    ++stats->files;
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_library_scan(const char* root, const char* index_path,
+                          int32_t threads) {
+  if (root == nullptr) return nullptr;
+  struct stat st;
+  if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+
+  cyrene::LibraryIndex index;
+  if (index_path != nullptr) index.Load(index_path);
+
+  cyrene::LibraryScanStats stats;
+  std::vector<cyrene::LibraryEntry> entries =
+      cyrene::ScanLibrary(root, index, threads, &stats);
+
+  if (index_path != nullptr) {
+    std::string directory = root;
+    while (directory.size() > 1 && directory.back() == '/') {
+      directory.pop_back();
+    }
+    index.ReplaceUnder(directory, entries);
+    index.Save(index_path);
+  }
+
+  return cyrene::EncodeScanResult(entries, stats);
+}
+
+void* cyrene_library_read(const uint8_t* paths, int64_t length) {
+  // NUL-separated UTF-8 paths.
+  std::vector<std::string> list;
+  if (paths != nullptr && length > 0) {
+    const char* p = reinterpret_cast<const char*>(paths);
+    const char* end = p + length;
+    while (p < end) {
+      const char* nul = static_cast<const char*>(std::memchr(p, 0, end - p));
+      if (nul == nullptr) nul = end;
+      if (nul > p) list.emplace_back(p, nul);
+      p = nul + 1;
+    }
+  }
+  cyrene::LibraryIndex index;
+  cyrene::LibraryScanStats stats;
+  return cyrene::EncodeScanResult(
+      cyrene::ReadLibraryFiles(list, index, &stats), stats);
+}
+
+const uint8_t* cyrene_library_scan_data(void* handle, int64_t* length) {
+  auto* result = static_cast<cyrene::LibraryScanResult*>(handle);
+  if (result == nullptr) {
+    if (length != nullptr) *length = 0;
+    return nullptr;
+  }
+  if (length != nullptr) *length = static_cast<int64_t>(result->data.size());
+  return result->data.data();
+}
+
+void cyrene_library_scan_free(void* handle) {
+  delete static_cast<cyrene::LibraryScanResult*>(handle);
+}
+
+}  // extern "C"
@@ -0,0 +1,108 @@
+#ifndef CYRENE_NATIVE_LIBRARY_SCANNER_H_
+#define CYRENE_NATIVE_LIBRARY_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "audio_tags.h"
+#include "native_export.h"
+
+namespace cyrene {
+
+// One audio file of the local library.
+struct LibraryEntry {
+  std::string path;
+  uint64_t inode = 0;
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+  AudioTags tags;
+  // "<stem>.lrc" next to the file or in a "Lyrics" subdirectory; empty when
+  // there is none. Resolved on every scan, never stored in the index.
+  std::string lyric_path;
+};
+
+// Tags of previously scanned files keyed by path, persisted between runs so
+// a rescan only opens files whose (inode, mtime, size) changed.
+//
+// On disk, big-endian:
+//   "CYLI" | u16 version | u32 count |
+//   count x (u64 inode | u64 size | u64 mtime_ns | u32 duration_ms |
+//            u16-length-prefixed path, title, artist, album)
+//
+// The index is a cache: a missing, truncated or unknown file loads as empty.
+class LibraryIndex {
+ public:
+  bool Load(const std::string& path);
+  // Writes to "<path>.tmp" and renames over |path|.
+  bool Save(const std::string& path) const;
+
+  // The stored entry for |path| if its identity still matches, else null.
+  const LibraryEntry* Find(const std::string& path, uint64_t inode,
+                           uint64_t size, int64_t mtime_ns) const;
+
+  // Replaces every entry under the directory |root| with |entries|; entries
+  // of other roots are kept.
+  void ReplaceUnder(const std::string& root,
+                    const std::vector<LibraryEntry>& entries);
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  std::unordered_map<std::string, LibraryEntry> entries_;
+};
+
+struct LibraryScanStats {
+  uint32_t files = 0;
+  uint32_t parsed = 0;  // Files whose headers were read
+  uint32_t reused = 0;  // Files answered from the index
+  uint32_t directories = 0;
+};
+
+// Recursively scans |root| for audio files with |threads| workers (0 picks
+// the hardware concurrency). Directory listings and batches of files are
+// tasks on per-worker deques; idle workers steal from the others, so one
+// huge folder or a slow disk subtree does not serialize the scan. Symlinks
+// to files are followed and scanned as the files they point to; symlinks to
+// directories are skipped, so link cycles cannot recurse.
+//
+// Files matching |index| are reused without being opened. The result is
+// sorted by path.
+std::vector<LibraryEntry> ScanLibrary(const std::string& root,
+                                      const LibraryIndex& index, int threads,
+                                      LibraryScanStats* stats);
+
+// Reads the given files (e.g. ones a watcher reported as added), resolving
+// their sidecar lyrics on disk. Paths that are not regular files are
+// skipped; the result keeps the order of |paths|.
+std::vector<LibraryEntry> ReadLibraryFiles(
+    const std::vector<std::string>& paths, const LibraryIndex& index,
+    LibraryScanStats* stats);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/library_scanner_native.dart. Scans |root|,
+// reusing and then updating the index at |index_path| (may be null). The
+// returned handle must be released with cyrene_library_scan_free(); its data
+// stays valid until then:
+//   u32 files | u32 parsed | u32 reused | u32 directories |
+//   files x (u16-length-prefixed path, title, artist, album, lyric path |
+//            u32 duration_ms)
+// (big-endian). Returns null if |root| cannot be opened.
+CYRENE_EXPORT void* cyrene_library_scan(const char* root,
+                                        const char* index_path,
+                                        int32_t threads);
+// Same for the NUL-separated UTF-8 |paths| (see ReadLibraryFiles), without
+// an index; never returns null.
+CYRENE_EXPORT void* cyrene_library_read(const uint8_t* paths, int64_t length);
+CYRENE_EXPORT const uint8_t* cyrene_library_scan_data(void* handle,
+                                                      int64_t* length);
+CYRENE_EXPORT void cyrene_library_scan_free(void* handle);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_LIBRARY_SCANNER_H_
@@ -0,0 +1,937 @@
+#include "loopback_proxy.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "fd_util.h"
+#include "http_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// Upstream fetch window: consecutive missing segments requested at once
+// (4 MB), which keeps request overhead low without over-fetching on seeks.
+constexpr uint32_t kFetchWindowSegments = 64;
+
+// How far ahead of a playing client the next window is requested, so that
+// playback does not stall at window boundaries.
+constexpr uint32_t kReadAheadSegments = 16;
+
+// Decrypted bytes produced per step when serving a .cyrene cache file.
+constexpr size_t kFileChunkSize = 256 * 1024;
+
+constexpr int kWorkerCount = 4;
+constexpr size_t kMaxRequestSize = 16 * 1024;
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+std::string PercentDecode(const std::string& text) {
+  std::string decoded;
+  decoded.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '%' && i + 2 < text.size() &&
+        HexValue(text[i + 1]) >= 0 && HexValue(text[i + 2]) >= 0) {
+      decoded += static_cast<char>(HexValue(text[i + 1]) * 16 +
+                                   HexValue(text[i + 2]));
+      i += 2;
+    } else if (text[i] == '+') {
+      decoded += ' ';
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+std::map<std::string, std::string> ParseQuery(const std::string& query) {
+  std::map<std::string, std::string> params;
+  size_t start = 0;
+  while (start <= query.size()) {
+    size_t end = query.find('&', start);
+    if (end == std::string::npos) end = query.size();
+    std::string pair = query.substr(start, end - start);
+    size_t equals = pair.find('=');
+    if (!pair.empty()) {
+      if (equals == std::string::npos) {
+        params[PercentDecode(pair)] = std::string();
+      } else {
+        params[PercentDecode(pair.substr(0, equals))] =
+            PercentDecode(pair.substr(equals + 1));
+      }
+    }
+    start = end + 1;
+  }
+  return params;
+}
+
+// Default cache key: FNV-1a of the URL without its query string, which for
+// the CDNs holds the expiring signature.
+std::string UrlKey(const std::string& url) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : url.substr(0, url.find('?'))) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  char key[24];
+  std::snprintf(key, sizeof(key), "u%016" PRIx64, hash);
+  return key;
+}
+
+// Same magic-number sniffing as ProxyService._sniffContentType.
+std::string SniffContentType(const CyreneFile& file) {
+  uint8_t head[12] = {0};
+  int64_t count = file.ReadAudio(0, head, sizeof(head));
+  if (count >= 4) {
+    if (std::memcmp(head, "fLaC", 4) == 0) return "audio/flac";
+    if (std::memcmp(head, "OggS", 4) == 0) return "audio/ogg";
+    if (std::memcmp(head, "RIFF", 4) == 0) return "audio/wav";
+  }
+  if (count >= 8 && std::memcmp(head + 4, "ftyp", 4) == 0) return "audio/mp4";
+  return "audio/mpeg";
+}
+
+const char* RefererFor(const std::string& platform) {
+  if (platform == "qq") return "https://y.qq.com";
+  if (platform == "kugou") return "https://www.kugou.com";
+  return nullptr;
+}
+
+}  // namespace
+
+struct LoopbackProxy::Client {
+  enum class State { kRequest, kHead, kBody, kClosing };
+
+  explicit Client(int socket) : fd(socket) {}
+  ~Client() { close(fd); }
+
+  const int fd;
+  State state = State::kRequest;
+  bool dead = false;
+  bool waiting = false;
+  bool want_write = false;
+
+  std::string input;
+  std::string output;
+  size_t output_offset = 0;
+
+  // Current request.
+  bool head_only = false;
+  bool keep_alive = true;
+  std::shared_ptr<SegmentEntry> entry;
+  std::string platform;
+  // Set instead of |entry| when an encrypted .cyrene file is being served.
+  std::unique_ptr<CyreneFile> file;
+  std::string file_content_type;
+  bool has_range = false;
+  uint64_t range_first = 0;
+  uint64_t range_last = UINT64_MAX;  // Inclusive; open-ended by default.
+  uint64_t suffix_length = 0;        // "bytes=-N".
+
+  // Body progress, as absolute resource offsets.
+  uint64_t position = 0;
+  uint64_t end = 0;
+
+  // Segment whose fetch this client triggered last; if it is still missing
+  // once that fetch is over, the upstream failed and the client gives up.
+  int64_t scheduled_segment = -1;
+};
+
+LoopbackProxy::LoopbackProxy(std::string cache_directory)
+    : cache_(std::move(cache_directory)),
+      prefetch_(&cache_,
+                [this](const std::shared_ptr<SegmentEntry>& entry,
+                       const std::string& platform, uint32_t first,
+                       uint32_t last) {
+                  Fetch(FetchJob{entry, platform, first, last});
+                }),
+      listen_fd_(-1),
+      epoll_fd_(-1),
+      wake_fd_(-1),
+      port_(0),
+      stopping_(false) {}
+
+LoopbackProxy::~LoopbackProxy() {
+  Stop();
+}
+
+bool LoopbackProxy::Start() {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) return false;
+
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t length = sizeof(address);
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+                  &length) != 0) {
+    Stop();
+    return false;
+  }
+  port_ = ntohs(address.sin_port);
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    Stop();
+    return false;
+  }
+  for (int fd : {listen_fd_, wake_fd_}) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      Stop();
+      return false;
+    }
+  }
+
+  loop_thread_ = std::thread(&LoopbackProxy::RunLoop, this);
+  for (int i = 0; i < kWorkerCount; ++i) {
+    workers_.emplace_back(&LoopbackProxy::RunWorker, this);
+  }
+  prefetch_.Start();
+  return true;
+}
+
+void LoopbackProxy::Stop() {
+  stopping_ = true;
+  if (wake_fd_ >= 0) Wake();
+  jobs_cv_.notify_all();
+  prefetch_.Stop();
+
+  if (loop_thread_.joinable()) loop_thread_.join();
+  for (std::thread& worker : workers_) worker.join();
+  workers_.clear();
+  jobs_.clear();
+  clients_.clear();
+  upstream_.CloseIdle();
+
+  for (int* fd : {&listen_fd_, &epoll_fd_, &wake_fd_}) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+  }
+}
+
+void LoopbackProxy::Wake() {
+  uint64_t one = 1;
+  ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+  (void)ignored;
+}
+
+void LoopbackProxy::RunLoop() {
+  struct epoll_event events[64];
+  while (!stopping_) {
+    int count = epoll_wait(epoll_fd_, events, 64, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == listen_fd_) {
+        AcceptClients();
+      } else if (fd == wake_fd_) {
+        uint64_t value;
+        ssize_t ignored = read(wake_fd_, &value, sizeof(value));
+        (void)ignored;
+
+        // A segment landed or a fetch ended: retry every parked client.
+        std::vector<Client*> waiting;
+        for (auto& slot : clients_) {
+          if (slot.second->waiting) waiting.push_back(slot.second.get());
+        }
+        for (Client* client : waiting) {
+          client->waiting = false;
+          Pump(client);
+          if (client->dead) CloseClient(client);
+        }
+      } else {
+        auto it = clients_.find(fd);
+        if (it != clients_.end()) {
+          OnClientEvent(it->second.get(), events[i].events);
+        }
+      }
+    }
+  }
+  clients_.clear();
+}
+
+void LoopbackProxy::AcceptClients() {
+  while (true) {
+    int fd = accept4(listen_fd_, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      close(fd);
+      continue;
+    }
+    clients_[fd] = std::make_unique<Client>(fd);
+  }
+}
+
+void LoopbackProxy::OnClientEvent(Client* client, uint32_t events) {
+  if (events & EPOLLIN) {
+    char buffer[16 * 1024];
+    while (true) {
+      ssize_t n = recv(client->fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        client->input.append(buffer, static_cast<size_t>(n));
+        if (client->input.size() > 4 * kMaxRequestSize) client->dead = true;
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (n < 0 && errno == EINTR) continue;
+      client->dead = true;  // Peer closed or failed.
+      break;
+    }
+  } else if (events & (EPOLLERR | EPOLLHUP)) {
+    client->dead = true;
+  }
+
+  if (!client->dead) Pump(client);
+  if (client->dead) CloseClient(client);
+}
+
+void LoopbackProxy::Pump(Client* client) {
+  while (!client->dead) {
+    if (client->output_offset < client->output.size()) {
+      if (!Flush(client)) return;
+      continue;
+    }
+
+    switch (client->state) {
+      case Client::State::kRequest:
+        ParseRequest(client);
+        if (client->state == Client::State::kRequest) {
+          if (client->want_write) UpdateEvents(client, false);
+          return;
+        }
+        break;
+
+      case Client::State::kHead:
+        StartHead(client);
+        if (client->state == Client::State::kHead) return;
+        break;
+
+      case Client::State::kBody: {
+        if (client->position >= client->end) {
+          FinishResponse(client);
+          break;
+        }
+
+        if (client->file) {
+          // Encrypted at rest: this is the only path that copies through
+          // user space, decrypting each chunk (AES-CTR for v3 files, XOR
+          // for older ones) in one pass into the send buffer.
+          size_t length = static_cast<size_t>(std::min<uint64_t>(
+              kFileChunkSize, client->end - client->position));
+          client->output.resize(length);
+          client->output_offset = 0;
+          int64_t read = client->file->ReadAudio(
+              client->position, reinterpret_cast<uint8_t*>(&client->output[0]),
+              length);
+          if (read <= 0) {
+            client->dead = true;
+            return;
+          }
+          client->output.resize(static_cast<size_t>(read));
+          client->position += static_cast<uint64_t>(read);
+          break;
+        }
+
+        SegmentEntry& entry = *client->entry;
+        uint32_t index = static_cast<uint32_t>(client->position / kSegmentSize);
+        if (!entry.HasSegment(index)) {
+          if (!EnsureSegment(client, index)) {
+            client->dead = true;
+            return;
+          }
+          if (client->waiting) {
+            // Parked until a segment lands; stop polling for writability.
+            if (client->want_write) UpdateEvents(client, false);
+            return;
+          }
+          continue;
+        }
+
+        uint32_t ahead = index + kReadAheadSegments;
+        if (ahead < entry.segment_count() && !entry.HasSegment(ahead) &&
+            !entry.IsPending(ahead)) {
+          Schedule(client->entry, client->platform, ahead);
+        }
+
+        uint64_t segment_end =
+            std::min<uint64_t>(static_cast<uint64_t>(index + 1) * kSegmentSize,
+                               client->end);
+        size_t length = static_cast<size_t>(segment_end - client->position);
+
+        // Segment data is plain audio: hand it to the socket straight from
+        // the page cache.
+        off_t offset = static_cast<off_t>(client->position);
+        ssize_t sent = sendfile(client->fd, entry.data_fd(), &offset, length);
+        if (sent < 0) {
+          if (errno == EINTR) continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            UpdateEvents(client, true);
+          } else {
+            client->dead = true;
+          }
+          return;
+        }
+        if (sent == 0) {
+          client->dead = true;
+          return;
+        }
+        client->position += static_cast<uint64_t>(sent);
+        if (static_cast<size_t>(sent) == length && client->want_write) {
+          UpdateEvents(client, false);
+        }
+        break;
+      }
+
+      case Client::State::kClosing:
+        client->dead = true;
+        return;
+    }
+  }
+}
+
+bool LoopbackProxy::Flush(Client* client) {
+  while (client->output_offset < client->output.size()) {
+    ssize_t n = send(client->fd, client->output.data() + client->output_offset,
+                     client->output.size() - client->output_offset,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        UpdateEvents(client, true);
+      } else {
+        client->dead = true;
+      }
+      return false;
+    }
+    client->output_offset += static_cast<size_t>(n);
+  }
+  client->output.clear();
+  client->output_offset = 0;
+  if (client->want_write) UpdateEvents(client, false);
+  return true;
+}
+
+void LoopbackProxy::ParseRequest(Client* client) {
+  size_t head_end = client->input.find("\r\n\r\n");
+  if (head_end == std::string::npos) {
+    if (client->input.size() > kMaxRequestSize) client->dead = true;
+    return;
+  }
+  std::string head = client->input.substr(0, head_end);
+  client->input.erase(0, head_end + 4);
+
+  // "GET /proxy?url=... HTTP/1.1"
+  size_t line_end = head.find("\r\n");
+  std::string request_line = head.substr(0, line_end);
+  size_t first_space = request_line.find(' ');
+  size_t second_space = request_line.rfind(' ');
+  if (first_space == std::string::npos || second_space <= first_space) {
+    SendError(client, 400, "Bad Request");
+    return;
+  }
+  std::string method = request_line.substr(0, first_space);
+  std::string target =
+      request_line.substr(first_space + 1, second_space - first_space - 1);
+  std::string version = request_line.substr(second_space + 1);
+
+  client->head_only = method == "HEAD";
+  client->keep_alive = version == "HTTP/1.1";
+  client->has_range = false;
+  client->range_first = 0;
+  client->range_last = UINT64_MAX;
+  client->suffix_length = 0;
+  client->scheduled_segment = -1;
+
+  size_t line_start = line_end;
+  while (line_start != std::string::npos && line_start < head.size()) {
+    line_start += 2;
+    size_t next = head.find("\r\n", line_start);
+    std::string line = head.substr(line_start, next == std::string::npos
+                                                   ? std::string::npos
+                                                   : next - line_start);
+    line_start = next;
+
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string name = ToLower(line.substr(0, colon));
+    std::string value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+
+    if (name == "connection") {
+      std::string lower = ToLower(value);
+      if (lower == "close") client->keep_alive = false;
+      if (lower == "keep-alive") client->keep_alive = true;
+    } else if (name == "range") {
+      // Single ranges only; anything else is ignored (served as 200). The
+      // suffix form is checked first because %llu would accept "-N".
+      unsigned long long first = 0;
+      unsigned long long last = 0;
+      char tail = 0;
+      if (value.compare(0, 7, "bytes=-") == 0) {
+        if (std::sscanf(value.c_str() + 7, "%llu%c", &last, &tail) == 1 &&
+            last > 0) {
+          client->has_range = true;
+          client->suffix_length = last;
+        }
+      } else if (std::sscanf(value.c_str(), "bytes=%llu-%llu%c", &first,
+                             &last, &tail) == 2) {
+        if (first <= last) {
+          client->has_range = true;
+          client->range_first = first;
+          client->range_last = last;
+        }
+      } else if (std::sscanf(value.c_str(), "bytes=%llu-%c", &first, &tail) ==
+                 1) {
+        client->has_range = true;
+        client->range_first = first;
+      }
+    }
+  }
+
+  if (method != "GET" && method != "HEAD") {
+    SendError(client, 405, "Method Not Allowed");
+    return;
+  }
+
+  size_t query_start = target.find('?');
+  std::string path = target.substr(0, query_start);
+  if (path.compare(0, 7, "/cache/") == 0) {
+    OpenCacheFile(client, PercentDecode(path.substr(7)));
+    return;
+  }
+  if (path != "/proxy") {
+    SendError(client, 404, "Not Found");
+    return;
+  }
+  auto params = ParseQuery(
+      query_start == std::string::npos ? "" : target.substr(query_start + 1));
+  const std::string& url = params["url"];
+  if (url.empty()) {
+    SendError(client, 400, "Bad Request");
+    return;
+  }
+
+  const std::string& key = params["key"];
+  client->entry = cache_.Acquire(key.empty() ? UrlKey(url) : key);
+  if (!client->entry) {
+    SendError(client, 500, "Internal Server Error");
+    return;
+  }
+  client->entry->set_url(url);
+  client->platform = params["platform"];
+  client->state = Client::State::kHead;
+}
+
+void LoopbackProxy::OpenCacheFile(Client* client, const std::string& id) {
+  CacheFile registration;
+  {
+    std::lock_guard<std::mutex> lock(cache_files_mutex_);
+    auto it = cache_files_.find(id);
+    if (it == cache_files_.end()) {
+      SendError(client, 404, "Not Found");
+      return;
+    }
+    registration = it->second;
+  }
+
+  auto file = std::make_unique<CyreneFile>();
+  if (!file->Open(registration.path, registration.key.data(),
+                  registration.key.size()) ||
+      file->audio_size() == 0) {
+    SendError(client, 404, "Not Found");
+    return;
+  }
+
+  // If the same track was streamed through the proxy in full, its plain
+  // copy in the segment cache can be sent with sendfile() and nothing needs
+  // decrypting.
+  if (!registration.segment_key.empty()) {
+    auto entry = cache_.Acquire(registration.segment_key, false);
+    if (entry && entry->IsComplete() &&
+        entry->total_size() == file->audio_size()) {
+      client->entry = std::move(entry);
+      client->state = Client::State::kHead;
+      return;
+    }
+  }
+
+  client->file_content_type = SniffContentType(*file);
+  client->file = std::move(file);
+  client->state = Client::State::kHead;
+}
+
+void LoopbackProxy::RegisterCacheFile(const std::string& id,
+                                      const std::string& path,
+                                      std::vector<uint8_t> key,
+                                      const std::string& segment_key) {
+  std::lock_guard<std::mutex> lock(cache_files_mutex_);
+  cache_files_[id] = CacheFile{path, std::move(key), segment_key};
+}
+
+void LoopbackProxy::UnregisterCacheFile(const std::string& id) {
+  std::lock_guard<std::mutex> lock(cache_files_mutex_);
+  cache_files_.erase(id);
+}
+
+void LoopbackProxy::SetCacheLimit(uint64_t bytes) {
+  cache_.SetLimit(bytes);
+}
+
+void LoopbackProxy::SetPrefetch(std::vector<PrefetchRequest> requests) {
+  prefetch_.SetRequests(std::move(requests));
+}
+
+void LoopbackProxy::SetPrefetchLimits(int concurrency,
+                                      uint64_t bytes_per_second,
+                                      uint64_t max_bytes) {
+  prefetch_.SetLimits(concurrency, bytes_per_second, max_bytes);
+}
+
+void LoopbackProxy::StartHead(Client* client) {
+  uint64_t total = client->file ? client->file->audio_size()
+                                : client->entry->total_size();
+  if (total == 0) {
+    // Size unknown until the first upstream response: fetch the segment the
+    // client wants first and learn the size from its Content-Range.
+    uint32_t probe =
+        client->has_range && client->suffix_length == 0
+            ? static_cast<uint32_t>(client->range_first / kSegmentSize)
+            : 0;
+    if (!EnsureSegment(client, probe)) SendError(client, 502, "Bad Gateway");
+    return;
+  }
+
+  uint64_t first = 0;
+  uint64_t last = total - 1;
+  if (client->has_range) {
+    if (client->suffix_length > 0) {
+      first = total > client->suffix_length ? total - client->suffix_length : 0;
+    } else {
+      first = client->range_first;
+      last = std::min(client->range_last, total - 1);
+    }
+  }
+
+  std::string& out = client->output;
+  if (first >= total) {
+    out = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" +
+          std::to_string(total) + "\r\nContent-Length: 0\r\n";
+    out += client->keep_alive ? "Connection: keep-alive\r\n\r\n"
+                              : "Connection: close\r\n\r\n";
+    FinishResponse(client);
+    return;
+  }
+
+  std::string content_type = client->file ? client->file_content_type
+                                          : client->entry->content_type();
+  out = client->has_range ? "HTTP/1.1 206 Partial Content\r\n"
+                          : "HTTP/1.1 200 OK\r\n";
+  out += "Content-Type: " +
+         (content_type.empty() ? std::string("audio/mpeg") : content_type) +
+         "\r\nContent-Length: " + std::to_string(last - first + 1) +
+         "\r\nAccept-Ranges: bytes\r\nCache-Control: no-cache\r\n";
+  if (client->has_range) {
+    out += "Content-Range: bytes " + std::to_string(first) + "-" +
+           std::to_string(last) + "/" + std::to_string(total) + "\r\n";
+  }
+  out += client->keep_alive ? "Connection: keep-alive\r\n\r\n"
+                            : "Connection: close\r\n\r\n";
+  client->output_offset = 0;
+
+  client->position = first;
+  client->end = last + 1;
+  client->scheduled_segment = -1;
+  if (client->head_only) {
+    FinishResponse(client);
+  } else {
+    client->state = Client::State::kBody;
+  }
+}
+
+void LoopbackProxy::FinishResponse(Client* client) {
+  client->entry.reset();
+  client->file.reset();
+  client->state = client->keep_alive ? Client::State::kRequest
+                                     : Client::State::kClosing;
+}
+
+void LoopbackProxy::SendError(Client* client, int status, const char* reason) {
+  client->output = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                   "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  client->output_offset = 0;
+  client->entry.reset();
+  client->file.reset();
+  client->state = Client::State::kClosing;
+}
+
+void LoopbackProxy::CloseClient(Client* client) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->fd, nullptr);
+  clients_.erase(client->fd);
+}
+
+void LoopbackProxy::UpdateEvents(Client* client, bool want_write) {
+  struct epoll_event event;
+  event.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+  event.data.fd = client->fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client->fd, &event);
+  client->want_write = want_write;
+}
+
+bool LoopbackProxy::EnsureSegment(Client* client, uint32_t index) {
+  SegmentEntry& entry = *client->entry;
+  // Check pending before presence: a worker marks the segment present before
+  // clearing its pending bit, so this order cannot miss a segment in flight.
+  if (entry.IsPending(index)) {
+    client->waiting = true;
+    return true;
+  }
+  if (entry.total_size() > 0 && entry.HasSegment(index)) return true;
+  if (client->scheduled_segment == static_cast<int64_t>(index)) return false;
+
+  Schedule(client->entry, client->platform, index);
+  client->scheduled_segment = index;
+  client->waiting = true;
+  return true;
+}
+
+void LoopbackProxy::Schedule(const std::shared_ptr<SegmentEntry>& entry,
+                             const std::string& platform, uint32_t index) {
+  uint32_t last = index + kFetchWindowSegments;
+  if (entry->segment_count() > 0) {
+    last = std::min(last, entry->NextAvailableOrPending(index));
+  }
+  if (last <= index) return;
+  entry->MarkPending(index, last);
+
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    jobs_.push_back(FetchJob{entry, platform, index, last});
+  }
+  jobs_cv_.notify_one();
+}
+
+void LoopbackProxy::RunWorker() {
+  while (true) {
+    FetchJob job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      jobs_cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) return;
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    Fetch(job);
+  }
+}
+
+void LoopbackProxy::Fetch(const FetchJob& job) {
+  SegmentEntry& entry = *job.entry;
+
+  uint64_t request_first = static_cast<uint64_t>(job.first) * kSegmentSize;
+  uint64_t request_last = static_cast<uint64_t>(job.last) * kSegmentSize - 1;
+  uint64_t known_total = entry.total_size();
+  if (known_total > 0) request_last = std::min(request_last, known_total - 1);
+
+  UpstreamClient::Headers headers = {
+      {"User-Agent", kUpstreamUserAgent},
+      {"Range", "bytes=" + std::to_string(request_first) + "-" +
+                    std::to_string(request_last)},
+  };
+  if (const char* referer = RefererFor(job.platform)) {
+    headers.emplace_back("Referer", referer);
+  }
+
+  uint64_t total = 0;
+  uint64_t body_end = 0;
+  uint32_t index = 0;
+  uint32_t limit = 0;
+  std::vector<uint8_t> segment;
+  segment.reserve(kSegmentSize);
+
+  auto on_head = [&](const UpstreamResponse& response) {
+    uint64_t start = 0;
+    const std::string* type = response.Header("content-type");
+    if (response.status == 206) {
+      const std::string* range = response.Header("content-range");
+      unsigned long long first = 0;
+      unsigned long long last = 0;
+      unsigned long long size = 0;
+      if (range == nullptr ||
+          std::sscanf(range->c_str(), "bytes %llu-%llu/%llu", &first, &last,
+                      &size) != 3 ||
+          first > last || last >= size) {
+        return false;
+      }
+      start = first;
+      body_end = last + 1;
+      total = size;
+    } else if (response.status == 200) {
+      // Range ignored by the server: the body is the whole resource.
+      const std::string* length = response.Header("content-length");
+      if (length == nullptr) return false;
+      total = std::strtoull(length->c_str(), nullptr, 10);
+      body_end = total;
+    } else {
+      return false;
+    }
+
+    if (start % kSegmentSize != 0 ||
+        !entry.SetTotalSize(total, type ? *type : std::string())) {
+      return false;
+    }
+    index = static_cast<uint32_t>(start / kSegmentSize);
+    limit = std::min(job.last, entry.segment_count());
+    return index < limit;
+  };
+
+  auto on_body = [&](const uint8_t* data, size_t length) {
+    while (length > 0) {
+      if (stopping_ || index >= limit) return false;
+
+      uint64_t offset = static_cast<uint64_t>(index) * kSegmentSize;
+      size_t expected =
+          static_cast<size_t>(std::min<uint64_t>(kSegmentSize, total - offset));
+      size_t take = std::min(length, expected - segment.size());
+      segment.insert(segment.end(), data, data + take);
+      data += take;
+      length -= take;
+      if (segment.size() < expected) continue;
+
+      if (!entry.WriteSegment(index, segment.data(), segment.size())) {
+        return false;
+      }
+      entry.ClearPending(index, index + 1);
+      Wake();
+      segment.clear();
+      ++index;
+
+      if (index >= limit) {
+        // Done with the window. Only abandon the connection if the server
+        // still has body bytes to send, otherwise it can be reused.
+        return length == 0 &&
+               static_cast<uint64_t>(index) * kSegmentSize >= body_end;
+      }
+      // Someone else already fetched what follows.
+      if (index > job.first && entry.HasSegment(index)) return false;
+    }
+    return true;
+  };
+
+  upstream_.Get(entry.url(), headers, on_head, on_body);
+
+  entry.ClearPending(job.first, job.last);
+  Wake();
+  cache_.Trim();
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_proxy_start(const char* cache_directory) {
+  if (cache_directory == nullptr) return nullptr;
+  auto proxy = std::make_unique<cyrene::LoopbackProxy>(cache_directory);
+  if (!proxy->Start()) return nullptr;
+  return proxy.release();
+}
+
+int32_t cyrene_proxy_port(void* handle) {
+  if (handle == nullptr) return 0;
+  return static_cast<cyrene::LoopbackProxy*>(handle)->port();
+}
+
+int32_t cyrene_proxy_register_cache(void* handle, const char* id,
+                                    const char* path, const uint8_t* key,
+                                    int32_t key_length,
+                                    const char* segment_key) {
+  if (handle == nullptr || id == nullptr || path == nullptr ||
+      key_length < 0 || (key == nullptr && key_length > 0)) {
+    return 0;
+  }
+  static_cast<cyrene::LoopbackProxy*>(handle)->RegisterCacheFile(
+      id, path, std::vector<uint8_t>(key, key + key_length),
+      segment_key ? segment_key : "");
+  return 1;
+}
+
+void cyrene_proxy_unregister_cache(void* handle, const char* id) {
+  if (handle == nullptr || id == nullptr) return;
+  static_cast<cyrene::LoopbackProxy*>(handle)->UnregisterCacheFile(id);
+}
+
+void cyrene_proxy_set_cache_limit(void* handle, int64_t bytes) {
+  if (handle == nullptr) return;
+  static_cast<cyrene::LoopbackProxy*>(handle)->SetCacheLimit(
+      bytes > 0 ? static_cast<uint64_t>(bytes) : 0);
+}
+
+void cyrene_proxy_set_prefetch(void* handle, const char* const* keys,
+                               const char* const* urls,
+                               const char* const* platforms,
+                               const int64_t* bytes, int32_t count) {
+  if (handle == nullptr || count < 0) return;
+  std::vector<cyrene::PrefetchRequest> requests;
+  for (int32_t i = 0; i < count; ++i) {
+    if (keys[i] == nullptr || urls[i] == nullptr) continue;
+    cyrene::PrefetchRequest request;
+    request.key = keys[i];
+    request.url = urls[i];
+    request.platform = platforms[i] ? platforms[i] : "";
+    request.bytes = bytes[i] > 0 ? static_cast<uint64_t>(bytes[i]) : 0;
+    requests.push_back(std::move(request));
+  }
+  static_cast<cyrene::LoopbackProxy*>(handle)->SetPrefetch(
+      std::move(requests));
+}
+
+void cyrene_proxy_set_prefetch_limits(void* handle, int32_t concurrency,
+                                      int64_t bytes_per_second,
+                                      int64_t max_bytes) {
+  if (handle == nullptr) return;
+  static_cast<cyrene::LoopbackProxy*>(handle)->SetPrefetchLimits(
+      concurrency,
+      bytes_per_second > 0 ? static_cast<uint64_t>(bytes_per_second) : 0,
+      max_bytes < 0 ? cyrene::PrefetchScheduler::kDefaultMaxBytes
+                    : static_cast<uint64_t>(max_bytes));
+}
+
+void cyrene_proxy_stop(void* handle) {
+  delete static_cast<cyrene::LoopbackProxy*>(handle);
+}
+
+}  // extern "C"
@@ -0,0 +1,189 @@
+#ifndef CYRENE_NATIVE_LOOPBACK_PROXY_H_
+#define CYRENE_NATIVE_LOOPBACK_PROXY_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cyrene_file.h"
+#include "native_export.h"
+#include "prefetch_scheduler.h"
+#include "segment_cache.h"
+#include "upstream_client.h"
+
+namespace cyrene {
+
+// Loopback HTTP proxy for online audio streams.
+//
+// The player requests
+//   GET|HEAD /proxy?url=<encoded upstream URL>&platform=<qq|kugou|netease>
+//            &key=<key>
+// and the proxy answers from a SegmentCache: segments already on disk are
+// served locally, missing ones are fetched from upstream in windows of
+// consecutive segments over pooled keep-alive connections. Range requests
+// (including seeks into parts that were never played) are honoured, so the
+// player never re-downloads from byte 0. |key| names the cache entry; when it
+// is omitted a hash of the URL without its (signed) query string is used.
+//
+// Tracks in the persistent .cyrene cache are served from
+//   GET|HEAD /cache/<id>
+// once registered with RegisterCacheFile(). Their payload is encrypted at
+// rest, so it is decrypted chunk by chunk into one buffer; when the segment
+// cache holds a complete plain copy of the same track, that copy is sent
+// with sendfile() instead. Segment-cache bodies always go out via sendfile(),
+// so steady-state playback makes no user-space copies.
+//
+// One epoll thread owns all client sockets; a few worker threads perform the
+// blocking upstream fetches and wake the loop through an eventfd whenever a
+// segment lands, trimming the segment cache back to its byte limit after
+// each window. A PrefetchScheduler warms the same segment cache for the
+// tracks likely to play next, so that switching to one is served from disk.
+class LoopbackProxy {
+ public:
+  explicit LoopbackProxy(std::string cache_directory);
+  ~LoopbackProxy();
+
+  LoopbackProxy(const LoopbackProxy&) = delete;
+  LoopbackProxy& operator=(const LoopbackProxy&) = delete;
+
+  // Binds 127.0.0.1 on an ephemeral port and starts the threads.
+  bool Start();
+
+  // Stops the threads and closes all connections. Idempotent.
+  void Stop();
+
+  uint16_t port() const { return port_; }
+
+  // Makes the .cyrene file at |path| available as /cache/<id>.
+  // |segment_key| optionally names the segment-cache entry holding the same
+  // track in plain form. Thread-safe.
+  void RegisterCacheFile(const std::string& id, const std::string& path,
+                         std::vector<uint8_t> key,
+                         const std::string& segment_key);
+  void UnregisterCacheFile(const std::string& id);
+
+  // Byte limit of the segment cache (0: unlimited). Thread-safe.
+  void SetCacheLimit(uint64_t bytes);
+
+  // See PrefetchScheduler. Thread-safe.
+  void SetPrefetch(std::vector<PrefetchRequest> requests);
+  void SetPrefetchLimits(int concurrency, uint64_t bytes_per_second,
+                         uint64_t max_bytes);
+
+ private:
+  struct Client;
+
+  struct CacheFile {
+    std::string path;
+    std::vector<uint8_t> key;
+    std::string segment_key;
+  };
+
+  struct FetchJob {
+    std::shared_ptr<SegmentEntry> entry;
+    std::string platform;
+    uint32_t first;  // First segment to fetch.
+    uint32_t last;   // One past the last segment to fetch.
+  };
+
+  void RunLoop();
+  void RunWorker();
+  void Wake();
+
+  void AcceptClients();
+  void OnClientEvent(Client* client, uint32_t events);
+  void ParseRequest(Client* client);
+  void OpenCacheFile(Client* client, const std::string& id);
+  void Pump(Client* client);
+  bool Flush(Client* client);
+  void StartHead(Client* client);
+  void FinishResponse(Client* client);
+  void SendError(Client* client, int status, const char* reason);
+  void CloseClient(Client* client);
+  void UpdateEvents(Client* client, bool want_write);
+
+  // Makes sure segment |index| of |client|'s entry is present or on its way.
+  // Returns false if a fetch this client already triggered for it failed.
+  bool EnsureSegment(Client* client, uint32_t index);
+  void Schedule(const std::shared_ptr<SegmentEntry>& entry,
+                const std::string& platform, uint32_t index);
+  void Fetch(const FetchJob& job);
+
+  SegmentCache cache_;
+  UpstreamClient upstream_;
+  PrefetchScheduler prefetch_;
+
+  int listen_fd_;
+  int epoll_fd_;
+  int wake_fd_;
+  uint16_t port_;
+  std::atomic<bool> stopping_;
+
+  std::thread loop_thread_;
+  std::vector<std::thread> workers_;
+
+  std::map<int, std::unique_ptr<Client>> clients_;  // Loop thread only.
+
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_cv_;
+  std::deque<FetchJob> jobs_;
+
+  std::mutex cache_files_mutex_;
+  std::map<std::string, CacheFile> cache_files_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// Starts a proxy caching into |cache_directory|. Returns null on failure.
+CYRENE_EXPORT void* cyrene_proxy_start(const char* cache_directory);
+
+// Port the proxy listens on (127.0.0.1).
+CYRENE_EXPORT int32_t cyrene_proxy_port(void* handle);
+
+// Registers a .cyrene cache file as /cache/<id>. |segment_key| may be null.
+// Returns 1 on success.
+CYRENE_EXPORT int32_t cyrene_proxy_register_cache(void* handle, const char* id,
+                                                  const char* path,
+                                                  const uint8_t* key,
+                                                  int32_t key_length,
+                                                  const char* segment_key);
+
+CYRENE_EXPORT void cyrene_proxy_unregister_cache(void* handle, const char* id);
+
+// Limits the segment cache to |bytes| (0: unlimited), deleting the least
+// recently used entries that do not fit. The default is 512 MiB.
+CYRENE_EXPORT void cyrene_proxy_set_cache_limit(void* handle, int64_t bytes);
+
+// Replaces the prefetch set with |count| requests, most likely first. The
+// arrays are parallel; |bytes| 0 prefetches a whole track. Passing 0
+// requests cancels all prefetching.
+CYRENE_EXPORT void cyrene_proxy_set_prefetch(void* handle,
+                                             const char* const* keys,
+                                             const char* const* urls,
+                                             const char* const* platforms,
+                                             const int64_t* bytes,
+                                             int32_t count);
+
+// Caps concurrent prefetch windows, their combined rate and the bytes the
+// prefetched set may cover (0: uncapped; a negative |max_bytes| keeps the
+// default).
+CYRENE_EXPORT void cyrene_proxy_set_prefetch_limits(void* handle,
+                                                    int32_t concurrency,
+                                                    int64_t bytes_per_second,
+                                                    int64_t max_bytes);
+
+// Stops the proxy and frees the handle.
+CYRENE_EXPORT void cyrene_proxy_stop(void* handle);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_LOOPBACK_PROXY_H_
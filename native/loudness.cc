@@ -0,0 +1,385 @@
+#include "loudness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "audio_decoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CYRENE_LOUDNESS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CYRENE_LOUDNESS_NEON 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+constexpr size_t kChunkFrames = 4096;
+constexpr size_t kSubBlockFrames = kEngineRate / 10;  // 100 ms
+constexpr size_t kSubBlocksPerBlock = 4;              // 400 ms, 75% overlap
+constexpr double kAbsoluteGateLufs = -70;
+constexpr double kRelativeGateLu = -10;
+constexpr size_t kHistoryFrames = LoudnessMeter::kPhaseTaps - 1;
+constexpr size_t kPhases = 4;
+
+// BS.1770-4 Annex 2 true-peak interpolator, one row per tap and one
+// column per phase. Rows run oldest input first, so output phase p for
+// input frame n is the dot product of column p with frames n-11 .. n.
+alignas(16) constexpr float kTaps[LoudnessMeter::kPhaseTaps][kPhases] = {
+    {-0.0083007812500f, -0.0189208984375f, -0.0291748046875f,
+     0.0017089843750f},
+    {0.0148925781250f, 0.0330810546875f, 0.0292968750000f,
+     0.0109863281250f},
+    {-0.0266113281250f, -0.0582275390625f, -0.0517578125000f,
+     -0.0196533203125f},
+    {0.0476074218750f, 0.1015625000000f, 0.0891113281250f,
+     0.0332031250000f},
+    {-0.1022949218750f, -0.2003173828125f, -0.1665039062500f,
+     -0.0594482421875f},
+    {0.9721679687500f, 0.7797851562500f, 0.4650878906250f,
+     0.1373291015625f},
+    {0.1373291015625f, 0.4650878906250f, 0.7797851562500f,
+     0.9721679687500f},
+    {-0.0594482421875f, -0.1665039062500f, -0.2003173828125f,
+     -0.1022949218750f},
+    {0.0332031250000f, 0.0891113281250f, 0.1015625000000f,
+     0.0476074218750f},
+    {-0.0196533203125f, -0.0517578125000f, -0.0582275390625f,
+     -0.0266113281250f},
+    {0.0109863281250f, 0.0292968750000f, 0.0330810546875f,
+     0.0148925781250f},
+    {0.0017089843750f, -0.0291748046875f, -0.0189208984375f,
+     -0.0083007812500f},
+};
+
+// All kernels share one contract: |input| holds kHistoryFrames + |count|
+// interleaved stereo frames, and the result is the larger of |peak| and
+// every oversampled magnitude for the last |count| of them.
+using PeakKernel = float (*)(const float* input, size_t count, float peak);
+
+float PeakScalar(const float* input, size_t count, float peak) {
+  for (size_t n = 0; n < count; ++n) {
+    const float* x = input + n * kEngineChannels;
+    for (int c = 0; c < kEngineChannels; ++c) {
+      for (size_t p = 0; p < kPhases; ++p) {
+        float acc = 0;
+        for (size_t t = 0; t < LoudnessMeter::kPhaseTaps; ++t) {
+          acc += kTaps[t][p] * x[t * kEngineChannels + c];
+        }
+        peak = std::max(peak, std::fabs(acc));
+      }
+    }
+  }
+  return peak;
+}
+
+#if defined(CYRENE_LOUDNESS_X86)
+
+float MaxLane(__m128 v) {
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, v);
+  return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+// One vector per channel, one lane per phase.
+__attribute__((target("sse2"))) float PeakSse2(const float* input,
+                                               size_t count, float peak) {
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 max = _mm_set1_ps(peak);
+  for (size_t n = 0; n < count; ++n) {
+    const float* x = input + n * kEngineChannels;
+    __m128 left = _mm_setzero_ps();
+    __m128 right = _mm_setzero_ps();
+    for (size_t t = 0; t < LoudnessMeter::kPhaseTaps; ++t) {
+      __m128 taps = _mm_load_ps(kTaps[t]);
+      left = _mm_add_ps(left, _mm_mul_ps(taps, _mm_set1_ps(x[2 * t])));
+      right = _mm_add_ps(right, _mm_mul_ps(taps, _mm_set1_ps(x[2 * t + 1])));
+    }
+    max = _mm_max_ps(max, _mm_and_ps(left, abs_mask));
+    max = _mm_max_ps(max, _mm_and_ps(right, abs_mask));
+  }
+  return MaxLane(max);
+}
+
+// Both channels in one vector: lanes 0-3 are the left phases, 4-7 the
+// right ones.
+__attribute__((target("avx2,fma"))) float PeakAvx2(const float* input,
+                                                   size_t count, float peak) {
+  const __m256 abs_mask =
+      _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+  __m256 max = _mm256_set1_ps(peak);
+  for (size_t n = 0; n < count; ++n) {
+    const float* x = input + n * kEngineChannels;
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t t = 0; t < LoudnessMeter::kPhaseTaps; ++t) {
+      __m256 taps = _mm256_broadcast_ps(
+          reinterpret_cast<const __m128*>(kTaps[t]));
+      __m128 frame = _mm_castpd_ps(
+          _mm_load_sd(reinterpret_cast<const double*>(x + 2 * t)));
+      __m256 samples =
+          _mm256_permutevar8x32_ps(_mm256_castps128_ps256(frame), spread);
+      acc = _mm256_fmadd_ps(taps, samples, acc);
+    }
+    max = _mm256_max_ps(max, _mm256_and_ps(acc, abs_mask));
+  }
+  return MaxLane(_mm_max_ps(_mm256_castps256_ps128(max),
+                            _mm256_extractf128_ps(max, 1)));
+}
+
+#endif  // CYRENE_LOUDNESS_X86
+
+#if defined(CYRENE_LOUDNESS_NEON)
+
+float PeakNeon(const float* input, size_t count, float peak) {
+  float32x4_t max = vdupq_n_f32(peak);
+  for (size_t n = 0; n < count; ++n) {
+    const float* x = input + n * kEngineChannels;
+    float32x4_t left = vdupq_n_f32(0);
+    float32x4_t right = vdupq_n_f32(0);
+    for (size_t t = 0; t < LoudnessMeter::kPhaseTaps; ++t) {
+      float32x4_t taps = vld1q_f32(kTaps[t]);
+      left = vfmaq_n_f32(left, taps, x[2 * t]);
+      right = vfmaq_n_f32(right, taps, x[2 * t + 1]);
+    }
+    max = vmaxq_f32(max, vabsq_f32(left));
+    max = vmaxq_f32(max, vabsq_f32(right));
+  }
+  return vmaxvq_f32(max);
+}
+
+#endif  // CYRENE_LOUDNESS_NEON
+
+struct KernelChoice {
+  PeakKernel kernel;
+  const char* name;
+};
+
+KernelChoice SelectKernel() {
+#if defined(CYRENE_LOUDNESS_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {PeakAvx2, "avx2"};
+  }
+  if (__builtin_cpu_supports("sse2")) return {PeakSse2, "sse2"};
+#elif defined(CYRENE_LOUDNESS_NEON)
+  return {PeakNeon, "neon"};
+#endif
+  return {PeakScalar, "scalar"};
+}
+
+const KernelChoice& Kernel() {
+  static const KernelChoice choice = SelectKernel();
+  return choice;
+}
+
+// The K-weighting filters run both channels as the two lanes of one
+// double vector. SSE2 and 64-bit NEON are part of their base ISAs, so
+// this needs no runtime dispatch.
+#if defined(__SSE2__)
+using Pair = __m128d;
+inline Pair Splat(double v) { return _mm_set1_pd(v); }
+inline Pair MakePair(double l, double r) { return _mm_setr_pd(l, r); }
+inline Pair PairAdd(Pair a, Pair b) { return _mm_add_pd(a, b); }
+inline Pair PairMul(Pair a, Pair b) { return _mm_mul_pd(a, b); }
+inline double SumLanes(Pair a) {
+  return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+inline void Store(double* out, Pair a) { _mm_storeu_pd(out, a); }
+inline Pair Load(const double* in) { return _mm_loadu_pd(in); }
+#elif defined(CYRENE_LOUDNESS_NEON)
+using Pair = float64x2_t;
+inline Pair Splat(double v) { return vdupq_n_f64(v); }
+inline Pair MakePair(double l, double r) {
+  return vsetq_lane_f64(r, vdupq_n_f64(l), 1);
+}
+inline Pair PairAdd(Pair a, Pair b) { return vaddq_f64(a, b); }
+inline Pair PairMul(Pair a, Pair b) { return vmulq_f64(a, b); }
+inline double SumLanes(Pair a) { return vaddvq_f64(a); }
+inline void Store(double* out, Pair a) { vst1q_f64(out, a); }
+inline Pair Load(const double* in) { return vld1q_f64(in); }
+#else
+struct Pair {
+  double l, r;
+};
+inline Pair Splat(double v) { return {v, v}; }
+inline Pair MakePair(double l, double r) { return {l, r}; }
+inline Pair PairAdd(Pair a, Pair b) { return {a.l + b.l, a.r + b.r}; }
+inline Pair PairMul(Pair a, Pair b) { return {a.l * b.l, a.r * b.r}; }
+inline double SumLanes(Pair a) { return a.l + a.r; }
+inline void Store(double* out, Pair a) {
+  out[0] = a.l;
+  out[1] = a.r;
+}
+inline Pair Load(const double* in) { return {in[0], in[1]}; }
+#endif
+
+double Lufs(double energy) { return -0.691 + 10 * std::log10(energy); }
+
+}  // namespace
+
+LoudnessMeter::LoudnessMeter()
+    : history_((kHistoryFrames + kChunkFrames) * kEngineChannels, 0.0f) {
+  // BS.1770 defines both stages for 48 kHz; these are the analog
+  // prototypes behind its tables, re-derived for the engine rate.
+  const double rate = kEngineRate;
+  double k = std::tan(M_PI * 1681.974450955533 / rate);
+  double q = 0.7071752369554196;
+  double vh = std::pow(10.0, 3.999843853973347 / 20);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1 + k / q + k * k;
+  shelf_b_[0] = (vh + vb * k / q + k * k) / a0;
+  shelf_b_[1] = 2 * (k * k - vh) / a0;
+  shelf_b_[2] = (vh - vb * k / q + k * k) / a0;
+  shelf_a_[0] = 1;
+  shelf_a_[1] = 2 * (k * k - 1) / a0;
+  shelf_a_[2] = (1 - k / q + k * k) / a0;
+
+  k = std::tan(M_PI * 38.13547087602444 / rate);
+  q = 0.5003270373238773;
+  a0 = 1 + k / q + k * k;
+  pass_b_[0] = 1;
+  pass_b_[1] = -2;
+  pass_b_[2] = 1;
+  pass_a_[0] = 1;
+  pass_a_[1] = 2 * (k * k - 1) / a0;
+  pass_a_[2] = (1 - k / q + k * k) / a0;
+}
+
+void LoudnessMeter::Add(const float* frames, size_t count) {
+  while (count > 0) {
+    size_t chunk = std::min(count, kChunkFrames);
+    Filter(frames, chunk);
+
+    float* tail = history_.data() + kHistoryFrames * kEngineChannels;
+    std::memcpy(tail, frames, chunk * kEngineChannels * sizeof(float));
+    peak_ = Kernel().kernel(history_.data(), chunk, peak_);
+    // Keep the newest kHistoryFrames, whether from this chunk or, after a
+    // short one, partly from the old history.
+    std::memmove(history_.data(), history_.data() + chunk * kEngineChannels,
+                 kHistoryFrames * kEngineChannels * sizeof(float));
+    frames_ += static_cast<int64_t>(chunk);
+    frames += chunk * kEngineChannels;
+    count -= chunk;
+  }
+}
+
+void LoudnessMeter::Filter(const float* frames, size_t count) {
+  const Pair sb0 = Splat(shelf_b_[0]), sb1 = Splat(shelf_b_[1]),
+             sb2 = Splat(shelf_b_[2]);
+  const Pair sa1 = Splat(-shelf_a_[1]), sa2 = Splat(-shelf_a_[2]);
+  const Pair pb0 = Splat(pass_b_[0]), pb1 = Splat(pass_b_[1]),
+             pb2 = Splat(pass_b_[2]);
+  const Pair pa1 = Splat(-pass_a_[1]), pa2 = Splat(-pass_a_[2]);
+  Pair s1 = Load(shelf_z_[0]), s2 = Load(shelf_z_[1]);
+  Pair p1 = Load(pass_z_[0]), p2 = Load(pass_z_[1]);
+  Pair energy = Splat(0);
+
+  for (size_t i = 0; i < count; ++i) {
+    Pair x = MakePair(frames[i * kEngineChannels],
+                      frames[i * kEngineChannels + 1]);
+    Pair y = PairAdd(PairMul(sb0, x), s1);
+    s1 = PairAdd(PairAdd(PairMul(sb1, x), PairMul(sa1, y)), s2);
+    s2 = PairAdd(PairMul(sb2, x), PairMul(sa2, y));
+
+    Pair z = PairAdd(PairMul(pb0, y), p1);
+    p1 = PairAdd(PairAdd(PairMul(pb1, y), PairMul(pa1, z)), p2);
+    p2 = PairAdd(PairMul(pb2, y), PairMul(pa2, z));
+
+    energy = PairAdd(energy, PairMul(z, z));
+    if (++block_fill_ == kSubBlockFrames) {
+      sub_blocks_.push_back(block_energy_ + SumLanes(energy));
+      block_energy_ = 0;
+      block_fill_ = 0;
+      energy = Splat(0);
+    }
+  }
+  block_energy_ += SumLanes(energy);
+
+  Store(shelf_z_[0], s1);
+  Store(shelf_z_[1], s2);
+  Store(pass_z_[0], p1);
+  Store(pass_z_[1], p2);
+}
+
+bool LoudnessMeter::Finish(LoudnessResult* out) {
+  // Let the interpolator ring out past the last frame.
+  std::vector<float> flush((kHistoryFrames * 2) * kEngineChannels, 0.0f);
+  std::copy(history_.begin(),
+            history_.begin() + kHistoryFrames * kEngineChannels,
+            flush.begin());
+  float peak = Kernel().kernel(flush.data(), kHistoryFrames, peak_);
+
+  const double block_frames = kSubBlockFrames * kSubBlocksPerBlock;
+  const double absolute_gate =
+      std::pow(10.0, (kAbsoluteGateLufs + 0.691) / 10);
+  std::vector<double> blocks;
+  double window = 0;
+  for (size_t i = 0; i < sub_blocks_.size(); ++i) {
+    window += sub_blocks_[i];
+    if (i + 1 < kSubBlocksPerBlock) continue;
+    if (i >= kSubBlocksPerBlock) window -= sub_blocks_[i - kSubBlocksPerBlock];
+    double energy = std::max(window, 0.0) / block_frames;
+    if (energy > absolute_gate) blocks.push_back(energy);
+  }
+  if (blocks.empty()) return false;
+
+  double sum = 0;
+  for (double energy : blocks) sum += energy;
+  const double relative_gate =
+      sum / blocks.size() * std::pow(10.0, kRelativeGateLu / 10);
+  sum = 0;
+  size_t gated = 0;
+  for (double energy : blocks) {
+    if (energy > relative_gate) {
+      sum += energy;
+      ++gated;
+    }
+  }
+  if (gated == 0) return false;
+
+  out->integrated_lufs = Lufs(sum / gated);
+  out->true_peak_dbtp = peak > 0 ? 20 * std::log10(peak) : -HUGE_VAL;
+  out->frames = frames_;
+  return true;
+}
+
+const char* LoudnessMeter::KernelName() { return Kernel().name; }
+
+bool AnalyzeLoudness(const std::string& uri, LoudnessResult* out) {
+  std::unique_ptr<AudioDecoder> decoder = OpenAudioDecoder(uri);
+  if (!decoder) return false;
+  LoudnessMeter meter;
+  std::vector<float> buffer(kChunkFrames * kEngineChannels);
+  for (;;) {
+    size_t got = decoder->Read(buffer.data(), kChunkFrames);
+    if (got > 0) {
+      meter.Add(buffer.data(), got);
+    } else if (decoder->failed()) {
+      return false;
+    } else if (decoder->finished()) {
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+  return meter.Finish(out);
+}
+
+}  // namespace cyrene
+
+int32_t cyrene_loudness_analyze(const char* uri, double* out) {
+  if (uri == nullptr || out == nullptr) return 0;
+  cyrene::LoudnessResult result;
+  if (!cyrene::AnalyzeLoudness(uri, &result)) return 0;
+  out[0] = result.integrated_lufs;
+  out[1] = result.true_peak_dbtp;
+  return 1;
+}
@@ -0,0 +1,81 @@
+#ifndef CYRENE_NATIVE_LOUDNESS_H_
+#define CYRENE_NATIVE_LOUDNESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+struct LoudnessResult {
+  double integrated_lufs = 0;
+  double true_peak_dbtp = 0;
+  int64_t frames = 0;
+};
+
+// EBU R128 / ITU-R BS.1770-4 meter for audio in the engine's format
+// (kEngineRate interleaved stereo floats).
+//
+// Both channels are K-weighted together, one SIMD lane each, and their
+// energy is summed per 100 ms; integrated loudness gates the 400 ms blocks
+// built from those at -70 LUFS and then 10 LU below the ungated mean. True
+// peak is the largest sample after 4x oversampling with the 48-tap
+// polyphase filter from BS.1770 Annex 2. The oversampling kernel uses
+// AVX2+FMA or SSE2 on x86-64, NEON on ARM64 and a scalar loop elsewhere;
+// the choice is made once per process.
+class LoudnessMeter {
+ public:
+  LoudnessMeter();
+
+  void Add(const float* frames, size_t count);
+
+  // Measures everything added so far. Returns false when nothing passed
+  // the gates (silence, or less than one 400 ms block).
+  bool Finish(LoudnessResult* out);
+
+  // Name of the true-peak kernel selected for this CPU ("avx2", "sse2",
+  // "neon" or "scalar").
+  static const char* KernelName();
+
+  // Taps per oversampling phase.
+  static constexpr size_t kPhaseTaps = 12;
+
+ private:
+  void Filter(const float* frames, size_t count);
+
+  // K-weighting: high shelf then high pass, direct form II transposed.
+  double shelf_b_[3], shelf_a_[3];
+  double pass_b_[3], pass_a_[3];
+  double shelf_z_[2][2] = {};  // [state][channel]
+  double pass_z_[2][2] = {};
+
+  double block_energy_ = 0;
+  size_t block_fill_ = 0;
+  std::vector<double> sub_blocks_;  // Energy per 100 ms
+
+  // The last kPhaseTaps - 1 input frames ahead of the current chunk, then
+  // the chunk itself; the kernel reads both as one interleaved run.
+  std::vector<float> history_;
+  float peak_ = 0;
+  int64_t frames_ = 0;
+};
+
+// Decodes |uri| (see OpenAudioDecoder) to the end and measures it.
+// Returns false if it cannot be decoded or nothing passed the gates.
+bool AnalyzeLoudness(const std::string& uri, LoudnessResult* out);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/loudness_native.dart. Blocks until the
+// whole track is decoded; call it off the UI isolate. On success writes
+// integrated loudness (LUFS) and true peak (dBTP) to |out| and returns 1.
+CYRENE_EXPORT int32_t cyrene_loudness_analyze(const char* uri, double* out);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_LOUDNESS_H_
@@ -0,0 +1,435 @@
+#include "lyric_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace cyrene {
+
+namespace {
+
+// Digits accepted per number; keeps every time well inside int64_t.
+constexpr int kMaxDigits = 9;
+
+struct Word {
+  int64_t start_ms;
+  int64_t duration_ms;
+  int32_t begin;
+  int32_t end;
+};
+
+struct Record {
+  int64_t start_ms;
+  int32_t begin;
+  int32_t end;
+  int32_t first_word;
+  int32_t word_count;
+};
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+bool ReadNumber(const char*& p, const char* end, int64_t* value) {
+  const char* q = p;
+  int64_t number = 0;
+  while (q != end && IsDigit(*q) && q - p < kMaxDigits) {
+    number = number * 10 + (*q - '0');
+    ++q;
+  }
+  if (q == p || (q != end && IsDigit(*q))) return false;
+  *value = number;
+  p = q;
+  return true;
+}
+
+bool ReadChar(const char*& p, const char* end, char c) {
+  if (p == end || *p != c) return false;
+  ++p;
+  return true;
+}
+
+// [mm:ss], [mm:ss.f] or [mm:ss:f]. The fraction is read as milliseconds from
+// its first three digits, right-padded: .5 is 500 ms, .12 (and the
+// hundredths of [mm:ss:12]) 120 ms, .1234 123 ms.
+bool ReadTimestamp(const char*& p, const char* end, int64_t* ms) {
+  const char* q = p;
+  int64_t minutes, seconds;
+  if (!ReadChar(q, end, '[') || !ReadNumber(q, end, &minutes) ||
+      !ReadChar(q, end, ':') || !ReadNumber(q, end, &seconds)) {
+    return false;
+  }
+  int64_t fraction = 0;
+  if (q != end && (*q == '.' || *q == ':')) {
+    ++q;
+    const char* digits = q;
+    int used = 0;
+    for (; q != end && IsDigit(*q); ++q) {
+      if (used < 3) {
+        fraction = fraction * 10 + (*q - '0');
+        ++used;
+      }
+    }
+    if (q == digits) return false;
+    for (; used < 3; ++used) fraction *= 10;
+  }
+  if (!ReadChar(q, end, ']')) return false;
+  *ms = (minutes * 60 + seconds) * 1000 + fraction;
+  p = q;
+  return true;
+}
+
+// |open|start,duration|close|, with an optional third field in word tags
+// (YRC writes "(start,duration,0)").
+bool ReadTimingTag(const char*& p, const char* end, char open, char close,
+                   bool allow_third, int64_t* start, int64_t* duration) {
+  const char* q = p;
+  if (!ReadChar(q, end, open) || !ReadNumber(q, end, start) ||
+      !ReadChar(q, end, ',') || !ReadNumber(q, end, duration)) {
+    return false;
+  }
+  int64_t ignored;
+  if (allow_third && ReadChar(q, end, ',') && !ReadNumber(q, end, &ignored)) {
+    return false;
+  }
+  if (!ReadChar(q, end, close)) return false;
+  p = q;
+  return true;
+}
+
+bool ReadWordTag(const char*& p, const char* end, int64_t* start,
+                 int64_t* duration) {
+  return ReadTimingTag(p, end, '(', ')', true, start, duration);
+}
+
+// First word tag at or after |p|, or |end|. A '(' that does not open a
+// valid tag is ordinary text.
+const char* FindWordTag(const char* p, const char* end) {
+  while (p != end) {
+    const char* open =
+        static_cast<const char*>(std::memchr(p, '(', end - p));
+    if (open == nullptr) return end;
+    const char* q = open;
+    int64_t start, duration;
+    if (ReadWordTag(q, end, &start, &duration)) return open;
+    p = open + 1;
+  }
+  return end;
+}
+
+// Length of the whitespace character at the start of [p, end), or 0. Covers
+// ASCII whitespace, U+00A0 and the ideographic space U+3000, which CJK
+// lyrics use for padding.
+size_t LeadingSpace(const char* p, const char* end) {
+  if (p == end) return 0;
+  unsigned char c = static_cast<unsigned char>(*p);
+  if (c == ' ' || (c >= '\t' && c <= '\r')) return 1;
+  if (c == 0xC2 && end - p >= 2 && static_cast<unsigned char>(p[1]) == 0xA0) {
+    return 2;
+  }
+  if (c == 0xE3 && end - p >= 3 && static_cast<unsigned char>(p[1]) == 0x80 &&
+      static_cast<unsigned char>(p[2]) == 0x80) {
+    return 3;
+  }
+  return 0;
+}
+
+size_t TrailingSpace(const char* begin, const char* p) {
+  if (p == begin) return 0;
+  unsigned char c = static_cast<unsigned char>(p[-1]);
+  if (c == ' ' || (c >= '\t' && c <= '\r')) return 1;
+  if (c == 0xA0 && p - begin >= 2 &&
+      static_cast<unsigned char>(p[-2]) == 0xC2) {
+    return 2;
+  }
+  if (c == 0x80 && p - begin >= 3 &&
+      static_cast<unsigned char>(p[-2]) == 0x80 &&
+      static_cast<unsigned char>(p[-3]) == 0xE3) {
+    return 3;
+  }
+  return 0;
+}
+
+void Trim(const char*& begin, const char*& end) {
+  while (size_t n = LeadingSpace(begin, end)) begin += n;
+  while (size_t n = TrailingSpace(begin, end)) end -= n;
+}
+
+// Tokenizes lyric documents into records and words whose text is appended to
+// one shared pool.
+class Tokenizer {
+ public:
+  Tokenizer(std::string* text, std::vector<Word>* words)
+      : text_(text), words_(words) {}
+
+  std::vector<Record> Parse(std::string_view source) {
+    std::vector<Record> records;
+    const char* p = source.data();
+    const char* end = p + source.size();
+    if (end - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+
+    while (p < end) {
+      const char* newline =
+          static_cast<const char*>(std::memchr(p, '\n', end - p));
+      const char* line_end = newline != nullptr ? newline : end;
+      const char* content_end = line_end;
+      if (content_end != p && content_end[-1] == '\r') --content_end;
+      ParseLine(p, content_end, &records);
+      p = line_end + 1;
+    }
+    return records;
+  }
+
+ private:
+  int32_t Append(const char* begin, const char* end) {
+    text_->append(begin, end - begin);
+    return static_cast<int32_t>(text_->size());
+  }
+
+  void ParseLine(const char* p, const char* end,
+                 std::vector<Record>* records) {
+    int64_t start, duration;
+    if (ReadTimingTag(p, end, '[', ']', false, &start, &duration)) {
+      ParseWordLine(start, p, end, records);
+      return;
+    }
+
+    times_.clear();
+    int64_t time;
+    while (ReadTimestamp(p, end, &time)) times_.push_back(time);
+    if (times_.empty()) return;  // [ar:...] tags, JSON metadata, blank lines
+
+    Trim(p, end);
+    if (p == end) return;
+    int32_t begin = static_cast<int32_t>(text_->size());
+    int32_t text_end = Append(p, end);
+    for (int64_t line_start : times_) {
+      records->push_back({line_start, begin, text_end, 0, 0});
+    }
+  }
+
+  // The body of a YRC or QRC line. YRC puts each word's tag before its text,
+  // QRC after it; the first character tells which.
+  void ParseWordLine(int64_t line_start, const char* p, const char* end,
+                     std::vector<Record>* records) {
+    size_t line_begin = text_->size();
+    size_t first = words_->size();
+
+    const char* probe = p;
+    int64_t start, duration;
+    bool tag_first = ReadWordTag(probe, end, &start, &duration);
+    while (p != end) {
+      const char* word_begin;
+      const char* word_end;
+      if (tag_first) {
+        if (!ReadWordTag(p, end, &start, &duration)) break;
+        word_begin = p;
+        word_end = FindWordTag(p, end);
+        p = word_end;
+      } else {
+        const char* tag = FindWordTag(p, end);
+        if (tag == end) break;  // Untimed trailing text
+        word_begin = p;
+        word_end = tag;
+        p = tag;
+        ReadWordTag(p, end, &start, &duration);
+      }
+      if (word_begin == word_end) continue;
+      int32_t begin = static_cast<int32_t>(text_->size());
+      words_->push_back({start, duration, begin, Append(word_begin, word_end)});
+    }
+
+    // Trim the line at its outer words so they still concatenate to it:
+    // blank words at either edge are dropped, and the remaining edge words
+    // are trimmed within their own ranges.
+    const char* base = text_->data();
+    auto blank = [base](const Word& word) {
+      const char* b = base + word.begin;
+      const char* e = base + word.end;
+      Trim(b, e);
+      return b == e;
+    };
+    while (words_->size() > first && blank(words_->back())) {
+      words_->pop_back();
+    }
+    size_t lead = first;
+    while (lead < words_->size() && blank((*words_)[lead])) ++lead;
+    words_->erase(words_->begin() + first, words_->begin() + lead);
+
+    if (words_->size() > first) {
+      Word& head = (*words_)[first];
+      const char* b = base + head.begin;
+      while (size_t n = LeadingSpace(b, base + head.end)) b += n;
+      head.begin = static_cast<int32_t>(b - base);
+
+      Word& tail = words_->back();
+      const char* e = base + tail.end;
+      while (size_t n = TrailingSpace(base + tail.begin, e)) e -= n;
+      tail.end = static_cast<int32_t>(e - base);
+
+      records->push_back({line_start, head.begin, tail.end,
+                          static_cast<int32_t>(first),
+                          static_cast<int32_t>(words_->size() - first)});
+      return;
+    }
+    words_->resize(first);
+    text_->resize(line_begin);
+  }
+
+  std::string* text_;
+  std::vector<Word>* words_;
+  std::vector<int64_t> times_;
+};
+
+}  // namespace
+
+std::string_view LyricDocument::LineText(size_t line) const {
+  return std::string_view(text).substr(
+      text_ranges[4 * line], text_ranges[4 * line + 1] - text_ranges[4 * line]);
+}
+
+std::string_view LyricDocument::Translation(size_t line) const {
+  return std::string_view(text).substr(
+      text_ranges[4 * line + 2],
+      text_ranges[4 * line + 3] - text_ranges[4 * line + 2]);
+}
+
+int LyricDocument::LineAt(int64_t position_ms, int hint) const {
+  int count = static_cast<int>(start_ms.size());
+  if (count == 0 || position_ms < start_ms[0]) return -1;
+
+  if (hint >= 0 && hint < count && start_ms[hint] <= position_ms) {
+    if (hint + 1 == count || position_ms < start_ms[hint + 1]) return hint;
+    if (hint + 2 == count || position_ms < start_ms[hint + 2]) {
+      return hint + 1;
+    }
+  }
+  auto it = std::upper_bound(start_ms.begin(), start_ms.end(), position_ms);
+  return static_cast<int>(it - start_ms.begin()) - 1;
+}
+
+LyricDocument ParseLyrics(std::string_view lyric,
+                          std::string_view translation) {
+  LyricDocument document;
+  if (lyric.size() + translation.size() >
+      static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+    return document;  // Offsets are 32-bit; no real lyric comes close.
+  }
+
+  std::vector<Word> words;
+  document.text.reserve(lyric.size() + translation.size());
+  Tokenizer tokenizer(&document.text, &words);
+  std::vector<Record> lines = tokenizer.Parse(lyric);
+  std::vector<Record> translations = tokenizer.Parse(translation);
+
+  auto by_time = [](const Record& a, const Record& b) {
+    return a.start_ms < b.start_ms;
+  };
+  std::stable_sort(lines.begin(), lines.end(), by_time);
+  std::stable_sort(translations.begin(), translations.end(), by_time);
+
+  document.start_ms.reserve(lines.size());
+  document.text_ranges.reserve(4 * lines.size());
+  document.word_index.reserve(lines.size() + 1);
+  document.word_times.reserve(2 * words.size());
+  document.word_ranges.reserve(2 * words.size());
+
+  // Both lists are sorted, so translations are joined in one merge pass.
+  size_t t = 0;
+  for (const Record& line : lines) {
+    while (t < translations.size() &&
+           translations[t].start_ms < line.start_ms) {
+      ++t;
+    }
+    int32_t translation_begin = 0;
+    int32_t translation_end = 0;
+    // Several translations at one time: the last wins.
+    for (size_t u = t; u < translations.size() &&
+                       translations[u].start_ms == line.start_ms;
+         ++u) {
+      translation_begin = translations[u].begin;
+      translation_end = translations[u].end;
+    }
+
+    document.start_ms.push_back(line.start_ms);
+    document.text_ranges.insert(
+        document.text_ranges.end(),
+        {line.begin, line.end, translation_begin, translation_end});
+    for (int32_t w = 0; w < line.word_count; ++w) {
+      const Word& word = words[line.first_word + w];
+      document.word_times.push_back(word.start_ms);
+      document.word_times.push_back(word.duration_ms);
+      document.word_ranges.push_back(word.begin);
+      document.word_ranges.push_back(word.end);
+    }
+    document.word_index.push_back(
+        static_cast<int32_t>(document.word_times.size() / 2));
+  }
+  return document;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_lyrics_parse(const uint8_t* lyric, int64_t lyric_length,
+                          const uint8_t* translation,
+                          int64_t translation_length) {
+  if (lyric == nullptr || lyric_length < 0) return nullptr;
+  std::string_view translation_view;
+  if (translation != nullptr && translation_length > 0) {
+    translation_view = std::string_view(
+        reinterpret_cast<const char*>(translation),
+        static_cast<size_t>(translation_length));
+  }
+  return new cyrene::LyricDocument(cyrene::ParseLyrics(
+      std::string_view(reinterpret_cast<const char*>(lyric),
+                       static_cast<size_t>(lyric_length)),
+      translation_view));
+}
+
+void cyrene_lyrics_destroy(void* handle) {
+  delete static_cast<cyrene::LyricDocument*>(handle);
+}
+
+int32_t cyrene_lyrics_line_count(void* handle) {
+  return static_cast<int32_t>(
+      static_cast<cyrene::LyricDocument*>(handle)->size());
+}
+
+int32_t cyrene_lyrics_word_count(void* handle) {
+  return static_cast<int32_t>(
+      static_cast<cyrene::LyricDocument*>(handle)->word_count());
+}
+
+const uint8_t* cyrene_lyrics_text(void* handle, int64_t* length) {
+  const std::string& text = static_cast<cyrene::LyricDocument*>(handle)->text;
+  *length = static_cast<int64_t>(text.size());
+  return reinterpret_cast<const uint8_t*>(text.data());
+}
+
+const int64_t* cyrene_lyrics_start_times(void* handle) {
+  return static_cast<cyrene::LyricDocument*>(handle)->start_ms.data();
+}
+
+const int32_t* cyrene_lyrics_text_ranges(void* handle) {
+  return static_cast<cyrene::LyricDocument*>(handle)->text_ranges.data();
+}
+
+const int32_t* cyrene_lyrics_word_index(void* handle) {
+  return static_cast<cyrene::LyricDocument*>(handle)->word_index.data();
+}
+
+const int64_t* cyrene_lyrics_word_times(void* handle) {
+  return static_cast<cyrene::LyricDocument*>(handle)->word_times.data();
+}
+
+const int32_t* cyrene_lyrics_word_ranges(void* handle) {
+  return static_cast<cyrene::LyricDocument*>(handle)->word_ranges.data();
+}
+
+int32_t cyrene_lyrics_line_at(void* handle, int64_t position_ms,
+                              int32_t hint) {
+  return static_cast<cyrene::LyricDocument*>(handle)->LineAt(position_ms,
+                                                             hint);
+}
+
+}  // extern "C"
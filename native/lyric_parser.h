@@ -0,0 +1,84 @@
+#ifndef CYRENE_NATIVE_LYRIC_PARSER_H_
+#define CYRENE_NATIVE_LYRIC_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// A parsed lyric, flat and sorted by start time. Lines are stored as parallel
+// arrays with all text in one UTF-8 pool, so the whole document is a handful
+// of allocations and can be read from Dart without per-line calls:
+//
+//   start_ms[i]             line start
+//   text_ranges[4i .. 4i+3] line text [begin, end), translation [begin, end)
+//                           (an empty range when there is no translation)
+//   word_index[i .. i+1]    the line's words, [first, last); empty for LRC
+//   word_times[2w .. 2w+1]  word start and duration
+//   word_ranges[2w .. 2w+1] word text [begin, end)
+//
+// The words of a line concatenate to its text.
+struct LyricDocument {
+  std::string text;
+  std::vector<int64_t> start_ms;
+  std::vector<int32_t> text_ranges;
+  std::vector<int32_t> word_index{0};
+  std::vector<int64_t> word_times;
+  std::vector<int32_t> word_ranges;
+
+  size_t size() const { return start_ms.size(); }
+  size_t word_count() const { return word_times.size() / 2; }
+
+  std::string_view LineText(size_t line) const;
+  std::string_view Translation(size_t line) const;
+
+  // Index of the line shown at |position_ms| (the last one starting at or
+  // before it), or -1 before the first line. |hint| is the previous result:
+  // playback mostly stays on a line or moves to the next one, which is
+  // answered without a search; anything else is a binary search.
+  int LineAt(int64_t position_ms, int hint = -1) const;
+};
+
+// Parses a lyric in one pass over the text. Each line may be
+//   LRC       [mm:ss.xx]text, also [mm:ss:xx] and [mm:ss]; several leading
+//             timestamps repeat the line at each time
+//   YRC       [start,duration](start,duration,0)word(start,duration,0)word
+//   QRC       [start,duration]word(start,duration)word(start,duration)
+// (times in milliseconds); anything else (tags, JSON metadata) is skipped,
+// as are lines without text. |translation| is an LRC document whose lines are
+// attached to the lyric lines with the same start time.
+LyricDocument ParseLyrics(std::string_view lyric,
+                          std::string_view translation = {});
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/lyric_parser_native.dart. Handles returned
+// by cyrene_lyrics_parse() must be released with cyrene_lyrics_destroy(); the
+// array pointers stay valid until then (see LyricDocument for the layout).
+CYRENE_EXPORT void* cyrene_lyrics_parse(const uint8_t* lyric,
+                                        int64_t lyric_length,
+                                        const uint8_t* translation,
+                                        int64_t translation_length);
+CYRENE_EXPORT void cyrene_lyrics_destroy(void* handle);
+CYRENE_EXPORT int32_t cyrene_lyrics_line_count(void* handle);
+CYRENE_EXPORT int32_t cyrene_lyrics_word_count(void* handle);
+CYRENE_EXPORT const uint8_t* cyrene_lyrics_text(void* handle,
+                                                int64_t* length);
+CYRENE_EXPORT const int64_t* cyrene_lyrics_start_times(void* handle);
+CYRENE_EXPORT const int32_t* cyrene_lyrics_text_ranges(void* handle);
+CYRENE_EXPORT const int32_t* cyrene_lyrics_word_index(void* handle);
+CYRENE_EXPORT const int64_t* cyrene_lyrics_word_times(void* handle);
+CYRENE_EXPORT const int32_t* cyrene_lyrics_word_ranges(void* handle);
+CYRENE_EXPORT int32_t cyrene_lyrics_line_at(void* handle, int64_t position_ms,
+                                            int32_t hint);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_LYRIC_PARSER_H_
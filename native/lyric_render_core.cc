@@ -0,0 +1,71 @@
+#include "lyric_render_core.h"
+
+#include <algorithm>
+
+namespace cyrene {
+
+LyricRect LyricRect::Union(const LyricRect& other) const {
+  if (other.empty()) return *this;
+  if (empty()) return other;
+  return {std::min(left, other.left), std::min(top, other.top),
+          std::max(right, other.right), std::max(bottom, other.bottom)};
+}
+
+LyricRect LyricRect::Intersect(const LyricRect& other) const {
+  LyricRect result{std::max(left, other.left), std::max(top, other.top),
+                   std::min(right, other.right),
+                   std::min(bottom, other.bottom)};
+  return result.empty() ? LyricRect{} : result;
+}
+
+size_t GlyphKeyHash::operator()(const GlyphKey& key) const {
+  size_t hash = std::hash<std::string>()(key.text);
+  auto mix = [&hash](size_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+  };
+  mix(std::hash<std::string>()(key.font_family));
+  mix(std::hash<float>()(key.font_size));
+  mix(std::hash<float>()(key.stroke_width));
+  mix(std::hash<int>()(key.style));
+  return hash;
+}
+
+void DirtyTracker::Reset(int width, int height) {
+  surface_ = {0, 0, width, height};
+  content_ = {};
+  content_key_ = {};
+  dirty_ = surface_;
+}
+
+void DirtyTracker::SetContent(const LyricRect& bounds, const GlyphKey& key) {
+  if (bounds == content_ && key == content_key_) return;
+  dirty_ = dirty_.Union(content_).Union(bounds);
+  content_ = bounds;
+  content_key_ = key;
+}
+
+void DirtyTracker::InvalidateContent() { dirty_ = dirty_.Union(content_); }
+
+void DirtyTracker::Invalidate(const LyricRect& rect) {
+  dirty_ = dirty_.Union(rect);
+}
+
+void DirtyTracker::InvalidateAll() { dirty_ = surface_; }
+
+LyricRect DirtyTracker::Take() {
+  LyricRect result = dirty_.Intersect(surface_);
+  dirty_ = {};
+  return result;
+}
+
+void FrameStats::Record(std::chrono::steady_clock::duration elapsed) {
+  int64_t us =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+  last_us_ = us;
+  max_us_ = std::max(max_us_, us);
+  average_us_ = frames_ == 0 ? static_cast<double>(us)
+                             : average_us_ + (us - average_us_) / 32.0;
+  ++frames_;
+}
+
+}  // namespace cyrene
@@ -0,0 +1,190 @@
+#ifndef CYRENE_NATIVE_LYRIC_RENDER_CORE_H_
+#define CYRENE_NATIVE_LYRIC_RENDER_CORE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Platform-independent pieces of the desktop lyric renderers. The windowing
+// and drawing code lives in the runners; this file only decides what needs
+// to be rebuilt and redrawn, so it builds (and can be exercised) anywhere.
+
+namespace cyrene {
+
+// Integer pixel rectangle, right/bottom exclusive.
+struct LyricRect {
+  int left = 0;
+  int top = 0;
+  int right = 0;
+  int bottom = 0;
+
+  bool empty() const { return right <= left || bottom <= top; }
+  int width() const { return right - left; }
+  int height() const { return bottom - top; }
+
+  // Smallest rectangle covering both; an empty side is ignored.
+  LyricRect Union(const LyricRect& other) const;
+  LyricRect Intersect(const LyricRect& other) const;
+
+  bool operator==(const LyricRect& other) const {
+    return left == other.left && top == other.top && right == other.right &&
+           bottom == other.bottom;
+  }
+};
+
+// Everything that changes the shape of a rendered lyric line. Colours are
+// deliberately absent: recolouring reuses the same outlines.
+struct GlyphKey {
+  std::string text;  // UTF-8.
+  std::string font_family;
+  float font_size = 0;
+  float stroke_width = 0;
+  int style = 0;  // Toolkit-specific weight/style flags.
+
+  bool operator==(const GlyphKey& other) const {
+    return font_size == other.font_size &&
+           stroke_width == other.stroke_width && style == other.style &&
+           text == other.text && font_family == other.font_family;
+  }
+};
+
+struct GlyphKeyHash {
+  size_t operator()(const GlyphKey& key) const;
+};
+
+// Small LRU cache of built glyph outlines (GraphicsPath, cairo_path_t, ...).
+// Building an outline means shaping the text and flattening the curves, which
+// dominates the cost of a lyric redraw; lines repeat (choruses, re-renders on
+// recolour or show), so most redraws become a lookup.
+//
+// Not thread-safe; each window owns its own cache on its UI thread.
+template <typename Value>
+class GlyphCache {
+ public:
+  explicit GlyphCache(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+  GlyphCache(const GlyphCache&) = delete;
+  GlyphCache& operator=(const GlyphCache&) = delete;
+
+  // Returns the value for |key|, calling |build| (returning Value) to create
+  // it on a miss. The reference stays valid until the entry is evicted.
+  template <typename Build>
+  Value& Get(const GlyphKey& key, Build&& build) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      ++hits_;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->second;
+    }
+
+    ++builds_;
+    entries_.emplace_front(key, build());
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+      ++evictions_;
+    }
+    return entries_.front().second;
+  }
+
+  void Clear() {
+    index_.clear();
+    entries_.clear();
+  }
+
+  size_t size() const { return entries_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t builds() const { return builds_; }
+  uint64_t evictions() const { return evictions_; }
+
+ private:
+  using Entry = std::pair<GlyphKey, Value>;
+
+  const size_t capacity_;
+  std::list<Entry> entries_;  // Most recently used first.
+  std::unordered_map<GlyphKey, typename std::list<Entry>::iterator,
+                     GlyphKeyHash>
+      index_;
+  uint64_t hits_ = 0;
+  uint64_t builds_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+// Tracks which part of a persistent back buffer must be repainted and pushed
+// to the screen. A content change dirties the union of the old and new
+// content bounds; a style change dirties the current bounds only. Content is
+// identified by its glyph key as well as its bounds, since two lines of the
+// same length often lay out to the same rectangle.
+class DirtyTracker {
+ public:
+  // Sets the drawable area and marks all of it dirty (new back buffer).
+  void Reset(int width, int height);
+
+  // Records the content about to be drawn: its glyph key and bounds.
+  void SetContent(const LyricRect& bounds, const GlyphKey& key);
+
+  // The current content must be repainted in place (e.g. a colour change).
+  void InvalidateContent();
+  // Part of the content changed in place (e.g. a karaoke highlight step).
+  void Invalidate(const LyricRect& rect);
+  void InvalidateAll();
+
+  bool HasDirty() const { return !dirty_.empty(); }
+
+  // Returns the pending dirty area, clipped to the surface, and clears it.
+  LyricRect Take();
+
+  const LyricRect& content() const { return content_; }
+
+ private:
+  LyricRect surface_;
+  LyricRect content_;
+  GlyphKey content_key_;
+  LyricRect dirty_;
+};
+
+// Rolling render-time statistics, for the getRenderStats channel method and
+// for spotting regressions without a profiler attached.
+class FrameStats {
+ public:
+  void Record(std::chrono::steady_clock::duration elapsed);
+
+  uint64_t frames() const { return frames_; }
+  int64_t last_us() const { return last_us_; }
+  int64_t max_us() const { return max_us_; }
+  // Exponential moving average over roughly the last 32 frames.
+  int64_t average_us() const { return static_cast<int64_t>(average_us_); }
+
+ private:
+  uint64_t frames_ = 0;
+  int64_t last_us_ = 0;
+  int64_t max_us_ = 0;
+  double average_us_ = 0;
+};
+
+// Records the lifetime of the enclosing scope as one frame.
+class ScopedFrameTimer {
+ public:
+  explicit ScopedFrameTimer(FrameStats* stats)
+      : stats_(stats), start_(std::chrono::steady_clock::now()) {}
+  ~ScopedFrameTimer() {
+    stats_->Record(std::chrono::steady_clock::now() - start_);
+  }
+
+  ScopedFrameTimer(const ScopedFrameTimer&) = delete;
+  ScopedFrameTimer& operator=(const ScopedFrameTimer&) = delete;
+
+ private:
+  FrameStats* stats_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_LYRIC_RENDER_CORE_H_
@@ -0,0 +1,133 @@
+#include "lyric_style.h"
+
+#include <algorithm>
+
+#include "cyrene_format.h"
+
+namespace cyrene {
+
+namespace {
+
+// Encoded size of each field, in LyricStyleField bit order.
+constexpr size_t kFieldSizes[] = {4, 4, 4, 4, 4, 1, 1};
+constexpr size_t kFieldCount = sizeof(kFieldSizes) / sizeof(kFieldSizes[0]);
+constexpr size_t kHeaderSize = 3;
+
+}  // namespace
+
+bool DecodeLyricStyle(const uint8_t* data, size_t length,
+                      LyricStyleUpdate* update) {
+  if (length < kHeaderSize || data[0] != kLyricStyleVersion) return false;
+  uint16_t fields = format::ReadU16(data + 1);
+  if (fields >> kFieldCount) return false;
+
+  size_t expected = kHeaderSize;
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    if (fields & (1u << i)) expected += kFieldSizes[i];
+  }
+  if (length != expected) return false;
+
+  const uint8_t* p = data + kHeaderSize;
+  LyricStyle& values = update->values;
+  if (fields & kLyricStyleFontSize) {
+    values.font_size = static_cast<int32_t>(format::ReadU32(p));
+    p += 4;
+  }
+  if (fields & kLyricStyleTextColor) {
+    values.text_color = format::ReadU32(p);
+    p += 4;
+  }
+  if (fields & kLyricStyleStrokeColor) {
+    values.stroke_color = format::ReadU32(p);
+    p += 4;
+  }
+  if (fields & kLyricStyleStrokeWidth) {
+    values.stroke_width = static_cast<int32_t>(format::ReadU32(p));
+    p += 4;
+  }
+  if (fields & kLyricStyleHighlightColor) {
+    values.highlight_color = format::ReadU32(p);
+    p += 4;
+  }
+  if (fields & kLyricStyleDraggable) values.draggable = *p++ != 0;
+  if (fields & kLyricStyleMouseTransparent) {
+    values.mouse_transparent = *p++ != 0;
+  }
+  update->fields = fields;
+  return true;
+}
+
+std::vector<uint8_t> EncodeLyricStyle(const LyricStyleUpdate& update) {
+  uint16_t fields = update.fields & ((1u << kFieldCount) - 1);
+  size_t length = kHeaderSize;
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    if (fields & (1u << i)) length += kFieldSizes[i];
+  }
+
+  std::vector<uint8_t> out(length);
+  out[0] = kLyricStyleVersion;
+  format::WriteU16(out.data() + 1, fields);
+  uint8_t* p = out.data() + kHeaderSize;
+  auto put_u32 = [&p](uint32_t value) {
+    format::WriteU32(p, value);
+    p += 4;
+  };
+
+  const LyricStyle& values = update.values;
+  if (fields & kLyricStyleFontSize) {
+    put_u32(static_cast<uint32_t>(values.font_size));
+  }
+  if (fields & kLyricStyleTextColor) put_u32(values.text_color);
+  if (fields & kLyricStyleStrokeColor) put_u32(values.stroke_color);
+  if (fields & kLyricStyleStrokeWidth) {
+    put_u32(static_cast<uint32_t>(values.stroke_width));
+  }
+  if (fields & kLyricStyleHighlightColor) put_u32(values.highlight_color);
+  if (fields & kLyricStyleDraggable) *p++ = values.draggable;
+  if (fields & kLyricStyleMouseTransparent) *p++ = values.mouse_transparent;
+  return out;
+}
+
+LyricRedraw ApplyLyricStyle(const LyricStyleUpdate& update,
+                            LyricStyle* style) {
+  const LyricStyle& values = update.values;
+  LyricRedraw redraw = LyricRedraw::kNone;
+  auto need = [&redraw](LyricRedraw level) {
+    redraw = std::max(redraw, level);
+  };
+
+  if ((update.fields & kLyricStyleFontSize) &&
+      values.font_size != style->font_size) {
+    style->font_size = values.font_size;
+    need(LyricRedraw::kRelayout);
+  }
+  if ((update.fields & kLyricStyleStrokeWidth) &&
+      values.stroke_width != style->stroke_width) {
+    style->stroke_width = values.stroke_width;
+    need(LyricRedraw::kRelayout);
+  }
+  if ((update.fields & kLyricStyleTextColor) &&
+      values.text_color != style->text_color) {
+    style->text_color = values.text_color;
+    need(LyricRedraw::kRepaint);
+  }
+  if ((update.fields & kLyricStyleStrokeColor) &&
+      values.stroke_color != style->stroke_color) {
+    style->stroke_color = values.stroke_color;
+    need(LyricRedraw::kRepaint);
+  }
+  if ((update.fields & kLyricStyleHighlightColor) &&
+      values.highlight_color != style->highlight_color) {
+    style->highlight_color = values.highlight_color;
+    need(LyricRedraw::kRepaint);
+  }
+  if (update.fields & kLyricStyleDraggable) {
+    style->draggable = values.draggable;
+  }
+  if (update.fields & kLyricStyleMouseTransparent) {
+    style->mouse_transparent = values.mouse_transparent;
+  }
+  return redraw;
+}
+
+}  // namespace cyrene
@@ -0,0 +1,63 @@
+#ifndef CYRENE_NATIVE_LYRIC_STYLE_H_
+#define CYRENE_NATIVE_LYRIC_STYLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cyrene {
+
+// Appearance of a desktop lyric window.
+struct LyricStyle {
+  int32_t font_size = 32;
+  uint32_t text_color = 0xFFFFFFFF;       // ARGB
+  uint32_t stroke_color = 0xFF000000;     // ARGB
+  int32_t stroke_width = 2;
+  uint32_t highlight_color = 0xFF4FC3F7;  // ARGB
+  bool draggable = true;
+  bool mouse_transparent = false;
+};
+
+// Bits of LyricStyleUpdate::fields; also the order fields are encoded in.
+enum LyricStyleField : uint16_t {
+  kLyricStyleFontSize = 1 << 0,
+  kLyricStyleTextColor = 1 << 1,
+  kLyricStyleStrokeColor = 1 << 2,
+  kLyricStyleStrokeWidth = 1 << 3,
+  kLyricStyleHighlightColor = 1 << 4,
+  kLyricStyleDraggable = 1 << 5,
+  kLyricStyleMouseTransparent = 1 << 6,
+};
+
+// A partial style change: only the fields named in |fields| are meaningful.
+struct LyricStyleUpdate {
+  uint16_t fields = 0;
+  LyricStyle values;
+};
+
+// Compact binary form of a LyricStyleUpdate, sent from Dart as one
+// Uint8List ("applyStyle") instead of one method call per property:
+//   u8 version (1) | u16 fields | each present field in bit order:
+//   font size i32, text colour u32, stroke colour u32, stroke width i32,
+//   highlight colour u32, draggable u8, mouse transparent u8
+// Integers are big-endian, like the rest of the native formats.
+constexpr uint8_t kLyricStyleVersion = 1;
+
+bool DecodeLyricStyle(const uint8_t* data, size_t length,
+                      LyricStyleUpdate* update);
+std::vector<uint8_t> EncodeLyricStyle(const LyricStyleUpdate& update);
+
+// How much of a redraw a style change requires.
+enum class LyricRedraw {
+  kNone,      // Nothing visible changed (or only window behaviour).
+  kRepaint,   // Colours changed: repaint the current outlines.
+  kRelayout,  // Shape changed: outlines must be rebuilt.
+};
+
+// Applies the fields of |update| that differ from |style| and reports the
+// single redraw that covers all of them, so a whole theme costs one frame.
+LyricRedraw ApplyLyricStyle(const LyricStyleUpdate& update, LyricStyle* style);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_LYRIC_STYLE_H_
@@ -0,0 +1,127 @@
+#include "lyric_timeline.h"
+
+#include <algorithm>
+
+namespace cyrene {
+
+namespace {
+
+size_t CountCodePoints(const std::string& text) {
+  size_t count = 0;
+  for (unsigned char c : text) {
+    if ((c & 0xC0) != 0x80) ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+void LyricTimeline::SetLines(std::vector<LyricTimelineLine> lines) {
+  std::stable_sort(lines.begin(), lines.end(),
+                   [](const LyricTimelineLine& a, const LyricTimelineLine& b) {
+                     return a.start_ms < b.start_ms;
+                   });
+
+  lines_.clear();
+  lines_.reserve(lines.size());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    Line line;
+    line.characters = CountCodePoints(lines[i].text);
+
+    int64_t cap = static_cast<int64_t>(line.characters) * kMaxMsPerCharacter;
+    int64_t sweep = cap;
+    if (i + 1 < lines.size()) {
+      sweep = std::min(lines[i + 1].start_ms - lines[i].start_ms, cap);
+    }
+    line.sweep_end_ms = lines[i].start_ms + std::max<int64_t>(sweep, 0);
+
+    // Word timing is only usable if it covers the line's text; otherwise
+    // fall back to the synthesized sweep.
+    size_t before = 0;
+    for (const LyricWord& word : lines[i].words) {
+      size_t characters = CountCodePoints(word.text);
+      line.words.push_back({word.start_ms,
+                            word.start_ms + std::max<int64_t>(
+                                                word.duration_ms, 0),
+                            before, characters});
+      before += characters;
+    }
+    if (before != line.characters || before == 0) line.words.clear();
+
+    line.line = std::move(lines[i]);
+    lines_.push_back(std::move(line));
+  }
+}
+
+void LyricTimeline::Clear() { lines_.clear(); }
+
+int LyricTimeline::LineAt(int64_t position_ms) const {
+  auto it = std::upper_bound(
+      lines_.begin(), lines_.end(), position_ms,
+      [](int64_t position, const Line& line) {
+        return position < line.line.start_ms;
+      });
+  return static_cast<int>(it - lines_.begin()) - 1;
+}
+
+KaraokeFrame LyricTimeline::FrameAt(int64_t position_ms) const {
+  KaraokeFrame frame;
+  frame.line = LineAt(position_ms);
+  if (frame.line >= 0) {
+    frame.progress = ProgressAt(lines_[frame.line], position_ms);
+  }
+  return frame;
+}
+
+double LyricTimeline::ProgressAt(const Line& line, int64_t position_ms) const {
+  if (line.characters == 0) return 1;
+
+  if (line.words.empty()) {
+    int64_t span = line.sweep_end_ms - line.line.start_ms;
+    if (span <= 0 || position_ms >= line.sweep_end_ms) return 1;
+    return static_cast<double>(position_ms - line.line.start_ms) / span;
+  }
+
+  // Last word starting at or before |position_ms|.
+  auto it = std::upper_bound(
+      line.words.begin(), line.words.end(), position_ms,
+      [](int64_t position, const Word& word) {
+        return position < word.start_ms;
+      });
+  if (it == line.words.begin()) return 0;
+  const Word& word = *(it - 1);
+
+  double within = 1;
+  if (position_ms < word.end_ms) {
+    within = static_cast<double>(position_ms - word.start_ms) /
+             (word.end_ms - word.start_ms);
+  }
+  return (word.characters_before + within * word.characters) / line.characters;
+}
+
+void LyricClock::Sync(int64_t position_ms, bool playing,
+                      Clock::time_point now) {
+  int64_t predicted = PositionAt(now);
+  bool seek = position_ms > predicted + kSeekThresholdMs ||
+              position_ms < predicted - kSeekThresholdMs || !playing_ ||
+              !playing;
+  base_ms_ = position_ms;
+  base_time_ = now;
+  playing_ = playing;
+  if (seek) last_ms_ = position_ms;
+}
+
+int64_t LyricClock::PositionAt(Clock::time_point now) {
+  int64_t position = base_ms_;
+  if (playing_) {
+    position += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - base_time_)
+                    .count();
+    // Hold instead of stepping back after a small correction.
+    position = std::max(position, last_ms_);
+  }
+  last_ms_ = position;
+  return position;
+}
+
+}  // namespace cyrene
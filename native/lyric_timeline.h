@@ -0,0 +1,110 @@
+#ifndef CYRENE_NATIVE_LYRIC_TIMELINE_H_
+#define CYRENE_NATIVE_LYRIC_TIMELINE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cyrene {
+
+// One timed word (or syllable) of a lyric line.
+struct LyricWord {
+  int64_t start_ms = 0;
+  int64_t duration_ms = 0;
+  std::string text;  // UTF-8; the words of a line concatenate to its text.
+};
+
+struct LyricTimelineLine {
+  int64_t start_ms = 0;
+  std::string text;  // UTF-8.
+  std::string translation;
+  std::vector<LyricWord> words;  // Empty for plain LRC lines.
+};
+
+// What a karaoke renderer should show at a given instant.
+struct KaraokeFrame {
+  int line = -1;        // Index into the timeline, -1 before the first line.
+  double progress = 0;  // Sung fraction of the line's characters, [0, 1].
+
+  bool operator==(const KaraokeFrame& other) const {
+    return line == other.line && progress == other.progress;
+  }
+  bool operator!=(const KaraokeFrame& other) const { return !(*this == other); }
+};
+
+// A whole timed lyric document, handed over once per track so the window
+// can drive its own highlight.
+//
+// Progress is measured in code points: with word timing, finished words count
+// fully and the current word proportionally to its elapsed time; without it,
+// the line is swept at a steady pace until the next line starts (capped so
+// that a long instrumental gap does not stretch the last words).
+class LyricTimeline {
+ public:
+  // Upper bound on the synthesized time per character of an untimed line.
+  static constexpr int64_t kMaxMsPerCharacter = 400;
+
+  void SetLines(std::vector<LyricTimelineLine> lines);
+  void Clear();
+
+  bool empty() const { return lines_.empty(); }
+  size_t size() const { return lines_.size(); }
+  const LyricTimelineLine& line(int index) const { return lines_[index].line; }
+
+  // Line shown at |position_ms|, or -1 before the first one.
+  int LineAt(int64_t position_ms) const;
+
+  KaraokeFrame FrameAt(int64_t position_ms) const;
+
+ private:
+  struct Word {
+    int64_t start_ms;
+    int64_t end_ms;
+    size_t characters_before;
+    size_t characters;
+  };
+
+  struct Line {
+    LyricTimelineLine line;
+    int64_t sweep_end_ms;  // End of the synthesized sweep (untimed lines).
+    size_t characters;
+    std::vector<Word> words;
+  };
+
+  double ProgressAt(const Line& line, int64_t position_ms) const;
+
+  std::vector<Line> lines_;
+};
+
+// Playback position between the occasional syncs from Dart: advances with
+// the monotonic clock while playing and holds while paused. Small backwards
+// corrections (the player's position reports lag a little) are absorbed by
+// holding the position until the clock catches up, so the highlight never
+// jitters backwards; anything larger is treated as a seek and applied at once.
+class LyricClock {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Corrections larger than this are seeks rather than drift.
+  static constexpr int64_t kSeekThresholdMs = 400;
+
+  void Sync(int64_t position_ms, bool playing, Clock::time_point now);
+
+  // Interpolated position at |now|. Non-decreasing while playing between
+  // seeks.
+  int64_t PositionAt(Clock::time_point now);
+
+  bool playing() const { return playing_; }
+
+ private:
+  int64_t base_ms_ = 0;
+  Clock::time_point base_time_;
+  bool playing_ = false;
+  int64_t last_ms_ = 0;
+};
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_LYRIC_TIMELINE_H_
@@ -0,0 +1,13 @@
+#ifndef CYRENE_NATIVE_NATIVE_EXPORT_H_
+#define CYRENE_NATIVE_NATIVE_EXPORT_H_
+
+// Marks a C entry point as part of the libcyrene_native FFI surface. The
+// library is built with hidden visibility, so only these symbols are visible
+// to Dart's DynamicLibrary.lookup().
+#if defined(_WIN32)
+#define CYRENE_EXPORT __declspec(dllexport)
+#else
+#define CYRENE_EXPORT __attribute__((visibility("default")))
+#endif
+
+#endif  // CYRENE_NATIVE_NATIVE_EXPORT_H_
@@ -0,0 +1,368 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <vector>
+
+#include "image_codec.h"
+
+namespace cyrene {
+
+namespace {
+
+// Android's Palette resizes to about 112x112 before quantizing; sampling on
+// the same grid gives the same colors for much less work.
+constexpr int kSampleSize = 112;
+constexpr int kMaxColors = 16;
+
+constexpr int kBins = 1 << 15;  // 5 bits per channel
+constexpr uint16_t kSkip = 0xFFFF;
+
+// ---- Histogram ------------------------------------------------------------
+
+// Histogram bins of every |step|-th pixel of a row. Kept free of branches so
+// the compiler vectorizes it; pixels that are mostly transparent map to
+// kSkip.
+template <int kChannels>
+int BinRow(const uint8_t* row, int width, int step, uint16_t* bins) {
+  int count = 0;
+  for (int x = 0; x < width; x += step) {
+    const uint8_t* p = row + x * kChannels;
+    uint16_t bin = static_cast<uint16_t>(((p[0] >> 3) << 10) |
+                                         ((p[1] >> 3) << 5) | (p[2] >> 3));
+    if (kChannels == 4) bin = p[3] < 128 ? kSkip : bin;
+    bins[count++] = bin;
+  }
+  return count;
+}
+
+void Count(const uint16_t* bins, int begin, int end,
+           std::vector<uint32_t>* histogram) {
+  for (int i = begin; i < end; ++i) {
+    if (bins[i] != kSkip) ++(*histogram)[bins[i]];
+  }
+}
+
+// ---- Quantization ---------------------------------------------------------
+
+struct Hsl {
+  float h;  // Degrees
+  float s;
+  float l;
+};
+
+Hsl ToHsl(uint32_t rgb) {
+  float r = ((rgb >> 16) & 0xFF) / 255.0f;
+  float g = ((rgb >> 8) & 0xFF) / 255.0f;
+  float b = (rgb & 0xFF) / 255.0f;
+  float max = std::max({r, g, b});
+  float min = std::min({r, g, b});
+  float delta = max - min;
+  Hsl hsl{0, 0, (max + min) / 2};
+  if (delta == 0) return hsl;
+  if (max == r) {
+    hsl.h = std::fmod((g - b) / delta, 6.0f);
+  } else if (max == g) {
+    hsl.h = (b - r) / delta + 2;
+  } else {
+    hsl.h = (r - g) / delta + 4;
+  }
+  hsl.h = std::fmod(hsl.h * 60 + 360, 360.0f);
+  hsl.s = delta / (1 - std::fabs(2 * hsl.l - 1));
+  return hsl;
+}
+
+// Palette's default filter: near black, near white and skin tones (the
+// "I line" of the HSL space) make poor theme colors.
+bool IsAllowed(uint32_t rgb) {
+  Hsl hsl = ToHsl(rgb);
+  return hsl.l > 0.05f && hsl.l < 0.95f &&
+         !(hsl.h >= 10 && hsl.h <= 37 && hsl.s <= 0.82f);
+}
+
+int Component(uint16_t bin, int which) {
+  return (bin >> (10 - 5 * which)) & 0x1F;
+}
+
+uint32_t BinToRgb(uint16_t bin) {
+  auto expand = [](int value) {
+    return static_cast<uint32_t>(value << 3 | value >> 2);
+  };
+  return expand(Component(bin, 0)) << 16 | expand(Component(bin, 1)) << 8 |
+         expand(Component(bin, 2));
+}
+
+struct ColorCount {
+  uint16_t bin;
+  uint32_t count;
+};
+
+// A box of the median cut: colors [begin, end) of the working list.
+struct Box {
+  int begin;
+  int end;
+  int min[3];
+  int max[3];
+  uint32_t population;
+
+  int Volume() const {
+    return (max[0] - min[0] + 1) * (max[1] - min[1] + 1) *
+           (max[2] - min[2] + 1);
+  }
+  bool CanSplit() const { return end - begin > 1; }
+};
+
+Box Fit(const std::vector<ColorCount>& colors, int begin, int end) {
+  Box box{begin, end, {31, 31, 31}, {0, 0, 0}, 0};
+  for (int i = begin; i < end; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      int value = Component(colors[i].bin, c);
+      box.min[c] = std::min(box.min[c], value);
+      box.max[c] = std::max(box.max[c], value);
+    }
+    box.population += colors[i].count;
+  }
+  return box;
+}
+
+// Sorts the box along its longest side and splits it where half of its
+// population is on either side.
+int SplitPoint(std::vector<ColorCount>* colors, const Box& box) {
+  int longest = 0;
+  for (int c = 1; c < 3; ++c) {
+    if (box.max[c] - box.min[c] > box.max[longest] - box.min[longest]) {
+      longest = c;
+    }
+  }
+  // Rotating the bin puts the longest side in the high bits, so a plain
+  // sort orders by it and breaks ties by the other two.
+  auto key = [longest](uint16_t bin) {
+    int shift = 5 * longest;
+    return static_cast<uint16_t>(((bin << shift) | (bin >> (15 - shift))) &
+                                 0x7FFF);
+  };
+  std::sort(colors->begin() + box.begin, colors->begin() + box.end,
+            [&key](const ColorCount& a, const ColorCount& b) {
+              return key(a.bin) < key(b.bin);
+            });
+
+  uint32_t half = box.population / 2;
+  uint32_t sum = 0;
+  for (int i = box.begin; i < box.end; ++i) {
+    sum += (*colors)[i].count;
+    if (sum >= half) return std::min(i + 1, box.end - 1);
+  }
+  return box.begin + 1;
+}
+
+Swatch Average(const std::vector<ColorCount>& colors, const Box& box) {
+  double sum[3] = {0, 0, 0};
+  for (int i = box.begin; i < box.end; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      sum[c] += static_cast<double>(Component(colors[i].bin, c)) *
+                colors[i].count;
+    }
+  }
+  uint32_t rgb = 0;
+  for (int c = 0; c < 3; ++c) {
+    double average = sum[c] / box.population;  // 5-bit
+    rgb = rgb << 8 | static_cast<uint32_t>(std::lround(average * 255 / 31));
+  }
+  return {0xFF000000u | rgb, box.population};
+}
+
+std::vector<Swatch> Quantize(const std::vector<uint32_t>& histogram) {
+  std::vector<ColorCount> colors;
+  for (int bin = 0; bin < kBins; ++bin) {
+    uint16_t color = static_cast<uint16_t>(bin);
+    if (histogram[bin] != 0 && IsAllowed(BinToRgb(color))) {
+      colors.push_back({color, histogram[bin]});
+    }
+  }
+
+  std::vector<Swatch> swatches;
+  if (colors.size() <= static_cast<size_t>(kMaxColors)) {
+    for (const ColorCount& color : colors) {
+      swatches.push_back({0xFF000000u | BinToRgb(color.bin), color.count});
+    }
+    return swatches;
+  }
+
+  auto smaller = [](const Box& a, const Box& b) {
+    return a.Volume() < b.Volume();
+  };
+  std::priority_queue<Box, std::vector<Box>, decltype(smaller)> boxes(smaller);
+  boxes.push(Fit(colors, 0, static_cast<int>(colors.size())));
+  std::vector<Box> done;
+  while (!boxes.empty() &&
+         boxes.size() + done.size() < static_cast<size_t>(kMaxColors)) {
+    Box box = boxes.top();
+    boxes.pop();
+    if (!box.CanSplit()) {
+      done.push_back(box);
+      continue;
+    }
+    int split = SplitPoint(&colors, box);
+    boxes.push(Fit(colors, box.begin, split));
+    boxes.push(Fit(colors, split, box.end));
+  }
+  for (; !boxes.empty(); boxes.pop()) done.push_back(boxes.top());
+
+  for (const Box& box : done) {
+    Swatch swatch = Average(colors, box);
+    if (IsAllowed(swatch.argb)) swatches.push_back(swatch);
+  }
+  return swatches;
+}
+
+// ---- Targets --------------------------------------------------------------
+
+struct Target {
+  float min_saturation, target_saturation, max_saturation;
+  float min_lightness, target_lightness, max_lightness;
+  Swatch Palette::*field;
+};
+
+// In Palette's order: each target takes the best swatch left over by the
+// ones before it.
+constexpr Target kTargets[] = {
+    {0.35f, 1.0f, 1.0f, 0.55f, 0.74f, 1.0f, &Palette::light_vibrant},
+    {0.35f, 1.0f, 1.0f, 0.3f, 0.5f, 0.7f, &Palette::vibrant},
+    {0.35f, 1.0f, 1.0f, 0.0f, 0.26f, 0.45f, &Palette::dark_vibrant},
+    {0.0f, 0.3f, 0.4f, 0.55f, 0.74f, 1.0f, &Palette::light_muted},
+    {0.0f, 0.3f, 0.4f, 0.3f, 0.5f, 0.7f, &Palette::muted},
+    {0.0f, 0.3f, 0.4f, 0.0f, 0.26f, 0.45f, &Palette::dark_muted},
+};
+
+constexpr float kSaturationWeight = 0.24f;
+constexpr float kLightnessWeight = 0.52f;
+constexpr float kPopulationWeight = 0.24f;
+
+Palette BuildPalette(const std::vector<uint32_t>& histogram) {
+  Palette palette;
+  std::vector<Swatch> swatches = Quantize(histogram);
+  if (swatches.empty()) return palette;
+
+  uint32_t max_population = 0;
+  for (const Swatch& swatch : swatches) {
+    if (swatch.population > palette.dominant.population) {
+      palette.dominant = swatch;
+    }
+    max_population = std::max(max_population, swatch.population);
+  }
+
+  std::vector<Hsl> hsl;
+  for (const Swatch& swatch : swatches) hsl.push_back(ToHsl(swatch.argb));
+  std::vector<bool> used(swatches.size(), false);
+  for (const Target& target : kTargets) {
+    int best = -1;
+    float best_score = 0;
+    for (size_t i = 0; i < swatches.size(); ++i) {
+      const Hsl& color = hsl[i];
+      if (used[i] || color.s < target.min_saturation ||
+          color.s > target.max_saturation ||
+          color.l < target.min_lightness || color.l > target.max_lightness) {
+        continue;
+      }
+      float score =
+          kSaturationWeight *
+              (1 - std::fabs(color.s - target.target_saturation)) +
+          kLightnessWeight *
+              (1 - std::fabs(color.l - target.target_lightness)) +
+          kPopulationWeight * swatches[i].population / max_population;
+      if (best < 0 || score > best_score) {
+        best = static_cast<int>(i);
+        best_score = score;
+      }
+    }
+    if (best >= 0) {
+      used[best] = true;
+      palette.*target.field = swatches[best];
+    }
+  }
+  return palette;
+}
+
+}  // namespace
+
+bool ExtractPalette(const uint8_t* data, size_t size,
+                    const PaletteRegion* region, Palette* palette,
+                    Palette* region_palette) {
+  DecodedImage image;
+  if (data == nullptr || !DecodeImage(data, size, kSampleSize, &image) ||
+      image.width == 0 || image.height == 0) {
+    return false;
+  }
+
+  int step = std::max(1, std::min(image.width, image.height) / kSampleSize);
+  int samples_per_row = (image.width + step - 1) / step;
+  // The region in sample columns [column_begin, column_end) and rows.
+  int column_begin = 0, column_end = 0, row_begin = 0, row_end = 0;
+  if (region != nullptr && region_palette != nullptr) {
+    auto scale = [](float fraction, int size) {
+      float clamped = std::clamp(fraction, 0.0f, 1.0f);
+      return static_cast<int>(std::lround(clamped * size));
+    };
+    int left = scale(region->left, image.width);
+    int right = scale(region->right, image.width);
+    column_begin = (left + step - 1) / step;
+    column_end = (right + step - 1) / step;
+    row_begin = scale(region->top, image.height);
+    row_end = scale(region->bottom, image.height);
+  }
+
+  std::vector<uint32_t> histogram(kBins, 0);
+  std::vector<uint32_t> region_histogram(row_end > row_begin ? kBins : 0, 0);
+  std::vector<uint16_t> bins(samples_per_row);
+  size_t stride = static_cast<size_t>(image.width) * image.channels;
+  for (int y = 0; y < image.height; y += step) {
+    const uint8_t* row = image.pixels.data() + y * stride;
+    int count = image.channels == 4
+                    ? BinRow<4>(row, image.width, step, bins.data())
+                    : BinRow<3>(row, image.width, step, bins.data());
+    Count(bins.data(), 0, count, &histogram);
+    if (y >= row_begin && y < row_end) {
+      Count(bins.data(), column_begin, std::min(column_end, count),
+            &region_histogram);
+    }
+  }
+
+  *palette = BuildPalette(histogram);
+  if (region_palette != nullptr) {
+    *region_palette = region_histogram.empty() ? Palette()
+                                               : BuildPalette(region_histogram);
+  }
+  return true;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_palette_extract(const uint8_t* data, int64_t length,
+                               double left, double top, double right,
+                               double bottom, uint32_t* out) {
+  if (length <= 0 || out == nullptr) return 0;
+  cyrene::PaletteRegion region;
+  region.left = static_cast<float>(left);
+  region.top = static_cast<float>(top);
+  region.right = static_cast<float>(right);
+  region.bottom = static_cast<float>(bottom);
+  cyrene::Palette palettes[2];
+  if (!cyrene::ExtractPalette(data, static_cast<size_t>(length), &region,
+                              &palettes[0], &palettes[1])) {
+    return 0;
+  }
+  for (const cyrene::Palette& palette : palettes) {
+    for (const cyrene::Swatch* swatch :
+         {&palette.vibrant, &palette.dark_vibrant, &palette.light_vibrant,
+          &palette.muted, &palette.dark_muted, &palette.light_muted,
+          &palette.dominant}) {
+      *out++ = swatch->population != 0 ? swatch->argb : 0;
+    }
+  }
+  return 1;
+}
+
+}  // extern "C"
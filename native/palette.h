@@ -0,0 +1,68 @@
+#ifndef CYRENE_NATIVE_PALETTE_H_
+#define CYRENE_NATIVE_PALETTE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// A representative color of an image and the share of sampled pixels it
+// stands for. A population of 0 means the image has no such color.
+struct Swatch {
+  uint32_t argb = 0;
+  uint32_t population = 0;
+};
+
+// The same targets as Android's Palette (and Flutter's PaletteGenerator),
+// each picked from a different swatch, plus the most common color.
+struct Palette {
+  Swatch vibrant;
+  Swatch dark_vibrant;
+  Swatch light_vibrant;
+  Swatch muted;
+  Swatch dark_muted;
+  Swatch light_muted;
+  Swatch dominant;
+};
+
+// A sub-rectangle of the image as fractions of its size.
+struct PaletteRegion {
+  float left = 0;
+  float top = 0;
+  float right = 1;
+  float bottom = 1;
+};
+
+// Extracts the palette of a JPEG or PNG cover.
+//
+// JPEGs are decoded with DCT scaling straight to about kSampleSize pixels
+// on the short side, so a 1000x1000 cover costs an eighth-scale decode; PNGs
+// are decoded fully and sampled on a grid. Sampled pixels go into a 5-bit
+// per channel RGB histogram, which a median cut reduces to at most 16
+// swatches before scoring the targets.
+//
+// With |region|, pixels inside it are also counted in a second histogram in
+// the same pass and |region_palette| receives its palette.
+//
+// Returns false if the data cannot be decoded.
+bool ExtractPalette(const uint8_t* data, size_t size,
+                    const PaletteRegion* region, Palette* palette,
+                    Palette* region_palette);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/palette_native.dart. Writes 14 ARGB colors
+// to |out| (full image, then region, each in Palette's field order; 0 where
+// a swatch is missing). Returns 0 if the image cannot be decoded.
+CYRENE_EXPORT int32_t cyrene_palette_extract(const uint8_t* data,
+                                             int64_t length, double left,
+                                             double top, double right,
+                                             double bottom, uint32_t* out);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_PALETTE_H_
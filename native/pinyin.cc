@@ -0,0 +1,86 @@
+#include "pinyin.h"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "icu_loader.h"
+
+namespace cyrene {
+
+namespace {
+
+struct TransliteratorCloser {
+  void operator()(void* t) const { Icu()->trans_close(t); }
+};
+
+// UTRANS_FORWARD.
+constexpr int kForward = 0;
+
+class PinyinTable {
+ public:
+  std::string_view Get(char32_t c) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = readings_.find(c);
+    if (it == readings_.end()) {
+      it = readings_.emplace(c, Transliterate(c)).first;
+    }
+    return it->second;
+  }
+
+ private:
+  // Returns "" when ICU is unavailable or the result is not a plain
+  // syllable (unassigned characters come back unchanged).
+  std::string Transliterate(char32_t c) {
+    const IcuApi* icu = Icu();
+    int status = kIcuZeroError;
+    if (!opened_ && icu != nullptr) {
+      opened_ = true;
+      IcuParseError error;
+      transliterator_.reset(icu->trans_open(u"Han-Latin; Latin-ASCII; Lower",
+                                            -1, kForward, nullptr, 0, &error,
+                                            &status));
+      if (IcuFailure(status)) transliterator_.reset();
+    }
+    if (!transliterator_) return std::string();
+
+    char16_t buffer[32];
+    int32_t length = 0;
+    if (c < 0x10000) {
+      buffer[length++] = static_cast<char16_t>(c);
+    } else {
+      buffer[length++] = static_cast<char16_t>(0xD7C0 + (c >> 10));
+      buffer[length++] = static_cast<char16_t>(0xDC00 | (c & 0x3FF));
+    }
+    int32_t limit = length;
+    icu->trans_uchars(transliterator_.get(), buffer, &length,
+                      static_cast<int32_t>(std::size(buffer)), 0, &limit,
+                      &status);
+    if (IcuFailure(status)) return std::string();
+
+    std::string reading;
+    for (int32_t i = 0; i < length; ++i) {
+      if (buffer[i] < 'a' || buffer[i] > 'z') return std::string();
+      reading.push_back(static_cast<char>(buffer[i]));
+    }
+    return reading;
+  }
+
+  std::mutex mutex_;
+  bool opened_ = false;
+  std::unique_ptr<void, TransliteratorCloser> transliterator_;
+  // Node-based, so views of the stored strings survive rehashing.
+  std::unordered_map<char32_t, std::string> readings_;
+};
+
+}  // namespace
+
+std::string_view PinyinOf(char32_t c) {
+  static PinyinTable* table = new PinyinTable();
+  return table->Get(c);
+}
+
+}  // namespace cyrene
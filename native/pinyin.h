@@ -0,0 +1,21 @@
+#ifndef CYRENE_NATIVE_PINYIN_H_
+#define CYRENE_NATIVE_PINYIN_H_
+
+#include <string_view>
+
+namespace cyrene {
+
+// Toneless lowercase ASCII pinyin of the Han character |c| ("zhou" for 周),
+// or an empty view for characters without a reading and when ICU is not
+// installed. Polyphonic characters
+// get ICU's Han-Latin default reading only.
+//
+// Readings are transliterated on first use and cached for the lifetime of
+// the process (the whole table takes ICU several hundred milliseconds, far
+// more than a library ever needs). The returned view stays valid forever.
+// Thread-safe.
+std::string_view PinyinOf(char32_t c);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_PINYIN_H_
@@ -0,0 +1,344 @@
+#include "prefetch_scheduler.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace cyrene {
+
+namespace {
+
+// Segments per prefetch window (512 KB). Small, so that cancellation and a
+// change of first choice take effect quickly and one window never holds the
+// bandwidth budget for long.
+constexpr uint32_t kPrefetchWindowSegments = 8;
+
+// Consecutive windows that may fail (expired URL, network down) before a
+// request is given up until it is resubmitted with a new URL.
+constexpr int kMaxFailures = 2;
+
+// Re-check interval while the only remaining work waits on a segment a
+// playing client is fetching.
+constexpr auto kDeferredRetry = std::chrono::milliseconds(200);
+
+enum class WindowState { kReady, kDeferred, kDone };
+
+// First line of a small sysfs/procfs file, without the newline.
+std::string ReadLine(const std::string& path) {
+  FILE* file = std::fopen(path.c_str(), "re");
+  if (file == nullptr) return std::string();
+  char line[256] = {0};
+  if (std::fgets(line, sizeof(line), file) == nullptr) line[0] = 0;
+  std::fclose(file);
+  line[std::strcspn(line, "\n")] = 0;
+  return line;
+}
+
+bool PathExists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+// Interface carrying the IPv4 default route, or empty.
+std::string DefaultRouteInterface() {
+  FILE* file = std::fopen("/proc/net/route", "re");
+  if (file == nullptr) return std::string();
+  char line[512];
+  std::string interface;
+  while (std::fgets(line, sizeof(line), file) != nullptr) {
+    char name[64];
+    char destination[16];
+    if (std::sscanf(line, "%63s %15s", name, destination) == 2 &&
+        std::strcmp(destination, "00000000") == 0) {
+      interface = name;
+      break;
+    }
+  }
+  std::fclose(file);
+  return interface;
+}
+
+}  // namespace
+
+PrefetchScheduler::PrefetchScheduler(SegmentCache* cache, WindowFetcher fetch)
+    : cache_(cache),
+      fetch_(std::move(fetch)),
+      stopping_(false),
+      concurrency_(2),
+      active_(0),
+      bytes_per_second_(0),
+      max_bytes_(kDefaultMaxBytes) {}
+
+PrefetchScheduler::~PrefetchScheduler() {
+  Stop();
+}
+
+void PrefetchScheduler::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!threads_.empty()) return;
+  stopping_ = false;
+  for (int i = 0; i < kMaxConcurrency; ++i) {
+    threads_.emplace_back(&PrefetchScheduler::Run, this);
+  }
+}
+
+void PrefetchScheduler::Stop() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    threads.swap(threads_);
+    for (const auto& task : tasks_) task->done = true;
+    tasks_.clear();
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads) thread.join();
+}
+
+void PrefetchScheduler::SetRequests(std::vector<PrefetchRequest> requests) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::shared_ptr<Task>> next;
+  for (PrefetchRequest& request : requests) {
+    if (request.key.empty() || request.url.empty()) continue;
+    auto found = std::find_if(tasks_.begin(), tasks_.end(),
+                              [&](const std::shared_ptr<Task>& task) {
+                                return task->request.key == request.key;
+                              });
+    std::shared_ptr<Task> task;
+    if (found != tasks_.end()) {
+      task = *found;
+      tasks_.erase(found);
+      // A new URL or a larger budget is worth another attempt.
+      if (task->request.url != request.url ||
+          task->request.bytes != request.bytes) {
+        task->done = false;
+        task->failures = 0;
+      }
+      task->request = std::move(request);
+    } else {
+      std::shared_ptr<SegmentEntry> entry =
+          cache_->AcquireForPrefetch(request.key);
+      if (!entry) continue;
+      task = std::make_shared<Task>();
+      task->entry = std::move(entry);
+      task->request = std::move(request);
+    }
+    // Its share of max_bytes may have grown with the new order.
+    if (task->capped) {
+      task->done = false;
+      task->capped = false;
+    }
+    task->entry->set_url(task->request.url);
+    next.push_back(std::move(task));
+  }
+  // Whatever is left was dropped from the set: cancel it. A window already
+  // in flight completes, the rest of the request does not.
+  for (const auto& task : tasks_) task->done = true;
+  tasks_ = std::move(next);
+  cv_.notify_all();
+}
+
+void PrefetchScheduler::SetLimits(int concurrency, uint64_t bytes_per_second,
+                                  uint64_t max_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  concurrency_ = std::max(1, std::min(concurrency, kMaxConcurrency));
+  bytes_per_second_ = bytes_per_second;
+  budget_time_ = std::chrono::steady_clock::time_point();
+  max_bytes_ = max_bytes;
+  for (const auto& task : tasks_) {
+    if (task->capped) {
+      task->done = false;
+      task->capped = false;
+    }
+  }
+  cv_.notify_all();
+}
+
+uint64_t PrefetchScheduler::Allowance(const Task* task) const {
+  if (max_bytes_ == 0) return UINT32_MAX;
+  uint64_t left = max_bytes_ / kSegmentSize;
+  for (const auto& other : tasks_) {
+    if (other.get() == task) break;
+    // What the request covers: its prefix, or the whole resource once the
+    // size is known (until then, the first window that learns it).
+    uint64_t count = other->entry->segment_count();
+    uint64_t covered =
+        other->request.bytes == 0
+            ? (count > 0 ? count : kPrefetchWindowSegments)
+            : (other->request.bytes + kSegmentSize - 1) / kSegmentSize;
+    if (count > 0) covered = std::min(covered, count);
+    left -= std::min(left, covered);
+  }
+  return left;
+}
+
+bool PrefetchScheduler::NextWindow(Task* task, uint32_t* first,
+                                   uint32_t* last) {
+  SegmentEntry& entry = *task->entry;
+  uint64_t wanted =
+      task->request.bytes == 0
+          ? UINT32_MAX
+          : (task->request.bytes + kSegmentSize - 1) / kSegmentSize;
+  uint64_t allowance = Allowance(task);
+  bool capped = allowance < wanted;
+  wanted = std::min(wanted, allowance);
+  if (wanted == 0) {
+    task->done = task->capped = true;
+    return false;
+  }
+  uint32_t count = entry.segment_count();
+  if (count == 0) {
+    // Size unknown: the first window learns it. A playing client that is
+    // already fetching the start will learn it too.
+    if (entry.IsPending(0)) return false;
+    *first = 0;
+    *last = static_cast<uint32_t>(
+        std::min<uint64_t>(wanted, kPrefetchWindowSegments));
+    return true;
+  }
+
+  uint32_t limit = static_cast<uint32_t>(std::min<uint64_t>(wanted, count));
+  uint32_t index = 0;
+  // Pending before present, as in LoopbackProxy::EnsureSegment.
+  while (index < limit && (entry.IsPending(index) || entry.HasSegment(index))) {
+    ++index;
+  }
+  if (index >= limit) {
+    task->done = true;
+    task->capped = capped && limit < count;
+    return false;
+  }
+  *first = index;
+  *last = std::min(index + kPrefetchWindowSegments, limit);
+  *last = std::min(*last, entry.NextAvailableOrPending(index));
+  return *last > *first;
+}
+
+bool PrefetchScheduler::Throttle(std::unique_lock<std::mutex>& lock,
+                                 const std::shared_ptr<Task>& task,
+                                 uint64_t bytes) {
+  if (bytes_per_second_ > 0) {
+    auto now = std::chrono::steady_clock::now();
+    auto start = std::max(now, budget_time_);
+    budget_time_ = start + std::chrono::microseconds(
+                               bytes * 1000000 / bytes_per_second_);
+    cv_.wait_until(lock, start, [&] { return stopping_ || task->done; });
+  }
+  return !stopping_ && !task->done;
+}
+
+void PrefetchScheduler::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    std::shared_ptr<Task> task;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    bool deferred = false;
+    if (active_ < concurrency_) {
+      for (const auto& candidate : tasks_) {
+        if (candidate->active || candidate->done) continue;
+        if (NextWindow(candidate.get(), &first, &last)) {
+          task = candidate;
+          break;
+        }
+        deferred |= !candidate->done;
+      }
+    }
+    if (!task) {
+      if (deferred) {
+        cv_.wait_for(lock, kDeferredRetry);
+      } else {
+        cv_.wait(lock);
+      }
+      continue;
+    }
+
+    task->active = true;
+    ++active_;
+    // The budget is reserved for the window as planned; by the time it is
+    // granted a client may have fetched part of it, so plan again.
+    if (Throttle(lock, task,
+                 static_cast<uint64_t>(last - first) * kSegmentSize) &&
+        NextWindow(task.get(), &first, &last)) {
+      std::shared_ptr<SegmentEntry> entry = task->entry;
+      std::string platform = task->request.platform;
+      entry->MarkPending(first, last);
+      lock.unlock();
+      fetch_(entry, platform, first, last);
+      lock.lock();
+      if (entry->total_size() > 0 && entry->HasSegment(first)) {
+        task->failures = 0;
+      } else if (++task->failures >= kMaxFailures) {
+        task->done = true;
+      }
+    }
+    task->active = false;
+    --active_;
+    cv_.notify_all();
+  }
+}
+
+bool OnAcPower() {
+  DIR* dir = opendir("/sys/class/power_supply");
+  if (dir == nullptr) return true;
+  bool battery = false;
+  bool mains_online = false;
+  while (struct dirent* item = readdir(dir)) {
+    if (item->d_name[0] == '.') continue;
+    std::string base = std::string("/sys/class/power_supply/") + item->d_name;
+    std::string type = ReadLine(base + "/type");
+    if (type == "Mains") {
+      mains_online |= ReadLine(base + "/online") == "1";
+    } else if (type == "Battery") {
+      // Peripherals (mice, headsets) report batteries of their own.
+      battery |= ReadLine(base + "/scope") != "Device";
+    }
+  }
+  closedir(dir);
+  return mains_online || !battery;
+}
+
+bool OnUnmeteredLink() {
+  std::string interface = DefaultRouteInterface();
+  if (interface.empty()) return false;
+  std::string base = "/sys/class/net/" + interface;
+  // Virtual links (VPNs, bridges) say nothing about the uplink.
+  if (!PathExists(base + "/device")) return false;
+  if (PathExists(base + "/wireless") || PathExists(base + "/phy80211")) {
+    return false;
+  }
+  if (interface.compare(0, 2, "ww") == 0) return false;
+
+  // Phones tethered over USB show up as Ethernet through these drivers.
+  char driver[256] = {0};
+  ssize_t length = readlink((base + "/device/driver").c_str(), driver,
+                            sizeof(driver) - 1);
+  if (length > 0) {
+    driver[length] = 0;
+    const char* name = std::strrchr(driver, '/');
+    name = name ? name + 1 : driver;
+    for (const char* tethering : {"rndis_host", "cdc_ether", "cdc_ncm",
+                                  "ipheth", "qmi_wwan", "cdc_mbim"}) {
+      if (std::strcmp(name, tethering) == 0) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_power_on_ac() {
+  return cyrene::OnAcPower() ? 1 : 0;
+}
+
+int32_t cyrene_link_unmetered() {
+  return cyrene::OnUnmeteredLink() ? 1 : 0;
+}
+
+}  // extern "C"
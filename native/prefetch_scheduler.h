@@ -0,0 +1,135 @@
+#ifndef CYRENE_NATIVE_PREFETCH_SCHEDULER_H_
+#define CYRENE_NATIVE_PREFETCH_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "native_export.h"
+#include "segment_cache.h"
+
+namespace cyrene {
+
+// One resource the scheduler should warm, in the same terms the player
+// uses for /proxy?url=&platform=&key=.
+struct PrefetchRequest {
+  std::string key;
+  std::string url;
+  std::string platform;
+  uint64_t bytes = 0;  // Leading bytes to fetch; 0 for the whole resource.
+};
+
+// Background warming of the segment cache for tracks likely to play next.
+//
+// The caller hands over the complete wanted set, most likely first, each
+// time its guess changes; requests missing from the new set are cancelled
+// and ones still in it keep their progress. Work is done a small window of
+// segments at a time, each window going to the highest-priority request
+// that is not already being served, so a new first choice overtakes older
+// ones within one window. Segments that are present, or pending because a
+// client is playing them, are skipped, so prefetching never duplicates
+// playback fetches.
+//
+// At most |concurrency| windows are in flight, and a shared byte budget
+// paces window starts to |bytes_per_second| so the warming never crowds out
+// the track that is playing. The wanted set as a whole covers at most
+// |max_bytes|, claimed in priority order: a whole-track request for a long
+// lossless file is cut short rather than filling the segment cache with
+// guesses, and requests after it get what is left. Entries are acquired
+// with SegmentCache::AcquireForPrefetch, so what is never played is evicted
+// first. All limits can be changed at any time.
+class PrefetchScheduler {
+ public:
+  // Fetches segments [first, last) of |entry| (already marked pending) and
+  // clears their pending bits when done.
+  using WindowFetcher = std::function<void(
+      const std::shared_ptr<SegmentEntry>& entry, const std::string& platform,
+      uint32_t first, uint32_t last)>;
+
+  PrefetchScheduler(SegmentCache* cache, WindowFetcher fetch);
+  ~PrefetchScheduler();
+
+  PrefetchScheduler(const PrefetchScheduler&) = delete;
+  PrefetchScheduler& operator=(const PrefetchScheduler&) = delete;
+
+  void Start();
+
+  // Wakes and joins the threads; in-flight windows finish first.
+  void Stop();
+
+  // Replaces the wanted set; |requests| is ordered by priority.
+  void SetRequests(std::vector<PrefetchRequest> requests);
+
+  // |bytes_per_second| 0 removes the bandwidth cap and |max_bytes| 0 the
+  // size cap. |concurrency| is clamped to [1, kMaxConcurrency].
+  void SetLimits(int concurrency, uint64_t bytes_per_second,
+                 uint64_t max_bytes = kDefaultMaxBytes);
+
+  static constexpr int kMaxConcurrency = 4;
+  static constexpr uint64_t kDefaultMaxBytes = 64ull * 1024 * 1024;
+
+ private:
+  struct Task {
+    PrefetchRequest request;
+    std::shared_ptr<SegmentEntry> entry;
+    bool active = false;
+    bool done = false;
+    bool capped = false;  // Done because max_bytes_ ran out.
+    int failures = 0;
+  };
+
+  void Run();
+
+  // Segments |task| may cover after the requests before it have claimed
+  // theirs from max_bytes_.
+  uint64_t Allowance(const Task* task) const;
+
+  // Picks the next window for |task|; false when nothing is left to fetch.
+  bool NextWindow(Task* task, uint32_t* first, uint32_t* last);
+
+  // Waits until the bandwidth budget allows |bytes| more. False if the wait
+  // was cut short by Stop() or by |task| being cancelled.
+  bool Throttle(std::unique_lock<std::mutex>& lock,
+                const std::shared_ptr<Task>& task, uint64_t bytes);
+
+  SegmentCache* const cache_;
+  const WindowFetcher fetch_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::shared_ptr<Task>> tasks_;  // Priority order.
+  std::vector<std::thread> threads_;
+  bool stopping_;
+  int concurrency_;
+  int active_;
+  uint64_t bytes_per_second_;
+  uint64_t max_bytes_;
+  std::chrono::steady_clock::time_point budget_time_;
+};
+
+// Whether the machine is on mains power: true when a mains supply reports
+// online, or when there is no battery at all (a desktop).
+bool OnAcPower();
+
+// Whether the default route goes over a link that is usually unmetered:
+// wired Ethernet, as opposed to Wi-Fi, mobile broadband or USB tethering.
+bool OnUnmeteredLink();
+
+}  // namespace cyrene
+
+extern "C" {
+
+// Used by linux/runner/loopback_proxy_plugin.cc to answer the Dart side's
+// "prefetchConditions" call. Return 1 or 0.
+CYRENE_EXPORT int32_t cyrene_power_on_ac();
+CYRENE_EXPORT int32_t cyrene_link_unmetered();
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_PREFETCH_SCHEDULER_H_
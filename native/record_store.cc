@@ -0,0 +1,425 @@
+#include "record_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "crc32c.h"
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+constexpr char kMagic[4] = {'C', 'Y', 'R', 'S'};
+constexpr uint16_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordHeaderSize = 16;
+
+constexpr uint8_t kPut = 1;
+constexpr uint8_t kDelete = 2;
+
+constexpr uint32_t kMaxKeyLength = 64 * 1024;
+constexpr uint32_t kMaxValueLength = 64 * 1024 * 1024;
+
+// The mapping grows in powers of two from here, so appends rarely remap.
+constexpr uint64_t kMinMapSize = 1024 * 1024;
+// Compact once superseded records are over half the file and at least this.
+constexpr uint64_t kCompactGarbage = 256 * 1024;
+
+bool ParseHeader(const uint8_t* h, uint64_t* checkpoint_end,
+                 uint64_t* generation) {
+  if (std::memcmp(h, kMagic, 4) != 0 || format::ReadU16(h + 4) != kVersion ||
+      format::ReadU32(h + 60) != Crc32c(h, 60)) {
+    return false;
+  }
+  *checkpoint_end = format::ReadU64(h + 12);
+  *generation = format::ReadU64(h + 20);
+  return true;
+}
+
+void BuildHeader(uint8_t* h, uint64_t checkpoint_end, uint64_t generation) {
+  std::memset(h, 0, kHeaderSize);
+  std::memcpy(h, kMagic, 4);
+  format::WriteU16(h + 4, kVersion);
+  format::WriteU64(h + 12, checkpoint_end);
+  format::WriteU64(h + 20, generation);
+  format::WriteU32(h + 60, Crc32c(h, 60));
+}
+
+// Makes a rename() in the directory of |path| durable.
+void SyncDirectory(const std::string& path) {
+  size_t slash = path.rfind('/');
+  std::string directory =
+      slash == std::string::npos ? "." : path.substr(0, slash);
+  int fd = open(directory.empty() ? "/" : directory.c_str(),
+                O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+}  // namespace
+
+RecordStore::~RecordStore() { Close(); }
+
+bool RecordStore::Open(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ >= 0) return false;
+  path_ = path;
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) return false;
+
+  uint8_t header[kHeaderSize];
+  uint64_t checkpoint_end = 0;
+  if (PReadFully(fd_, header, sizeof(header), 0) &&
+      ParseHeader(header, &checkpoint_end, &generation_) &&
+      Replay(checkpoint_end)) {
+    return true;
+  }
+  if (Reset()) return true;
+  Unmap();
+  close(fd_);
+  fd_ = -1;
+  return false;
+}
+
+void RecordStore::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Unmap();
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  index_.clear();
+  scratch_.clear();
+  end_ = 0;
+  garbage_ = 0;
+}
+
+bool RecordStore::Put(std::string_view key, std::string_view value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Append(kPut, key, value);
+}
+
+bool RecordStore::Delete(std::string_view key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.find(std::string(key)) == index_.end()) return false;
+  return Append(kDelete, key, {});
+}
+
+const uint8_t* RecordStore::Get(std::string_view key, size_t* length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(std::string(key));
+  if (it == index_.end()) {
+    *length = 0;
+    return nullptr;
+  }
+  *length = it->second.value_length;
+  return map_ + it->second.offset + kRecordHeaderSize + key.size();
+}
+
+bool RecordStore::Contains(std::string_view key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.count(std::string(key)) != 0;
+}
+
+size_t RecordStore::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_.size();
+}
+
+uint64_t RecordStore::garbage_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return garbage_;
+}
+
+const uint8_t* RecordStore::Entries(size_t* length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  scratch_.clear();
+  for (const auto& item : index_) {
+    const std::string& key = item.first;
+    const Slot& slot = item.second;
+    size_t at = scratch_.size();
+    scratch_.resize(at + 8 + key.size() + slot.value_length);
+    uint8_t* out = scratch_.data() + at;
+    format::WriteU32(out, static_cast<uint32_t>(key.size()));
+    if (!key.empty()) std::memcpy(out + 4, key.data(), key.size());
+    format::WriteU32(out + 4 + key.size(), slot.value_length);
+    std::memcpy(out + 8 + key.size(),
+                map_ + slot.offset + kRecordHeaderSize + key.size(),
+                slot.value_length);
+  }
+  *length = scratch_.size();
+  return scratch_.data();
+}
+
+bool RecordStore::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fd_ >= 0 && Reset();
+}
+
+bool RecordStore::Checkpoint() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0) return false;
+  // The records must be durable before the header that covers them.
+  if (fdatasync(fd_) != 0 || !WriteHeader(end_) || fdatasync(fd_) != 0) {
+    return false;
+  }
+  if (garbage_ >= kCompactGarbage && garbage_ * 2 > end_) return Compact();
+  return true;
+}
+
+bool RecordStore::Append(uint8_t kind, std::string_view key,
+                         std::string_view value) {
+  if (fd_ < 0 || key.size() > kMaxKeyLength ||
+      value.size() > kMaxValueLength) {
+    return false;
+  }
+  uint32_t total =
+      static_cast<uint32_t>(kRecordHeaderSize + key.size() + value.size());
+  std::vector<uint8_t> record(total);
+  uint8_t* r = record.data();
+  r[4] = kind;
+  format::WriteU32(r + 8, static_cast<uint32_t>(key.size()));
+  format::WriteU32(r + 12, static_cast<uint32_t>(value.size()));
+  if (!key.empty()) std::memcpy(r + kRecordHeaderSize, key.data(), key.size());
+  if (!value.empty()) {
+    std::memcpy(r + kRecordHeaderSize + key.size(), value.data(), value.size());
+  }
+  format::WriteU32(r, Crc32c(r + 4, total - 4));
+
+  if (!PWriteFully(fd_, r, total, end_) || !Map(end_ + total)) {
+    // Drop whatever part of the record made it to the file.
+    int ignored = ftruncate(fd_, static_cast<off_t>(end_));
+    (void)ignored;
+    return false;
+  }
+
+  std::string name(key);
+  if (kind == kPut) {
+    auto result = index_.try_emplace(std::move(name));
+    if (!result.second) garbage_ += result.first->second.size;
+    result.first->second = {end_, total, static_cast<uint32_t>(value.size())};
+  } else {
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+      garbage_ += it->second.size;
+      index_.erase(it);
+    }
+    garbage_ += total;  // The tombstone itself
+  }
+  end_ += total;
+  return true;
+}
+
+bool RecordStore::Replay(uint64_t checkpoint_end) {
+  struct stat st;
+  if (fstat(fd_, &st) != 0) return false;
+  uint64_t size = static_cast<uint64_t>(st.st_size);
+  if (!Map(size)) return false;
+  // Records below the checkpoint were synced before the header that covers
+  // them, so only the ones after it can be torn and need their checksums
+  // verified. A file shorter than its checkpoint has lost synced data and
+  // is verified throughout.
+  if (checkpoint_end > size) checkpoint_end = kHeaderSize;
+
+  uint64_t pos = kHeaderSize;
+  while (size - pos >= kRecordHeaderSize) {
+    const uint8_t* r = map_ + pos;
+    uint8_t kind = r[4];
+    uint32_t key_length = format::ReadU32(r + 8);
+    uint32_t value_length = format::ReadU32(r + 12);
+    if ((kind != kPut && kind != kDelete) || key_length > kMaxKeyLength ||
+        value_length > kMaxValueLength) {
+      break;
+    }
+    uint64_t total = kRecordHeaderSize + key_length + value_length;
+    if (total > size - pos) break;
+    if (pos + total > checkpoint_end &&
+        Crc32c(r + 4, static_cast<size_t>(total - 4)) != format::ReadU32(r)) {
+      break;
+    }
+
+    std::string key(reinterpret_cast<const char*>(r + kRecordHeaderSize),
+                    key_length);
+    if (kind == kPut) {
+      auto result = index_.try_emplace(std::move(key));
+      if (!result.second) garbage_ += result.first->second.size;
+      result.first->second = {pos, static_cast<uint32_t>(total), value_length};
+    } else {
+      auto it = index_.find(key);
+      if (it != index_.end()) {
+        garbage_ += it->second.size;
+        index_.erase(it);
+      }
+      garbage_ += total;
+    }
+    pos += total;
+  }
+
+  end_ = pos;
+  // Anything after the last valid record is a write cut short by a crash.
+  return pos == size || ftruncate(fd_, static_cast<off_t>(pos)) == 0;
+}
+
+bool RecordStore::Map(uint64_t min_size) {
+  if (map_ != nullptr && min_size <= map_size_) return true;
+  uint64_t size = kMinMapSize;
+  while (size < min_size) size *= 2;
+  // Mapping past the end of the file is fine: only bytes below end_ (which
+  // pwrite has already extended the file to cover) are ever read.
+  void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) return false;
+  Unmap();
+  map_ = static_cast<uint8_t*>(map);
+  map_size_ = size;
+  return true;
+}
+
+void RecordStore::Unmap() {
+  if (map_ != nullptr) {
+    munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+}
+
+bool RecordStore::WriteHeader(uint64_t checkpoint_end) {
+  uint8_t header[kHeaderSize];
+  BuildHeader(header, checkpoint_end, generation_);
+  return PWriteFully(fd_, header, sizeof(header), 0);
+}
+
+bool RecordStore::Reset() {
+  index_.clear();
+  garbage_ = 0;
+  ++generation_;
+  end_ = kHeaderSize;
+  return ftruncate(fd_, 0) == 0 && WriteHeader(kHeaderSize) &&
+         Map(kHeaderSize);
+}
+
+bool RecordStore::Compact() {
+  // Live records are copied verbatim (their checksums do not cover their
+  // position) into a new file that then replaces this one.
+  std::vector<uint8_t> data(kHeaderSize);
+  std::unordered_map<std::string, Slot> index;
+  index.reserve(index_.size());
+  for (const auto& item : index_) {
+    const Slot& slot = item.second;
+    index.emplace(item.first,
+                  Slot{data.size(), slot.size, slot.value_length});
+    data.insert(data.end(), map_ + slot.offset,
+                map_ + slot.offset + slot.size);
+  }
+  BuildHeader(data.data(), data.size(), generation_ + 1);
+
+  std::string temp_path = path_ + ".compact";
+  int fd = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if (fd < 0) return false;
+  if (!WriteFully(fd, data.data(), data.size()) || fsync(fd) != 0 ||
+      rename(temp_path.c_str(), path_.c_str()) != 0) {
+    close(fd);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  SyncDirectory(path_);
+
+  Unmap();
+  close(fd_);
+  fd_ = fd;
+  index_.swap(index);
+  end_ = data.size();
+  garbage_ = 0;
+  ++generation_;
+  return Map(end_);
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_store_open(const char* path) {
+  if (path == nullptr) return nullptr;
+  auto* store = new cyrene::RecordStore();
+  if (!store->Open(path)) {
+    delete store;
+    return nullptr;
+  }
+  return store;
+}
+
+void cyrene_store_close(void* handle) {
+  delete static_cast<cyrene::RecordStore*>(handle);
+}
+
+static std::string_view AsView(const uint8_t* data, int32_t length) {
+  return data == nullptr || length <= 0
+             ? std::string_view()
+             : std::string_view(reinterpret_cast<const char*>(data),
+                                static_cast<size_t>(length));
+}
+
+int32_t cyrene_store_put(void* handle, const uint8_t* key, int32_t key_length,
+                         const uint8_t* value, int32_t value_length) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  if (store == nullptr) return 0;
+  return store->Put(AsView(key, key_length), AsView(value, value_length)) ? 1
+                                                                          : 0;
+}
+
+int32_t cyrene_store_delete(void* handle, const uint8_t* key,
+                            int32_t key_length) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  if (store == nullptr) return 0;
+  return store->Delete(AsView(key, key_length)) ? 1 : 0;
+}
+
+const uint8_t* cyrene_store_get(void* handle, const uint8_t* key,
+                                int32_t key_length, int64_t* value_length) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  size_t length = 0;
+  const uint8_t* value =
+      store != nullptr ? store->Get(AsView(key, key_length), &length) : nullptr;
+  if (value_length != nullptr) *value_length = static_cast<int64_t>(length);
+  return value;
+}
+
+int32_t cyrene_store_contains(void* handle, const uint8_t* key,
+                              int32_t key_length) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  return store != nullptr && store->Contains(AsView(key, key_length)) ? 1 : 0;
+}
+
+int64_t cyrene_store_count(void* handle) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  return store != nullptr ? static_cast<int64_t>(store->size()) : 0;
+}
+
+const uint8_t* cyrene_store_entries(void* handle, int64_t* length) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  size_t size = 0;
+  const uint8_t* data = store != nullptr ? store->Entries(&size) : nullptr;
+  if (length != nullptr) *length = static_cast<int64_t>(size);
+  return data;
+}
+
+int32_t cyrene_store_clear(void* handle) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  return store != nullptr && store->Clear() ? 1 : 0;
+}
+
+int32_t cyrene_store_checkpoint(void* handle) {
+  auto* store = static_cast<cyrene::RecordStore*>(handle);
+  return store != nullptr && store->Checkpoint() ? 1 : 0;
+}
+
+}  // extern "C"
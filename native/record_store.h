@@ -0,0 +1,125 @@
+#ifndef CYRENE_NATIVE_RECORD_STORE_H_
+#define CYRENE_NATIVE_RECORD_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// A persistent key/value store: an append-only log that is memory-mapped
+// for reads, with an in-memory hash index from key to the latest value.
+// Put and Delete append one record and update the index, so a point update
+// costs one small write however large the store is.
+//
+// On disk:
+//   header  "CYRS" | u16 version | u16 0 | u32 0 | u64 checkpoint end |
+//           u64 generation | zero padding | u32 CRC-32C of bytes [0, 60)
+//   record  u32 CRC-32C of the rest | u8 kind (1 put, 2 delete) | u8[3] 0 |
+//           u32 key length | u32 value length | key | value
+// (64-byte header, big-endian integers).
+//
+// Checkpoint() makes everything written so far durable, then records the
+// end of the log in the header as the checkpoint end; once more than half
+// of the file is superseded records, it also compacts the log into a fresh
+// file that replaces the old one with rename(), so a crash leaves either
+// file intact. Opening replays the log, checking the checksums of only the
+// records after the checkpoint end, and truncates it at the first one that
+// fails, which is where a crash interrupted a write.
+//
+// All methods are thread-safe. Pointers returned by Get() and Entries()
+// stay valid until the next call that modifies the store.
+class RecordStore {
+ public:
+  RecordStore() = default;
+  ~RecordStore();
+
+  RecordStore(const RecordStore&) = delete;
+  RecordStore& operator=(const RecordStore&) = delete;
+
+  // Opens or creates the store at |path|. A file that is not a store is
+  // replaced by an empty one.
+  bool Open(const std::string& path);
+  void Close();
+
+  bool Put(std::string_view key, std::string_view value);
+  // True if |key| existed.
+  bool Delete(std::string_view key);
+  // The value of |key|, or null.
+  const uint8_t* Get(std::string_view key, size_t* length);
+  bool Contains(std::string_view key) const;
+  size_t size() const;
+
+  // Every live record as  u32 key length | key | u32 value length | value
+  // (big-endian), in no particular order.
+  const uint8_t* Entries(size_t* length);
+
+  bool Clear();
+  bool Checkpoint();
+
+  // Bytes of the log held by superseded or deleted records.
+  uint64_t garbage_bytes() const;
+
+ private:
+  struct Slot {
+    uint64_t offset;  // Of the record
+    uint32_t size;    // Of the whole record
+    uint32_t value_length;
+  };
+
+  bool Append(uint8_t kind, std::string_view key, std::string_view value);
+  bool Replay(uint64_t checkpoint_end);
+  bool Map(uint64_t min_size);
+  bool WriteHeader(uint64_t checkpoint_end);
+  bool Compact();
+  bool Reset();
+  void Unmap();
+
+  mutable std::mutex mutex_;
+  std::string path_;
+  int fd_ = -1;
+  uint8_t* map_ = nullptr;
+  uint64_t map_size_ = 0;
+  uint64_t end_ = 0;
+  uint64_t generation_ = 0;
+  uint64_t garbage_ = 0;
+  std::unordered_map<std::string, Slot> index_;
+  std::vector<uint8_t> scratch_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/record_store_native.dart. Handles from
+// cyrene_store_open() (null on failure) are released with
+// cyrene_store_close(). Returned pointers follow RecordStore's rules.
+CYRENE_EXPORT void* cyrene_store_open(const char* path);
+CYRENE_EXPORT void cyrene_store_close(void* handle);
+CYRENE_EXPORT int32_t cyrene_store_put(void* handle, const uint8_t* key,
+                                       int32_t key_length,
+                                       const uint8_t* value,
+                                       int32_t value_length);
+CYRENE_EXPORT int32_t cyrene_store_delete(void* handle, const uint8_t* key,
+                                          int32_t key_length);
+CYRENE_EXPORT const uint8_t* cyrene_store_get(void* handle,
+                                              const uint8_t* key,
+                                              int32_t key_length,
+                                              int64_t* value_length);
+CYRENE_EXPORT int32_t cyrene_store_contains(void* handle, const uint8_t* key,
+                                            int32_t key_length);
+CYRENE_EXPORT int64_t cyrene_store_count(void* handle);
+CYRENE_EXPORT const uint8_t* cyrene_store_entries(void* handle,
+                                                  int64_t* length);
+CYRENE_EXPORT int32_t cyrene_store_clear(void* handle);
+CYRENE_EXPORT int32_t cyrene_store_checkpoint(void* handle);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_RECORD_STORE_H_
@@ -0,0 +1,616 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+#include "pinyin.h"
+#include "text_fold.h"
+
+namespace cyrene {
+
+namespace {
+
+// Match weights, multiplied by the field weight. A pinyin term stands for
+// the characters it was derived from and scores a little below them.
+constexpr float kExactWeight = 6;
+constexpr float kPrefixWeight = 4;
+constexpr float kTypoWeight = 2;
+constexpr float kPinyinFactor = 0.9f;
+constexpr float kFieldWeights[4] = {3, 2, 1, 0};
+// Added as kBrevityBonus / title terms, so among equal matches the
+// shortest title ("晴天" before "晴天娃娃") comes first.
+constexpr float kBrevityBonus = 1;
+constexpr size_t kMaxQueryTokens = 32;
+// Compaction is not worth it for a handful of removed entries.
+constexpr size_t kMinDeadToCompact = 1024;
+
+bool IsHan(char32_t c) {
+  return (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF) ||
+         (c >= 0xF900 && c <= 0xFAFF) || (c >= 0x20000 && c <= 0x3134F) ||
+         c == 0x3007;
+}
+
+void AppendUtf8(char32_t c, std::string* out) {
+  if (c < 0x80) {
+    out->push_back(static_cast<char>(c));
+  } else if (c < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | c >> 6));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  } else if (c < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | c >> 12));
+    out->push_back(static_cast<char>(0x80 | (c >> 6 & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | c >> 18));
+    out->push_back(static_cast<char>(0x80 | (c >> 12 & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (c >> 6 & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3F)));
+  }
+}
+
+bool IsAsciiLetters(std::string_view text) {
+  for (char c : text) {
+    if (c < 'a' || c > 'z') return false;
+  }
+  return true;
+}
+
+// Splits folded |text| into terms: words of key characters, single Han
+// characters and, with |pinyin|, the pinyin and initials of each Han run's
+// suffixes. Calls emit(term, is_pinyin, is_han).
+template <typename Emit>
+void ForEachTerm(const std::u32string& text, bool pinyin, Emit&& emit) {
+  std::string word;
+  std::string full;
+  std::string initials;
+  auto flush_word = [&] {
+    if (!word.empty()) emit(std::string_view(word), false, false);
+    word.clear();
+  };
+
+  for (size_t i = 0; i < text.size();) {
+    char32_t c = text[i];
+    if (!IsHan(c)) {
+      if (IsKeyCharacter(c)) {
+        AppendUtf8(c, &word);
+      } else {
+        flush_word();
+      }
+      ++i;
+      continue;
+    }
+
+    flush_word();
+    size_t end = i;
+    while (end < text.size() && IsHan(text[end])) ++end;
+    for (size_t start = i; start < end; ++start) {
+      word.clear();
+      AppendUtf8(text[start], &word);
+      emit(std::string_view(word), false, true);
+      if (!pinyin) continue;
+
+      // Only the longest run from each start is indexed; shorter ones are
+      // its prefixes. Initials are typed from the start of a name ("zjl",
+      // not "jl"), which keeps the term count down.
+      full.clear();
+      initials.clear();
+      for (size_t k = start; k < end && k - start < kMaxPinyinRun; ++k) {
+        std::string_view reading = PinyinOf(text[k]);
+        if (reading.empty()) break;
+        full.append(reading);
+        initials.push_back(reading[0]);
+      }
+      if (!full.empty()) emit(std::string_view(full), true, false);
+      if (start == i && initials.size() >= 2) {
+        emit(std::string_view(initials), true, false);
+      }
+    }
+    word.clear();
+    i = end;
+  }
+  flush_word();
+}
+
+// Whether |a| and |b| differ by exactly one insertion, deletion,
+// substitution or transposition of neighbours.
+bool WithinOneEdit(std::string_view a, std::string_view b) {
+  if (a.size() > b.size()) std::swap(a, b);
+  if (b.size() - a.size() > 1) return false;
+  size_t i = 0;
+  while (i < a.size() && a[i] == b[i]) ++i;
+  if (i == a.size()) return a.size() != b.size();
+  if (a.size() == b.size()) {
+    if (a.compare(i + 1, std::string_view::npos, b, i + 1,
+                  std::string_view::npos) == 0) {
+      return true;
+    }
+    return i + 1 < a.size() && a[i] == b[i + 1] && a[i + 1] == b[i] &&
+           a.compare(i + 2, std::string_view::npos, b, i + 2,
+                     std::string_view::npos) == 0;
+  }
+  return a.compare(i, std::string_view::npos, b, i + 1,
+                   std::string_view::npos) == 0;
+}
+
+uint64_t TypoHash(std::string_view text) {
+  // FNV-1a; collisions only cost a WithinOneEdit check.
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+struct Match {
+  uint32_t term;
+  float weight;
+};
+
+// Per-thread scratch for scoring, indexed by document and cleared after
+// each query through the touched lists.
+struct Accumulator {
+  std::vector<float> score;
+  std::vector<float> best;
+  std::vector<uint16_t> tokens;
+  std::vector<uint32_t> touched;
+  std::vector<uint32_t> token_touched;
+
+  void Reserve(size_t documents) {
+    if (score.size() >= documents) return;
+    score.resize(documents);
+    best.resize(documents);
+    tokens.resize(documents);
+  }
+};
+
+}  // namespace
+
+void SearchIndex::Put(std::string_view key, const IndexEntry& entry) {
+  PutBatch(&key, &entry, 1);
+}
+
+void SearchIndex::PutBatch(const std::string_view* keys,
+                           const IndexEntry* entries, size_t count) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  for (size_t i = 0; i < count; ++i) PutLocked(keys[i], entries[i]);
+  CompactIfNeeded();
+  // Compaction sorts all terms itself; otherwise only the new ones need
+  // merging into the prefix order.
+  size_t sorted = sorted_terms_.size();
+  for (uint32_t id = static_cast<uint32_t>(sorted);
+       id < static_cast<uint32_t>(terms_.size()); ++id) {
+    sorted_terms_.push_back(id);
+  }
+  if (sorted_terms_.size() > sorted) SortNewTerms(sorted);
+  SortNewTypoKeys();
+}
+
+void SearchIndex::PutLocked(std::string_view key, const IndexEntry& entry) {
+  auto it = keys_.find(key);
+  if (it != keys_.end()) {
+    documents_[it->second].live = false;
+    ++dead_;
+    keys_.erase(it);
+  }
+
+  Document& document = documents_.emplace_back();
+  document.text.reserve(key.size() + entry.title.size() +
+                        entry.artists.size() + entry.album.size());
+  document.text.append(key);
+  document.title_at = static_cast<uint32_t>(document.text.size());
+  document.text.append(entry.title);
+  document.artists_at = static_cast<uint32_t>(document.text.size());
+  document.text.append(entry.artists);
+  document.album_at = static_cast<uint32_t>(document.text.size());
+  document.text.append(entry.album);
+  document.boost = entry.boost;
+  document.live = true;
+  uint32_t doc = static_cast<uint32_t>(documents_.size() - 1);
+  keys_.emplace(document.key(), doc);
+  IndexDocument(doc);
+}
+
+void SearchIndex::IndexDocument(uint32_t doc) {
+  thread_local std::vector<uint32_t> postings;
+  postings.clear();
+  Document& document = documents_[doc];
+  const std::string_view fields[] = {document.title(), document.artists(),
+                                      document.album()};
+  uint32_t title_terms = 0;
+  for (uint32_t field = kTitle; field <= kAlbum; ++field) {
+    std::u32string folded = FoldText(fields[field]);
+    ForEachTerm(folded, true,
+                [&](std::string_view term, bool is_pinyin, bool) {
+                  uint32_t id = InternTerm(term, is_pinyin ? kPinyin : kWord);
+                  postings.push_back(id << 2 | field);
+                  if (field == kTitle && !is_pinyin) ++title_terms;
+                });
+  }
+  document.title_terms = static_cast<uint16_t>(
+      std::clamp<uint32_t>(title_terms, 1, UINT16_MAX));
+
+  // Repeated words of one field are posted once.
+  std::sort(postings.begin(), postings.end());
+  postings.erase(std::unique(postings.begin(), postings.end()),
+                 postings.end());
+  for (uint32_t posting : postings) {
+    terms_[posting >> 2].postings.push_back(doc << 2 | (posting & 3));
+  }
+}
+
+uint32_t SearchIndex::InternTerm(std::string_view text, TermKind kind) {
+  auto it = term_ids_.find(text);
+  uint32_t id;
+  if (it != term_ids_.end()) {
+    id = it->second;
+    // A term is a word if any entry has it as a word; only then can a typo
+    // reach it.
+    if (kind != kWord || terms_[id].kind == kWord) return id;
+    terms_[id].kind = kWord;
+  } else {
+    id = static_cast<uint32_t>(terms_.size());
+    const std::string& stored = term_text_.emplace_back(text);
+    terms_.push_back(Term{{}, static_cast<uint8_t>(kind)});
+    term_ids_.emplace(stored, id);
+    if (kind != kWord) return id;
+  }
+
+  // A token of kMinTypoLength can lose a letter to a typo.
+  if (text.size() + 1 >= kMinTypoLength && IsAsciiLetters(text)) {
+    AddTypoKeys(text, id);
+  }
+  return id;
+}
+
+void SearchIndex::AddTypoKeys(std::string_view text, uint32_t id) {
+  typo_keys_.emplace_back(TypoHash(text), id);
+  std::string deleted;
+  for (size_t i = 0; i < text.size(); ++i) {
+    // Deleting any letter of a run gives the same string.
+    if (i > 0 && text[i] == text[i - 1]) continue;
+    deleted.assign(text.substr(0, i));
+    deleted.append(text.substr(i + 1));
+    typo_keys_.emplace_back(TypoHash(deleted), id);
+  }
+}
+
+void SearchIndex::SortNewTypoKeys() {
+  auto middle = typo_keys_.begin() + typo_sorted_;
+  std::sort(middle, typo_keys_.end());
+  std::inplace_merge(typo_keys_.begin(), middle, typo_keys_.end());
+  typo_sorted_ = typo_keys_.size();
+}
+
+void SearchIndex::FindTypos(const std::string& text,
+                            std::vector<uint32_t>* found) const {
+  size_t first = found->size();
+  auto probe = [&](std::string_view key) {
+    uint64_t hash = TypoHash(key);
+    auto it = std::lower_bound(
+        typo_keys_.begin(), typo_keys_.end(), hash,
+        [](const std::pair<uint64_t, uint32_t>& entry, uint64_t value) {
+          return entry.first < value;
+        });
+    for (; it != typo_keys_.end() && it->first == hash; ++it) {
+      found->push_back(it->second);
+    }
+  };
+  probe(text);
+  std::string deleted;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (i > 0 && text[i] == text[i - 1]) continue;
+    deleted.assign(text, 0, i);
+    deleted.append(text, i + 1, std::string::npos);
+    probe(deleted);
+  }
+
+  // Keys are shared by terms two edits apart and by hash collisions, so
+  // every candidate is checked once.
+  std::sort(found->begin() + first, found->end());
+  auto end = std::unique(found->begin() + first, found->end());
+  end = std::remove_if(found->begin() + first, end, [&](uint32_t id) {
+    // Longer terms starting with the token were found as prefixes.
+    const std::string& term = term_text_[id];
+    return (term.size() > text.size() &&
+            term.compare(0, text.size(), text) == 0) ||
+           !WithinOneEdit(text, term);
+  });
+  found->erase(end, found->end());
+}
+
+void SearchIndex::SortNewTerms(size_t sorted) {
+  auto by_text = [this](uint32_t a, uint32_t b) {
+    return term_text_[a] < term_text_[b];
+  };
+  auto middle = sorted_terms_.begin() + sorted;
+  std::sort(middle, sorted_terms_.end(), by_text);
+  std::inplace_merge(sorted_terms_.begin(), middle, sorted_terms_.end(),
+                     by_text);
+}
+
+bool SearchIndex::Remove(std::string_view key) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto it = keys_.find(key);
+  if (it == keys_.end()) return false;
+  documents_[it->second].live = false;
+  ++dead_;
+  keys_.erase(it);
+  CompactIfNeeded();
+  return true;
+}
+
+void SearchIndex::Clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  documents_.clear();
+  keys_.clear();
+  dead_ = 0;
+  term_text_.clear();
+  terms_.clear();
+  term_ids_.clear();
+  sorted_terms_.clear();
+  typo_keys_.clear();
+  typo_sorted_ = 0;
+}
+
+size_t SearchIndex::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return keys_.size();
+}
+
+void SearchIndex::CompactIfNeeded() {
+  if (dead_ < kMinDeadToCompact || dead_ * 2 < documents_.size()) return;
+
+  // Rebuilding from the stored text also drops terms only dead entries
+  // had.
+  std::deque<Document> live;
+  for (Document& document : documents_) {
+    if (document.live) live.push_back(std::move(document));
+  }
+  documents_.clear();
+  keys_.clear();
+  dead_ = 0;
+  term_text_.clear();
+  terms_.clear();
+  term_ids_.clear();
+  sorted_terms_.clear();
+  typo_keys_.clear();
+  typo_sorted_ = 0;
+
+  for (Document& document : live) {
+    IndexEntry entry{document.title(), document.artists(), document.album(),
+                     document.boost};
+    PutLocked(document.key(), entry);
+  }
+  for (uint32_t id = 0; id < static_cast<uint32_t>(terms_.size()); ++id) {
+    sorted_terms_.push_back(id);
+  }
+  SortNewTerms(0);
+  SortNewTypoKeys();
+}
+
+std::vector<IndexHit> SearchIndex::Search(std::string_view query,
+                                          size_t limit) const {
+  std::vector<IndexHit> hits;
+  if (limit == 0) return hits;
+
+  struct Token {
+    std::string text;
+    bool han;
+  };
+  std::vector<Token> tokens;
+  ForEachTerm(FoldText(query), false,
+              [&](std::string_view term, bool, bool han) {
+                for (const Token& token : tokens) {
+                  if (token.text == term) return;
+                }
+                if (tokens.size() < kMaxQueryTokens) {
+                  tokens.push_back(Token{std::string(term), han});
+                }
+              });
+  if (tokens.empty()) return hits;
+
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (keys_.empty()) return hits;
+
+  // Expand each token into the terms it matches.
+  std::vector<std::vector<Match>> matches(tokens.size());
+  std::vector<std::pair<size_t, size_t>> order;  // (postings, token)
+  for (size_t t = 0; t < tokens.size(); ++t) {
+    const std::string& text = tokens[t].text;
+    std::vector<Match>& found = matches[t];
+    auto add = [&](uint32_t id, float weight) {
+      if (terms_[id].kind == kPinyin) weight *= kPinyinFactor;
+      found.push_back(Match{id, weight});
+    };
+
+    auto exact = term_ids_.find(text);
+    if (exact != term_ids_.end()) add(exact->second, kExactWeight);
+
+    // One letter completes to too much to be useful unless nothing is
+    // spelled exactly that way.
+    if (!tokens[t].han && (text.size() >= 2 || found.empty())) {
+      auto it = std::lower_bound(
+          sorted_terms_.begin(), sorted_terms_.end(), text,
+          [this](uint32_t id, const std::string& key) {
+            return term_text_[id] < key;
+          });
+      size_t expanded = 0;
+      for (; it != sorted_terms_.end() && expanded < kMaxPrefixTerms; ++it) {
+        const std::string& term = term_text_[*it];
+        if (term.compare(0, text.size(), text) != 0) break;
+        if (term.size() == text.size()) continue;
+        // Closer completions score higher.
+        float closeness = static_cast<float>(text.size()) / term.size();
+        add(*it, kPrefixWeight * (0.5f + 0.5f * closeness));
+        ++expanded;
+      }
+    }
+
+    if (text.size() >= kMinTypoLength && IsAsciiLetters(text)) {
+      thread_local std::vector<uint32_t> typos;
+      typos.clear();
+      FindTypos(text, &typos);
+      for (uint32_t id : typos) add(id, kTypoWeight);
+    }
+
+    if (found.empty()) return hits;  // every token has to match
+    size_t postings = 0;
+    for (const Match& match : found) {
+      postings += terms_[match.term].postings.size();
+    }
+    order.emplace_back(postings, t);
+  }
+
+  // Rarest token first: later tokens only revisit its candidates.
+  std::sort(order.begin(), order.end());
+  thread_local Accumulator acc;
+  acc.Reserve(documents_.size());
+  acc.touched.clear();
+  for (size_t step = 0; step < order.size(); ++step) {
+    acc.token_touched.clear();
+    for (const Match& match : matches[order[step].second]) {
+      for (uint32_t posting : terms_[match.term].postings) {
+        uint32_t doc = posting >> 2;
+        if (acc.tokens[doc] != step || !documents_[doc].live) continue;
+        float score = match.weight * kFieldWeights[posting & 3];
+        if (acc.best[doc] == 0) acc.token_touched.push_back(doc);
+        acc.best[doc] = std::max(acc.best[doc], score);
+      }
+    }
+    for (uint32_t doc : acc.token_touched) {
+      acc.score[doc] += acc.best[doc];
+      acc.best[doc] = 0;
+      acc.tokens[doc] = static_cast<uint16_t>(step + 1);
+      if (step == 0) acc.touched.push_back(doc);
+    }
+    if (acc.token_touched.empty()) break;
+  }
+
+  struct Scored {
+    float score;
+    uint32_t doc;
+  };
+  std::vector<Scored> scored;
+  for (uint32_t doc : acc.touched) {
+    if (acc.tokens[doc] == order.size()) {
+      const Document& document = documents_[doc];
+      scored.push_back(Scored{acc.score[doc] + document.boost +
+                                  kBrevityBonus / document.title_terms,
+                              doc});
+    }
+    acc.score[doc] = 0;
+    acc.tokens[doc] = 0;
+  }
+
+  // Newer entries first among equal scores.
+  auto better = [](const Scored& a, const Scored& b) {
+    return a.score != b.score ? a.score > b.score : a.doc > b.doc;
+  };
+  size_t count = std::min(limit, scored.size());
+  std::partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+                    better);
+  hits.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    hits.push_back(IndexHit{std::string(documents_[scored[i].doc].key()),
+                            scored[i].score});
+  }
+  return hits;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_search_index_create() { return new cyrene::SearchIndex(); }
+
+void cyrene_search_index_destroy(void* handle) {
+  delete static_cast<cyrene::SearchIndex*>(handle);
+}
+
+static bool ValidRange(const int32_t* range, int64_t text_length) {
+  return range[0] >= 0 && range[0] <= range[1] && range[1] <= text_length;
+}
+
+static std::string_view RangeView(const uint8_t* text,
+                                  const int32_t* range) {
+  return std::string_view(reinterpret_cast<const char*>(text) + range[0],
+                          static_cast<size_t>(range[1] - range[0]));
+}
+
+int32_t cyrene_search_index_put(void* handle, const uint8_t* text,
+                                int64_t text_length, const int32_t* ranges,
+                                const float* boosts, int32_t count) {
+  auto* index = static_cast<cyrene::SearchIndex*>(handle);
+  if (index == nullptr || count < 0 || (count > 0 && ranges == nullptr) ||
+      (text == nullptr && text_length != 0)) {
+    return -1;
+  }
+  std::vector<std::string_view> keys(static_cast<size_t>(count));
+  std::vector<cyrene::IndexEntry> entries(static_cast<size_t>(count));
+  for (int32_t i = 0; i < count; ++i) {
+    const int32_t* range = ranges + i * 8;
+    for (int field = 0; field < 4; ++field) {
+      if (!ValidRange(range + field * 2, text_length)) return -1;
+    }
+    keys[i] = RangeView(text, range);
+    entries[i].title = RangeView(text, range + 2);
+    entries[i].artists = RangeView(text, range + 4);
+    entries[i].album = RangeView(text, range + 6);
+    entries[i].boost = boosts != nullptr ? boosts[i] : 0;
+  }
+  index->PutBatch(keys.data(), entries.data(), keys.size());
+  return count;
+}
+
+int32_t cyrene_search_index_remove(void* handle, const uint8_t* text,
+                                   int64_t text_length, const int32_t* ranges,
+                                   int32_t count) {
+  auto* index = static_cast<cyrene::SearchIndex*>(handle);
+  if (index == nullptr || count <= 0 || ranges == nullptr) return 0;
+  int32_t removed = 0;
+  for (int32_t i = 0; i < count; ++i) {
+    if (!ValidRange(ranges + i * 2, text_length)) break;
+    if (index->Remove(RangeView(text, ranges + i * 2))) ++removed;
+  }
+  return removed;
+}
+
+void cyrene_search_index_clear(void* handle) {
+  auto* index = static_cast<cyrene::SearchIndex*>(handle);
+  if (index != nullptr) index->Clear();
+}
+
+int64_t cyrene_search_index_count(void* handle) {
+  auto* index = static_cast<cyrene::SearchIndex*>(handle);
+  return index != nullptr ? static_cast<int64_t>(index->size()) : 0;
+}
+
+int32_t cyrene_search_index_query(void* handle, const uint8_t* query,
+                                  int32_t query_length, int32_t limit,
+                                  uint8_t* keys, int32_t keys_capacity,
+                                  int32_t* key_ends, float* scores) {
+  auto* index = static_cast<cyrene::SearchIndex*>(handle);
+  if (index == nullptr || query == nullptr || query_length <= 0 ||
+      limit <= 0 || keys == nullptr || key_ends == nullptr) {
+    return 0;
+  }
+  std::vector<cyrene::IndexHit> hits = index->Search(
+      std::string_view(reinterpret_cast<const char*>(query),
+                       static_cast<size_t>(query_length)),
+      static_cast<size_t>(limit));
+  int32_t written = 0;
+  int32_t offset = 0;
+  for (const cyrene::IndexHit& hit : hits) {
+    if (hit.key.size() > static_cast<size_t>(keys_capacity - offset)) break;
+    std::memcpy(keys + offset, hit.key.data(), hit.key.size());
+    offset += static_cast<int32_t>(hit.key.size());
+    key_ends[written] = offset;
+    if (scores != nullptr) scores[written] = hit.score;
+    ++written;
+  }
+  return written;
+}
+
+}  // extern "C"
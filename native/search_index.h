@@ -0,0 +1,180 @@
+#ifndef CYRENE_NATIVE_SEARCH_INDEX_H_
+#define CYRENE_NATIVE_SEARCH_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// One searchable track. |boost| is added to the score of every match, so
+// favourites and local files can rank above songs that were only cached.
+struct IndexEntry {
+  std::string_view title;
+  std::string_view artists;
+  std::string_view album;
+  float boost = 0;
+};
+
+struct IndexHit {
+  std::string key;
+  float score = 0;
+};
+
+// In-memory inverted index over what is already on the device, queried
+// while the platform searches are still in flight.
+//
+// Text is folded with FoldText. Words of letters and digits become terms;
+// every Han character is a term of its own, and each Han run additionally
+// contributes the full pinyin of all its suffixes (up to kMaxPinyinRun
+// characters) and its initials, so 周杰伦 is found by "zhoujielun",
+// "jielun", "zhou jie" or "zjl". Query tokens must all match (AND). A token
+// matches a term exactly, as a prefix of it (search as you type) or, for
+// Latin tokens of kMinTypoLength or more, within one edit (insertion,
+// deletion, substitution or swap of neighbours). Exact beats prefix beats
+// typo, and title beats artist beats album. A single Latin character
+// matches its exact term, and only when there is none its completions.
+//
+// Typos are found SymSpell-style: every Latin word term is stored under the
+// hash of itself and of each string one deletion away, and a query token
+// probes the same set for itself and its deletions, so the candidates any
+// single edit can reach share a key. That costs a few binary searches
+// instead of a pass over the vocabulary.
+//
+// Updates are incremental: Put replaces an entry by key and Remove
+// tombstones it; postings are rebuilt once more than half are dead.
+// Queries take a shared lock and may run concurrently with each other.
+class SearchIndex {
+ public:
+  SearchIndex() = default;
+  SearchIndex(const SearchIndex&) = delete;
+  SearchIndex& operator=(const SearchIndex&) = delete;
+
+  void Put(std::string_view key, const IndexEntry& entry);
+  // Puts |count| entries under one lock.
+  void PutBatch(const std::string_view* keys, const IndexEntry* entries,
+                size_t count);
+  bool Remove(std::string_view key);
+  void Clear();
+  size_t size() const;
+
+  // Up to |limit| best hits for |query|, best first.
+  std::vector<IndexHit> Search(std::string_view query, size_t limit) const;
+
+ private:
+  enum Field : uint32_t { kTitle = 0, kArtist = 1, kAlbum = 2 };
+  enum TermKind : uint8_t { kWord = 0, kPinyin = 1 };
+
+  // The key, title, artists and album back to back, kept for rebuilding.
+  struct Document {
+    std::string text;
+    uint32_t title_at = 0;
+    uint32_t artists_at = 0;
+    uint32_t album_at = 0;
+    float boost = 0;
+    uint16_t title_terms = 0;
+    bool live = false;
+
+    std::string_view key() const {
+      return std::string_view(text).substr(0, title_at);
+    }
+    std::string_view title() const {
+      return std::string_view(text).substr(title_at, artists_at - title_at);
+    }
+    std::string_view artists() const {
+      return std::string_view(text).substr(artists_at, album_at - artists_at);
+    }
+    std::string_view album() const {
+      return std::string_view(text).substr(album_at);
+    }
+  };
+
+  struct Term {
+    std::vector<uint32_t> postings;  // doc << 2 | field, doc ascending
+    uint8_t kind = kWord;
+  };
+
+  void PutLocked(std::string_view key, const IndexEntry& entry);
+  void IndexDocument(uint32_t doc);
+  uint32_t InternTerm(std::string_view text, TermKind kind);
+  // Merges sorted_terms_[sorted..] into the sorted ids before it.
+  void SortNewTerms(size_t sorted);
+  void AddTypoKeys(std::string_view text, uint32_t id);
+  void SortNewTypoKeys();
+  // Word terms within one edit of |text| (not |text| itself) that do not
+  // start with it, appended to |found|.
+  void FindTypos(const std::string& text, std::vector<uint32_t>* found) const;
+  void CompactIfNeeded();
+
+  mutable std::shared_mutex mutex_;
+  // A deque never moves its elements, so the views into keys and term text
+  // below stay valid as it grows.
+  std::deque<Document> documents_;
+  std::unordered_map<std::string_view, uint32_t> keys_;  // live docs only
+  size_t dead_ = 0;
+
+  std::deque<std::string> term_text_;
+  std::vector<Term> terms_;
+  std::unordered_map<std::string_view, uint32_t> term_ids_;
+  std::vector<uint32_t> sorted_terms_;  // by text, for prefix lookups
+  // (hash of a Latin word term or one of its deletions, term id), sorted
+  // up to typo_sorted_; writers sort the rest before unlocking.
+  std::vector<std::pair<uint64_t, uint32_t>> typo_keys_;
+  size_t typo_sorted_ = 0;
+};
+
+constexpr size_t kMaxPinyinRun = 8;
+constexpr size_t kMinTypoLength = 4;
+constexpr size_t kMaxPrefixTerms = 512;
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/search_index_native.dart. Handles come
+// from cyrene_search_index_create() and are released with
+// cyrene_search_index_destroy().
+CYRENE_EXPORT void* cyrene_search_index_create();
+CYRENE_EXPORT void cyrene_search_index_destroy(void* handle);
+
+// Entry i's key, title, artists and album are the UTF-8 ranges
+// text[ranges[8i] .. ranges[8i+1]), text[ranges[8i+2] .. ranges[8i+3]) and
+// so on. Returns the number of entries put, or -1 for bad ranges.
+CYRENE_EXPORT int32_t cyrene_search_index_put(void* handle,
+                                              const uint8_t* text,
+                                              int64_t text_length,
+                                              const int32_t* ranges,
+                                              const float* boosts,
+                                              int32_t count);
+// Key i is text[ranges[2i] .. ranges[2i+1]). Returns the number removed.
+CYRENE_EXPORT int32_t cyrene_search_index_remove(void* handle,
+                                                 const uint8_t* text,
+                                                 int64_t text_length,
+                                                 const int32_t* ranges,
+                                                 int32_t count);
+CYRENE_EXPORT void cyrene_search_index_clear(void* handle);
+CYRENE_EXPORT int64_t cyrene_search_index_count(void* handle);
+
+// Writes up to |limit| hits: the keys back to back into |keys| (at most
+// |keys_capacity| bytes; hits that no longer fit are dropped), the end
+// offset of each key to |key_ends| and the scores to |scores|. Returns the
+// number of hits written.
+CYRENE_EXPORT int32_t cyrene_search_index_query(void* handle,
+                                                const uint8_t* query,
+                                                int32_t query_length,
+                                                int32_t limit, uint8_t* keys,
+                                                int32_t keys_capacity,
+                                                int32_t* key_ends,
+                                                float* scores);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_SEARCH_INDEX_H_
@@ -0,0 +1,502 @@
+#include "search_merge.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "text_fold.h"
+
+namespace cyrene {
+
+namespace {
+
+// Padding outside Unicode, so a title's first and last characters get
+// trigrams of their own.
+constexpr char32_t kBegin = 0x110000;
+constexpr char32_t kEnd = 0x110001;
+
+// MinHash signature length and LSH banding. Two titles become candidates
+// when any band of kRows hashes agrees: for Jaccard 0.7 that is
+// 1 - (1 - 0.7^2)^8, over 99.6%.
+constexpr int kHashes = 16;
+constexpr int kRows = 2;
+constexpr int kBands = kHashes / kRows;
+
+enum Tag : uint32_t {
+  kLive = 1 << 0,
+  kRemix = 1 << 1,
+  kInstrumental = 1 << 2,
+  kCover = 1 << 3,
+};
+
+struct TagWord {
+  std::u32string_view word;
+  uint32_t tag;
+};
+
+// Matched against the key characters of title suffixes.
+constexpr TagWord kTagWords[] = {
+    {U"live", kLive},
+    {U"现场", kLive},
+    {U"remix", kRemix},
+    {U"dj", kRemix},
+    {U"伴奏", kInstrumental},
+    {U"inst", kInstrumental},
+    {U"纯音乐", kInstrumental},
+    {U"karaoke", kInstrumental},
+    {U"offvocal", kInstrumental},
+    {U"翻唱", kCover},
+    {U"翻自", kCover},
+    {U"cover", kCover},
+};
+
+// Where a "featuring" clause starts, in a folded (lower-case) string.
+constexpr std::u32string_view kFeatMarkers[] = {
+    U" feat.", U" feat ", U" featuring ", U" ft.", U" ft ", U"(feat.",
+};
+
+bool IsOpener(char32_t c) {
+  return c == U'(' || c == U'[' || c == U'【' || c == U'〖' || c == U'〔';
+}
+
+bool IsCloser(char32_t c) {
+  return c == U')' || c == U']' || c == U'】' || c == U'〗' || c == U'〕';
+}
+
+bool IsDash(char32_t c) { return c == U'-' || c == U'–' || c == U'—'; }
+
+bool IsArtistSeparator(char32_t c) {
+  return c == U',' || c == U'/' || c == U'&' || c == U'、' || c == U';' ||
+         c == U'|' || c == U'+' || c == U'×';
+}
+
+std::u32string KeyCharacters(std::u32string_view text) {
+  std::u32string key;
+  for (char32_t c : text) {
+    if (IsKeyCharacter(c)) key.push_back(c);
+  }
+  return key;
+}
+
+// The first "featuring" marker in |text| and its |length|, or npos.
+size_t FindFeat(std::u32string_view text, size_t* length) {
+  size_t first = std::u32string_view::npos;
+  for (std::u32string_view marker : kFeatMarkers) {
+    size_t at = text.find(marker);
+    if (at < first) {
+      first = at;
+      *length = marker.size();
+    }
+  }
+  return first;
+}
+
+uint64_t Mix(uint64_t x) {
+  // SplitMix64 finalizer.
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+uint64_t HashKey(std::u32string_view key) {
+  uint64_t hash = 0x84222325CBF29CE4ull;
+  for (char32_t c : key) hash = Mix(hash ^ c);
+  return hash;
+}
+
+struct Parsed {
+  std::u32string title;            // key characters of the base title
+  uint32_t tags = 0;
+  std::vector<uint64_t> artists;   // hashed key characters, sorted, unique
+  int title_id = 0;
+};
+
+Parsed Parse(const SearchItem& item) {
+  Parsed parsed;
+
+  // Bracketed text goes to the suffix, the rest to the base title.
+  std::u32string folded = FoldText(item.title);
+  std::u32string base;
+  std::u32string suffix;
+  int depth = 0;
+  for (char32_t c : folded) {
+    if (IsOpener(c)) {
+      ++depth;
+      suffix.push_back(U' ');
+    } else if (depth > 0) {
+      if (IsCloser(c)) {
+        --depth;
+      } else {
+        suffix.push_back(c);
+      }
+    } else {
+      base.push_back(c);
+    }
+  }
+  // "Title - Live", "Title feat. Someone".
+  for (size_t i = 1; i + 1 < base.size(); ++i) {
+    if (IsDash(base[i]) && base[i - 1] == U' ' && base[i + 1] == U' ') {
+      suffix.append(base, i, std::u32string::npos);
+      base.resize(i);
+      break;
+    }
+  }
+  size_t feat_length = 0;
+  size_t feat = FindFeat(base, &feat_length);
+  if (feat != std::u32string::npos) base.resize(feat);
+
+  parsed.title = KeyCharacters(base);
+  if (parsed.title.empty()) parsed.title = KeyCharacters(folded);
+  if (parsed.title.empty()) parsed.title = folded;
+
+  std::u32string suffix_key = KeyCharacters(suffix);
+  for (const TagWord& tag : kTagWords) {
+    if (suffix_key.find(tag.word) != std::u32string::npos) {
+      parsed.tags |= tag.tag;
+    }
+  }
+
+  // Artists split on separators and "feat." clauses.
+  std::u32string artists = FoldText(item.artists);
+  for (feat = FindFeat(artists, &feat_length); feat != std::u32string::npos;
+       feat = FindFeat(artists, &feat_length)) {
+    artists.replace(feat, feat_length, 1, U',');
+  }
+  size_t begin = 0;
+  for (size_t i = 0; i <= artists.size(); ++i) {
+    if (i < artists.size() && !IsArtistSeparator(artists[i])) continue;
+    std::u32string name = KeyCharacters(
+        std::u32string_view(artists).substr(begin, i - begin));
+    if (!name.empty()) parsed.artists.push_back(HashKey(name));
+    begin = i + 1;
+  }
+  std::sort(parsed.artists.begin(), parsed.artists.end());
+  parsed.artists.erase(
+      std::unique(parsed.artists.begin(), parsed.artists.end()),
+      parsed.artists.end());
+  return parsed;
+}
+
+// A distinct base title.
+struct Title {
+  std::vector<uint64_t> trigrams;  // sorted, unique
+  uint64_t signature[kHashes];
+};
+
+Title MakeTitle(const std::u32string& text) {
+  Title title;
+  std::u32string padded;
+  padded.reserve(text.size() + 2);
+  padded.push_back(kBegin);
+  padded.append(text);
+  padded.push_back(kEnd);
+  for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+    title.trigrams.push_back(static_cast<uint64_t>(padded[i]) << 42 |
+                             static_cast<uint64_t>(padded[i + 1]) << 21 |
+                             padded[i + 2]);
+  }
+  std::sort(title.trigrams.begin(), title.trigrams.end());
+  title.trigrams.erase(
+      std::unique(title.trigrams.begin(), title.trigrams.end()),
+      title.trigrams.end());
+
+  for (int k = 0; k < kHashes; ++k) {
+    uint64_t seed = 0x9E3779B97F4A7C15ull * (k + 1);
+    uint64_t min = UINT64_MAX;
+    for (uint64_t trigram : title.trigrams) {
+      min = std::min(min, Mix(trigram ^ seed));
+    }
+    title.signature[k] = min;
+  }
+  return title;
+}
+
+double Jaccard(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+  size_t shared = 0;
+  for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (b[j] < a[i]) {
+      ++j;
+    } else {
+      ++shared;
+      ++i;
+      ++j;
+    }
+  }
+  size_t all = a.size() + b.size() - shared;
+  return all == 0 ? 0 : static_cast<double>(shared) / all;
+}
+
+// At least half of the shorter artist list (and at least one artist) is
+// shared; results without artists only match each other.
+bool ArtistsMatch(const Parsed& a, const Parsed& b) {
+  if (a.artists.empty() || b.artists.empty()) {
+    return a.artists.empty() && b.artists.empty();
+  }
+  size_t shared = 0;
+  for (size_t i = 0, j = 0; i < a.artists.size() && j < b.artists.size();) {
+    if (a.artists[i] < b.artists[j]) {
+      ++i;
+    } else if (b.artists[j] < a.artists[i]) {
+      ++j;
+    } else {
+      ++shared;
+      ++i;
+      ++j;
+    }
+  }
+  return shared > 0 &&
+         shared * 2 >= std::min(a.artists.size(), b.artists.size());
+}
+
+// Two titles and their similarity, scaled to 0..kSimilarityScale.
+struct TitlePair {
+  int a;
+  int b;
+  uint64_t score;
+};
+
+constexpr double kSimilarityScale = 1 << 16;
+
+// Pairs of distinct titles with similar trigram sets. Candidates come from
+// LSH bands of the MinHash signatures.
+std::vector<TitlePair> SimilarTitles(
+    const std::vector<Title>& titles) {
+  std::vector<uint64_t> candidates;
+  std::vector<std::pair<uint64_t, int>> buckets;
+  buckets.reserve(titles.size());
+  for (int band = 0; band < kBands; ++band) {
+    buckets.clear();
+    for (size_t t = 0; t < titles.size(); ++t) {
+      if (titles[t].trigrams.empty()) continue;
+      uint64_t key = 0;
+      for (int r = 0; r < kRows; ++r) {
+        key = Mix(key ^ titles[t].signature[band * kRows + r]);
+      }
+      buckets.emplace_back(key, static_cast<int>(t));
+    }
+    std::sort(buckets.begin(), buckets.end());
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      for (size_t j = i + 1;
+           j < buckets.size() && buckets[j].first == buckets[i].first; ++j) {
+        candidates.push_back(static_cast<uint64_t>(buckets[i].second) << 32 |
+                             static_cast<uint32_t>(buckets[j].second));
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+
+  std::vector<TitlePair> similar;
+  for (uint64_t pair : candidates) {
+    int a = static_cast<int>(pair >> 32);
+    int b = static_cast<int>(pair & 0xFFFFFFFFu);
+    double similarity = Jaccard(titles[a].trigrams, titles[b].trigrams);
+    if (similarity >= kTitleThreshold) {
+      similar.push_back(
+          {a, b, static_cast<uint64_t>(similarity * kSimilarityScale)});
+    }
+  }
+  return similar;
+}
+
+// An accepted pair, packed so that sorting puts the best first: inverted
+// score (exact matches score above any similarity), then the item indices.
+using Edge = uint64_t;
+
+constexpr uint64_t kExactScore = 1 << 17;
+
+Edge MakeEdge(uint64_t score, int a, int b) {
+  return (kExactScore - score) << 40 | static_cast<uint64_t>(a) << 20 |
+         static_cast<uint64_t>(b);
+}
+
+class Groups {
+ public:
+  Groups(const std::vector<SearchItem>& items)
+      : parent_(items.size()), sources_(items.size()) {
+    std::iota(parent_.begin(), parent_.end(), 0);
+    for (size_t i = 0; i < items.size(); ++i) {
+      sources_[i] = 1u << (items[i].source & 31);
+    }
+  }
+
+  int Find(int i) {
+    while (parent_[i] != i) {
+      parent_[i] = parent_[parent_[i]];
+      i = parent_[i];
+    }
+    return i;
+  }
+
+  void Merge(Edge edge) {
+    bool exact = (edge >> 40) == 0;
+    int a = Find(static_cast<int>(edge >> 20 & 0xFFFFF));
+    int b = Find(static_cast<int>(edge & 0xFFFFF));
+    if (a == b || (!exact && (sources_[a] & sources_[b]) != 0)) return;
+    if (b < a) std::swap(a, b);
+    parent_[b] = a;
+    sources_[a] |= sources_[b];
+  }
+
+ private:
+  std::vector<int> parent_;
+  std::vector<uint32_t> sources_;
+};
+
+}  // namespace
+
+std::vector<int32_t> GroupSearchResults(const std::vector<SearchItem>& items) {
+  std::vector<int32_t> result(items.size());
+  if (items.size() > static_cast<size_t>(kMaxSearchItems)) {
+    std::iota(result.begin(), result.end(), 0);
+    return result;
+  }
+
+  std::vector<Parsed> parsed;
+  parsed.reserve(items.size());
+  std::unordered_map<std::u32string, int> title_ids;
+  std::vector<Title> titles;
+  for (const SearchItem& item : items) {
+    parsed.push_back(Parse(item));
+    auto inserted = title_ids.emplace(parsed.back().title,
+                                      static_cast<int>(titles.size()));
+    if (inserted.second) titles.push_back(MakeTitle(parsed.back().title));
+    parsed.back().title_id = inserted.first->second;
+  }
+
+  // Items indexed by (title, tags, artist): only items with the same tags
+  // sharing an artist (or both without one) can match.
+  constexpr uint64_t kNoArtist = 0;
+  std::vector<std::pair<uint64_t, int>> by_artist;
+  auto index_key = [](int title_id, uint32_t tags, uint64_t artist) {
+    return Mix(Mix(static_cast<uint64_t>(title_id) << 32 | tags) ^ artist);
+  };
+  for (size_t i = 0; i < parsed.size(); ++i) {
+    const Parsed& p = parsed[i];
+    if (p.artists.empty()) {
+      by_artist.emplace_back(index_key(p.title_id, p.tags, kNoArtist),
+                             static_cast<int>(i));
+    }
+    for (uint64_t artist : p.artists) {
+      by_artist.emplace_back(index_key(p.title_id, p.tags, artist),
+                             static_cast<int>(i));
+    }
+  }
+  std::sort(by_artist.begin(), by_artist.end());
+  auto items_with = [&](uint64_t key) {
+    return std::equal_range(
+        by_artist.begin(), by_artist.end(), std::make_pair(key, -1),
+        [](const std::pair<uint64_t, int>& x,
+           const std::pair<uint64_t, int>& y) { return x.first < y.first; });
+  };
+
+  // Title pairs to consider: each title with itself, and similar ones.
+  std::vector<TitlePair> title_pairs = SimilarTitles(titles);
+  for (size_t t = 0; t < titles.size(); ++t) {
+    int id = static_cast<int>(t);
+    title_pairs.push_back(
+        {id, id, static_cast<uint64_t>(kSimilarityScale)});
+  }
+
+  std::vector<int> members_start(titles.size() + 1, 0);
+  std::vector<int> members(parsed.size());
+  for (const Parsed& p : parsed) ++members_start[p.title_id + 1];
+  std::partial_sum(members_start.begin(), members_start.end(),
+                   members_start.begin());
+  {
+    std::vector<int> next(members_start.begin(), members_start.end() - 1);
+    for (size_t i = 0; i < parsed.size(); ++i) {
+      members[next[parsed[i].title_id]++] = static_cast<int>(i);
+    }
+  }
+
+  std::vector<Edge> edges;
+  std::vector<uint64_t> seen;
+  for (const TitlePair& title_pair : title_pairs) {
+    int from = title_pair.a;
+    int to = title_pair.b;
+    for (int m = members_start[from]; m < members_start[from + 1]; ++m) {
+      int i = members[m];
+      const Parsed& a = parsed[i];
+      auto probe = [&](uint64_t artist) {
+        auto range = items_with(index_key(to, a.tags, artist));
+        for (auto it = range.first; it != range.second; ++it) {
+          int j = it->second;
+          if (j == i || (from == to && j < i)) continue;
+          seen.push_back(static_cast<uint64_t>(std::min(i, j)) << 32 |
+                         static_cast<uint32_t>(std::max(i, j)));
+        }
+      };
+      if (a.artists.empty()) probe(kNoArtist);
+      for (uint64_t artist : a.artists) probe(artist);
+    }
+    std::sort(seen.begin(), seen.end());
+    seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+    for (uint64_t pair : seen) {
+      int i = static_cast<int>(pair >> 32);
+      int j = static_cast<int>(pair & 0xFFFFFFFFu);
+      const Parsed& a = parsed[i];
+      const Parsed& b = parsed[j];
+      if (a.tags != b.tags || !ArtistsMatch(a, b)) continue;
+      bool exact = a.title_id == b.title_id && a.artists == b.artists;
+      edges.push_back(
+          MakeEdge(exact ? kExactScore : title_pair.score, i, j));
+    }
+    seen.clear();
+  }
+
+  std::sort(edges.begin(), edges.end());
+  Groups groups(items);
+  for (Edge edge : edges) groups.Merge(edge);
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    result[i] = groups.Find(static_cast<int>(i));
+  }
+  return result;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_search_group(const uint8_t* text, int64_t text_length,
+                            const int32_t* ranges, const int32_t* sources,
+                            int32_t count, int32_t* groups) {
+  if (count < 0 || count > cyrene::kMaxSearchItems ||
+      (count > 0 &&
+       (ranges == nullptr || sources == nullptr || groups == nullptr))) {
+    return -1;
+  }
+  const char* chars = reinterpret_cast<const char*>(text);
+  auto slice = [&](int32_t begin, int32_t end, std::string_view* out) {
+    if (begin < 0 || end < begin || end > text_length) return false;
+    *out = begin == end ? std::string_view()
+                        : std::string_view(chars + begin, end - begin);
+    return true;
+  };
+
+  std::vector<cyrene::SearchItem> items(count);
+  for (int32_t i = 0; i < count; ++i) {
+    items[i].source = sources[i];
+    if (!slice(ranges[4 * i], ranges[4 * i + 1], &items[i].title) ||
+        !slice(ranges[4 * i + 2], ranges[4 * i + 3], &items[i].artists)) {
+      return -1;
+    }
+  }
+
+  std::vector<int32_t> result = cyrene::GroupSearchResults(items);
+  int32_t group_count = 0;
+  for (int32_t i = 0; i < count; ++i) {
+    groups[i] = result[i];
+    if (result[i] == i) ++group_count;
+  }
+  return group_count;
+}
+
+}  // extern "C"
@@ -0,0 +1,58 @@
+#ifndef CYRENE_NATIVE_SEARCH_MERGE_H_
+#define CYRENE_NATIVE_SEARCH_MERGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// One search result: the platform it came from and its display strings.
+struct SearchItem {
+  int source = 0;  // 0..31
+  std::string_view title;
+  std::string_view artists;
+};
+
+// Groups results from different platforms that are the same recording.
+//
+// Titles and artists are folded (FoldText: NFKC, case, traditional to
+// simplified). Bracketed and " - " suffixes and "feat." clauses are cut
+// from the title; the suffixes only contribute version tags (live, remix,
+// instrumental, cover), which must agree. The rest of the title is
+// compared by padded character trigrams: MinHash signatures banded for
+// locality-sensitive hashing propose candidate pairs, which are accepted
+// when the exact trigram Jaccard similarity is at least kTitleThreshold
+// and at least half of the shorter artist list is shared.
+//
+// Accepted pairs are merged best first, never putting two results of one
+// platform in a group. Results with identical folded keys are always
+// merged, as the old exact-key merge did.
+//
+// Returns, for each item, the index of the first item of its group. At most
+// kMaxSearchItems items are supported.
+std::vector<int32_t> GroupSearchResults(const std::vector<SearchItem>& items);
+
+constexpr double kTitleThreshold = 0.7;
+constexpr int32_t kMaxSearchItems = 1 << 20;
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/search_merge_native.dart. Item i's title
+// is text[ranges[4i] .. ranges[4i+1]) and its artists
+// text[ranges[4i+2] .. ranges[4i+3]) (UTF-8). Writes the group of each item
+// to |groups| and returns the number of groups, or -1 for bad ranges.
+CYRENE_EXPORT int32_t cyrene_search_group(const uint8_t* text,
+                                          int64_t text_length,
+                                          const int32_t* ranges,
+                                          const int32_t* sources,
+                                          int32_t count, int32_t* groups);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_SEARCH_MERGE_H_
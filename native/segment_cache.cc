@@ -0,0 +1,379 @@
+#include "segment_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "cyrene_format.h"
+#include "fd_util.h"
+
+namespace cyrene {
+
+namespace {
+
+constexpr uint8_t kIndexMagic[4] = {'C', 'Y', 'S', 'C'};
+constexpr uint16_t kIndexVersion = 1;
+
+// magic + version + content type length + total size + segment size.
+constexpr size_t kIndexHeaderSize = 4 + 2 + 2 + 8 + 4;
+
+uint32_t SegmentsFor(uint64_t total_size) {
+  return static_cast<uint32_t>((total_size + kSegmentSize - 1) / kSegmentSize);
+}
+
+// Cache keys come from Dart ("qq_<id>_<quality>") or are URL hashes; keep
+// them to a safe file name alphabet regardless.
+std::string SanitizeKey(const std::string& key) {
+  std::string name = key.substr(0, 128);
+  for (char& c : name) {
+    bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+    if (!safe) c = '_';
+  }
+  if (name.empty() || name[0] == '.') name.insert(0, "_");
+  return name;
+}
+
+bool HasSuffix(const std::string& text, const char* suffix) {
+  size_t length = std::strlen(suffix);
+  return text.size() >= length &&
+         text.compare(text.size() - length, length, suffix) == 0;
+}
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+SegmentEntry::SegmentEntry(std::string data_path, std::string index_path)
+    : data_path_(std::move(data_path)),
+      index_path_(std::move(index_path)),
+      data_fd_(-1),
+      index_fd_(-1),
+      total_size_(0),
+      stored_(std::make_shared<std::atomic<uint64_t>>(0)) {}
+
+SegmentEntry::~SegmentEntry() {
+  if (data_fd_ >= 0) close(data_fd_);
+  if (index_fd_ >= 0) close(index_fd_);
+}
+
+bool SegmentEntry::Open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  data_fd_ = open(data_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  index_fd_ = open(index_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (data_fd_ < 0 || index_fd_ < 0) return false;
+
+  struct stat st;
+  if (fstat(index_fd_, &st) != 0) return false;
+  size_t index_size = static_cast<size_t>(st.st_size);
+  if (index_size < kIndexHeaderSize) return true;
+
+  std::vector<uint8_t> index(index_size);
+  if (!PReadFully(index_fd_, index.data(), index_size, 0)) return true;
+
+  uint16_t type_length = format::ReadU16(index.data() + 6);
+  uint64_t total_size = format::ReadU64(index.data() + 8);
+  size_t bitmap_length = (SegmentsFor(total_size) + 7) / 8;
+  bool valid = std::memcmp(index.data(), kIndexMagic, 4) == 0 &&
+               format::ReadU16(index.data() + 4) == kIndexVersion &&
+               format::ReadU32(index.data() + 16) == kSegmentSize &&
+               total_size > 0 &&
+               index_size == kIndexHeaderSize + type_length + bitmap_length &&
+               fstat(data_fd_, &st) == 0 &&
+               static_cast<uint64_t>(st.st_size) == total_size;
+  if (!valid) {
+    // Stale or foreign layout: start over.
+    if (ftruncate(index_fd_, 0) != 0 || ftruncate(data_fd_, 0) != 0) {
+      return false;
+    }
+    return true;
+  }
+
+  total_size_ = total_size;
+  content_type_.assign(
+      reinterpret_cast<const char*>(index.data() + kIndexHeaderSize),
+      type_length);
+  bitmap_.assign(index.begin() + kIndexHeaderSize + type_length, index.end());
+  uint64_t stored = 0;
+  for (uint32_t i = 0; i < SegmentsFor(total_size_); ++i) {
+    if ((bitmap_[i / 8] >> (i % 8)) & 1) {
+      uint64_t offset = static_cast<uint64_t>(i) * kSegmentSize;
+      stored += std::min<uint64_t>(kSegmentSize, total_size_ - offset);
+    }
+  }
+  *stored_ = stored;
+  return true;
+}
+
+uint64_t SegmentEntry::total_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_size_;
+}
+
+std::string SegmentEntry::content_type() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return content_type_;
+}
+
+uint32_t SegmentEntry::segment_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return SegmentsFor(total_size_);
+}
+
+bool SegmentEntry::SetTotalSize(uint64_t total_size,
+                                const std::string& content_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (total_size == 0) return false;
+  if (total_size == total_size_) return true;
+
+  // A different size means the upstream resource changed under the same key;
+  // nothing already cached can be trusted.
+  if (ftruncate(data_fd_, 0) != 0 ||
+      ftruncate(data_fd_, static_cast<off_t>(total_size)) != 0) {
+    return false;
+  }
+  total_size_ = total_size;
+  *stored_ = 0;
+  content_type_ = content_type.substr(0, 255);
+  bitmap_.assign((SegmentsFor(total_size) + 7) / 8, 0);
+  return WriteIndexHeader();
+}
+
+bool SegmentEntry::HasSegment(uint32_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index / 8 >= bitmap_.size()) return false;
+  return (bitmap_[index / 8] >> (index % 8)) & 1;
+}
+
+bool SegmentEntry::IsComplete() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t count = SegmentsFor(total_size_);
+  if (count == 0) return false;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!((bitmap_[i / 8] >> (i % 8)) & 1)) return false;
+  }
+  return true;
+}
+
+uint32_t SegmentEntry::NextAvailableOrPending(uint32_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t count = SegmentsFor(total_size_);
+  auto pending = pending_.lower_bound(index);
+  uint32_t limit =
+      pending == pending_.end() ? count : std::min(*pending, count);
+  for (uint32_t i = index; i < limit; ++i) {
+    if ((bitmap_[i / 8] >> (i % 8)) & 1) return i;
+  }
+  return limit;
+}
+
+bool SegmentEntry::WriteSegment(uint32_t index, const uint8_t* data,
+                                size_t length) {
+  uint64_t offset = static_cast<uint64_t>(index) * kSegmentSize;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (offset >= total_size_) return false;
+    uint64_t expected =
+        std::min<uint64_t>(kSegmentSize, total_size_ - offset);
+    if (length != expected) return false;
+    if ((bitmap_[index / 8] >> (index % 8)) & 1) return true;
+  }
+
+  // The data write happens outside the lock so readers of other segments are
+  // not held up by disk I/O.
+  if (!PWriteFully(data_fd_, data, length, offset)) return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint8_t& byte = bitmap_[index / 8];
+  if (!((byte >> (index % 8)) & 1)) *stored_ += length;
+  byte |= static_cast<uint8_t>(1u << (index % 8));
+  return PWriteFully(index_fd_, &byte, 1, BitmapOffset() + index / 8);
+}
+
+std::string SegmentEntry::url() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return url_;
+}
+
+void SegmentEntry::set_url(const std::string& url) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  url_ = url;
+}
+
+bool SegmentEntry::IsPending(uint32_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.count(index) != 0;
+}
+
+void SegmentEntry::MarkPending(uint32_t first, uint32_t last) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = first; i < last; ++i) pending_.insert(i);
+}
+
+void SegmentEntry::ClearPending(uint32_t first, uint32_t last) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.erase(pending_.lower_bound(first), pending_.lower_bound(last));
+}
+
+bool SegmentEntry::WriteIndexHeader() {
+  std::vector<uint8_t> index(kIndexHeaderSize);
+  std::memcpy(index.data(), kIndexMagic, 4);
+  format::WriteU16(index.data() + 4, kIndexVersion);
+  format::WriteU16(index.data() + 6,
+                   static_cast<uint16_t>(content_type_.size()));
+  format::WriteU64(index.data() + 8, total_size_);
+  format::WriteU32(index.data() + 16, kSegmentSize);
+  index.insert(index.end(), content_type_.begin(), content_type_.end());
+  index.insert(index.end(), bitmap_.begin(), bitmap_.end());
+
+  return ftruncate(index_fd_, 0) == 0 &&
+         PWriteFully(index_fd_, index.data(), index.size(), 0);
+}
+
+size_t SegmentEntry::BitmapOffset() const {
+  return kIndexHeaderSize + content_type_.size();
+}
+
+SegmentCache::SegmentCache(std::string directory, uint64_t limit)
+    : directory_(std::move(directory)), limit_(limit), usage_(0) {
+  mkdir(directory_.c_str(), 0755);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Load();
+  TrimLocked();
+}
+
+std::shared_ptr<SegmentEntry> SegmentCache::Acquire(const std::string& key,
+                                                    bool create) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return AcquireLocked(key, create, false);
+}
+
+std::shared_ptr<SegmentEntry> SegmentCache::AcquireForPrefetch(
+    const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return AcquireLocked(key, true, true);
+}
+
+std::shared_ptr<SegmentEntry> SegmentCache::AcquireLocked(
+    const std::string& key, bool create, bool prefetch) {
+  std::string name = SanitizeKey(key);
+  std::string base = directory_ + "/" + name;
+  int64_t now = NowNanos();
+
+  auto it = entries_.find(name);
+  bool known = it != entries_.end();
+  std::shared_ptr<SegmentEntry> entry;
+  if (known) entry = it->second.entry.lock();
+  if (!entry) {
+    if (!create && access((base + ".idx").c_str(), F_OK) != 0) return nullptr;
+    entry = std::make_shared<SegmentEntry>(base + ".seg", base + ".idx");
+    if (!entry->Open()) return nullptr;
+  }
+  utimensat(AT_FDCWD, (base + ".idx").c_str(), nullptr, 0);
+
+  Slot& slot = entries_[name];
+  // Only a new entry starts out prefetched; playback clears the mark.
+  if (prefetch && !known) {
+    int fd = open((base + ".pf").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+                  0644);
+    if (fd >= 0) close(fd);
+    slot.prefetched = true;
+  } else if (!prefetch && slot.prefetched) {
+    unlink((base + ".pf").c_str());
+    slot.prefetched = false;
+  }
+  slot.entry = entry;
+  slot.stored = entry->stored_counter();
+  slot.last_used = now;
+  return entry;
+}
+
+void SegmentCache::SetLimit(uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  limit_ = bytes;
+  TrimLocked();
+}
+
+void SegmentCache::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  TrimLocked();
+}
+
+uint64_t SegmentCache::usage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return usage_;
+}
+
+void SegmentCache::Load() {
+  DIR* dir = opendir(directory_.c_str());
+  if (dir == nullptr) return;
+  std::vector<std::string> orphans;
+  while (dirent* item = readdir(dir)) {
+    std::string file = item->d_name;
+    std::string path = directory_ + "/" + file;
+    if (HasSuffix(file, ".seg") || HasSuffix(file, ".pf")) {
+      std::string index = path.substr(0, path.rfind('.')) + ".idx";
+      if (access(index.c_str(), F_OK) != 0) orphans.push_back(path);
+      continue;
+    }
+    if (!HasSuffix(file, ".idx")) continue;
+
+    struct stat index_st;
+    struct stat data_st;
+    std::string data = path.substr(0, path.size() - 4) + ".seg";
+    if (stat(path.c_str(), &index_st) != 0) continue;
+    Slot& slot = entries_[file.substr(0, file.size() - 4)];
+    // The data file is sparse; its allocated blocks are what it costs.
+    slot.disk_bytes = stat(data.c_str(), &data_st) == 0
+                     ? static_cast<uint64_t>(data_st.st_blocks) * 512
+                     : 0;
+    slot.last_used = static_cast<int64_t>(index_st.st_mtim.tv_sec) *
+                         1000000000 +
+                     index_st.st_mtim.tv_nsec;
+    std::string marker = path.substr(0, path.size() - 4) + ".pf";
+    slot.prefetched = access(marker.c_str(), F_OK) == 0;
+  }
+  closedir(dir);
+  for (const std::string& path : orphans) unlink(path.c_str());
+}
+
+void SegmentCache::TrimLocked() {
+  using Iterator = std::map<std::string, Slot>::iterator;
+  std::vector<Iterator> idle;
+  uint64_t total = 0;
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->second.entry.expired()) idle.push_back(it);
+    total += it->second.bytes();
+  }
+
+  if (limit_ != 0 && total > limit_) {
+    // Unplayed prefetches first, then least recently used.
+    std::sort(idle.begin(), idle.end(), [](Iterator a, Iterator b) {
+      if (a->second.prefetched != b->second.prefetched) {
+        return a->second.prefetched;
+      }
+      return a->second.last_used < b->second.last_used;
+    });
+    for (Iterator it : idle) {
+      if (total <= limit_) break;
+      std::string base = directory_ + "/" + it->first;
+      unlink((base + ".seg").c_str());
+      unlink((base + ".idx").c_str());
+      unlink((base + ".pf").c_str());
+      total -= it->second.bytes();
+      entries_.erase(it);
+    }
+  }
+  usage_ = total;
+}
+
+}  // namespace cyrene
@@ -0,0 +1,171 @@
+#ifndef CYRENE_NATIVE_SEGMENT_CACHE_H_
+#define CYRENE_NATIVE_SEGMENT_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cyrene {
+
+// Granularity of the segment cache. Upstream fetches and presence tracking
+// both work in whole segments.
+constexpr uint32_t kSegmentSize = 64 * 1024;
+
+// One cached upstream resource: a sparse data file holding whatever byte
+// ranges have been fetched so far, plus a small index file recording the
+// total size, content type and which fixed-size segments are present.
+//
+// On disk ("<key>.seg" / "<key>.idx"):
+//   idx: "CYSC" | u16 version | u16 content type length | u64 total size |
+//        u32 segment size | content type | segment bitmap (LSB first)
+//   seg: the resource bytes at their natural offsets (holes where missing)
+//
+// A segment's bitmap bit is only written after its data, so a present bit
+// always refers to complete data. The cache lives in a temporary directory
+// and is treated as disposable: anything that fails to parse is discarded.
+//
+// All methods are thread-safe.
+class SegmentEntry {
+ public:
+  SegmentEntry(std::string data_path, std::string index_path);
+  ~SegmentEntry();
+
+  SegmentEntry(const SegmentEntry&) = delete;
+  SegmentEntry& operator=(const SegmentEntry&) = delete;
+
+  // Opens (or creates) the backing files and loads the index if one exists.
+  bool Open();
+
+  // Total resource size, or 0 while it is still unknown.
+  uint64_t total_size() const;
+  std::string content_type() const;
+  uint32_t segment_count() const;
+
+  // Records the resource size once it is learned from an upstream response.
+  // A size that disagrees with the stored one resets the entry.
+  bool SetTotalSize(uint64_t total_size, const std::string& content_type);
+
+  bool HasSegment(uint32_t index) const;
+
+  // True once every segment of a known-size resource is present.
+  bool IsComplete() const;
+
+  // Index of the first segment at or after |index| that is present or being
+  // fetched, or segment_count() if there is none.
+  uint32_t NextAvailableOrPending(uint32_t index) const;
+
+  // Writes one complete segment (the last one may be short) and marks it
+  // present. Segments that are already present are left untouched.
+  bool WriteSegment(uint32_t index, const uint8_t* data, size_t length);
+
+  // Bytes of the resource present in the cache. The counter outlives the
+  // entry, so the owning SegmentCache can account for it after release.
+  uint64_t stored_bytes() const { return *stored_; }
+  std::shared_ptr<const std::atomic<uint64_t>> stored_counter() const {
+    return stored_;
+  }
+
+  // Descriptor of the data file, for reading present segments with pread().
+  int data_fd() const { return data_fd_; }
+
+  // Upstream URL most recently supplied for this resource. Signed CDN URLs
+  // expire, so fetches always use the newest one.
+  std::string url() const;
+  void set_url(const std::string& url);
+
+  // In-flight bookkeeping so that concurrent readers do not fetch the same
+  // segments twice.
+  bool IsPending(uint32_t index) const;
+  void MarkPending(uint32_t first, uint32_t last);
+  void ClearPending(uint32_t first, uint32_t last);
+
+ private:
+  bool WriteIndexHeader();
+  size_t BitmapOffset() const;
+
+  const std::string data_path_;
+  const std::string index_path_;
+
+  mutable std::mutex mutex_;
+  int data_fd_;
+  int index_fd_;
+  uint64_t total_size_;
+  std::string content_type_;
+  std::vector<uint8_t> bitmap_;
+  std::set<uint32_t> pending_;
+  std::string url_;
+  const std::shared_ptr<std::atomic<uint64_t>> stored_;
+};
+
+// Directory of SegmentEntry files, keyed by a caller-supplied cache key.
+// Entries are shared between concurrent users of the same key.
+//
+// The directory holds plain copies of whatever was streamed, so it is kept to
+// a byte budget: Trim() deletes whole entries, least recently acquired first,
+// until the cached data fits. Entries that were only prefetched and never
+// played go before any played one, so a wrong guess about the next track
+// cannot push out what the user listens to. Entries someone still holds (a
+// track that is playing or being fetched) are never deleted. Recency
+// survives restarts as the index file's modification time, and the
+// prefetched state as an empty "<key>.pf" marker.
+class SegmentCache {
+ public:
+  static constexpr uint64_t kDefaultLimit = 512ull * 1024 * 1024;
+
+  explicit SegmentCache(std::string directory, uint64_t limit = kDefaultLimit);
+
+  // Returns the entry for |key|, opening it if no one holds it yet. With
+  // |create| false, returns null instead of creating a new entry on disk.
+  // The entry counts as played from now on.
+  std::shared_ptr<SegmentEntry> Acquire(const std::string& key,
+                                        bool create = true);
+
+  // Same, for the prefetcher: an entry that is new or was only prefetched
+  // so far stays marked as prefetched; a played one stays played.
+  std::shared_ptr<SegmentEntry> AcquireForPrefetch(const std::string& key);
+
+  // |bytes| 0 removes the limit. Trims right away.
+  void SetLimit(uint64_t bytes);
+
+  // Deletes entries until the cache fits its limit. Called after data is
+  // written; the cache may exceed the limit by what was written since.
+  void Trim();
+
+  // Bytes cached as of the last Trim().
+  uint64_t usage() const;
+
+ private:
+  struct Slot {
+    std::weak_ptr<SegmentEntry> entry;
+    // The entry's stored_counter() once it has been opened in this process;
+    // until then, the data file's allocated size as found on disk.
+    std::shared_ptr<const std::atomic<uint64_t>> stored;
+    uint64_t disk_bytes = 0;
+    int64_t last_used = 0;  // Unix nanoseconds.
+    bool prefetched = false;  // Never acquired for playback.
+
+    uint64_t bytes() const { return stored ? stored->load() : disk_bytes; }
+  };
+
+  std::shared_ptr<SegmentEntry> AcquireLocked(const std::string& key,
+                                              bool create, bool prefetch);
+  void Load();
+  void TrimLocked();
+
+  const std::string directory_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Slot> entries_;  // Every entry on disk.
+  uint64_t limit_;
+  uint64_t usage_;
+};
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_SEGMENT_CACHE_H_
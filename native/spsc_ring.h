@@ -0,0 +1,106 @@
+#ifndef CYRENE_NATIVE_SPSC_RING_H_
+#define CYRENE_NATIVE_SPSC_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace cyrene {
+
+// Lock-free ring buffer for exactly one producer thread and one consumer
+// thread. Neither side blocks or allocates, so the consumer can be an audio
+// callback. Capacity is rounded up to a power of two.
+//
+// The producer calls Write() and WriteAvailable(); the consumer calls
+// Read(), Peek(), Discard() and ReadAvailable().
+template <typename T>
+class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscRing copies elements with memcpy");
+
+ public:
+  explicit SpscRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    buffer_.reset(new T[size]);
+    mask_ = size - 1;
+  }
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  size_t ReadAvailable() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_relaxed);
+  }
+
+  size_t WriteAvailable() const {
+    return capacity() - (head_.load(std::memory_order_relaxed) -
+                         tail_.load(std::memory_order_acquire));
+  }
+
+  // Appends up to |count| elements; returns how many fitted.
+  size_t Write(const T* data, size_t count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    count = std::min(count, capacity() - (head - tail));
+    CopyIn(head, data, count);
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  // Removes up to |count| elements into |out|; returns how many there were.
+  size_t Read(T* out, size_t count) {
+    count = Peek(out, count);
+    tail_.store(tail_.load(std::memory_order_relaxed) + count,
+                std::memory_order_release);
+    return count;
+  }
+
+  // Copies up to |count| elements without removing them.
+  size_t Peek(T* out, size_t count) const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    count = std::min(count, head - tail);
+    CopyOut(tail, out, count);
+    return count;
+  }
+
+  // Drops up to |count| elements; returns how many were dropped.
+  size_t Discard(size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    count = std::min(count, head_.load(std::memory_order_acquire) - tail);
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+ private:
+  void CopyIn(size_t at, const T* data, size_t count) {
+    size_t start = at & mask_;
+    size_t first = std::min(count, capacity() - start);
+    std::memcpy(buffer_.get() + start, data, first * sizeof(T));
+    std::memcpy(buffer_.get(), data + first, (count - first) * sizeof(T));
+  }
+
+  void CopyOut(size_t at, T* out, size_t count) const {
+    size_t start = at & mask_;
+    size_t first = std::min(count, capacity() - start);
+    std::memcpy(out, buffer_.get() + start, first * sizeof(T));
+    std::memcpy(out + first, buffer_.get(), (count - first) * sizeof(T));
+  }
+
+  std::unique_ptr<T[]> buffer_;
+  size_t mask_ = 0;
+  // Total elements ever written and read; only their difference matters,
+  // so wrapping is harmless. Kept on separate cache lines.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_SPSC_RING_H_
@@ -0,0 +1,323 @@
+#include "audio_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "audio_sink.h"
+#include "http_test_server.h"
+
+namespace cyrene {
+namespace {
+
+using testing::TempDirectory;
+using Clock = std::chrono::steady_clock;
+using State = AudioEngine::State;
+
+// Writes |ms| of a quiet 16-bit stereo sine at |rate| as a RIFF WAVE file.
+std::string WriteWav(const TempDirectory& dir, const std::string& name,
+                     int ms, int rate = kEngineRate) {
+  uint32_t frames = static_cast<uint32_t>(int64_t{rate} * ms / 1000);
+  uint32_t data_size = frames * 4;
+  std::vector<uint8_t> file(44 + data_size);
+  auto put32 = [&](size_t at, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+      file[at + i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+  };
+  auto put16 = [&](size_t at, uint16_t v) {
+    file[at] = static_cast<uint8_t>(v);
+    file[at + 1] = static_cast<uint8_t>(v >> 8);
+  };
+  std::memcpy(&file[0], "RIFF", 4);
+  put32(4, 36 + data_size);
+  std::memcpy(&file[8], "WAVEfmt ", 8);
+  put32(16, 16);
+  put16(20, 1);  // PCM
+  put16(22, 2);
+  put32(24, static_cast<uint32_t>(rate));
+  put32(28, static_cast<uint32_t>(rate) * 4);
+  put16(32, 4);
+  put16(34, 16);
+  std::memcpy(&file[36], "data", 4);
+  put32(40, data_size);
+  for (uint32_t i = 0; i < frames; ++i) {
+    int16_t sample = static_cast<int16_t>(
+        3000 * std::sin(2 * M_PI * 440 * i / static_cast<double>(rate)));
+    put16(44 + i * 4, static_cast<uint16_t>(sample));
+    put16(46 + i * 4, static_cast<uint16_t>(sample));
+  }
+
+  std::string path = dir.path() + "/" + name;
+  FILE* out = std::fopen(path.c_str(), "wb");
+  EXPECT_NE(out, nullptr);
+  if (out != nullptr) {
+    std::fwrite(file.data(), 1, file.size(), out);
+    std::fclose(out);
+  }
+  return path;
+}
+
+std::unique_ptr<AudioEngine> NullEngine(
+    AudioEngine::DecoderOpener open = OpenAudioDecoder) {
+  std::unique_ptr<AudioSink> sink = OpenAudioSink(SinkBackend::kNull, 1024);
+  EXPECT_TRUE(sink);
+  return std::make_unique<AudioEngine>(std::move(sink), std::move(open));
+}
+
+// One status() reading and when it was taken.
+struct Sample {
+  Clock::time_point at;
+  AudioEngine::Status status;
+};
+
+// Polls |engine| every 2 ms until |done| holds or |timeout_ms| passes.
+// Returns every reading, the last one satisfying |done| unless it timed out.
+std::vector<Sample> PollUntil(
+    const AudioEngine& engine,
+    const std::function<bool(const AudioEngine::Status&)>& done,
+    int timeout_ms = 5000) {
+  std::vector<Sample> samples;
+  Clock::time_point deadline =
+      Clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (Clock::now() < deadline) {
+    samples.push_back({Clock::now(), engine.status()});
+    if (done(samples.back().status)) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  return samples;
+}
+
+bool Ended(const AudioEngine::Status& status) {
+  return status.state == State::kEnded || status.state == State::kError;
+}
+
+// What a run of samples says about each item.
+struct ItemTrace {
+  int64_t first_position = -1;
+  int64_t max_position = -1;
+  Clock::time_point first_heard;
+};
+
+ItemTrace Trace(const std::vector<Sample>& samples, int64_t item_id) {
+  ItemTrace trace;
+  for (const Sample& sample : samples) {
+    const AudioEngine::Status& status = sample.status;
+    if (status.item_id != item_id || status.state == State::kLoading) continue;
+    if (trace.first_position < 0) {
+      trace.first_position = status.position_ms;
+      trace.first_heard = sample.at;
+    }
+    trace.max_position = std::max(trace.max_position, status.position_ms);
+  }
+  return trace;
+}
+
+// Item ids in the order they were heard, repeats collapsed.
+std::vector<int64_t> Order(const std::vector<Sample>& samples) {
+  std::vector<int64_t> order;
+  for (const Sample& sample : samples) {
+    int64_t id = sample.status.item_id;
+    if (id != 0 && (order.empty() || order.back() != id)) order.push_back(id);
+  }
+  return order;
+}
+
+int64_t Ms(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+      .count();
+}
+
+TEST(AudioEngineTest, NullSink) {
+  std::unique_ptr<AudioEngine> engine = NullEngine();
+  EXPECT_STREQ(engine->sink_name(), "null");
+  EXPECT_EQ(engine->status().state, State::kIdle);
+}
+
+TEST(AudioEngineTest, GaplessHandover) {
+  TempDirectory dir;
+  std::string first = WriteWav(dir, "first.wav", 600);
+  // A different rate goes through the resampler without changing length.
+  std::string second = WriteWav(dir, "second.wav", 600, 44100);
+  std::unique_ptr<AudioEngine> engine = NullEngine();
+  engine->Load(1, first, true);
+  engine->QueueNext(2, second);
+
+  std::vector<Sample> samples = PollUntil(*engine, Ended);
+  ASSERT_EQ(samples.back().status.state, State::kEnded);
+  EXPECT_EQ(samples.back().status.item_id, 2);
+  EXPECT_EQ(Order(samples), (std::vector<int64_t>{1, 2}));
+
+  // The first item plays to its end and the second from its start: no
+  // crossfade cut, nothing skipped.
+  ItemTrace one = Trace(samples, 1);
+  ItemTrace two = Trace(samples, 2);
+  EXPECT_GE(one.max_position, 550);
+  EXPECT_LE(two.first_position, 100);
+  EXPECT_GE(two.max_position, 550);
+  EXPECT_EQ(samples.back().status.duration_ms, 600);
+
+  // The second item was decoded into the ring long before it was heard;
+  // its boundary marker makes status() switch only when it is.
+  EXPECT_GE(Ms(two.first_heard - one.first_heard), 500);
+
+  // The handover did not run the ring dry.
+  EXPECT_EQ(samples.back().status.next_item_id, 0);
+  EXPECT_EQ(samples.back().status.underruns, 0);
+}
+
+TEST(AudioEngineTest, CrossfadeOverlapsTheItems) {
+  TempDirectory dir;
+  std::string first = WriteWav(dir, "first.wav", 3000);
+  std::string second = WriteWav(dir, "second.wav", 600);
+  std::unique_ptr<AudioEngine> engine = NullEngine();
+  engine->SetCrossfade(300);
+  engine->Load(1, first, true);
+  ASSERT_GT(PollUntil(*engine, [](const AudioEngine::Status& status) {
+              return status.position_ms > 0;
+            }).back().status.position_ms,
+            0);
+
+  // Queued mid-item, the next one is reported ready while the first plays.
+  engine->QueueNext(2, second);
+  AudioEngine::Status ready =
+      PollUntil(*engine, [](const AudioEngine::Status& status) {
+        return status.next_item_id == 2;
+      }).back().status;
+  EXPECT_EQ(ready.next_item_id, 2);
+  EXPECT_EQ(ready.item_id, 1);
+
+  std::vector<Sample> samples = PollUntil(*engine, Ended);
+  ASSERT_EQ(samples.back().status.state, State::kEnded);
+  EXPECT_EQ(Order(samples), (std::vector<int64_t>{1, 2}));
+
+  // The incoming item's marker goes in where the fade starts, 300 ms before
+  // the end of the first (give or take one 21 ms decode chunk), so the
+  // first is never reported past that.
+  ItemTrace one = Trace(samples, 1);
+  ItemTrace two = Trace(samples, 2);
+  EXPECT_GE(one.max_position, 2600);
+  EXPECT_LE(one.max_position, 2750);
+  EXPECT_LE(two.first_position, 100);
+  EXPECT_GE(two.max_position, 550);
+  EXPECT_EQ(samples.back().status.underruns, 0);
+}
+
+TEST(AudioEngineTest, Seek) {
+  TempDirectory dir;
+  std::string track = WriteWav(dir, "track.wav", 2000);
+  std::unique_ptr<AudioEngine> engine = NullEngine();
+  engine->Load(1, track, false);
+  ASSERT_EQ(PollUntil(*engine, [](const AudioEngine::Status& status) {
+              return status.state == State::kPaused && status.item_id == 1;
+            }).back().status.state,
+            State::kPaused);
+  EXPECT_EQ(engine->status().duration_ms, 2000);
+
+  // While paused nothing plays, so the position is exactly the target.
+  engine->Seek(1500);
+  EXPECT_EQ(PollUntil(*engine, [](const AudioEngine::Status& status) {
+              return status.position_ms == 1500;
+            }).back().status.position_ms,
+            1500);
+
+  // Back towards the start while playing.
+  engine->Play();
+  std::vector<Sample> samples = PollUntil(
+      *engine, [](const AudioEngine::Status& status) {
+        return status.position_ms >= 1600;
+      });
+  ASSERT_GE(samples.back().status.position_ms, 1600);
+  engine->Seek(100);
+  samples = PollUntil(*engine, [](const AudioEngine::Status& status) {
+    return status.position_ms < 500;
+  });
+  EXPECT_GE(samples.back().status.position_ms, 100);
+  EXPECT_LT(samples.back().status.position_ms, 500);
+  EXPECT_EQ(samples.back().status.state, State::kPlaying);
+
+  // Past the end finishes the item.
+  engine->Seek(5000);
+  samples = PollUntil(*engine, Ended);
+  EXPECT_EQ(samples.back().status.state, State::kEnded);
+
+  // Pauses, flushes and the end are not underruns.
+  EXPECT_EQ(samples.back().status.underruns, 0);
+}
+
+// Stands in for a network source: while |stalled| is set, Read() returns 0
+// without the stream having finished or failed.
+class StallingDecoder : public AudioDecoder {
+ public:
+  StallingDecoder(std::unique_ptr<AudioDecoder> decoder,
+                  const std::atomic<bool>* stalled)
+      : decoder_(std::move(decoder)), stalled_(stalled) {}
+
+  size_t Read(float* out, size_t frames) override {
+    return *stalled_ ? 0 : decoder_->Read(out, frames);
+  }
+  bool Seek(int64_t frame) override { return decoder_->Seek(frame); }
+  int64_t length() const override { return decoder_->length(); }
+  bool finished() const override { return !*stalled_ && decoder_->finished(); }
+  bool failed() const override { return !*stalled_ && decoder_->failed(); }
+
+ private:
+  std::unique_ptr<AudioDecoder> decoder_;
+  const std::atomic<bool>* stalled_;
+};
+
+TEST(AudioEngineTest, StalledSourceCountsOneUnderrun) {
+  TempDirectory dir;
+  std::string track = WriteWav(dir, "track.wav", 3500);
+  std::atomic<bool> stalled{false};
+  std::unique_ptr<AudioEngine> engine =
+      NullEngine([&stalled](const std::string& uri) {
+        std::unique_ptr<AudioDecoder> decoder;
+        if (std::unique_ptr<AudioDecoder> wav = OpenAudioDecoder(uri)) {
+          decoder.reset(new StallingDecoder(std::move(wav), &stalled));
+        }
+        return decoder;
+      });
+  engine->Load(1, track, true);
+  ASSERT_GT(PollUntil(*engine, [](const AudioEngine::Status& status) {
+              return status.position_ms > 0;
+            }).back().status.position_ms,
+            0);
+
+  // The preroll and the ring play out, then the output runs dry mid-item.
+  stalled = true;
+  std::vector<Sample> samples = PollUntil(
+      *engine,
+      [](const AudioEngine::Status& status) { return status.underruns > 0; },
+      8000);
+  ASSERT_EQ(samples.back().status.underruns, 1);
+  EXPECT_EQ(samples.back().status.state, State::kPlaying);
+
+  // Once the device has played out what it held, the position stops, and
+  // a long stall is one underrun, not one per empty period.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  int64_t stuck_at = engine->status().position_ms;
+  EXPECT_LT(stuck_at, 3400);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_EQ(engine->status().position_ms, stuck_at);
+  EXPECT_EQ(engine->status().underruns, 1);
+  EXPECT_EQ(engine->status().state, State::kPlaying);
+
+  stalled = false;
+  samples = PollUntil(*engine, Ended);
+  EXPECT_EQ(samples.back().status.state, State::kEnded);
+  EXPECT_EQ(samples.back().status.underruns, 1);
+}
+
+}  // namespace
+}  // namespace cyrene
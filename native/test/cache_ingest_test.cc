@@ -0,0 +1,163 @@
+#include "cache_ingest.h"
+
+#include <openssl/evp.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cyrene_file.h"
+#include "http_test_server.h"
+#include "upstream_client.h"
+
+namespace cyrene {
+namespace {
+
+using testing::HttpTestServer;
+using testing::TempDirectory;
+using testing::TestResource;
+
+std::string RandomBytes(size_t length, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::string bytes(length, '\0');
+  for (char& c : bytes) c = static_cast<char>(random());
+  return bytes;
+}
+
+// One-shot digest to compare the incremental one against.
+std::string Md5Hex(const std::string& data) {
+  uint8_t md5[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_Digest(data.data(), data.size(), md5, &length, EVP_md5(), nullptr);
+  std::string hex;
+  char digits[3];
+  for (unsigned int i = 0; i < length; ++i) {
+    std::snprintf(digits, sizeof(digits), "%02x", md5[i]);
+    hex += digits;
+  }
+  return hex;
+}
+
+bool Exists(const std::string& path) { return access(path.c_str(), F_OK) == 0; }
+
+class CacheIngestTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(server_.Start());
+    // Several writer blocks, with a partial last one.
+    body_ = RandomBytes(3 * 1024 * 1024 + 12345, 1);
+    server_.Put("/track.mp3", TestResource{body_});
+    path_ = directory_.path() + "/track.cyrene";
+  }
+
+  bool Ingest(const std::string& url, const std::string& expected_md5,
+              IngestResult* result) {
+    return IngestToCache(&client_, url, path_, key_, sizeof(key_),
+                         reinterpret_cast<const uint8_t*>(kMetadata),
+                         sizeof(kMetadata) - 1, expected_md5, result);
+  }
+
+  // Nothing may be left behind by a failed ingest.
+  void ExpectNoFiles() {
+    EXPECT_FALSE(Exists(path_));
+    EXPECT_FALSE(Exists(path_ + ".part"));
+  }
+
+  static constexpr char kMetadata[] = "{\"songId\":\"42\"}";
+
+  HttpTestServer server_;
+  TempDirectory directory_;
+  UpstreamClient client_;
+  std::string body_;
+  std::string path_;
+  uint8_t key_[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+};
+
+TEST_F(CacheIngestTest, StreamsIntoAVerifiedCacheFile) {
+  IngestResult result;
+  ASSERT_TRUE(Ingest(server_.Url("/track.mp3"), "", &result));
+  EXPECT_EQ(result.status, 200);
+  EXPECT_EQ(result.size, body_.size());
+  EXPECT_EQ(result.md5, Md5Hex(body_));
+  EXPECT_FALSE(Exists(path_ + ".part"));
+
+  CyreneFile file;
+  ASSERT_TRUE(file.Open(path_, key_, sizeof(key_)));
+  EXPECT_EQ(file.version(), 3);
+  EXPECT_EQ(std::string(file.metadata(), file.metadata_length()), kMetadata);
+  EXPECT_GT(file.block_count(), 1u);
+  EXPECT_EQ(file.Verify(), -1);
+  std::string audio(file.audio_size(), '\0');
+  ASSERT_EQ(file.ReadAudio(0, reinterpret_cast<uint8_t*>(&audio[0]),
+                           audio.size()),
+            static_cast<int64_t>(body_.size()));
+  EXPECT_EQ(audio, body_);
+}
+
+TEST_F(CacheIngestTest, DigestIsIncrementalAcrossSmallReads) {
+  // A throttled server hands the client the body in many small pieces.
+  std::string body = RandomBytes(256 * 1024, 2);
+  server_.Put("/slow.mp3", TestResource{body});
+  server_.set_bytes_per_second(4 * 1024 * 1024);
+  IngestResult result;
+  ASSERT_TRUE(Ingest(server_.Url("/slow.mp3"), "", &result));
+  EXPECT_EQ(result.size, body.size());
+  EXPECT_EQ(result.md5, Md5Hex(body));
+}
+
+TEST_F(CacheIngestTest, AcceptsMatchingExpectedMd5InAnyCase) {
+  std::string expected = Md5Hex(body_);
+  for (char& c : expected) c = static_cast<char>(std::toupper(c));
+  IngestResult result;
+  EXPECT_TRUE(Ingest(server_.Url("/track.mp3"), expected, &result));
+  EXPECT_TRUE(Exists(path_));
+}
+
+TEST_F(CacheIngestTest, Md5MismatchLeavesNoFile) {
+  IngestResult result;
+  EXPECT_FALSE(Ingest(server_.Url("/track.mp3"),
+                      "0123456789abcdef0123456789abcdef", &result));
+  EXPECT_EQ(result.status, 200);
+  EXPECT_EQ(result.size, body_.size());
+  EXPECT_EQ(result.md5, Md5Hex(body_));
+  ExpectNoFiles();
+}
+
+TEST_F(CacheIngestTest, TruncatedBodyLeavesNoFile) {
+  TestResource truncated{body_};
+  truncated.truncate_after = 1024 * 1024 + 7;
+  server_.Put("/cut.mp3", truncated);
+  IngestResult result;
+  EXPECT_FALSE(Ingest(server_.Url("/cut.mp3"), "", &result));
+  EXPECT_EQ(result.status, 200);
+  EXPECT_EQ(result.size, truncated.truncate_after);
+  ExpectNoFiles();
+
+  // The pooled client recovers for the next download.
+  EXPECT_TRUE(Ingest(server_.Url("/track.mp3"), "", &result));
+}
+
+TEST_F(CacheIngestTest, ErrorStatusCreatesNothing) {
+  IngestResult result;
+  EXPECT_FALSE(Ingest(server_.Url("/missing.mp3"), "", &result));
+  EXPECT_EQ(result.status, 404);
+  EXPECT_EQ(result.size, 0u);
+  ExpectNoFiles();
+}
+
+TEST_F(CacheIngestTest, UnreachableServer) {
+  std::string url = server_.Url("/track.mp3");
+  server_.Stop();
+  IngestResult result;
+  EXPECT_FALSE(Ingest(url, "", &result));
+  EXPECT_EQ(result.status, 0);
+  ExpectNoFiles();
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,242 @@
+#include "http_test_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace cyrene {
+namespace testing {
+
+namespace {
+
+std::string Lower(std::string text) {
+  for (char& c : text) {
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+  }
+  return text;
+}
+
+bool SendAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent <= 0) return false;
+    data += sent;
+    length -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+}  // namespace
+
+HttpTestServer::HttpTestServer()
+    : listen_fd_(-1),
+      port_(0),
+      stopping_(false),
+      bytes_per_second_(0),
+      requests_(0),
+      body_bytes_(0) {}
+
+HttpTestServer::~HttpTestServer() {
+  Stop();
+}
+
+bool HttpTestServer::Start() {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) return false;
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+                  &length) != 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  port_ = ntohs(address.sin_port);
+  accept_thread_ = std::thread(&HttpTestServer::AcceptLoop, this);
+  return true;
+}
+
+void HttpTestServer::Stop() {
+  if (listen_fd_ < 0) return;
+  stopping_ = true;
+  // Wakes the blocked accept() and recv() calls.
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  std::vector<std::thread> connections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int fd : connection_fds_) shutdown(fd, SHUT_RDWR);
+    connections.swap(connections_);
+  }
+  for (std::thread& thread : connections) thread.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+}
+
+std::string HttpTestServer::Url(const std::string& path) const {
+  return "http://127.0.0.1:" + std::to_string(port_) + path;
+}
+
+void HttpTestServer::Put(const std::string& path, TestResource resource) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resources_[path] = std::move(resource);
+}
+
+void HttpTestServer::AcceptLoop() {
+  while (!stopping_) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (stopping_) return;
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_fds_.push_back(fd);
+    connections_.emplace_back(&HttpTestServer::Serve, this, fd);
+  }
+}
+
+void HttpTestServer::Serve(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  while (!stopping_) {
+    size_t head_end;
+    while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+      if (received <= 0) {
+        close(fd);
+        return;
+      }
+      buffer.append(chunk, static_cast<size_t>(received));
+    }
+    std::string head = buffer.substr(0, head_end);
+    buffer.erase(0, head_end + 4);
+    ++requests_;
+
+    char method[16] = {};
+    char target[2048] = {};
+    if (std::sscanf(head.c_str(), "%15s %2047s", method, target) != 2) break;
+    bool has_range = false;
+    unsigned long long first = 0;
+    unsigned long long last = ~0ull;
+    size_t line = head.find("\r\n");
+    while (line != std::string::npos) {
+      size_t next = head.find("\r\n", line + 2);
+      std::string header = head.substr(line + 2, next - line - 2);
+      size_t colon = header.find(':');
+      if (colon != std::string::npos &&
+          Lower(header.substr(0, colon)) == "range") {
+        std::string value = header.substr(colon + 1);
+        has_range = std::sscanf(value.c_str(), " bytes=%llu-%llu", &first,
+                                &last) >= 1;
+      }
+      line = next;
+    }
+
+    TestResource resource;
+    bool found;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = resources_.find(target);
+      found = it != resources_.end();
+      if (found) resource = it->second;
+    }
+    if (!found) {
+      const char response[] =
+          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      if (!SendAll(fd, response, sizeof(response) - 1)) break;
+      continue;
+    }
+
+    uint64_t size = resource.body.size();
+    std::string status = "200 OK";
+    std::string extra;
+    if (has_range && resource.ranges) {
+      if (first >= size) {
+        std::string response =
+            "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" +
+            std::to_string(size) + "\r\nContent-Length: 0\r\n\r\n";
+        if (!SendAll(fd, response.data(), response.size())) break;
+        continue;
+      }
+      last = std::min<unsigned long long>(last, size - 1);
+      status = "206 Partial Content";
+      extra = "Content-Range: bytes " + std::to_string(first) + "-" +
+              std::to_string(last) + "/" + std::to_string(size) + "\r\n";
+    } else {
+      first = 0;
+      last = size - 1;
+    }
+    size_t length = size == 0 ? 0 : static_cast<size_t>(last - first + 1);
+
+    std::string response = "HTTP/1.1 " + status +
+                           "\r\nContent-Type: " + resource.content_type +
+                           "\r\nContent-Length: " + std::to_string(length) +
+                           "\r\nAccept-Ranges: bytes\r\n" + extra + "\r\n";
+    if (!SendAll(fd, response.data(), response.size())) break;
+    if (std::strcmp(method, "HEAD") == 0) continue;
+
+    size_t send_length = std::min(length, resource.truncate_after);
+    if (!SendBody(fd, resource.body.data() + first, send_length) ||
+        send_length < length) {
+      break;
+    }
+  }
+  close(fd);
+}
+
+bool HttpTestServer::SendBody(int fd, const char* data, size_t length) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  size_t sent = 0;
+  while (sent < length) {
+    uint64_t rate = bytes_per_second_;
+    size_t piece = std::min<size_t>(length - sent, 16 * 1024);
+    if (rate != 0) {
+      // Sleep until the bytes sent so far are due at |rate|.
+      auto due = start + std::chrono::microseconds(sent * 1000000 / rate);
+      std::this_thread::sleep_until(due);
+    }
+    if (stopping_ || !SendAll(fd, data + sent, piece)) return false;
+    sent += piece;
+    body_bytes_ += piece;
+  }
+  return true;
+}
+
+TempDirectory::TempDirectory() {
+  const char* root = std::getenv("TMPDIR");
+  std::string pattern =
+      std::string(root ? root : "/tmp") + "/cyrene_test_XXXXXX";
+  std::vector<char> name(pattern.begin(), pattern.end());
+  name.push_back('\0');
+  if (mkdtemp(name.data()) != nullptr) path_ = name.data();
+}
+
+TempDirectory::~TempDirectory() {
+  if (path_.empty()) return;
+  std::error_code error;
+  std::filesystem::remove_all(path_, error);
+}
+
+}  // namespace testing
+}  // namespace cyrene
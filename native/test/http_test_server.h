@@ -0,0 +1,96 @@
+#ifndef CYRENE_NATIVE_TEST_HTTP_TEST_SERVER_H_
+#define CYRENE_NATIVE_TEST_HTTP_TEST_SERVER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cyrene {
+namespace testing {
+
+// A resource served by HttpTestServer.
+struct TestResource {
+  std::string body;
+  std::string content_type = "audio/mpeg";
+  // Whether Range requests are honoured; if not, every GET gets a 200 with
+  // the whole body, as some CDNs do.
+  bool ranges = true;
+  // Stop after this many body bytes of each response and close the
+  // connection, while still announcing the full length.
+  size_t truncate_after = static_cast<size_t>(-1);
+};
+
+// Stand-in for a music CDN on 127.0.0.1, for tests and benchmarks of the
+// code that fetches from upstream (loopback proxy, cache ingest, download
+// engine). HTTP/1.1 with keep-alive, single-range GETs and HEADs; anything
+// unknown is a 404. Each connection is served on its own thread and can be
+// throttled to a fixed rate.
+class HttpTestServer {
+ public:
+  HttpTestServer();
+  ~HttpTestServer();
+
+  HttpTestServer(const HttpTestServer&) = delete;
+  HttpTestServer& operator=(const HttpTestServer&) = delete;
+
+  bool Start();
+  void Stop();
+
+  uint16_t port() const { return port_; }
+
+  // "http://127.0.0.1:<port><path>".
+  std::string Url(const std::string& path) const;
+
+  // Thread-safe; later requests see the new resource.
+  void Put(const std::string& path, TestResource resource);
+
+  // Per-connection body rate; 0 (the default) is unthrottled.
+  void set_bytes_per_second(uint64_t rate) { bytes_per_second_ = rate; }
+
+  // Totals since Start(), over every connection.
+  int requests() const { return requests_; }
+  uint64_t body_bytes() const { return body_bytes_; }
+
+ private:
+  void AcceptLoop();
+  void Serve(int fd);
+  bool SendBody(int fd, const char* data, size_t length);
+
+  int listen_fd_;
+  uint16_t port_;
+  std::atomic<bool> stopping_;
+  std::atomic<uint64_t> bytes_per_second_;
+  std::atomic<int> requests_;
+  std::atomic<uint64_t> body_bytes_;
+  std::thread accept_thread_;
+
+  std::mutex mutex_;
+  std::map<std::string, TestResource> resources_;
+  std::vector<std::thread> connections_;
+  std::vector<int> connection_fds_;
+};
+
+// A fresh directory under $TMPDIR, removed with its contents on destruction.
+class TempDirectory {
+ public:
+  TempDirectory();
+  ~TempDirectory();
+
+  TempDirectory(const TempDirectory&) = delete;
+  TempDirectory& operator=(const TempDirectory&) = delete;
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+}  // namespace testing
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_TEST_HTTP_TEST_SERVER_H_
@@ -0,0 +1,134 @@
+#include "lyric_parser.h"
+
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+namespace cyrene {
+namespace {
+
+// Every line's words must be valid ranges that concatenate to its text; the
+// Dart side decodes the arrays under that assumption.
+void ExpectConsistent(const LyricDocument& document) {
+  ASSERT_EQ(document.word_index.size(), document.size() + 1);
+  for (size_t line = 0; line < document.size(); ++line) {
+    int32_t first = document.word_index[line];
+    int32_t last = document.word_index[line + 1];
+    if (first == last) continue;
+    std::string joined;
+    for (int32_t w = first; w < last; ++w) {
+      int32_t begin = document.word_ranges[2 * w];
+      int32_t end = document.word_ranges[2 * w + 1];
+      ASSERT_LE(begin, end) << "line " << line << " word " << w;
+      joined += document.text.substr(begin, end - begin);
+    }
+    EXPECT_EQ(joined, document.LineText(line)) << "line " << line;
+  }
+}
+
+std::vector<std::string> Words(const LyricDocument& document, size_t line) {
+  std::vector<std::string> words;
+  for (int32_t w = document.word_index[line];
+       w < document.word_index[line + 1]; ++w) {
+    int32_t begin = document.word_ranges[2 * w];
+    words.push_back(document.text.substr(
+        begin, document.word_ranges[2 * w + 1] - begin));
+  }
+  return words;
+}
+
+TEST(LyricParserTest, Lrc) {
+  LyricDocument document = ParseLyrics(
+      "\xEF\xBB\xBF[ar:Artist]\r\n"
+      "[00:01.50]first\r\n"
+      "[00:03.00][00:10.25]chorus\n"
+      "[00:05:10]  padded \xE3\x80\x80\n"
+      "[00:07]\n"
+      "{\"t\":0,\"c\":[]}\n");
+  ASSERT_EQ(document.size(), 4u);
+  EXPECT_EQ(document.start_ms[0], 1500);
+  EXPECT_EQ(document.LineText(0), "first");
+  EXPECT_EQ(document.start_ms[1], 3000);
+  EXPECT_EQ(document.LineText(1), "chorus");
+  EXPECT_EQ(document.start_ms[2], 5100);
+  EXPECT_EQ(document.LineText(2), "padded");
+  EXPECT_EQ(document.start_ms[3], 10250);
+  EXPECT_EQ(document.LineText(3), "chorus");
+  EXPECT_EQ(document.word_count(), 0u);
+}
+
+TEST(LyricParserTest, TranslationsJoinByTime) {
+  LyricDocument document =
+      ParseLyrics("[00:01.00]one\n[00:02.00]two\n[00:03.00]three\n",
+                  "[00:02.00]zwei\n[00:03.00]drei\n[00:09.00]orphan\n");
+  ASSERT_EQ(document.size(), 3u);
+  EXPECT_EQ(document.Translation(0), "");
+  EXPECT_EQ(document.Translation(1), "zwei");
+  EXPECT_EQ(document.Translation(2), "drei");
+}
+
+TEST(LyricParserTest, YrcAndQrcWords) {
+  LyricDocument yrc = ParseLyrics(
+      "[1000,900](1000,300,0)Hel(1300,300,0)lo (1600,300,0)you\n");
+  ASSERT_EQ(yrc.size(), 1u);
+  EXPECT_EQ(yrc.LineText(0), "Hello you");
+  EXPECT_EQ(Words(yrc, 0), (std::vector<std::string>{"Hel", "lo ", "you"}));
+  EXPECT_EQ(yrc.word_times[2], 1300);
+  EXPECT_EQ(yrc.word_times[3], 300);
+  ExpectConsistent(yrc);
+
+  LyricDocument qrc =
+      ParseLyrics("[1000,900]Hel(1000,300)lo (1300,300)you(1600,300)\n");
+  ASSERT_EQ(qrc.size(), 1u);
+  EXPECT_EQ(qrc.LineText(0), "Hello you");
+  EXPECT_EQ(Words(qrc, 0), (std::vector<std::string>{"Hel", "lo ", "you"}));
+  ExpectConsistent(qrc);
+}
+
+TEST(LyricParserTest, BlankEdgeWordsAreDropped) {
+  // Regression: trimming across the outer words used to leave the first
+  // word of the first line as the range 2..1 and the last word of the
+  // second as 3..2.
+  LyricDocument document = ParseLyrics(
+      "[0,1000](0,10,0) (10,10,0) word(20,10,0)x\n"
+      "[2000,1000](0,10,0)ab(10,10,0) (20,10,0) \n"
+      "[4000,1000](0,10,0) (10,10,0)\xE3\x80\x80\n"
+      "[6000,1000](0,10,0)  a  (10,10,0)b(20,10,0)  c \n");
+  ExpectConsistent(document);
+  ASSERT_EQ(document.size(), 3u);
+
+  EXPECT_EQ(document.LineText(0), "wordx");
+  EXPECT_EQ(Words(document, 0), (std::vector<std::string>{"word", "x"}));
+  EXPECT_EQ(document.word_times[0], 10);  // The blank word's timing is gone.
+
+  EXPECT_EQ(document.LineText(1), "ab");
+  EXPECT_EQ(Words(document, 1), (std::vector<std::string>{"ab"}));
+
+  // The all-blank line is skipped; inner spaces are kept.
+  EXPECT_EQ(document.start_ms[2], 6000);
+  EXPECT_EQ(document.LineText(2), "a  b  c");
+  EXPECT_EQ(Words(document, 2),
+            (std::vector<std::string>{"a  ", "b", "  c"}));
+}
+
+TEST(LyricParserTest, LineAtWithAndWithoutHint) {
+  LyricDocument document =
+      ParseLyrics("[00:01.00]a\n[00:02.00]b\n[00:03.00]c\n[00:04.00]d\n");
+  EXPECT_EQ(document.LineAt(0), -1);
+  EXPECT_EQ(document.LineAt(999), -1);
+  EXPECT_EQ(document.LineAt(1000), 0);
+  EXPECT_EQ(document.LineAt(3999), 2);
+  EXPECT_EQ(document.LineAt(100000), 3);
+
+  // The hint is only a shortcut: stale or wrong hints give the same answer.
+  for (int hint = -1; hint < 6; ++hint) {
+    for (int64_t position : {500, 1000, 1500, 2000, 2999, 3500, 9000}) {
+      EXPECT_EQ(document.LineAt(position, hint), document.LineAt(position))
+          << "hint " << hint << " position " << position;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace cyrene
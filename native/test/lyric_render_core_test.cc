@@ -0,0 +1,149 @@
+#include "lyric_render_core.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <gtest/gtest.h>
+
+// Counts heap allocations so the steady-state redraw path can be checked
+// to make none.
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  ++g_allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace cyrene {
+namespace {
+
+GlyphKey Key(const std::string& text, float size = 32) {
+  GlyphKey key;
+  key.text = text;
+  key.font_family = "Sans";
+  key.font_size = size;
+  key.stroke_width = 2;
+  return key;
+}
+
+TEST(GlyphCacheTest, HitsReuseTheBuiltValue) {
+  GlyphCache<int> cache(4);
+  int built = 0;
+  auto build = [&] { return ++built; };
+
+  EXPECT_EQ(cache.Get(Key("line one"), build), 1);
+  EXPECT_EQ(cache.Get(Key("line two"), build), 2);
+  EXPECT_EQ(cache.Get(Key("line one"), build), 1);
+  EXPECT_EQ(cache.Get(Key("line one", 40), build), 3);  // Shape changed.
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.builds(), 3u);
+  EXPECT_EQ(cache.size(), 3u);
+}
+
+TEST(GlyphCacheTest, EvictsLeastRecentlyUsed) {
+  GlyphCache<int> cache(2);
+  int built = 0;
+  auto build = [&] { return ++built; };
+
+  cache.Get(Key("a"), build);
+  cache.Get(Key("b"), build);
+  cache.Get(Key("a"), build);  // "b" is now the oldest.
+  cache.Get(Key("c"), build);
+  EXPECT_EQ(cache.evictions(), 1u);
+  EXPECT_EQ(cache.Get(Key("a"), build), 1);
+  EXPECT_EQ(cache.Get(Key("b"), build), 4);  // Rebuilt.
+}
+
+TEST(DirtyTrackerTest, ResetDirtiesTheWholeSurface) {
+  DirtyTracker dirty;
+  dirty.Reset(800, 100);
+  EXPECT_EQ(dirty.Take(), (LyricRect{0, 0, 800, 100}));
+  EXPECT_FALSE(dirty.HasDirty());
+}
+
+TEST(DirtyTrackerTest, UnchangedContentIsClean) {
+  DirtyTracker dirty;
+  dirty.Reset(800, 100);
+  dirty.SetContent({10, 10, 200, 60}, Key("hello"));
+  dirty.Take();
+
+  dirty.SetContent({10, 10, 200, 60}, Key("hello"));
+  EXPECT_FALSE(dirty.HasDirty());
+}
+
+TEST(DirtyTrackerTest, NewLineWithSameBoundsIsRepainted) {
+  DirtyTracker dirty;
+  dirty.Reset(800, 100);
+  dirty.SetContent({10, 10, 200, 60}, Key("hello"));
+  dirty.Take();
+
+  dirty.SetContent({10, 10, 200, 60}, Key("world"));
+  EXPECT_EQ(dirty.Take(), (LyricRect{10, 10, 200, 60}));
+}
+
+TEST(DirtyTrackerTest, MovedContentDirtiesOldAndNewBounds) {
+  DirtyTracker dirty;
+  dirty.Reset(800, 100);
+  dirty.SetContent({10, 10, 200, 60}, Key("short"));
+  dirty.Take();
+
+  dirty.SetContent({5, 20, 400, 70}, Key("a longer line"));
+  EXPECT_EQ(dirty.Take(), (LyricRect{5, 10, 400, 70}));
+
+  dirty.SetContent({}, GlyphKey());  // Cleared.
+  EXPECT_EQ(dirty.Take(), (LyricRect{5, 20, 400, 70}));
+}
+
+TEST(DirtyTrackerTest, InvalidationsAccumulateAndClipToSurface) {
+  DirtyTracker dirty;
+  dirty.Reset(800, 100);
+  dirty.SetContent({10, 10, 200, 60}, Key("hello"));
+  dirty.Take();
+
+  dirty.InvalidateContent();
+  EXPECT_EQ(dirty.Take(), (LyricRect{10, 10, 200, 60}));
+
+  dirty.Invalidate({-5, 20, 8, 30});
+  dirty.Invalidate({790, 40, 900, 50});
+  EXPECT_EQ(dirty.Take(), (LyricRect{0, 20, 800, 50}));
+
+  dirty.InvalidateAll();
+  EXPECT_EQ(dirty.Take(), (LyricRect{0, 0, 800, 100}));
+}
+
+// A karaoke frame on an unchanged line: cache hit, same content, a small
+// highlight strip. None of it should touch the heap.
+TEST(LyricRenderCoreTest, SteadyStateFrameDoesNotAllocate) {
+  GlyphCache<LyricRect> cache(8);
+  DirtyTracker dirty;
+  FrameStats stats;
+  dirty.Reset(800, 100);
+  GlyphKey key = Key("a line that is being sung");
+  LyricRect bounds =
+      cache.Get(key, [] { return LyricRect{10, 10, 600, 60}; });
+  dirty.SetContent(bounds, key);
+  dirty.Take();
+
+  uint64_t before = g_allocations;
+  for (int x = 10; x < 600; ++x) {
+    ScopedFrameTimer timer(&stats);
+    const LyricRect& content =
+        cache.Get(key, [] { return LyricRect{0, 0, 1, 1}; });
+    dirty.SetContent(content, key);
+    dirty.Invalidate({x - 1, content.top, x + 1, content.bottom});
+    ASSERT_FALSE(dirty.Take().empty());
+  }
+  EXPECT_EQ(g_allocations - before, 0u);
+  EXPECT_EQ(cache.builds(), 1u);
+  EXPECT_EQ(stats.frames(), 590u);
+}
+
+}  // namespace
+}  // namespace cyrene
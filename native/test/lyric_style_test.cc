@@ -0,0 +1,182 @@
+#include "lyric_style.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lyric_render_core.h"
+
+namespace cyrene {
+namespace {
+
+// The parts of a runner's DesktopLyricWindow that react to style changes,
+// over the portable core: ApplyStyle() mirrors the runners', and every
+// frame that finds something dirty counts as a redraw.
+class FakeLyricWindow {
+ public:
+  FakeLyricWindow() : glyphs_(8) {
+    dirty_.Reset(800, 100);
+    Frame();
+    redraws_ = 0;
+  }
+
+  void ApplyStyle(const LyricStyleUpdate& update) {
+    LyricRedraw redraw = ApplyLyricStyle(update, &style_);
+    if (redraw == LyricRedraw::kNone) return;
+    dirty_.InvalidateContent();
+    Frame();
+  }
+
+  // Plugin side: decode the "applyStyle" message, as the method handler does.
+  bool OnApplyStyle(const std::vector<uint8_t>& message) {
+    LyricStyleUpdate update;
+    if (!DecodeLyricStyle(message.data(), message.size(), &update)) {
+      return false;
+    }
+    ApplyStyle(update);
+    return true;
+  }
+
+  int redraws() const { return redraws_; }
+  uint64_t layouts() const { return glyphs_.builds(); }
+  const LyricStyle& style() const { return style_; }
+
+ private:
+  void Frame() {
+    GlyphKey key;
+    key.text = "lyric";
+    key.font_size = static_cast<float>(style_.font_size);
+    key.stroke_width = static_cast<float>(style_.stroke_width);
+    const LyricRect& bounds = glyphs_.Get(key, [this] {
+      return LyricRect{0, 0, style_.font_size * 5, style_.font_size};
+    });
+    dirty_.SetContent(bounds, key);
+    if (dirty_.HasDirty()) {
+      dirty_.Take();
+      ++redraws_;
+    }
+  }
+
+  LyricStyle style_;
+  GlyphCache<LyricRect> glyphs_;
+  DirtyTracker dirty_;
+  int redraws_ = 0;
+};
+
+LyricStyleUpdate Theme() {
+  LyricStyleUpdate update;
+  update.fields = kLyricStyleFontSize | kLyricStyleTextColor |
+                  kLyricStyleStrokeColor | kLyricStyleStrokeWidth |
+                  kLyricStyleHighlightColor;
+  update.values.font_size = 40;
+  update.values.text_color = 0xFFFFEE00;
+  update.values.stroke_color = 0xFF202020;
+  update.values.stroke_width = 3;
+  update.values.highlight_color = 0xFFFF4081;
+  return update;
+}
+
+TEST(LyricStyleTest, EncodeDecodeRoundTrip) {
+  LyricStyleUpdate update = Theme();
+  update.fields |= kLyricStyleMouseTransparent;
+  update.values.mouse_transparent = true;
+
+  std::vector<uint8_t> encoded = EncodeLyricStyle(update);
+  EXPECT_EQ(encoded.size(), 3u + 5 * 4 + 1);
+
+  LyricStyleUpdate decoded;
+  ASSERT_TRUE(DecodeLyricStyle(encoded.data(), encoded.size(), &decoded));
+  EXPECT_EQ(decoded.fields, update.fields);
+  EXPECT_EQ(decoded.values.font_size, 40);
+  EXPECT_EQ(decoded.values.text_color, 0xFFFFEE00u);
+  EXPECT_EQ(decoded.values.stroke_color, 0xFF202020u);
+  EXPECT_EQ(decoded.values.stroke_width, 3);
+  EXPECT_EQ(decoded.values.highlight_color, 0xFFFF4081u);
+  EXPECT_TRUE(decoded.values.mouse_transparent);
+}
+
+TEST(LyricStyleTest, RejectsMalformedMessages) {
+  std::vector<uint8_t> encoded = EncodeLyricStyle(Theme());
+  LyricStyleUpdate update;
+
+  std::vector<uint8_t> truncated(encoded.begin(), encoded.end() - 1);
+  EXPECT_FALSE(DecodeLyricStyle(truncated.data(), truncated.size(), &update));
+
+  std::vector<uint8_t> padded = encoded;
+  padded.push_back(0);
+  EXPECT_FALSE(DecodeLyricStyle(padded.data(), padded.size(), &update));
+
+  std::vector<uint8_t> version = encoded;
+  version[0] = 2;
+  EXPECT_FALSE(DecodeLyricStyle(version.data(), version.size(), &update));
+
+  const uint8_t unknown_field[] = {1, 0x80, 0x00};
+  EXPECT_FALSE(DecodeLyricStyle(unknown_field, sizeof(unknown_field),
+                                &update));
+  EXPECT_FALSE(DecodeLyricStyle(encoded.data(), 2, &update));
+}
+
+TEST(LyricStyleTest, RedrawLevels) {
+  LyricStyle style;
+  LyricStyleUpdate update;
+
+  update.fields = kLyricStyleTextColor | kLyricStyleHighlightColor;
+  update.values.text_color = 0xFF00FF00;
+  update.values.highlight_color = style.highlight_color;  // Unchanged.
+  EXPECT_EQ(ApplyLyricStyle(update, &style), LyricRedraw::kRepaint);
+  EXPECT_EQ(ApplyLyricStyle(update, &style), LyricRedraw::kNone);
+
+  update.fields |= kLyricStyleStrokeWidth;
+  update.values.stroke_width = 5;
+  EXPECT_EQ(ApplyLyricStyle(update, &style), LyricRedraw::kRelayout);
+
+  update.fields = kLyricStyleDraggable | kLyricStyleMouseTransparent;
+  update.values.draggable = false;
+  update.values.mouse_transparent = true;
+  EXPECT_EQ(ApplyLyricStyle(update, &style), LyricRedraw::kNone);
+  EXPECT_FALSE(style.draggable);
+  EXPECT_TRUE(style.mouse_transparent);
+}
+
+TEST(LyricStyleTest, ThemeAppliedInOneMessageRedrawsOnce) {
+  FakeLyricWindow window;
+  ASSERT_TRUE(window.OnApplyStyle(EncodeLyricStyle(Theme())));
+  EXPECT_EQ(window.redraws(), 1);
+  EXPECT_EQ(window.layouts(), 2u);  // Initial layout plus the new size.
+  EXPECT_EQ(window.style().font_size, 40);
+  EXPECT_EQ(window.style().highlight_color, 0xFFFF4081u);
+
+  // Re-applying the same theme changes nothing and draws nothing.
+  ASSERT_TRUE(window.OnApplyStyle(EncodeLyricStyle(Theme())));
+  EXPECT_EQ(window.redraws(), 1);
+}
+
+TEST(LyricStyleTest, PerPropertyCallsRedrawEachTime) {
+  // The old protocol, one setter per property, for comparison.
+  FakeLyricWindow window;
+  LyricStyleUpdate theme = Theme();
+  for (uint16_t field = 1; field <= kLyricStyleHighlightColor; field <<= 1) {
+    LyricStyleUpdate single;
+    single.fields = field;
+    single.values = theme.values;
+    window.ApplyStyle(single);
+  }
+  EXPECT_EQ(window.redraws(), 5);
+  EXPECT_EQ(window.layouts(), 3u);
+}
+
+TEST(LyricStyleTest, BehaviourOnlyChangesDoNotRedraw) {
+  FakeLyricWindow window;
+  LyricStyleUpdate update;
+  update.fields = kLyricStyleDraggable | kLyricStyleMouseTransparent;
+  update.values.draggable = false;
+  update.values.mouse_transparent = true;
+  ASSERT_TRUE(window.OnApplyStyle(EncodeLyricStyle(update)));
+  EXPECT_EQ(window.redraws(), 0);
+  EXPECT_TRUE(window.style().mouse_transparent);
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,187 @@
+#include "lyric_timeline.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cyrene {
+namespace {
+
+using std::chrono::milliseconds;
+
+LyricTimelineLine Line(int64_t start_ms, const std::string& text,
+                       std::vector<LyricWord> words = {}) {
+  LyricTimelineLine line;
+  line.start_ms = start_ms;
+  line.text = text;
+  line.words = std::move(words);
+  return line;
+}
+
+TEST(LyricTimelineTest, LineBoundaries) {
+  LyricTimeline timeline;
+  // Out of order on purpose: lines are sorted by start time.
+  timeline.SetLines({Line(5000, "second"), Line(1000, "first"),
+                     Line(9000, "third")});
+
+  EXPECT_EQ(timeline.LineAt(0), -1);
+  EXPECT_EQ(timeline.LineAt(999), -1);
+  EXPECT_EQ(timeline.LineAt(1000), 0);
+  EXPECT_EQ(timeline.LineAt(4999), 0);
+  EXPECT_EQ(timeline.LineAt(5000), 1);
+  EXPECT_EQ(timeline.LineAt(9000), 2);
+  EXPECT_EQ(timeline.LineAt(1 << 30), 2);
+  EXPECT_EQ(timeline.line(1).text, "second");
+
+  EXPECT_EQ(timeline.FrameAt(999), (KaraokeFrame{-1, 0}));
+  EXPECT_EQ(timeline.FrameAt(1000).line, 0);
+  EXPECT_EQ(timeline.FrameAt(1000).progress, 0);
+}
+
+TEST(LyricTimelineTest, WordBoundaries) {
+  LyricTimeline timeline;
+  // "ab" 0-1000, a 200 ms gap, then "cd" 1200-2200.
+  timeline.SetLines({Line(0, "abcd", {{0, 1000, "ab"}, {1200, 1000, "cd"}}),
+                     Line(5000, "next")});
+
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(0).progress, 0);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(500).progress, 0.25);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(999).progress, 0.4995);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1000).progress, 0.5);
+  // Between words the finished word stays fully sung.
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1199).progress, 0.5);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1200).progress, 0.5);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1700).progress, 0.75);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(2200).progress, 1);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(4999).progress, 1);
+  EXPECT_EQ(timeline.FrameAt(5000), (KaraokeFrame{1, 0}));
+}
+
+TEST(LyricTimelineTest, ProgressCountsCodePoints) {
+  LyricTimeline timeline;
+  // Three characters, nine bytes: the first word is one third of the line.
+  const std::string ni = "\xE4\xBD\xA0";
+  const std::string hao_ma = "\xE5\xA5\xBD\xE5\x90\x97";
+  timeline.SetLines(
+      {Line(0, ni + hao_ma, {{0, 100, ni}, {100, 200, hao_ma}})});
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(100).progress, 1.0 / 3);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(200).progress, 2.0 / 3);
+}
+
+TEST(LyricTimelineTest, UntimedLinesSweepUntilTheNextLine) {
+  LyricTimeline timeline;
+  timeline.SetLines({Line(1000, "abcd"), Line(2000, "ab"),
+                     Line(60000, "last")});
+
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1500).progress, 0.5);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(1999).progress, 0.999);
+  // Two characters before a long gap: the sweep is capped at
+  // kMaxMsPerCharacter each instead of stretching over the gap.
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(2000).progress, 0);
+  EXPECT_DOUBLE_EQ(
+      timeline.FrameAt(2000 + LyricTimeline::kMaxMsPerCharacter).progress,
+      0.5);
+  EXPECT_DOUBLE_EQ(
+      timeline.FrameAt(2000 + 2 * LyricTimeline::kMaxMsPerCharacter).progress,
+      1);
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(30000).progress, 1);
+}
+
+TEST(LyricTimelineTest, WordsNotCoveringTheTextFallBackToSweep) {
+  LyricTimeline timeline;
+  timeline.SetLines(
+      {Line(0, "abcd", {{0, 100, "ab"}}), Line(1000, "next")});
+  // With the words used, 100 ms would be half the line.
+  EXPECT_DOUBLE_EQ(timeline.FrameAt(100).progress, 0.1);
+}
+
+TEST(LyricTimelineTest, EmptyLineIsComplete) {
+  LyricTimeline timeline;
+  timeline.SetLines({Line(0, ""), Line(1000, "x")});
+  EXPECT_EQ(timeline.FrameAt(10), (KaraokeFrame{0, 1}));
+}
+
+class LyricClockTest : public ::testing::Test {
+ protected:
+  LyricClock::Clock::time_point At(int64_t ms) {
+    return t0_ + milliseconds(ms);
+  }
+
+  LyricClock clock_;
+  const LyricClock::Clock::time_point t0_ = LyricClock::Clock::now();
+};
+
+TEST_F(LyricClockTest, InterpolatesBetweenReports) {
+  clock_.Sync(10000, true, At(0));
+  EXPECT_EQ(clock_.PositionAt(At(0)), 10000);
+  EXPECT_EQ(clock_.PositionAt(At(16)), 10016);
+  EXPECT_EQ(clock_.PositionAt(At(250)), 10250);
+
+  // An exact report changes nothing.
+  clock_.Sync(10500, true, At(500));
+  EXPECT_EQ(clock_.PositionAt(At(600)), 10600);
+}
+
+TEST_F(LyricClockTest, HoldsWhilePaused) {
+  clock_.Sync(10000, true, At(0));
+  clock_.Sync(10300, false, At(300));
+  EXPECT_EQ(clock_.PositionAt(At(300)), 10300);
+  EXPECT_EQ(clock_.PositionAt(At(5000)), 10300);
+  EXPECT_FALSE(clock_.playing());
+
+  // Resuming restarts interpolation from the reported position.
+  clock_.Sync(10300, true, At(6000));
+  EXPECT_EQ(clock_.PositionAt(At(6100)), 10400);
+}
+
+TEST_F(LyricClockTest, SmallBackwardCorrectionHolds) {
+  clock_.Sync(10000, true, At(0));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 11000);
+
+  // The player reports 150 ms less than predicted: hold at 11000 until the
+  // clock catches up instead of jumping back.
+  clock_.Sync(10850, true, At(1000));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 11000);
+  EXPECT_EQ(clock_.PositionAt(At(1100)), 11000);
+  EXPECT_EQ(clock_.PositionAt(At(1150)), 11000);
+  EXPECT_EQ(clock_.PositionAt(At(1200)), 11050);
+}
+
+TEST_F(LyricClockTest, BackwardSeekThreshold) {
+  const int64_t threshold = LyricClock::kSeekThresholdMs;
+
+  // Exactly at the threshold: still drift, held.
+  clock_.Sync(10000, true, At(0));
+  clock_.Sync(11000 - threshold, true, At(1000));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 11000);
+
+  // Just above it: a seek, applied at once.
+  LyricClock seeking;
+  seeking.Sync(10000, true, At(0));
+  seeking.Sync(11000 - threshold - 1, true, At(1000));
+  EXPECT_EQ(seeking.PositionAt(At(1000)), 11000 - threshold - 1);
+  EXPECT_EQ(seeking.PositionAt(At(1010)), 11010 - threshold - 1);
+}
+
+TEST_F(LyricClockTest, ForwardCorrectionsApplyAtOnce) {
+  const int64_t threshold = LyricClock::kSeekThresholdMs;
+  clock_.Sync(10000, true, At(0));
+  clock_.Sync(11000 + threshold, true, At(1000));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 11000 + threshold);
+
+  clock_.Sync(11000 + 3 * threshold + 1, true, At(1000));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 11000 + 3 * threshold + 1);
+}
+
+TEST_F(LyricClockTest, FarBackwardSeek) {
+  clock_.Sync(120000, true, At(0));
+  clock_.PositionAt(At(1000));
+  clock_.Sync(5000, true, At(1000));
+  EXPECT_EQ(clock_.PositionAt(At(1000)), 5000);
+  EXPECT_EQ(clock_.PositionAt(At(1500)), 5500);
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,126 @@
+#include "prefetch_scheduler.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "http_test_server.h"
+
+namespace cyrene {
+namespace {
+
+using testing::TempDirectory;
+
+constexpr uint64_t kMiB = 1024 * 1024;
+
+// Schedules against a segment cache with a fetcher that "downloads"
+// instantly: resources are known by URL and their segments written
+// straight into the entry.
+class PrefetchSchedulerTest : public ::testing::Test {
+ protected:
+  PrefetchSchedulerTest()
+      : cache_(directory_.path(), 0),
+        scheduler_(&cache_, [this](const std::shared_ptr<SegmentEntry>& entry,
+                                   const std::string&, uint32_t first,
+                                   uint32_t last) {
+          Fetch(entry, first, last);
+        }) {
+    sizes_["http://cdn/a"] = 3 * kMiB;
+    sizes_["http://cdn/b"] = 3 * kMiB + 1000;
+    sizes_["http://cdn/c"] = 2 * kMiB;
+    scheduler_.Start();
+  }
+
+  void Fetch(const std::shared_ptr<SegmentEntry>& entry, uint32_t first,
+             uint32_t last) {
+    uint64_t size = sizes_.at(entry->url());
+    entry->SetTotalSize(size, "audio/flac");
+    std::vector<uint8_t> data(kSegmentSize, 0x5a);
+    for (uint32_t i = first; i < last && i < entry->segment_count(); ++i) {
+      uint64_t offset = static_cast<uint64_t>(i) * kSegmentSize;
+      entry->WriteSegment(i, data.data(),
+                          std::min<uint64_t>(kSegmentSize, size - offset));
+    }
+    entry->ClearPending(first, last);
+  }
+
+  static PrefetchRequest Request(const std::string& name,
+                                 uint64_t bytes = 0) {
+    return PrefetchRequest{name, "http://cdn/" + name, "netease", bytes};
+  }
+
+  uint64_t Stored(const std::string& key) {
+    auto entry = cache_.Acquire(key, false);
+    return entry ? entry->stored_bytes() : 0;
+  }
+
+  // Waits for the cache to hold |total| bytes, then a little longer so that
+  // anything fetched beyond it shows up in the checks. Waiting for a quiet
+  // period instead returned early when the scheduler thread was slow to
+  // start on a loaded machine.
+  void Settle(uint64_t total) {
+    for (int i = 0; i < 1000; ++i) {
+      cache_.Trim();  // Refreshes usage().
+      if (cache_.usage() >= total) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  TempDirectory directory_;
+  SegmentCache cache_;
+  std::map<std::string, uint64_t> sizes_;
+  PrefetchScheduler scheduler_;
+};
+
+TEST_F(PrefetchSchedulerTest, WholeTracksAreCutAtMaxBytes) {
+  scheduler_.SetLimits(2, 0, 4 * kMiB);
+  scheduler_.SetRequests({Request("a"), Request("b"), Request("c")});
+  Settle(4 * kMiB);
+  // "a" first, "b" gets the rest, nothing is left for "c".
+  EXPECT_EQ(Stored("a"), 3 * kMiB);
+  EXPECT_EQ(Stored("b"), 1 * kMiB);
+  EXPECT_EQ(Stored("c"), 0u);
+
+  // A new order hands the budget to "c" first; "b" keeps what it has.
+  scheduler_.SetRequests({Request("c"), Request("b")});
+  Settle(7 * kMiB);  // "a" stays in the cache.
+  EXPECT_EQ(Stored("c"), 2 * kMiB);
+  EXPECT_EQ(Stored("b"), 2 * kMiB);
+
+  // Lifting the cap lets the capped request finish.
+  scheduler_.SetLimits(2, 0, 0);
+  Settle(5 * kMiB + sizes_["http://cdn/b"]);
+  EXPECT_EQ(Stored("b"), sizes_["http://cdn/b"]);
+}
+
+TEST_F(PrefetchSchedulerTest, PrefixesCountTheirOwnSize) {
+  scheduler_.SetLimits(2, 0, 2 * kMiB);
+  scheduler_.SetRequests(
+      {Request("a", kMiB), Request("b", kMiB / 2), Request("c", kMiB)});
+  Settle(2 * kMiB);
+  EXPECT_EQ(Stored("a"), kMiB);
+  EXPECT_EQ(Stored("b"), kMiB / 2);
+  EXPECT_EQ(Stored("c"), kMiB / 2);
+}
+
+TEST_F(PrefetchSchedulerTest, PrefetchedEntriesAreEvictedBeforePlayedOnes) {
+  scheduler_.SetLimits(2, 0, 0);
+  scheduler_.SetRequests({Request("a"), Request("c")});
+  Settle(5 * kMiB);
+  {
+    // The user plays "a", the guess "c" never is.
+    auto played = cache_.Acquire("a");
+  }
+  scheduler_.SetRequests({});
+  cache_.SetLimit(4 * kMiB);
+  EXPECT_EQ(Stored("a"), 3 * kMiB);
+  EXPECT_FALSE(cache_.Acquire("c", false));
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,97 @@
+#include "search_index.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "icu_loader.h"
+
+namespace cyrene {
+namespace {
+
+std::vector<std::string> Keys(const std::vector<IndexHit>& hits) {
+  std::vector<std::string> keys;
+  for (const IndexHit& hit : hits) keys.push_back(hit.key);
+  return keys;
+}
+
+class SearchIndexTest : public ::testing::Test {
+ protected:
+  void Put(const std::string& key, const std::string& title,
+           const std::string& artists = "", const std::string& album = "") {
+    index_.Put(key, IndexEntry{title, artists, album});
+  }
+
+  std::vector<std::string> Search(const std::string& query) {
+    return Keys(index_.Search(query, 10));
+  }
+
+  SearchIndex index_;
+};
+
+TEST_F(SearchIndexTest, ExactBeatsPrefixBeatsTypo) {
+  Put("title", "Title Track");
+  Put("titles", "Titles");
+  Put("tilde", "Tilde");
+  EXPECT_EQ(Search("title"), (std::vector<std::string>{"title", "titles"}));
+  // Swap of neighbours, substitution, deletion and insertion.
+  EXPECT_EQ(Search("ittle"), (std::vector<std::string>{"title"}));
+  EXPECT_EQ(Search("titke"), (std::vector<std::string>{"title"}));
+  EXPECT_EQ(Search("titl track"), (std::vector<std::string>{"title"}));
+  EXPECT_EQ(Search("tiltde"), (std::vector<std::string>{"tilde"}));
+  // A swap for one term, a substitution (d for t) for the other.
+  EXPECT_EQ(Search("tilte"), (std::vector<std::string>{"tilde", "title"}));
+  // Two edits away.
+  EXPECT_TRUE(Search("tlite").empty());
+}
+
+TEST_F(SearchIndexTest, TyposNeedFourLetters) {
+  Put("cat", "Cat");
+  EXPECT_TRUE(Search("cta").empty());
+  // A four-letter token may lose a letter to a three-letter term.
+  EXPECT_EQ(Search("catt"), (std::vector<std::string>{"cat"}));
+  Put("cats", "Cats");
+  EXPECT_EQ(Search("cast"), (std::vector<std::string>{"cats", "cat"}));
+}
+
+TEST_F(SearchIndexTest, TyposSurviveUpdatesAndCompaction) {
+  Put("a", "Yesterday");
+  EXPECT_EQ(Search("yesterdya"), (std::vector<std::string>{"a"}));
+  index_.Remove("a");
+  EXPECT_TRUE(Search("yesterdya").empty());
+
+  for (int i = 0; i < 3000; ++i) {
+    Put("k" + std::to_string(i), i % 2 ? "Yesterday" : "Tomorrow");
+  }
+  for (int i = 0; i < 2000; ++i) index_.Remove("k" + std::to_string(i));
+  EXPECT_EQ(index_.size(), 1000u);
+  EXPECT_EQ(index_.Search("yesterdya", 5000).size(), 500u);
+  EXPECT_EQ(index_.Search("tomorow", 5000).size(), 500u);
+}
+
+TEST_F(SearchIndexTest, SingleCharacterQueries) {
+  Put("one", "Track 1");
+  Put("article", "A Day In The Life");
+  Put("zoo", "Zoo Station");
+  EXPECT_EQ(Search("1"), (std::vector<std::string>{"one"}));
+  // The exact term only, not every word starting with the letter.
+  EXPECT_EQ(Search("a"), (std::vector<std::string>{"article"}));
+  // No exact term: its completions.
+  EXPECT_EQ(Search("z"), (std::vector<std::string>{"zoo"}));
+}
+
+TEST_F(SearchIndexTest, HanAndPinyin) {
+  Put("qt", "\xE6\x99\xB4\xE5\xA4\xA9", "\xE5\x91\xA8\xE6\x9D\xB0\xE5\x80\xAB");
+  // 晴, and 周杰伦 in simplified form.
+  EXPECT_EQ(Search("\xE6\x99\xB4"), (std::vector<std::string>{"qt"}));
+  EXPECT_EQ(Search("\xE5\x91\xA8\xE6\x9D\xB0\xE4\xBC\xA6"),
+            (std::vector<std::string>{"qt"}));
+  if (Icu() == nullptr) return;
+  EXPECT_EQ(Search("zhoujielun"), (std::vector<std::string>{"qt"}));
+  EXPECT_EQ(Search("zjl"), (std::vector<std::string>{"qt"}));
+  EXPECT_EQ(Search("qingtian"), (std::vector<std::string>{"qt"}));
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,262 @@
+#include "segment_cache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "http_test_server.h"
+#include "loopback_proxy.h"
+#include "upstream_client.h"
+
+namespace cyrene {
+namespace {
+
+using testing::HttpTestServer;
+using testing::TempDirectory;
+using testing::TestResource;
+
+std::string Body(size_t length, uint8_t seed) {
+  std::string body(length, '\0');
+  for (size_t i = 0; i < length; ++i) {
+    body[i] = static_cast<char>((i * 131 + seed) & 0xff);
+  }
+  return body;
+}
+
+// Caches all of |size| bytes under |key| and releases the entry.
+void Fill(SegmentCache* cache, const std::string& key, uint64_t size,
+          bool prefetch = false) {
+  auto entry = prefetch ? cache->AcquireForPrefetch(key) : cache->Acquire(key);
+  ASSERT_TRUE(entry);
+  ASSERT_TRUE(entry->SetTotalSize(size, "audio/mpeg"));
+  std::string body = Body(static_cast<size_t>(size), 1);
+  for (uint32_t i = 0; i < entry->segment_count(); ++i) {
+    uint64_t offset = static_cast<uint64_t>(i) * kSegmentSize;
+    size_t length = static_cast<size_t>(
+        std::min<uint64_t>(kSegmentSize, size - offset));
+    ASSERT_TRUE(entry->WriteSegment(
+        i, reinterpret_cast<const uint8_t*>(body.data() + offset), length));
+  }
+  EXPECT_EQ(entry->stored_bytes(), size);
+}
+
+bool Exists(const std::string& path) {
+  return access(path.c_str(), F_OK) == 0;
+}
+
+TEST(SegmentCacheTest, TrimEvictsLeastRecentlyUsed) {
+  TempDirectory dir;
+  SegmentCache cache(dir.path(), 0);
+  Fill(&cache, "a", 4 * kSegmentSize);
+  Fill(&cache, "b", 4 * kSegmentSize);
+  Fill(&cache, "c", 4 * kSegmentSize);
+  cache.Acquire("a");  // "b" is now the oldest.
+
+  cache.Trim();
+  EXPECT_EQ(cache.usage(), 12u * kSegmentSize);
+
+  cache.SetLimit(9 * kSegmentSize);
+  EXPECT_EQ(cache.usage(), 8u * kSegmentSize);
+  EXPECT_TRUE(Exists(dir.path() + "/a.idx"));
+  EXPECT_FALSE(Exists(dir.path() + "/b.idx"));
+  EXPECT_FALSE(Exists(dir.path() + "/b.seg"));
+  EXPECT_TRUE(Exists(dir.path() + "/c.idx"));
+  EXPECT_FALSE(cache.Acquire("b", false));
+}
+
+TEST(SegmentCacheTest, HeldEntriesAreNeverEvicted) {
+  TempDirectory dir;
+  SegmentCache cache(dir.path(), 0);
+  Fill(&cache, "playing", 4 * kSegmentSize);
+  Fill(&cache, "old", 4 * kSegmentSize);
+  auto playing = cache.Acquire("playing");
+  cache.Acquire("old");
+
+  // Over the limit even with everything idle gone: only "old" can go.
+  cache.SetLimit(kSegmentSize);
+  EXPECT_TRUE(Exists(dir.path() + "/playing.seg"));
+  EXPECT_FALSE(Exists(dir.path() + "/old.seg"));
+  EXPECT_EQ(cache.usage(), 4u * kSegmentSize);
+
+  playing.reset();
+  cache.Trim();
+  EXPECT_FALSE(Exists(dir.path() + "/playing.seg"));
+  EXPECT_EQ(cache.usage(), 0u);
+}
+
+TEST(SegmentCacheTest, ReopenedCacheKeepsUsageAndOrder) {
+  TempDirectory dir;
+  {
+    SegmentCache cache(dir.path(), 0);
+    Fill(&cache, "first", 2 * kSegmentSize);
+    Fill(&cache, "second", 2 * kSegmentSize);
+    // A data file without its index is a leftover and goes at startup.
+    Fill(&cache, "orphan", kSegmentSize);
+  }
+  unlink((dir.path() + "/orphan.idx").c_str());
+
+  SegmentCache reopened(dir.path(), 0);
+  EXPECT_FALSE(Exists(dir.path() + "/orphan.seg"));
+  EXPECT_GE(reopened.usage(), 4u * kSegmentSize);
+
+  reopened.SetLimit(3 * kSegmentSize);
+  EXPECT_FALSE(Exists(dir.path() + "/first.idx"));
+  EXPECT_TRUE(Exists(dir.path() + "/second.idx"));
+  auto second = reopened.Acquire("second", false);
+  ASSERT_TRUE(second);
+  EXPECT_TRUE(second->IsComplete());
+}
+
+TEST(SegmentCacheTest, UnplayedPrefetchesAreEvictedFirst) {
+  TempDirectory dir;
+  {
+    SegmentCache cache(dir.path(), 0);
+    Fill(&cache, "played", 4 * kSegmentSize);
+    Fill(&cache, "guess", 4 * kSegmentSize, true);
+    Fill(&cache, "next", 4 * kSegmentSize, true);
+    // Prefetched, then played: an ordinary entry from now on, and
+    // prefetching it again does not change that.
+    cache.Acquire("next");
+    cache.AcquireForPrefetch("next");
+    EXPECT_TRUE(Exists(dir.path() + "/guess.pf"));
+    EXPECT_FALSE(Exists(dir.path() + "/next.pf"));
+  }
+
+  // The marker survives a restart; "guess" goes although it is newer than
+  // "played".
+  SegmentCache cache(dir.path(), 0);
+  cache.SetLimit(9 * kSegmentSize);
+  EXPECT_FALSE(Exists(dir.path() + "/guess.idx"));
+  EXPECT_FALSE(Exists(dir.path() + "/guess.pf"));
+  EXPECT_TRUE(Exists(dir.path() + "/played.idx"));
+  EXPECT_TRUE(Exists(dir.path() + "/next.idx"));
+
+  // Among played entries the order is by recency again.
+  cache.SetLimit(5 * kSegmentSize);
+  EXPECT_FALSE(Exists(dir.path() + "/played.idx"));
+  EXPECT_TRUE(Exists(dir.path() + "/next.idx"));
+}
+
+// The proxy against a stand-in CDN: responses match the upstream body,
+// repeats are served from disk, and the cache stays within its limit.
+class LoopbackProxyTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(server_.Start());
+    proxy_ = std::make_unique<LoopbackProxy>(dir_.path());
+    ASSERT_TRUE(proxy_->Start());
+  }
+
+  void TearDown() override {
+    proxy_.reset();
+    server_.Stop();
+  }
+
+  std::string ProxyUrl(const std::string& key, const std::string& path) {
+    std::string url = server_.Url(path);
+    std::string encoded;
+    for (char c : url) {
+      if (c == ':' || c == '/' || c == '?' || c == '&' || c == '=') {
+        char escape[4];
+        std::snprintf(escape, sizeof(escape), "%%%02X",
+                      static_cast<unsigned char>(c));
+        encoded += escape;
+      } else {
+        encoded += c;
+      }
+    }
+    return "http://127.0.0.1:" + std::to_string(proxy_->port()) +
+           "/proxy?platform=qq&key=" + key + "&url=" + encoded;
+  }
+
+  // GETs |url| through UpstreamClient; returns the status and body.
+  int Get(const std::string& url, std::string* body,
+          const std::string& range = std::string()) {
+    UpstreamClient client;
+    UpstreamClient::Headers headers;
+    if (!range.empty()) headers.emplace_back("Range", range);
+    int status = 0;
+    body->clear();
+    client.Get(
+        url, headers,
+        [&](const UpstreamResponse& response) {
+          status = response.status;
+          return true;
+        },
+        [&](const uint8_t* data, size_t length) {
+          body->append(reinterpret_cast<const char*>(data), length);
+          return true;
+        });
+    return status;
+  }
+
+  TempDirectory dir_;
+  HttpTestServer server_;
+  std::unique_ptr<LoopbackProxy> proxy_;
+};
+
+TEST_F(LoopbackProxyTest, ServesUpstreamAndCachesIt) {
+  std::string track = Body(10 * kSegmentSize + 1234, 7);
+  server_.Put("/track.mp3", TestResource{track});
+
+  std::string body;
+  ASSERT_EQ(Get(ProxyUrl("qq_1_320", "/track.mp3"), &body), 200);
+  EXPECT_EQ(body, track);
+
+  // Once complete, the track is served without asking upstream again.
+  int requests = server_.requests();
+  ASSERT_EQ(Get(ProxyUrl("qq_1_320", "/track.mp3"), &body), 200);
+  EXPECT_EQ(body, track);
+  EXPECT_EQ(server_.requests(), requests);
+}
+
+TEST_F(LoopbackProxyTest, HonoursRangesAndServersWithoutThem) {
+  std::string track = Body(6 * kSegmentSize, 3);
+  server_.Put("/ranged.mp3", TestResource{track});
+  TestResource whole{track};
+  whole.ranges = false;
+  server_.Put("/whole.mp3", whole);
+
+  for (const char* path : {"/ranged.mp3", "/whole.mp3"}) {
+    SCOPED_TRACE(path);
+    std::string body;
+    std::string key = path + 1;
+    ASSERT_EQ(Get(ProxyUrl(key, path), &body, "bytes=200000-300000"), 206);
+    EXPECT_EQ(body, track.substr(200000, 100001));
+    ASSERT_EQ(Get(ProxyUrl(key, path), &body, "bytes=393000-"), 206);
+    EXPECT_EQ(body, track.substr(393000));
+  }
+}
+
+TEST_F(LoopbackProxyTest, CacheStaysWithinLimit) {
+  proxy_->SetCacheLimit(24 * kSegmentSize);
+  for (int i = 0; i < 6; ++i) {
+    std::string path = "/t" + std::to_string(i) + ".mp3";
+    std::string track = Body(10 * kSegmentSize, static_cast<uint8_t>(i));
+    server_.Put(path, TestResource{track});
+    std::string body;
+    ASSERT_EQ(Get(ProxyUrl("t" + std::to_string(i), path), &body), 200);
+    EXPECT_EQ(body, track);
+  }
+
+  // Only the two most recent tracks fit.
+  uint64_t stored = 0;
+  for (int i = 0; i < 6; ++i) {
+    struct stat st;
+    std::string data = dir_.path() + "/t" + std::to_string(i) + ".seg";
+    if (stat(data.c_str(), &st) == 0) {
+      EXPECT_GE(i, 4) << data;
+      stored += static_cast<uint64_t>(st.st_size);
+    }
+  }
+  EXPECT_LE(stored, 24u * kSegmentSize);
+}
+
+}  // namespace
+}  // namespace cyrene
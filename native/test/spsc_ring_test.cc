@@ -0,0 +1,106 @@
+#include "spsc_ring.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace cyrene {
+namespace {
+
+TEST(SpscRingTest, CapacityRoundsUpToAPowerOfTwo) {
+  EXPECT_EQ(SpscRing<int>(1).capacity(), 1u);
+  EXPECT_EQ(SpscRing<int>(5).capacity(), 8u);
+  EXPECT_EQ(SpscRing<int>(64).capacity(), 64u);
+}
+
+TEST(SpscRingTest, FullAndEmpty) {
+  SpscRing<int> ring(4);
+  int out[8] = {};
+  EXPECT_EQ(ring.ReadAvailable(), 0u);
+  EXPECT_EQ(ring.WriteAvailable(), 4u);
+  EXPECT_EQ(ring.Read(out, 8), 0u);
+  EXPECT_EQ(ring.Peek(out, 8), 0u);
+  EXPECT_EQ(ring.Discard(8), 0u);
+
+  // Only what fits is taken.
+  const int in[6] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(ring.Write(in, 6), 4u);
+  EXPECT_EQ(ring.ReadAvailable(), 4u);
+  EXPECT_EQ(ring.WriteAvailable(), 0u);
+  EXPECT_EQ(ring.Write(in, 1), 0u);
+
+  // Peek leaves the elements in place.
+  EXPECT_EQ(ring.Peek(out, 2), 2u);
+  EXPECT_EQ(out[0], 1);
+  EXPECT_EQ(out[1], 2);
+  EXPECT_EQ(ring.ReadAvailable(), 4u);
+
+  EXPECT_EQ(ring.Discard(1), 1u);
+  EXPECT_EQ(ring.Read(out, 8), 3u);
+  EXPECT_EQ(out[0], 2);
+  EXPECT_EQ(out[2], 4);
+  EXPECT_EQ(ring.ReadAvailable(), 0u);
+  EXPECT_EQ(ring.WriteAvailable(), 4u);
+}
+
+TEST(SpscRingTest, WritesAndReadsWrapAround) {
+  SpscRing<uint32_t> ring(8);
+  std::vector<uint32_t> in(5);
+  std::vector<uint32_t> out(5);
+  uint32_t next_in = 0;
+  uint32_t next_out = 0;
+  // Steps of 5 in a ring of 8 start at every offset, so most writes and
+  // reads are split across the end of the buffer.
+  for (int round = 0; round < 40; ++round) {
+    for (uint32_t& value : in) value = next_in++;
+    ASSERT_EQ(ring.Write(in.data(), in.size()), in.size());
+    ASSERT_EQ(ring.Read(out.data(), out.size()), out.size());
+    for (uint32_t value : out) ASSERT_EQ(value, next_out++);
+  }
+
+  // Filling the ring when it starts mid-buffer.
+  std::vector<uint32_t> full(8);
+  for (uint32_t& value : full) value = next_in++;
+  ASSERT_EQ(ring.Write(full.data(), full.size()), 8u);
+  std::vector<uint32_t> back(8);
+  ASSERT_EQ(ring.Peek(back.data(), 8), 8u);
+  EXPECT_EQ(back, full);
+  ASSERT_EQ(ring.Read(back.data(), 8), 8u);
+  EXPECT_EQ(back, full);
+}
+
+TEST(SpscRingTest, OneProducerOneConsumer) {
+  constexpr uint32_t kCount = 1 << 18;
+  SpscRing<uint32_t> ring(256);
+  std::thread producer([&] {
+    uint32_t chunk[37];
+    uint32_t next = 0;
+    while (next < kCount) {
+      size_t count = 0;
+      while (count < 37 && next + count < kCount) {
+        chunk[count] = next + static_cast<uint32_t>(count);
+        ++count;
+      }
+      size_t written = ring.Write(chunk, count);
+      if (written == 0) std::this_thread::yield();
+      next += static_cast<uint32_t>(written);
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t chunk[53];
+  bool ordered = true;
+  while (expected < kCount) {
+    size_t got = ring.Read(chunk, 53);
+    if (got == 0) std::this_thread::yield();
+    for (size_t i = 0; i < got; ++i) ordered &= chunk[i] == expected++;
+  }
+  producer.join();
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(ring.ReadAvailable(), 0u);
+}
+
+}  // namespace
+}  // namespace cyrene
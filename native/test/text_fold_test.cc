@@ -0,0 +1,55 @@
+#include "text_fold.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "icu_loader.h"
+#include "pinyin.h"
+
+namespace cyrene {
+namespace {
+
+TEST(TextFoldTest, FoldsCaseWidthAndTraditionalHan) {
+  EXPECT_EQ(FoldText("Hello World"), U"hello world");
+  // Full-width Latin, ideographic space.
+  EXPECT_EQ(FoldText("\xEF\xBC\xA1\xEF\xBC\xA2\xE3\x80\x80" "c"), U"ab c");
+  // 愛與誠 -> 爱与诚
+  EXPECT_EQ(FoldText("\xE6\x84\x9B\xE8\x88\x87\xE8\xAA\xA0"),
+            U"爱与诚");
+  EXPECT_EQ(FoldText("\xC3\x89t\xC3\xA9"), U"été");  // Été
+  EXPECT_EQ(FoldText("a\xFF" "b"), U"a�b");
+  EXPECT_EQ(FoldText(""), U"");
+}
+
+TEST(TextFoldTest, NormalizesCompatibilityFormsWithIcu) {
+  if (Icu() == nullptr) GTEST_SKIP() << "ICU is not installed";
+  EXPECT_EQ(FoldText("\xEF\xAC\x81le"), U"file");  // U+FB01 ligature
+  EXPECT_EQ(FoldText("\xE2\x85\xA0"), U"i");        // Roman numeral one
+  EXPECT_EQ(FoldText("\xF0\x9D\x90\x80"), U"a");    // Mathematical bold A
+}
+
+TEST(TextFoldTest, KeyCharacters) {
+  EXPECT_TRUE(IsKeyCharacter(U'a'));
+  EXPECT_TRUE(IsKeyCharacter(U'7'));
+  EXPECT_TRUE(IsKeyCharacter(U'é'));
+  EXPECT_TRUE(IsKeyCharacter(U'爱'));
+  EXPECT_TRUE(IsKeyCharacter(U'あ'));  // Hiragana a
+  EXPECT_FALSE(IsKeyCharacter(U' '));
+  EXPECT_FALSE(IsKeyCharacter(U'-'));
+  EXPECT_FALSE(IsKeyCharacter(U'、'));  // Ideographic comma
+  EXPECT_FALSE(IsKeyCharacter(U'’'));  // Right single quote
+  EXPECT_FALSE(IsKeyCharacter(U'（'));  // Full-width parenthesis
+}
+
+TEST(TextFoldTest, PinyinComesFromIcu) {
+  if (Icu() == nullptr) {
+    EXPECT_EQ(PinyinOf(U'周'), "");
+    return;
+  }
+  EXPECT_EQ(PinyinOf(U'周'), "zhou");  // 周
+  EXPECT_EQ(PinyinOf(U'杰'), "jie");   // 杰
+}
+
+}  // namespace
+}  // namespace cyrene
@@ -0,0 +1,29 @@
+#ifndef CYRENE_NATIVE_TEXT_FOLD_H_
+#define CYRENE_NATIVE_TEXT_FOLD_H_
+
+#include <string>
+#include <string_view>
+
+namespace cyrene {
+
+// Folds UTF-8 |text| for matching titles and names across platforms:
+// NFKC with case folding (full-width and half-width forms, compatibility
+// ideographs, ligatures and case collapse), then traditional Chinese
+// characters to simplified ones. Invalid UTF-8 becomes U+FFFD.
+//
+// NFKC needs ICU, which is loaded at run time; without it Latin case and
+// full-width forms are still folded but compatibility characters and
+// ligatures are kept. Plain ASCII and common Han text never touch ICU.
+std::u32string FoldText(std::string_view text);
+
+// The simplified form of the Han character |c|, or |c| itself.
+char32_t SimplifiedHan(char32_t c);
+
+// Whether |c| counts towards a folded key: letters, digits and ideographs,
+// not spaces, punctuation or symbols. Without ICU, non-ASCII characters
+// outside the common punctuation and symbol blocks all count.
+bool IsKeyCharacter(char32_t c);
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_TEXT_FOLD_H_
@@ -0,0 +1,269 @@
+#include "thumbnail_cache.h"
+
+#include <openssl/evp.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "fd_util.h"
+#include "image_codec.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CYRENE_THUMB_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CYRENE_THUMB_NEON 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+constexpr int kJpegQuality = 88;
+
+// A square RGBA image.
+struct Square {
+  std::vector<uint8_t> pixels;
+  int size = 0;
+};
+
+// The centered square of |image|, as RGBA.
+Square CropToSquare(const DecodedImage& image) {
+  Square square;
+  square.size = std::min(image.width, image.height);
+  square.pixels.resize(static_cast<size_t>(square.size) * square.size * 4);
+  int left = (image.width - square.size) / 2;
+  int top = (image.height - square.size) / 2;
+  for (int y = 0; y < square.size; ++y) {
+    const uint8_t* in =
+        image.pixels.data() +
+        (static_cast<size_t>(top + y) * image.width + left) * image.channels;
+    uint8_t* out =
+        square.pixels.data() + static_cast<size_t>(y) * square.size * 4;
+    if (image.channels == 4) {
+      std::memcpy(out, in, static_cast<size_t>(square.size) * 4);
+      continue;
+    }
+    for (int x = 0; x < square.size; ++x) {
+      out[x * 4] = in[x * 3];
+      out[x * 4 + 1] = in[x * 3 + 1];
+      out[x * 4 + 2] = in[x * 3 + 2];
+      out[x * 4 + 3] = 0xFF;
+    }
+  }
+  return square;
+}
+
+// Averages 2x2 blocks of RGBA pixels: |count| output pixels from rows |a|
+// and |b|, starting at output pixel |begin|.
+void HalveRowScalar(const uint8_t* a, const uint8_t* b, uint8_t* out,
+                    int begin, int count) {
+  for (int x = begin; x < count; ++x) {
+    for (int c = 0; c < 4; ++c) {
+      int sum = a[x * 8 + c] + a[x * 8 + 4 + c] + b[x * 8 + c] +
+                b[x * 8 + 4 + c];
+      out[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+    }
+  }
+}
+
+void HalveRow(const uint8_t* a, const uint8_t* b, uint8_t* out, int count) {
+  int x = 0;
+#if defined(CYRENE_THUMB_SSE2)
+  // Four input pixels of each row make two output pixels.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for (; x + 2 <= count; x += 2) {
+    __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8));
+    __m128i bottom =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8));
+    __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero),
+                                 _mm_unpacklo_epi8(bottom, zero));
+    __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero),
+                                  _mm_unpackhi_epi8(bottom, zero));
+    __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right),
+                                _mm_unpackhi_epi64(left, right));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4),
+                     _mm_packus_epi16(sum, sum));
+  }
+#elif defined(CYRENE_THUMB_NEON)
+  for (; x + 2 <= count; x += 2) {
+    uint8x16_t top = vld1q_u8(a + x * 8);
+    uint8x16_t bottom = vld1q_u8(b + x * 8);
+    uint16x8_t left = vaddl_u8(vget_low_u8(top), vget_low_u8(bottom));
+    uint16x8_t right = vaddl_u8(vget_high_u8(top), vget_high_u8(bottom));
+    uint16x8_t sum =
+        vaddq_u16(vcombine_u16(vget_low_u16(left), vget_low_u16(right)),
+                  vcombine_u16(vget_high_u16(left), vget_high_u16(right)));
+    vst1_u8(out + x * 4, vrshrn_n_u16(sum, 2));
+  }
+#endif
+  HalveRowScalar(a, b, out, x, count);
+}
+
+Square Halve(const Square& in) {
+  Square out;
+  out.size = in.size / 2;
+  out.pixels.resize(static_cast<size_t>(out.size) * out.size * 4);
+  size_t stride = static_cast<size_t>(in.size) * 4;
+  for (int y = 0; y < out.size; ++y) {
+    const uint8_t* a = in.pixels.data() + 2 * y * stride;
+    uint8_t* row =
+        out.pixels.data() + static_cast<size_t>(y) * out.size * 4;
+    HalveRow(a, a + stride, row, out.size);
+  }
+  return out;
+}
+
+// One output pixel's share of the source along an axis: source pixels
+// [first, first + weights.size()) with their coverage.
+struct Span {
+  int first;
+  std::vector<float> weights;
+};
+
+std::vector<Span> AreaSpans(int from, int to) {
+  std::vector<Span> spans(to);
+  double scale = static_cast<double>(from) / to;
+  for (int i = 0; i < to; ++i) {
+    double begin = i * scale;
+    double end = (i + 1) * scale;
+    Span& span = spans[i];
+    span.first = static_cast<int>(begin);
+    for (int j = span.first; j < end && j < from; ++j) {
+      double covered =
+          std::min<double>(j + 1, end) - std::max<double>(j, begin);
+      span.weights.push_back(static_cast<float>(covered / scale));
+    }
+  }
+  return spans;
+}
+
+// Area (box) resampling to a smaller size: every output pixel is the
+// coverage-weighted mean of the source pixels under it. Separable, rows
+// first.
+Square AreaResample(const Square& in, int size) {
+  std::vector<Span> spans = AreaSpans(in.size, size);
+  std::vector<float> rows(static_cast<size_t>(in.size) * size * 4);
+  for (int y = 0; y < in.size; ++y) {
+    const uint8_t* src =
+        in.pixels.data() + static_cast<size_t>(y) * in.size * 4;
+    float* dst = rows.data() + static_cast<size_t>(y) * size * 4;
+    for (int x = 0; x < size; ++x) {
+      float sum[4] = {0, 0, 0, 0};
+      const Span& span = spans[x];
+      for (size_t k = 0; k < span.weights.size(); ++k) {
+        const uint8_t* p = src + (span.first + k) * 4;
+        for (int c = 0; c < 4; ++c) sum[c] += p[c] * span.weights[k];
+      }
+      std::memcpy(dst + x * 4, sum, sizeof(sum));
+    }
+  }
+
+  Square out;
+  out.size = size;
+  out.pixels.resize(static_cast<size_t>(size) * size * 4);
+  for (int y = 0; y < size; ++y) {
+    const Span& span = spans[y];
+    uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * size * 4;
+    for (int i = 0; i < size * 4; ++i) {
+      float sum = 0;
+      for (size_t k = 0; k < span.weights.size(); ++k) {
+        sum += rows[(span.first + k) * size * 4 + i] * span.weights[k];
+      }
+      dst[i] = static_cast<uint8_t>(std::min(255.0f, sum + 0.5f));
+    }
+  }
+  return out;
+}
+
+// Brings |square| down to |size|: halvings while it is at least twice as
+// large, then one area resample for the remaining factor below 2.
+Square Shrink(Square square, int size) {
+  while (square.size >= 2 * size) square = Halve(square);
+  if (square.size > size) square = AreaResample(square, size);
+  return square;
+}
+
+std::string Sha256Hex(const uint8_t* data, size_t size) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  if (!EVP_Digest(data, size, digest, &length, EVP_sha256(), nullptr)) {
+    return std::string();
+  }
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (unsigned int i = 0; i < length; ++i) {
+    hex += kDigits[digest[i] >> 4];
+    hex += kDigits[digest[i] & 0xF];
+  }
+  return hex;
+}
+
+bool Exists(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+}  // namespace
+
+std::string ThumbnailPath(const std::string& directory,
+                          const std::string& hash, int level) {
+  return directory + "/" + hash.substr(0, 2) + "/" + hash + "_" +
+         std::to_string(level) + ".jpg";
+}
+
+std::string StoreThumbnails(const std::string& directory, const uint8_t* data,
+                            size_t size) {
+  if (data == nullptr || size == 0) return std::string();
+  std::string hash = Sha256Hex(data, size);
+  if (hash.empty()) return std::string();
+
+  // Levels are written largest first, so the smallest means all are there.
+  constexpr int kSmallest = kThumbnailLevels[std::size(kThumbnailLevels) - 1];
+  if (Exists(ThumbnailPath(directory, hash, kSmallest))) return hash;
+
+  DecodedImage image;
+  if (!DecodeImage(data, size, kThumbnailLevels[0], &image) ||
+      image.width == 0 || image.height == 0) {
+    return std::string();
+  }
+  std::string bucket = directory + "/" + hash.substr(0, 2);
+  mkdir(directory.c_str(), 0755);
+  mkdir(bucket.c_str(), 0755);
+
+  Square square = CropToSquare(image);
+  image.pixels = std::vector<uint8_t>();
+  std::vector<uint8_t> jpeg;
+  for (int level : kThumbnailLevels) {
+    square = Shrink(std::move(square), level);
+    if (!EncodeJpeg(square.pixels.data(), square.size, square.size,
+                    kJpegQuality, &jpeg) ||
+        !WriteFileAtomically(ThumbnailPath(directory, hash, level),
+                             jpeg.data(), jpeg.size())) {
+      return std::string();
+    }
+  }
+  return hash;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+int32_t cyrene_thumbnail_store(const char* directory, const uint8_t* data,
+                               int64_t length, char* hash_out) {
+  if (directory == nullptr || length <= 0 || hash_out == nullptr) return 0;
+  std::string hash =
+      cyrene::StoreThumbnails(directory, data, static_cast<size_t>(length));
+  if (hash.empty()) return 0;
+  std::memcpy(hash_out, hash.c_str(), hash.size() + 1);
+  return 1;
+}
+
+}  // extern "C"
@@ -0,0 +1,47 @@
+#ifndef CYRENE_NATIVE_THUMBNAIL_CACHE_H_
+#define CYRENE_NATIVE_THUMBNAIL_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// Content-addressed cover thumbnails.
+//
+// A cover is stored once per distinct image as a pyramid of square JPEGs,
+//   <directory>/<first two hash digits>/<hash>_<level>.jpg
+// one per level in kThumbnailLevels, where <hash> is the hex SHA-256 of the
+// original bytes. Non-square covers are center-cropped, as BoxFit.cover
+// would show them. A level larger than the cover is written at the cover's
+// own size, so every level always exists.
+//
+// The largest level is area-resampled from the (DCT-scaled) decode; each
+// smaller one halves the previous with a SIMD 2x2 box filter.
+constexpr int kThumbnailLevels[] = {512, 256, 128, 64};
+
+// Writes the pyramid of |data| unless it is already there and returns the
+// hash, or an empty string if the image cannot be decoded or written. Files
+// appear atomically, so concurrent callers and readers are safe.
+std::string StoreThumbnails(const std::string& directory, const uint8_t* data,
+                            size_t size);
+
+// Path of |level| for |hash| (whether or not it exists).
+std::string ThumbnailPath(const std::string& directory,
+                          const std::string& hash, int level);
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/thumbnail_cache_native.dart. Writes the
+// 64-digit hash and a NUL to |hash_out| (65 bytes); returns 0 on failure.
+CYRENE_EXPORT int32_t cyrene_thumbnail_store(const char* directory,
+                                             const uint8_t* data,
+                                             int64_t length, char* hash_out);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_THUMBNAIL_CACHE_H_
@@ -0,0 +1,437 @@
+#include "upstream_client.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "http_util.h"
+
+namespace cyrene {
+
+namespace {
+
+// Socket send/receive timeout for upstream connections.
+constexpr int kIoTimeoutSeconds = 15;
+
+// Maximum number of redirects followed per request.
+constexpr int kMaxRedirects = 5;
+
+// Limit on the size of a response head (status line plus headers).
+constexpr size_t kMaxHeadSize = 64 * 1024;
+
+// Idle connections kept per origin.
+constexpr size_t kMaxIdlePerOrigin = 4;
+
+// Size of the buffer used when streaming a response body.
+constexpr size_t kBodyChunkSize = 64 * 1024;
+
+SSL_CTX* TlsContext() {
+  static SSL_CTX* context = [] {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if (ctx != nullptr) {
+      SSL_CTX_set_default_verify_paths(ctx);
+      SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+      SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    }
+    return ctx;
+  }();
+  return context;
+}
+
+std::string Trim(const std::string& text) {
+  size_t begin = text.find_first_not_of(" \t");
+  if (begin == std::string::npos) return std::string();
+  size_t end = text.find_last_not_of(" \t");
+  return text.substr(begin, end - begin + 1);
+}
+
+}  // namespace
+
+bool Url::Parse(const std::string& text, Url* url) {
+  size_t scheme_end = text.find("://");
+  if (scheme_end == std::string::npos) return false;
+
+  std::string scheme = ToLower(text.substr(0, scheme_end));
+  if (scheme == "https") {
+    url->tls = true;
+    url->port = 443;
+  } else if (scheme == "http") {
+    url->tls = false;
+    url->port = 80;
+  } else {
+    return false;
+  }
+
+  size_t host_begin = scheme_end + 3;
+  size_t path_begin = text.find_first_of("/?#", host_begin);
+  std::string authority = text.substr(
+      host_begin, path_begin == std::string::npos ? std::string::npos
+                                                  : path_begin - host_begin);
+  // Drop any userinfo.
+  size_t at = authority.rfind('@');
+  if (at != std::string::npos) authority = authority.substr(at + 1);
+
+  size_t colon = authority.rfind(':');
+  if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+    int port = std::atoi(authority.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) return false;
+    url->port = static_cast<uint16_t>(port);
+    authority = authority.substr(0, colon);
+  }
+  if (authority.empty()) return false;
+  url->host = authority;
+
+  if (path_begin == std::string::npos) {
+    url->target = "/";
+  } else {
+    url->target = text.substr(path_begin);
+    size_t fragment = url->target.find('#');
+    if (fragment != std::string::npos) url->target.resize(fragment);
+    if (url->target.empty() || url->target[0] != '/') {
+      url->target.insert(0, "/");
+    }
+  }
+  return true;
+}
+
+std::string Url::Origin() const {
+  return (tls ? "https://" : "http://") + host + ":" + std::to_string(port);
+}
+
+const std::string* UpstreamResponse::Header(const std::string& name) const {
+  auto it = headers.find(name);
+  return it == headers.end() ? nullptr : &it->second;
+}
+
+class UpstreamConnection {
+ public:
+  static std::unique_ptr<UpstreamConnection> Open(const Url& url) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses = nullptr;
+    std::string port = std::to_string(url.port);
+    if (getaddrinfo(url.host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+      return nullptr;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = addresses; ai != nullptr; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                  ai->ai_protocol);
+      if (fd < 0) continue;
+
+      // On Linux SO_SNDTIMEO also bounds connect().
+      struct timeval timeout = {kIoTimeoutSeconds, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) return nullptr;
+
+    std::unique_ptr<UpstreamConnection> connection(
+        new UpstreamConnection(fd, url.Origin()));
+    if (url.tls && !connection->StartTls(url.host)) return nullptr;
+    return connection;
+  }
+
+  ~UpstreamConnection() {
+    if (ssl_ != nullptr) {
+      SSL_shutdown(ssl_);
+      SSL_free(ssl_);
+    }
+    close(fd_);
+  }
+
+  const std::string& origin() const { return origin_; }
+
+  bool WriteAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n;
+      if (ssl_ != nullptr) {
+        n = SSL_write(ssl_, data.data() + sent,
+                      static_cast<int>(data.size() - sent));
+        if (n <= 0) return false;
+      } else {
+        n = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+          if (errno == EINTR) continue;
+          return false;
+        }
+      }
+      sent += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Reads up to |capacity| bytes, serving buffered data first. Returns the
+  // number of bytes read, 0 on a clean EOF and -1 on error.
+  ssize_t Read(uint8_t* buffer, size_t capacity) {
+    if (pending_ < buffer_.size()) {
+      size_t count = std::min(capacity, buffer_.size() - pending_);
+      std::memcpy(buffer, buffer_.data() + pending_, count);
+      pending_ += count;
+      return static_cast<ssize_t>(count);
+    }
+    return ReadSocket(buffer, capacity);
+  }
+
+  // Reads one CRLF-terminated line (without the terminator).
+  bool ReadLine(std::string* line) {
+    while (true) {
+      size_t end = buffer_.find("\r\n", pending_);
+      if (end != std::string::npos) {
+        line->assign(buffer_, pending_, end - pending_);
+        pending_ = end + 2;
+        return true;
+      }
+      if (buffer_.size() - pending_ > kMaxHeadSize || !Fill()) return false;
+    }
+  }
+
+  // Reads exactly |length| bytes.
+  bool ReadExact(uint8_t* buffer, size_t length) {
+    while (length > 0) {
+      ssize_t n = Read(buffer, length);
+      if (n <= 0) return false;
+      buffer += n;
+      length -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+ private:
+  UpstreamConnection(int fd, std::string origin)
+      : fd_(fd), ssl_(nullptr), origin_(std::move(origin)), pending_(0) {}
+
+  bool StartTls(const std::string& host) {
+    SSL_CTX* context = TlsContext();
+    if (context == nullptr) return false;
+    ssl_ = SSL_new(context);
+    if (ssl_ == nullptr) return false;
+    SSL_set_fd(ssl_, fd_);
+    SSL_set_tlsext_host_name(ssl_, host.c_str());
+    SSL_set1_host(ssl_, host.c_str());
+    if (SSL_connect(ssl_) != 1) {
+      ERR_clear_error();
+      return false;
+    }
+    return true;
+  }
+
+  bool Fill() {
+    if (pending_ > 0) {
+      buffer_.erase(0, pending_);
+      pending_ = 0;
+    }
+    uint8_t chunk[16 * 1024];
+    ssize_t n = ReadSocket(chunk, sizeof(chunk));
+    if (n <= 0) return false;
+    buffer_.append(reinterpret_cast<const char*>(chunk),
+                   static_cast<size_t>(n));
+    return true;
+  }
+
+  ssize_t ReadSocket(uint8_t* buffer, size_t capacity) {
+    while (true) {
+      if (ssl_ != nullptr) {
+        int n = SSL_read(ssl_, buffer, static_cast<int>(capacity));
+        if (n > 0) return n;
+        int error = SSL_get_error(ssl_, n);
+        ERR_clear_error();
+        return error == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+      }
+      ssize_t n = recv(fd_, buffer, capacity, 0);
+      if (n < 0 && errno == EINTR) continue;
+      return n;
+    }
+  }
+
+  int fd_;
+  SSL* ssl_;
+  std::string origin_;
+  std::string buffer_;
+  size_t pending_;
+};
+
+UpstreamClient::UpstreamClient() = default;
+
+UpstreamClient::~UpstreamClient() = default;
+
+std::unique_ptr<UpstreamConnection> UpstreamClient::Acquire(const Url& url,
+                                                            bool* reused) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = idle_.find(url.Origin());
+    if (it != idle_.end() && !it->second.empty()) {
+      std::unique_ptr<UpstreamConnection> connection =
+          std::move(it->second.back());
+      it->second.pop_back();
+      *reused = true;
+      return connection;
+    }
+  }
+  *reused = false;
+  return UpstreamConnection::Open(url);
+}
+
+void UpstreamClient::Release(std::unique_ptr<UpstreamConnection> connection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& pool = idle_[connection->origin()];
+  if (pool.size() < kMaxIdlePerOrigin) pool.push_back(std::move(connection));
+}
+
+void UpstreamClient::CloseIdle() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.clear();
+}
+
+bool UpstreamClient::Get(const std::string& url_text, const Headers& headers,
+                         const HeadHandler& on_head,
+                         const BodyHandler& on_body) {
+  Url url;
+  if (!Url::Parse(url_text, &url)) return false;
+
+  for (int redirect = 0; redirect <= kMaxRedirects; ++redirect) {
+    std::string request = "GET " + url.target + " HTTP/1.1\r\nHost: " +
+                          url.host;
+    if (url.port != (url.tls ? 443 : 80)) {
+      request += ":" + std::to_string(url.port);
+    }
+    request += "\r\nConnection: keep-alive\r\nAccept-Encoding: identity\r\n";
+    for (const auto& header : headers) {
+      request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "\r\n";
+
+    // A pooled connection may have been closed by the server while idle;
+    // retry once on a fresh one before giving up.
+    std::unique_ptr<UpstreamConnection> connection;
+    UpstreamResponse response;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      bool reused = false;
+      connection = Acquire(url, &reused);
+      if (!connection) return false;
+
+      std::string status_line;
+      if (connection->WriteAll(request) &&
+          connection->ReadLine(&status_line)) {
+        // "HTTP/1.1 206 Partial Content"
+        size_t space = status_line.find(' ');
+        response.status = space == std::string::npos
+                              ? 0
+                              : std::atoi(status_line.c_str() + space + 1);
+        break;
+      }
+      connection.reset();
+      if (!reused) return false;
+    }
+    if (!connection || response.status < 100) return false;
+
+    std::string line;
+    while (true) {
+      if (!connection->ReadLine(&line)) return false;
+      if (line.empty()) break;
+      size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      response.headers[ToLower(Trim(line.substr(0, colon)))] =
+          Trim(line.substr(colon + 1));
+    }
+
+    const std::string* encoding = response.Header("transfer-encoding");
+    bool chunked = encoding != nullptr &&
+                   ToLower(*encoding).find("chunked") != std::string::npos;
+    const std::string* length_header = response.Header("content-length");
+    const std::string* connection_header = response.Header("connection");
+    bool keep_alive = (chunked || length_header != nullptr) &&
+                      (connection_header == nullptr ||
+                       ToLower(*connection_header) != "close");
+    uint64_t content_length =
+        length_header ? std::strtoull(length_header->c_str(), nullptr, 10)
+                      : 0;
+
+    const std::string* location = response.Header("location");
+    if (response.status >= 300 && response.status < 400 &&
+        location != nullptr && redirect < kMaxRedirects) {
+      std::string next = *location;
+      if (next.rfind("//", 0) == 0) {
+        next = (url.tls ? "https:" : "http:") + next;
+      } else if (next.find("://") == std::string::npos) {
+        std::string base = (url.tls ? "https://" : "http://") + url.host +
+                           ":" + std::to_string(url.port);
+        next = base + (next.empty() || next[0] != '/' ? "/" : "") + next;
+      }
+      if (!Url::Parse(next, &url)) return false;
+      // Redirect bodies are tiny; the connection is simply dropped.
+      continue;
+    }
+
+    if (!on_head(response)) return true;
+
+    std::unique_ptr<uint8_t[]> chunk(new uint8_t[kBodyChunkSize]);
+    if (chunked) {
+      while (true) {
+        if (!connection->ReadLine(&line)) return false;
+        uint64_t size = std::strtoull(line.c_str(), nullptr, 16);
+        if (size == 0) {
+          // Trailer section ends with an empty line.
+          do {
+            if (!connection->ReadLine(&line)) return false;
+          } while (!line.empty());
+          break;
+        }
+        while (size > 0) {
+          size_t take = static_cast<size_t>(
+              std::min<uint64_t>(size, kBodyChunkSize));
+          if (!connection->ReadExact(chunk.get(), take)) return false;
+          size -= take;
+          if (!on_body(chunk.get(), take)) return true;
+        }
+        if (!connection->ReadLine(&line)) return false;
+      }
+    } else if (length_header != nullptr) {
+      uint64_t remaining = content_length;
+      while (remaining > 0) {
+        ssize_t n = connection->Read(
+            chunk.get(),
+            static_cast<size_t>(std::min<uint64_t>(remaining, kBodyChunkSize)));
+        if (n <= 0) return false;
+        remaining -= static_cast<uint64_t>(n);
+        if (!on_body(chunk.get(), static_cast<size_t>(n))) return true;
+      }
+    } else {
+      // No framing: the body runs until the server closes the connection.
+      while (true) {
+        ssize_t n = connection->Read(chunk.get(), kBodyChunkSize);
+        if (n < 0) return false;
+        if (n == 0) break;
+        if (!on_body(chunk.get(), static_cast<size_t>(n))) return true;
+      }
+    }
+
+    if (keep_alive) Release(std::move(connection));
+    return true;
+  }
+  return false;
+}
+
+}  // namespace cyrene
@@ -0,0 +1,89 @@
+#ifndef CYRENE_NATIVE_UPSTREAM_CLIENT_H_
+#define CYRENE_NATIVE_UPSTREAM_CLIENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cyrene {
+
+// Sent with every CDN request, as the Dart proxy does; some CDNs refuse
+// unknown clients.
+constexpr char kUpstreamUserAgent[] =
+    "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36";
+
+// Parsed http:// or https:// URL.
+struct Url {
+  bool tls = false;
+  std::string host;
+  uint16_t port = 0;
+  std::string target;  // Path plus query, always starting with '/'.
+
+  static bool Parse(const std::string& text, Url* url);
+
+  // "scheme://host:port", the key used for connection reuse.
+  std::string Origin() const;
+};
+
+// Status line and headers of an upstream response. Header names are
+// lower-cased.
+struct UpstreamResponse {
+  int status = 0;
+  std::map<std::string, std::string> headers;
+
+  const std::string* Header(const std::string& name) const;
+};
+
+// One TCP (optionally TLS) connection to an upstream server.
+class UpstreamConnection;
+
+// Minimal blocking HTTP/1.1 client for fetching audio from the music CDNs.
+//
+// Connections are kept alive and pooled per origin, so consecutive range
+// requests for the same track reuse one socket (and one TLS session).
+// Redirects are followed; Content-Length and chunked bodies are supported.
+// Thread-safe: each Get() call uses its own connection.
+class UpstreamClient {
+ public:
+  using Headers = std::vector<std::pair<std::string, std::string>>;
+
+  // Called once with the final (post-redirect) response head. Returning
+  // false skips the body.
+  using HeadHandler = std::function<bool(const UpstreamResponse&)>;
+
+  // Called for each piece of the body. Returning false stops reading; the
+  // connection is then discarded rather than returned to the pool.
+  using BodyHandler = std::function<bool(const uint8_t* data, size_t length)>;
+
+  UpstreamClient();
+  ~UpstreamClient();
+
+  UpstreamClient(const UpstreamClient&) = delete;
+  UpstreamClient& operator=(const UpstreamClient&) = delete;
+
+  // Issues a GET for |url| with |headers|. Returns false on network or
+  // protocol errors (HTTP error statuses are reported through |on_head|).
+  bool Get(const std::string& url, const Headers& headers,
+           const HeadHandler& on_head, const BodyHandler& on_body);
+
+  // Closes all idle pooled connections.
+  void CloseIdle();
+
+ private:
+  std::unique_ptr<UpstreamConnection> Acquire(const Url& url, bool* reused);
+  void Release(std::unique_ptr<UpstreamConnection> connection);
+
+  std::mutex mutex_;
+  std::map<std::string, std::vector<std::unique_ptr<UpstreamConnection>>>
+      idle_;
+};
+
+}  // namespace cyrene
+
+#endif  // CYRENE_NATIVE_UPSTREAM_CLIENT_H_
@@ -0,0 +1,202 @@
+#include "xor_cipher.h"
+
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CYRENE_XOR_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CYRENE_XOR_NEON 1
+#endif
+
+namespace cyrene {
+
+namespace {
+
+// All kernels share one contract: |keystream| holds at least
+// |period| + kBlockWidth bytes, |period| is a multiple of kBlockWidth and
+// |phase| < |period| is the keystream position of buffer[0].
+using XorKernel = void (*)(uint8_t* buffer, size_t length,
+                           const uint8_t* keystream, size_t period,
+                           size_t phase);
+
+constexpr size_t kBlock = XorCipher::kBlockWidth;
+
+void XorTail(uint8_t* buffer, size_t length, const uint8_t* keystream,
+             size_t phase) {
+  // phase < period and length < kBlock, so this stays inside the slack block.
+  for (size_t i = 0; i < length; ++i) {
+    buffer[i] ^= keystream[phase + i];
+  }
+}
+
+void XorScalar(uint8_t* buffer, size_t length, const uint8_t* keystream,
+               size_t period, size_t phase) {
+  size_t i = 0;
+  for (; i + kBlock <= length; i += kBlock) {
+    for (size_t j = 0; j < kBlock; ++j) {
+      buffer[i + j] ^= keystream[phase + j];
+    }
+    phase += kBlock;
+    if (phase >= period) phase -= period;
+  }
+  XorTail(buffer + i, length - i, keystream, phase);
+}
+
+#if defined(CYRENE_XOR_X86)
+
+void XorSse2(uint8_t* buffer, size_t length, const uint8_t* keystream,
+             size_t period, size_t phase) {
+  size_t i = 0;
+  for (; i + kBlock <= length; i += kBlock) {
+    const uint8_t* k = keystream + phase;
+    uint8_t* b = buffer + i;
+    for (size_t j = 0; j < kBlock; j += 16) {
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+      __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(k + j));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b + j),
+                       _mm_xor_si128(data, key));
+    }
+    phase += kBlock;
+    if (phase >= period) phase -= period;
+  }
+  XorTail(buffer + i, length - i, keystream, phase);
+}
+
+__attribute__((target("avx2"))) void XorAvx2(uint8_t* buffer, size_t length,
+                                             const uint8_t* keystream,
+                                             size_t period, size_t phase) {
+  size_t i = 0;
+  for (; i + kBlock <= length; i += kBlock) {
+    const uint8_t* k = keystream + phase;
+    uint8_t* b = buffer + i;
+    __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+    __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 32));
+    __m256i k0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(k));
+    __m256i k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + 32));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b),
+                        _mm256_xor_si256(d0, k0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + 32),
+                        _mm256_xor_si256(d1, k1));
+    phase += kBlock;
+    if (phase >= period) phase -= period;
+  }
+  XorTail(buffer + i, length - i, keystream, phase);
+}
+
+#endif  // CYRENE_XOR_X86
+
+#if defined(CYRENE_XOR_NEON)
+
+void XorNeon(uint8_t* buffer, size_t length, const uint8_t* keystream,
+             size_t period, size_t phase) {
+  size_t i = 0;
+  for (; i + kBlock <= length; i += kBlock) {
+    const uint8_t* k = keystream + phase;
+    uint8_t* b = buffer + i;
+    for (size_t j = 0; j < kBlock; j += 16) {
+      vst1q_u8(b + j, veorq_u8(vld1q_u8(b + j), vld1q_u8(k + j)));
+    }
+    phase += kBlock;
+    if (phase >= period) phase -= period;
+  }
+  XorTail(buffer + i, length - i, keystream, phase);
+}
+
+#endif  // CYRENE_XOR_NEON
+
+struct KernelChoice {
+  XorKernel kernel;
+  const char* name;
+};
+
+// Every kernel the CPU supports, best first.
+std::vector<KernelChoice> SupportedChoices() {
+  std::vector<KernelChoice> choices;
+#if defined(CYRENE_XOR_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) choices.push_back({XorAvx2, "avx2"});
+  if (__builtin_cpu_supports("sse2")) choices.push_back({XorSse2, "sse2"});
+#elif defined(CYRENE_XOR_NEON)
+  choices.push_back({XorNeon, "neon"});
+#endif
+  choices.push_back({XorScalar, "scalar"});
+  return choices;
+}
+
+const KernelChoice& Kernel() {
+  static const KernelChoice choice = SupportedChoices().front();
+  return choice;
+}
+
+}  // namespace
+
+XorCipher::XorCipher(const uint8_t* key, size_t key_length)
+    : key_length_(key_length), period_(0) {
+  if (key_length_ == 0) return;
+
+  period_ = std::lcm(key_length_, kBlockWidth);
+  expanded_.resize(period_ + kBlockWidth);
+  for (size_t i = 0; i < expanded_.size(); ++i) {
+    expanded_[i] = key[i % key_length_];
+  }
+}
+
+void XorCipher::Apply(uint8_t* buffer, size_t length, uint64_t offset) const {
+  if (key_length_ == 0 || length == 0) return;
+  // Any phase below key_length_ is also below period_; both index the same
+  // keystream byte because period_ is a multiple of key_length_.
+  size_t phase = static_cast<size_t>(offset % key_length_);
+  Kernel().kernel(buffer, length, expanded_.data(), period_, phase);
+}
+
+const char* XorCipher::KernelName() {
+  return Kernel().name;
+}
+
+std::vector<const char*> XorCipher::SupportedKernels() {
+  std::vector<const char*> names;
+  for (const KernelChoice& choice : SupportedChoices()) {
+    names.push_back(choice.name);
+  }
+  return names;
+}
+
+bool XorCipher::ApplyWithKernel(const char* kernel, uint8_t* buffer,
+                                size_t length, uint64_t offset) const {
+  for (const KernelChoice& choice : SupportedChoices()) {
+    if (std::strcmp(choice.name, kernel) != 0) continue;
+    if (key_length_ != 0 && length != 0) {
+      size_t phase = static_cast<size_t>(offset % key_length_);
+      choice.kernel(buffer, length, expanded_.data(), period_, phase);
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace cyrene
+
+extern "C" {
+
+void* cyrene_xor_create(const uint8_t* key, int32_t key_length) {
+  if (key == nullptr || key_length <= 0) return nullptr;
+  return new cyrene::XorCipher(key, static_cast<size_t>(key_length));
+}
+
+void cyrene_xor_destroy(void* handle) {
+  delete static_cast<cyrene::XorCipher*>(handle);
+}
+
+void cyrene_xor_apply(void* handle, uint8_t* buffer, int64_t length,
+                      int64_t offset) {
+  if (handle == nullptr || buffer == nullptr || length <= 0 || offset < 0) {
+    return;
+  }
+  static_cast<cyrene::XorCipher*>(handle)->Apply(
+      buffer, static_cast<size_t>(length), static_cast<uint64_t>(offset));
+}
+
+}  // extern "C"
@@ -0,0 +1,64 @@
+#ifndef CYRENE_NATIVE_XOR_CIPHER_H_
+#define CYRENE_NATIVE_XOR_CIPHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "native_export.h"
+
+namespace cyrene {
+
+// Repeating-key XOR used by .cyrene payloads and the cache index.
+//
+// The key is expanded once to lcm(key length, kBlockWidth) bytes plus one
+// block of slack, so the vector kernels can load the keystream for any
+// position with a single unaligned load and advance it without a modulo.
+// Apply() picks AVX2 or SSE2 on x86-64, NEON on ARM64 and a scalar loop
+// elsewhere; the choice is made once per process.
+class XorCipher {
+ public:
+  // Bytes processed per kernel iteration.
+  static constexpr size_t kBlockWidth = 64;
+
+  XorCipher(const uint8_t* key, size_t key_length);
+
+  // XORs |length| bytes of |buffer| in place. |offset| is the keystream
+  // position of buffer[0], i.e. its offset within the encrypted stream.
+  void Apply(uint8_t* buffer, size_t length, uint64_t offset) const;
+
+  size_t key_length() const { return key_length_; }
+
+  // Name of the kernel selected for this CPU ("avx2", "sse2", "neon" or
+  // "scalar").
+  static const char* KernelName();
+
+  // Kernels this CPU can run, best first; the last is always "scalar".
+  // For benchmarks and tests, together with ApplyWithKernel().
+  static std::vector<const char*> SupportedKernels();
+
+  // Apply() through the named kernel instead of the selected one. Returns
+  // false, leaving |buffer| untouched, if the kernel is not supported.
+  bool ApplyWithKernel(const char* kernel, uint8_t* buffer, size_t length,
+                       uint64_t offset) const;
+
+ private:
+  size_t key_length_;
+  size_t period_;
+  std::vector<uint8_t> expanded_;
+};
+
+}  // namespace cyrene
+
+extern "C" {
+
+// FFI surface used by lib/native/xor_cipher_native.dart. Handles returned by
+// cyrene_xor_create() must be released with cyrene_xor_destroy().
+CYRENE_EXPORT void* cyrene_xor_create(const uint8_t* key, int32_t key_length);
+CYRENE_EXPORT void cyrene_xor_destroy(void* handle);
+CYRENE_EXPORT void cyrene_xor_apply(void* handle, uint8_t* buffer,
+                                    int64_t length, int64_t offset);
+
+}  // extern "C"
+
+#endif  // CYRENE_NATIVE_XOR_CIPHER_H_
@@ -5,39 +5,94 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace {
 
-std::string WStringToString(const std::wstring& wstr) {
-  if (wstr.empty()) return std::string();
-  int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), 
-                                        NULL, 0, NULL, NULL);
-  std::string strTo(size_needed, 0);
-  WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), 
-                      &strTo[0], size_needed, NULL, NULL);
-  return strTo;
-}
+using flutter::EncodableList;
+using flutter::EncodableMap;
+using flutter::EncodableValue;
 
 std::wstring StringToWString(const std::string& str) {
   if (str.empty()) return std::wstring();
-  int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), 
+  int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(),
                                         NULL, 0);
   std::wstring wstrTo(size_needed, 0);
-  MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), 
+  MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(),
                       &wstrTo[0], size_needed);
   return wstrTo;
 }
 
+// Looks up |key| in a method-call argument map.
+const EncodableValue* Find(const EncodableMap& map, const char* key) {
+  auto it = map.find(EncodableValue(key));
+  return it == map.end() ? nullptr : &it->second;
+}
+
+std::string FindString(const EncodableMap& map, const char* key) {
+  const auto* value = Find(map, key);
+  const auto* text = value ? std::get_if<std::string>(value) : nullptr;
+  return text ? *text : std::string();
+}
+
+bool HasInt(const EncodableMap& map, const char* key) {
+  const auto* value = Find(map, key);
+  return value != nullptr && (std::holds_alternative<int32_t>(*value) ||
+                              std::holds_alternative<int64_t>(*value));
+}
+
+int64_t FindInt(const EncodableMap& map, const char* key) {
+  return HasInt(map, key) ? Find(map, key)->LongValue() : 0;
+}
+
+bool HasBool(const EncodableMap& map, const char* key) {
+  const auto* value = Find(map, key);
+  return value != nullptr && std::holds_alternative<bool>(*value);
+}
+
+// Converts the setLyricDocument payload:
+//   [{time, text, translation?, words?: [{time, duration, text}]}]
+std::vector<cyrene::LyricTimelineLine> ParseLyricDocument(
+    const EncodableList& list) {
+  std::vector<cyrene::LyricTimelineLine> lines;
+  lines.reserve(list.size());
+  for (const auto& item : list) {
+    const auto* map = std::get_if<EncodableMap>(&item);
+    if (map == nullptr) continue;
+
+    cyrene::LyricTimelineLine line;
+    line.start_ms = FindInt(*map, "time");
+    line.text = FindString(*map, "text");
+    line.translation = FindString(*map, "translation");
+    const auto* words = Find(*map, "words");
+    const auto* word_list = words ? std::get_if<EncodableList>(words) : nullptr;
+    if (word_list != nullptr) {
+      for (const auto& word_item : *word_list) {
+        const auto* word_map = std::get_if<EncodableMap>(&word_item);
+        if (word_map == nullptr) continue;
+        cyrene::LyricWord word;
+        word.start_ms = FindInt(*word_map, "time");
+        word.duration_ms = FindInt(*word_map, "duration");
+        word.text = FindString(*word_map, "text");
+        line.words.push_back(std::move(word));
+      }
+    }
+    lines.push_back(std::move(line));
+  }
+  return lines;
+}
+
 }  // namespace
 
 // static
 void DesktopLyricPlugin::RegisterWithRegistrar(
     FlutterDesktopPluginRegistrarRef registrar_ref) {
   // Wrap registrar in PluginRegistrarWindows
-  auto registrar = 
+  auto registrar =
       flutter::PluginRegistrarManager::GetInstance()
           ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar_ref);
-      
+
   auto channel = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
       registrar->messenger(), "desktop_lyric",
       &flutter::StandardMethodCodec::GetInstance());
@@ -52,7 +107,7 @@ void DesktopLyricPlugin::RegisterWithRegistrar(
   // Keep plugin and channel alive - store in static maps
   static std::map<FlutterDesktopPluginRegistrarRef, std::unique_ptr<DesktopLyricPlugin>> plugins;
   static std::map<FlutterDesktopPluginRegistrarRef, std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>>> channels;
-  
+
   plugins[registrar_ref] = std::move(plugin);
   channels[registrar_ref] = std::move(channel);
 }
@@ -64,161 +119,211 @@ DesktopLyricPlugin::DesktopLyricPlugin()
 DesktopLyricPlugin::~DesktopLyricPlugin() {
 }
 
+// static
+const DesktopLyricPlugin::MethodTable& DesktopLyricPlugin::Methods() {
+  // Built once; dispatch is a single hash lookup instead of a chain of
+  // string compares.
+  static const MethodTable table = {
+      {"create", &DesktopLyricPlugin::OnCreate},
+      {"destroy", &DesktopLyricPlugin::OnDestroy},
+      {"show", &DesktopLyricPlugin::OnShow},
+      {"hide", &DesktopLyricPlugin::OnHide},
+      {"isVisible", &DesktopLyricPlugin::OnIsVisible},
+      {"setLyricText", &DesktopLyricPlugin::OnSetLyricText},
+      {"setLyricDocument", &DesktopLyricPlugin::OnSetLyricDocument},
+      {"syncPosition", &DesktopLyricPlugin::OnSyncPosition},
+      {"setPosition", &DesktopLyricPlugin::OnSetPosition},
+      {"getPosition", &DesktopLyricPlugin::OnGetPosition},
+      {"applyStyle", &DesktopLyricPlugin::OnApplyStyle},
+      {"setFontSize", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setTextColor", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setStrokeColor", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setStrokeWidth", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setHighlightColor", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setDraggable", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"setMouseTransparent", &DesktopLyricPlugin::OnSetStyleProperty},
+      {"getRenderStats", &DesktopLyricPlugin::OnGetRenderStats},
+  };
+  return table;
+}
+
 void DesktopLyricPlugin::HandleMethodCall(
     const flutter::MethodCall<flutter::EncodableValue>& method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  const auto& method_name = method_call.method_name();
-
-  if (method_name == "create") {
-    // Create desktop lyric window
-    bool success = lyric_window_->Create();
-    result->Success(flutter::EncodableValue(success));
-    
-  } else if (method_name == "destroy") {
-    // Destroy window
-    lyric_window_->Destroy();
-    result->Success(flutter::EncodableValue(true));
-    
-  } else if (method_name == "show") {
-    // Show window
-    lyric_window_->Show();
-    result->Success(flutter::EncodableValue(true));
-    
-  } else if (method_name == "hide") {
-    // Hide window
-    lyric_window_->Hide();
-    result->Success(flutter::EncodableValue(true));
-    
-  } else if (method_name == "isVisible") {
-    // Check if window is visible
-    bool visible = lyric_window_->IsVisible();
-    result->Success(flutter::EncodableValue(visible));
-    
-  } else if (method_name == "setLyricText") {
-    // Set lyric text
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto text_it = arguments->find(flutter::EncodableValue("text"));
-      if (text_it != arguments->end()) {
-        std::string text = std::get<std::string>(text_it->second);
-        lyric_window_->SetLyricText(StringToWString(text));
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'text' argument");
-    
-  } else if (method_name == "setPosition") {
-    // Set window position
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto x_it = arguments->find(flutter::EncodableValue("x"));
-      auto y_it = arguments->find(flutter::EncodableValue("y"));
-      
-      if (x_it != arguments->end() && y_it != arguments->end()) {
-        int x = std::get<int>(x_it->second);
-        int y = std::get<int>(y_it->second);
-        lyric_window_->SetPosition(x, y);
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'x' or 'y' argument");
-    
-  } else if (method_name == "getPosition") {
-    // Get window position
-    int x, y;
-    lyric_window_->GetPosition(&x, &y);
-    flutter::EncodableMap position;
-    position[flutter::EncodableValue("x")] = flutter::EncodableValue(x);
-    position[flutter::EncodableValue("y")] = flutter::EncodableValue(y);
-    result->Success(flutter::EncodableValue(position));
-    
-  } else if (method_name == "setFontSize") {
-    // Set font size
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto size_it = arguments->find(flutter::EncodableValue("size"));
-      if (size_it != arguments->end()) {
-        int size = std::get<int>(size_it->second);
-        lyric_window_->SetFontSize(size);
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'size' argument");
-    
-  } else if (method_name == "setTextColor") {
-    // Set text color
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto color_it = arguments->find(flutter::EncodableValue("color"));
-      if (color_it != arguments->end()) {
-        int64_t color = std::get<int64_t>(color_it->second);
-        lyric_window_->SetTextColor(static_cast<DWORD>(color));
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'color' argument");
-    
-  } else if (method_name == "setStrokeColor") {
-    // Set stroke color
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto color_it = arguments->find(flutter::EncodableValue("color"));
-      if (color_it != arguments->end()) {
-        int64_t color = std::get<int64_t>(color_it->second);
-        lyric_window_->SetStrokeColor(static_cast<DWORD>(color));
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'color' argument");
-    
-  } else if (method_name == "setStrokeWidth") {
-    // Set stroke width
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto width_it = arguments->find(flutter::EncodableValue("width"));
-      if (width_it != arguments->end()) {
-        int width = std::get<int>(width_it->second);
-        lyric_window_->SetStrokeWidth(width);
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'width' argument");
-    
-  } else if (method_name == "setDraggable") {
-    // Set draggable
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto draggable_it = arguments->find(flutter::EncodableValue("draggable"));
-      if (draggable_it != arguments->end()) {
-        bool draggable = std::get<bool>(draggable_it->second);
-        lyric_window_->SetDraggable(draggable);
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
-    }
-    result->Error("INVALID_ARGUMENT", "Missing 'draggable' argument");
-    
-  } else if (method_name == "setMouseTransparent") {
-    // Set mouse transparent
-    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
-    if (arguments) {
-      auto transparent_it = arguments->find(flutter::EncodableValue("transparent"));
-      if (transparent_it != arguments->end()) {
-        bool transparent = std::get<bool>(transparent_it->second);
-        lyric_window_->SetMouseTransparent(transparent);
-        result->Success(flutter::EncodableValue(true));
-        return;
-      }
+  const auto& methods = Methods();
+  auto it = methods.find(method_call.method_name());
+  if (it == methods.end()) {
+    result->NotImplemented();
+    return;
+  }
+  (this->*(it->second))(method_call, *result);
+}
+
+void DesktopLyricPlugin::OnCreate(const MethodCall& call, MethodResult& result) {
+  // Create desktop lyric window
+  bool success = lyric_window_->Create();
+  result.Success(EncodableValue(success));
+}
+
+void DesktopLyricPlugin::OnDestroy(const MethodCall& call, MethodResult& result) {
+  // Destroy window
+  lyric_window_->Destroy();
+  result.Success(EncodableValue(true));
+}
+
+void DesktopLyricPlugin::OnShow(const MethodCall& call, MethodResult& result) {
+  // Show window
+  lyric_window_->Show();
+  result.Success(EncodableValue(true));
+}
+
+void DesktopLyricPlugin::OnHide(const MethodCall& call, MethodResult& result) {
+  // Hide window
+  lyric_window_->Hide();
+  result.Success(EncodableValue(true));
+}
+
+void DesktopLyricPlugin::OnIsVisible(const MethodCall& call, MethodResult& result) {
+  // Check if window is visible
+  result.Success(EncodableValue(lyric_window_->IsVisible()));
+}
+
+void DesktopLyricPlugin::OnSetLyricText(const MethodCall& call, MethodResult& result) {
+  // Set lyric text
+  const auto* arguments = std::get_if<EncodableMap>(call.arguments());
+  if (arguments && Find(*arguments, "text")) {
+    lyric_window_->SetLyricText(StringToWString(FindString(*arguments, "text")));
+    result.Success(EncodableValue(true));
+    return;
+  }
+  result.Error("INVALID_ARGUMENT", "Missing 'text' argument");
+}
+
+void DesktopLyricPlugin::OnSetLyricDocument(const MethodCall& call, MethodResult& result) {
+  // Load a whole timed lyric document for native karaoke
+  const auto* arguments = std::get_if<EncodableMap>(call.arguments());
+  if (arguments) {
+    const auto* lines = Find(*arguments, "lines");
+    const auto* line_list = lines ? std::get_if<EncodableList>(lines) : nullptr;
+    if (line_list) {
+      lyric_window_->SetLyricDocument(ParseLyricDocument(*line_list));
+      result.Success(EncodableValue(true));
+      return;
     }
-    result->Error("INVALID_ARGUMENT", "Missing 'transparent' argument");
-    
+  }
+  result.Error("INVALID_ARGUMENT", "Missing 'lines' argument");
+}
+
+void DesktopLyricPlugin::OnSyncPosition(const MethodCall& call, MethodResult& result) {
+  // Playback position sync for the karaoke clock
+  const auto* arguments = std::get_if<EncodableMap>(call.arguments());
+  if (arguments && HasInt(*arguments, "position")) {
+    bool playing = HasBool(*arguments, "playing") &&
+                   std::get<bool>(*Find(*arguments, "playing"));
+    lyric_window_->SyncPosition(FindInt(*arguments, "position"), playing);
+    result.Success(EncodableValue(true));
+    return;
+  }
+  result.Error("INVALID_ARGUMENT", "Missing 'position' argument");
+}
+
+void DesktopLyricPlugin::OnSetPosition(const MethodCall& call, MethodResult& result) {
+  // Set window position
+  const auto* arguments = std::get_if<EncodableMap>(call.arguments());
+  if (arguments && HasInt(*arguments, "x") && HasInt(*arguments, "y")) {
+    lyric_window_->SetPosition(static_cast<int>(FindInt(*arguments, "x")),
+                               static_cast<int>(FindInt(*arguments, "y")));
+    result.Success(EncodableValue(true));
+    return;
+  }
+  result.Error("INVALID_ARGUMENT", "Missing 'x' or 'y' argument");
+}
+
+void DesktopLyricPlugin::OnGetPosition(const MethodCall& call, MethodResult& result) {
+  // Get window position
+  int x = 0, y = 0;
+  lyric_window_->GetPosition(&x, &y);
+  EncodableMap position;
+  position[EncodableValue("x")] = EncodableValue(x);
+  position[EncodableValue("y")] = EncodableValue(y);
+  result.Success(EncodableValue(position));
+}
+
+void DesktopLyricPlugin::OnApplyStyle(const MethodCall& call, MethodResult& result) {
+  // Apply a packed style update (see native/lyric_style.h) with one redraw
+  const auto* bytes = std::get_if<std::vector<uint8_t>>(call.arguments());
+  cyrene::LyricStyleUpdate update;
+  if (bytes && cyrene::DecodeLyricStyle(bytes->data(), bytes->size(), &update)) {
+    lyric_window_->ApplyStyle(update);
+    result.Success(EncodableValue(true));
+    return;
+  }
+  result.Error("INVALID_ARGUMENT", "Malformed style update");
+}
+
+void DesktopLyricPlugin::OnSetStyleProperty(const MethodCall& call, MethodResult& result) {
+  // Single-property setters, kept for older callers: each maps onto a
+  // one-field style update.
+  struct Property {
+    const char* argument;
+    uint16_t field;
+    bool is_bool;
+  };
+  static const std::unordered_map<std::string, Property> properties = {
+      {"setFontSize", {"size", cyrene::kLyricStyleFontSize, false}},
+      {"setTextColor", {"color", cyrene::kLyricStyleTextColor, false}},
+      {"setStrokeColor", {"color", cyrene::kLyricStyleStrokeColor, false}},
+      {"setStrokeWidth", {"width", cyrene::kLyricStyleStrokeWidth, false}},
+      {"setHighlightColor",
+       {"color", cyrene::kLyricStyleHighlightColor, false}},
+      {"setDraggable", {"draggable", cyrene::kLyricStyleDraggable, true}},
+      {"setMouseTransparent",
+       {"transparent", cyrene::kLyricStyleMouseTransparent, true}},
+  };
+  const Property& property = properties.at(call.method_name());
+
+  const auto* arguments = std::get_if<EncodableMap>(call.arguments());
+  bool present = arguments && (property.is_bool
+                                   ? HasBool(*arguments, property.argument)
+                                   : HasInt(*arguments, property.argument));
+  if (!present) {
+    result.Error("INVALID_ARGUMENT",
+                 std::string("Missing '") + property.argument + "' argument");
+    return;
+  }
+
+  cyrene::LyricStyleUpdate update;
+  update.fields = property.field;
+  cyrene::LyricStyle& values = update.values;
+  if (property.is_bool) {
+    bool flag = std::get<bool>(*Find(*arguments, property.argument));
+    values.draggable = flag;
+    values.mouse_transparent = flag;
   } else {
-    result->NotImplemented();
+    int64_t number = FindInt(*arguments, property.argument);
+    values.font_size = static_cast<int32_t>(number);
+    values.stroke_width = static_cast<int32_t>(number);
+    values.text_color = static_cast<uint32_t>(number);
+    values.stroke_color = static_cast<uint32_t>(number);
+    values.highlight_color = static_cast<uint32_t>(number);
   }
+  lyric_window_->ApplyStyle(update);
+  result.Success(EncodableValue(true));
+}
+
+void DesktopLyricPlugin::OnGetRenderStats(const MethodCall& call, MethodResult& result) {
+  // Frame times and glyph cache counters, for diagnostics
+  const auto& frames = lyric_window_->frame_stats();
+  const auto& cache = lyric_window_->glyph_cache();
+  EncodableMap stats;
+  stats[EncodableValue("frames")] =
+      EncodableValue(static_cast<int64_t>(frames.frames()));
+  stats[EncodableValue("lastFrameUs")] = EncodableValue(frames.last_us());
+  stats[EncodableValue("averageFrameUs")] = EncodableValue(frames.average_us());
+  stats[EncodableValue("maxFrameUs")] = EncodableValue(frames.max_us());
+  stats[EncodableValue("glyphBuilds")] =
+      EncodableValue(static_cast<int64_t>(cache.builds()));
+  stats[EncodableValue("glyphHits")] =
+      EncodableValue(static_cast<int64_t>(cache.hits()));
+  result.Success(EncodableValue(stats));
 }
@@ -5,6 +5,8 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "desktop_lyric_window.h"
 
@@ -22,6 +24,29 @@ class DesktopLyricPlugin {
       const flutter::MethodCall<flutter::EncodableValue>& method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  using MethodCall = flutter::MethodCall<flutter::EncodableValue>;
+  using MethodResult = flutter::MethodResult<flutter::EncodableValue>;
+  using Handler = void (DesktopLyricPlugin::*)(const MethodCall& call,
+                                               MethodResult& result);
+  using MethodTable = std::unordered_map<std::string, Handler>;
+
+  // Method name -> handler, built on first use
+  static const MethodTable& Methods();
+
+  void OnCreate(const MethodCall& call, MethodResult& result);
+  void OnDestroy(const MethodCall& call, MethodResult& result);
+  void OnShow(const MethodCall& call, MethodResult& result);
+  void OnHide(const MethodCall& call, MethodResult& result);
+  void OnIsVisible(const MethodCall& call, MethodResult& result);
+  void OnSetLyricText(const MethodCall& call, MethodResult& result);
+  void OnSetLyricDocument(const MethodCall& call, MethodResult& result);
+  void OnSyncPosition(const MethodCall& call, MethodResult& result);
+  void OnSetPosition(const MethodCall& call, MethodResult& result);
+  void OnGetPosition(const MethodCall& call, MethodResult& result);
+  void OnApplyStyle(const MethodCall& call, MethodResult& result);
+  void OnSetStyleProperty(const MethodCall& call, MethodResult& result);
+  void OnGetRenderStats(const MethodCall& call, MethodResult& result);
+
   std::unique_ptr<DesktopLyricWindow> lyric_window_;
 };
 
@@ -2,18 +2,66 @@
 #include <dwmapi.h>
 #include <gdiplus.h>
 #include <algorithm>
+#include <cmath>
 
 #pragma comment(lib, "dwmapi.lib")
 #pragma comment(lib, "gdiplus.lib")
 
 namespace {
 const wchar_t kWindowClassName[] = L"DESKTOP_LYRIC_WINDOW";
-const int kDefaultFontSize = 32;
-const DWORD kDefaultTextColor = 0xFFFFFFFF;  // White
-const DWORD kDefaultStrokeColor = 0xFF000000;  // Black
-const int kDefaultStrokeWidth = 2;
 const int kWindowWidth = 800;
 const int kWindowHeight = 100;
+const wchar_t kFontFamily[] = L"Microsoft YaHei";
+// Lines kept in the glyph cache (current line, previous one, repeats)
+const size_t kGlyphCacheSize = 16;
+// Karaoke frame timer: ~60 fps (USER timers round to the tick anyway)
+const UINT_PTR kKaraokeTimerId = 1;
+const UINT kKaraokeFrameMs = 16;
+// Glyph key style bit for the two-row karaoke layout
+const int kKaraokeLayoutStyle = 1 << 16;
+// Translation row height and font scale in karaoke layout
+const float kTranslationRowRatio = 0.4f;
+const float kTranslationFontRatio = 0.6f;
+
+Gdiplus::Color ToGdiplusColor(DWORD argb) {
+  return Gdiplus::Color((argb >> 24) & 0xFF,  // A
+                        (argb >> 16) & 0xFF,  // R
+                        (argb >> 8) & 0xFF,   // G
+                        argb & 0xFF);         // B
+}
+
+std::wstring FromUtf8(const std::string& text) {
+  if (text.empty()) return std::wstring();
+  int size = MultiByteToWideChar(CP_UTF8, 0, text.data(),
+                                 static_cast<int>(text.size()), nullptr, 0);
+  std::wstring result(size, 0);
+  MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                      &result[0], size);
+  return result;
+}
+
+// Pixel bounds of |path| (as drawn), padded by a pixel for anti-aliasing.
+cyrene::LyricRect PathBounds(Gdiplus::GraphicsPath* path) {
+  Gdiplus::RectF bounds;
+  path->GetBounds(&bounds);
+  cyrene::LyricRect rect;
+  rect.left = static_cast<int>(std::floor(bounds.X)) - 1;
+  rect.top = static_cast<int>(std::floor(bounds.Y)) - 1;
+  rect.right = static_cast<int>(std::ceil(bounds.X + bounds.Width)) + 1;
+  rect.bottom = static_cast<int>(std::ceil(bounds.Y + bounds.Height)) + 1;
+  return rect;
+}
+
+std::string ToUtf8(const std::wstring& text) {
+  if (text.empty()) return std::string();
+  int size = WideCharToMultiByte(CP_UTF8, 0, text.data(),
+                                 static_cast<int>(text.size()), nullptr, 0,
+                                 nullptr, nullptr);
+  std::string result(size, 0);
+  WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                      &result[0], size, nullptr, nullptr);
+  return result;
+}
 
 // GDI+ initialization
 ULONG_PTR gdiplusToken = 0;
@@ -37,13 +85,14 @@ void ShutdownGdiPlus() {
 DesktopLyricWindow::DesktopLyricWindow()
     : hwnd_(nullptr),
       lyric_text_(L""),
-      font_size_(kDefaultFontSize),
-      text_color_(kDefaultTextColor),
-      stroke_color_(kDefaultStrokeColor),
-      stroke_width_(kDefaultStrokeWidth),
-      is_draggable_(true),
       is_dragging_(false),
-      font_(nullptr) {
+      font_(nullptr),
+      mem_dc_(nullptr),
+      bitmap_(nullptr),
+      old_bitmap_(nullptr),
+      highlight_x_(-1),
+      timer_running_(false),
+      glyph_cache_(kGlyphCacheSize) {
   InitGdiPlus();
 }
 
@@ -97,17 +146,25 @@ bool DesktopLyricWindow::Create() {
   // Save this pointer
   SetWindowLongPtr(hwnd_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
 
+  UpdateMouseTransparency();
+
   // Create font
   font_ = CreateFont(
-      font_size_, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+      style_.font_size, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
       DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
       ANTIALIASED_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
       L"Microsoft YaHei");
 
-  return true;
+  return CreateSurface();
 }
 
 void DesktopLyricWindow::Destroy() {
+  if (timer_running_) {
+    KillTimer(hwnd_, kKaraokeTimerId);
+    timer_running_ = false;
+  }
+  DestroySurface();
+
   if (hwnd_ != nullptr) {
     DestroyWindow(hwnd_);
     hwnd_ = nullptr;
@@ -121,14 +178,18 @@ void DesktopLyricWindow::Destroy() {
 
 void DesktopLyricWindow::Show() {
   if (hwnd_ != nullptr) {
+    dirty_.InvalidateAll();
     UpdateWindow();
     ShowWindow(hwnd_, SW_SHOWNOACTIVATE);
+    Tick();
+    UpdateTimer();
   }
 }
 
 void DesktopLyricWindow::Hide() {
   if (hwnd_ != nullptr) {
     ShowWindow(hwnd_, SW_HIDE);
+    UpdateTimer();
   }
 }
 
@@ -137,10 +198,85 @@ bool DesktopLyricWindow::IsVisible() const {
 }
 
 void DesktopLyricWindow::SetLyricText(const std::wstring& text) {
+  bool was_karaoke = !timeline_.empty();
+  if (was_karaoke) {
+    timeline_.Clear();
+    karaoke_ = cyrene::KaraokeFrame();
+    UpdateTimer();
+  }
+  if (text == lyric_text_ && !was_karaoke) {
+    return;
+  }
+  SetDisplayText(text);
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::SetDisplayText(const std::wstring& text) {
   lyric_text_ = text;
+  lyric_text_utf8_ = ToUtf8(text);
+}
+
+void DesktopLyricWindow::SetLyricDocument(
+    std::vector<cyrene::LyricTimelineLine> lines) {
+  timeline_.SetLines(std::move(lines));
+  karaoke_ = cyrene::KaraokeFrame();
+  SetDisplayText(std::wstring());
   if (IsVisible()) {
     UpdateWindow();
   }
+  Tick();
+  UpdateTimer();
+}
+
+void DesktopLyricWindow::SyncPosition(int64_t position_ms, bool playing) {
+  clock_.Sync(position_ms, playing, cyrene::LyricClock::Clock::now());
+  Tick();
+  UpdateTimer();
+}
+
+void DesktopLyricWindow::Tick() {
+  if (timeline_.empty()) {
+    return;
+  }
+
+  cyrene::KaraokeFrame frame = timeline_.FrameAt(
+      clock_.PositionAt(cyrene::LyricClock::Clock::now()));
+  if (frame == karaoke_) {
+    return;
+  }
+  if (frame.line != karaoke_.line) {
+    std::wstring text;
+    if (frame.line >= 0) {
+      const cyrene::LyricTimelineLine& line = timeline_.line(frame.line);
+      text = FromUtf8(line.text);
+      if (!line.translation.empty()) {
+        text += L"\n" + FromUtf8(line.translation);
+      }
+    }
+    SetDisplayText(text);
+  }
+  karaoke_ = frame;
+
+  // Sub-pixel progress steps are absorbed by UpdateWindow's dirty check.
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::UpdateTimer() {
+  bool want = hwnd_ != nullptr && IsVisible() && !timeline_.empty() &&
+              clock_.playing();
+  if (want == timer_running_) {
+    return;
+  }
+  if (want) {
+    SetTimer(hwnd_, kKaraokeTimerId, kKaraokeFrameMs, nullptr);
+  } else if (hwnd_ != nullptr) {
+    KillTimer(hwnd_, kKaraokeTimerId);
+  }
+  timer_running_ = want;
 }
 
 void DesktopLyricWindow::SetPosition(int x, int y) {
@@ -160,54 +296,94 @@ void DesktopLyricWindow::GetPosition(int* x, int* y) {
 }
 
 void DesktopLyricWindow::SetFontSize(int size) {
-  font_size_ = size;
-  
-  // Recreate font
-  if (font_ != nullptr) {
-    DeleteObject(font_);
-  }
-  
-  font_ = CreateFont(
-      font_size_, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
-      DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-      ANTIALIASED_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
-      L"Microsoft YaHei");
-  
-  if (IsVisible()) {
-    UpdateWindow();
-  }
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleFontSize;
+  update.values.font_size = size;
+  ApplyStyle(update);
 }
 
 void DesktopLyricWindow::SetTextColor(DWORD color) {
-  text_color_ = color;
-  if (IsVisible()) {
-    UpdateWindow();
-  }
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleTextColor;
+  update.values.text_color = color;
+  ApplyStyle(update);
 }
 
 void DesktopLyricWindow::SetStrokeColor(DWORD color) {
-  stroke_color_ = color;
-  if (IsVisible()) {
-    UpdateWindow();
-  }
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleStrokeColor;
+  update.values.stroke_color = color;
+  ApplyStyle(update);
+}
+
+void DesktopLyricWindow::SetHighlightColor(DWORD color) {
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleHighlightColor;
+  update.values.highlight_color = color;
+  ApplyStyle(update);
 }
 
 void DesktopLyricWindow::SetStrokeWidth(int width) {
-  stroke_width_ = width;
-  if (IsVisible()) {
-    UpdateWindow();
-  }
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleStrokeWidth;
+  update.values.stroke_width = width;
+  ApplyStyle(update);
 }
 
 void DesktopLyricWindow::SetDraggable(bool draggable) {
-  is_draggable_ = draggable;
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleDraggable;
+  update.values.draggable = draggable;
+  ApplyStyle(update);
 }
 
 void DesktopLyricWindow::SetMouseTransparent(bool transparent) {
+  cyrene::LyricStyleUpdate update;
+  update.fields = cyrene::kLyricStyleMouseTransparent;
+  update.values.mouse_transparent = transparent;
+  ApplyStyle(update);
+}
+
+void DesktopLyricWindow::ApplyStyle(const cyrene::LyricStyleUpdate& update) {
+  cyrene::LyricRedraw redraw = cyrene::ApplyLyricStyle(update, &style_);
+
+  if (update.fields & cyrene::kLyricStyleMouseTransparent) {
+    UpdateMouseTransparency();
+  }
+
+  if (redraw == cyrene::LyricRedraw::kNone) {
+    return;
+  }
+
+  if (redraw == cyrene::LyricRedraw::kRelayout && font_ != nullptr) {
+    // Recreate font
+    DeleteObject(font_);
+    font_ = CreateFont(
+        style_.font_size, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE,
+        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+        ANTIALIASED_QUALITY, DEFAULT_PITCH | FF_DONTCARE,
+        L"Microsoft YaHei");
+  }
+
+  if (text_brush_) {
+    text_brush_->SetColor(ToGdiplusColor(style_.text_color));
+    stroke_brush_->SetColor(ToGdiplusColor(style_.stroke_color));
+    highlight_brush_->SetColor(ToGdiplusColor(style_.highlight_color));
+  }
+
+  // One redraw however many properties changed. A relayout changes the
+  // glyph key, so UpdateWindow also picks up the new bounds.
+  dirty_.InvalidateContent();
+  if (IsVisible()) {
+    UpdateWindow();
+  }
+}
+
+void DesktopLyricWindow::UpdateMouseTransparency() {
   if (hwnd_ == nullptr) return;
   
   LONG exStyle = GetWindowLong(hwnd_, GWL_EXSTYLE);
-  if (transparent) {
+  if (style_.mouse_transparent) {
     exStyle |= WS_EX_TRANSPARENT;
   } else {
     exStyle &= ~WS_EX_TRANSPARENT;
@@ -215,14 +391,13 @@ void DesktopLyricWindow::SetMouseTransparent(bool transparent) {
   SetWindowLong(hwnd_, GWL_EXSTYLE, exStyle);
 }
 
-void DesktopLyricWindow::UpdateWindow() {
-  if (hwnd_ == nullptr) return;
+bool DesktopLyricWindow::CreateSurface() {
+  if (mem_dc_ != nullptr) {
+    return true;
+  }
 
-  // Create memory DC
-  HDC hdc_screen = GetDC(nullptr);
-  HDC hdc_mem = CreateCompatibleDC(hdc_screen);
-  
-  // Create 32-bit bitmap
+  // 32-bit top-down DIB, kept selected into the memory DC for the lifetime
+  // of the window so frames only repaint what changed.
   BITMAPINFO bmi = {};
   bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
   bmi.bmiHeader.biWidth = kWindowWidth;
@@ -230,93 +405,212 @@ void DesktopLyricWindow::UpdateWindow() {
   bmi.bmiHeader.biPlanes = 1;
   bmi.bmiHeader.biBitCount = 32;
   bmi.bmiHeader.biCompression = BI_RGB;
-  
+
+  mem_dc_ = CreateCompatibleDC(nullptr);
+  if (mem_dc_ == nullptr) {
+    return false;
+  }
   void* bits = nullptr;
-  HBITMAP hbm = CreateDIBSection(hdc_mem, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
-  HBITMAP hbm_old = (HBITMAP)SelectObject(hdc_mem, hbm);
-  
-  // Draw lyric
-  DrawLyric(hdc_mem, kWindowWidth, kWindowHeight);
-  
-  // Update layered window
+  bitmap_ = CreateDIBSection(mem_dc_, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+  if (bitmap_ == nullptr) {
+    DestroySurface();
+    return false;
+  }
+  old_bitmap_ = SelectObject(mem_dc_, bitmap_);
+
+  graphics_ = std::make_unique<Gdiplus::Graphics>(mem_dc_);
+  graphics_->SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
+  graphics_->SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
+  graphics_->Clear(Gdiplus::Color(0, 0, 0, 0));
+
+  font_family_ = std::make_unique<Gdiplus::FontFamily>(kFontFamily);
+  string_format_ = std::make_unique<Gdiplus::StringFormat>();
+  string_format_->SetAlignment(Gdiplus::StringAlignmentCenter);
+  string_format_->SetLineAlignment(Gdiplus::StringAlignmentCenter);
+  text_brush_ = std::make_unique<Gdiplus::SolidBrush>(
+      ToGdiplusColor(style_.text_color));
+  stroke_brush_ = std::make_unique<Gdiplus::SolidBrush>(
+      ToGdiplusColor(style_.stroke_color));
+  highlight_brush_ = std::make_unique<Gdiplus::SolidBrush>(
+      ToGdiplusColor(style_.highlight_color));
+
+  highlight_x_ = -1;
+  dirty_.Reset(kWindowWidth, kWindowHeight);
+  return true;
+}
+
+void DesktopLyricWindow::DestroySurface() {
+  // GDI+ objects must go before GdiplusShutdown and before their DC.
+  glyph_cache_.Clear();
+  highlight_brush_.reset();
+  stroke_brush_.reset();
+  text_brush_.reset();
+  string_format_.reset();
+  font_family_.reset();
+  graphics_.reset();
+
+  if (mem_dc_ != nullptr) {
+    if (old_bitmap_ != nullptr) {
+      SelectObject(mem_dc_, old_bitmap_);
+      old_bitmap_ = nullptr;
+    }
+    DeleteDC(mem_dc_);
+    mem_dc_ = nullptr;
+  }
+  if (bitmap_ != nullptr) {
+    DeleteObject(bitmap_);
+    bitmap_ = nullptr;
+  }
+}
+
+cyrene::GlyphKey DesktopLyricWindow::CurrentGlyphKey() const {
+  bool karaoke = karaoke_.line >= 0;
+
+  cyrene::GlyphKey key;
+  key.text = lyric_text_utf8_;
+  key.font_family = "Microsoft YaHei";
+  key.font_size = static_cast<float>(style_.font_size);
+  key.stroke_width = static_cast<float>(style_.stroke_width);
+  key.style = Gdiplus::FontStyleBold | (karaoke ? kKaraokeLayoutStyle : 0);
+  return key;
+}
+
+const LyricGlyphs& DesktopLyricWindow::CurrentGlyphs(
+    const cyrene::GlyphKey& key) {
+  bool karaoke = karaoke_.line >= 0;
+  return glyph_cache_.Get(key, [this, karaoke]() {
+    LyricGlyphs glyphs;
+    Gdiplus::REAL width = static_cast<Gdiplus::REAL>(kWindowWidth);
+    Gdiplus::REAL height = static_cast<Gdiplus::REAL>(kWindowHeight);
+    Gdiplus::REAL size = static_cast<Gdiplus::REAL>(style_.font_size);
+    glyphs.fill = std::make_unique<Gdiplus::GraphicsPath>();
+
+    if (!karaoke) {
+      Gdiplus::RectF layout_rect(0, 0, width, height);
+      glyphs.fill->AddString(lyric_text_.c_str(), -1, font_family_.get(),
+                             Gdiplus::FontStyleBold, size, layout_rect,
+                             string_format_.get());
+    } else {
+      // Sung line on top, smaller translation underneath. The line gets its
+      // own path so the highlight can be filled over it alone.
+      const cyrene::LyricTimelineLine& line = timeline_.line(karaoke_.line);
+      std::wstring text = FromUtf8(line.text);
+      std::wstring translation = FromUtf8(line.translation);
+      Gdiplus::REAL line_height =
+          translation.empty() ? height : height * (1 - kTranslationRowRatio);
+
+      glyphs.line = std::make_unique<Gdiplus::GraphicsPath>();
+      glyphs.line->AddString(text.c_str(), -1, font_family_.get(),
+                             Gdiplus::FontStyleBold, size,
+                             Gdiplus::RectF(0, 0, width, line_height),
+                             string_format_.get());
+      glyphs.line_bounds = PathBounds(glyphs.line.get());
+      glyphs.fill->AddPath(glyphs.line.get(), FALSE);
+      if (!translation.empty()) {
+        glyphs.fill->AddString(
+            translation.c_str(), -1, font_family_.get(),
+            Gdiplus::FontStyleBold, size * kTranslationFontRatio,
+            Gdiplus::RectF(0, line_height, width, height - line_height),
+            string_format_.get());
+      }
+    }
+
+    // Widening once here turns every later stroke into a plain fill.
+    Gdiplus::GraphicsPath* outer = glyphs.fill.get();
+    if (style_.stroke_width > 0) {
+      Gdiplus::Pen pen(Gdiplus::Color(255, 0, 0, 0),
+                       static_cast<Gdiplus::REAL>(style_.stroke_width));
+      pen.SetLineJoin(Gdiplus::LineJoinRound);
+      glyphs.stroke.reset(glyphs.fill->Clone());
+      glyphs.stroke->Widen(&pen);
+      outer = glyphs.stroke.get();
+    }
+    glyphs.bounds = PathBounds(outer);
+    return glyphs;
+  });
+}
+
+void DesktopLyricWindow::UpdateWindow() {
+  if (hwnd_ == nullptr || mem_dc_ == nullptr) return;
+
+  cyrene::ScopedFrameTimer frame_timer(&frame_stats_);
+
+  cyrene::GlyphKey key;
+  const LyricGlyphs* glyphs = nullptr;
+  if (!lyric_text_.empty()) {
+    key = CurrentGlyphKey();
+    glyphs = &CurrentGlyphs(key);
+  }
+  dirty_.SetContent(glyphs != nullptr ? glyphs->bounds : cyrene::LyricRect{},
+                    key);
+
+  // Karaoke: repaint only the strip the highlight edge moved across.
+  int highlight_x = -1;
+  if (glyphs != nullptr && glyphs->line) {
+    const cyrene::LyricRect& line = glyphs->line_bounds;
+    highlight_x = line.left + static_cast<int>(std::lround(
+                                  karaoke_.progress * line.width()));
+  }
+  if (highlight_x != highlight_x_) {
+    if (glyphs != nullptr && glyphs->line) {
+      int from = highlight_x_ < 0 ? glyphs->line_bounds.left : highlight_x_;
+      dirty_.Invalidate({std::min(from, highlight_x) - 1,
+                         glyphs->line_bounds.top,
+                         std::max(from, highlight_x) + 1,
+                         glyphs->line_bounds.bottom});
+    }
+    highlight_x_ = highlight_x;
+  }
+
+  if (!dirty_.HasDirty()) {
+    return;  // Nothing visible changed
+  }
+  cyrene::LyricRect dirty = dirty_.Take();
+
+  DrawLyric(glyphs, dirty);
+  GdiFlush();
+
+  // Push only the dirty rectangle to the compositor.
   POINT pt_src = {0, 0};
   SIZE size = {kWindowWidth, kWindowHeight};
   BLENDFUNCTION blend = {AC_SRC_OVER, 0, 255, AC_SRC_ALPHA};
-  
-  UpdateLayeredWindow(hwnd_, hdc_screen, nullptr, &size, hdc_mem, &pt_src,
-                      0, &blend, ULW_ALPHA);
-  
-  // Cleanup
-  SelectObject(hdc_mem, hbm_old);
-  DeleteObject(hbm);
-  DeleteDC(hdc_mem);
-  ReleaseDC(nullptr, hdc_screen);
-}
-
-void DesktopLyricWindow::DrawLyric(HDC hdc, int width, int height) {
-  // Use GDI+ to draw text (better anti-aliasing and stroke)
-  Gdiplus::Graphics graphics(hdc);
-  graphics.SetSmoothingMode(Gdiplus::SmoothingModeAntiAlias);
-  graphics.SetTextRenderingHint(Gdiplus::TextRenderingHintAntiAlias);
-  
-  // Clear background (transparent)
-  graphics.Clear(Gdiplus::Color(0, 0, 0, 0));
-  
-  if (lyric_text_.empty()) {
-    return;
-  }
-  
-  // Create font
-  Gdiplus::FontFamily fontFamily(L"Microsoft YaHei");
-  Gdiplus::Font font(&fontFamily, static_cast<Gdiplus::REAL>(font_size_), 
-                     Gdiplus::FontStyleBold, Gdiplus::UnitPixel);
-  
-  // Measure text size
-  Gdiplus::RectF layoutRect(0, 0, static_cast<Gdiplus::REAL>(width), 
-                             static_cast<Gdiplus::REAL>(height));
-  Gdiplus::RectF boundRect;
-  Gdiplus::StringFormat format;
-  format.SetAlignment(Gdiplus::StringAlignmentCenter);
-  format.SetLineAlignment(Gdiplus::StringAlignmentCenter);
-  
-  graphics.MeasureString(lyric_text_.c_str(), -1, &font, layoutRect, &format, &boundRect);
-  
-  // Draw stroke (multiple draws to simulate stroke effect)
-  if (stroke_width_ > 0) {
-    Gdiplus::GraphicsPath path;
-    Gdiplus::FontFamily fontFamilyPath(L"Microsoft YaHei");
-    path.AddString(lyric_text_.c_str(), -1, &fontFamilyPath, 
-                   Gdiplus::FontStyleBold, static_cast<Gdiplus::REAL>(font_size_),
-                   layoutRect, &format);
-    
-    Gdiplus::Pen stroke_pen(Gdiplus::Color(
-        (stroke_color_ >> 24) & 0xFF,  // A
-        (stroke_color_ >> 16) & 0xFF,  // R
-        (stroke_color_ >> 8) & 0xFF,   // G
-        stroke_color_ & 0xFF           // B
-    ), static_cast<Gdiplus::REAL>(stroke_width_));
-    
-    stroke_pen.SetLineJoin(Gdiplus::LineJoinRound);
-    graphics.DrawPath(&stroke_pen, &path);
-    
-    // Fill text
-    Gdiplus::SolidBrush text_brush(Gdiplus::Color(
-        (text_color_ >> 24) & 0xFF,  // A
-        (text_color_ >> 16) & 0xFF,  // R
-        (text_color_ >> 8) & 0xFF,   // G
-        text_color_ & 0xFF           // B
-    ));
-    graphics.FillPath(&text_brush, &path);
-  } else {
-    // No stroke, draw text directly
-    Gdiplus::SolidBrush text_brush(Gdiplus::Color(
-        (text_color_ >> 24) & 0xFF,
-        (text_color_ >> 16) & 0xFF,
-        (text_color_ >> 8) & 0xFF,
-        text_color_ & 0xFF
-    ));
-    graphics.DrawString(lyric_text_.c_str(), -1, &font, layoutRect, &format, &text_brush);
+  RECT dirty_rect = {dirty.left, dirty.top, dirty.right, dirty.bottom};
+
+  UPDATELAYEREDWINDOWINFO info = {};
+  info.cbSize = sizeof(info);
+  info.psize = &size;
+  info.hdcSrc = mem_dc_;
+  info.pptSrc = &pt_src;
+  info.pblend = &blend;
+  info.dwFlags = ULW_ALPHA;
+  info.prcDirty = &dirty_rect;
+  UpdateLayeredWindowIndirect(hwnd_, &info);
+}
+
+void DesktopLyricWindow::DrawLyric(const LyricGlyphs* glyphs,
+                                   const cyrene::LyricRect& dirty) {
+  // Clear background (transparent) inside the dirty rectangle only
+  graphics_->SetClip(Gdiplus::Rect(dirty.left, dirty.top, dirty.width(),
+                                   dirty.height()));
+  graphics_->Clear(Gdiplus::Color(0, 0, 0, 0));
+
+  if (glyphs != nullptr) {
+    if (glyphs->stroke) {
+      graphics_->FillPath(stroke_brush_.get(), glyphs->stroke.get());
+    }
+    graphics_->FillPath(text_brush_.get(), glyphs->fill.get());
+
+    if (glyphs->line && highlight_x_ > glyphs->line_bounds.left) {
+      const cyrene::LyricRect& line = glyphs->line_bounds;
+      graphics_->SetClip(
+          Gdiplus::Rect(line.left, line.top, highlight_x_ - line.left,
+                        line.height()),
+          Gdiplus::CombineModeIntersect);
+      graphics_->FillPath(highlight_brush_.get(), glyphs->line.get());
+    }
   }
+
+  graphics_->ResetClip();
 }
 
 LRESULT CALLBACK DesktopLyricWindow::WndProc(HWND hwnd, UINT message,
@@ -330,7 +624,7 @@ LRESULT CALLBACK DesktopLyricWindow::WndProc(HWND hwnd, UINT message,
   
   switch (message) {
     case WM_LBUTTONDOWN: {
-      if (window->is_draggable_) {
+      if (window->style_.draggable) {
         window->is_dragging_ = true;
         window->drag_point_.x = LOWORD(lparam);
         window->drag_point_.y = HIWORD(lparam);
@@ -364,6 +658,13 @@ LRESULT CALLBACK DesktopLyricWindow::WndProc(HWND hwnd, UINT message,
       return 0;
     }
     
+    case WM_TIMER: {
+      if (wparam == kKaraokeTimerId) {
+        window->Tick();
+      }
+      return 0;
+    }
+    
     case WM_DESTROY: {
       PostQuitMessage(0);
       return 0;
@@ -2,8 +2,26 @@
 #define RUNNER_DESKTOP_LYRIC_WINDOW_H_
 
 #include <windows.h>
+#include <gdiplus.h>
 #include <string>
 #include <memory>
+#include <vector>
+
+#include "lyric_render_core.h"
+#include "lyric_style.h"
+#include "lyric_timeline.h"
+
+// Cached outline of one lyric line: the text fill and, when stroked, the
+// widened stroke outline, plus the pixel bounds both cover. In karaoke mode
+// |line| is the sung line alone (without its translation), which the
+// highlight is clipped over.
+struct LyricGlyphs {
+  std::unique_ptr<Gdiplus::GraphicsPath> fill;
+  std::unique_ptr<Gdiplus::GraphicsPath> stroke;
+  cyrene::LyricRect bounds;
+  std::unique_ptr<Gdiplus::GraphicsPath> line;
+  cyrene::LyricRect line_bounds;
+};
 
 // Desktop lyric window class
 class DesktopLyricWindow {
@@ -22,8 +40,16 @@ class DesktopLyricWindow {
   void Hide();
   bool IsVisible() const;
   
-  // Set lyric text
+  // Set lyric text (leaves karaoke mode)
   void SetLyricText(const std::wstring& text);
+
+  // Load a whole timed lyric document. The window then picks the line and
+  // advances the karaoke highlight itself on a ~60 fps timer, interpolating
+  // between SyncPosition calls. An empty document leaves karaoke mode.
+  void SetLyricDocument(std::vector<cyrene::LyricTimelineLine> lines);
+
+  // Playback position report (milliseconds) and play state
+  void SyncPosition(int64_t position_ms, bool playing);
   
   // Set window position
   void SetPosition(int x, int y);
@@ -42,35 +68,89 @@ class DesktopLyricWindow {
   
   // Set stroke width
   void SetStrokeWidth(int width);
+
+  // Set karaoke highlight color (ARGB format)
+  void SetHighlightColor(DWORD color);
   
   // Set draggable
   void SetDraggable(bool draggable);
   
   // Set mouse transparent
   void SetMouseTransparent(bool transparent);
+
+  // Apply several style properties at once with a single redraw
+  void ApplyStyle(const cyrene::LyricStyleUpdate& update);
   
   // Get window handle
   HWND GetHandle() const { return hwnd_; }
 
+  // Render statistics (frame times and glyph cache counters)
+  const cyrene::FrameStats& frame_stats() const { return frame_stats_; }
+  const cyrene::GlyphCache<LyricGlyphs>& glyph_cache() const {
+    return glyph_cache_;
+  }
+
  private:
   static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
   
-  // Update window display
+  // Update window display, repainting and re-blitting only the dirty area
   void UpdateWindow();
-  
-  // Draw lyric to memory DC
-  void DrawLyric(HDC hdc, int width, int height);
-  
+
+  // Create/release the persistent back buffer and GDI+ objects
+  bool CreateSurface();
+  void DestroySurface();
+
+  // Cache key of the current line's outline
+  cyrene::GlyphKey CurrentGlyphKey() const;
+
+  // Outline for |key|, built on first use and cached
+  const LyricGlyphs& CurrentGlyphs(const cyrene::GlyphKey& key);
+
+  // Draw lyric into the dirty rectangle of the back buffer
+  void DrawLyric(const LyricGlyphs* glyphs, const cyrene::LyricRect& dirty);
+
+  // Advance karaoke to the clock's current position
+  void Tick();
+
+  // Run the frame timer only while karaoke is visibly playing
+  void UpdateTimer();
+
+  // Apply style_.mouse_transparent to the window
+  void UpdateMouseTransparency();
+
+  // Switch the displayed text (cache key follows)
+  void SetDisplayText(const std::wstring& text);
+
   HWND hwnd_;
   std::wstring lyric_text_;
-  int font_size_;
-  DWORD text_color_;
-  DWORD stroke_color_;
-  int stroke_width_;
-  bool is_draggable_;
+  std::string lyric_text_utf8_;  // Glyph cache key
+  cyrene::LyricStyle style_;
   bool is_dragging_;
   POINT drag_point_;
   HFONT font_;
+
+  // Back buffer kept across frames
+  HDC mem_dc_;
+  HBITMAP bitmap_;
+  HGDIOBJ old_bitmap_;
+  std::unique_ptr<Gdiplus::Graphics> graphics_;
+  std::unique_ptr<Gdiplus::FontFamily> font_family_;
+  std::unique_ptr<Gdiplus::StringFormat> string_format_;
+  std::unique_ptr<Gdiplus::SolidBrush> text_brush_;
+  std::unique_ptr<Gdiplus::SolidBrush> stroke_brush_;
+
+  std::unique_ptr<Gdiplus::SolidBrush> highlight_brush_;
+
+  // Karaoke state
+  cyrene::LyricTimeline timeline_;
+  cyrene::LyricClock clock_;
+  cyrene::KaraokeFrame karaoke_;
+  int highlight_x_;  // Right edge of the highlight, or -1 for none
+  bool timer_running_;
+
+  cyrene::GlyphCache<LyricGlyphs> glyph_cache_;
+  cyrene::DirtyTracker dirty_;
+  cyrene::FrameStats frame_stats_;
 };
 
 #endif  // RUNNER_DESKTOP_LYRIC_WINDOW_H_